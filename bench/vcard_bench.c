@@ -0,0 +1,648 @@
+/**
+ * Virtual Sound Card - Benchmark Suite
+ *
+ * Times the hot paths of the common library and prints the results as one
+ * JSON document, so runs can be compared across releases, machines and
+ * SIMD kernels:
+ *  - sine:   every sine_generator_process_* variant, once per supported
+ *            kernel (scalar and SIMD), and the same tone from cached
+ *            cycles and an interpolated wavetable
+ *  - convert: float to f32/i16/i24/i32 interleaved conversion
+ *  - ring:   ring buffer write + read, copying and zero-copy
+ *  - engine: vcard_write_audio + vcard_read_audio through a device
+ *  - mixer:  routing_mixer_process at 2, 8 and 32 channels
+ *  - resample: resampler_process 44.1 -> 48 kHz at 2, 8 and 32 channels
+ * over buffers of 32 to 4096 frames where the size matters.
+ *
+ * Each case is run in batches long enough to time reliably; the fastest of
+ * several batches is reported, as nanoseconds per call and per sample.
+ *
+ * Usage: vcard_bench [--quick] [--group <name>] [--output <file>]
+ */
+
+#include "vcard.h"
+#include "vcard_thread.h"
+#include "sine_generator.h"
+#include "sine_table.h"
+#include "ring_buffer.h"
+#include "routing_mixer.h"
+#include "resampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define BENCH_MIN_FRAMES 32
+#define BENCH_MAX_FRAMES 4096
+#define BENCH_MAX_CHANNELS 32
+#define BENCH_SINE_FRAMES 1024
+#define BENCH_SAMPLE_RATE 48000
+
+#ifndef VCARD_BENCH_CONFIG
+#define VCARD_BENCH_CONFIG ""
+#endif
+
+#if defined(__clang__)
+#define BENCH_COMPILER "clang " __clang_version__
+#elif defined(__GNUC__)
+#define BENCH_COMPILER "gcc " __VERSION__
+#elif defined(_MSC_VER)
+#define BENCH_COMPILER "msvc"
+#else
+#define BENCH_COMPILER "unknown"
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BENCH_ARCH "x86_64"
+#elif defined(__i386__) || defined(_M_IX86)
+#define BENCH_ARCH "x86"
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define BENCH_ARCH "arm64"
+#elif defined(__arm__) || defined(_M_ARM)
+#define BENCH_ARCH "arm"
+#else
+#define BENCH_ARCH "unknown"
+#endif
+
+typedef void (*bench_fn_t)(void *ctx);
+
+/**
+ * Description of one result row
+ */
+typedef struct {
+    const char *group;
+    const char *name;
+    const char *kernel;     /* NULL when not kernel-specific */
+    const char *format;     /* NULL when not format-specific */
+    uint32_t channels;
+    uint32_t frames;        /* Frames per call */
+} bench_case_t;
+
+typedef struct {
+    FILE *out;
+    const char *group;      /* Only run this group, or NULL for all */
+    uint64_t batch_ns;      /* Minimum duration of a timed batch */
+    int repeats;            /* Timed batches per case */
+    int results;
+} bench_t;
+
+/* Keeps the compiler from discarding benchmarked work */
+static volatile float bench_sink;
+
+static float bench_src[BENCH_MAX_CHANNELS][BENCH_MAX_FRAMES];
+static float bench_dst[BENCH_MAX_CHANNELS][BENCH_MAX_FRAMES];
+static float bench_interleaved[BENCH_MAX_FRAMES * BENCH_MAX_CHANNELS];
+
+static const char *format_names[] = { "f32", "i16", "i24", "i32", "i24_32" };
+
+static int bench_enabled(const bench_t *b, const char *group)
+{
+    return !b->group || strcmp(b->group, group) == 0;
+}
+
+/**
+ * Time fn and emit a result row
+ *
+ * Doubles the number of calls per batch until a batch lasts batch_ns, then
+ * keeps the fastest of repeats batches.
+ */
+static void bench_run(bench_t *b, const bench_case_t *c, bench_fn_t fn, void *ctx)
+{
+    uint64_t iterations = 1;
+    double best_ns = 0.0;
+    double samples = (double)c->frames * (double)c->channels;
+
+    fn(ctx);
+    for (;;) {
+        uint64_t start = vcard_time_ns();
+        for (uint64_t i = 0; i < iterations; i++) {
+            fn(ctx);
+        }
+        if (vcard_time_ns() - start >= b->batch_ns || iterations >= (1ull << 40)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    for (int r = 0; r < b->repeats; r++) {
+        uint64_t start = vcard_time_ns();
+        double ns;
+
+        for (uint64_t i = 0; i < iterations; i++) {
+            fn(ctx);
+        }
+        ns = (double)(vcard_time_ns() - start) / (double)iterations;
+        if (r == 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+    }
+
+    fprintf(b->out, "%s\n    {\"group\": \"%s\", \"name\": \"%s\"",
+            b->results ? "," : "", c->group, c->name);
+    if (c->kernel) {
+        fprintf(b->out, ", \"kernel\": \"%s\"", c->kernel);
+    }
+    if (c->format) {
+        fprintf(b->out, ", \"format\": \"%s\"", c->format);
+    }
+    fprintf(b->out, ", \"channels\": %u, \"frames\": %u, \"iterations\": %llu, "
+            "\"ns_per_call\": %.1f, \"ns_per_sample\": %.4f, "
+            "\"msamples_per_s\": %.2f}",
+            c->channels, c->frames, (unsigned long long)iterations, best_ns,
+            best_ns / samples, best_ns > 0.0 ? samples * 1e3 / best_ns : 0.0);
+    b->results++;
+}
+
+/* Sine generator */
+
+typedef struct {
+    sine_generator_t gen;
+    int variant;
+    unsigned int channels;
+} sine_ctx_t;
+
+static const char *sine_variants[] = {
+    "process_f32", "process_i16", "process_i32",
+    "process_interleaved_f32", "process_interleaved_i16",
+    "process_interleaved_i32"
+};
+
+static void bench_sine_fn(void *arg)
+{
+    sine_ctx_t *ctx = (sine_ctx_t *)arg;
+    void *buf = bench_interleaved;
+
+    switch (ctx->variant) {
+    case 0:
+        sine_generator_process_f32(&ctx->gen, buf, BENCH_SINE_FRAMES);
+        break;
+    case 1:
+        sine_generator_process_i16(&ctx->gen, buf, BENCH_SINE_FRAMES);
+        break;
+    case 2:
+        sine_generator_process_i32(&ctx->gen, buf, BENCH_SINE_FRAMES);
+        break;
+    case 3:
+        sine_generator_process_interleaved_f32(&ctx->gen, buf, BENCH_SINE_FRAMES,
+                                               ctx->channels);
+        break;
+    case 4:
+        sine_generator_process_interleaved_i16(&ctx->gen, buf, BENCH_SINE_FRAMES,
+                                               ctx->channels);
+        break;
+    default:
+        sine_generator_process_interleaved_i32(&ctx->gen, buf, BENCH_SINE_FRAMES,
+                                               ctx->channels);
+        break;
+    }
+    bench_sink = bench_interleaved[0];
+}
+
+typedef struct {
+    sine_generator_t gen;
+    sine_writer_t writer;
+    sine_table_t table;
+} table_ctx_t;
+
+static void bench_writer_render_fn(void *arg)
+{
+    table_ctx_t *ctx = (table_ctx_t *)arg;
+    void *buffer = bench_interleaved;
+
+    sine_writer_render(&ctx->writer, &ctx->gen, &buffer, BENCH_SINE_FRAMES, NULL);
+    bench_sink = bench_interleaved[0];
+}
+
+static void bench_table_fn(void *arg)
+{
+    table_ctx_t *ctx = (table_ctx_t *)arg;
+    void *buffer = bench_interleaved;
+
+    sine_table_render(&ctx->table, &buffer, BENCH_SINE_FRAMES);
+    bench_sink = bench_interleaved[0];
+}
+
+/* One tone through the generator, cached cycles and the interpolated table */
+static void bench_sine_table(bench_t *b)
+{
+    static const sine_format_t formats[] = { SINE_FORMAT_F32, SINE_FORMAT_I16 };
+    static table_ctx_t ctx;
+
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        bench_case_t render = { "sine", "writer_render", NULL, format_names[formats[f]],
+                                2, BENCH_SINE_FRAMES };
+        bench_case_t cached = { "sine", "table_cached", NULL, format_names[formats[f]],
+                                2, BENCH_SINE_FRAMES };
+        bench_case_t lookup = { "sine", "table_interpolated", NULL,
+                                format_names[formats[f]], 2, BENCH_SINE_FRAMES };
+
+        sine_writer_init(&ctx.writer, formats[f], 2, 0);
+        sine_generator_init(&ctx.gen, 1000.0, BENCH_SAMPLE_RATE, 0.5);
+        bench_run(b, &render, bench_writer_render_fn, &ctx);
+
+        if (sine_table_init_sine(&ctx.table, &ctx.writer, &ctx.gen) == VCARD_SUCCESS) {
+            bench_run(b, &cached, bench_table_fn, &ctx);
+            sine_table_free(&ctx.table);
+        }
+        // An irrational ratio has no period to cache
+        ctx.gen.frequency = 1000.0 * 1.41421356237309505;
+        if (sine_table_init_sine(&ctx.table, &ctx.writer, &ctx.gen) == VCARD_SUCCESS) {
+            bench_run(b, &lookup, bench_table_fn, &ctx);
+            sine_table_free(&ctx.table);
+        }
+    }
+}
+
+static void bench_sine(bench_t *b)
+{
+    static const sine_kernel_t kernels[] = {
+        SINE_KERNEL_SCALAR, SINE_KERNEL_SSE2, SINE_KERNEL_AVX2, SINE_KERNEL_NEON
+    };
+    sine_kernel_t saved = sine_generator_active_kernel();
+    sine_ctx_t ctx;
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (!sine_generator_kernel_supported(kernels[k]) ||
+            sine_generator_select_kernel(kernels[k]) != 0) {
+            continue;
+        }
+        for (int v = 0; v < 6; v++) {
+            bench_case_t c = { "sine", sine_variants[v],
+                               sine_generator_kernel_name(kernels[k]), NULL,
+                               v < 3 ? 1 : 2, BENCH_SINE_FRAMES };
+
+            sine_generator_init(&ctx.gen, 1000.0, BENCH_SAMPLE_RATE, 0.5);
+            ctx.variant = v;
+            ctx.channels = c.channels;
+            bench_run(b, &c, bench_sine_fn, &ctx);
+        }
+    }
+    sine_generator_select_kernel(saved);
+    bench_sine_table(b);
+}
+
+/* Format conversion */
+
+typedef struct {
+    sine_format_t format;
+    uint32_t frames;
+    sine_dither_t dither;
+    sine_writer_t writer;
+} convert_ctx_t;
+
+static void bench_convert_fn(void *arg)
+{
+    convert_ctx_t *ctx = (convert_ctx_t *)arg;
+
+    sine_format_convert(bench_src[0], ctx->frames, bench_interleaved, 2, ctx->format);
+    bench_sink = bench_interleaved[0];
+}
+
+static void bench_convert_dither_fn(void *arg)
+{
+    convert_ctx_t *ctx = (convert_ctx_t *)arg;
+
+    sine_format_convert_dither(bench_src[0], ctx->frames, bench_interleaved, 2,
+                               ctx->format, &ctx->dither);
+    bench_sink = bench_interleaved[0];
+}
+
+static void bench_writer_fn(void *arg)
+{
+    convert_ctx_t *ctx = (convert_ctx_t *)arg;
+    void *buffer = bench_interleaved;
+
+    sine_writer_convert(&ctx->writer, bench_src[0], ctx->frames, &buffer, NULL);
+    bench_sink = bench_interleaved[0];
+}
+
+static void bench_convert(bench_t *b)
+{
+    static const uint32_t layouts[] = { 2, 6, 8, 12, 32 };
+    convert_ctx_t ctx;
+
+    sine_dither_init(&ctx.dither, 1);
+    for (int f = SINE_FORMAT_F32; f <= SINE_FORMAT_I24_32; f++) {
+        for (uint32_t frames = BENCH_MIN_FRAMES; frames <= BENCH_MAX_FRAMES; frames *= 4) {
+            bench_case_t c = { "convert", "sine_format_convert", NULL,
+                               format_names[f], 2, frames };
+            bench_case_t d = { "convert", "sine_format_convert_dither", NULL,
+                               format_names[f], 2, frames };
+
+            ctx.format = (sine_format_t)f;
+            ctx.frames = frames;
+            bench_run(b, &c, bench_convert_fn, &ctx);
+            if (f != SINE_FORMAT_F32) {
+                bench_run(b, &d, bench_convert_dither_fn, &ctx);
+            }
+        }
+
+        // Layout kernels resolved once, at specialized counts and a generic one (12)
+        for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+            bench_case_t c = { "convert", "sine_writer_convert", NULL, format_names[f],
+                               layouts[l], BENCH_SINE_FRAMES };
+
+            sine_writer_init(&ctx.writer, (sine_format_t)f, layouts[l], 0);
+            ctx.frames = BENCH_SINE_FRAMES;
+            bench_run(b, &c, bench_writer_fn, &ctx);
+        }
+    }
+}
+
+/* Ring buffer */
+
+typedef struct {
+    ring_buffer_t rb;
+    uint32_t frames;
+} ring_ctx_t;
+
+static void bench_ring_copy_fn(void *arg)
+{
+    ring_ctx_t *ctx = (ring_ctx_t *)arg;
+
+    ring_buffer_write(&ctx->rb, bench_src[0], ctx->frames);
+    ring_buffer_read(&ctx->rb, bench_dst[0], ctx->frames);
+    bench_sink = bench_dst[0][0];
+}
+
+static void bench_ring_regions_fn(void *arg)
+{
+    ring_ctx_t *ctx = (ring_ctx_t *)arg;
+    float *w1, *w2;
+    const float *r1, *r2;
+    uint32_t n1, n2;
+
+    // Produce in place, then consume in place
+    ring_buffer_get_write_regions(&ctx->rb, ctx->frames, &w1, &n1, &w2, &n2);
+    memcpy(w1, bench_src[0], n1 * sizeof(float));
+    if (n2) {
+        memcpy(w2, bench_src[0] + n1, n2 * sizeof(float));
+    }
+    ring_buffer_commit_write(&ctx->rb, n1 + n2);
+
+    ring_buffer_get_read_regions(&ctx->rb, ctx->frames, &r1, &n1, &r2, &n2);
+    memcpy(bench_dst[0], r1, n1 * sizeof(float));
+    if (n2) {
+        memcpy(bench_dst[0] + n1, r2, n2 * sizeof(float));
+    }
+    ring_buffer_commit_read(&ctx->rb, n1 + n2);
+    bench_sink = bench_dst[0][0];
+}
+
+static void bench_ring(bench_t *b)
+{
+    ring_ctx_t ctx;
+
+    if (ring_buffer_init(&ctx.rb, 2 * BENCH_MAX_FRAMES) != 0) {
+        fprintf(stderr, "vcard_bench: ring buffer allocation failed\n");
+        return;
+    }
+    for (uint32_t frames = BENCH_MIN_FRAMES; frames <= BENCH_MAX_FRAMES; frames *= 2) {
+        bench_case_t copy = { "ring", "write_read", NULL, NULL, 1, frames };
+        bench_case_t regions = { "ring", "write_read_regions", NULL, NULL, 1, frames };
+
+        ctx.frames = frames;
+        ring_buffer_reset(&ctx.rb);
+        bench_run(b, &copy, bench_ring_copy_fn, &ctx);
+        ring_buffer_reset(&ctx.rb);
+        bench_run(b, &regions, bench_ring_regions_fn, &ctx);
+    }
+    ring_buffer_free(&ctx.rb);
+}
+
+/* Device engine */
+
+typedef struct {
+    int device_id;
+    uint32_t frames;
+    const float *src[BENCH_MAX_CHANNELS];
+    float *dst[BENCH_MAX_CHANNELS];
+} engine_ctx_t;
+
+static void bench_engine_fn(void *arg)
+{
+    engine_ctx_t *ctx = (engine_ctx_t *)arg;
+    size_t done;
+
+    vcard_write_audio(ctx->device_id, ctx->src, ctx->frames, &done);
+    vcard_read_audio(ctx->device_id, ctx->dst, ctx->frames, &done);
+    bench_sink = bench_dst[0][0];
+}
+
+static void bench_engine(bench_t *b)
+{
+    static const uint32_t channel_counts[] = { 2, 8, 32 };
+    engine_ctx_t ctx;
+
+    if (vcard_init() != VCARD_SUCCESS) {
+        fprintf(stderr, "vcard_bench: vcard_init failed\n");
+        return;
+    }
+    for (uint32_t ch = 0; ch < BENCH_MAX_CHANNELS; ch++) {
+        ctx.src[ch] = bench_src[ch];
+        ctx.dst[ch] = bench_dst[ch];
+    }
+    for (size_t i = 0; i < sizeof(channel_counts) / sizeof(channel_counts[0]); i++) {
+        vcard_config_t config;
+
+        memset(&config, 0, sizeof(config));
+        snprintf(config.name, sizeof(config.name), "Bench %u", channel_counts[i]);
+        config.channels_in = channel_counts[i];
+        config.channels_out = channel_counts[i];
+        config.sample_rate = BENCH_SAMPLE_RATE;
+        config.buffer_size = BENCH_MAX_FRAMES;
+        config.bit_depth = 32;
+        if (vcard_create_device(&config, &ctx.device_id) != VCARD_SUCCESS) {
+            fprintf(stderr, "vcard_bench: could not create a %u-channel device\n",
+                    channel_counts[i]);
+            continue;
+        }
+        for (uint32_t frames = BENCH_MIN_FRAMES; frames <= BENCH_MAX_FRAMES; frames *= 2) {
+            bench_case_t c = { "engine", "write_read", NULL, NULL,
+                               channel_counts[i], frames };
+
+            ctx.frames = frames;
+            bench_run(b, &c, bench_engine_fn, &ctx);
+        }
+        vcard_destroy_device(ctx.device_id);
+    }
+    vcard_cleanup();
+}
+
+/* Routing mixer */
+
+typedef struct {
+    routing_mixer_t mixer;
+    uint32_t frames;
+    const float *src[BENCH_MAX_CHANNELS];
+    float *dst[BENCH_MAX_CHANNELS];
+} mixer_ctx_t;
+
+static void bench_mixer_fn(void *arg)
+{
+    mixer_ctx_t *ctx = (mixer_ctx_t *)arg;
+
+    routing_mixer_begin(&ctx->mixer);
+    routing_mixer_process(&ctx->mixer, ctx->src, ctx->dst, ctx->frames);
+    bench_sink = bench_dst[0][0];
+}
+
+static void bench_mixer(bench_t *b)
+{
+    static const uint32_t channel_counts[] = { 2, 8, 32 };
+    static mixer_ctx_t ctx;
+
+    for (uint32_t ch = 0; ch < BENCH_MAX_CHANNELS; ch++) {
+        ctx.src[ch] = bench_src[ch];
+        ctx.dst[ch] = bench_dst[ch];
+    }
+    for (size_t i = 0; i < sizeof(channel_counts) / sizeof(channel_counts[0]); i++) {
+        uint32_t n = channel_counts[i];
+        vcard_routing_t routing;
+
+        // Every destination mixes its own source and the next one down
+        routing.num_routes = 0;
+        for (uint32_t ch = 0; ch < n; ch++) {
+            for (uint32_t k = 0; k < 2; k++) {
+                routing.routes[routing.num_routes].source_channel = (ch + k) % n;
+                routing.routes[routing.num_routes].dest_channel = ch;
+                routing.routes[routing.num_routes].gain = 0.5f;
+                routing.num_routes++;
+            }
+        }
+        routing_mixer_init(&ctx.mixer, n, n);
+        routing_mixer_publish(&ctx.mixer, &routing);
+
+        for (uint32_t frames = BENCH_MIN_FRAMES; frames <= BENCH_MAX_FRAMES; frames *= 2) {
+            bench_case_t c = { "mixer", "process_2_routes_per_channel", NULL, NULL,
+                               n, frames };
+
+            ctx.frames = frames;
+            bench_run(b, &c, bench_mixer_fn, &ctx);
+        }
+    }
+}
+
+typedef struct {
+    resampler_t resampler;
+    uint32_t frames;
+    const float *src[BENCH_MAX_CHANNELS];
+    float *dst[BENCH_MAX_CHANNELS];
+} resample_ctx_t;
+
+static void bench_resample_fn(void *arg)
+{
+    resample_ctx_t *ctx = (resample_ctx_t *)arg;
+    size_t used;
+
+    // Input for about ctx->frames output frames; the rest stays staged
+    resampler_process(&ctx->resampler, ctx->src, ctx->frames * 147 / 160 + 1, &used,
+                      ctx->dst, ctx->frames);
+    bench_sink = bench_dst[0][0];
+}
+
+static void bench_resample(bench_t *b)
+{
+    static const uint32_t channel_counts[] = { 2, 8, 32 };
+    static resample_ctx_t ctx;
+
+    for (uint32_t ch = 0; ch < BENCH_MAX_CHANNELS; ch++) {
+        ctx.src[ch] = bench_src[ch];
+        ctx.dst[ch] = bench_dst[ch];
+    }
+    for (size_t i = 0; i < sizeof(channel_counts) / sizeof(channel_counts[0]); i++) {
+        uint32_t n = channel_counts[i];
+
+        if (resampler_init(&ctx.resampler, n, 44100, BENCH_SAMPLE_RATE) != 0) {
+            continue;
+        }
+        for (uint32_t frames = BENCH_MIN_FRAMES; frames <= BENCH_MAX_FRAMES; frames *= 2) {
+            bench_case_t c = { "resample", "process_44100_to_48000", NULL, NULL, n, frames };
+
+            ctx.frames = frames;
+            bench_run(b, &c, bench_resample_fn, &ctx);
+        }
+        resampler_free(&ctx.resampler);
+    }
+}
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [--quick] [--group <name>] [--output <file>]\n", prog);
+    printf("  --quick           Short batches (smoke run, noisy numbers)\n");
+    printf("  --group <name>    Only run sine, convert, ring, engine, mixer or resample\n");
+    printf("  --output <file>   Write the JSON results to a file (default stdout)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bench_t b;
+    const char *output = NULL;
+
+    memset(&b, 0, sizeof(b));
+    b.batch_ns = 20000000;
+    b.repeats = 5;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            b.batch_ns = 1000000;
+            b.repeats = 2;
+        } else if (strcmp(argv[i], "--group") == 0 && i + 1 < argc) {
+            b.group = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    b.out = output ? fopen(output, "w") : stdout;
+    if (!b.out) {
+        fprintf(stderr, "vcard_bench: cannot open %s\n", output);
+        return 1;
+    }
+
+    for (uint32_t ch = 0; ch < BENCH_MAX_CHANNELS; ch++) {
+        for (uint32_t i = 0; i < BENCH_MAX_FRAMES; i++) {
+            bench_src[ch][i] = (float)((i * 37 + ch * 11) % 200) / 100.0f - 1.0f;
+        }
+    }
+
+    fprintf(b.out, "{\n  \"suite\": \"vcard_bench\",\n");
+    fprintf(b.out, "  \"version\": \"%d.%d.%d\",\n", VCARD_VERSION_MAJOR,
+            VCARD_VERSION_MINOR, VCARD_VERSION_PATCH);
+    fprintf(b.out, "  \"compiler\": \"%s\",\n", BENCH_COMPILER);
+    fprintf(b.out, "  \"config\": \"%s\",\n", VCARD_BENCH_CONFIG);
+    fprintf(b.out, "  \"arch\": \"%s\",\n", BENCH_ARCH);
+    fprintf(b.out, "  \"default_kernel\": \"%s\",\n",
+            sine_generator_kernel_name(sine_generator_active_kernel()));
+    fprintf(b.out, "  \"batch_ns\": %llu,\n  \"repeats\": %d,\n",
+            (unsigned long long)b.batch_ns, b.repeats);
+    fprintf(b.out, "  \"results\": [");
+
+    if (bench_enabled(&b, "sine")) {
+        bench_sine(&b);
+    }
+    if (bench_enabled(&b, "convert")) {
+        bench_convert(&b);
+    }
+    if (bench_enabled(&b, "ring")) {
+        bench_ring(&b);
+    }
+    if (bench_enabled(&b, "engine")) {
+        bench_engine(&b);
+    }
+    if (bench_enabled(&b, "mixer")) {
+        bench_mixer(&b);
+    }
+    if (bench_enabled(&b, "resample")) {
+        bench_resample(&b);
+    }
+
+    fprintf(b.out, "\n  ]\n}\n");
+    if (output) {
+        fclose(b.out);
+    }
+    return b.results > 0 ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+/**
+ * Lock-free SPSC Block Queue Implementation
+ */
+
+#include "block_queue.h"
+#include "vcard.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Largest supported block count (keeps index differences unambiguous) */
+#define BLOCK_QUEUE_MAX_BLOCKS (1u << 16)
+
+int block_queue_init(block_queue_t *q, uint32_t min_blocks, size_t block_bytes)
+{
+    uint32_t num_blocks = 1;
+
+    memset(q, 0, sizeof(*q));
+    if (min_blocks == 0 || min_blocks > BLOCK_QUEUE_MAX_BLOCKS || block_bytes == 0) {
+        return VCARD_ERROR_INVALID;
+    }
+    while (num_blocks < min_blocks) {
+        num_blocks <<= 1;
+    }
+
+    // Blocks start on their own cache line so producer and consumer never share one
+    q->stride = (block_bytes + VCARD_CACHELINE - 1) & ~(size_t)(VCARD_CACHELINE - 1);
+    q->storage = (uint8_t *)calloc(num_blocks, q->stride);
+    q->frames = (uint32_t *)calloc(num_blocks, sizeof(uint32_t));
+    if (!q->storage || !q->frames) {
+        block_queue_free(q);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    q->block_bytes = block_bytes;
+    q->num_blocks = num_blocks;
+    q->mask = num_blocks - 1;
+    vcard_atomic_store_relaxed_u32(&q->write_index, 0);
+    vcard_atomic_store_relaxed_u32(&q->read_index, 0);
+    vcard_atomic_store_relaxed_u32(&q->overflows, 0);
+    return VCARD_SUCCESS;
+}
+
+void block_queue_free(block_queue_t *q)
+{
+    free(q->storage);
+    free(q->frames);
+    q->storage = NULL;
+    q->frames = NULL;
+    q->num_blocks = 0;
+    q->mask = 0;
+}
+
+void *block_queue_write_begin(block_queue_t *q)
+{
+    uint32_t w = vcard_atomic_load_relaxed_u32(&q->write_index);
+    uint32_t r = vcard_atomic_load_acquire_u32(&q->read_index);
+
+    if (w - r == q->num_blocks) {
+        // Producer-only counter: no locked add needed
+        vcard_atomic_store_relaxed_u32(&q->overflows,
+                                       vcard_atomic_load_relaxed_u32(&q->overflows) + 1);
+        return NULL;
+    }
+    return q->storage + (size_t)(w & q->mask) * q->stride;
+}
+
+void block_queue_write_commit(block_queue_t *q, uint32_t frames)
+{
+    uint32_t w = vcard_atomic_load_relaxed_u32(&q->write_index);
+
+    q->frames[w & q->mask] = frames;
+    vcard_atomic_store_release_u32(&q->write_index, w + 1);
+}
+
+const void *block_queue_read_begin(block_queue_t *q, uint32_t *frames)
+{
+    uint32_t r = vcard_atomic_load_relaxed_u32(&q->read_index);
+    uint32_t w = vcard_atomic_load_acquire_u32(&q->write_index);
+
+    if (r == w) {
+        return NULL;
+    }
+    if (frames) {
+        *frames = q->frames[r & q->mask];
+    }
+    return q->storage + (size_t)(r & q->mask) * q->stride;
+}
+
+void block_queue_read_commit(block_queue_t *q)
+{
+    uint32_t r = vcard_atomic_load_relaxed_u32(&q->read_index);
+
+    vcard_atomic_store_release_u32(&q->read_index, r + 1);
+}
+
+uint32_t block_queue_overflows(const block_queue_t *q)
+{
+    return vcard_atomic_load_relaxed_u32(&q->overflows);
+}
@@ -0,0 +1,114 @@
+/**
+ * Lock-free Single-Producer/Single-Consumer Block Queue
+ *
+ * Hands fixed-size blocks from a real-time thread to a worker thread
+ * without copying through an intermediate ring or allocating. All blocks
+ * are allocated up front; the producer fills the next free block in place
+ * (e.g. as the destination of AudioUnitRender) and publishes it with its
+ * frame count, and the consumer hands it back once it is done. When every
+ * block is in flight the producer drops the period and counts an overflow
+ * instead of waiting.
+ */
+
+#ifndef BLOCK_QUEUE_H
+#define BLOCK_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vcard_atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Block queue state
+ *
+ * Indices are free-running and wrap modulo 2^32; the block count is a
+ * power of two so slots are obtained with a mask.
+ */
+typedef struct {
+    /* Shared, read-only after block_queue_init() */
+    uint8_t *storage;
+    uint32_t *frames;                    /* Valid frames per published block */
+    size_t block_bytes;                  /* Usable bytes per block */
+    size_t stride;                       /* Bytes between blocks (cache-line multiple) */
+    uint32_t num_blocks;
+    uint32_t mask;
+    char pad0[VCARD_CACHELINE];
+
+    /* Producer-owned line */
+    vcard_atomic_u32 write_index;
+    vcard_atomic_u32 overflows;
+    char pad1[VCARD_CACHELINE - 2 * sizeof(uint32_t)];
+
+    /* Consumer-owned line */
+    vcard_atomic_u32 read_index;
+    char pad2[VCARD_CACHELINE - sizeof(uint32_t)];
+} block_queue_t;
+
+/**
+ * Allocate a block queue
+ *
+ * @param q Queue to initialize
+ * @param min_blocks Minimum number of blocks (rounded up to a power of two)
+ * @param block_bytes Size of each block in bytes
+ * @return 0 on success, VCARD_ERROR_* on failure
+ */
+int block_queue_init(block_queue_t *q, uint32_t min_blocks, size_t block_bytes);
+
+/**
+ * Release the storage of a block queue
+ *
+ * @param q Queue
+ */
+void block_queue_free(block_queue_t *q);
+
+/**
+ * Get the next free block to fill (producer)
+ *
+ * Returns the same block until it is committed. Wait-free.
+ *
+ * @param q Queue
+ * @return Block of q->block_bytes bytes, or NULL if all blocks are in flight
+ *         (the overflow counter is incremented)
+ */
+void *block_queue_write_begin(block_queue_t *q);
+
+/**
+ * Publish the block returned by block_queue_write_begin (producer)
+ *
+ * @param q Queue
+ * @param frames Number of valid frames in the block
+ */
+void block_queue_write_commit(block_queue_t *q, uint32_t frames);
+
+/**
+ * Get the oldest published block (consumer)
+ *
+ * @param q Queue
+ * @param frames Output parameter for the block's frame count
+ * @return Block data, or NULL if none is pending
+ */
+const void *block_queue_read_begin(block_queue_t *q, uint32_t *frames);
+
+/**
+ * Return the block from block_queue_read_begin to the producer (consumer)
+ *
+ * @param q Queue
+ */
+void block_queue_read_commit(block_queue_t *q);
+
+/**
+ * Number of periods the producer dropped because no block was free
+ *
+ * @param q Queue
+ * @return Overflow count
+ */
+uint32_t block_queue_overflows(const block_queue_t *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLOCK_QUEUE_H */
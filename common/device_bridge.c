@@ -0,0 +1,163 @@
+/**
+ * Virtual Sound Card - Device Bridge Implementation
+ */
+
+#include "device_bridge.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEVICE_BRIDGE_MIN_IDLE_US 500
+
+/**
+ * Source -> resampler -> destination (pump thread)
+ */
+static void bridge_pump(void *arg)
+{
+    device_bridge_t *b = (device_bridge_t *)arg;
+    const float *in[VCARD_MAX_CHANNELS] = { NULL };
+    float *source_planes[VCARD_MAX_CHANNELS] = { NULL };
+    float *out[VCARD_MAX_CHANNELS] = { NULL };
+    const float *dest_planes[VCARD_MAX_CHANNELS] = { NULL };
+    size_t in_pos = 0, in_count = 0;
+    size_t out_pos = 0, out_count = 0;
+    uint64_t last_ns = 0;
+
+    for (uint32_t ch = 0; ch < b->channels; ch++) {
+        source_planes[ch] = b->in_data + (size_t)ch * DEVICE_BRIDGE_BLOCK_FRAMES;
+        out[ch] = b->out_data + (size_t)ch * DEVICE_BRIDGE_BLOCK_FRAMES;
+    }
+
+    while (vcard_atomic_load_acquire_u32(&b->running)) {
+        size_t written = 0, used = 0, fill = 0;
+        uint64_t now;
+
+        // Finish handing over the previous block before producing more
+        if (out_pos < out_count) {
+            for (uint32_t ch = 0; ch < b->channels; ch++) {
+                dest_planes[ch] = out[ch] + out_pos;
+            }
+            vcard_write_audio(b->dest_id, dest_planes, out_count - out_pos, &written);
+            out_pos += written;
+            vcard_atomic_fetch_add_u64(&b->frames_out, written);
+            if (out_pos < out_count) {
+                vcard_sleep_us(b->idle_us);
+                continue;
+            }
+        }
+
+        if (in_pos == in_count) {
+            vcard_read_audio(b->source_id, source_planes, DEVICE_BRIDGE_BLOCK_FRAMES, &in_count);
+            in_pos = 0;
+            if (in_count == 0) {
+                // Nothing flowing: don't let the controller wind up meanwhile
+                last_ns = 0;
+                vcard_sleep_us(b->idle_us);
+                continue;
+            }
+            vcard_atomic_fetch_add_u64(&b->frames_in, in_count);
+        }
+
+        vcard_get_buffered(b->dest_id, &fill);
+        vcard_atomic_store_relaxed_u32(&b->fill, (uint32_t)fill);
+        now = vcard_time_ns();
+        if (last_ns) {
+            double adjust = resampler_steer(&b->resampler, (double)fill, (double)b->target,
+                                            (double)(now - last_ns) * 1e-9);
+            vcard_atomic_store_relaxed_u64(&b->correction_ppb,
+                                           (uint64_t)(int64_t)llround(adjust * 1e9));
+        }
+        last_ns = now;
+
+        for (uint32_t ch = 0; ch < b->channels; ch++) {
+            in[ch] = source_planes[ch] + in_pos;
+        }
+        out_count = resampler_process(&b->resampler, in, in_count - in_pos, &used, out,
+                                      DEVICE_BRIDGE_BLOCK_FRAMES);
+        in_pos += used;
+        out_pos = 0;
+    }
+}
+
+int device_bridge_start(device_bridge_t *b, int source_id, int dest_id,
+                        uint32_t target_frames)
+{
+    vcard_config_t source, dest;
+    uint64_t idle_us;
+    size_t bytes;
+    int result;
+
+    memset(b, 0, sizeof(*b));
+    if (source_id == dest_id) {
+        return VCARD_ERROR_INVALID;
+    }
+    result = vcard_get_config(source_id, &source);
+    if (result == VCARD_SUCCESS) {
+        result = vcard_get_config(dest_id, &dest);
+    }
+    if (result != VCARD_SUCCESS) {
+        return result;
+    }
+    if (target_frames == 0) {
+        target_frames = 2 * dest.buffer_size;
+    }
+    if (target_frames > 3 * dest.buffer_size) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    b->source_id = source_id;
+    b->dest_id = dest_id;
+    b->channels = source.channels_in < dest.channels_out ? source.channels_in :
+                                                           dest.channels_out;
+    b->target = target_frames;
+    idle_us = (uint64_t)dest.buffer_size * 1000000 / dest.sample_rate / 4;
+    b->idle_us = idle_us < DEVICE_BRIDGE_MIN_IDLE_US ? DEVICE_BRIDGE_MIN_IDLE_US :
+                                                       (uint32_t)idle_us;
+
+    result = resampler_init(&b->resampler, b->channels, source.sample_rate,
+                            dest.sample_rate);
+    if (result != VCARD_SUCCESS) {
+        return result;
+    }
+    bytes = (size_t)b->channels * DEVICE_BRIDGE_BLOCK_FRAMES * sizeof(float);
+    b->in_data = (float *)malloc(bytes);
+    b->out_data = (float *)malloc(bytes);
+    if (!b->in_data || !b->out_data) {
+        result = VCARD_ERROR_NO_MEMORY;
+        goto fail;
+    }
+
+    vcard_atomic_store_release_u32(&b->running, 1);
+    if (vcard_thread_create(&b->thread, bridge_pump, b) != 0) {
+        result = VCARD_ERROR_NO_MEMORY;
+        goto fail;
+    }
+    return VCARD_SUCCESS;
+
+fail:
+    free(b->in_data);
+    free(b->out_data);
+    resampler_free(&b->resampler);
+    return result;
+}
+
+void device_bridge_stop(device_bridge_t *b)
+{
+    vcard_atomic_store_release_u32(&b->running, 0);
+    vcard_thread_join(&b->thread);
+    free(b->in_data);
+    free(b->out_data);
+    b->in_data = NULL;
+    b->out_data = NULL;
+    resampler_free(&b->resampler);
+}
+
+void device_bridge_get_stats(device_bridge_t *b, device_bridge_stats_t *stats)
+{
+    stats->frames_in = vcard_atomic_load_relaxed_u64(&b->frames_in);
+    stats->frames_out = vcard_atomic_load_relaxed_u64(&b->frames_out);
+    stats->correction_ppm =
+        (double)(int64_t)vcard_atomic_load_relaxed_u64(&b->correction_ppb) / 1000.0;
+    stats->fill = vcard_atomic_load_relaxed_u32(&b->fill);
+    stats->target = b->target;
+}
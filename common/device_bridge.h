@@ -0,0 +1,100 @@
+/**
+ * Virtual Sound Card - Device Bridge
+ *
+ * Carries the input channels of one vcard device into the output channels
+ * of another when the two are clocked independently: a generator writing
+ * to a device paced by one backend, say, and a consumer reading a device
+ * paced by another card or loopback driver. A pump thread reads the
+ * source, converts through an adaptive resampler and writes the
+ * destination, steering the resampler so the destination keeps a constant
+ * number of frames queued. Clock drift then shows up as a correction of
+ * a few ppm instead of a queue that slowly fills or empties into xruns.
+ *
+ * The source and destination sample rates may differ; the nominal ratio
+ * is theirs and steering trims it by up to RESAMPLER_MAX_ADJUST.
+ */
+
+#ifndef DEVICE_BRIDGE_H
+#define DEVICE_BRIDGE_H
+
+#include <stdint.h>
+#include "vcard.h"
+#include "vcard_atomic.h"
+#include "vcard_thread.h"
+#include "resampler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEVICE_BRIDGE_BLOCK_FRAMES 256       /* Frames moved per pump cycle */
+
+/**
+ * Device bridge statistics
+ */
+typedef struct {
+    uint64_t frames_in;       /* Frames read from the source */
+    uint64_t frames_out;      /* Frames written to the destination */
+    double correction_ppm;    /* Steering correction in effect */
+    uint32_t fill;            /* Destination frames queued at the last cycle */
+    uint32_t target;          /* Fill the bridge holds */
+} device_bridge_stats_t;
+
+/**
+ * Device bridge state
+ */
+typedef struct {
+    int source_id;
+    int dest_id;
+    uint32_t channels;                   /* Channels carried across */
+    uint32_t target;                     /* Destination fill to hold */
+    uint32_t idle_us;                    /* Pump sleep when nothing moved */
+    resampler_t resampler;               /* Pump-thread owned */
+    float *in_data;                      /* channels x BLOCK_FRAMES from the source */
+    float *out_data;                     /* channels x BLOCK_FRAMES for the destination */
+    vcard_thread_t thread;
+
+    vcard_atomic_u32 running;
+    vcard_atomic_u32 fill;
+    vcard_atomic_u64 frames_in;
+    vcard_atomic_u64 frames_out;
+    vcard_atomic_u64 correction_ppb;     /* Signed, stored two's complement */
+} device_bridge_t;
+
+/**
+ * Start bridging a source device's inputs to a destination's outputs
+ *
+ * Source input channel N goes to destination output channel N; outputs
+ * beyond the source's channels get silence. The bridge is the only reader
+ * of the source and the only writer of the destination.
+ *
+ * @param b Bridge to start
+ * @param source_id Device whose input channels are read
+ * @param dest_id Device whose output channels are written
+ * @param target_frames Destination fill to hold, or 0 for two periods
+ *                      (at most three of the destination's periods)
+ * @return 0 on success, VCARD_ERROR_* on failure
+ */
+int device_bridge_start(device_bridge_t *b, int source_id, int dest_id,
+                        uint32_t target_frames);
+
+/**
+ * Stop the pump thread and release the bridge
+ *
+ * @param b Bridge
+ */
+void device_bridge_stop(device_bridge_t *b);
+
+/**
+ * Get statistics (any thread)
+ *
+ * @param b Bridge
+ * @param stats Output parameter for statistics
+ */
+void device_bridge_get_stats(device_bridge_t *b, device_bridge_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEVICE_BRIDGE_H */
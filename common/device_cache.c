@@ -0,0 +1,262 @@
+/**
+ * Virtual Sound Card - Persistent Device Discovery Cache Implementation
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "device_cache.h"
+#include "vcard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define DEVICE_CACHE_HEADER "vcard-device-cache 1"
+
+static int valid_field(const char *s, size_t max)
+{
+    size_t len;
+
+    if (!s || !s[0]) {
+        return 0;
+    }
+    len = strlen(s);
+    return len < max && strcspn(s, "\t\r\n") == len;
+}
+
+static int find_entry(const device_cache_t *cache, const char *name)
+{
+    for (uint32_t i = 0; i < cache->count; i++) {
+        if (strcmp(cache->entries[i].name, name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+int device_cache_default_path(const char *backend, char *path, size_t size)
+{
+    const char *override = getenv("VCARD_DEVICE_CACHE");
+    const char *base;
+    const char *suffix;
+    int n;
+
+    if (override) {
+        if (!override[0] || strcmp(override, "off") == 0) {
+            return VCARD_ERROR_NOT_FOUND;
+        }
+        n = snprintf(path, size, "%s", override);
+        return n < 0 || (size_t)n >= size ? VCARD_ERROR_INVALID : VCARD_SUCCESS;
+    }
+
+#if defined(_WIN32)
+    base = getenv("LOCALAPPDATA");
+    suffix = "\\vcard\\";
+#elif defined(__APPLE__)
+    base = getenv("HOME");
+    suffix = "/Library/Caches/vcard/";
+#else
+    base = getenv("XDG_CACHE_HOME");
+    suffix = "/vcard/";
+    if (!base || !base[0]) {
+        base = getenv("HOME");
+        suffix = "/.cache/vcard/";
+    }
+#endif
+    if (!base || !base[0]) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    n = snprintf(path, size, "%s%s%s-devices.cache", base, suffix, backend);
+    return n < 0 || (size_t)n >= size ? VCARD_ERROR_INVALID : VCARD_SUCCESS;
+}
+
+int device_cache_load(device_cache_t *cache, const char *path)
+{
+    char line[DEVICE_CACHE_ID_MAX + DEVICE_CACHE_NAME_MAX + 8];
+    FILE *fp;
+
+    memset(cache, 0, sizeof(*cache));
+    if (!path || !path[0]) {
+        return VCARD_SUCCESS;
+    }
+    if (strlen(path) >= sizeof(cache->path)) {
+        return VCARD_ERROR_INVALID;
+    }
+    strcpy(cache->path, path);
+
+    fp = fopen(path, "r");
+    if (!fp) {
+        return VCARD_SUCCESS;
+    }
+    if (!fgets(line, sizeof(line), fp) ||
+        strncmp(line, DEVICE_CACHE_HEADER, strlen(DEVICE_CACHE_HEADER)) != 0 ||
+        (line[strlen(DEVICE_CACHE_HEADER)] != '\n' && line[strlen(DEVICE_CACHE_HEADER)] != '\r')) {
+        // Another version or not ours: start over, it is rewritten on save
+        fclose(fp);
+        return VCARD_SUCCESS;
+    }
+
+    while (cache->count < DEVICE_CACHE_MAX_ENTRIES && fgets(line, sizeof(line), fp)) {
+        size_t len = strlen(line);
+        char *tab;
+
+        if (len == 0 || line[len - 1] != '\n') {
+            // Overlong or truncated last line
+            if (len == sizeof(line) - 1) {
+                int c;
+                while ((c = fgetc(fp)) != EOF && c != '\n') {
+                }
+            }
+            continue;
+        }
+        line[--len] = '\0';
+        if (len > 0 && line[len - 1] == '\r') {
+            line[--len] = '\0';
+        }
+        tab = strchr(line, '\t');
+        if (!tab) {
+            continue;
+        }
+        *tab = '\0';
+        if (!valid_field(line, DEVICE_CACHE_ID_MAX) ||
+            !valid_field(tab + 1, DEVICE_CACHE_NAME_MAX) ||
+            find_entry(cache, tab + 1) >= 0) {
+            continue;
+        }
+        strcpy(cache->entries[cache->count].id, line);
+        strcpy(cache->entries[cache->count].name, tab + 1);
+        cache->count++;
+    }
+    fclose(fp);
+    return VCARD_SUCCESS;
+}
+
+const char *device_cache_lookup(const device_cache_t *cache, const char *name)
+{
+    int i = name ? find_entry(cache, name) : -1;
+
+    return i >= 0 ? cache->entries[i].id : NULL;
+}
+
+int device_cache_store(device_cache_t *cache, const char *name, const char *id)
+{
+    int i;
+    uint32_t last;
+
+    if (!valid_field(name, DEVICE_CACHE_NAME_MAX) || !valid_field(id, DEVICE_CACHE_ID_MAX)) {
+        return VCARD_ERROR_INVALID;
+    }
+    i = find_entry(cache, name);
+    if (i == 0 && strcmp(cache->entries[0].id, id) == 0) {
+        return VCARD_SUCCESS;
+    }
+
+    // Shift the entries before the old slot (or all, dropping the oldest)
+    last = i >= 0 ? (uint32_t)i
+                  : (cache->count < DEVICE_CACHE_MAX_ENTRIES ? cache->count++
+                                                             : DEVICE_CACHE_MAX_ENTRIES - 1);
+    memmove(&cache->entries[1], &cache->entries[0], last * sizeof(cache->entries[0]));
+    strcpy(cache->entries[0].name, name);
+    strcpy(cache->entries[0].id, id);
+    cache->dirty = 1;
+    return VCARD_SUCCESS;
+}
+
+void device_cache_remove(device_cache_t *cache, const char *name)
+{
+    int i = name ? find_entry(cache, name) : -1;
+
+    if (i < 0) {
+        return;
+    }
+    memmove(&cache->entries[i], &cache->entries[i + 1],
+            (cache->count - (uint32_t)i - 1) * sizeof(cache->entries[0]));
+    cache->count--;
+    cache->dirty = 1;
+}
+
+/**
+ * Create every missing directory above a file
+ */
+static void make_parents(const char *path)
+{
+    char dir[DEVICE_CACHE_PATH_MAX];
+    size_t len = strlen(path);
+
+    if (len >= sizeof(dir)) {
+        return;
+    }
+    memcpy(dir, path, len + 1);
+    for (size_t i = 1; i < len; i++) {
+        if (dir[i] != '/' && dir[i] != '\\') {
+            continue;
+        }
+        dir[i] = '\0';
+#ifdef _WIN32
+        _mkdir(dir);
+#else
+        mkdir(dir, 0755);
+#endif
+        dir[i] = path[i];
+    }
+}
+
+int device_cache_save(device_cache_t *cache)
+{
+    char tmp[DEVICE_CACHE_PATH_MAX + 32];
+    FILE *fp;
+    int ok;
+
+    if (!cache->dirty || !cache->path[0]) {
+        return VCARD_SUCCESS;
+    }
+#ifdef _WIN32
+    snprintf(tmp, sizeof(tmp), "%s.%lu.tmp", cache->path, (unsigned long)GetCurrentProcessId());
+#else
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", cache->path, (long)getpid());
+#endif
+
+    fp = fopen(tmp, "w");
+    if (!fp) {
+        make_parents(cache->path);
+        fp = fopen(tmp, "w");
+        if (!fp) {
+            return VCARD_ERROR_IO;
+        }
+    }
+    ok = fprintf(fp, "%s\n", DEVICE_CACHE_HEADER) > 0;
+    for (uint32_t i = 0; i < cache->count && ok; i++) {
+        ok = fprintf(fp, "%s\t%s\n", cache->entries[i].id, cache->entries[i].name) > 0;
+    }
+    ok = fclose(fp) == 0 && ok;
+
+    // Readers see either the old file or the new one, never a partial one
+#ifdef _WIN32
+    ok = ok && MoveFileExA(tmp, cache->path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    ok = ok && rename(tmp, cache->path) == 0;
+#endif
+    if (!ok) {
+        remove(tmp);
+        return VCARD_ERROR_IO;
+    }
+    cache->dirty = 0;
+    return VCARD_SUCCESS;
+}
+
+void device_cache_invalidate(const char *path)
+{
+    if (path && path[0]) {
+        remove(path);
+    }
+}
@@ -0,0 +1,135 @@
+/**
+ * Virtual Sound Card - Persistent Device Discovery Cache
+ *
+ * Maps the device names users pass on the command line to the backend's
+ * stable device identifier (a WASAPI endpoint ID, a CoreAudio device UID,
+ * an ALSA hw string), so a tool that starts many times an hour can open
+ * its device without enumerating every endpoint on each launch.
+ *
+ * The cache is a small text file, one "id<TAB>name" line per entry under
+ * a version header, replaced atomically on save so concurrent launches
+ * never see a torn file. It is only a hint:
+ *  - a hit is verified by opening the cached identifier directly and
+ *    checking the device's name; a failed check is treated as a miss
+ *  - a miss falls back to full enumeration and stores the result
+ *  - device-change notifications (IMMNotificationClient,
+ *    kAudioHardwarePropertyDevices listeners) call
+ *    device_cache_invalidate() so the next launch re-enumerates
+ *
+ * The file lives in the per-user cache directory
+ * (%LOCALAPPDATA%\vcard, ~/Library/Caches/vcard, $XDG_CACHE_HOME/vcard or
+ * ~/.cache/vcard), or at $VCARD_DEVICE_CACHE; setting that variable to
+ * "off" (or an empty string) disables the cache.
+ */
+
+#ifndef DEVICE_CACHE_H
+#define DEVICE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEVICE_CACHE_MAX_ENTRIES 32
+#define DEVICE_CACHE_NAME_MAX 256            /* Bytes, including the terminator */
+#define DEVICE_CACHE_ID_MAX 256
+#define DEVICE_CACHE_PATH_MAX 1024
+
+/**
+ * One cached lookup
+ */
+typedef struct {
+    char name[DEVICE_CACHE_NAME_MAX];        /* Name as queried (UTF-8) */
+    char id[DEVICE_CACHE_ID_MAX];            /* Backend identifier (UTF-8) */
+} device_cache_entry_t;
+
+/**
+ * In-memory copy of a cache file
+ *
+ * Entries are kept most recently stored first; storing into a full cache
+ * drops the oldest entry.
+ */
+typedef struct {
+    char path[DEVICE_CACHE_PATH_MAX];        /* Empty if the cache is disabled */
+    uint32_t count;
+    int dirty;                               /* Changed since load or save */
+    device_cache_entry_t entries[DEVICE_CACHE_MAX_ENTRIES];
+} device_cache_t;
+
+/**
+ * Build the default cache file path for a backend
+ *
+ * @param backend Backend name used in the file name (e.g. "wasapi")
+ * @param path Output buffer
+ * @param size Size of the output buffer
+ * @return 0 on success, VCARD_ERROR_NOT_FOUND if the cache is disabled or
+ *         no cache directory is known, VCARD_ERROR_INVALID if path is too small
+ */
+int device_cache_default_path(const char *backend, char *path, size_t size);
+
+/**
+ * Load a cache file
+ *
+ * A missing, unreadable or foreign file yields an empty cache that will be
+ * written to path on save. Malformed lines are skipped.
+ *
+ * @param cache Cache to fill
+ * @param path Cache file, or NULL or "" for a disabled (memory-only) cache
+ * @return 0 on success, VCARD_ERROR_INVALID if path is too long
+ */
+int device_cache_load(device_cache_t *cache, const char *path);
+
+/**
+ * Look up the identifier cached for a name
+ *
+ * @param cache Cache
+ * @param name Name as queried
+ * @return The identifier, or NULL on a miss
+ */
+const char *device_cache_lookup(const device_cache_t *cache, const char *name);
+
+/**
+ * Store or replace the identifier for a name
+ *
+ * @param cache Cache
+ * @param name Name as queried
+ * @param id Backend identifier
+ * @return 0 on success, VCARD_ERROR_INVALID if either string is empty,
+ *         too long or contains a tab or line break
+ */
+int device_cache_store(device_cache_t *cache, const char *name, const char *id);
+
+/**
+ * Drop the entry for a name (after its identifier failed verification)
+ *
+ * @param cache Cache
+ * @param name Name as queried
+ */
+void device_cache_remove(device_cache_t *cache, const char *name);
+
+/**
+ * Write the cache back if it changed
+ *
+ * Creates the cache directory if needed and replaces the file atomically.
+ *
+ * @param cache Cache
+ * @return 0 on success (or nothing to write), VCARD_ERROR_IO on failure
+ */
+int device_cache_save(device_cache_t *cache);
+
+/**
+ * Discard a cache file, e.g. from a device-change notification
+ *
+ * Only removes the file; safe to call from notification threads.
+ *
+ * @param path Cache file (NULL or "" is ignored)
+ */
+void device_cache_invalidate(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEVICE_CACHE_H */
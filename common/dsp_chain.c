@@ -0,0 +1,792 @@
+/**
+ * Virtual Sound Card - Insert Chain Processor Implementation
+ */
+
+#include "dsp_chain.h"
+#include "vcard_atomic.h"
+#include "vcard_telemetry.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || \
+    ((defined(__i386__) || defined(_M_IX86)) && \
+     (defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+#define DSP_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define DSP_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Filter lanes per EQ group */
+#define DSP_LANES 4
+
+/* Filter state below this is flushed to zero at block ends, before it goes denormal */
+#define DSP_STATE_FLOOR 1e-25f
+
+typedef struct {
+    uint32_t channel;
+    float gain;
+} gain_lane_t;
+
+/**
+ * Up to four biquads on four channels, transposed direct form II, one per lane
+ */
+typedef struct {
+    float b0[DSP_LANES], b1[DSP_LANES], b2[DSP_LANES], a1[DSP_LANES], a2[DSP_LANES];
+    float z1[DSP_LANES], z2[DSP_LANES];
+    uint32_t channels[DSP_LANES];
+    uint32_t lanes;
+} eq_group_t;
+
+typedef struct {
+    uint32_t channel;
+    uint32_t length;                     /* Frames; 0 passes audio through */
+    uint32_t pos;
+    float *line;
+} delay_lane_t;
+
+typedef struct {
+    uint32_t channel;
+    float peak;
+    float ms;                            /* Smoothed mean square */
+    vcard_atomic_u32 *level;             /* Peak and RMS float bits, for readers */
+} meter_lane_t;
+
+/**
+ * Peak limiter over linked channels: instant attack, exponential release
+ */
+typedef struct {
+    uint32_t channels[VCARD_MAX_CHANNELS];
+    uint32_t count;
+    float ceiling;
+    float release;                       /* Per-frame recovery coefficient */
+    float gain;
+} limiter_t;
+
+typedef struct {
+    vcard_insert_type_t kind;
+    uint32_t count;                      /* Lanes, groups or 1 for a limiter */
+    void *items;
+} dsp_step_t;
+
+struct dsp_chain {
+    uint32_t channels;
+    uint32_t used_mask;                  /* Channels some insert processes */
+    float meter_rate;                    /* 1 / meter time constant in frames */
+    uint32_t num_steps;
+    dsp_step_t *steps;
+    float *scratch[VCARD_MAX_CHANNELS];  /* Stand-ins for NULL buffers */
+    vcard_atomic_u32 *meters[VCARD_MAX_INSERTS];
+};
+
+/**
+ * Bump allocator over the single build-time allocation
+ */
+typedef struct {
+    char *base;
+    size_t used;
+} dsp_arena_t;
+
+static void *arena_take(dsp_arena_t *arena, size_t bytes)
+{
+    void *p;
+
+    arena->used = (arena->used + 15) & ~(size_t)15;
+    p = arena->base ? arena->base + arena->used : NULL;
+    arena->used += bytes;
+    return p;
+}
+
+static uint32_t popcount32(uint32_t mask)
+{
+    uint32_t count = 0;
+
+    for (; mask; mask &= mask - 1) {
+        count++;
+    }
+    return count;
+}
+
+static float db_to_linear(float db)
+{
+    return powf(10.0f, db / 20.0f);
+}
+
+/**
+ * RBJ cookbook coefficients, normalized by a0: b0 b1 b2 a1 a2
+ */
+static void design_eq(const vcard_insert_t *insert, uint32_t sample_rate, float coefs[5])
+{
+    double f = insert->frequency_hz;
+    double A, w0, cw, alpha, sa, a0;
+    double b[3], a[3];
+
+    // A device rate change may leave the frequency above the new Nyquist
+    if (f > 0.45 * sample_rate) {
+        f = 0.45 * sample_rate;
+    }
+    A = pow(10.0, insert->gain_db / 40.0);
+    w0 = 2.0 * M_PI * f / sample_rate;
+    cw = cos(w0);
+    alpha = sin(w0) / (2.0 * insert->q);
+    sa = 2.0 * sqrt(A) * alpha;
+
+    switch (insert->shape) {
+    case VCARD_EQ_LOW_SHELF:
+        b[0] = A * ((A + 1) - (A - 1) * cw + sa);
+        b[1] = 2 * A * ((A - 1) - (A + 1) * cw);
+        b[2] = A * ((A + 1) - (A - 1) * cw - sa);
+        a[0] = (A + 1) + (A - 1) * cw + sa;
+        a[1] = -2 * ((A - 1) + (A + 1) * cw);
+        a[2] = (A + 1) + (A - 1) * cw - sa;
+        break;
+    case VCARD_EQ_HIGH_SHELF:
+        b[0] = A * ((A + 1) + (A - 1) * cw + sa);
+        b[1] = -2 * A * ((A - 1) + (A + 1) * cw);
+        b[2] = A * ((A + 1) + (A - 1) * cw - sa);
+        a[0] = (A + 1) - (A - 1) * cw + sa;
+        a[1] = 2 * ((A - 1) - (A + 1) * cw);
+        a[2] = (A + 1) - (A - 1) * cw - sa;
+        break;
+    case VCARD_EQ_LOWPASS:
+        b[0] = (1 - cw) / 2;
+        b[1] = 1 - cw;
+        b[2] = (1 - cw) / 2;
+        a[0] = 1 + alpha;
+        a[1] = -2 * cw;
+        a[2] = 1 - alpha;
+        break;
+    case VCARD_EQ_HIGHPASS:
+        b[0] = (1 + cw) / 2;
+        b[1] = -(1 + cw);
+        b[2] = (1 + cw) / 2;
+        a[0] = 1 + alpha;
+        a[1] = -2 * cw;
+        a[2] = 1 - alpha;
+        break;
+    case VCARD_EQ_PEAK:
+    default:
+        b[0] = 1 + alpha * A;
+        b[1] = -2 * cw;
+        b[2] = 1 - alpha * A;
+        a[0] = 1 + alpha / A;
+        a[1] = -2 * cw;
+        a[2] = 1 - alpha / A;
+        break;
+    }
+    a0 = a[0];
+    coefs[0] = (float)(b[0] / a0);
+    coefs[1] = (float)(b[1] / a0);
+    coefs[2] = (float)(b[2] / a0);
+    coefs[3] = (float)(a[1] / a0);
+    coefs[4] = (float)(a[2] / a0);
+}
+
+int dsp_chain_validate(const vcard_insert_chain_t *chain, uint32_t channels)
+{
+    if (!chain || chain->num_inserts > VCARD_MAX_INSERTS ||
+        channels < 1 || channels > VCARD_MAX_CHANNELS) {
+        return VCARD_ERROR_INVALID;
+    }
+    for (uint32_t i = 0; i < chain->num_inserts; i++) {
+        const vcard_insert_t *insert = &chain->inserts[i];
+
+        if (insert->channel_mask == 0 ||
+            (channels < 32 && (insert->channel_mask >> channels) != 0)) {
+            return VCARD_ERROR_INVALID;
+        }
+        switch (insert->type) {
+        case VCARD_INSERT_GAIN:
+            if (!isfinite(insert->gain_db)) {
+                return VCARD_ERROR_INVALID;
+            }
+            break;
+        case VCARD_INSERT_EQ:
+            if ((uint32_t)insert->shape > VCARD_EQ_HIGHPASS || !isfinite(insert->gain_db) ||
+                !(insert->frequency_hz > 0.0f) || !isfinite(insert->frequency_hz) ||
+                !(insert->q > 0.0f) || !isfinite(insert->q)) {
+                return VCARD_ERROR_INVALID;
+            }
+            break;
+        case VCARD_INSERT_DELAY:
+            if (!(insert->time_ms >= 0.0f && insert->time_ms <= VCARD_MAX_INSERT_DELAY_MS)) {
+                return VCARD_ERROR_INVALID;
+            }
+            break;
+        case VCARD_INSERT_METER:
+            break;
+        case VCARD_INSERT_LIMITER:
+            if (!(insert->gain_db <= 0.0f) || !isfinite(insert->gain_db) ||
+                !(insert->time_ms > 0.0f) || !isfinite(insert->time_ms)) {
+                return VCARD_ERROR_INVALID;
+            }
+            break;
+        default:
+            return VCARD_ERROR_INVALID;
+        }
+    }
+    return VCARD_SUCCESS;
+}
+
+/**
+ * Lay the chain out in an arena; with a NULL base this only sizes it
+ *
+ * depth[] is the dependency depth of each insert: one more than the
+ * deepest earlier insert sharing a channel. List order is already a
+ * topological order, so one forward pass finds it.
+ */
+static dsp_chain_t *layout(const vcard_insert_chain_t *chain, const uint32_t *depth,
+                           uint32_t max_depth, uint32_t channels, uint32_t sample_rate,
+                           dsp_arena_t *arena)
+{
+    dsp_chain_t *c = (dsp_chain_t *)arena_take(arena, sizeof(dsp_chain_t));
+    uint32_t num_steps = 0;
+    uint32_t used_mask = 0;
+    static const vcard_insert_type_t kinds[] = {
+        VCARD_INSERT_GAIN, VCARD_INSERT_EQ, VCARD_INSERT_DELAY, VCARD_INSERT_METER
+    };
+
+    for (uint32_t i = 0; i < chain->num_inserts; i++) {
+        used_mask |= chain->inserts[i].channel_mask;
+    }
+
+    // Count steps first so the step array sits before the items
+    for (uint32_t d = 0; d <= max_depth; d++) {
+        for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+            for (uint32_t i = 0; i < chain->num_inserts; i++) {
+                if (depth[i] == d && chain->inserts[i].type == kinds[k]) {
+                    num_steps++;
+                    break;
+                }
+            }
+        }
+        for (uint32_t i = 0; i < chain->num_inserts; i++) {
+            num_steps += depth[i] == d && chain->inserts[i].type == VCARD_INSERT_LIMITER;
+        }
+    }
+
+    dsp_step_t *steps = (dsp_step_t *)arena_take(arena, num_steps * sizeof(dsp_step_t));
+    if (c) {
+        memset(c, 0, sizeof(*c));
+        c->channels = channels;
+        c->used_mask = used_mask;
+        c->meter_rate = 1000.0f / ((float)DSP_CHAIN_METER_MS * (float)sample_rate);
+        c->num_steps = num_steps;
+        c->steps = steps;
+    }
+
+    num_steps = 0;
+    for (uint32_t d = 0; d <= max_depth; d++) {
+        // Inserts of one kind at one depth are on disjoint channels: one step
+        for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+            uint32_t lanes = 0;
+            size_t item_size;
+            uint32_t items;
+            char *base;
+
+            for (uint32_t i = 0; i < chain->num_inserts; i++) {
+                if (depth[i] == d && chain->inserts[i].type == kinds[k]) {
+                    lanes += popcount32(chain->inserts[i].channel_mask);
+                }
+            }
+            if (!lanes) {
+                continue;
+            }
+            switch (kinds[k]) {
+            case VCARD_INSERT_GAIN:
+                item_size = sizeof(gain_lane_t);
+                items = lanes;
+                break;
+            case VCARD_INSERT_EQ:
+                item_size = sizeof(eq_group_t);
+                items = (lanes + DSP_LANES - 1) / DSP_LANES;
+                break;
+            case VCARD_INSERT_DELAY:
+                item_size = sizeof(delay_lane_t);
+                items = lanes;
+                break;
+            default:
+                item_size = sizeof(meter_lane_t);
+                items = lanes;
+                break;
+            }
+            base = (char *)arena_take(arena, items * item_size);
+            if (c) {
+                memset(base, 0, items * item_size);
+                steps[num_steps].kind = kinds[k];
+                steps[num_steps].count = items;
+                steps[num_steps].items = base;
+            }
+            num_steps++;
+
+            lanes = 0;
+            for (uint32_t i = 0; i < chain->num_inserts; i++) {
+                const vcard_insert_t *insert = &chain->inserts[i];
+                vcard_atomic_u32 *level = NULL;
+                float coefs[5] = { 0 };
+
+                if (depth[i] != d || insert->type != kinds[k]) {
+                    continue;
+                }
+                if (insert->type == VCARD_INSERT_EQ) {
+                    design_eq(insert, sample_rate, coefs);
+                } else if (insert->type == VCARD_INSERT_METER) {
+                    level = (vcard_atomic_u32 *)arena_take(
+                        arena, 2 * VCARD_MAX_CHANNELS * sizeof(vcard_atomic_u32));
+                    if (c) {
+                        memset(level, 0, 2 * VCARD_MAX_CHANNELS * sizeof(vcard_atomic_u32));
+                        c->meters[i] = level;
+                    }
+                }
+                for (uint32_t ch = 0; ch < channels; ch++) {
+                    if (!(insert->channel_mask & (1u << ch))) {
+                        continue;
+                    }
+                    if (insert->type == VCARD_INSERT_DELAY) {
+                        uint32_t length = (uint32_t)(insert->time_ms * sample_rate / 1000.0f + 0.5f);
+                        float *line = (float *)arena_take(arena, length * sizeof(float));
+                        if (c) {
+                            delay_lane_t *lane = &((delay_lane_t *)base)[lanes];
+                            memset(line, 0, length * sizeof(float));
+                            lane->channel = ch;
+                            lane->length = length;
+                            lane->line = line;
+                        }
+                    } else if (c) {
+                        switch (insert->type) {
+                        case VCARD_INSERT_GAIN: {
+                            gain_lane_t *lane = &((gain_lane_t *)base)[lanes];
+                            lane->channel = ch;
+                            lane->gain = db_to_linear(insert->gain_db);
+                            break;
+                        }
+                        case VCARD_INSERT_EQ: {
+                            eq_group_t *group = &((eq_group_t *)base)[lanes / DSP_LANES];
+                            uint32_t l = lanes % DSP_LANES;
+                            group->b0[l] = coefs[0];
+                            group->b1[l] = coefs[1];
+                            group->b2[l] = coefs[2];
+                            group->a1[l] = coefs[3];
+                            group->a2[l] = coefs[4];
+                            group->channels[l] = ch;
+                            group->lanes = l + 1;
+                            break;
+                        }
+                        default: {
+                            meter_lane_t *lane = &((meter_lane_t *)base)[lanes];
+                            lane->channel = ch;
+                            lane->level = level + 2 * ch;
+                            break;
+                        }
+                        }
+                    }
+                    lanes++;
+                }
+            }
+        }
+
+        for (uint32_t i = 0; i < chain->num_inserts; i++) {
+            const vcard_insert_t *insert = &chain->inserts[i];
+            limiter_t *limiter;
+
+            if (depth[i] != d || insert->type != VCARD_INSERT_LIMITER) {
+                continue;
+            }
+            limiter = (limiter_t *)arena_take(arena, sizeof(limiter_t));
+            if (c) {
+                memset(limiter, 0, sizeof(*limiter));
+                for (uint32_t ch = 0; ch < channels; ch++) {
+                    if (insert->channel_mask & (1u << ch)) {
+                        limiter->channels[limiter->count++] = ch;
+                    }
+                }
+                limiter->ceiling = db_to_linear(insert->gain_db);
+                limiter->release = expf(-1000.0f / (insert->time_ms * (float)sample_rate));
+                limiter->gain = 1.0f;
+                steps[num_steps].kind = VCARD_INSERT_LIMITER;
+                steps[num_steps].count = 1;
+                steps[num_steps].items = limiter;
+            }
+            num_steps++;
+        }
+    }
+
+    for (uint32_t ch = 0; ch < channels; ch++) {
+        if (used_mask & (1u << ch)) {
+            float *scratch = (float *)arena_take(arena, DSP_CHAIN_BLOCK * sizeof(float));
+            if (c) {
+                c->scratch[ch] = scratch;
+            }
+        }
+    }
+    return c;
+}
+
+int dsp_chain_build(const vcard_insert_chain_t *chain, uint32_t channels,
+                    uint32_t sample_rate, dsp_chain_t **out)
+{
+    uint32_t depth[VCARD_MAX_INSERTS];
+    uint32_t max_depth = 0;
+    dsp_arena_t arena = { NULL, 0 };
+    int result;
+
+    if (!out || sample_rate == 0) {
+        return VCARD_ERROR_INVALID;
+    }
+    *out = NULL;
+    result = dsp_chain_validate(chain, channels);
+    if (result != VCARD_SUCCESS || chain->num_inserts == 0) {
+        return result;
+    }
+
+    for (uint32_t j = 0; j < chain->num_inserts; j++) {
+        depth[j] = 0;
+        for (uint32_t i = 0; i < j; i++) {
+            if ((chain->inserts[i].channel_mask & chain->inserts[j].channel_mask) &&
+                depth[i] + 1 > depth[j]) {
+                depth[j] = depth[i] + 1;
+            }
+        }
+        if (depth[j] > max_depth) {
+            max_depth = depth[j];
+        }
+    }
+
+    layout(chain, depth, max_depth, channels, sample_rate, &arena);
+    arena.base = (char *)malloc(arena.used);
+    if (!arena.base) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    arena.used = 0;
+    *out = layout(chain, depth, max_depth, channels, sample_rate, &arena);
+    return VCARD_SUCCESS;
+}
+
+void dsp_chain_free(dsp_chain_t *chain)
+{
+    // The chain is the head of its arena
+    free(chain);
+}
+
+static void flush_state(float *z)
+{
+    for (uint32_t l = 0; l < DSP_LANES; l++) {
+        if (fabsf(z[l]) < DSP_STATE_FLOOR) {
+            z[l] = 0.0f;
+        }
+    }
+}
+
+static void eq_group_scalar(eq_group_t *g, float *const *io, uint32_t frames)
+{
+    for (uint32_t l = 0; l < g->lanes; l++) {
+        float *x = io[g->channels[l]];
+        float b0 = g->b0[l], b1 = g->b1[l], b2 = g->b2[l], a1 = g->a1[l], a2 = g->a2[l];
+        float z1 = g->z1[l], z2 = g->z2[l];
+
+        for (uint32_t i = 0; i < frames; i++) {
+            float in = x[i];
+            float y = b0 * in + z1;
+            z1 = b1 * in - a1 * y + z2;
+            z2 = b2 * in - a2 * y;
+            x[i] = y;
+        }
+        g->z1[l] = z1;
+        g->z2[l] = z2;
+    }
+}
+
+#if defined(DSP_HAVE_SSE2)
+#define DSP_BIQUAD4(v) do { \
+        __m128 y_ = _mm_add_ps(_mm_mul_ps(b0, v), z1); \
+        z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, v), _mm_mul_ps(a1, y_)), z2); \
+        z2 = _mm_sub_ps(_mm_mul_ps(b2, v), _mm_mul_ps(a2, y_)); \
+        v = y_; \
+    } while (0)
+
+/**
+ * Four channels in lockstep: each 4x4 tile is transposed so a register
+ * holds one frame across the lanes
+ */
+static void eq_group_simd(eq_group_t *g, float *const *io, uint32_t frames)
+{
+    float *x0 = io[g->channels[0]], *x1 = io[g->channels[1]];
+    float *x2 = io[g->channels[2]], *x3 = io[g->channels[3]];
+    __m128 b0 = _mm_loadu_ps(g->b0), b1 = _mm_loadu_ps(g->b1), b2 = _mm_loadu_ps(g->b2);
+    __m128 a1 = _mm_loadu_ps(g->a1), a2 = _mm_loadu_ps(g->a2);
+    __m128 z1 = _mm_loadu_ps(g->z1), z2 = _mm_loadu_ps(g->z2);
+    uint32_t i = 0;
+
+    for (; i + 4 <= frames; i += 4) {
+        __m128 r0 = _mm_loadu_ps(x0 + i), r1 = _mm_loadu_ps(x1 + i);
+        __m128 r2 = _mm_loadu_ps(x2 + i), r3 = _mm_loadu_ps(x3 + i);
+
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        DSP_BIQUAD4(r0);
+        DSP_BIQUAD4(r1);
+        DSP_BIQUAD4(r2);
+        DSP_BIQUAD4(r3);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(x0 + i, r0);
+        _mm_storeu_ps(x1 + i, r1);
+        _mm_storeu_ps(x2 + i, r2);
+        _mm_storeu_ps(x3 + i, r3);
+    }
+    for (; i < frames; i++) {
+        float out[DSP_LANES];
+        __m128 v = _mm_setr_ps(x0[i], x1[i], x2[i], x3[i]);
+
+        DSP_BIQUAD4(v);
+        _mm_storeu_ps(out, v);
+        x0[i] = out[0];
+        x1[i] = out[1];
+        x2[i] = out[2];
+        x3[i] = out[3];
+    }
+    _mm_storeu_ps(g->z1, z1);
+    _mm_storeu_ps(g->z2, z2);
+}
+#elif defined(DSP_HAVE_NEON)
+#define DSP_BIQUAD4(v) do { \
+        float32x4_t y_ = vmlaq_f32(z1, b0, v); \
+        z1 = vmlsq_f32(vmlaq_f32(z2, b1, v), a1, y_); \
+        z2 = vmlsq_f32(vmulq_f32(b2, v), a2, y_); \
+        v = y_; \
+    } while (0)
+
+static void transpose4(float32x4_t *r0, float32x4_t *r1, float32x4_t *r2, float32x4_t *r3)
+{
+    float32x4x2_t t01 = vtrnq_f32(*r0, *r1);
+    float32x4x2_t t23 = vtrnq_f32(*r2, *r3);
+
+    *r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+    *r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+    *r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+    *r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+
+/**
+ * Four channels in lockstep: each 4x4 tile is transposed so a register
+ * holds one frame across the lanes
+ */
+static void eq_group_simd(eq_group_t *g, float *const *io, uint32_t frames)
+{
+    float *x0 = io[g->channels[0]], *x1 = io[g->channels[1]];
+    float *x2 = io[g->channels[2]], *x3 = io[g->channels[3]];
+    float32x4_t b0 = vld1q_f32(g->b0), b1 = vld1q_f32(g->b1), b2 = vld1q_f32(g->b2);
+    float32x4_t a1 = vld1q_f32(g->a1), a2 = vld1q_f32(g->a2);
+    float32x4_t z1 = vld1q_f32(g->z1), z2 = vld1q_f32(g->z2);
+    uint32_t i = 0;
+
+    for (; i + 4 <= frames; i += 4) {
+        float32x4_t r0 = vld1q_f32(x0 + i), r1 = vld1q_f32(x1 + i);
+        float32x4_t r2 = vld1q_f32(x2 + i), r3 = vld1q_f32(x3 + i);
+
+        transpose4(&r0, &r1, &r2, &r3);
+        DSP_BIQUAD4(r0);
+        DSP_BIQUAD4(r1);
+        DSP_BIQUAD4(r2);
+        DSP_BIQUAD4(r3);
+        transpose4(&r0, &r1, &r2, &r3);
+        vst1q_f32(x0 + i, r0);
+        vst1q_f32(x1 + i, r1);
+        vst1q_f32(x2 + i, r2);
+        vst1q_f32(x3 + i, r3);
+    }
+    for (; i < frames; i++) {
+        float in[DSP_LANES] = { x0[i], x1[i], x2[i], x3[i] };
+        float32x4_t v = vld1q_f32(in);
+
+        DSP_BIQUAD4(v);
+        vst1q_f32(in, v);
+        x0[i] = in[0];
+        x1[i] = in[1];
+        x2[i] = in[2];
+        x3[i] = in[3];
+    }
+    vst1q_f32(g->z1, z1);
+    vst1q_f32(g->z2, z2);
+}
+#endif
+
+static void run_eq(eq_group_t *groups, uint32_t count, float *const *io, uint32_t frames)
+{
+    for (uint32_t n = 0; n < count; n++) {
+        eq_group_t *g = &groups[n];
+
+#if defined(DSP_HAVE_SSE2) || defined(DSP_HAVE_NEON)
+        if (g->lanes == DSP_LANES) {
+            eq_group_simd(g, io, frames);
+        } else {
+            eq_group_scalar(g, io, frames);
+        }
+#else
+        eq_group_scalar(g, io, frames);
+#endif
+        flush_state(g->z1);
+        flush_state(g->z2);
+    }
+}
+
+static void run_delay(delay_lane_t *lanes, uint32_t count, float *const *io, uint32_t frames)
+{
+    for (uint32_t n = 0; n < count; n++) {
+        delay_lane_t *lane = &lanes[n];
+        float *x = io[lane->channel];
+
+        if (!lane->length) {
+            continue;
+        }
+        // Swap the block with the line: out comes the audio from length frames ago
+        for (uint32_t done = 0; done < frames; ) {
+            uint32_t run = lane->length - lane->pos;
+            float *line = lane->line + lane->pos;
+
+            if (run > frames - done) {
+                run = frames - done;
+            }
+            for (uint32_t i = 0; i < run; i++) {
+                float t = line[i];
+                line[i] = x[done + i];
+                x[done + i] = t;
+            }
+            done += run;
+            lane->pos += run;
+            if (lane->pos == lane->length) {
+                lane->pos = 0;
+            }
+        }
+    }
+}
+
+static void run_meter(meter_lane_t *lanes, uint32_t count, float *const *io, uint32_t frames,
+                      float decay)
+{
+    for (uint32_t n = 0; n < count; n++) {
+        meter_lane_t *lane = &lanes[n];
+        const float *x = io[lane->channel];
+        float peak = 0.0f, sum = 0.0f;
+
+        for (uint32_t i = 0; i < frames; i++) {
+            float a = fabsf(x[i]);
+            peak = a > peak ? a : peak;
+            sum += x[i] * x[i];
+        }
+        lane->peak *= decay;
+        if (peak > lane->peak) {
+            lane->peak = peak;
+        }
+        lane->ms = sum / frames + decay * (lane->ms - sum / frames);
+        vcard_atomic_store_relaxed_u32(&lane->level[0], vcard_telemetry_float_bits(lane->peak));
+        vcard_atomic_store_relaxed_u32(&lane->level[1],
+                                       vcard_telemetry_float_bits(sqrtf(lane->ms)));
+    }
+}
+
+static void run_limiter(limiter_t *limiter, float *const *io, uint32_t frames)
+{
+    float gain = limiter->gain;
+
+    for (uint32_t i = 0; i < frames; i++) {
+        float peak = 0.0f, target = 1.0f;
+
+        for (uint32_t c = 0; c < limiter->count; c++) {
+            float a = fabsf(io[limiter->channels[c]][i]);
+            peak = a > peak ? a : peak;
+        }
+        if (peak > limiter->ceiling) {
+            target = limiter->ceiling / peak;
+        }
+        // Down at once, back up gradually; never above target, so never over the ceiling
+        gain = target < gain ? target : target - (target - gain) * limiter->release;
+        for (uint32_t c = 0; c < limiter->count; c++) {
+            io[limiter->channels[c]][i] *= gain;
+        }
+    }
+    limiter->gain = gain;
+}
+
+void dsp_chain_process(dsp_chain_t *chain, float *const *buffers, uint32_t frames)
+{
+    float *io[VCARD_MAX_CHANNELS];
+
+    for (uint32_t done = 0; done < frames; ) {
+        uint32_t n = frames - done;
+        float decay;
+
+        if (n > DSP_CHAIN_BLOCK) {
+            n = DSP_CHAIN_BLOCK;
+        }
+        for (uint32_t ch = 0; ch < chain->channels; ch++) {
+            if (!(chain->used_mask & (1u << ch))) {
+                continue;
+            }
+            if (buffers[ch]) {
+                io[ch] = buffers[ch] + done;
+            } else {
+                memset(chain->scratch[ch], 0, n * sizeof(float));
+                io[ch] = chain->scratch[ch];
+            }
+        }
+        decay = expf(-(float)n * chain->meter_rate);
+
+        for (uint32_t s = 0; s < chain->num_steps; s++) {
+            dsp_step_t *step = &chain->steps[s];
+
+            switch (step->kind) {
+            case VCARD_INSERT_GAIN:
+                for (uint32_t l = 0; l < step->count; l++) {
+                    const gain_lane_t *lane = &((const gain_lane_t *)step->items)[l];
+                    float *x = io[lane->channel];
+                    for (uint32_t i = 0; i < n; i++) {
+                        x[i] *= lane->gain;
+                    }
+                }
+                break;
+            case VCARD_INSERT_EQ:
+                run_eq((eq_group_t *)step->items, step->count, io, n);
+                break;
+            case VCARD_INSERT_DELAY:
+                run_delay((delay_lane_t *)step->items, step->count, io, n);
+                break;
+            case VCARD_INSERT_METER:
+                run_meter((meter_lane_t *)step->items, step->count, io, n, decay);
+                break;
+            case VCARD_INSERT_LIMITER:
+                run_limiter((limiter_t *)step->items, io, n);
+                break;
+            }
+        }
+        done += n;
+    }
+}
+
+int dsp_chain_meter(const dsp_chain_t *chain, uint32_t insert, vcard_meter_t *levels)
+{
+    const vcard_atomic_u32 *level;
+
+    if (!chain || !levels || insert >= VCARD_MAX_INSERTS || !chain->meters[insert]) {
+        return VCARD_ERROR_INVALID;
+    }
+    level = chain->meters[insert];
+    for (uint32_t ch = 0; ch < VCARD_MAX_CHANNELS; ch++) {
+        levels[ch].peak = vcard_telemetry_bits_float(
+            vcard_atomic_load_relaxed_u32(&level[2 * ch]));
+        levels[ch].rms = vcard_telemetry_bits_float(
+            vcard_atomic_load_relaxed_u32(&level[2 * ch + 1]));
+    }
+    return VCARD_SUCCESS;
+}
+
+uint32_t dsp_chain_steps(const dsp_chain_t *chain)
+{
+    return chain ? chain->num_steps : 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * Virtual Sound Card - Insert Chain Processor
+ *
+ * Runs a vcard_insert_chain_t (gain, EQ, delay, meter, limiter) in place
+ * on planar audio. The chain is compiled on the control thread into a
+ * flat array of steps: each insert waits only for the earlier inserts
+ * that share one of its channels, so inserts are scheduled by dependency
+ * depth, and inserts of the same kind at the same depth (always on
+ * disjoint channels) run as one step. EQ steps filter four channels at a
+ * time in SIMD lanes, each lane with its own coefficients. Steps, state,
+ * delay lines and scratch are carved from one allocation made at build
+ * time; processing never allocates, locks or blocks.
+ */
+
+#ifndef DSP_CHAIN_H
+#define DSP_CHAIN_H
+
+#include <stdint.h>
+#include "vcard.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frames processed per step pass; bounds the scratch for NULL channels */
+#define DSP_CHAIN_BLOCK 256
+
+/* Meter ballistics: peak release and RMS averaging time */
+#define DSP_CHAIN_METER_MS 300
+
+typedef struct dsp_chain dsp_chain_t;
+
+/**
+ * Check a chain against a channel count
+ *
+ * @param chain Insert chain
+ * @param channels Channels the chain will process
+ * @return 0 if valid, VCARD_ERROR_INVALID otherwise
+ */
+int dsp_chain_validate(const vcard_insert_chain_t *chain, uint32_t channels);
+
+/**
+ * Compile a chain for a sample rate (control thread)
+ *
+ * @param chain Validated insert chain
+ * @param channels Channels the chain will process
+ * @param sample_rate Sample rate, for EQ coefficients and delay lengths
+ * @param out Output parameter for the compiled chain (NULL for an empty chain)
+ * @return 0 on success, error code on failure
+ */
+int dsp_chain_build(const vcard_insert_chain_t *chain, uint32_t channels,
+                    uint32_t sample_rate, dsp_chain_t **out);
+
+/**
+ * Free a compiled chain; NULL is ignored
+ */
+void dsp_chain_free(dsp_chain_t *chain);
+
+/**
+ * Process planar audio in place (audio thread)
+ *
+ * @param chain Compiled chain
+ * @param buffers channels buffers; NULL entries are processed as silence
+ * @param frames Number of frames
+ */
+void dsp_chain_process(dsp_chain_t *chain, float *const *buffers, uint32_t frames);
+
+/**
+ * Read a meter insert's levels (any thread, while the chain exists)
+ *
+ * @param chain Compiled chain
+ * @param insert Index of the insert in the chain
+ * @param levels Output array of VCARD_MAX_CHANNELS levels
+ * @return 0 on success, VCARD_ERROR_INVALID if the insert is not a meter
+ */
+int dsp_chain_meter(const dsp_chain_t *chain, uint32_t insert, vcard_meter_t *levels);
+
+/**
+ * Number of steps the chain was compiled into
+ */
+uint32_t dsp_chain_steps(const dsp_chain_t *chain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DSP_CHAIN_H */
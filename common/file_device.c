@@ -0,0 +1,316 @@
+/**
+ * Virtual Sound Card - File Device Implementation
+ */
+
+#include "file_device.h"
+#include <string.h>
+
+#define FILE_DEVICE_MIN_IDLE_US 500
+
+/* Plane of one channel within a queue block */
+static float *block_plane(void *block, uint32_t channel)
+{
+    return (float *)block + (size_t)channel * FILE_DEVICE_BLOCK_FRAMES;
+}
+
+/**
+ * Device -> queue (recording pump thread)
+ */
+static void record_pump(void *arg)
+{
+    file_device_t *fd = (file_device_t *)arg;
+    float *planes[VCARD_MAX_CHANNELS] = { NULL };
+    float *const no_planes[VCARD_MAX_CHANNELS] = { NULL };
+    void *block = NULL;
+    uint32_t fill = 0;
+    int dropping = 0;
+
+    while (vcard_atomic_load_acquire_u32(&fd->running)) {
+        uint64_t start = vcard_time_ns();
+        size_t got = 0;
+
+        if (!block) {
+            block = block_queue_write_begin(&fd->queue);
+            fill = 0;
+        }
+        if (block) {
+            for (uint32_t ch = 0; ch < fd->channels; ch++) {
+                planes[ch] = block_plane(block, ch) + fill;
+            }
+            vcard_read_audio(fd->device_id, planes, FILE_DEVICE_BLOCK_FRAMES - fill, &got);
+            fill += (uint32_t)got;
+            if (fill == FILE_DEVICE_BLOCK_FRAMES) {
+                block_queue_write_commit(&fd->queue, fill);
+                block = NULL;
+            }
+            dropping = 0;
+        } else {
+            // Every block is waiting for the disk: keep the device moving
+            vcard_read_audio(fd->device_id, no_planes, fd->period_frames, &got);
+            if (got) {
+                vcard_atomic_fetch_add_u64(&fd->dropped_frames, got);
+                if (!dropping) {
+                    vcard_report_xrun(fd->device_id);
+                    dropping = 1;
+                }
+            }
+        }
+
+        if (got) {
+            vcard_report_period(fd->device_id, (uint32_t)got, vcard_time_ns() - start);
+        } else {
+            vcard_sleep_us(fd->idle_us);
+        }
+    }
+
+    if (block && fill) {
+        block_queue_write_commit(&fd->queue, fill);
+    }
+    vcard_atomic_store_release_u32(&fd->pump_done, 1);
+}
+
+/**
+ * Queue -> file (recording I/O thread)
+ */
+static void record_io(void *arg)
+{
+    file_device_t *fd = (file_device_t *)arg;
+    const float *planes[VCARD_MAX_CHANNELS];
+
+    for (;;) {
+        // Read the flag first so a block committed just before it is not missed
+        uint32_t done = vcard_atomic_load_acquire_u32(&fd->pump_done);
+        uint32_t frames;
+        const void *block = block_queue_read_begin(&fd->queue, &frames);
+
+        if (!block) {
+            if (done) {
+                break;
+            }
+            vcard_sleep_us(fd->idle_us);
+            continue;
+        }
+
+        for (uint32_t ch = 0; ch < fd->channels; ch++) {
+            planes[ch] = block_plane((void *)block, ch);
+        }
+        if (!fd->io_error) {
+            fd->io_error = wav_writer_write_planar(&fd->writer, planes, frames);
+        }
+        vcard_atomic_fetch_add_u64(&fd->frames, frames);
+        block_queue_read_commit(&fd->queue);
+    }
+}
+
+/**
+ * Read the next block from the file into the queue (playing)
+ *
+ * @return 1 if a block was queued or the file ended, 0 if no block was free
+ */
+static int play_fill(file_device_t *fd)
+{
+    float *planes[WAV_MAX_CHANNELS] = { NULL };
+    void *block = block_queue_write_begin(&fd->queue);
+    size_t got;
+
+    if (!block) {
+        return 0;
+    }
+    for (uint32_t ch = 0; ch < fd->file_channels && ch < fd->channels; ch++) {
+        planes[ch] = block_plane(block, ch);
+    }
+    got = wav_reader_read_planar(&fd->reader, planes, FILE_DEVICE_BLOCK_FRAMES);
+    if (got) {
+        block_queue_write_commit(&fd->queue, (uint32_t)got);
+        vcard_atomic_fetch_add_u64(&fd->frames, got);
+    }
+    if (got < FILE_DEVICE_BLOCK_FRAMES) {
+        vcard_atomic_store_release_u32(&fd->eof, 1);
+    }
+    return 1;
+}
+
+/**
+ * File -> queue (playing I/O thread)
+ */
+static void play_io(void *arg)
+{
+    file_device_t *fd = (file_device_t *)arg;
+
+    while (vcard_atomic_load_acquire_u32(&fd->running) &&
+           !vcard_atomic_load_relaxed_u32(&fd->eof)) {
+        if (!play_fill(fd)) {
+            vcard_sleep_us(fd->idle_us);
+        }
+    }
+}
+
+/**
+ * Queue -> device (playing pump thread)
+ */
+static void play_pump(void *arg)
+{
+    file_device_t *fd = (file_device_t *)arg;
+    const float *planes[VCARD_MAX_CHANNELS] = { NULL };
+    const void *block = NULL;
+    uint32_t frames = 0;
+    uint32_t pos = 0;
+    int starved = 0;
+
+    while (vcard_atomic_load_acquire_u32(&fd->running)) {
+        uint64_t start = vcard_time_ns();
+        size_t written = 0;
+
+        if (!block) {
+            uint32_t eof = vcard_atomic_load_acquire_u32(&fd->eof);
+
+            block = block_queue_read_begin(&fd->queue, &frames);
+            pos = 0;
+            if (!block) {
+                if (eof) {
+                    vcard_atomic_store_release_u32(&fd->finished, 1);
+                    break;
+                }
+                if (!starved) {
+                    vcard_atomic_fetch_add_u32(&fd->underruns, 1);
+                    vcard_report_xrun(fd->device_id);
+                    starved = 1;
+                }
+                vcard_sleep_us(fd->idle_us);
+                continue;
+            }
+            starved = 0;
+        }
+
+        for (uint32_t ch = 0; ch < fd->channels; ch++) {
+            planes[ch] = ch < fd->file_channels ?
+                         block_plane((void *)block, ch) + pos : NULL;
+        }
+        vcard_write_audio(fd->device_id, planes, frames - pos, &written);
+        pos += (uint32_t)written;
+        if (pos == frames) {
+            block_queue_read_commit(&fd->queue);
+            block = NULL;
+        }
+
+        if (written) {
+            vcard_report_period(fd->device_id, (uint32_t)written, vcard_time_ns() - start);
+        } else {
+            vcard_sleep_us(fd->idle_us);
+        }
+    }
+}
+
+int file_device_start(file_device_t *fd, int device_id, const char *path,
+                      file_device_mode_t mode, sine_format_t format,
+                      wav_container_t container)
+{
+    vcard_config_t config;
+    uint64_t idle_us;
+    int result;
+
+    memset(fd, 0, sizeof(*fd));
+    if (mode != FILE_DEVICE_RECORD && mode != FILE_DEVICE_PLAY) {
+        return VCARD_ERROR_INVALID;
+    }
+    result = vcard_get_config(device_id, &config);
+    if (result != VCARD_SUCCESS) {
+        return result;
+    }
+
+    fd->device_id = device_id;
+    fd->mode = mode;
+    fd->period_frames = config.buffer_size;
+    idle_us = (uint64_t)config.buffer_size * 1000000 / config.sample_rate / 4;
+    fd->idle_us = idle_us < FILE_DEVICE_MIN_IDLE_US ? FILE_DEVICE_MIN_IDLE_US :
+                                                      (uint32_t)idle_us;
+
+    if (mode == FILE_DEVICE_RECORD) {
+        fd->channels = config.channels_in;
+        fd->file_channels = config.channels_in;
+        result = wav_writer_open(&fd->writer, path, fd->channels, config.sample_rate,
+                                 format, container);
+    } else {
+        fd->channels = config.channels_out;
+        result = wav_reader_open(&fd->reader, path, WAV_READER_MMAP);
+        if (result == VCARD_SUCCESS && fd->reader.sample_rate != config.sample_rate) {
+            wav_reader_close(&fd->reader);
+            result = VCARD_ERROR_INVALID;
+        }
+        fd->file_channels = fd->reader.channels;
+    }
+    if (result != VCARD_SUCCESS) {
+        return result;
+    }
+
+    result = block_queue_init(&fd->queue, FILE_DEVICE_BLOCKS,
+                              (size_t)fd->channels * FILE_DEVICE_BLOCK_FRAMES * sizeof(float));
+    if (result != VCARD_SUCCESS) {
+        goto fail_file;
+    }
+
+    if (mode == FILE_DEVICE_PLAY) {
+        // Start with a full queue so the first periods never wait for the disk
+        while (!vcard_atomic_load_relaxed_u32(&fd->eof) && play_fill(fd)) {
+        }
+    }
+
+    vcard_atomic_store_release_u32(&fd->running, 1);
+    if (vcard_thread_create(&fd->io_thread, mode == FILE_DEVICE_RECORD ? record_io : play_io,
+                            fd) != 0) {
+        result = VCARD_ERROR_NO_MEMORY;
+        goto fail_queue;
+    }
+    if (vcard_thread_create(&fd->pump_thread,
+                            mode == FILE_DEVICE_RECORD ? record_pump : play_pump, fd) != 0) {
+        vcard_atomic_store_release_u32(&fd->running, 0);
+        vcard_atomic_store_release_u32(&fd->pump_done, 1);
+        vcard_thread_join(&fd->io_thread);
+        result = VCARD_ERROR_NO_MEMORY;
+        goto fail_queue;
+    }
+    return VCARD_SUCCESS;
+
+fail_queue:
+    block_queue_free(&fd->queue);
+fail_file:
+    if (mode == FILE_DEVICE_RECORD) {
+        wav_writer_close(&fd->writer);
+    } else {
+        wav_reader_close(&fd->reader);
+    }
+    return result;
+}
+
+int file_device_stop(file_device_t *fd)
+{
+    int result;
+
+    vcard_atomic_store_release_u32(&fd->running, 0);
+    vcard_thread_join(&fd->pump_thread);
+    vcard_thread_join(&fd->io_thread);     // Recording: drains the queue first
+
+    result = fd->io_error;
+    if (fd->mode == FILE_DEVICE_RECORD) {
+        int closed = wav_writer_close(&fd->writer);
+        if (result == VCARD_SUCCESS) {
+            result = closed;
+        }
+    } else {
+        wav_reader_close(&fd->reader);
+    }
+    block_queue_free(&fd->queue);
+    return result;
+}
+
+int file_device_finished(file_device_t *fd)
+{
+    return (int)vcard_atomic_load_acquire_u32(&fd->finished);
+}
+
+void file_device_get_stats(file_device_t *fd, file_device_stats_t *stats)
+{
+    stats->frames = vcard_atomic_load_relaxed_u64(&fd->frames);
+    stats->dropped_frames = vcard_atomic_load_relaxed_u64(&fd->dropped_frames);
+    stats->underruns = vcard_atomic_load_relaxed_u32(&fd->underruns);
+}
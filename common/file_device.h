@@ -0,0 +1,128 @@
+/**
+ * Virtual Sound Card - File Device
+ *
+ * Connects a vcard device to a WAV/RF64/W64 file, so a session can be
+ * recorded to disk or a file played into a device without an audio
+ * backend. Two threads are involved:
+ *  - the pump thread drives the device in place of a backend, moving one
+ *    period at a time between the device and a queue of planar blocks;
+ *  - the I/O thread moves whole blocks between the queue and the file.
+ *
+ * Disk latency only reaches the device once every block is in flight.
+ * When recording, the pump then discards audio and counts the dropped
+ * frames; when playing, it counts an underrun and the device's own rings
+ * run dry. Both are reported to the device as xruns.
+ */
+
+#ifndef FILE_DEVICE_H
+#define FILE_DEVICE_H
+
+#include <stdint.h>
+#include "vcard.h"
+#include "vcard_atomic.h"
+#include "vcard_thread.h"
+#include "block_queue.h"
+#include "wav_file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FILE_DEVICE_BLOCK_FRAMES 8192        /* Frames per disk transfer */
+#define FILE_DEVICE_BLOCKS 8                 /* Blocks between pump and disk */
+
+/**
+ * Direction of a file device
+ */
+typedef enum {
+    FILE_DEVICE_RECORD = 0,  /* Device input channels -> file */
+    FILE_DEVICE_PLAY         /* File -> device output channels */
+} file_device_mode_t;
+
+/**
+ * File device statistics
+ */
+typedef struct {
+    uint64_t frames;          /* Frames written to or read from the file */
+    uint64_t dropped_frames;  /* Recording: frames discarded for lack of a block */
+    uint32_t underruns;       /* Playing: times the pump found the queue empty */
+} file_device_stats_t;
+
+/**
+ * File device state
+ */
+typedef struct {
+    int device_id;
+    file_device_mode_t mode;
+    uint32_t channels;                   /* Device channels in use */
+    uint32_t file_channels;              /* Channels in the file */
+    uint32_t period_frames;              /* Device buffer size */
+    uint32_t idle_us;                    /* Pump sleep when nothing moved */
+    wav_writer_t writer;
+    wav_reader_t reader;
+    block_queue_t queue;
+    vcard_thread_t pump_thread;
+    vcard_thread_t io_thread;
+    int io_error;                        /* First file error (I/O thread) */
+
+    vcard_atomic_u32 running;
+    vcard_atomic_u32 pump_done;          /* Recording: last block committed */
+    vcard_atomic_u32 eof;                /* Playing: last block queued */
+    vcard_atomic_u32 finished;           /* Playing: whole file sent to the device */
+    vcard_atomic_u32 underruns;
+    vcard_atomic_u64 frames;
+    vcard_atomic_u64 dropped_frames;
+} file_device_t;
+
+/**
+ * Start recording a device to a file or playing a file into it
+ *
+ * Recording captures the device's channels_in input channels. Playing
+ * sends file channel N to output channel N; outputs beyond the file's
+ * channels get silence and file channels beyond channels_out are skipped.
+ * The file's sample rate must match the device's.
+ *
+ * @param fd File device to start
+ * @param device_id Device to drive (no other backend may drive it)
+ * @param path File to create (recording) or open (playing)
+ * @param mode FILE_DEVICE_RECORD or FILE_DEVICE_PLAY
+ * @param format Sample format of a recording (ignored when playing)
+ * @param container Container of a recording (ignored when playing)
+ * @return 0 on success, VCARD_ERROR_* on failure
+ */
+int file_device_start(file_device_t *fd, int device_id, const char *path,
+                      file_device_mode_t mode, sine_format_t format,
+                      wav_container_t container);
+
+/**
+ * Stop the threads and close the file
+ *
+ * A recording is flushed first, including a final partial block.
+ *
+ * @param fd File device
+ * @return 0 on success, VCARD_ERROR_IO if the file could not be written
+ */
+int file_device_stop(file_device_t *fd);
+
+/**
+ * Check whether playback has sent the whole file to the device
+ *
+ * @param fd File device
+ * @return 1 once the last frame is in the device, 0 otherwise (always 0
+ *         when recording)
+ */
+int file_device_finished(file_device_t *fd);
+
+/**
+ * Get statistics (any thread)
+ *
+ * @param fd File device
+ * @param stats Output parameter for statistics
+ */
+void file_device_get_stats(file_device_t *fd, file_device_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FILE_DEVICE_H */
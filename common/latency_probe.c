@@ -0,0 +1,398 @@
+/**
+ * Round-Trip Latency Probe Implementation
+ *
+ * The MLS has a flat spectrum and a single sharp autocorrelation peak, so
+ * the normalized cross-correlation against it finds a burst through gain
+ * changes, polarity inversion and moderate noise, and a parabola through
+ * the peak and its neighbours places it to a fraction of a sample. The
+ * correlation runs over a contiguous window of the mirrored history.
+ */
+
+#include "latency_probe.h"
+#include "vcard.h"
+#include <string.h>
+#include <math.h>
+
+/* Order-7 MLS (x^7 + x^6 + 1), chip k is bit k: 1 = +amplitude */
+static const uint64_t mls_bits[2] = { 0x5f2b9a278a18207full, 0x2a6774b1bdad9238ull };
+
+/* Normalized correlation a sync must exceed */
+#define PROBE_THRESHOLD 0.6
+
+/* Silence never triggers a sync: minimum mean power of the window */
+#define PROBE_MIN_POWER 1e-8
+
+/* Render chunk for the format-converting writer */
+#define PROBE_CHUNK 256
+
+static int mls_chip(uint32_t k)
+{
+    return (int)((mls_bits[k >> 6] >> (k & 63)) & 1u);
+}
+
+static uint8_t crc8(uint32_t value)
+{
+    uint8_t crc = 0;
+
+    for (int byte = 0; byte < 4; byte++) {
+        crc ^= (uint8_t)(value >> (8 * byte));
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (uint8_t)((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * Sync and code lengths at a sample rate: every chip at least partly covered
+ */
+static int probe_geometry(double sample_rate, double *chips_per_frame,
+                          uint32_t *sync_frames, uint32_t *code_frames)
+{
+    if (!(sample_rate >= LATENCY_PROBE_MIN_RATE && sample_rate <= LATENCY_PROBE_MAX_RATE)) {
+        return VCARD_ERROR_INVALID;
+    }
+    *chips_per_frame = LATENCY_PROBE_CHIP_RATE / sample_rate;
+    *sync_frames = (uint32_t)ceil(LATENCY_PROBE_SYNC_CHIPS / *chips_per_frame);
+    // Each code bit is two chips: high then low for a 1, low then high for a 0
+    *code_frames = (uint32_t)ceil(2 * LATENCY_PROBE_CODE_BITS / *chips_per_frame);
+    return VCARD_SUCCESS;
+}
+
+int latency_probe_init(latency_probe_t *p, double sample_rate,
+                       double interval_seconds, double amplitude)
+{
+    memset(p, 0, sizeof(*p));
+    if (probe_geometry(sample_rate, &p->chips_per_frame, &p->sync_frames,
+                       &p->code_frames) != VCARD_SUCCESS ||
+        !(amplitude > 0.0 && amplitude <= 1.0)) {
+        return VCARD_ERROR_INVALID;
+    }
+    p->sample_rate = sample_rate;
+    p->amplitude = (float)amplitude;
+    p->interval = (uint32_t)(interval_seconds * sample_rate);
+    // Leave the detector at least one burst length of quiet between bursts
+    if (!(interval_seconds < 3600.0) || p->interval < 2 * (p->sync_frames + p->code_frames)) {
+        return VCARD_ERROR_INVALID;
+    }
+    return VCARD_SUCCESS;
+}
+
+static float probe_sample(const latency_probe_t *p, uint32_t pos)
+{
+    uint32_t chip;
+
+    if (pos < p->sync_frames) {
+        chip = (uint32_t)(pos * p->chips_per_frame);
+        return mls_chip(chip) ? p->amplitude : -p->amplitude;
+    }
+    pos -= p->sync_frames;
+    if (pos < p->code_frames) {
+        chip = (uint32_t)(pos * p->chips_per_frame);
+        if (chip < 2 * LATENCY_PROBE_CODE_BITS) {
+            int bit = (int)((p->code >> (chip >> 1)) & 1u);
+            return (bit != 0) == ((chip & 1u) == 0) ? p->amplitude : -p->amplitude;
+        }
+    }
+    return 0.0f;
+}
+
+void latency_probe_render(latency_probe_t *p, float *buffer,
+                          size_t num_frames, uint64_t time_ns)
+{
+    for (size_t i = 0; i < num_frames; i++) {
+        if (p->pos == 0) {
+            uint64_t t = time_ns + (uint64_t)((double)i * 1e9 / p->sample_rate);
+            uint32_t stamp = (uint32_t)(t / 1000u);
+
+            p->code = stamp | (uint64_t)crc8(stamp) << 32;
+            p->bursts++;
+        }
+        buffer[i] = probe_sample(p, p->pos);
+        if (++p->pos == p->interval) {
+            p->pos = 0;
+        }
+    }
+}
+
+void latency_probe_write_interleaved(latency_probe_t *p, void *buffer,
+                                     size_t num_frames, unsigned int channels,
+                                     sine_format_t format, uint64_t time_ns)
+{
+    float chunk[PROBE_CHUNK];
+    size_t frame_bytes = sine_format_bytes(format) * channels;
+    uint8_t *out = (uint8_t *)buffer;
+
+    for (size_t done = 0; done < num_frames; done += PROBE_CHUNK) {
+        size_t n = num_frames - done < PROBE_CHUNK ? num_frames - done : PROBE_CHUNK;
+
+        latency_probe_render(p, chunk, n,
+                             time_ns + (uint64_t)((double)done * 1e9 / p->sample_rate));
+        sine_format_convert(chunk, n, out + done * frame_bytes, channels, format);
+    }
+}
+
+int latency_detector_init(latency_detector_t *d, double sample_rate)
+{
+    memset(d, 0, sizeof(*d));
+    if (probe_geometry(sample_rate, &d->chips_per_frame, &d->sync_frames,
+                       &d->code_frames) != VCARD_SUCCESS) {
+        return VCARD_ERROR_INVALID;
+    }
+    d->sample_rate = sample_rate;
+    for (uint32_t i = 0; i < d->sync_frames; i++) {
+        d->sync[i] = mls_chip((uint32_t)(i * d->chips_per_frame)) ? 1.0f : -1.0f;
+    }
+    d->sync_energy = d->sync_frames;
+    d->stats.min_us = HUGE_VAL;
+    return VCARD_SUCCESS;
+}
+
+static void stats_add(latency_stats_t *s, double latency_us)
+{
+    double bin = latency_us / LATENCY_PROBE_HISTOGRAM_US;
+
+    s->count++;
+    s->sum_us += latency_us;
+    s->sum_sq_us += latency_us * latency_us;
+    if (latency_us < s->min_us) {
+        s->min_us = latency_us;
+    }
+    if (latency_us > s->max_us) {
+        s->max_us = latency_us;
+    }
+    s->histogram[bin < LATENCY_PROBE_HISTOGRAM_BINS - 1 ?
+                 (uint32_t)bin : LATENCY_PROBE_HISTOGRAM_BINS - 1]++;
+}
+
+/**
+ * Dot product of the newest sync_frames samples with the MLS template
+ */
+static double correlate(const latency_detector_t *d)
+{
+    const float *x = d->history + d->head + 1;
+    float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    uint32_t n = d->sync_frames;
+    uint32_t i = 0;
+
+    // Four independent sums so the compiler can vectorize without reassociation
+    for (; i + 4 <= n; i += 4) {
+        acc[0] += x[i] * d->sync[i];
+        acc[1] += x[i + 1] * d->sync[i + 1];
+        acc[2] += x[i + 2] * d->sync[i + 2];
+        acc[3] += x[i + 3] * d->sync[i + 3];
+    }
+    for (; i < n; i++) {
+        acc[0] += x[i] * d->sync[i];
+    }
+    return (double)acc[0] + acc[1] + acc[2] + acc[3];
+}
+
+/**
+ * Decode the code behind a located sync and record its latency
+ *
+ * The code occupies the newest code_frames samples of the history.
+ */
+static int finish_burst(latency_detector_t *d)
+{
+    const float *x = d->history + d->head + 1 + (d->sync_frames - d->code_frames);
+    double bits[LATENCY_PROBE_CODE_BITS];
+    double offset;
+    double denom;
+    uint64_t code = 0;
+    int64_t start_ns;
+    uint32_t stamp;
+    uint32_t arrival_us;
+    uint32_t elapsed_us;
+
+    memset(bits, 0, sizeof(bits));
+    for (uint32_t i = 0; i < d->code_frames; i++) {
+        uint32_t chip = (uint32_t)(i * d->chips_per_frame);
+
+        if (chip < 2 * LATENCY_PROBE_CODE_BITS) {
+            bits[chip >> 1] += (chip & 1u) ? -x[i] : x[i];
+        }
+    }
+    for (int b = 0; b < LATENCY_PROBE_CODE_BITS; b++) {
+        if (bits[b] * d->polarity > 0.0) {
+            code |= 1ull << b;
+        }
+    }
+    stamp = (uint32_t)code;
+    if ((uint8_t)(code >> 32) != crc8(stamp)) {
+        d->stats.errors++;
+        return 0;
+    }
+
+    // Parabolic interpolation of the peak, then back to the first sync frame
+    denom = d->peak_before - 2.0 * d->peak + d->peak_after;
+    offset = denom < 0.0 ? 0.5 * (d->peak_before - d->peak_after) / denom : 0.0;
+    if (offset > 0.5 || offset < -0.5) {
+        offset = 0.0;
+    }
+    start_ns = (int64_t)d->peak_time_ns +
+               (int64_t)llround((offset - (double)(d->sync_frames - 1)) * 1e9 / d->sample_rate);
+
+    // Microsecond clocks compared modulo 2^32; a negative latency is no burst of ours
+    arrival_us = (uint32_t)((uint64_t)start_ns / 1000u);
+    elapsed_us = arrival_us - stamp;
+    if (elapsed_us >= 0x80000000u) {
+        d->stats.errors++;
+        return 0;
+    }
+    stats_add(&d->stats, elapsed_us + (double)((uint64_t)start_ns % 1000u) / 1000.0);
+    return 1;
+}
+
+/**
+ * Take one sample: correlate, track the peak, decode when the code is in
+ */
+static int push_sample(latency_detector_t *d, float x, uint64_t time_ns)
+{
+    uint32_t n = d->sync_frames;
+    float old = d->history[d->head];
+    double corr;
+    double power;
+    int found = 0;
+
+    // Once written, the newest n samples are history[head + 1 .. head + n]
+    d->history[d->head] = x;
+    d->history[d->head + n] = x;
+    if (d->head == n - 1) {
+        // Once per window, drop the rounding the running sum accumulates
+        d->energy = 0.0;
+        for (uint32_t i = n; i < 2 * n; i++) {
+            d->energy += (double)d->history[i] * d->history[i];
+        }
+    } else {
+        d->energy += (double)x * x - (double)old * old;
+    }
+
+    corr = correlate(d);
+    power = d->energy > 0.0 ? d->energy : 0.0;
+
+    if (!d->locked) {
+        if (power > PROBE_MIN_POWER * n &&
+            fabs(corr) > PROBE_THRESHOLD * sqrt(power * d->sync_energy)) {
+            d->locked = 1;
+            d->peak = fabs(corr);
+            d->peak_before = fabs(d->prev_corr);
+            d->peak_after = 0.0;
+            d->polarity = corr < 0.0 ? -1.0 : 1.0;
+            d->peak_frame = d->frame;
+            d->peak_time_ns = time_ns;
+        }
+    } else if (d->frame - d->peak_frame < 2 / d->chips_per_frame) {
+        // The peak settles within a chip; the code follows the sync
+        if (fabs(corr) > d->peak) {
+            d->peak_before = fabs(d->prev_corr);
+            d->peak = fabs(corr);
+            d->peak_after = 0.0;
+            d->polarity = corr < 0.0 ? -1.0 : 1.0;
+            d->peak_frame = d->frame;
+            d->peak_time_ns = time_ns;
+        } else if (d->frame == d->peak_frame + 1) {
+            d->peak_after = fabs(corr);
+        }
+    }
+    d->prev_corr = corr;
+    d->frame++;
+
+    if (d->locked && d->frame - d->peak_frame > d->code_frames) {
+        d->locked = 0;
+        found = finish_burst(d);
+    }
+    if (++d->head == n) {
+        d->head = 0;
+    }
+    return found;
+}
+
+int latency_detector_process(latency_detector_t *d, const float *samples,
+                             size_t num_frames, size_t stride,
+                             uint64_t time_ns)
+{
+    double frame_ns = 1e9 / d->sample_rate;
+    int found = 0;
+
+    for (size_t i = 0; i < num_frames; i++) {
+        uint64_t t = time_ns - (uint64_t)((double)(num_frames - 1 - i) * frame_ns);
+
+        found += push_sample(d, samples[i * stride], t);
+    }
+    return found;
+}
+
+int latency_detector_process_i16(latency_detector_t *d, const int16_t *samples,
+                                 size_t num_frames, size_t stride,
+                                 uint64_t time_ns)
+{
+    double frame_ns = 1e9 / d->sample_rate;
+    int found = 0;
+
+    for (size_t i = 0; i < num_frames; i++) {
+        uint64_t t = time_ns - (uint64_t)((double)(num_frames - 1 - i) * frame_ns);
+
+        found += push_sample(d, samples[i * stride] * (1.0f / 32768.0f), t);
+    }
+    return found;
+}
+
+void latency_stats_report(const latency_stats_t *stats, latency_report_t *report)
+{
+    memset(report, 0, sizeof(*report));
+    report->count = stats->count;
+    report->errors = stats->errors;
+    if (stats->count == 0) {
+        return;
+    }
+    report->min_us = stats->min_us;
+    report->max_us = stats->max_us;
+    report->mean_us = stats->sum_us / stats->count;
+    report->jitter_us = sqrt(fmax(stats->sum_sq_us / stats->count -
+                                  report->mean_us * report->mean_us, 0.0));
+
+    // Upper edge of the bin holding the 99th percentile
+    {
+        uint64_t target = (stats->count * 99 + 99) / 100;
+        uint64_t seen = 0;
+
+        report->p99_us = stats->max_us;
+        for (uint32_t b = 0; b < LATENCY_PROBE_HISTOGRAM_BINS - 1; b++) {
+            seen += stats->histogram[b];
+            if (seen >= target) {
+                report->p99_us = fmin((b + 1) * LATENCY_PROBE_HISTOGRAM_US, stats->max_us);
+                break;
+            }
+        }
+    }
+}
+
+uint32_t latency_stats_jitter_histogram(const latency_stats_t *stats,
+                                        uint32_t *bins, uint32_t num_bins,
+                                        double *bin_us)
+{
+    uint32_t first;
+    uint32_t last;
+    uint32_t per_bin;
+    uint32_t used;
+
+    *bin_us = LATENCY_PROBE_HISTOGRAM_US;
+    if (stats->count == 0 || num_bins == 0) {
+        return 0;
+    }
+
+    first = (uint32_t)fmin(stats->min_us / LATENCY_PROBE_HISTOGRAM_US,
+                           LATENCY_PROBE_HISTOGRAM_BINS - 1);
+    last = (uint32_t)fmin(stats->max_us / LATENCY_PROBE_HISTOGRAM_US,
+                          LATENCY_PROBE_HISTOGRAM_BINS - 1);
+    per_bin = (last - first) / num_bins + 1;
+    used = (last - first) / per_bin + 1;
+
+    memset(bins, 0, num_bins * sizeof(*bins));
+    for (uint32_t b = first; b <= last; b++) {
+        bins[(b - first) / per_bin] += stats->histogram[b];
+    }
+    *bin_us = per_bin * LATENCY_PROBE_HISTOGRAM_US;
+    return used;
+}
@@ -0,0 +1,221 @@
+/**
+ * Virtual Sound Card - Round-Trip Latency Probe
+ *
+ * Measures how long audio takes from the generator that renders it to the
+ * reader that receives it, as a replacement for the tone when tuning
+ * buffer sizes.
+ *
+ * The generator emits a burst every interval: a 127-chip maximum length
+ * sequence (MLS) for synchronisation, followed by a Manchester-coded 32-bit
+ * timestamp and its CRC-8. The timestamp is the microsecond time on the
+ * shared monotonic clock (vcard_time_ns()) at which the first sync sample
+ * was rendered. The reader cross-correlates its input against the MLS,
+ * locates the burst to a fraction of a sample, decodes the timestamp and
+ * subtracts it from the time the burst's first sample arrived.
+ *
+ * Both ends step time by one sample period within a buffer: the samples of
+ * a rendered buffer are due from the render time onward, and the samples of
+ * a received buffer arrived up to the receive time. The result is the
+ * generator-to-reader latency including every buffer in between. Chips
+ * are 1/12000 s long whatever the sample rate, so the two ends may run at
+ * different rates.
+ */
+
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sine_generator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LATENCY_PROBE_CHIP_RATE 12000.0      /* Sync chips per second */
+#define LATENCY_PROBE_SYNC_CHIPS 127         /* Order-7 MLS */
+#define LATENCY_PROBE_CODE_BITS 40           /* Timestamp and CRC-8 */
+#define LATENCY_PROBE_MIN_RATE 8000
+#define LATENCY_PROBE_MAX_RATE 192000
+#define LATENCY_PROBE_MAX_SYNC \
+    (LATENCY_PROBE_SYNC_CHIPS * (LATENCY_PROBE_MAX_RATE / 12000))
+#define LATENCY_PROBE_DEFAULT_INTERVAL 0.25  /* Seconds between bursts */
+
+/* Latency histogram: 100 us bins up to 409.6 ms, the last one open-ended */
+#define LATENCY_PROBE_HISTOGRAM_BINS 4096
+#define LATENCY_PROBE_HISTOGRAM_US 100.0
+
+/**
+ * Burst generator state
+ */
+typedef struct {
+    double sample_rate;
+    double chips_per_frame;
+    float amplitude;
+    uint32_t interval;      /* Frames from one burst to the next */
+    uint32_t sync_frames;
+    uint32_t code_frames;
+    uint32_t pos;           /* Frames into the current interval */
+    uint64_t code;          /* Timestamp and CRC of the current burst */
+    uint64_t bursts;        /* Bursts started */
+} latency_probe_t;
+
+/**
+ * Latencies measured so far
+ */
+typedef struct {
+    uint64_t count;         /* Bursts measured */
+    uint64_t errors;        /* Bursts found but failing the CRC */
+    double min_us;
+    double max_us;
+    double sum_us;
+    double sum_sq_us;
+    uint32_t histogram[LATENCY_PROBE_HISTOGRAM_BINS];
+} latency_stats_t;
+
+/**
+ * Summary of a latency_stats_t
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t errors;
+    double min_us;
+    double mean_us;
+    double p99_us;          /* Histogram resolution (100 us), at most max */
+    double max_us;
+    double jitter_us;       /* Standard deviation */
+} latency_report_t;
+
+/**
+ * Burst detector state for one channel
+ */
+typedef struct {
+    double sample_rate;
+    double chips_per_frame;
+    uint32_t sync_frames;
+    uint32_t code_frames;
+    double sync_energy;
+
+    /* Input history, written twice so the newest sync_frames are contiguous */
+    float history[2 * LATENCY_PROBE_MAX_SYNC];
+    uint32_t head;
+    double energy;          /* Sum of squares of the newest sync_frames */
+    uint64_t frame;         /* Frames received so far */
+
+    /* Correlation peak of the burst being received */
+    int locked;
+    double prev_corr;
+    double peak;
+    double peak_before;
+    double peak_after;
+    double polarity;
+    uint64_t peak_frame;
+    uint64_t peak_time_ns;  /* Arrival time of the peak frame */
+
+    latency_stats_t stats;
+    float sync[LATENCY_PROBE_MAX_SYNC];     /* MLS template at this rate */
+} latency_detector_t;
+
+/**
+ * Initialize a burst generator
+ *
+ * @param p Generator to initialize
+ * @param sample_rate Sample rate in Hz
+ * @param interval_seconds Time from one burst to the next
+ * @param amplitude Chip amplitude (0.0 to 1.0)
+ * @return 0 on success, VCARD_ERROR_INVALID on failure
+ */
+int latency_probe_init(latency_probe_t *p, double sample_rate,
+                       double interval_seconds, double amplitude);
+
+/**
+ * Render mono samples
+ *
+ * @param p Generator
+ * @param buffer Output buffer
+ * @param num_frames Number of samples to render
+ * @param time_ns vcard_time_ns() at which the first sample is rendered
+ */
+void latency_probe_render(latency_probe_t *p, float *buffer,
+                          size_t num_frames, uint64_t time_ns);
+
+/**
+ * Render interleaved samples, the same on every channel
+ *
+ * @param p Generator
+ * @param buffer Output buffer (num_frames * channels samples of the format)
+ * @param num_frames Number of frames to render
+ * @param channels Number of interleaved channels
+ * @param format Output sample format
+ * @param time_ns vcard_time_ns() at which the first frame is rendered
+ */
+void latency_probe_write_interleaved(latency_probe_t *p, void *buffer,
+                                     size_t num_frames, unsigned int channels,
+                                     sine_format_t format, uint64_t time_ns);
+
+/**
+ * Initialize a burst detector
+ *
+ * @param d Detector to initialize
+ * @param sample_rate Sample rate of the received audio in Hz
+ * @return 0 on success, VCARD_ERROR_INVALID on failure
+ */
+int latency_detector_init(latency_detector_t *d, double sample_rate);
+
+/**
+ * Feed received float samples
+ *
+ * @param d Detector
+ * @param samples First sample of the probed channel
+ * @param num_frames Number of samples
+ * @param stride Distance between consecutive samples
+ * @param time_ns vcard_time_ns() at which the last sample was received
+ * @return Number of bursts measured by this call
+ */
+int latency_detector_process(latency_detector_t *d, const float *samples,
+                             size_t num_frames, size_t stride,
+                             uint64_t time_ns);
+
+/**
+ * Feed received 16-bit samples
+ *
+ * @param d Detector
+ * @param samples First sample of the probed channel
+ * @param num_frames Number of samples
+ * @param stride Distance between consecutive samples
+ * @param time_ns vcard_time_ns() at which the last sample was received
+ * @return Number of bursts measured by this call
+ */
+int latency_detector_process_i16(latency_detector_t *d, const int16_t *samples,
+                                 size_t num_frames, size_t stride,
+                                 uint64_t time_ns);
+
+/**
+ * Summarize measured latencies
+ *
+ * @param stats Measurements
+ * @param report Receives count, min, mean, p99, max and jitter
+ */
+void latency_stats_report(const latency_stats_t *stats, latency_report_t *report);
+
+/**
+ * Histogram of latency above the minimum (jitter)
+ *
+ * Spreads the measured range over at most num_bins bins whose width is a
+ * multiple of LATENCY_PROBE_HISTOGRAM_US.
+ *
+ * @param stats Measurements
+ * @param bins Receives the count of each bin
+ * @param num_bins Maximum number of bins
+ * @param bin_us Receives the bin width in microseconds
+ * @return Number of bins filled (0 if nothing was measured)
+ */
+uint32_t latency_stats_jitter_histogram(const latency_stats_t *stats,
+                                        uint32_t *bins, uint32_t num_bins,
+                                        double *bin_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LATENCY_PROBE_H */
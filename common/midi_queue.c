@@ -0,0 +1,173 @@
+/**
+ * Lock-free SPSC MIDI Message Queue Implementation
+ */
+
+#include "midi_queue.h"
+#include "vcard.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Largest supported queue capacity (keeps index differences unambiguous) */
+#define MIDI_QUEUE_MAX_CAPACITY (1u << 24)
+
+/* Marks an entry whose payload is stored inline */
+#define MIDI_QUEUE_NO_SLOT UINT32_MAX
+
+static uint32_t round_up_pow2(uint32_t n)
+{
+    uint32_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+int midi_queue_init(midi_queue_t *q, uint32_t min_capacity,
+                    uint32_t sysex_slots, uint32_t sysex_slot_size)
+{
+    memset(q, 0, sizeof(*q));
+    if (min_capacity == 0 || min_capacity > MIDI_QUEUE_MAX_CAPACITY ||
+        sysex_slots > MIDI_QUEUE_MAX_CAPACITY ||
+        (sysex_slots > 0 && sysex_slot_size <= MIDI_QUEUE_INLINE_BYTES)) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    q->capacity = round_up_pow2(min_capacity);
+    q->mask = q->capacity - 1;
+    q->entries = (midi_queue_entry_t *)calloc(q->capacity, sizeof(midi_queue_entry_t));
+    if (!q->entries) {
+        midi_queue_free(q);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+
+    if (sysex_slots > 0) {
+        uint32_t free_capacity = round_up_pow2(sysex_slots);
+
+        q->sysex_slots = sysex_slots;
+        q->sysex_slot_size = sysex_slot_size;
+        q->free_mask = free_capacity - 1;
+        q->sysex_pool = (uint8_t *)malloc((size_t)sysex_slots * sysex_slot_size);
+        q->free_slots = (uint32_t *)malloc(free_capacity * sizeof(uint32_t));
+        if (!q->sysex_pool || !q->free_slots) {
+            midi_queue_free(q);
+            return VCARD_ERROR_NO_MEMORY;
+        }
+    }
+
+    midi_queue_reset(q);
+    return VCARD_SUCCESS;
+}
+
+void midi_queue_free(midi_queue_t *q)
+{
+    free(q->entries);
+    free(q->sysex_pool);
+    free(q->free_slots);
+    memset(q, 0, sizeof(*q));
+}
+
+void midi_queue_reset(midi_queue_t *q)
+{
+    for (uint32_t i = 0; i < q->sysex_slots; i++) {
+        q->free_slots[i] = i;
+    }
+    vcard_atomic_store_relaxed_u32(&q->write_index, 0);
+    vcard_atomic_store_relaxed_u32(&q->read_index, 0);
+    vcard_atomic_store_relaxed_u32(&q->dropped, 0);
+    q->free_read_index = 0;
+    vcard_atomic_store_release_u32(&q->free_write_index, q->sysex_slots);
+}
+
+int midi_queue_push(midi_queue_t *q, const uint8_t *message, size_t length,
+                    uint64_t frame)
+{
+    uint32_t w = vcard_atomic_load_relaxed_u32(&q->write_index);
+    uint32_t r = vcard_atomic_load_acquire_u32(&q->read_index);
+    midi_queue_entry_t *entry;
+
+    if (!message || length == 0 ||
+        (length > MIDI_QUEUE_INLINE_BYTES && length > q->sysex_slot_size)) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (w - r >= q->capacity) {
+        vcard_atomic_fetch_add_u32(&q->dropped, 1);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+
+    entry = &q->entries[w & q->mask];
+    entry->frame = frame;
+    entry->length = (uint32_t)length;
+
+    if (length <= MIDI_QUEUE_INLINE_BYTES) {
+        entry->slot = MIDI_QUEUE_NO_SLOT;
+        memcpy(entry->data, message, length);
+    } else {
+        // Take a slot returned by the consumer
+        uint32_t fw = vcard_atomic_load_acquire_u32(&q->free_write_index);
+        if (q->free_read_index == fw) {
+            vcard_atomic_fetch_add_u32(&q->dropped, 1);
+            return VCARD_ERROR_NO_MEMORY;
+        }
+        entry->slot = q->free_slots[q->free_read_index & q->free_mask];
+        q->free_read_index++;
+        memcpy(q->sysex_pool + (size_t)entry->slot * q->sysex_slot_size,
+               message, length);
+    }
+
+    vcard_atomic_store_release_u32(&q->write_index, w + 1);
+    return VCARD_SUCCESS;
+}
+
+int midi_queue_pop(midi_queue_t *q, uint64_t frame_limit,
+                   uint8_t *message, size_t max_length,
+                   size_t *length, uint64_t *frame)
+{
+    uint32_t r = vcard_atomic_load_relaxed_u32(&q->read_index);
+    uint32_t w = vcard_atomic_load_acquire_u32(&q->write_index);
+    const midi_queue_entry_t *entry;
+
+    *length = 0;
+    if (r == w) {
+        return 0;
+    }
+
+    entry = &q->entries[r & q->mask];
+    if (entry->frame >= frame_limit) {
+        return 0;
+    }
+    if (entry->length > max_length || !message) {
+        *length = entry->length;
+        return VCARD_ERROR_INVALID;
+    }
+
+    if (entry->slot == MIDI_QUEUE_NO_SLOT) {
+        memcpy(message, entry->data, entry->length);
+    } else {
+        uint32_t fw = vcard_atomic_load_relaxed_u32(&q->free_write_index);
+
+        memcpy(message, q->sysex_pool + (size_t)entry->slot * q->sysex_slot_size,
+               entry->length);
+        // Hand the slot back; the free ring can hold every slot, so it never overflows
+        q->free_slots[fw & q->free_mask] = entry->slot;
+        vcard_atomic_store_release_u32(&q->free_write_index, fw + 1);
+    }
+
+    *length = entry->length;
+    if (frame) {
+        *frame = entry->frame;
+    }
+    vcard_atomic_store_release_u32(&q->read_index, r + 1);
+    return 1;
+}
+
+uint32_t midi_queue_count(midi_queue_t *q)
+{
+    uint32_t w = vcard_atomic_load_acquire_u32(&q->write_index);
+    uint32_t r = vcard_atomic_load_acquire_u32(&q->read_index);
+    return w - r;
+}
+
+uint32_t midi_queue_dropped(midi_queue_t *q)
+{
+    return vcard_atomic_load_relaxed_u32(&q->dropped);
+}
@@ -0,0 +1,147 @@
+/**
+ * Lock-free Single-Producer/Single-Consumer MIDI Message Queue
+ *
+ * Fixed-capacity queue of timestamped MIDI messages between exactly one
+ * producer thread and one consumer thread. Short messages are stored
+ * inline in the queue entry; longer ones (sysex) are copied into a slot
+ * from a pool allocated at init time. Free slots travel back from the
+ * consumer to the producer through a second SPSC index ring, so neither
+ * side ever locks or allocates after midi_queue_init().
+ */
+
+#ifndef MIDI_QUEUE_H
+#define MIDI_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vcard_atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Messages up to this size are stored inline in the queue entry */
+#define MIDI_QUEUE_INLINE_BYTES 16
+
+/**
+ * Queue entry (32 bytes)
+ */
+typedef struct {
+    uint64_t frame;                      /* Timestamp in sample frames */
+    uint32_t length;                     /* Message length in bytes */
+    uint32_t slot;                       /* Sysex pool slot, or UINT32_MAX if inline */
+    uint8_t data[MIDI_QUEUE_INLINE_BYTES];
+} midi_queue_entry_t;
+
+/**
+ * Queue state
+ *
+ * Indices are free-running and wrap modulo 2^32; capacities are powers of
+ * two so positions are obtained with a mask.
+ */
+typedef struct {
+    /* Shared, read-only after midi_queue_init() */
+    midi_queue_entry_t *entries;
+    uint32_t capacity;
+    uint32_t mask;
+    uint8_t *sysex_pool;
+    uint32_t sysex_slots;
+    uint32_t sysex_slot_size;
+    uint32_t *free_slots;                /* Ring of free pool slot indices */
+    uint32_t free_mask;
+    char pad0[VCARD_CACHELINE];
+
+    /* Producer-owned line */
+    vcard_atomic_u32 write_index;
+    uint32_t free_read_index;            /* Next free slot to take */
+    vcard_atomic_u32 dropped;            /* Messages rejected (queue or pool full) */
+    char pad1[VCARD_CACHELINE - 3 * sizeof(uint32_t)];
+
+    /* Consumer-owned line */
+    vcard_atomic_u32 read_index;
+    vcard_atomic_u32 free_write_index;   /* Slots returned to the producer */
+    char pad2[VCARD_CACHELINE - 2 * sizeof(uint32_t)];
+} midi_queue_t;
+
+/**
+ * Initialize a MIDI queue
+ *
+ * @param q Queue to initialize
+ * @param min_capacity Minimum number of messages (rounded up to a power of two)
+ * @param sysex_slots Number of preallocated slots for long messages (may be 0)
+ * @param sysex_slot_size Largest message length in bytes
+ * @return 0 on success, VCARD_ERROR_* on failure
+ */
+int midi_queue_init(midi_queue_t *q, uint32_t min_capacity,
+                    uint32_t sysex_slots, uint32_t sysex_slot_size);
+
+/**
+ * Release the storage of a MIDI queue
+ *
+ * @param q Queue
+ */
+void midi_queue_free(midi_queue_t *q);
+
+/**
+ * Discard all queued messages and return every sysex slot to the pool
+ *
+ * Must not be called while the producer or consumer is active.
+ *
+ * @param q Queue
+ */
+void midi_queue_reset(midi_queue_t *q);
+
+/**
+ * Enqueue a message (producer side)
+ *
+ * @param q Queue
+ * @param message Message bytes
+ * @param length Message length (1 to sysex_slot_size, or inline size)
+ * @param frame Timestamp in sample frames
+ * @return 0 on success, VCARD_ERROR_INVALID for a bad length,
+ *         VCARD_ERROR_NO_MEMORY if the queue or sysex pool is full
+ */
+int midi_queue_push(midi_queue_t *q, const uint8_t *message, size_t length,
+                    uint64_t frame);
+
+/**
+ * Dequeue the oldest message if it is due (consumer side)
+ *
+ * Messages are only dequeued when their timestamp is before frame_limit;
+ * pass UINT64_MAX to dequeue regardless of timestamp. If the message does
+ * not fit in max_length it stays queued and *length reports its size.
+ *
+ * @param q Queue
+ * @param frame_limit Only dequeue messages stamped before this frame
+ * @param message Destination buffer
+ * @param max_length Size of the destination buffer
+ * @param length Output parameter for the message length (0 if none)
+ * @param frame Output parameter for the timestamp (may be NULL)
+ * @return 1 if a message was dequeued, 0 if none is due,
+ *         VCARD_ERROR_INVALID if the buffer is too small
+ */
+int midi_queue_pop(midi_queue_t *q, uint64_t frame_limit,
+                   uint8_t *message, size_t max_length,
+                   size_t *length, uint64_t *frame);
+
+/**
+ * Number of queued messages
+ *
+ * @param q Queue
+ * @return Messages waiting for the consumer
+ */
+uint32_t midi_queue_count(midi_queue_t *q);
+
+/**
+ * Number of messages rejected because the queue or sysex pool was full
+ *
+ * @param q Queue
+ * @return Dropped message count
+ */
+uint32_t midi_queue_dropped(midi_queue_t *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MIDI_QUEUE_H */
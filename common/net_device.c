@@ -0,0 +1,943 @@
+/**
+ * Virtual Sound Card - Network Streaming Device Implementation
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE                      /* sendmmsg, recvmmsg */
+#endif
+
+#ifdef _WIN32
+#include <winsock2.h>                    /* Before windows.h (via net_device.h) */
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "net_device.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#define NET_HAVE_MMSG 1
+#endif
+
+#define NET_MIN_IDLE_US 100
+#define NET_MAX_IDLE_US 1000
+#define NET_RECEIVE_BUFFER (1 << 20)     /* SO_RCVBUF: bursts of a few hundred ms */
+#define NET_RECEIVE_BATCHES 4            /* recvmmsg calls per pump cycle at most */
+#define NET_JITTER_MARGIN 4.0            /* Target headroom in units of jitter */
+
+#ifdef _WIN32
+#define NET_BAD_SOCKET ((intptr_t)INVALID_SOCKET)
+#define NET_FD(sock) ((SOCKET)(sock))
+#else
+#define NET_BAD_SOCKET ((intptr_t)-1)
+#define NET_FD(sock) ((int)(sock))
+#endif
+
+/* Sockets */
+
+static int net_startup(void)
+{
+#ifdef _WIN32
+    WSADATA data;
+
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+    return 1;
+#endif
+}
+
+static void net_shutdown(void)
+{
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+static void close_socket(intptr_t sock)
+{
+    if (sock == NET_BAD_SOCKET) {
+        return;
+    }
+#ifdef _WIN32
+    closesocket((SOCKET)sock);
+#else
+    close((int)sock);
+#endif
+}
+
+/**
+ * Non-blocking IPv4 UDP socket
+ */
+static intptr_t open_socket(void)
+{
+#ifdef _WIN32
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    u_long nonblocking = 1;
+
+    if (sock == INVALID_SOCKET) {
+        return NET_BAD_SOCKET;
+    }
+    if (ioctlsocket(sock, FIONBIO, &nonblocking) != 0) {
+        closesocket(sock);
+        return NET_BAD_SOCKET;
+    }
+    return (intptr_t)sock;
+#else
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int flags;
+
+    if (sock < 0) {
+        return NET_BAD_SOCKET;
+    }
+    flags = fcntl(sock, F_GETFL, 0);
+    if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+        close(sock);
+        return NET_BAD_SOCKET;
+    }
+    return (intptr_t)sock;
+#endif
+}
+
+static int parse_address(const char *address, uint16_t port, struct sockaddr_in *sa)
+{
+    memset(sa, 0, sizeof(*sa));
+    sa->sin_family = AF_INET;
+    sa->sin_port = htons(port);
+    if (!address) {
+        sa->sin_addr.s_addr = htonl(INADDR_ANY);
+        return 1;
+    }
+    return inet_pton(AF_INET, address, &sa->sin_addr) == 1;
+}
+
+static int is_multicast(const struct sockaddr_in *sa)
+{
+    return (ntohl(sa->sin_addr.s_addr) & 0xf0000000u) == 0xe0000000u;
+}
+
+/**
+ * Send packets on a connected socket
+ *
+ * @return Packets the socket accepted; the rest are dropped
+ */
+static int send_batch(intptr_t sock, uint8_t *packets, const size_t *sizes, int count)
+{
+#ifdef NET_HAVE_MMSG
+    struct mmsghdr msgs[NET_BATCH];
+    struct iovec iov[NET_BATCH];
+    int done = 0;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < count; i++) {
+        iov[i].iov_base = packets + (size_t)i * NET_MAX_PACKET;
+        iov[i].iov_len = sizes[i];
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    while (done < count) {
+        int n = sendmmsg((int)sock, msgs + done, (unsigned int)(count - done), 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        done += n;
+    }
+    return done;
+#else
+    int done = 0;
+
+    for (int i = 0; i < count; i++) {
+#ifdef _WIN32
+        if (send((SOCKET)sock, (const char *)packets + (size_t)i * NET_MAX_PACKET,
+                 (int)sizes[i], 0) == (int)sizes[i]) {
+#else
+        if (send((int)sock, packets + (size_t)i * NET_MAX_PACKET, sizes[i], 0) ==
+            (ssize_t)sizes[i]) {
+#endif
+            done++;
+        }
+    }
+    return done;
+#endif
+}
+
+/**
+ * Receive the packets waiting on a socket, without blocking
+ *
+ * @return Packets received (0 if none is waiting)
+ */
+static int receive_batch(intptr_t sock, uint8_t *packets, size_t *sizes, int max)
+{
+#ifdef NET_HAVE_MMSG
+    struct mmsghdr msgs[NET_BATCH];
+    struct iovec iov[NET_BATCH];
+    int n;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < max; i++) {
+        iov[i].iov_base = packets + (size_t)i * NET_MAX_PACKET;
+        iov[i].iov_len = NET_MAX_PACKET;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    n = recvmmsg((int)sock, msgs, (unsigned int)max, MSG_DONTWAIT, NULL);
+    for (int i = 0; i < n; i++) {
+        // Oversized datagrams are cut short and then fail the size check
+        sizes[i] = msgs[i].msg_len;
+    }
+    return n < 0 ? 0 : n;
+#else
+    int count = 0;
+
+    while (count < max) {
+#ifdef _WIN32
+        int n = recv((SOCKET)sock, (char *)packets + (size_t)count * NET_MAX_PACKET,
+                     NET_MAX_PACKET, 0);
+#else
+        ssize_t n = recv((int)sock, packets + (size_t)count * NET_MAX_PACKET,
+                         NET_MAX_PACKET, 0);
+#endif
+        if (n < 0) {
+            break;
+        }
+        sizes[count++] = (size_t)n;
+    }
+    return count;
+#endif
+}
+
+static uint64_t mix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+static uint32_t idle_for(uint32_t packet_frames, uint32_t sample_rate)
+{
+    uint64_t idle_us = (uint64_t)packet_frames * 1000000 / sample_rate / 4;
+
+    if (idle_us < NET_MIN_IDLE_US) {
+        return NET_MIN_IDLE_US;
+    }
+    return idle_us > NET_MAX_IDLE_US ? NET_MAX_IDLE_US : (uint32_t)idle_us;
+}
+
+/* RTP */
+
+size_t net_rtp_write(const net_rtp_header_t *header, net_encoding_t encoding,
+                     const float *const *in, uint32_t channels, uint32_t frames,
+                     uint8_t *packet)
+{
+    size_t payload = (size_t)channels * (size_t)encoding * frames;
+    uint8_t *p = packet + NET_RTP_HEADER_BYTES;
+
+    if ((encoding != NET_ENCODING_L16 && encoding != NET_ENCODING_L24) ||
+        payload == 0 || payload > NET_MAX_PAYLOAD) {
+        return 0;
+    }
+
+    packet[0] = 0x80;                    // Version 2, no padding, extension or CSRCs
+    packet[1] = header->payload_type & 0x7f;
+    packet[2] = (uint8_t)(header->sequence >> 8);
+    packet[3] = (uint8_t)header->sequence;
+    packet[4] = (uint8_t)(header->timestamp >> 24);
+    packet[5] = (uint8_t)(header->timestamp >> 16);
+    packet[6] = (uint8_t)(header->timestamp >> 8);
+    packet[7] = (uint8_t)header->timestamp;
+    packet[8] = (uint8_t)(header->ssrc >> 24);
+    packet[9] = (uint8_t)(header->ssrc >> 16);
+    packet[10] = (uint8_t)(header->ssrc >> 8);
+    packet[11] = (uint8_t)header->ssrc;
+
+    // Interleaved, big-endian (network order) samples
+    for (uint32_t i = 0; i < frames; i++) {
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            float x = in[ch] ? in[ch][i] : 0.0f;
+
+            x = x > 1.0f ? 1.0f : (x < -1.0f ? -1.0f : x);
+            if (encoding == NET_ENCODING_L24) {
+                int32_t s = (int32_t)lrintf(x * 8388607.0f);
+                p[0] = (uint8_t)(s >> 16);
+                p[1] = (uint8_t)(s >> 8);
+                p[2] = (uint8_t)s;
+                p += 3;
+            } else {
+                int32_t s = (int32_t)lrintf(x * 32767.0f);
+                p[0] = (uint8_t)(s >> 8);
+                p[1] = (uint8_t)s;
+                p += 2;
+            }
+        }
+    }
+    return NET_RTP_HEADER_BYTES + payload;
+}
+
+/* Jitter Buffer */
+
+int net_jitter_init(net_jitter_t *j, uint32_t channels, uint32_t sample_rate,
+                    const net_config_t *config)
+{
+    uint32_t max_latency_us;
+    uint64_t max_target;
+
+    memset(j, 0, sizeof(*j));
+    if (channels == 0 || channels > VCARD_MAX_CHANNELS ||
+        sample_rate < 8000 || sample_rate > 192000 ||
+        (config->encoding != NET_ENCODING_L16 && config->encoding != NET_ENCODING_L24)) {
+        return VCARD_ERROR_INVALID;
+    }
+    j->channels = channels;
+    j->sample_rate = sample_rate;
+    j->encoding = config->encoding;
+    j->packet_frames = config->packet_frames ? config->packet_frames : sample_rate / 1000;
+    j->payload_type = config->payload_type ? config->payload_type : NET_DEFAULT_PAYLOAD_TYPE;
+    if ((size_t)channels * (size_t)j->encoding * j->packet_frames > NET_MAX_PAYLOAD ||
+        j->payload_type > 127) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    max_latency_us = config->max_latency_us ? config->max_latency_us
+                                            : NET_DEFAULT_MAX_LATENCY_US;
+    max_target = (uint64_t)max_latency_us * sample_rate / 1000000;
+    j->min_target = 2 * j->packet_frames;
+    if (max_target > (uint64_t)(NET_JITTER_SLOTS / 2) * j->packet_frames) {
+        max_target = (uint64_t)(NET_JITTER_SLOTS / 2) * j->packet_frames;
+    }
+    j->max_target = max_target < j->min_target ? j->min_target : (uint32_t)max_target;
+    j->target = j->min_target;
+
+    j->data = (float *)calloc((size_t)NET_JITTER_SLOTS * j->packet_frames * channels,
+                              sizeof(float));
+    if (!j->data) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    return VCARD_SUCCESS;
+}
+
+void net_jitter_free(net_jitter_t *j)
+{
+    free(j->data);
+    j->data = NULL;
+}
+
+/**
+ * Restart the stream on a packet: everything buffered is dropped
+ */
+static void jitter_restart(net_jitter_t *j, uint32_t ssrc, uint32_t ext)
+{
+    memset(j->slot_valid, 0, sizeof(j->slot_valid));
+    j->started = 1;
+    j->playing = 0;
+    j->played = 0;
+    j->ssrc = ssrc;
+    j->highest = ext;
+    j->play = ext;
+    j->offset = 0;
+    j->have_transit = 0;
+}
+
+uint32_t net_jitter_depth(const net_jitter_t *j)
+{
+    int32_t packets = (int32_t)(j->highest - j->play) + 1;
+
+    if (!j->started || packets <= 0) {
+        return 0;
+    }
+    return (uint32_t)packets * j->packet_frames - j->offset;
+}
+
+net_packet_result_t net_jitter_push(net_jitter_t *j, const uint8_t *packet, size_t bytes,
+                                    uint64_t arrival_ns)
+{
+    net_packet_result_t result = NET_PACKET_OK;
+    size_t header = NET_RTP_HEADER_BYTES;
+    size_t end = bytes;
+    uint16_t seq;
+    uint32_t timestamp, ssrc, ext, slot;
+    int32_t ahead;
+    double arrival;
+    float *dst;
+    const uint8_t *p;
+
+    // Parse the header, skipping CSRCs, a header extension and padding
+    if (bytes < NET_RTP_HEADER_BYTES || (packet[0] >> 6) != 2) {
+        goto malformed;
+    }
+    header += 4u * (packet[0] & 0x0f);
+    if (packet[0] & 0x10) {
+        if (bytes < header + 4) {
+            goto malformed;
+        }
+        header += 4 + 4u * (((size_t)packet[header + 2] << 8) | packet[header + 3]);
+    }
+    if (packet[0] & 0x20) {
+        if (packet[bytes - 1] == 0 || packet[bytes - 1] > bytes) {
+            goto malformed;
+        }
+        end -= packet[bytes - 1];
+    }
+    if (header > end || (packet[1] & 0x7f) != j->payload_type ||
+        end - header != (size_t)j->channels * (size_t)j->encoding * j->packet_frames) {
+        goto malformed;
+    }
+    seq = (uint16_t)((packet[2] << 8) | packet[3]);
+    timestamp = ((uint32_t)packet[4] << 24) | ((uint32_t)packet[5] << 16) |
+                ((uint32_t)packet[6] << 8) | packet[7];
+    ssrc = ((uint32_t)packet[8] << 24) | ((uint32_t)packet[9] << 16) |
+           ((uint32_t)packet[10] << 8) | packet[11];
+
+    // Place it relative to the playout position
+    if (!j->started || ssrc != j->ssrc) {
+        if (j->started) {
+            j->stats.resyncs++;
+            result = NET_PACKET_RESYNC;
+        }
+        jitter_restart(j, ssrc, seq);
+    }
+    ext = j->highest + (uint32_t)(int32_t)(int16_t)(seq - (uint16_t)j->highest);
+    ahead = (int32_t)(ext - j->play);
+    if (ahead >= NET_JITTER_SLOTS || ahead <= -NET_JITTER_SLOTS) {
+        jitter_restart(j, ssrc, ext);
+        j->stats.resyncs++;
+        result = NET_PACKET_RESYNC;
+    } else if (ahead < 0) {
+        // Earlier than the first packet is fine until playout begins
+        if (j->played || (int32_t)(j->highest - ext) >= NET_JITTER_SLOTS) {
+            j->stats.late++;
+            return NET_PACKET_LATE;
+        }
+        j->play = ext;
+    }
+
+    slot = ext & (NET_JITTER_SLOTS - 1);
+    if (j->slot_valid[slot] && j->slot_seq[slot] == ext) {
+        j->stats.duplicates++;
+        return NET_PACKET_DUPLICATE;
+    }
+
+    dst = j->data + (size_t)slot * j->packet_frames * j->channels;
+    p = packet + header;
+    if (j->encoding == NET_ENCODING_L24) {
+        for (size_t i = 0; i < (size_t)j->packet_frames * j->channels; i++, p += 3) {
+            int32_t s = (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                                  ((uint32_t)p[2] << 8)) >> 8;
+            dst[i] = (float)s * (1.0f / 8388608.0f);
+        }
+    } else {
+        for (size_t i = 0; i < (size_t)j->packet_frames * j->channels; i++, p += 2) {
+            dst[i] = (float)(int16_t)((p[0] << 8) | p[1]) * (1.0f / 32768.0f);
+        }
+    }
+    j->slot_valid[slot] = 1;
+    j->slot_seq[slot] = ext;
+    if ((int32_t)(ext - j->highest) > 0) {
+        j->highest = ext;
+    }
+    j->stats.received++;
+
+    // RFC 3550 interarrival jitter, in frames, and the target it implies
+    arrival = (double)arrival_ns * 1e-9 * j->sample_rate;
+    if (j->have_transit) {
+        double d = (arrival - j->last_arrival) - (double)(int32_t)(timestamp - j->last_timestamp);
+        double target;
+
+        j->jitter += (fabs(d) - j->jitter) / 16.0;
+        target = j->min_target + NET_JITTER_MARGIN * j->jitter;
+        j->target = target > j->max_target ? j->max_target : (uint32_t)target;
+    }
+    j->last_arrival = arrival;
+    j->last_timestamp = timestamp;
+    j->have_transit = 1;
+
+    if (!j->playing && net_jitter_depth(j) >= j->target) {
+        j->playing = 1;
+    }
+    return result;
+
+malformed:
+    j->stats.malformed++;
+    return NET_PACKET_MALFORMED;
+}
+
+size_t net_jitter_pull(net_jitter_t *j, float *const *out, size_t frames)
+{
+    size_t done = 0;
+
+    if (!j->playing) {
+        return 0;
+    }
+    while (done < frames) {
+        uint32_t slot = j->play & (NET_JITTER_SLOTS - 1);
+        uint32_t count = j->packet_frames - j->offset;
+        int present = j->slot_valid[slot] && j->slot_seq[slot] == j->play;
+
+        if ((int32_t)(j->play - j->highest) > 0) {
+            // Ran dry: buffer up to the target again
+            j->playing = 0;
+            j->stats.underruns++;
+            break;
+        }
+        if (count > frames - done) {
+            count = (uint32_t)(frames - done);
+        }
+        if (present) {
+            const float *src = j->data + ((size_t)slot * j->packet_frames + j->offset) * j->channels;
+            for (uint32_t ch = 0; ch < j->channels; ch++) {
+                for (uint32_t i = 0; i < count; i++) {
+                    out[ch][done + i] = src[(size_t)i * j->channels + ch];
+                }
+            }
+        } else {
+            if (j->offset == 0) {
+                j->stats.lost++;
+            }
+            for (uint32_t ch = 0; ch < j->channels; ch++) {
+                memset(out[ch] + done, 0, count * sizeof(float));
+            }
+        }
+        done += count;
+        j->played = 1;
+        j->offset += count;
+        if (j->offset == j->packet_frames) {
+            j->slot_valid[slot] = 0;
+            j->play++;
+            j->offset = 0;
+        }
+    }
+    return done;
+}
+
+static void jitter_get_stats(const net_jitter_t *j, net_jitter_stats_t *stats)
+{
+    *stats = j->stats;
+    stats->jitter_us = j->jitter * 1e6 / j->sample_rate;
+    stats->depth = net_jitter_depth(j);
+    stats->target = j->target;
+    stats->playing = j->playing;
+}
+
+/* Sender */
+
+/**
+ * Source -> RTP packets -> socket (pump thread)
+ */
+static void sender_pump(void *arg)
+{
+    net_sender_t *s = (net_sender_t *)arg;
+    const float *planes[VCARD_MAX_CHANNELS] = { NULL };
+    float *dst[VCARD_MAX_CHANNELS] = { NULL };
+    size_t sizes[NET_BATCH];
+    uint32_t fill = 0;
+
+    for (uint32_t ch = 0; ch < s->channels; ch++) {
+        planes[ch] = s->block + (size_t)ch * s->packet_frames;
+    }
+
+    while (vcard_atomic_load_acquire_u32(&s->running)) {
+        int count = 0;
+
+        // Packetize everything the source has, a batch at a time
+        while (count < NET_BATCH) {
+            size_t got = 0;
+
+            for (uint32_t ch = 0; ch < s->channels; ch++) {
+                dst[ch] = s->block + (size_t)ch * s->packet_frames + fill;
+            }
+            vcard_read_audio(s->source_id, dst, s->packet_frames - fill, &got);
+            fill += (uint32_t)got;
+            if (fill < s->packet_frames) {
+                break;
+            }
+            sizes[count] = net_rtp_write(&s->header, s->encoding, planes, s->channels,
+                                         s->packet_frames,
+                                         s->packets + (size_t)count * NET_MAX_PACKET);
+            s->header.sequence++;
+            s->header.timestamp += s->packet_frames;
+            fill = 0;
+            count++;
+        }
+
+        if (count > 0) {
+            int sent = send_batch(s->socket, s->packets, sizes, count);
+
+            vcard_atomic_fetch_add_u64(&s->sent_packets, (uint64_t)sent);
+            vcard_atomic_fetch_add_u64(&s->sent_frames, (uint64_t)sent * s->packet_frames);
+            vcard_atomic_fetch_add_u64(&s->batches, 1);
+            if (sent < count) {
+                vcard_atomic_fetch_add_u64(&s->errors, (uint64_t)(count - sent));
+            }
+        }
+        if (count < NET_BATCH) {
+            vcard_sleep_us(s->idle_us);
+        }
+    }
+}
+
+int net_sender_start(net_sender_t *s, int source_id, const net_config_t *config)
+{
+    vcard_config_t source;
+    struct sockaddr_in sa;
+    uint64_t seed;
+    int result;
+
+    memset(s, 0, sizeof(*s));
+    s->socket = NET_BAD_SOCKET;
+    result = vcard_get_config(source_id, &source);
+    if (result != VCARD_SUCCESS) {
+        return result;
+    }
+    s->source_id = source_id;
+    s->channels = source.channels_in;
+    s->encoding = config->encoding;
+    s->packet_frames = config->packet_frames ? config->packet_frames : source.sample_rate / 1000;
+    s->idle_us = idle_for(s->packet_frames, source.sample_rate);
+    if ((s->encoding != NET_ENCODING_L16 && s->encoding != NET_ENCODING_L24) ||
+        s->channels == 0 || s->packet_frames == 0 ||
+        (size_t)s->channels * (size_t)s->encoding * s->packet_frames > NET_MAX_PAYLOAD ||
+        config->payload_type > 127 || config->port == 0 || !config->address ||
+        !parse_address(config->address, config->port, &sa)) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    // Random SSRC, sequence and timestamp origin (RFC 3550 section 5.1)
+    seed = mix64(vcard_time_ns() ^ (uint64_t)(uintptr_t)s);
+    s->header.payload_type = config->payload_type ? config->payload_type
+                                                  : NET_DEFAULT_PAYLOAD_TYPE;
+    s->header.ssrc = (uint32_t)seed;
+    s->header.sequence = (uint16_t)(seed >> 32);
+    s->header.timestamp = (uint32_t)mix64(seed);
+
+    s->block = (float *)calloc((size_t)s->channels * s->packet_frames, sizeof(float));
+    s->packets = (uint8_t *)malloc((size_t)NET_BATCH * NET_MAX_PACKET);
+    if (!s->block || !s->packets) {
+        result = VCARD_ERROR_NO_MEMORY;
+        goto fail;
+    }
+
+    if (!net_startup()) {
+        result = VCARD_ERROR_IO;
+        goto fail;
+    }
+    s->socket = open_socket();
+    if (s->socket == NET_BAD_SOCKET ||
+        connect(NET_FD(s->socket), (const struct sockaddr *)&sa, sizeof(sa)) != 0) {
+        close_socket(s->socket);
+        net_shutdown();
+        s->socket = NET_BAD_SOCKET;
+        result = VCARD_ERROR_IO;
+        goto fail;
+    }
+
+    vcard_atomic_store_release_u32(&s->running, 1);
+    if (vcard_thread_create(&s->thread, sender_pump, s) != 0) {
+        close_socket(s->socket);
+        net_shutdown();
+        s->socket = NET_BAD_SOCKET;
+        result = VCARD_ERROR_NO_MEMORY;
+        goto fail;
+    }
+    return VCARD_SUCCESS;
+
+fail:
+    free(s->block);
+    free(s->packets);
+    s->block = NULL;
+    s->packets = NULL;
+    return result;
+}
+
+void net_sender_stop(net_sender_t *s)
+{
+    vcard_atomic_store_release_u32(&s->running, 0);
+    vcard_thread_join(&s->thread);
+    close_socket(s->socket);
+    net_shutdown();
+    s->socket = NET_BAD_SOCKET;
+    free(s->block);
+    free(s->packets);
+    s->block = NULL;
+    s->packets = NULL;
+}
+
+void net_sender_get_stats(net_sender_t *s, net_sender_stats_t *stats)
+{
+    stats->packets = vcard_atomic_load_relaxed_u64(&s->sent_packets);
+    stats->frames = vcard_atomic_load_relaxed_u64(&s->sent_frames);
+    stats->batches = vcard_atomic_load_relaxed_u64(&s->batches);
+    stats->errors = vcard_atomic_load_relaxed_u64(&s->errors);
+}
+
+/* Receiver */
+
+/**
+ * Socket -> jitter buffer -> resampler -> destination (pump thread)
+ */
+static void receiver_pump(void *arg)
+{
+    net_receiver_t *r = (net_receiver_t *)arg;
+    net_jitter_t *j = &r->jitter;
+    uint32_t packet_frames = j->packet_frames;
+    uint32_t out_frames = 2 * packet_frames;
+    const float *in[VCARD_MAX_CHANNELS] = { NULL };
+    float *jitter_planes[VCARD_MAX_CHANNELS] = { NULL };
+    float *out[VCARD_MAX_CHANNELS] = { NULL };
+    const float *dest_planes[VCARD_MAX_CHANNELS] = { NULL };
+    size_t sizes[NET_BATCH];
+    size_t in_pos = 0, in_count = 0;
+    size_t out_pos = 0, out_count = 0;
+    uint64_t frames_out = 0, batches = 0, underruns = 0;
+    uint64_t last_ns = 0;
+    double adjust = 0.0;
+
+    for (uint32_t ch = 0; ch < r->channels; ch++) {
+        jitter_planes[ch] = r->in_data + (size_t)ch * packet_frames;
+        out[ch] = r->out_data + (size_t)ch * out_frames;
+    }
+
+    while (vcard_atomic_load_acquire_u32(&r->running)) {
+        size_t fill = 0, moved = 0;
+        int received = 0;
+        uint32_t latency_us;
+        uint64_t now;
+
+        // Drain the socket into the jitter buffer
+        for (int b = 0; b < NET_RECEIVE_BATCHES; b++) {
+            int n = receive_batch(r->socket, r->packets, sizes, NET_BATCH);
+
+            now = vcard_time_ns();
+            for (int i = 0; i < n; i++) {
+                net_jitter_push(j, r->packets + (size_t)i * NET_MAX_PACKET, sizes[i], now);
+            }
+            received += n;
+            batches += n > 0;
+            if (n < NET_BATCH) {
+                break;
+            }
+        }
+
+        // Hold the jitter buffer at its target against the destination's clock
+        now = vcard_time_ns();
+        if (j->playing) {
+            if (last_ns) {
+                adjust = resampler_steer(&r->resampler, (double)net_jitter_depth(j),
+                                         (double)j->target, (double)(now - last_ns) * 1e-9);
+            }
+            last_ns = now;
+        } else {
+            // Buffering: don't let the controller wind up meanwhile
+            last_ns = 0;
+        }
+
+        // Keep the destination topped up to its target fill
+        vcard_get_buffered(r->dest_id, &fill);
+        while (fill < r->dest_target) {
+            size_t used = 0;
+
+            if (out_pos < out_count) {
+                size_t written = 0;
+
+                for (uint32_t ch = 0; ch < r->channels; ch++) {
+                    dest_planes[ch] = out[ch] + out_pos;
+                }
+                vcard_write_audio(r->dest_id, dest_planes, out_count - out_pos, &written);
+                out_pos += written;
+                fill += written;
+                moved += written;
+                frames_out += written;
+                if (out_pos < out_count) {
+                    break;
+                }
+                continue;
+            }
+            if (in_pos == in_count) {
+                in_count = net_jitter_pull(j, jitter_planes, packet_frames);
+                in_pos = 0;
+                if (in_count == 0) {
+                    break;
+                }
+            }
+            for (uint32_t ch = 0; ch < r->channels; ch++) {
+                in[ch] = jitter_planes[ch] + in_pos;
+            }
+            out_count = resampler_process(&r->resampler, in, in_count - in_pos, &used, out,
+                                          out_frames);
+            in_pos += used;
+            out_pos = 0;
+            if (out_count == 0 && used == 0) {
+                break;
+            }
+        }
+
+        if (j->stats.underruns != underruns) {
+            underruns = j->stats.underruns;
+            vcard_report_xrun(r->dest_id);
+        }
+
+        // Packetization, jitter buffer and resampler staging, at the stream rate
+        latency_us = (uint32_t)(((uint64_t)packet_frames + net_jitter_depth(j) +
+                                 (in_count - in_pos) +
+                                 (r->resampler.fill - r->resampler.pos)) *
+                                1000000 / j->sample_rate);
+        vcard_report_latency(r->dest_id, latency_us);
+
+        vcard_mutex_lock(&r->stats_lock);
+        jitter_get_stats(j, &r->stats.jitter);
+        r->stats.correction_ppm = adjust * 1e6;
+        r->stats.latency_us = latency_us;
+        r->stats.frames_out = frames_out;
+        r->stats.batches = batches;
+        vcard_mutex_unlock(&r->stats_lock);
+
+        if (received == 0 && moved == 0) {
+            vcard_sleep_us(r->idle_us);
+        }
+    }
+}
+
+int net_receiver_start(net_receiver_t *r, int dest_id, const net_config_t *config)
+{
+    vcard_config_t dest;
+    struct sockaddr_in sa;
+    socklen_t sa_len = sizeof(sa);
+    uint32_t stream_rate;
+    size_t bytes;
+    int result;
+
+    memset(r, 0, sizeof(*r));
+    r->socket = NET_BAD_SOCKET;
+    result = vcard_get_config(dest_id, &dest);
+    if (result != VCARD_SUCCESS) {
+        return result;
+    }
+    if (!parse_address(config->address, config->port, &sa)) {
+        return VCARD_ERROR_INVALID;
+    }
+    r->dest_id = dest_id;
+    r->channels = dest.channels_out;
+    r->dest_target = 2 * dest.buffer_size;
+    stream_rate = config->sample_rate ? config->sample_rate : dest.sample_rate;
+
+    result = net_jitter_init(&r->jitter, r->channels, stream_rate, config);
+    if (result != VCARD_SUCCESS) {
+        return result;
+    }
+    r->idle_us = idle_for(r->jitter.packet_frames, stream_rate);
+    result = resampler_init(&r->resampler, r->channels, stream_rate, dest.sample_rate);
+    if (result != VCARD_SUCCESS) {
+        net_jitter_free(&r->jitter);
+        return result;
+    }
+    bytes = (size_t)r->channels * r->jitter.packet_frames * sizeof(float);
+    r->in_data = (float *)malloc(bytes);
+    r->out_data = (float *)malloc(2 * bytes);
+    r->packets = (uint8_t *)malloc((size_t)NET_BATCH * NET_MAX_PACKET);
+    if (!r->in_data || !r->out_data || !r->packets) {
+        result = VCARD_ERROR_NO_MEMORY;
+        goto fail;
+    }
+
+    if (!net_startup()) {
+        result = VCARD_ERROR_IO;
+        goto fail;
+    }
+    r->socket = open_socket();
+    if (r->socket != NET_BAD_SOCKET) {
+        int reuse = 1;
+        int buffer = NET_RECEIVE_BUFFER;
+        struct sockaddr_in local = sa;
+
+        setsockopt(NET_FD(r->socket), SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse,
+                   sizeof(reuse));
+        setsockopt(NET_FD(r->socket), SOL_SOCKET, SO_RCVBUF, (const char *)&buffer,
+                   sizeof(buffer));
+        // A multicast group is joined on a socket bound to any address
+        if (is_multicast(&sa)) {
+            local.sin_addr.s_addr = htonl(INADDR_ANY);
+        }
+        if (bind(NET_FD(r->socket), (const struct sockaddr *)&local, sizeof(local)) != 0 ||
+            getsockname(NET_FD(r->socket), (struct sockaddr *)&local, &sa_len) != 0) {
+            close_socket(r->socket);
+            r->socket = NET_BAD_SOCKET;
+        } else {
+            r->port = ntohs(local.sin_port);
+        }
+    }
+    if (r->socket != NET_BAD_SOCKET && is_multicast(&sa)) {
+        struct ip_mreq mreq;
+
+        memset(&mreq, 0, sizeof(mreq));
+        mreq.imr_multiaddr = sa.sin_addr;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(NET_FD(r->socket), IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char *)&mreq,
+                       sizeof(mreq)) != 0) {
+            close_socket(r->socket);
+            r->socket = NET_BAD_SOCKET;
+        }
+    }
+    if (r->socket == NET_BAD_SOCKET) {
+        net_shutdown();
+        result = VCARD_ERROR_IO;
+        goto fail;
+    }
+
+    vcard_mutex_init(&r->stats_lock);
+    vcard_atomic_store_release_u32(&r->running, 1);
+    if (vcard_thread_create(&r->thread, receiver_pump, r) != 0) {
+        vcard_mutex_destroy(&r->stats_lock);
+        close_socket(r->socket);
+        net_shutdown();
+        r->socket = NET_BAD_SOCKET;
+        result = VCARD_ERROR_NO_MEMORY;
+        goto fail;
+    }
+    return VCARD_SUCCESS;
+
+fail:
+    free(r->in_data);
+    free(r->out_data);
+    free(r->packets);
+    r->in_data = NULL;
+    r->out_data = NULL;
+    r->packets = NULL;
+    resampler_free(&r->resampler);
+    net_jitter_free(&r->jitter);
+    return result;
+}
+
+void net_receiver_stop(net_receiver_t *r)
+{
+    vcard_atomic_store_release_u32(&r->running, 0);
+    vcard_thread_join(&r->thread);
+    vcard_mutex_destroy(&r->stats_lock);
+    close_socket(r->socket);
+    net_shutdown();
+    r->socket = NET_BAD_SOCKET;
+    free(r->in_data);
+    free(r->out_data);
+    free(r->packets);
+    r->in_data = NULL;
+    r->out_data = NULL;
+    r->packets = NULL;
+    resampler_free(&r->resampler);
+    net_jitter_free(&r->jitter);
+}
+
+void net_receiver_get_stats(net_receiver_t *r, net_receiver_stats_t *stats)
+{
+    vcard_mutex_lock(&r->stats_lock);
+    *stats = r->stats;
+    vcard_mutex_unlock(&r->stats_lock);
+}
@@ -0,0 +1,349 @@
+/**
+ * Virtual Sound Card - Network Streaming Device
+ *
+ * Carries a vcard device's channels to another machine as RTP over UDP,
+ * in the AES67 style: uncompressed big-endian L16 or L24 payloads of a
+ * fixed number of frames (1 ms by default), one packet per block of all
+ * channels, unicast or IPv4 multicast. A generator on one host and an
+ * analyzer on another then talk through the network instead of audio
+ * interfaces and cables.
+ *
+ * net_sender_t is a pump thread that reads a source device's input
+ * channels and sends each completed block as a packet. Packets that
+ * become ready together go out in one sendmmsg (Linux) call.
+ *
+ * net_receiver_t is a pump thread that drains its socket in recvmmsg
+ * batches into a jitter buffer and writes the destination device's output
+ * channels through an adaptive resampler:
+ *  - the jitter buffer reorders packets by sequence number, drops late
+ *    and duplicate ones and conceals lost ones with silence
+ *  - its target depth follows the measured interarrival jitter (RFC 3550),
+ *    between two packets and max_latency_us
+ *  - the resampler is steered to hold the depth at the target, so the
+ *    sender's clock drift becomes a ppm correction rather than underruns
+ *    or a growing delay
+ *  - packetization plus buffered audio is reported as the destination's
+ *    backend latency, so it shows up in vcard_status_t.latency_us
+ *
+ * net_jitter_t is usable on its own, and net_rtp_write() builds the
+ * packets the sender sends.
+ */
+
+#ifndef NET_DEVICE_H
+#define NET_DEVICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vcard.h"
+#include "vcard_atomic.h"
+#include "vcard_thread.h"
+#include "resampler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NET_RTP_HEADER_BYTES 12
+#define NET_MAX_PAYLOAD 1440                 /* AES67 payload limit, fits a 1500-byte MTU */
+#define NET_MAX_PACKET (NET_RTP_HEADER_BYTES + NET_MAX_PAYLOAD)
+#define NET_BATCH 16                         /* Packets per sendmmsg/recvmmsg call */
+#define NET_JITTER_SLOTS 256                 /* Packets the jitter buffer holds (power of two) */
+#define NET_DEFAULT_PAYLOAD_TYPE 96          /* First dynamic RTP payload type */
+#define NET_DEFAULT_MAX_LATENCY_US 20000
+
+/**
+ * Payload encoding; the value is the bytes per sample
+ */
+typedef enum {
+    NET_ENCODING_L16 = 2,                    /* RFC 3551 L16 */
+    NET_ENCODING_L24 = 3                     /* RFC 3190 L24 */
+} net_encoding_t;
+
+/**
+ * Stream configuration, shared by both ends
+ */
+typedef struct {
+    const char *address;      /* Sender: destination IPv4 address. Receiver: local
+                                 address or multicast group to join, NULL for any */
+    uint16_t port;            /* Receiver: 0 for an ephemeral port */
+    net_encoding_t encoding;
+    uint32_t packet_frames;   /* Frames per packet, 0 for 1 ms */
+    uint32_t sample_rate;     /* Receiver: stream rate, 0 for the device's rate.
+                                 The sender always sends at its device's rate */
+    uint8_t payload_type;     /* 0 for NET_DEFAULT_PAYLOAD_TYPE */
+    uint32_t max_latency_us;  /* Receiver: jitter buffer target ceiling, 0 for default */
+} net_config_t;
+
+/**
+ * RTP fields of one packet
+ */
+typedef struct {
+    uint8_t payload_type;
+    uint16_t sequence;
+    uint32_t timestamp;       /* Stream frame of the first sample */
+    uint32_t ssrc;
+} net_rtp_header_t;
+
+/**
+ * Build one RTP packet from planar float frames
+ *
+ * @param header RTP fields
+ * @param encoding Payload encoding
+ * @param in channels planar buffers of frames samples (NULL channels are silent)
+ * @param channels Number of channels
+ * @param frames Frames per channel
+ * @param packet Output buffer of at least NET_MAX_PACKET bytes
+ * @return Packet size in bytes, or 0 if the payload exceeds NET_MAX_PAYLOAD
+ */
+size_t net_rtp_write(const net_rtp_header_t *header, net_encoding_t encoding,
+                     const float *const *in, uint32_t channels, uint32_t frames,
+                     uint8_t *packet);
+
+/**
+ * net_jitter_push() results
+ */
+typedef enum {
+    NET_PACKET_OK = 0,
+    NET_PACKET_MALFORMED,     /* Not RTP, wrong payload type or size */
+    NET_PACKET_LATE,          /* Arrived after its frames were played */
+    NET_PACKET_DUPLICATE,
+    NET_PACKET_RESYNC         /* New SSRC or a jump out of range: restarted on it */
+} net_packet_result_t;
+
+/**
+ * Jitter buffer statistics
+ */
+typedef struct {
+    uint64_t received;
+    uint64_t lost;            /* Concealed with silence */
+    uint64_t late;
+    uint64_t duplicates;
+    uint64_t malformed;
+    uint64_t underruns;       /* Ran dry while playing, rebuffering */
+    uint64_t resyncs;
+    double jitter_us;         /* RFC 3550 interarrival jitter */
+    uint32_t depth;           /* Frames buffered */
+    uint32_t target;          /* Frames the playout aims to hold */
+    int playing;
+} net_jitter_stats_t;
+
+/**
+ * Jitter buffer for one stream (single thread)
+ *
+ * Slots are indexed by the extended sequence number; each holds one
+ * packet's frames decoded to interleaved float.
+ */
+typedef struct {
+    uint32_t channels;
+    uint32_t packet_frames;
+    uint32_t sample_rate;
+    net_encoding_t encoding;
+    uint8_t payload_type;
+    uint32_t min_target;                 /* Frames */
+    uint32_t max_target;
+    uint32_t target;
+
+    float *data;                         /* SLOTS x packet_frames x channels */
+    uint32_t slot_seq[NET_JITTER_SLOTS]; /* Extended sequence held by each slot */
+    uint8_t slot_valid[NET_JITTER_SLOTS];
+
+    int started;                         /* A packet has been accepted */
+    int playing;                         /* Target depth reached, pulling */
+    int played;                          /* Frames pulled since the (re)start */
+    uint32_t ssrc;
+    uint32_t highest;                    /* Highest extended sequence received */
+    uint32_t play;                       /* Extended sequence being played */
+    uint32_t offset;                     /* Frames of the play packet consumed */
+
+    double jitter;                       /* Frames */
+    double last_arrival;                 /* Frames, on the local clock */
+    uint32_t last_timestamp;
+    int have_transit;
+
+    net_jitter_stats_t stats;
+} net_jitter_t;
+
+/**
+ * Initialize a jitter buffer
+ *
+ * @param j Jitter buffer to initialize
+ * @param channels Channels per packet (1-VCARD_MAX_CHANNELS)
+ * @param sample_rate Stream rate in Hz
+ * @param config Encoding, packet_frames, payload_type and max_latency_us
+ * @return 0 on success, VCARD_ERROR_INVALID if the packets do not fit
+ *         NET_MAX_PAYLOAD, VCARD_ERROR_NO_MEMORY
+ */
+int net_jitter_init(net_jitter_t *j, uint32_t channels, uint32_t sample_rate,
+                    const net_config_t *config);
+
+/**
+ * Release the storage of a jitter buffer
+ *
+ * @param j Jitter buffer
+ */
+void net_jitter_free(net_jitter_t *j);
+
+/**
+ * Insert a received packet
+ *
+ * @param j Jitter buffer
+ * @param packet Packet bytes
+ * @param bytes Packet size
+ * @param arrival_ns vcard_time_ns() at which the packet arrived
+ * @return NET_PACKET_*
+ */
+net_packet_result_t net_jitter_push(net_jitter_t *j, const uint8_t *packet, size_t bytes,
+                                    uint64_t arrival_ns);
+
+/**
+ * Take frames for playout
+ *
+ * Returns nothing until the target depth is first reached, and again
+ * after running dry until it is reached once more.
+ *
+ * @param j Jitter buffer
+ * @param out channels planar buffers
+ * @param frames Capacity of each buffer in frames
+ * @return Frames written to each buffer
+ */
+size_t net_jitter_pull(net_jitter_t *j, float *const *out, size_t frames);
+
+/**
+ * Frames buffered ahead of the playout position
+ *
+ * @param j Jitter buffer
+ * @return Frames, counting packets not yet arrived within the range
+ */
+uint32_t net_jitter_depth(const net_jitter_t *j);
+
+/**
+ * Sender statistics
+ */
+typedef struct {
+    uint64_t packets;
+    uint64_t frames;
+    uint64_t batches;         /* Send calls */
+    uint64_t errors;          /* Packets the socket refused */
+} net_sender_stats_t;
+
+/**
+ * Sender state
+ */
+typedef struct {
+    int source_id;
+    uint32_t channels;
+    uint32_t packet_frames;
+    uint32_t idle_us;
+    net_encoding_t encoding;
+    net_rtp_header_t header;             /* Next packet's fields */
+    intptr_t socket;                     /* Platform socket */
+    float *block;                        /* channels x packet_frames staging */
+    uint8_t *packets;                    /* NET_BATCH x NET_MAX_PACKET */
+    vcard_thread_t thread;
+
+    vcard_atomic_u32 running;
+    vcard_atomic_u64 sent_packets;
+    vcard_atomic_u64 sent_frames;
+    vcard_atomic_u64 batches;
+    vcard_atomic_u64 errors;
+} net_sender_t;
+
+/**
+ * Start sending a source device's input channels
+ *
+ * The sender is the only reader of the source.
+ *
+ * @param s Sender to start
+ * @param source_id Device whose input channels are sent
+ * @param config Destination address and port, encoding, packet size
+ * @return 0 on success, VCARD_ERROR_INVALID for a bad address or a packet
+ *         beyond NET_MAX_PAYLOAD, VCARD_ERROR_IO if the socket fails,
+ *         other VCARD_ERROR_* on failure
+ */
+int net_sender_start(net_sender_t *s, int source_id, const net_config_t *config);
+
+/**
+ * Stop the pump thread and release the sender
+ *
+ * @param s Sender
+ */
+void net_sender_stop(net_sender_t *s);
+
+/**
+ * Get statistics (any thread)
+ *
+ * @param s Sender
+ * @param stats Output parameter for statistics
+ */
+void net_sender_get_stats(net_sender_t *s, net_sender_stats_t *stats);
+
+/**
+ * Receiver statistics
+ */
+typedef struct {
+    net_jitter_stats_t jitter;
+    double correction_ppm;    /* Steering correction in effect */
+    uint32_t latency_us;      /* Reported to the destination device */
+    uint64_t frames_out;      /* Frames written to the destination */
+    uint64_t batches;         /* Receive calls that returned packets */
+} net_receiver_stats_t;
+
+/**
+ * Receiver state
+ */
+typedef struct {
+    int dest_id;
+    uint32_t channels;
+    uint32_t dest_target;                /* Destination fill to hold */
+    uint32_t idle_us;
+    uint16_t port;                       /* Bound port */
+    intptr_t socket;                     /* Platform socket */
+    net_jitter_t jitter;                 /* Pump-thread owned */
+    resampler_t resampler;               /* Pump-thread owned */
+    float *in_data;                      /* channels x packet_frames from the jitter buffer */
+    float *out_data;                     /* channels x 2 packet_frames for the destination */
+    uint8_t *packets;                    /* NET_BATCH x NET_MAX_PACKET */
+    vcard_thread_t thread;
+
+    vcard_atomic_u32 running;
+    vcard_mutex_t stats_lock;            /* Guards stats */
+    net_receiver_stats_t stats;          /* Published by the pump once per cycle */
+} net_receiver_t;
+
+/**
+ * Start receiving a stream into a destination device's output channels
+ *
+ * Stream channel N goes to destination output channel N; packets must
+ * carry exactly the destination's output channel count. The receiver is
+ * the only writer of the destination.
+ *
+ * @param r Receiver to start
+ * @param dest_id Device whose output channels are written
+ * @param config Local port (and address or multicast group), encoding,
+ *               packet size, stream rate and latency ceiling
+ * @return 0 on success, VCARD_ERROR_INVALID for a bad configuration,
+ *         VCARD_ERROR_IO if the socket cannot be bound, other
+ *         VCARD_ERROR_* on failure
+ */
+int net_receiver_start(net_receiver_t *r, int dest_id, const net_config_t *config);
+
+/**
+ * Stop the pump thread and release the receiver
+ *
+ * @param r Receiver
+ */
+void net_receiver_stop(net_receiver_t *r);
+
+/**
+ * Get statistics (any thread)
+ *
+ * @param r Receiver
+ * @param stats Output parameter for statistics
+ */
+void net_receiver_get_stats(net_receiver_t *r, net_receiver_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_DEVICE_H */
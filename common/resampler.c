@@ -0,0 +1,297 @@
+/**
+ * Virtual Sound Card - Adaptive Resampler Implementation
+ */
+
+#include "resampler.h"
+#include "vcard.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || \
+    ((defined(__i386__) || defined(_M_IX86)) && \
+     (defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+#define RESAMPLER_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define RESAMPLER_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Staged frames before the first tap of output frame 0, so it lands on input 0 */
+#define RESAMPLER_LEAD (RESAMPLER_TAPS / 2 - 1)
+
+/* Passband edge as a fraction of the lower Nyquist frequency */
+#define RESAMPLER_CUTOFF 0.9
+
+/**
+ * Windowed-sinc prototype at every phase, each phase normalized to unity gain
+ *
+ * Phase p holds the taps for an output point p / PHASES of a frame past
+ * tap RESAMPLER_LEAD; phase PHASES is phase 0 shifted by one tap, so any
+ * offset can be interpolated between a phase and the next.
+ */
+static void build_table(float *table, double cutoff)
+{
+    const double half = RESAMPLER_TAPS / 2.0;
+
+    for (uint32_t p = 0; p <= RESAMPLER_PHASES; p++) {
+        double offset = (double)p / RESAMPLER_PHASES;
+        double taps[RESAMPLER_TAPS];
+        double sum = 0.0;
+
+        for (uint32_t j = 0; j < RESAMPLER_TAPS; j++) {
+            double x = (double)j - RESAMPLER_LEAD - offset;
+            double arg = M_PI * cutoff * x;
+            double sinc = fabs(arg) < 1e-12 ? 1.0 : sin(arg) / arg;
+            double w = fabs(x) >= half ? 0.0 :
+                       0.42 + 0.5 * cos(M_PI * x / half) + 0.08 * cos(2.0 * M_PI * x / half);
+
+            taps[j] = sinc * w;
+            sum += taps[j];
+        }
+        for (uint32_t j = 0; j < RESAMPLER_TAPS; j++) {
+            table[p * RESAMPLER_TAPS + j] = (float)(taps[j] / sum);
+        }
+    }
+}
+
+/**
+ * coefs = a + t * (b - a), for the taps of one output frame
+ */
+static void interpolate_phase(float *coefs, const float *a, const float *b, float t)
+{
+    uint32_t j = 0;
+
+#if defined(RESAMPLER_HAVE_SSE2)
+    __m128 vt = _mm_set1_ps(t);
+    for (; j < RESAMPLER_TAPS; j += 4) {
+        __m128 va = _mm_loadu_ps(a + j);
+        _mm_storeu_ps(coefs + j,
+                      _mm_add_ps(va, _mm_mul_ps(vt, _mm_sub_ps(_mm_loadu_ps(b + j), va))));
+    }
+#elif defined(RESAMPLER_HAVE_NEON)
+    for (; j < RESAMPLER_TAPS; j += 4) {
+        float32x4_t va = vld1q_f32(a + j);
+        vst1q_f32(coefs + j, vmlaq_n_f32(va, vsubq_f32(vld1q_f32(b + j), va), t));
+    }
+#endif
+    for (; j < RESAMPLER_TAPS; j++) {
+        coefs[j] = a[j] + t * (b[j] - a[j]);
+    }
+}
+
+/**
+ * Dot product of RESAMPLER_TAPS staged samples with a coefficient set
+ */
+static float dot_taps(const float *x, const float *coefs)
+{
+#if defined(RESAMPLER_HAVE_SSE2)
+    __m128 acc0 = _mm_mul_ps(_mm_loadu_ps(x), _mm_loadu_ps(coefs));
+    __m128 acc1 = _mm_mul_ps(_mm_loadu_ps(x + 4), _mm_loadu_ps(coefs + 4));
+    for (uint32_t j = 8; j < RESAMPLER_TAPS; j += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + j), _mm_loadu_ps(coefs + j)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + j + 4),
+                                           _mm_loadu_ps(coefs + j + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+    return _mm_cvtss_f32(acc0);
+#elif defined(RESAMPLER_HAVE_NEON)
+    float32x4_t acc0 = vmulq_f32(vld1q_f32(x), vld1q_f32(coefs));
+    float32x4_t acc1 = vmulq_f32(vld1q_f32(x + 4), vld1q_f32(coefs + 4));
+    for (uint32_t j = 8; j < RESAMPLER_TAPS; j += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(x + j), vld1q_f32(coefs + j));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(x + j + 4), vld1q_f32(coefs + j + 4));
+    }
+    return vaddvq_f32(vaddq_f32(acc0, acc1));
+#else
+    float sum = 0.0f;
+    for (uint32_t j = 0; j < RESAMPLER_TAPS; j++) {
+        sum += x[j] * coefs[j];
+    }
+    return sum;
+#endif
+}
+
+int resampler_init(resampler_t *r, uint32_t channels, uint32_t in_rate, uint32_t out_rate)
+{
+    double ratio;
+
+    memset(r, 0, sizeof(*r));
+    if (channels == 0 || channels > VCARD_MAX_CHANNELS || in_rate == 0 || out_rate == 0) {
+        return VCARD_ERROR_INVALID;
+    }
+    ratio = (double)in_rate / out_rate;
+    if (ratio > RESAMPLER_MAX_RATIO || ratio * RESAMPLER_MAX_RATIO < 1.0) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    r->table = (float *)malloc((RESAMPLER_PHASES + 1) * RESAMPLER_TAPS * sizeof(float));
+    r->staged = (float *)malloc((size_t)channels * RESAMPLER_BUFFER_FRAMES * sizeof(float));
+    r->coefs = (float *)malloc(RESAMPLER_BATCH * RESAMPLER_TAPS * sizeof(float));
+    if (!r->table || !r->staged || !r->coefs) {
+        resampler_free(r);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+
+    r->channels = channels;
+    r->out_rate = out_rate;
+    r->nominal = ratio;
+    // Downsampling moves the passband edge below the output Nyquist frequency
+    build_table(r->table, RESAMPLER_CUTOFF * (ratio > 1.0 ? 1.0 / ratio : 1.0));
+    resampler_reset(r);
+    return VCARD_SUCCESS;
+}
+
+void resampler_free(resampler_t *r)
+{
+    free(r->table);
+    free(r->staged);
+    free(r->coefs);
+    r->table = NULL;
+    r->staged = NULL;
+    r->coefs = NULL;
+    r->channels = 0;
+}
+
+void resampler_reset(resampler_t *r)
+{
+    memset(r->staged, 0, (size_t)r->channels * RESAMPLER_BUFFER_FRAMES * sizeof(float));
+    r->fill = RESAMPLER_LEAD;
+    r->pos = 0;
+    r->frac = 0.0;
+    r->adjust = 0.0;
+    r->step = r->nominal;
+    r->filtered_fill = 0.0;
+    r->integral = 0.0;
+    r->steering = 0;
+}
+
+/**
+ * Move the unconsumed tail to the front and append input
+ *
+ * Only called once the tail is shorter than the taps; a step never
+ * exceeds RESAMPLER_MAX_RATIO frames, so pos is always within the tail.
+ *
+ * @return Frames taken from the input
+ */
+static size_t stage_input(resampler_t *r, const float *const *in, size_t offset,
+                          size_t frames)
+{
+    uint32_t keep = r->fill - r->pos;
+    size_t n = RESAMPLER_BUFFER_FRAMES - keep;
+
+    if (n > frames) {
+        n = frames;
+    }
+    for (uint32_t ch = 0; ch < r->channels; ch++) {
+        float *staged = r->staged + (size_t)ch * RESAMPLER_BUFFER_FRAMES;
+        memmove(staged, staged + r->pos, keep * sizeof(float));
+        memcpy(staged + keep, in[ch] + offset, n * sizeof(float));
+    }
+    r->pos = 0;
+    r->fill = keep + (uint32_t)n;
+    return n;
+}
+
+size_t resampler_process(resampler_t *r, const float *const *in, size_t in_frames,
+                         size_t *in_used, float *const *out, size_t out_frames)
+{
+    uint32_t positions[RESAMPLER_BATCH];
+    size_t used = 0;
+    size_t done = 0;
+
+    while (done < out_frames) {
+        uint32_t count = 0;
+
+        // Coefficients for as many output frames as the staged input covers
+        while (count < RESAMPLER_BATCH && done + count < out_frames &&
+               r->pos + RESAMPLER_TAPS <= r->fill) {
+            double phase = r->frac * RESAMPLER_PHASES;
+            uint32_t p = (uint32_t)phase;
+            uint32_t advance;
+
+            if (p >= RESAMPLER_PHASES) {
+                p = RESAMPLER_PHASES - 1;
+            }
+            interpolate_phase(r->coefs + count * RESAMPLER_TAPS,
+                              r->table + p * RESAMPLER_TAPS,
+                              r->table + (p + 1) * RESAMPLER_TAPS, (float)(phase - p));
+            positions[count++] = r->pos;
+
+            r->frac += r->step;
+            advance = (uint32_t)r->frac;
+            r->frac -= advance;
+            r->pos += advance;
+        }
+
+        if (count == 0) {
+            if (used == in_frames) {
+                break;
+            }
+            used += stage_input(r, in, used, in_frames - used);
+            continue;
+        }
+
+        // Every channel reuses the batch's coefficients
+        for (uint32_t ch = 0; ch < r->channels; ch++) {
+            const float *staged = r->staged + (size_t)ch * RESAMPLER_BUFFER_FRAMES;
+            float *dst = out[ch] + done;
+
+            for (uint32_t i = 0; i < count; i++) {
+                dst[i] = dot_taps(staged + positions[i], r->coefs + i * RESAMPLER_TAPS);
+            }
+        }
+        done += count;
+    }
+
+    if (in_used) *in_used = used;
+    return done;
+}
+
+void resampler_set_adjust(resampler_t *r, double adjust)
+{
+    if (adjust > RESAMPLER_MAX_ADJUST) {
+        adjust = RESAMPLER_MAX_ADJUST;
+    } else if (adjust < -RESAMPLER_MAX_ADJUST) {
+        adjust = -RESAMPLER_MAX_ADJUST;
+    }
+    r->adjust = adjust;
+    r->step = r->nominal * (1.0 + adjust);
+}
+
+double resampler_steer(resampler_t *r, double fill, double target, double seconds)
+{
+    // Fill error changes at out_rate / target per unit of correction
+    double gain = r->out_rate / (target > 1.0 ? target : 1.0);
+    double kp = 1.0 / (gain * RESAMPLER_LOOP_SECONDS);
+    double ki = 1.0 / (4.0 * gain * RESAMPLER_LOOP_SECONDS * RESAMPLER_LOOP_SECONDS);
+    double smoothing = seconds * 8.0 / RESAMPLER_LOOP_SECONDS;
+    double error;
+
+    if (!r->steering) {
+        r->filtered_fill = fill;
+        r->steering = 1;
+    } else {
+        // Average out the sawtooth of a consumer reading whole periods
+        r->filtered_fill += (fill - r->filtered_fill) * (smoothing < 1.0 ? smoothing : 1.0);
+    }
+    error = (r->filtered_fill - target) / (target > 1.0 ? target : 1.0);
+
+    r->integral += ki * error * seconds;
+    if (r->integral > RESAMPLER_MAX_ADJUST) {
+        r->integral = RESAMPLER_MAX_ADJUST;
+    } else if (r->integral < -RESAMPLER_MAX_ADJUST) {
+        r->integral = -RESAMPLER_MAX_ADJUST;
+    }
+    resampler_set_adjust(r, kp * error + r->integral);
+    return r->adjust;
+}
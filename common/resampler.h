@@ -0,0 +1,134 @@
+/**
+ * Virtual Sound Card - Adaptive Resampler
+ *
+ * Streaming polyphase resampler for planar float audio whose ratio can be
+ * trimmed continuously, so a stream produced on one clock can be consumed
+ * on another without the buffer between them drifting full or empty.
+ *
+ * The prototype is a Blackman-windowed sinc of RESAMPLER_TAPS taps stored
+ * at RESAMPLER_PHASES fractional offsets. For every output frame the two
+ * neighbouring phases are interpolated once into a coefficient set that
+ * all channels share, then each channel is a single RESAMPLER_TAPS-tap
+ * SIMD dot product; the cost is fixed per output sample whatever the
+ * ratio. Nothing is allocated after resampler_init().
+ *
+ * resampler_steer() is a PI controller on a measured buffer fill: the
+ * proportional term pulls the fill back to its target and the integral
+ * term settles at the clocks' actual ratio, so the fill stays put on
+ * arbitrarily long runs instead of creeping.
+ */
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RESAMPLER_TAPS 16                /* Filter length (multiple of 4) */
+#define RESAMPLER_PHASES 128             /* Fractional offsets in the table */
+#define RESAMPLER_BATCH 64               /* Output frames per shared coefficient batch */
+#define RESAMPLER_BUFFER_FRAMES 512      /* Input staged per channel */
+#define RESAMPLER_MAX_ADJUST 0.005       /* Largest steering correction (0.5%) */
+#define RESAMPLER_MAX_RATIO 8            /* Largest in/out or out/in rate ratio */
+#define RESAMPLER_LOOP_SECONDS 2.0       /* Time constant of the fill controller */
+
+/**
+ * Resampler state
+ */
+typedef struct {
+    uint32_t channels;
+    double out_rate;                     /* Output rate in Hz, for the controller gain */
+    double nominal;                      /* Input frames per output frame */
+    double adjust;                       /* Steering correction, +-MAX_ADJUST */
+    double step;                         /* nominal * (1 + adjust) */
+    double frac;                         /* Position between staged frames pos and pos + 1 */
+    uint32_t pos;                        /* First tap of the next output frame */
+    uint32_t fill;                       /* Frames staged per channel */
+    float *table;                        /* (PHASES + 1) x TAPS prototype */
+    float *staged;                       /* channels x BUFFER_FRAMES input */
+    float *coefs;                        /* BATCH x TAPS interpolated coefficients */
+
+    /* Fill controller (resampler_steer) */
+    double filtered_fill;
+    double integral;
+    int steering;                        /* First measurement taken */
+} resampler_t;
+
+/**
+ * Initialize a resampler
+ *
+ * @param r Resampler to initialize
+ * @param channels Number of planar channels (1-32)
+ * @param in_rate Input sample rate in Hz
+ * @param out_rate Output sample rate in Hz (within RESAMPLER_MAX_RATIO of in_rate)
+ * @return 0 on success, VCARD_ERROR_INVALID or VCARD_ERROR_NO_MEMORY
+ */
+int resampler_init(resampler_t *r, uint32_t channels, uint32_t in_rate, uint32_t out_rate);
+
+/**
+ * Release the storage of a resampler
+ *
+ * @param r Resampler
+ */
+void resampler_free(resampler_t *r);
+
+/**
+ * Drop staged input and controller state
+ *
+ * @param r Resampler
+ */
+void resampler_reset(resampler_t *r);
+
+/**
+ * Resample planar input into planar output
+ *
+ * Consumes input until either the input is used up or the output is full.
+ * Up to RESAMPLER_BUFFER_FRAMES consumed frames may still be staged when
+ * it returns; later calls render them first, so a call with no input
+ * drains all but the last RESAMPLER_TAPS frames. Output frame k
+ * of the stream is the input evaluated at k * step, so a fixed ratio
+ * introduces no delay beyond the taps of lookahead.
+ *
+ * @param r Resampler
+ * @param in channels input buffers
+ * @param in_frames Frames available in each input buffer
+ * @param in_used Output parameter for frames consumed from the input
+ * @param out channels output buffers
+ * @param out_frames Capacity of each output buffer in frames
+ * @return Frames written to each output buffer
+ */
+size_t resampler_process(resampler_t *r, const float *const *in, size_t in_frames,
+                         size_t *in_used, float *const *out, size_t out_frames);
+
+/**
+ * Set the steering correction directly
+ *
+ * @param r Resampler
+ * @param adjust Relative increase of the input consumed per output frame,
+ *               clamped to +-RESAMPLER_MAX_ADJUST
+ */
+void resampler_set_adjust(resampler_t *r, double adjust);
+
+/**
+ * Steer the ratio from the fill of the buffer the output goes into
+ *
+ * Call regularly (every period or pump cycle). A fill above the target
+ * makes the resampler consume input faster, producing fewer frames.
+ *
+ * @param r Resampler
+ * @param fill Frames currently in the downstream buffer
+ * @param target Fill to hold
+ * @param seconds Time since the previous call
+ * @return The correction now in effect
+ */
+double resampler_steer(resampler_t *r, double fill, double target, double seconds);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RESAMPLER_H */
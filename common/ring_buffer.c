@@ -0,0 +1,162 @@
+/**
+ * Lock-free SPSC Ring Buffer Implementation
+ */
+
+#include "ring_buffer.h"
+#include "vcard.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Largest supported capacity (keeps index differences unambiguous) */
+#define RING_BUFFER_MAX_CAPACITY (1u << 30)
+
+int ring_buffer_init(ring_buffer_t *rb, uint32_t min_capacity)
+{
+    uint32_t capacity = 1;
+
+    memset(rb, 0, sizeof(*rb));
+    if (min_capacity == 0 || min_capacity > RING_BUFFER_MAX_CAPACITY) {
+        return VCARD_ERROR_INVALID;
+    }
+    while (capacity < min_capacity) {
+        capacity <<= 1;
+    }
+
+    rb->data = (float *)calloc(capacity, sizeof(float));
+    if (!rb->data) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    rb->capacity = capacity;
+    rb->mask = capacity - 1;
+    vcard_atomic_store_relaxed_u32(&rb->write_index, 0);
+    vcard_atomic_store_relaxed_u32(&rb->read_index, 0);
+    return VCARD_SUCCESS;
+}
+
+void ring_buffer_free(ring_buffer_t *rb)
+{
+    free(rb->data);
+    rb->data = NULL;
+    rb->capacity = 0;
+    rb->mask = 0;
+}
+
+void ring_buffer_reset(ring_buffer_t *rb)
+{
+    vcard_atomic_store_relaxed_u32(&rb->write_index, 0);
+    vcard_atomic_store_relaxed_u32(&rb->read_index, 0);
+    rb->cached_read_index = 0;
+    rb->cached_write_index = 0;
+}
+
+uint32_t ring_buffer_read_available(ring_buffer_t *rb)
+{
+    uint32_t w = vcard_atomic_load_acquire_u32(&rb->write_index);
+    uint32_t r = vcard_atomic_load_relaxed_u32(&rb->read_index);
+    return w - r;
+}
+
+uint32_t ring_buffer_write_available(ring_buffer_t *rb)
+{
+    uint32_t w = vcard_atomic_load_relaxed_u32(&rb->write_index);
+    uint32_t r = vcard_atomic_load_acquire_u32(&rb->read_index);
+    return rb->capacity - (w - r);
+}
+
+uint32_t ring_buffer_get_write_regions(ring_buffer_t *rb, uint32_t count,
+                                       float **region1, uint32_t *size1,
+                                       float **region2, uint32_t *size2)
+{
+    uint32_t w = vcard_atomic_load_relaxed_u32(&rb->write_index);
+    uint32_t free_space = rb->capacity - (w - rb->cached_read_index);
+
+    // Only reload the consumer's index when the cached value is exhausted
+    if (free_space < count) {
+        rb->cached_read_index = vcard_atomic_load_acquire_u32(&rb->read_index);
+        free_space = rb->capacity - (w - rb->cached_read_index);
+    }
+    if (count > free_space) {
+        count = free_space;
+    }
+
+    uint32_t offset = w & rb->mask;
+    uint32_t first = rb->capacity - offset;
+    if (first > count) {
+        first = count;
+    }
+    *region1 = rb->data + offset;
+    *size1 = first;
+    *region2 = count > first ? rb->data : NULL;
+    *size2 = count - first;
+    return count;
+}
+
+void ring_buffer_commit_write(ring_buffer_t *rb, uint32_t count)
+{
+    uint32_t w = vcard_atomic_load_relaxed_u32(&rb->write_index);
+    vcard_atomic_store_release_u32(&rb->write_index, w + count);
+}
+
+uint32_t ring_buffer_get_read_regions(ring_buffer_t *rb, uint32_t count,
+                                      const float **region1, uint32_t *size1,
+                                      const float **region2, uint32_t *size2)
+{
+    uint32_t r = vcard_atomic_load_relaxed_u32(&rb->read_index);
+    uint32_t available = rb->cached_write_index - r;
+
+    // Only reload the producer's index when the cached value is exhausted
+    if (available < count) {
+        rb->cached_write_index = vcard_atomic_load_acquire_u32(&rb->write_index);
+        available = rb->cached_write_index - r;
+    }
+    if (count > available) {
+        count = available;
+    }
+
+    uint32_t offset = r & rb->mask;
+    uint32_t first = rb->capacity - offset;
+    if (first > count) {
+        first = count;
+    }
+    *region1 = rb->data + offset;
+    *size1 = first;
+    *region2 = count > first ? rb->data : NULL;
+    *size2 = count - first;
+    return count;
+}
+
+void ring_buffer_commit_read(ring_buffer_t *rb, uint32_t count)
+{
+    uint32_t r = vcard_atomic_load_relaxed_u32(&rb->read_index);
+    vcard_atomic_store_release_u32(&rb->read_index, r + count);
+}
+
+uint32_t ring_buffer_write(ring_buffer_t *rb, const float *src, uint32_t count)
+{
+    float *region1, *region2;
+    uint32_t size1, size2;
+
+    count = ring_buffer_get_write_regions(rb, count, &region1, &size1,
+                                          &region2, &size2);
+    memcpy(region1, src, size1 * sizeof(float));
+    if (size2) {
+        memcpy(region2, src + size1, size2 * sizeof(float));
+    }
+    ring_buffer_commit_write(rb, count);
+    return count;
+}
+
+uint32_t ring_buffer_read(ring_buffer_t *rb, float *dst, uint32_t count)
+{
+    const float *region1, *region2;
+    uint32_t size1, size2;
+
+    count = ring_buffer_get_read_regions(rb, count, &region1, &size1,
+                                         &region2, &size2);
+    memcpy(dst, region1, size1 * sizeof(float));
+    if (size2) {
+        memcpy(dst + size1, region2, size2 * sizeof(float));
+    }
+    ring_buffer_commit_read(rb, count);
+    return count;
+}
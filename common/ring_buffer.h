@@ -0,0 +1,160 @@
+/**
+ * Lock-free Single-Producer/Single-Consumer Ring Buffer
+ *
+ * Wait-free ring of float samples for exchanging audio between exactly one
+ * producer thread and one consumer thread. The read and write indices live
+ * on separate cache lines, and each side keeps a cached copy of the other
+ * side's index so the shared line is only touched when the cache runs out.
+ */
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vcard_atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Ring buffer state
+ *
+ * Indices are free-running and wrap modulo 2^32; the capacity is a power
+ * of two so positions are obtained with a mask.
+ */
+typedef struct {
+    /* Shared, read-only after ring_buffer_init() */
+    float *data;
+    uint32_t capacity;
+    uint32_t mask;
+    char pad0[VCARD_CACHELINE];
+
+    /* Producer-owned line */
+    vcard_atomic_u32 write_index;
+    uint32_t cached_read_index;
+    char pad1[VCARD_CACHELINE - 2 * sizeof(uint32_t)];
+
+    /* Consumer-owned line */
+    vcard_atomic_u32 read_index;
+    uint32_t cached_write_index;
+    char pad2[VCARD_CACHELINE - 2 * sizeof(uint32_t)];
+} ring_buffer_t;
+
+/**
+ * Initialize a ring buffer
+ *
+ * @param rb Ring buffer to initialize
+ * @param min_capacity Minimum capacity in samples (rounded up to a power of two)
+ * @return 0 on success, VCARD_ERROR_* on failure
+ */
+int ring_buffer_init(ring_buffer_t *rb, uint32_t min_capacity);
+
+/**
+ * Release the storage of a ring buffer
+ *
+ * @param rb Ring buffer
+ */
+void ring_buffer_free(ring_buffer_t *rb);
+
+/**
+ * Discard all buffered samples
+ *
+ * Must not be called while the producer or consumer is active.
+ *
+ * @param rb Ring buffer
+ */
+void ring_buffer_reset(ring_buffer_t *rb);
+
+/**
+ * Number of samples available to the consumer
+ *
+ * @param rb Ring buffer
+ * @return Samples that can be read
+ */
+uint32_t ring_buffer_read_available(ring_buffer_t *rb);
+
+/**
+ * Number of samples that the producer can write
+ *
+ * @param rb Ring buffer
+ * @return Free space in samples
+ */
+uint32_t ring_buffer_write_available(ring_buffer_t *rb);
+
+/**
+ * Copy samples into the ring (producer side)
+ *
+ * @param rb Ring buffer
+ * @param src Samples to write
+ * @param count Number of samples
+ * @return Number of samples written (less than count if the ring is full)
+ */
+uint32_t ring_buffer_write(ring_buffer_t *rb, const float *src, uint32_t count);
+
+/**
+ * Copy samples out of the ring (consumer side)
+ *
+ * @param rb Ring buffer
+ * @param dst Destination buffer
+ * @param count Number of samples requested
+ * @return Number of samples read (less than count if the ring runs empty)
+ */
+uint32_t ring_buffer_read(ring_buffer_t *rb, float *dst, uint32_t count);
+
+/**
+ * Get writable regions for zero-copy rendering (producer side)
+ *
+ * Up to two contiguous regions are returned because the free space may wrap
+ * around the end of the storage. Render into them, then call
+ * ring_buffer_commit_write().
+ *
+ * @param rb Ring buffer
+ * @param count Number of samples wanted
+ * @param region1 First region
+ * @param size1 Samples in the first region
+ * @param region2 Second region (NULL if not needed)
+ * @param size2 Samples in the second region
+ * @return Total samples available in both regions (<= count)
+ */
+uint32_t ring_buffer_get_write_regions(ring_buffer_t *rb, uint32_t count,
+                                       float **region1, uint32_t *size1,
+                                       float **region2, uint32_t *size2);
+
+/**
+ * Publish samples rendered into the write regions
+ *
+ * @param rb Ring buffer
+ * @param count Number of samples to publish
+ */
+void ring_buffer_commit_write(ring_buffer_t *rb, uint32_t count);
+
+/**
+ * Get readable regions for zero-copy consumption (consumer side)
+ *
+ * @param rb Ring buffer
+ * @param count Number of samples wanted
+ * @param region1 First region
+ * @param size1 Samples in the first region
+ * @param region2 Second region (NULL if not needed)
+ * @param size2 Samples in the second region
+ * @return Total samples available in both regions (<= count)
+ */
+uint32_t ring_buffer_get_read_regions(ring_buffer_t *rb, uint32_t count,
+                                      const float **region1, uint32_t *size1,
+                                      const float **region2, uint32_t *size2);
+
+/**
+ * Release samples consumed from the read regions
+ *
+ * @param rb Ring buffer
+ * @param count Number of samples to release
+ */
+void ring_buffer_commit_read(ring_buffer_t *rb, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RING_BUFFER_H */
@@ -0,0 +1,295 @@
+/**
+ * Virtual Sound Card - Routing Matrix Mixer Implementation
+ */
+
+#include "routing_mixer.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || \
+    ((defined(__i386__) || defined(_M_IX86)) && \
+     (defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)))
+#define ROUTING_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define ROUTING_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* Set in the middle slot index when it holds a matrix the reader hasn't seen */
+#define ROUTING_MIXER_FRESH 4u
+#define ROUTING_MIXER_SLOT_MASK 3u
+
+void routing_mix_gain(float *dst, const float *src, float gain, uint32_t frames)
+{
+    uint32_t i = 0;
+
+#if defined(ROUTING_HAVE_SSE2)
+    __m128 g = _mm_set1_ps(gain);
+    for (; i + 8 <= frames; i += 8) {
+        __m128 a = _mm_add_ps(_mm_loadu_ps(dst + i),
+                              _mm_mul_ps(g, _mm_loadu_ps(src + i)));
+        __m128 b = _mm_add_ps(_mm_loadu_ps(dst + i + 4),
+                              _mm_mul_ps(g, _mm_loadu_ps(src + i + 4)));
+        _mm_storeu_ps(dst + i, a);
+        _mm_storeu_ps(dst + i + 4, b);
+    }
+#elif defined(ROUTING_HAVE_NEON)
+    float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 8 <= frames; i += 8) {
+        vst1q_f32(dst + i, vmlaq_f32(vld1q_f32(dst + i), g, vld1q_f32(src + i)));
+        vst1q_f32(dst + i + 4, vmlaq_f32(vld1q_f32(dst + i + 4), g,
+                                         vld1q_f32(src + i + 4)));
+    }
+#endif
+    for (; i < frames; i++) {
+        dst[i] += gain * src[i];
+    }
+}
+
+void routing_mix_ramp(float *dst, const float *src, float gain, float step,
+                      uint32_t frames)
+{
+    uint32_t i = 0;
+
+#if defined(ROUTING_HAVE_SSE2)
+    __m128 g = _mm_setr_ps(gain, gain + step, gain + 2.0f * step, gain + 3.0f * step);
+    __m128 inc = _mm_set1_ps(4.0f * step);
+    for (; i + 4 <= frames; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i),
+                                          _mm_mul_ps(g, _mm_loadu_ps(src + i))));
+        g = _mm_add_ps(g, inc);
+    }
+#elif defined(ROUTING_HAVE_NEON)
+    const float lanes[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+    float32x4_t g = vmlaq_n_f32(vdupq_n_f32(gain), vld1q_f32(lanes), step);
+    float32x4_t inc = vdupq_n_f32(4.0f * step);
+    for (; i + 4 <= frames; i += 4) {
+        vst1q_f32(dst + i, vmlaq_f32(vld1q_f32(dst + i), g, vld1q_f32(src + i)));
+        g = vaddq_f32(g, inc);
+    }
+#endif
+    for (; i < frames; i++) {
+        dst[i] += (gain + (float)i * step) * src[i];
+    }
+}
+
+/**
+ * Build a compiled matrix from a validated route list
+ */
+static void compile_matrix(routing_matrix_t *matrix, const vcard_routing_t *routing,
+                           uint32_t channels_in, uint32_t channels_out)
+{
+    uint32_t n = 0;
+
+    matrix->identity = routing->num_routes == 0;
+    if (matrix->identity) {
+        uint32_t channels = channels_in < channels_out ? channels_in : channels_out;
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            matrix->pairs[ch].dest = (uint8_t)ch;
+            matrix->pairs[ch].src = (uint8_t)ch;
+            matrix->pairs[ch].gain = 1.0f;
+        }
+        matrix->num_pairs = channels;
+        return;
+    }
+
+    // Insertion sort by (dest, src), summing duplicate routes
+    for (int r = 0; r < routing->num_routes; r++) {
+        uint8_t dest = (uint8_t)routing->routes[r].dest_channel;
+        uint8_t src = (uint8_t)routing->routes[r].source_channel;
+        uint32_t key = ((uint32_t)dest << 8) | src;
+        uint32_t pos = n;
+
+        while (pos > 0 &&
+               (((uint32_t)matrix->pairs[pos - 1].dest << 8) | matrix->pairs[pos - 1].src) > key) {
+            pos--;
+        }
+        if (pos > 0 && matrix->pairs[pos - 1].dest == dest &&
+            matrix->pairs[pos - 1].src == src) {
+            matrix->pairs[pos - 1].gain += routing->routes[r].gain;
+            continue;
+        }
+        memmove(&matrix->pairs[pos + 1], &matrix->pairs[pos],
+                (n - pos) * sizeof(routing_pair_t));
+        matrix->pairs[pos].dest = dest;
+        matrix->pairs[pos].src = src;
+        matrix->pairs[pos].gain = routing->routes[r].gain;
+        n++;
+    }
+
+    // Routes that cancel out (or were set to 0) cost nothing to skip
+    matrix->num_pairs = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (matrix->pairs[i].gain != 0.0f) {
+            matrix->pairs[matrix->num_pairs++] = matrix->pairs[i];
+        }
+    }
+}
+
+/**
+ * Retarget the active pair list at a new matrix (audio thread)
+ *
+ * Only called between ramps, so current[] holds the applied gains.
+ */
+static void install_matrix(routing_mixer_t *mixer, const routing_matrix_t *matrix)
+{
+    uint32_t in_new[VCARD_MAX_CHANNELS];
+    routing_active_t next[2 * VCARD_MAX_ROUTES];
+    uint32_t n = 0;
+    int ramping = 0;
+
+    memset(in_new, 0, sizeof(in_new));
+
+    for (uint32_t i = 0; i < matrix->num_pairs; i++) {
+        const routing_pair_t *p = &matrix->pairs[i];
+        next[n].dest = p->dest;
+        next[n].src = p->src;
+        next[n].from = mixer->current[p->dest][p->src];
+        next[n].to = p->gain;
+        ramping |= next[n].from != next[n].to;
+        in_new[p->dest] |= 1u << p->src;
+        n++;
+    }
+    // Pairs dropped by the new matrix fade out
+    for (uint32_t i = 0; i < mixer->num_active; i++) {
+        const routing_active_t *a = &mixer->active[i];
+        if (in_new[a->dest] & (1u << a->src)) {
+            continue;
+        }
+        next[n].dest = a->dest;
+        next[n].src = a->src;
+        next[n].from = mixer->current[a->dest][a->src];
+        next[n].to = 0.0f;
+        ramping |= next[n].from != 0.0f;
+        n++;
+    }
+
+    memcpy(mixer->active, next, n * sizeof(routing_active_t));
+    mixer->num_active = n;
+    mixer->ramp_pos = ramping ? 0 : ROUTING_MIXER_RAMP_FRAMES;
+    mixer->identity = matrix->identity && !ramping;
+}
+
+/**
+ * Apply the end of a completed ramp and drop pairs that faded out
+ */
+static void finish_ramp(routing_mixer_t *mixer)
+{
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < mixer->num_active; i++) {
+        routing_active_t a = mixer->active[i];
+        mixer->current[a.dest][a.src] = a.to;
+        if (a.to != 0.0f) {
+            a.from = a.to;
+            mixer->active[n++] = a;
+        }
+    }
+    mixer->num_active = n;
+    mixer->identity = mixer->slots[mixer->front].identity;
+}
+
+int routing_mixer_init(routing_mixer_t *mixer, uint32_t channels_in,
+                       uint32_t channels_out)
+{
+    vcard_routing_t empty;
+
+    if (channels_in < 1 || channels_in > VCARD_MAX_CHANNELS ||
+        channels_out < 1 || channels_out > VCARD_MAX_CHANNELS) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    memset(mixer, 0, sizeof(*mixer));
+    mixer->channels_in = channels_in;
+    mixer->channels_out = channels_out;
+
+    // Start in steady identity: front holds it, no ramp
+    empty.num_routes = 0;
+    compile_matrix(&mixer->slots[0], &empty, channels_in, channels_out);
+    mixer->front = 0;
+    vcard_atomic_store_relaxed_u32(&mixer->middle, 1);
+    mixer->back = 2;
+    for (uint32_t i = 0; i < mixer->slots[0].num_pairs; i++) {
+        const routing_pair_t *p = &mixer->slots[0].pairs[i];
+        mixer->active[i].dest = p->dest;
+        mixer->active[i].src = p->src;
+        mixer->active[i].from = p->gain;
+        mixer->active[i].to = p->gain;
+        mixer->current[p->dest][p->src] = p->gain;
+    }
+    mixer->num_active = mixer->slots[0].num_pairs;
+    mixer->ramp_pos = ROUTING_MIXER_RAMP_FRAMES;
+    mixer->identity = 1;
+    return VCARD_SUCCESS;
+}
+
+void routing_mixer_publish(routing_mixer_t *mixer, const vcard_routing_t *routing)
+{
+    compile_matrix(&mixer->slots[mixer->back], routing, mixer->channels_in,
+                   mixer->channels_out);
+    mixer->back = vcard_atomic_exchange_u32(&mixer->middle,
+                                            mixer->back | ROUTING_MIXER_FRESH) &
+                  ROUTING_MIXER_SLOT_MASK;
+}
+
+int routing_mixer_begin(routing_mixer_t *mixer)
+{
+    // A matrix published mid-ramp waits for the ramp to finish, which also
+    // bounds the active list to the old and new pairs
+    if (mixer->ramp_pos == ROUTING_MIXER_RAMP_FRAMES &&
+        (vcard_atomic_load_relaxed_u32(&mixer->middle) & ROUTING_MIXER_FRESH)) {
+        mixer->front = vcard_atomic_exchange_u32(&mixer->middle, mixer->front) &
+                       ROUTING_MIXER_SLOT_MASK;
+        install_matrix(mixer, &mixer->slots[mixer->front]);
+    }
+    return mixer->identity;
+}
+
+void routing_mixer_process(routing_mixer_t *mixer, const float *const *src,
+                           float *const *dst, uint32_t frames)
+{
+    uint32_t done = 0;
+
+    for (uint32_t ch = 0; ch < mixer->channels_in; ch++) {
+        if (dst[ch]) {
+            memset(dst[ch], 0, frames * sizeof(float));
+        }
+    }
+
+    while (done < frames) {
+        uint32_t n = frames - done;
+
+        if (mixer->ramp_pos < ROUTING_MIXER_RAMP_FRAMES) {
+            const float inv = 1.0f / ROUTING_MIXER_RAMP_FRAMES;
+            uint32_t left = ROUTING_MIXER_RAMP_FRAMES - mixer->ramp_pos;
+            float t = (float)mixer->ramp_pos * inv;
+
+            if (n > left) {
+                n = left;
+            }
+            for (uint32_t i = 0; i < mixer->num_active; i++) {
+                const routing_active_t *a = &mixer->active[i];
+                float delta = a->to - a->from;
+                if (dst[a->dest]) {
+                    routing_mix_ramp(dst[a->dest] + done, src[a->src] + done,
+                                     a->from + delta * t, delta * inv, n);
+                }
+            }
+            mixer->ramp_pos += n;
+            if (mixer->ramp_pos == ROUTING_MIXER_RAMP_FRAMES) {
+                finish_ramp(mixer);
+            }
+        } else {
+            for (uint32_t i = 0; i < mixer->num_active; i++) {
+                const routing_active_t *a = &mixer->active[i];
+                if (dst[a->dest]) {
+                    routing_mix_gain(dst[a->dest] + done, src[a->src] + done,
+                                     a->to, n);
+                }
+            }
+        }
+        done += n;
+    }
+}
@@ -0,0 +1,143 @@
+/**
+ * Virtual Sound Card - Routing Matrix Mixer
+ *
+ * Applies a vcard_routing_t to planar audio. The route list is compiled
+ * into a sparse gain matrix (duplicate routes summed, sorted by
+ * destination) on the control thread and published through a wait-free
+ * triple buffer, so the audio thread always sees a complete table and
+ * nothing is allocated or freed on either side. Gain changes ramp
+ * linearly over ROUTING_MIXER_RAMP_FRAMES; the ramp is applied per block
+ * by the multiply-accumulate kernels, without per-sample branching.
+ */
+
+#ifndef ROUTING_MIXER_H
+#define ROUTING_MIXER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vcard.h"
+#include "vcard_atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Length of the gain ramp applied when a new routing is installed */
+#define ROUTING_MIXER_RAMP_FRAMES 256
+
+/**
+ * One (source, destination, gain) entry of a compiled matrix
+ */
+typedef struct {
+    uint8_t dest;
+    uint8_t src;
+    float gain;
+} routing_pair_t;
+
+/**
+ * Compiled routing matrix
+ */
+typedef struct {
+    routing_pair_t pairs[VCARD_MAX_ROUTES];
+    uint32_t num_pairs;
+    int identity;                        /* Unit-gain channel N -> N mapping */
+} routing_matrix_t;
+
+/**
+ * Pair being mixed by the audio thread, ramping from one gain to another
+ */
+typedef struct {
+    uint8_t dest;
+    uint8_t src;
+    float from;
+    float to;
+} routing_active_t;
+
+/**
+ * Mixer state
+ */
+typedef struct {
+    /* Triple buffer: the writer owns back, the reader owns front */
+    routing_matrix_t slots[3];
+    vcard_atomic_u32 middle;
+    char pad0[VCARD_CACHELINE];
+
+    /* Immutable after routing_mixer_init() */
+    uint32_t channels_in;
+    uint32_t channels_out;
+
+    /* Control-thread owned */
+    uint32_t back;
+
+    /* Audio-thread owned */
+    uint32_t front;
+    uint32_t ramp_pos;                   /* Frames into the ramp; RAMP_FRAMES when idle */
+    uint32_t num_active;
+    int identity;                        /* Steady identity mapping (no ramp) */
+    routing_active_t active[2 * VCARD_MAX_ROUTES];
+    float current[VCARD_MAX_CHANNELS][VCARD_MAX_CHANNELS]; /* Applied gain [dest][src] */
+} routing_mixer_t;
+
+/**
+ * Initialize a mixer with the identity mapping
+ *
+ * @param mixer Mixer to initialize
+ * @param channels_in Destination (input) channel count
+ * @param channels_out Source (output) channel count
+ * @return 0 on success, VCARD_ERROR_INVALID for bad channel counts
+ */
+int routing_mixer_init(routing_mixer_t *mixer, uint32_t channels_in,
+                       uint32_t channels_out);
+
+/**
+ * Compile and publish a routing (control thread)
+ *
+ * An empty route list selects the identity mapping. Routes must already
+ * be validated against the channel counts. Wait-free; one writer thread.
+ *
+ * @param mixer Mixer
+ * @param routing Routing configuration
+ */
+void routing_mixer_publish(routing_mixer_t *mixer, const vcard_routing_t *routing);
+
+/**
+ * Pick up a newly published matrix (audio thread)
+ *
+ * Call once before processing a period.
+ *
+ * @param mixer Mixer
+ * @return 1 if the mixer is a steady identity mapping, so the caller may
+ *         copy channels straight through instead of calling process
+ */
+int routing_mixer_begin(routing_mixer_t *mixer);
+
+/**
+ * Mix planar source channels into planar destination channels (audio thread)
+ *
+ * Destination channels without a route are zeroed. NULL destination
+ * entries are skipped.
+ *
+ * @param mixer Mixer
+ * @param src channels_out source buffers
+ * @param dst channels_in destination buffers
+ * @param frames Number of frames
+ */
+void routing_mixer_process(routing_mixer_t *mixer, const float *const *src,
+                           float *const *dst, uint32_t frames);
+
+/**
+ * dst[i] += gain * src[i]
+ */
+void routing_mix_gain(float *dst, const float *src, float gain, uint32_t frames);
+
+/**
+ * dst[i] += (gain + i * step) * src[i]
+ */
+void routing_mix_ramp(float *dst, const float *src, float gain, float step,
+                      uint32_t frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ROUTING_MIXER_H */
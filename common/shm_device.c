@@ -0,0 +1,690 @@
+/**
+ * Virtual Sound Card - Shared-Memory Device Implementation
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#if defined(__linux__)
+#define _GNU_SOURCE                      /* syscall */
+#elif defined(__APPLE__)
+#define _DARWIN_C_SOURCE                 /* os_sync_wait_on_address */
+#endif
+
+#include "shm_device.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <limits.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#define SHM_HAVE_FUTEX 1
+#endif
+
+#if defined(__APPLE__) && defined(__has_include)
+#if __has_include(<os/os_sync_wait_on_address.h>)
+#include <os/os_sync_wait_on_address.h>
+#define SHM_HAVE_OS_SYNC 1
+#endif
+#endif
+
+#define SHM_DEVICE_MAGIC 0x4d485356u         /* "VSHM" */
+#define SHM_DEVICE_VERSION 1
+
+/* Sleep between checks where the OS has no shared-address wait */
+#define SHM_DEVICE_POLL_US 250
+
+static int valid_name(const char *name)
+{
+    size_t len = 0;
+
+    if (!name) {
+        return 0;
+    }
+    for (; name[len]; len++) {
+        char c = name[len];
+        if (len >= SHM_DEVICE_MAX_NAME ||
+            !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+              (c >= '0' && c <= '9') || c == '-' || c == '_')) {
+            return 0;
+        }
+    }
+    return len > 0;
+}
+
+static size_t segment_size(uint32_t channels, uint32_t capacity)
+{
+    return sizeof(shm_device_header_t) + (size_t)channels * capacity * sizeof(float);
+}
+
+/**
+ * Fill in the per-process fields from a published header
+ */
+static void attach_layout(shm_device_t *d)
+{
+    d->data = (float *)(d->header + 1);
+    d->channels = d->header->channels;
+    d->sample_rate = d->header->sample_rate;
+    d->capacity = d->header->capacity;
+    d->mask = d->capacity - 1;
+    d->cached_read_index = vcard_atomic_load_acquire_u32(&d->header->read_index);
+    d->cached_write_index = vcard_atomic_load_acquire_u32(&d->header->write_index);
+}
+
+/* Platform segments and wake-ups */
+
+#ifdef _WIN32
+
+static void object_name(char *buf, size_t size, const char *name, const char *suffix)
+{
+    snprintf(buf, size, "Local\\vcard-%s%s", name, suffix);
+}
+
+static void unmap_segment(shm_device_t *d)
+{
+    if (d->header) UnmapViewOfFile(d->header);
+    if (d->mapping) CloseHandle(d->mapping);
+    if (d->readable_event) CloseHandle(d->readable_event);
+    if (d->writable_event) CloseHandle(d->writable_event);
+    d->header = NULL;
+    d->mapping = NULL;
+    d->readable_event = NULL;
+    d->writable_event = NULL;
+}
+
+static int open_events(shm_device_t *d)
+{
+    char path[64];
+
+    // Auto-reset: one SetEvent releases one wait, or the next one
+    object_name(path, sizeof(path), d->name, "-readable");
+    d->readable_event = CreateEventA(NULL, FALSE, FALSE, path);
+    object_name(path, sizeof(path), d->name, "-writable");
+    d->writable_event = CreateEventA(NULL, FALSE, FALSE, path);
+    return d->readable_event && d->writable_event ? VCARD_SUCCESS : VCARD_ERROR_IO;
+}
+
+static int map_segment(shm_device_t *d, size_t size)
+{
+    char path[64];
+    DWORD error;
+
+    object_name(path, sizeof(path), d->name, "");
+    if (size) {
+        d->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                        (DWORD)((uint64_t)size >> 32), (DWORD)size, path);
+        error = GetLastError();
+        if (d->mapping && error == ERROR_ALREADY_EXISTS) {
+            CloseHandle(d->mapping);
+            d->mapping = NULL;
+            return VCARD_ERROR_IN_USE;
+        }
+    } else {
+        d->mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path);
+        error = GetLastError();
+    }
+    if (!d->mapping) {
+        return error == ERROR_FILE_NOT_FOUND ? VCARD_ERROR_NOT_FOUND :
+               error == ERROR_ACCESS_DENIED ? VCARD_ERROR_PERMISSION : VCARD_ERROR_IO;
+    }
+    d->header = (shm_device_header_t *)MapViewOfFile(d->mapping, FILE_MAP_ALL_ACCESS,
+                                                     0, 0, size);
+    if (!d->header || open_events(d) != VCARD_SUCCESS) {
+        unmap_segment(d);
+        return VCARD_ERROR_IO;
+    }
+    return VCARD_SUCCESS;
+}
+
+static void wait_for(shm_device_t *d, vcard_atomic_u32 *seq, uint32_t value,
+                     uint64_t timeout_ns)
+{
+    (void)value;
+    WaitForSingleObject(seq == &d->header->readable_seq ? d->readable_event :
+                                                         d->writable_event,
+                        (DWORD)((timeout_ns + 999999u) / 1000000u));
+}
+
+static void wake(shm_device_t *d, vcard_atomic_u32 *seq)
+{
+    SetEvent(seq == &d->header->readable_seq ? d->readable_event : d->writable_event);
+}
+
+int shm_device_unlink(const char *name)
+{
+    return valid_name(name) ? VCARD_SUCCESS : VCARD_ERROR_INVALID;
+}
+
+#else
+
+static void object_name(char *buf, size_t size, const char *name)
+{
+    snprintf(buf, size, "/vcard-%s", name);
+}
+
+static int errno_result(int err)
+{
+    switch (err) {
+    case ENOENT: return VCARD_ERROR_NOT_FOUND;
+    case EEXIST: return VCARD_ERROR_IN_USE;
+    case EACCES: return VCARD_ERROR_PERMISSION;
+    case ENOMEM: return VCARD_ERROR_NO_MEMORY;
+    default: return VCARD_ERROR_IO;
+    }
+}
+
+static int map_segment(shm_device_t *d, size_t size)
+{
+    char path[64];
+    struct stat st;
+    void *addr;
+    int fd;
+
+    object_name(path, sizeof(path), d->name);
+    fd = size ? shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600) : shm_open(path, O_RDWR, 0);
+    if (fd < 0) {
+        return errno_result(errno);
+    }
+    if (size) {
+        if (ftruncate(fd, (off_t)size) != 0) {
+            int result = errno_result(errno);
+            close(fd);
+            shm_unlink(path);
+            return result;
+        }
+    } else {
+        // Not sized yet: the creator is still setting up
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shm_device_header_t)) {
+            close(fd);
+            return VCARD_ERROR_NOT_FOUND;
+        }
+        size = (size_t)st.st_size;
+    }
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        int result = errno_result(errno);
+        if (d->owner) {
+            shm_unlink(path);
+        }
+        return result;
+    }
+    d->header = (shm_device_header_t *)addr;
+    d->size = size;
+    return VCARD_SUCCESS;
+}
+
+static void unmap_segment(shm_device_t *d)
+{
+    if (d->header) {
+        munmap(d->header, d->size);
+    }
+    if (d->owner) {
+        shm_device_unlink(d->name);
+    }
+}
+
+static void wait_for(shm_device_t *d, vcard_atomic_u32 *seq, uint32_t value,
+                     uint64_t timeout_ns)
+{
+    (void)d;
+#if defined(SHM_HAVE_FUTEX)
+    // Shared futex: the word lives in a mapping other processes see
+    struct timespec ts;
+    ts.tv_sec = (time_t)(timeout_ns / 1000000000u);
+    ts.tv_nsec = (long)(timeout_ns % 1000000000u);
+    syscall(SYS_futex, (uint32_t *)seq, FUTEX_WAIT, value, &ts, NULL, 0);
+    return;
+#else
+#if defined(SHM_HAVE_OS_SYNC)
+    if (__builtin_available(macOS 14.4, *)) {
+        os_sync_wait_on_address_with_timeout((void *)seq, value, sizeof(uint32_t),
+                                             OS_SYNC_WAIT_ON_ADDRESS_SHARED,
+                                             OS_CLOCK_MACH_ABSOLUTE_TIME, timeout_ns);
+        return;
+    }
+#endif
+    (void)seq;
+    (void)value;
+    vcard_sleep_us(timeout_ns < SHM_DEVICE_POLL_US * 1000u ?
+                   (uint32_t)(timeout_ns / 1000u) + 1 : SHM_DEVICE_POLL_US);
+#endif
+}
+
+static void wake(shm_device_t *d, vcard_atomic_u32 *seq)
+{
+    (void)d;
+#if defined(SHM_HAVE_FUTEX)
+    syscall(SYS_futex, (uint32_t *)seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#elif defined(SHM_HAVE_OS_SYNC)
+    if (__builtin_available(macOS 14.4, *)) {
+        os_sync_wake_by_address_all((void *)seq, sizeof(uint32_t),
+                                    OS_SYNC_WAKE_BY_ADDRESS_SHARED);
+    }
+#else
+    (void)seq;
+#endif
+}
+
+int shm_device_unlink(const char *name)
+{
+    char path[64];
+
+    if (!valid_name(name)) {
+        return VCARD_ERROR_INVALID;
+    }
+    object_name(path, sizeof(path), name);
+    return shm_unlink(path) == 0 ? VCARD_SUCCESS : errno_result(errno);
+}
+
+#endif
+
+int shm_device_create(shm_device_t *d, const char *name, uint32_t channels,
+                      uint32_t sample_rate, uint32_t frames)
+{
+    uint32_t capacity = SHM_DEVICE_MIN_FRAMES;
+    shm_device_header_t *h;
+    int result;
+
+    memset(d, 0, sizeof(*d));
+    if (!valid_name(name) || channels == 0 || channels > VCARD_MAX_CHANNELS ||
+        sample_rate == 0 || frames > SHM_DEVICE_MAX_FRAMES) {
+        return VCARD_ERROR_INVALID;
+    }
+    while (capacity < frames) {
+        capacity <<= 1;
+    }
+    memcpy(d->name, name, strlen(name) + 1);
+    d->owner = 1;
+
+    // A failed map cleans up after itself, and must not remove a name someone else holds
+    result = map_segment(d, segment_size(channels, capacity));
+    if (result != VCARD_SUCCESS) {
+        memset(d, 0, sizeof(*d));
+        return result;
+    }
+    d->size = segment_size(channels, capacity);
+
+    // New mappings are zero-filled: indices, flags and samples start at 0
+    h = d->header;
+    h->version = SHM_DEVICE_VERSION;
+    h->channels = channels;
+    h->sample_rate = sample_rate;
+    h->capacity = capacity;
+    vcard_atomic_store_release_u32(&h->magic, SHM_DEVICE_MAGIC);
+    attach_layout(d);
+    return VCARD_SUCCESS;
+}
+
+int shm_device_open(shm_device_t *d, const char *name)
+{
+    shm_device_header_t *h;
+    int result;
+
+    memset(d, 0, sizeof(*d));
+    if (!valid_name(name)) {
+        return VCARD_ERROR_INVALID;
+    }
+    memcpy(d->name, name, strlen(name) + 1);
+
+    result = map_segment(d, 0);
+    if (result != VCARD_SUCCESS) {
+        memset(d, 0, sizeof(*d));
+        return result;
+    }
+    // Mapped before the creator published the layout: not ready yet
+    h = d->header;
+    if (vcard_atomic_load_acquire_u32(&h->magic) != SHM_DEVICE_MAGIC) {
+        result = VCARD_ERROR_NOT_FOUND;
+    } else if (h->version != SHM_DEVICE_VERSION || h->channels == 0 ||
+               h->channels > VCARD_MAX_CHANNELS || h->capacity < SHM_DEVICE_MIN_FRAMES ||
+               h->capacity > SHM_DEVICE_MAX_FRAMES ||
+               (h->capacity & (h->capacity - 1)) != 0 ||
+               (d->size && d->size < segment_size(h->channels, h->capacity))) {
+        result = VCARD_ERROR_INVALID;
+    }
+    if (result != VCARD_SUCCESS) {
+        unmap_segment(d);
+        memset(d, 0, sizeof(*d));
+        return result;
+    }
+    d->size = segment_size(h->channels, h->capacity);
+    attach_layout(d);
+    return VCARD_SUCCESS;
+}
+
+void shm_device_close(shm_device_t *d)
+{
+    unmap_segment(d);
+    memset(d, 0, sizeof(*d));
+}
+
+int shm_device_write(shm_device_t *d, const float *const *buffers, size_t frames,
+                     size_t *frames_written)
+{
+    shm_device_header_t *h = d->header;
+    uint32_t w = vcard_atomic_load_relaxed_u32(&h->write_index);
+    uint32_t count = frames > d->capacity ? d->capacity : (uint32_t)frames;
+    uint32_t pos, first;
+
+    if (frames_written) *frames_written = 0;
+    if (!buffers) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (d->capacity - (w - d->cached_read_index) < count) {
+        d->cached_read_index = vcard_atomic_load_acquire_u32(&h->read_index);
+        if (d->capacity - (w - d->cached_read_index) < count) {
+            count = d->capacity - (w - d->cached_read_index);
+        }
+    }
+    if (count == 0) {
+        return VCARD_SUCCESS;
+    }
+
+    pos = w & d->mask;
+    first = d->capacity - pos < count ? d->capacity - pos : count;
+    for (uint32_t ch = 0; ch < d->channels; ch++) {
+        float *ring = d->data + (size_t)ch * d->capacity;
+
+        if (buffers[ch]) {
+            memcpy(ring + pos, buffers[ch], first * sizeof(float));
+            memcpy(ring, buffers[ch] + first, (count - first) * sizeof(float));
+        } else {
+            memset(ring + pos, 0, first * sizeof(float));
+            memset(ring, 0, (count - first) * sizeof(float));
+        }
+    }
+    vcard_atomic_store_release_u32(&h->write_index, w + count);
+
+    // Pairs with the fence in wait_readable: either we see the flag or it sees the data
+    vcard_atomic_fence();
+    if (vcard_atomic_load_relaxed_u32(&h->reader_waiting)) {
+        vcard_atomic_fetch_add_u32(&h->readable_seq, 1);
+        wake(d, &h->readable_seq);
+    }
+    if (frames_written) *frames_written = count;
+    return VCARD_SUCCESS;
+}
+
+int shm_device_read(shm_device_t *d, float *const *buffers, size_t frames,
+                    size_t *frames_read)
+{
+    shm_device_header_t *h = d->header;
+    uint32_t r = vcard_atomic_load_relaxed_u32(&h->read_index);
+    uint32_t count = frames > d->capacity ? d->capacity : (uint32_t)frames;
+    uint32_t pos, first;
+
+    if (frames_read) *frames_read = 0;
+    if (!buffers) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (d->cached_write_index - r < count) {
+        d->cached_write_index = vcard_atomic_load_acquire_u32(&h->write_index);
+        if (d->cached_write_index - r < count) {
+            count = d->cached_write_index - r;
+        }
+    }
+    if (count == 0) {
+        return VCARD_SUCCESS;
+    }
+
+    pos = r & d->mask;
+    first = d->capacity - pos < count ? d->capacity - pos : count;
+    for (uint32_t ch = 0; ch < d->channels; ch++) {
+        const float *ring = d->data + (size_t)ch * d->capacity;
+
+        if (buffers[ch]) {
+            memcpy(buffers[ch], ring + pos, first * sizeof(float));
+            memcpy(buffers[ch] + first, ring, (count - first) * sizeof(float));
+        }
+    }
+    vcard_atomic_store_release_u32(&h->read_index, r + count);
+
+    vcard_atomic_fence();
+    if (vcard_atomic_load_relaxed_u32(&h->writer_waiting)) {
+        vcard_atomic_fetch_add_u32(&h->writable_seq, 1);
+        wake(d, &h->writable_seq);
+    }
+    if (frames_read) *frames_read = count;
+    return VCARD_SUCCESS;
+}
+
+static uint32_t readable(shm_device_t *d)
+{
+    shm_device_header_t *h = d->header;
+    return vcard_atomic_load_acquire_u32(&h->write_index) -
+           vcard_atomic_load_relaxed_u32(&h->read_index);
+}
+
+static uint32_t writable(shm_device_t *d)
+{
+    shm_device_header_t *h = d->header;
+    return d->capacity - (vcard_atomic_load_relaxed_u32(&h->write_index) -
+                          vcard_atomic_load_acquire_u32(&h->read_index));
+}
+
+/**
+ * Sleep until ready(d) >= frames: flag, fence, recheck, then sleep on seq
+ *
+ * Reading seq before the recheck means a wake-up that lands between the
+ * recheck and the sleep changes the value and the sleep returns at once.
+ */
+static int wait_until(shm_device_t *d, uint32_t (*ready)(shm_device_t *),
+                      vcard_atomic_u32 *waiting, vcard_atomic_u32 *seq,
+                      uint32_t frames, uint32_t timeout_ms)
+{
+    uint64_t deadline;
+
+    if (frames > d->capacity) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (ready(d) >= frames) {
+        return VCARD_SUCCESS;
+    }
+    deadline = vcard_time_ns() + (uint64_t)timeout_ms * 1000000u;
+    for (;;) {
+        uint32_t value = vcard_atomic_load_acquire_u32(seq);
+        uint64_t now;
+
+        vcard_atomic_store_relaxed_u32(waiting, 1);
+        vcard_atomic_fence();
+        if (ready(d) >= frames) {
+            break;
+        }
+        now = vcard_time_ns();
+        if (now >= deadline) {
+            vcard_atomic_store_relaxed_u32(waiting, 0);
+            return VCARD_ERROR_TIMEOUT;
+        }
+        wait_for(d, seq, value, deadline - now);
+    }
+    vcard_atomic_store_relaxed_u32(waiting, 0);
+    return VCARD_SUCCESS;
+}
+
+int shm_device_wait_readable(shm_device_t *d, uint32_t frames, uint32_t timeout_ms)
+{
+    return wait_until(d, readable, &d->header->reader_waiting, &d->header->readable_seq,
+                      frames, timeout_ms);
+}
+
+int shm_device_wait_writable(shm_device_t *d, uint32_t frames, uint32_t timeout_ms)
+{
+    return wait_until(d, writable, &d->header->writer_waiting, &d->header->writable_seq,
+                      frames, timeout_ms);
+}
+
+uint32_t shm_device_buffered(shm_device_t *d)
+{
+    return readable(d);
+}
+
+/* Device links */
+
+#define SHM_LINK_MIN_IDLE_US 500
+#define SHM_LINK_DEFAULT_PERIODS 8
+#define SHM_LINK_WAIT_MS 10                  /* Import wait between running checks */
+
+/**
+ * Device -> segment (export pump thread)
+ */
+static void export_pump(void *arg)
+{
+    shm_link_t *l = (shm_link_t *)arg;
+    float *planes[VCARD_MAX_CHANNELS];
+    int dropping = 0;
+
+    for (uint32_t ch = 0; ch < l->channels; ch++) {
+        planes[ch] = l->staging + (size_t)ch * l->period_frames;
+    }
+    while (vcard_atomic_load_acquire_u32(&l->running)) {
+        uint64_t start = vcard_time_ns();
+        size_t got = 0, written = 0;
+
+        vcard_read_audio(l->device_id, planes, l->period_frames, &got);
+        if (!got) {
+            vcard_sleep_us(l->idle_us);
+            continue;
+        }
+        shm_device_write(&l->shm, (const float *const *)planes, got, &written);
+        vcard_atomic_fetch_add_u64(&l->frames, written);
+        if (written < got) {
+            // The consumer fell a whole segment behind: keep the device moving
+            vcard_atomic_fetch_add_u64(&l->dropped_frames, got - written);
+            if (!dropping) {
+                vcard_report_xrun(l->device_id);
+                dropping = 1;
+            }
+        } else {
+            dropping = 0;
+        }
+        vcard_report_period(l->device_id, (uint32_t)got, vcard_time_ns() - start);
+    }
+}
+
+/**
+ * Segment -> device (import pump thread)
+ */
+static void import_pump(void *arg)
+{
+    shm_link_t *l = (shm_link_t *)arg;
+    float *planes[VCARD_MAX_CHANNELS];
+    const float *pending[VCARD_MAX_CHANNELS];
+    size_t count = 0, pos = 0;
+
+    for (uint32_t ch = 0; ch < l->channels; ch++) {
+        planes[ch] = l->staging + (size_t)ch * l->period_frames;
+    }
+    while (vcard_atomic_load_acquire_u32(&l->running)) {
+        uint64_t start;
+        size_t written = 0;
+
+        if (pos == count) {
+            // Sleep on the segment until the producer has written something
+            if (shm_device_wait_readable(&l->shm, 1, SHM_LINK_WAIT_MS) != VCARD_SUCCESS) {
+                continue;
+            }
+            shm_device_read(&l->shm, planes, l->period_frames, &count);
+            pos = 0;
+            if (!count) {
+                continue;
+            }
+        }
+
+        start = vcard_time_ns();
+        for (uint32_t ch = 0; ch < l->channels; ch++) {
+            pending[ch] = planes[ch] + pos;
+        }
+        vcard_write_audio(l->device_id, pending, count - pos, &written);
+        if (!written) {
+            // The device is full; its reader sets the pace
+            vcard_sleep_us(l->idle_us);
+            continue;
+        }
+        pos += written;
+        vcard_atomic_fetch_add_u64(&l->frames, written);
+        vcard_report_period(l->device_id, (uint32_t)written, vcard_time_ns() - start);
+    }
+}
+
+int shm_link_start(shm_link_t *l, int device_id, const char *name, shm_link_mode_t mode,
+                   uint32_t frames)
+{
+    vcard_config_t config;
+    uint64_t idle_us;
+    int result;
+
+    memset(l, 0, sizeof(*l));
+    if (mode != SHM_LINK_EXPORT && mode != SHM_LINK_IMPORT) {
+        return VCARD_ERROR_INVALID;
+    }
+    result = vcard_get_config(device_id, &config);
+    if (result != VCARD_SUCCESS) {
+        return result;
+    }
+
+    l->device_id = device_id;
+    l->mode = mode;
+    l->period_frames = config.buffer_size;
+    idle_us = (uint64_t)config.buffer_size * 1000000 / config.sample_rate / 4;
+    l->idle_us = idle_us < SHM_LINK_MIN_IDLE_US ? SHM_LINK_MIN_IDLE_US : (uint32_t)idle_us;
+
+    if (mode == SHM_LINK_EXPORT) {
+        l->channels = config.channels_in;
+        result = shm_device_create(&l->shm, name, l->channels, config.sample_rate,
+                                   frames ? frames :
+                                            config.buffer_size * SHM_LINK_DEFAULT_PERIODS);
+    } else {
+        l->channels = config.channels_out;
+        result = shm_device_open(&l->shm, name);
+        if (result == VCARD_SUCCESS && (l->shm.channels != l->channels ||
+                                        l->shm.sample_rate != config.sample_rate)) {
+            shm_device_close(&l->shm);
+            result = VCARD_ERROR_INVALID;
+        }
+    }
+    if (result != VCARD_SUCCESS) {
+        return result;
+    }
+
+    l->staging = (float *)malloc((size_t)l->channels * l->period_frames * sizeof(float));
+    if (!l->staging) {
+        shm_device_close(&l->shm);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    vcard_atomic_store_release_u32(&l->running, 1);
+    if (vcard_thread_create(&l->thread, mode == SHM_LINK_EXPORT ? export_pump : import_pump,
+                            l) != VCARD_SUCCESS) {
+        free(l->staging);
+        shm_device_close(&l->shm);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    return VCARD_SUCCESS;
+}
+
+void shm_link_stop(shm_link_t *l)
+{
+    vcard_atomic_store_release_u32(&l->running, 0);
+    vcard_thread_join(&l->thread);
+    shm_device_close(&l->shm);
+    free(l->staging);
+    l->staging = NULL;
+}
+
+void shm_link_get_stats(shm_link_t *l, shm_link_stats_t *stats)
+{
+    stats->frames = vcard_atomic_load_relaxed_u64(&l->frames);
+    stats->dropped_frames = vcard_atomic_load_relaxed_u64(&l->dropped_frames);
+}
@@ -0,0 +1,267 @@
+/**
+ * Virtual Sound Card - Shared-Memory Device
+ *
+ * A named segment holding one planar float ring per channel, for a
+ * producer and a consumer in different processes: a generator daemon
+ * feeding a host, or a test feeding an analyzer in another process, without
+ * snd-aloop, VB-Cable or BlackHole in between. The segment is created by
+ * one process and attached by name from another (POSIX shm_open on Linux
+ * and macOS, a named file mapping on Windows).
+ *
+ * Transfers copy straight between the caller's buffers and the mapped
+ * rings and make no system call while the peer is running. A side that
+ * has to wait sleeps on a futex in the segment (Linux), a shared-address
+ * wait (macOS 14.4 and later, short polls before that) or a named event
+ * (Windows); the other side only makes the wake-up call when it sees the
+ * waiter's flag.
+ *
+ * Like ring_buffer_t, each segment carries one writer and one reader.
+ * Feeding several consumers takes one segment per consumer.
+ *
+ * shm_link_t connects a segment to a vcard device in place of a backend:
+ * an export link creates the segment and pumps a device's input channels
+ * into it, and an import link in another process attaches by name and
+ * pumps the segment into a device's output channels. The two devices then
+ * behave as one cable between the processes.
+ */
+
+#ifndef SHM_DEVICE_H
+#define SHM_DEVICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vcard.h"
+#include "vcard_atomic.h"
+#include "vcard_thread.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHM_DEVICE_MAX_NAME 24               /* Name characters, fits macOS PSHMNAMLEN */
+#define SHM_DEVICE_MIN_FRAMES 16
+#define SHM_DEVICE_MAX_FRAMES (1u << 20)     /* Per-channel ring capacity limit */
+
+/**
+ * Segment header, at the start of the mapping
+ *
+ * The creator fills in the layout and publishes it by storing magic last.
+ */
+typedef struct {
+    vcard_atomic_u32 magic;
+    uint32_t version;
+    uint32_t channels;
+    uint32_t sample_rate;
+    uint32_t capacity;                   /* Frames per channel, a power of two */
+    char pad0[VCARD_CACHELINE - 5 * sizeof(uint32_t)];
+
+    /* Written by the producer */
+    vcard_atomic_u32 write_index;        /* Free-running, wraps modulo 2^32 */
+    vcard_atomic_u32 writer_waiting;     /* Set while the producer sleeps for space */
+    vcard_atomic_u32 readable_seq;       /* Bumped to wake a sleeping consumer */
+    char pad1[VCARD_CACHELINE - 3 * sizeof(uint32_t)];
+
+    /* Written by the consumer */
+    vcard_atomic_u32 read_index;
+    vcard_atomic_u32 reader_waiting;     /* Set while the consumer sleeps for data */
+    vcard_atomic_u32 writable_seq;       /* Bumped to wake a sleeping producer */
+    char pad2[VCARD_CACHELINE - 3 * sizeof(uint32_t)];
+} shm_device_header_t;
+
+/**
+ * One process's attachment to a segment
+ */
+typedef struct {
+    shm_device_header_t *header;
+    float *data;                         /* channels x capacity, after the header */
+    size_t size;                         /* Bytes mapped */
+    uint32_t channels;
+    uint32_t sample_rate;
+    uint32_t capacity;
+    uint32_t mask;
+    uint32_t cached_read_index;          /* Producer's copy of the consumer index */
+    uint32_t cached_write_index;         /* Consumer's copy of the producer index */
+    int owner;                           /* Created here; removed by shm_device_close */
+    char name[SHM_DEVICE_MAX_NAME + 1];
+#ifdef _WIN32
+    HANDLE mapping;
+    HANDLE readable_event;
+    HANDLE writable_event;
+#endif
+} shm_device_t;
+
+/**
+ * Create a named segment
+ *
+ * @param d Attachment to initialize
+ * @param name Up to SHM_DEVICE_MAX_NAME letters, digits, '-' or '_'
+ * @param channels Channel count (1 to VCARD_MAX_CHANNELS)
+ * @param sample_rate Sample rate recorded for the consumer
+ * @param frames Minimum ring capacity per channel (rounded up to a power of two)
+ * @return 0 on success, VCARD_ERROR_IN_USE if the name exists,
+ *         other VCARD_ERROR_* on failure
+ */
+int shm_device_create(shm_device_t *d, const char *name, uint32_t channels,
+                      uint32_t sample_rate, uint32_t frames);
+
+/**
+ * Attach to a segment created by another process
+ *
+ * @param d Attachment to initialize
+ * @param name Segment name
+ * @return 0 on success, VCARD_ERROR_NOT_FOUND if no segment of that name
+ *         is ready, other VCARD_ERROR_* on failure
+ */
+int shm_device_open(shm_device_t *d, const char *name);
+
+/**
+ * Detach; the creator also removes the name
+ *
+ * @param d Attachment
+ */
+void shm_device_close(shm_device_t *d);
+
+/**
+ * Remove a segment name left behind by a process that exited without
+ * closing (no-op on Windows, where segments go with their last handle)
+ *
+ * @param name Segment name
+ * @return 0 on success, VCARD_ERROR_NOT_FOUND if there was none
+ */
+int shm_device_unlink(const char *name);
+
+/**
+ * Write planar frames (producer)
+ *
+ * Writes as many frames as fit on every channel; NULL channel buffers
+ * write silence.
+ *
+ * @param d Attachment
+ * @param buffers channels buffers of frames samples
+ * @param frames Frames offered
+ * @param frames_written Output parameter for frames written
+ * @return 0 on success, VCARD_ERROR_INVALID on bad parameters
+ */
+int shm_device_write(shm_device_t *d, const float *const *buffers, size_t frames,
+                     size_t *frames_written);
+
+/**
+ * Read planar frames (consumer)
+ *
+ * NULL channel buffers discard that channel.
+ *
+ * @param d Attachment
+ * @param buffers channels buffers of room for frames samples
+ * @param frames Frames wanted
+ * @param frames_read Output parameter for frames read
+ * @return 0 on success, VCARD_ERROR_INVALID on bad parameters
+ */
+int shm_device_read(shm_device_t *d, float *const *buffers, size_t frames,
+                    size_t *frames_read);
+
+/**
+ * Sleep until at least frames can be read (consumer)
+ *
+ * @param d Attachment
+ * @param frames Frames wanted (at most the capacity)
+ * @param timeout_ms Longest wait
+ * @return 0 once readable, VCARD_ERROR_TIMEOUT, or VCARD_ERROR_INVALID
+ */
+int shm_device_wait_readable(shm_device_t *d, uint32_t frames, uint32_t timeout_ms);
+
+/**
+ * Sleep until at least frames can be written (producer)
+ *
+ * @param d Attachment
+ * @param frames Frames to write (at most the capacity)
+ * @param timeout_ms Longest wait
+ * @return 0 once writable, VCARD_ERROR_TIMEOUT, or VCARD_ERROR_INVALID
+ */
+int shm_device_wait_writable(shm_device_t *d, uint32_t frames, uint32_t timeout_ms);
+
+/**
+ * Frames queued in the segment (either side)
+ *
+ * @param d Attachment
+ * @return Frames written and not yet read
+ */
+uint32_t shm_device_buffered(shm_device_t *d);
+
+/**
+ * Direction of a device link
+ */
+typedef enum {
+    SHM_LINK_EXPORT = 0,     /* Device input channels -> new segment */
+    SHM_LINK_IMPORT          /* Attached segment -> device output channels */
+} shm_link_mode_t;
+
+/**
+ * Device link statistics
+ */
+typedef struct {
+    uint64_t frames;          /* Frames moved between the device and the segment */
+    uint64_t dropped_frames;  /* Export: frames discarded on a full segment */
+} shm_link_stats_t;
+
+/**
+ * Device link state
+ */
+typedef struct {
+    int device_id;
+    shm_link_mode_t mode;
+    uint32_t channels;
+    uint32_t period_frames;              /* Device buffer size */
+    uint32_t idle_us;                    /* Pump sleep when nothing moved */
+    shm_device_t shm;
+    float *staging;                      /* channels x period_frames */
+    vcard_thread_t thread;
+
+    vcard_atomic_u32 running;
+    vcard_atomic_u64 frames;
+    vcard_atomic_u64 dropped_frames;
+} shm_link_t;
+
+/**
+ * Connect a device to a segment through a pump thread
+ *
+ * Exporting creates the segment with the device's channels_in channels
+ * and sample rate. Importing attaches to an existing segment, which must
+ * carry exactly the device's channels_out channels at its sample rate.
+ *
+ * @param l Link to start
+ * @param device_id Device to drive (no other backend may drive it)
+ * @param name Segment name (see shm_device_create)
+ * @param mode SHM_LINK_EXPORT or SHM_LINK_IMPORT
+ * @param frames Exporting: minimum segment capacity per channel, 0 for
+ *               eight device periods (ignored when importing)
+ * @return 0 on success, VCARD_ERROR_INVALID for a segment that does not
+ *         match the device, other VCARD_ERROR_* as shm_device_create or
+ *         shm_device_open
+ */
+int shm_link_start(shm_link_t *l, int device_id, const char *name, shm_link_mode_t mode,
+                   uint32_t frames);
+
+/**
+ * Stop the pump thread and detach (an export also removes the name)
+ *
+ * @param l Link
+ */
+void shm_link_stop(shm_link_t *l);
+
+/**
+ * Get statistics (any thread)
+ *
+ * @param l Link
+ * @param stats Output parameter for statistics
+ */
+void shm_link_get_stats(shm_link_t *l, shm_link_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHM_DEVICE_H */
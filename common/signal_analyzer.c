@@ -0,0 +1,569 @@
+/**
+ * Streaming Signal Analyzer Implementation
+ *
+ * Goertzel bins are evaluated at arbitrary frequencies (not at the nearest
+ * DFT bin). The tone, its negative-frequency image and the DC offset are
+ * fitted to the bins with the closed-form window response, and the block
+ * power is weighted by the same window, so the fitted tone and the
+ * residual split the power the way a least-squares notch would: noise
+ * does not bias THD+N, and a clean float tone measures below -120 dB.
+ * After each block the bins are retuned to the measured frequency.
+ *
+ * In FFT mode samples are windowed and stored in bit-reversed order as
+ * they arrive; the butterflies at the end of each block run four at a
+ * time with SSE2 or NEON where available.
+ */
+
+#include "signal_analyzer.h"
+#include "vcard.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANALYZER_HAVE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define ANALYZER_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* 4-term Blackman-Harris window coefficients */
+static const double window_coeffs[4] = { 0.35875, 0.48829, 0.14128, 0.01168 };
+
+/*
+ * Bins either side of a tone counted as that tone in FFT mode: the main
+ * lobe is 4 bins wide each side, the rest keeps the near sidelobes out of
+ * the noise (about -100 dB left outside)
+ */
+#define ANALYZER_LOBE_BINS 12
+
+/*
+ * Goertzel blocks before the first report: one primes the bin phase, one
+ * measures the frequency the bins are then tuned to
+ */
+#define ANALYZER_WARMUP_BLOCKS 2
+
+/* Power floor: keeps dB values finite for silence and perfect tones */
+#define ANALYZER_POWER_FLOOR 1e-20
+
+/**
+ * Closed-form DTFT of the window, sum of w[i] * e^{-i nu i} over the block
+ */
+static void window_response(double nu, double n, double *re, double *im)
+{
+    *re = 0.0;
+    *im = 0.0;
+    for (int k = -3; k <= 3; k++) {
+        double c = window_coeffs[k < 0 ? -k : k] * ((k & 1) ? -1.0 : 1.0) * (k ? 0.5 : 1.0);
+        double theta = 2.0 * M_PI * k / n - nu;
+        double mag;
+
+        // Geometric sum of e^{i theta i}: e^{i theta (N-1)/2} sin(N theta/2) / sin(theta/2)
+        theta -= 2.0 * M_PI * floor(theta / (2.0 * M_PI) + 0.5);
+        if (fabs(theta) < 1e-12) {
+            *re += c * n;
+            continue;
+        }
+        mag = c * sin(n * theta / 2.0) / sin(theta / 2.0);
+        *re += mag * cos(theta * (n - 1.0) / 2.0);
+        *im += mag * sin(theta * (n - 1.0) / 2.0);
+    }
+}
+
+static double power_db(double num, double den)
+{
+    double db = 10.0 * log10((num > ANALYZER_POWER_FLOOR ? num : ANALYZER_POWER_FLOOR) /
+                             (den > ANALYZER_POWER_FLOOR ? den : ANALYZER_POWER_FLOOR));
+
+    return db > 200.0 ? 200.0 : (db < -200.0 ? -200.0 : db);
+}
+
+/* Tune the Goertzel bins to a fundamental and its harmonics */
+static void tune_bins(signal_analyzer_t *a, double frequency)
+{
+    a->track = frequency;
+    for (uint32_t h = 0; h < a->num_bins; h++) {
+        double w = 2.0 * M_PI * frequency * (h + 1) / a->sample_rate;
+
+        a->omega[h] = w;
+        a->cos_w[h] = cos(w);
+        a->sin_w[h] = sin(w);
+        a->coeff[h] = 2.0 * a->cos_w[h];
+    }
+}
+
+static void reset_block(signal_analyzer_t *a)
+{
+    a->pos = 0;
+    a->sum = 0.0;
+    a->sum_sq = 0.0;
+    for (uint32_t h = 0; h < a->num_bins; h++) {
+        a->s1[h] = 0.0;
+        a->s2[h] = 0.0;
+    }
+    if (a->fft_im) {
+        memset(a->fft_im, 0, a->block_frames * sizeof(float));
+    }
+}
+
+int signal_analyzer_init(signal_analyzer_t *a, double sample_rate,
+                         double expected_frequency, uint32_t block_frames)
+{
+    double n = (double)block_frames;
+
+    memset(a, 0, sizeof(*a));
+    if (sample_rate <= 0.0 || expected_frequency < 0.0 ||
+        expected_frequency >= sample_rate / 2.0 ||
+        block_frames < SIGNAL_ANALYZER_MIN_BLOCK ||
+        block_frames > SIGNAL_ANALYZER_MAX_BLOCK) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (expected_frequency == 0.0 && (block_frames & (block_frames - 1)) != 0) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    a->sample_rate = sample_rate;
+    a->expected = expected_frequency;
+    a->block_frames = block_frames;
+    a->window = (double *)malloc(block_frames * sizeof(double));
+    if (!a->window) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    for (uint32_t i = 0; i < block_frames; i++) {
+        double t = 2.0 * M_PI * i / n;
+        double w = window_coeffs[0] - window_coeffs[1] * cos(t) +
+                   window_coeffs[2] * cos(2.0 * t) - window_coeffs[3] * cos(3.0 * t);
+
+        a->window[i] = w;
+        a->window_sum += w;
+    }
+
+    if (expected_frequency > 0.0) {
+        // Harmonics that stay clear of Nyquist by more than the main lobe
+        double nyquist = sample_rate / 2.0 - ANALYZER_LOBE_BINS * sample_rate / n;
+
+        a->num_bins = 1;
+        while (a->num_bins < SIGNAL_ANALYZER_MAX_HARMONICS &&
+               expected_frequency * (a->num_bins + 1) < nyquist) {
+            a->num_bins++;
+        }
+        tune_bins(a, expected_frequency);
+        a->warmup = ANALYZER_WARMUP_BLOCKS;
+    } else {
+        uint32_t bits = 0;
+
+        while ((1u << bits) < block_frames) {
+            bits++;
+        }
+        a->fft_re = (float *)malloc(block_frames * sizeof(float));
+        a->fft_im = (float *)malloc(block_frames * sizeof(float));
+        a->twiddle_re = (float *)malloc(block_frames * sizeof(float));
+        a->twiddle_im = (float *)malloc(block_frames * sizeof(float));
+        a->bitrev = (uint32_t *)malloc(block_frames * sizeof(uint32_t));
+        if (!a->fft_re || !a->fft_im || !a->twiddle_re || !a->twiddle_im || !a->bitrev) {
+            signal_analyzer_free(a);
+            return VCARD_ERROR_NO_MEMORY;
+        }
+        for (uint32_t i = 0; i < block_frames; i++) {
+            uint32_t r = 0;
+
+            for (uint32_t bit = 0; bit < bits; bit++) {
+                r |= ((i >> bit) & 1u) << (bits - 1 - bit);
+            }
+            a->bitrev[i] = r;
+        }
+        // Each stage's twiddles are contiguous so the SIMD loop loads them directly
+        for (uint32_t m = 1; m < block_frames; m <<= 1) {
+            for (uint32_t j = 0; j < m; j++) {
+                a->twiddle_re[m - 1 + j] = (float)cos(M_PI * j / m);
+                a->twiddle_im[m - 1 + j] = (float)-sin(M_PI * j / m);
+            }
+        }
+    }
+
+    reset_block(a);
+    return VCARD_SUCCESS;
+}
+
+void signal_analyzer_free(signal_analyzer_t *a)
+{
+    free(a->window);
+    free(a->fft_re);
+    free(a->fft_im);
+    free(a->twiddle_re);
+    free(a->twiddle_im);
+    free(a->bitrev);
+    a->window = NULL;
+    a->fft_re = NULL;
+    a->fft_im = NULL;
+    a->twiddle_re = NULL;
+    a->twiddle_im = NULL;
+    a->bitrev = NULL;
+}
+
+/* One FFT stage: butterflies of span m over the whole block */
+static void fft_stage(float *re, float *im, const float *wr, const float *wi,
+                      uint32_t n, uint32_t m)
+{
+    for (uint32_t k = 0; k < n; k += 2 * m) {
+        uint32_t j = 0;
+
+#if defined(ANALYZER_HAVE_SSE2)
+        for (; j + 4 <= m; j += 4) {
+            __m128 ar = _mm_loadu_ps(re + k + j), ai = _mm_loadu_ps(im + k + j);
+            __m128 br = _mm_loadu_ps(re + k + j + m), bi = _mm_loadu_ps(im + k + j + m);
+            __m128 cr = _mm_loadu_ps(wr + j), ci = _mm_loadu_ps(wi + j);
+            __m128 tr = _mm_sub_ps(_mm_mul_ps(br, cr), _mm_mul_ps(bi, ci));
+            __m128 ti = _mm_add_ps(_mm_mul_ps(br, ci), _mm_mul_ps(bi, cr));
+
+            _mm_storeu_ps(re + k + j + m, _mm_sub_ps(ar, tr));
+            _mm_storeu_ps(im + k + j + m, _mm_sub_ps(ai, ti));
+            _mm_storeu_ps(re + k + j, _mm_add_ps(ar, tr));
+            _mm_storeu_ps(im + k + j, _mm_add_ps(ai, ti));
+        }
+#elif defined(ANALYZER_HAVE_NEON)
+        for (; j + 4 <= m; j += 4) {
+            float32x4_t ar = vld1q_f32(re + k + j), ai = vld1q_f32(im + k + j);
+            float32x4_t br = vld1q_f32(re + k + j + m), bi = vld1q_f32(im + k + j + m);
+            float32x4_t cr = vld1q_f32(wr + j), ci = vld1q_f32(wi + j);
+            float32x4_t tr = vsubq_f32(vmulq_f32(br, cr), vmulq_f32(bi, ci));
+            float32x4_t ti = vaddq_f32(vmulq_f32(br, ci), vmulq_f32(bi, cr));
+
+            vst1q_f32(re + k + j + m, vsubq_f32(ar, tr));
+            vst1q_f32(im + k + j + m, vsubq_f32(ai, ti));
+            vst1q_f32(re + k + j, vaddq_f32(ar, tr));
+            vst1q_f32(im + k + j, vaddq_f32(ai, ti));
+        }
+#endif
+        for (; j < m; j++) {
+            uint32_t p = k + j, q = p + m;
+            float tr = re[q] * wr[j] - im[q] * wi[j];
+            float ti = re[q] * wi[j] + im[q] * wr[j];
+
+            re[q] = re[p] - tr;
+            im[q] = im[p] - ti;
+            re[p] += tr;
+            im[p] += ti;
+        }
+    }
+}
+
+static double bin_power(const signal_analyzer_t *a, uint32_t k)
+{
+    return (double)a->fft_re[k] * a->fft_re[k] + (double)a->fft_im[k] * a->fft_im[k];
+}
+
+/* Sum of bin powers over [first, last], clipped to the usable spectrum */
+static double lobe_power(const signal_analyzer_t *a, int64_t first, int64_t last)
+{
+    int64_t top = a->block_frames / 2 - 1;
+    double p = 0.0;
+
+    if (first < ANALYZER_LOBE_BINS) {
+        first = ANALYZER_LOBE_BINS;
+    }
+    if (last > top) {
+        last = top;
+    }
+    for (int64_t k = first; k <= last; k++) {
+        p += bin_power(a, (uint32_t)k);
+    }
+    return p;
+}
+
+/* Measure a completed FFT-mode block */
+static void finish_fft(signal_analyzer_t *a, signal_metrics_t *m)
+{
+    double mean = a->sum / a->window_sum;
+    double ac_power = a->sum_sq / a->window_sum - mean * mean;
+    uint32_t n = a->block_frames;
+    uint32_t top = n / 2 - 1;
+    uint32_t peak = ANALYZER_LOBE_BINS;
+    double total = 0.0, fund, harm = 0.0, best = -1.0, offset = 0.0;
+    int64_t counted;
+
+    for (uint32_t size = 1; size < n; size <<= 1) {
+        fft_stage(a->fft_re, a->fft_im, a->twiddle_re + size - 1,
+                  a->twiddle_im + size - 1, n, size);
+    }
+
+    // Bins below the lobe belong to the DC offset, measured in the time domain
+    for (uint32_t k = ANALYZER_LOBE_BINS; k <= top; k++) {
+        double p = bin_power(a, k);
+
+        total += p;
+        if (p > best) {
+            best = p;
+            peak = k;
+        }
+    }
+
+    // Parabolic interpolation of the log magnitude around the peak
+    if (peak > ANALYZER_LOBE_BINS && peak < top && best > 0.0) {
+        double l = log(bin_power(a, peak - 1) + ANALYZER_POWER_FLOOR);
+        double c = log(best);
+        double r = log(bin_power(a, peak + 1) + ANALYZER_POWER_FLOOR);
+        double den = l - 2.0 * c + r;
+
+        if (den < 0.0) {
+            offset = 0.5 * (l - r) / den;
+        }
+    }
+
+    fund = lobe_power(a, (int64_t)peak - ANALYZER_LOBE_BINS, (int64_t)peak + ANALYZER_LOBE_BINS);
+    counted = (int64_t)peak + ANALYZER_LOBE_BINS;
+    for (uint32_t h = 2; h <= SIGNAL_ANALYZER_MAX_HARMONICS; h++) {
+        int64_t centre = (int64_t)floor(h * (peak + offset) + 0.5);
+        int64_t first = centre - ANALYZER_LOBE_BINS;
+
+        if (centre > (int64_t)top) {
+            break;
+        }
+        if (first <= counted) {
+            first = counted + 1;
+        }
+        harm += lobe_power(a, first, centre + ANALYZER_LOBE_BINS);
+        counted = centre + ANALYZER_LOBE_BINS;
+    }
+
+    if (ac_power < 0.0) {
+        ac_power = 0.0;
+    }
+    m->frequency = (peak + offset) * a->sample_rate / n;
+    m->dc = mean;
+    m->rms = sqrt(ac_power);
+    m->amplitude = total > 0.0 ? sqrt(2.0 * ac_power * fund / total) : 0.0;
+    m->thd_n_db = power_db(total - fund, total);
+    m->snr_db = power_db(fund, total - fund - harm);
+}
+
+/* DTFT of the block at bin h, = e^{-iw(N-1)} * (s1 - e^{-iw} s2) */
+static void goertzel_dtft(const signal_analyzer_t *a, uint32_t h, double *re, double *im)
+{
+    double yr = a->s1[h] - a->cos_w[h] * a->s2[h];
+    double yi = a->sin_w[h] * a->s2[h];
+    double turn = a->omega[h] * (a->block_frames - 1.0);
+    double c = cos(turn), s = sin(turn);
+
+    *re = yr * c + yi * s;
+    *im = yi * c - yr * s;
+}
+
+/*
+ * A real tone c e^{i wt i} + conj(c) e^{-i wt i} shows up in the bin at w
+ * as c W(w - wt) + conj(c) W(w + wt). Solving for c (u + iv) removes both
+ * the window's scalloping and the negative-frequency image.
+ */
+static int solve_tone(double n, double w, double tone, double xr, double xi,
+                      double *u, double *v)
+{
+    double pr, pi, qr, qi, det;
+
+    window_response(w - tone, n, &pr, &pi);
+    window_response(w + tone, n, &qr, &qi);
+    det = pr * pr + pi * pi - qr * qr - qi * qi;
+    if (det <= 0.0) {
+        *u = 0.0;
+        *v = 0.0;
+        return 0;
+    }
+    *u = (xr * (pr - qr) - xi * (qi - pi)) / det;
+    *v = (xi * (pr + qr) - xr * (pi + qi)) / det;
+    return 1;
+}
+
+/* Phase of a tone at the start of a block, from its bin at w */
+static double tone_phase(double n, double w, double tone, double xr, double xi)
+{
+    double u, v;
+
+    solve_tone(n, w, tone, xr, xi, &u, &v);
+    return atan2(v, u);
+}
+
+/* Measure a completed Goertzel-mode block; returns 0 during warm-up */
+static int finish_goertzel(signal_analyzer_t *a, signal_metrics_t *m)
+{
+    double n = (double)a->block_frames;
+    double capture = 0.5 * a->sample_rate / n;
+    double mean = a->sum / a->window_sum;
+    double frequency = a->track, tone;
+    double xr, xi, dr, di, lr, li, u, v, ac_power, fund = 0.0, harm = 0.0;
+
+    goertzel_dtft(a, 0, &xr, &xi);
+    window_response(a->omega[0], n, &dr, &di);
+    xr -= mean * dr;
+    xi -= mean * di;
+    if (a->warmup == ANALYZER_WARMUP_BLOCKS) {
+        a->warmup--;
+        a->prev_re = xr;
+        a->prev_im = xi;
+        a->prev_omega = a->omega[0];
+        return 0;
+    }
+
+    /*
+     * The tone's phase advances by wt * N between blocks. Its phase is
+     * solved from each block's bin with the best frequency so far, which a
+     * second pass refines (the image depends slightly on it).
+     */
+    for (int pass = 0; pass < 2; pass++) {
+        double advance;
+
+        tone = 2.0 * M_PI * frequency / a->sample_rate;
+        advance = tone_phase(n, a->omega[0], tone, xr, xi) -
+                  tone_phase(n, a->prev_omega, tone, a->prev_re, a->prev_im) - tone * n;
+        advance -= 2.0 * M_PI * floor(advance / (2.0 * M_PI) + 0.5);
+        frequency += advance * a->sample_rate / (2.0 * M_PI * n);
+    }
+    tone = 2.0 * M_PI * frequency / a->sample_rate;
+
+    // The tone leaks into the windowed mean; take it out before the DC is removed
+    if (solve_tone(n, a->omega[0], tone, xr, xi, &u, &v)) {
+        window_response(-tone, n, &lr, &li);
+        mean -= 2.0 * (u * lr - v * li) / a->window_sum;
+    }
+
+    for (uint32_t h = 0; h < a->num_bins; h++) {
+        goertzel_dtft(a, h, &xr, &xi);
+        window_response(a->omega[h], n, &dr, &di);
+        xr -= mean * dr;
+        xi -= mean * di;
+        if (!solve_tone(n, a->omega[h], tone * (h + 1), xr, xi, &u, &v)) {
+            continue;
+        }
+        if (h == 0) {
+            // Windowed power of the fitted tone, partial cycles included
+            window_response(-2.0 * tone, n, &lr, &li);
+            fund = 2.0 * (u * u + v * v) +
+                   2.0 * ((u * u - v * v) * lr - 2.0 * u * v * li) / a->window_sum;
+            m->amplitude = 2.0 * sqrt(u * u + v * v);
+            a->prev_re = xr;
+            a->prev_im = xi;
+        } else {
+            harm += 2.0 * (u * u + v * v);
+        }
+    }
+    a->prev_omega = a->omega[0];
+
+    /*
+     * Power is weighted by the same window as the bins, so the fitted tone
+     * and the residual split it exactly and noise does not bias THD+N
+     */
+    ac_power = (a->sum_sq - 2.0 * mean * a->sum) / a->window_sum + mean * mean;
+    if (ac_power < 0.0) {
+        ac_power = 0.0;
+    }
+    m->frequency = frequency;
+    m->dc = mean;
+    m->rms = sqrt(ac_power);
+    m->thd_n_db = power_db(ac_power - fund, ac_power);
+    m->snr_db = power_db(fund, ac_power - fund - harm);
+
+    // Follow the tone with the bins, within the capture range of the expected one
+    if (frequency > a->expected + capture) {
+        frequency = a->expected + capture;
+    } else if (frequency < a->expected - capture) {
+        frequency = a->expected - capture;
+    }
+    tune_bins(a, frequency);
+    if (a->warmup > 0) {
+        a->warmup--;
+        return 0;
+    }
+    return 1;
+}
+
+static void update_summary(signal_summary_t *s, const signal_metrics_t *m)
+{
+    double dc = fabs(m->dc);
+
+    if (s->blocks == 0) {
+        s->frequency_min = s->frequency_max = m->frequency;
+        s->amplitude_min = m->amplitude;
+        s->rms_min = m->rms;
+        s->dc_max = dc;
+        s->thd_n_db_max = m->thd_n_db;
+        s->snr_db_min = m->snr_db;
+    } else {
+        s->frequency_min = m->frequency < s->frequency_min ? m->frequency : s->frequency_min;
+        s->frequency_max = m->frequency > s->frequency_max ? m->frequency : s->frequency_max;
+        s->amplitude_min = m->amplitude < s->amplitude_min ? m->amplitude : s->amplitude_min;
+        s->rms_min = m->rms < s->rms_min ? m->rms : s->rms_min;
+        s->dc_max = dc > s->dc_max ? dc : s->dc_max;
+        s->thd_n_db_max = m->thd_n_db > s->thd_n_db_max ? m->thd_n_db : s->thd_n_db_max;
+        s->snr_db_min = m->snr_db < s->snr_db_min ? m->snr_db : s->snr_db_min;
+    }
+    s->blocks++;
+}
+
+/* Close the current block; returns 1 if it was reported */
+static int finish_block(signal_analyzer_t *a)
+{
+    signal_metrics_t m;
+    int reported = 1;
+
+    memset(&m, 0, sizeof(m));
+    if (a->fft_re) {
+        finish_fft(a, &m);
+    } else {
+        reported = finish_goertzel(a, &m);
+    }
+    if (reported) {
+        a->last = m;
+        update_summary(&a->summary, &m);
+    }
+    reset_block(a);
+    return reported;
+}
+
+/* Add one sample to the current block */
+static inline int push_sample(signal_analyzer_t *a, double x)
+{
+    double w = a->window[a->pos];
+    double wx = w * x;
+
+    a->sum += wx;
+    a->sum_sq += wx * x;
+    if (a->fft_re) {
+        a->fft_re[a->bitrev[a->pos]] = (float)wx;
+    } else {
+        for (uint32_t h = 0; h < a->num_bins; h++) {
+            double s0 = wx + a->coeff[h] * a->s1[h] - a->s2[h];
+
+            a->s2[h] = a->s1[h];
+            a->s1[h] = s0;
+        }
+    }
+    if (++a->pos == a->block_frames) {
+        return finish_block(a);
+    }
+    return 0;
+}
+
+int signal_analyzer_process(signal_analyzer_t *a, const float *samples,
+                            size_t num_frames, size_t stride)
+{
+    int blocks = 0;
+
+    for (size_t i = 0; i < num_frames; i++) {
+        blocks += push_sample(a, samples[i * stride]);
+    }
+    return blocks;
+}
+
+int signal_analyzer_process_i16(signal_analyzer_t *a, const int16_t *samples,
+                                size_t num_frames, size_t stride)
+{
+    int blocks = 0;
+
+    for (size_t i = 0; i < num_frames; i++) {
+        blocks += push_sample(a, samples[i * stride] * (1.0 / 32768.0));
+    }
+    return blocks;
+}
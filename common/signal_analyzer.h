@@ -0,0 +1,157 @@
+/**
+ * Virtual Sound Card - Streaming Signal Analyzer
+ *
+ * Measures one channel of a test tone block by block as it is captured,
+ * with memory fixed at init regardless of how long the stream runs. Each
+ * block of block_frames samples yields the fundamental frequency and
+ * amplitude, DC offset, RMS, THD+N and SNR; a running summary keeps the
+ * worst value of each across the whole stream.
+ *
+ * Two modes:
+ *  - Goertzel (expected frequency > 0): one bin at the tone and one per
+ *    harmonic, updated sample by sample. The frequency is taken from the
+ *    phase advance of the fundamental between blocks, so it is resolved
+ *    far below the bin spacing, and the bins then follow it. The tone must
+ *    lie within +/- sample_rate / (2 * block_frames) of the expected one.
+ *    The first two blocks lock onto the tone and are not reported. The
+ *    measurement floor is below -120 dB.
+ *  - FFT (expected frequency 0): a radix-2 FFT of every block, for tones
+ *    of unknown frequency. block_frames must be a power of two. The floor
+ *    is about -100 dB.
+ *
+ * Both modes apply a 4-term Blackman-Harris window.
+ */
+
+#ifndef SIGNAL_ANALYZER_H
+#define SIGNAL_ANALYZER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIGNAL_ANALYZER_MAX_HARMONICS 5      /* Fundamental included */
+#define SIGNAL_ANALYZER_MIN_BLOCK 64
+#define SIGNAL_ANALYZER_MAX_BLOCK 65536
+
+/**
+ * Measurements of one block
+ *
+ * THD+N is the power of everything but the fundamental relative to the
+ * total (AC) power; SNR is the fundamental relative to everything but the
+ * fundamental and its harmonics. Both are clamped to +/-200 dB.
+ */
+typedef struct {
+    double frequency;       /* Fundamental frequency in Hz */
+    double amplitude;       /* Fundamental peak amplitude */
+    double dc;              /* Mean of the block */
+    double rms;             /* RMS with the DC offset removed */
+    double thd_n_db;
+    double snr_db;
+} signal_metrics_t;
+
+/**
+ * Extremes over every reported block
+ */
+typedef struct {
+    uint64_t blocks;
+    double frequency_min;
+    double frequency_max;
+    double amplitude_min;
+    double rms_min;
+    double dc_max;          /* Largest |DC offset| */
+    double thd_n_db_max;
+    double snr_db_min;
+} signal_summary_t;
+
+/**
+ * Analyzer state for one channel
+ */
+typedef struct {
+    double sample_rate;
+    double expected;        /* Goertzel fundamental in Hz, 0 in FFT mode */
+    uint32_t block_frames;
+    uint32_t pos;           /* Samples into the current block */
+    double *window;
+    double window_sum;
+
+    /* Windowed sums of x and x^2 over the current block */
+    double sum;
+    double sum_sq;
+
+    /* Goertzel bins (fundamental and harmonics), tuned to track */
+    uint32_t num_bins;
+    double track;
+    double omega[SIGNAL_ANALYZER_MAX_HARMONICS];   /* Radians per sample */
+    double coeff[SIGNAL_ANALYZER_MAX_HARMONICS];
+    double cos_w[SIGNAL_ANALYZER_MAX_HARMONICS];
+    double sin_w[SIGNAL_ANALYZER_MAX_HARMONICS];
+    double s1[SIGNAL_ANALYZER_MAX_HARMONICS];
+    double s2[SIGNAL_ANALYZER_MAX_HARMONICS];
+    double prev_re;         /* Previous block's fundamental bin */
+    double prev_im;
+    double prev_omega;      /* ... and the frequency it was tuned to */
+    uint32_t warmup;        /* Blocks left before the bins track the tone */
+
+    /* FFT mode: samples are stored windowed, in bit-reversed order */
+    float *fft_re;
+    float *fft_im;
+    float *twiddle_re;      /* Stage with half-size m starts at index m - 1 */
+    float *twiddle_im;
+    uint32_t *bitrev;
+
+    signal_metrics_t last;  /* Most recent reported block */
+    signal_summary_t summary;
+} signal_analyzer_t;
+
+/**
+ * Allocate an analyzer
+ *
+ * @param a Analyzer to initialize
+ * @param sample_rate Sample rate in Hz
+ * @param expected_frequency Tone to track with Goertzel bins, or 0 for FFT
+ * @param block_frames Samples per analysis block (a power of two in FFT mode)
+ * @return 0 on success, VCARD_ERROR_* on failure
+ */
+int signal_analyzer_init(signal_analyzer_t *a, double sample_rate,
+                         double expected_frequency, uint32_t block_frames);
+
+/**
+ * Free an analyzer's buffers
+ *
+ * @param a Analyzer
+ */
+void signal_analyzer_free(signal_analyzer_t *a);
+
+/**
+ * Feed float samples
+ *
+ * @param a Analyzer
+ * @param samples First sample of this channel
+ * @param num_frames Number of samples to analyze
+ * @param stride Distance between consecutive samples (channel count for
+ *               interleaved buffers)
+ * @return Number of blocks reported by this call
+ */
+int signal_analyzer_process(signal_analyzer_t *a, const float *samples,
+                            size_t num_frames, size_t stride);
+
+/**
+ * Feed 16-bit samples (scaled to [-1.0, 1.0))
+ *
+ * @param a Analyzer
+ * @param samples First sample of this channel
+ * @param num_frames Number of samples to analyze
+ * @param stride Distance between consecutive samples
+ * @return Number of blocks reported by this call
+ */
+int signal_analyzer_process_i16(signal_analyzer_t *a, const int16_t *samples,
+                                size_t num_frames, size_t stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIGNAL_ANALYZER_H */
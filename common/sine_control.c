@@ -0,0 +1,202 @@
+/**
+ * Live Sine Parameter Control Implementation
+ */
+
+#include "sine_control.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SINE_CONTROL_MASK (SINE_CONTROL_QUEUE_SIZE - 1)
+
+void sine_control_init(sine_control_t *ctl, double frequency,
+                       double sample_rate, double amplitude)
+{
+    memset(ctl, 0, sizeof(*ctl));
+    sine_generator_init(&ctl->gen, frequency, sample_rate, amplitude);
+    vcard_atomic_store_relaxed_u32(&ctl->frequency_mhz,
+                                   (uint32_t)(frequency * 1000.0 + 0.5));
+}
+
+int sine_control_push(sine_control_t *ctl, sine_param_t param, double target,
+                      uint32_t ramp_frames, uint64_t frame)
+{
+    uint32_t w = vcard_atomic_load_relaxed_u32(&ctl->write_index);
+    uint32_t r = vcard_atomic_load_acquire_u32(&ctl->read_index);
+    sine_command_t *cmd;
+
+    if (param == SINE_PARAM_FREQUENCY) {
+        if (!(target >= SINE_CONTROL_MIN_FREQUENCY &&
+              target <= SINE_CONTROL_MAX_FREQUENCY)) {
+            return VCARD_ERROR_INVALID;
+        }
+    } else if (param == SINE_PARAM_AMPLITUDE) {
+        if (!(target >= 0.0 && target <= 1.0)) {
+            return VCARD_ERROR_INVALID;
+        }
+    } else {
+        return VCARD_ERROR_INVALID;
+    }
+    if (w - r >= SINE_CONTROL_QUEUE_SIZE) {
+        vcard_atomic_fetch_add_u32(&ctl->dropped, 1);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+
+    cmd = &ctl->commands[w & SINE_CONTROL_MASK];
+    cmd->frame = frame;
+    cmd->target = target;
+    cmd->ramp_frames = ramp_frames;
+    cmd->param = (uint32_t)param;
+
+    vcard_atomic_store_release_u32(&ctl->write_index, w + 1);
+    return VCARD_SUCCESS;
+}
+
+/**
+ * Oldest queued command, or NULL (render thread)
+ */
+static const sine_command_t *control_peek(sine_control_t *ctl)
+{
+    uint32_t r = vcard_atomic_load_relaxed_u32(&ctl->read_index);
+    uint32_t w = vcard_atomic_load_acquire_u32(&ctl->write_index);
+
+    return r == w ? NULL : &ctl->commands[r & SINE_CONTROL_MASK];
+}
+
+static void control_pop(sine_control_t *ctl)
+{
+    uint32_t r = vcard_atomic_load_relaxed_u32(&ctl->read_index);
+    vcard_atomic_store_release_u32(&ctl->read_index, r + 1);
+}
+
+static void control_complete(sine_control_t *ctl)
+{
+    uint32_t done = vcard_atomic_load_relaxed_u32(&ctl->completed);
+    vcard_atomic_store_release_u32(&ctl->completed, done + 1);
+}
+
+/**
+ * Start a command at the current frame (render thread)
+ */
+static void control_apply(sine_control_t *ctl, const sine_command_t *cmd)
+{
+    int is_frequency = cmd->param == SINE_PARAM_FREQUENCY;
+    sine_ramp_t *ramp = is_frequency ? &ctl->frequency : &ctl->amplitude;
+    double *value = is_frequency ? &ctl->gen.frequency : &ctl->gen.amplitude;
+
+    if (ramp->remaining) {
+        // Superseded: the new change continues from the current value
+        ramp->remaining = 0;
+        control_complete(ctl);
+    }
+
+    ramp->target = cmd->target;
+    if (cmd->ramp_frames == 0) {
+        *value = cmd->target;
+        control_complete(ctl);
+    } else if (is_frequency) {
+        ramp->step = pow(cmd->target / *value, 1.0 / (double)cmd->ramp_frames);
+        ramp->remaining = cmd->ramp_frames;
+    } else {
+        ramp->step = (cmd->target - *value) / (double)cmd->ramp_frames;
+        ramp->remaining = cmd->ramp_frames;
+    }
+}
+
+/**
+ * Render while at least one parameter ramps, advancing both per sample
+ */
+static void control_render_ramp(sine_control_t *ctl, float *out, size_t num_frames)
+{
+    double frequency = ctl->gen.frequency;
+    double amplitude = ctl->gen.amplitude;
+    double cycles = ctl->gen.phase / (2.0 * M_PI);
+    double inv_rate = 1.0 / ctl->gen.sample_rate;
+
+    for (size_t i = 0; i < num_frames; i++) {
+        out[i] = (float)(amplitude * sin(2.0 * M_PI * cycles));
+
+        cycles += frequency * inv_rate;
+        if (cycles >= 1.0) {
+            cycles -= 1.0;
+        }
+        if (ctl->frequency.remaining) {
+            frequency *= ctl->frequency.step;
+            if (--ctl->frequency.remaining == 0) {
+                frequency = ctl->frequency.target;
+                control_complete(ctl);
+            }
+        }
+        if (ctl->amplitude.remaining) {
+            amplitude += ctl->amplitude.step;
+            if (--ctl->amplitude.remaining == 0) {
+                amplitude = ctl->amplitude.target;
+                control_complete(ctl);
+            }
+        }
+    }
+
+    ctl->gen.frequency = frequency;
+    ctl->gen.amplitude = amplitude;
+    ctl->gen.phase = cycles * 2.0 * M_PI;
+}
+
+void sine_control_render(sine_control_t *ctl, float *out, size_t num_frames)
+{
+    size_t pos = 0;
+
+    while (pos < num_frames) {
+        const sine_command_t *cmd;
+        size_t seg = num_frames - pos;
+        uint32_t ramp;
+
+        // Start every command due at this frame, then stop at the next one
+        while ((cmd = control_peek(ctl)) != NULL && cmd->frame <= ctl->frame) {
+            control_apply(ctl, cmd);
+            control_pop(ctl);
+        }
+        if (cmd && cmd->frame - ctl->frame < seg) {
+            seg = (size_t)(cmd->frame - ctl->frame);
+        }
+
+        if (ctl->frequency.remaining || ctl->amplitude.remaining) {
+            // Return to the SIMD kernel as soon as the shorter ramp ends
+            ramp = ctl->frequency.remaining;
+            if (ramp == 0 || (ctl->amplitude.remaining && ctl->amplitude.remaining < ramp)) {
+                ramp = ctl->amplitude.remaining;
+            }
+            if (ramp < seg) {
+                seg = ramp;
+            }
+            control_render_ramp(ctl, out + pos, seg);
+        } else {
+            sine_generator_process_f32(&ctl->gen, out + pos, seg);
+        }
+
+        pos += seg;
+        ctl->frame += seg;
+    }
+
+    vcard_atomic_store_relaxed_u64(&ctl->frames, ctl->frame);
+    vcard_atomic_store_relaxed_u32(&ctl->frequency_mhz,
+                                   (uint32_t)(ctl->gen.frequency * 1000.0 + 0.5));
+}
+
+uint64_t sine_control_frames(sine_control_t *ctl)
+{
+    return vcard_atomic_load_relaxed_u64(&ctl->frames);
+}
+
+double sine_control_frequency(sine_control_t *ctl)
+{
+    return (double)vcard_atomic_load_relaxed_u32(&ctl->frequency_mhz) / 1000.0;
+}
+
+int sine_control_idle(sine_control_t *ctl)
+{
+    return vcard_atomic_load_acquire_u32(&ctl->completed) ==
+           vcard_atomic_load_relaxed_u32(&ctl->write_index);
+}
@@ -0,0 +1,159 @@
+/**
+ * Virtual Sound Card - Live Sine Parameter Control
+ *
+ * A sine generator whose frequency and amplitude can be changed while a
+ * real-time thread renders it. A control thread pushes commands into a
+ * wait-free single-producer/single-consumer queue; the render thread pops
+ * them and applies them at the frame they are stamped with, optionally as
+ * a ramp: linear for amplitude, exponential for frequency (a constant
+ * musical rate, as in a sweep). Progress goes back to the control thread
+ * through atomics. Neither side locks or allocates after init.
+ *
+ * Outside ramps the active SIMD sine kernel renders whole segments; during
+ * a ramp both parameters advance every sample.
+ */
+
+#ifndef SINE_CONTROL_H
+#define SINE_CONTROL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vcard.h"
+#include "vcard_atomic.h"
+#include "sine_generator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SINE_CONTROL_QUEUE_SIZE 64       /* Power of two */
+
+/* Frequencies accepted by sine_control_push() */
+#define SINE_CONTROL_MIN_FREQUENCY 1.0
+#define SINE_CONTROL_MAX_FREQUENCY 96000.0
+
+/* Frame stamp for "as soon as possible" */
+#define SINE_CONTROL_NOW 0
+
+/**
+ * Controllable parameters
+ */
+typedef enum {
+    SINE_PARAM_FREQUENCY = 0,   /* Hz, ramped exponentially */
+    SINE_PARAM_AMPLITUDE        /* 0.0 to 1.0, ramped linearly */
+} sine_param_t;
+
+/**
+ * One queued parameter change
+ */
+typedef struct {
+    uint64_t frame;             /* Frame at which the change starts */
+    double target;
+    uint32_t ramp_frames;       /* 0 to jump */
+    uint32_t param;             /* sine_param_t */
+} sine_command_t;
+
+/**
+ * Ramp state of one parameter (render thread)
+ */
+typedef struct {
+    double target;
+    double step;                /* Per-sample increment or ratio */
+    uint32_t remaining;         /* Samples left, 0 when steady */
+} sine_ramp_t;
+
+/**
+ * Controlled generator state
+ */
+typedef struct {
+    /* Render-thread owned */
+    sine_generator_t gen;
+    sine_ramp_t frequency;
+    sine_ramp_t amplitude;
+    uint64_t frame;                      /* Frames rendered so far */
+    char pad0[VCARD_CACHELINE];
+
+    /* Producer-owned line */
+    vcard_atomic_u32 write_index;
+    vcard_atomic_u32 dropped;            /* Commands rejected (queue full) */
+    char pad1[VCARD_CACHELINE - 2 * sizeof(uint32_t)];
+
+    /* Consumer-owned line, read by the control thread */
+    vcard_atomic_u32 read_index;
+    vcard_atomic_u32 completed;          /* Commands whose change has finished */
+    vcard_atomic_u64 frames;             /* frame, published after each call */
+    vcard_atomic_u32 frequency_mhz;      /* Current frequency in millihertz */
+    char pad2[VCARD_CACHELINE - 4 * sizeof(uint32_t) - sizeof(uint64_t)];
+
+    sine_command_t commands[SINE_CONTROL_QUEUE_SIZE];
+} sine_control_t;
+
+/**
+ * Initialize a controlled generator
+ *
+ * @param ctl Generator to initialize
+ * @param frequency Initial frequency in Hz
+ * @param sample_rate Sample rate in Hz
+ * @param amplitude Initial amplitude (0.0 to 1.0)
+ */
+void sine_control_init(sine_control_t *ctl, double frequency,
+                       double sample_rate, double amplitude);
+
+/**
+ * Queue a parameter change (control thread)
+ *
+ * Commands take effect in the order they are pushed. A change stamped with
+ * a frame that has already been rendered (such as SINE_CONTROL_NOW) starts
+ * with the next rendered frame. A new change to a parameter that is still
+ * ramping starts from wherever the ramp has got to. Wait-free; one
+ * producer thread.
+ *
+ * @param ctl Generator
+ * @param param Parameter to change
+ * @param target New value
+ * @param ramp_frames Frames over which to reach it (0 to jump)
+ * @param frame Frame at which the change starts
+ * @return 0 on success, VCARD_ERROR_INVALID for an out-of-range target,
+ *         VCARD_ERROR_NO_MEMORY if the queue is full
+ */
+int sine_control_push(sine_control_t *ctl, sine_param_t param, double target,
+                      uint32_t ramp_frames, uint64_t frame);
+
+/**
+ * Render mono samples, applying due commands (render thread)
+ *
+ * @param ctl Generator
+ * @param out Output samples
+ * @param num_frames Number of samples to render
+ */
+void sine_control_render(sine_control_t *ctl, float *out, size_t num_frames);
+
+/**
+ * Frames rendered so far (any thread)
+ *
+ * @param ctl Generator
+ * @return Frame counter as of the end of the last render call
+ */
+uint64_t sine_control_frames(sine_control_t *ctl);
+
+/**
+ * Current frequency (any thread)
+ *
+ * @param ctl Generator
+ * @return Frequency in Hz as of the end of the last render call, to 1 mHz
+ */
+double sine_control_frequency(sine_control_t *ctl);
+
+/**
+ * Check whether every pushed command has finished (control thread)
+ *
+ * @param ctl Generator
+ * @return 1 if all ramps and jumps pushed so far are complete, 0 otherwise
+ */
+int sine_control_idle(sine_control_t *ctl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SINE_CONTROL_H */
@@ -1,16 +1,433 @@
 /**
  * Sine Wave Generator Implementation
+ *
+ * Samples are produced by a polynomial approximation of sin(2*pi*x) on a
+ * phase that is accumulated in double precision (in cycles) and reduced to
+ * [-0.25, 0.25] before being evaluated in single precision. The same
+ * algorithm is implemented as a scalar loop and as SSE2, AVX2 and NEON
+ * kernels; the active kernel is chosen once at runtime.
  */
 
 #include "sine_generator.h"
+#include "vcard_atomic.h"
 #include <math.h>
+#include <string.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
-void sine_generator_init(sine_generator_t *gen, 
-                        double frequency, 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SINE_ARCH_X86 1
+#endif
+
+#if defined(SINE_ARCH_X86) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SINE_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(SINE_ARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+/* Compiled with a target attribute, enabled after a CPUID check */
+#define SINE_HAVE_AVX2 1
+#define SINE_AVX2_RUNTIME_CHECK 1
+#define SINE_AVX2_TARGET __attribute__((target("avx2,fma")))
+#include <immintrin.h>
+#elif defined(SINE_ARCH_X86) && defined(__AVX2__)
+/* MSVC /arch:AVX2: the whole binary already requires AVX2 */
+#define SINE_HAVE_AVX2 1
+#define SINE_AVX2_TARGET
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define SINE_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* Frames rendered per internal block by the format/interleave writers */
+#define SINE_BLOCK_FRAMES 256
+
+/*
+ * Taylor coefficients of sin(2*pi*r) in powers of r. On |r| <= 0.25 the
+ * truncation error of the degree-11 polynomial is below 6e-8.
+ */
+#define SINE_C1   6.28318530717958648f
+#define SINE_C3  -41.3417022403997448f
+#define SINE_C5   81.6052492760750319f
+#define SINE_C7  -76.7058597530612597f
+#define SINE_C9   42.0586939448102582f
+#define SINE_C11 -15.0946425768975121f
+
+typedef void (*sine_kernel_fn)(float *out, size_t n, double t, double inc,
+                               float amp);
+
+/**
+ * Wrap a phase in cycles to [-0.5, 0.5)
+ */
+static double phase_wrap(double x)
+{
+    return x - floor(x + 0.5);
+}
+
+/**
+ * Fractional part of a phase in cycles, in [0, 1)
+ */
+static double phase_frac(double x)
+{
+    return x - floor(x);
+}
+
+/**
+ * Fold a phase in [-0.5, 0.5) cycles to [-0.25, 0.25] (sin symmetry)
+ */
+static float sine_fold(double t)
+{
+    float r = (float)t;
+
+    if (r > 0.25f) {
+        r = 0.5f - r;
+    } else if (r < -0.25f) {
+        r = -0.5f - r;
+    }
+    return r;
+}
+
+/**
+ * Evaluate sin(2*pi*r) for |r| <= 0.25
+ */
+static float sine_poly(float r)
+{
+    float r2 = r * r;
+
+    return r * (SINE_C1 + r2 * (SINE_C3 + r2 * (SINE_C5 + r2 *
+               (SINE_C7 + r2 * (SINE_C9 + r2 * SINE_C11)))));
+}
+
+static void sine_kernel_scalar(float *out, size_t n, double t, double inc,
+                               float amp)
+{
+    for (size_t i = 0; i < n; i++) {
+        out[i] = amp * sine_poly(sine_fold(t));
+        t += inc;
+        if (t >= 0.5) {
+            t -= 1.0;
+        }
+    }
+}
+
+#ifdef SINE_HAVE_SSE2
+static void sine_kernel_sse2(float *out, size_t n, double t, double inc,
+                             float amp)
+{
+    size_t i = 0;
+
+    if (n >= 4) {
+        const __m128d one = _mm_set1_pd(1.0);
+        const __m128d half_d = _mm_set1_pd(0.5);
+        const __m128d step = _mm_set1_pd(phase_frac(4.0 * inc));
+        const __m128 sign_mask = _mm_set1_ps(-0.0f);
+        const __m128 quarter = _mm_set1_ps(0.25f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 vamp = _mm_set1_ps(amp);
+        __m128d t01 = _mm_set_pd(phase_wrap(t + inc), t);
+        __m128d t23 = _mm_set_pd(phase_wrap(t + 3.0 * inc),
+                                 phase_wrap(t + 2.0 * inc));
+
+        for (; i + 4 <= n; i += 4) {
+            __m128 r = _mm_movelh_ps(_mm_cvtpd_ps(t01), _mm_cvtpd_ps(t23));
+
+            // Fold |r| > 0.25 onto copysign(0.5, r) - r
+            __m128 sign = _mm_and_ps(r, sign_mask);
+            __m128 mask = _mm_cmpgt_ps(_mm_andnot_ps(sign_mask, r), quarter);
+            __m128 folded = _mm_sub_ps(_mm_or_ps(half, sign), r);
+            r = _mm_or_ps(_mm_and_ps(mask, folded), _mm_andnot_ps(mask, r));
+
+            __m128 r2 = _mm_mul_ps(r, r);
+            __m128 p = _mm_set1_ps(SINE_C11);
+            p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(SINE_C9));
+            p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(SINE_C7));
+            p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(SINE_C5));
+            p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(SINE_C3));
+            p = _mm_add_ps(_mm_mul_ps(p, r2), _mm_set1_ps(SINE_C1));
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_mul_ps(p, r), vamp));
+
+            // Advance by 4 samples; step is in [0, 1), so wrap once
+            t01 = _mm_add_pd(t01, step);
+            t23 = _mm_add_pd(t23, step);
+            t01 = _mm_sub_pd(t01, _mm_and_pd(_mm_cmpge_pd(t01, half_d), one));
+            t23 = _mm_sub_pd(t23, _mm_and_pd(_mm_cmpge_pd(t23, half_d), one));
+        }
+    }
+
+    if (i < n) {
+        sine_kernel_scalar(out + i, n - i, phase_wrap(t + (double)i * inc),
+                           inc, amp);
+    }
+}
+#endif
+
+#ifdef SINE_HAVE_AVX2
+SINE_AVX2_TARGET
+static void sine_kernel_avx2(float *out, size_t n, double t, double inc,
+                             float amp)
+{
+    size_t i = 0;
+
+    if (n >= 8) {
+        const __m256d one = _mm256_set1_pd(1.0);
+        const __m256d half_d = _mm256_set1_pd(0.5);
+        const __m256d step = _mm256_set1_pd(phase_frac(8.0 * inc));
+        const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+        const __m256 quarter = _mm256_set1_ps(0.25f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 vamp = _mm256_set1_ps(amp);
+        __m256d t03 = _mm256_set_pd(phase_wrap(t + 3.0 * inc),
+                                    phase_wrap(t + 2.0 * inc),
+                                    phase_wrap(t + inc), t);
+        __m256d t47 = _mm256_set_pd(phase_wrap(t + 7.0 * inc),
+                                    phase_wrap(t + 6.0 * inc),
+                                    phase_wrap(t + 5.0 * inc),
+                                    phase_wrap(t + 4.0 * inc));
+
+        for (; i + 8 <= n; i += 8) {
+            __m256 r = _mm256_insertf128_ps(
+                _mm256_castps128_ps256(_mm256_cvtpd_ps(t03)),
+                _mm256_cvtpd_ps(t47), 1);
+
+            __m256 sign = _mm256_and_ps(r, sign_mask);
+            __m256 mask = _mm256_cmp_ps(_mm256_andnot_ps(sign_mask, r),
+                                        quarter, _CMP_GT_OQ);
+            __m256 folded = _mm256_sub_ps(_mm256_or_ps(half, sign), r);
+            r = _mm256_blendv_ps(r, folded, mask);
+
+            __m256 r2 = _mm256_mul_ps(r, r);
+            __m256 p = _mm256_set1_ps(SINE_C11);
+            p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(SINE_C9));
+            p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(SINE_C7));
+            p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(SINE_C5));
+            p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(SINE_C3));
+            p = _mm256_fmadd_ps(p, r2, _mm256_set1_ps(SINE_C1));
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_mul_ps(p, r), vamp));
+
+            t03 = _mm256_add_pd(t03, step);
+            t47 = _mm256_add_pd(t47, step);
+            t03 = _mm256_sub_pd(t03, _mm256_and_pd(
+                _mm256_cmp_pd(t03, half_d, _CMP_GE_OQ), one));
+            t47 = _mm256_sub_pd(t47, _mm256_and_pd(
+                _mm256_cmp_pd(t47, half_d, _CMP_GE_OQ), one));
+        }
+    }
+
+    if (i < n) {
+        sine_kernel_scalar(out + i, n - i, phase_wrap(t + (double)i * inc),
+                           inc, amp);
+    }
+}
+#endif
+
+#ifdef SINE_HAVE_NEON
+static void sine_kernel_neon(float *out, size_t n, double t, double inc,
+                             float amp)
+{
+    size_t i = 0;
+
+    if (n >= 4) {
+        const float64x2_t one = vdupq_n_f64(1.0);
+        const float64x2_t half_d = vdupq_n_f64(0.5);
+        const float64x2_t step = vdupq_n_f64(phase_frac(4.0 * inc));
+        const uint32x4_t sign_mask = vdupq_n_u32(0x80000000u);
+        const uint32x4_t half_bits = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+        const float32x4_t quarter = vdupq_n_f32(0.25f);
+        double lanes[4] = {
+            t, phase_wrap(t + inc), phase_wrap(t + 2.0 * inc),
+            phase_wrap(t + 3.0 * inc)
+        };
+        float64x2_t t01 = vld1q_f64(lanes);
+        float64x2_t t23 = vld1q_f64(lanes + 2);
+
+        for (; i + 4 <= n; i += 4) {
+            float32x4_t r = vcombine_f32(vcvt_f32_f64(t01), vcvt_f32_f64(t23));
+
+            uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(r), sign_mask);
+            uint32x4_t mask = vcgtq_f32(vabsq_f32(r), quarter);
+            float32x4_t folded = vsubq_f32(
+                vreinterpretq_f32_u32(vorrq_u32(half_bits, sign)), r);
+            r = vbslq_f32(mask, folded, r);
+
+            float32x4_t r2 = vmulq_f32(r, r);
+            float32x4_t p = vdupq_n_f32(SINE_C11);
+            p = vfmaq_f32(vdupq_n_f32(SINE_C9), p, r2);
+            p = vfmaq_f32(vdupq_n_f32(SINE_C7), p, r2);
+            p = vfmaq_f32(vdupq_n_f32(SINE_C5), p, r2);
+            p = vfmaq_f32(vdupq_n_f32(SINE_C3), p, r2);
+            p = vfmaq_f32(vdupq_n_f32(SINE_C1), p, r2);
+            vst1q_f32(out + i, vmulq_n_f32(vmulq_f32(p, r), amp));
+
+            t01 = vaddq_f64(t01, step);
+            t23 = vaddq_f64(t23, step);
+            t01 = vsubq_f64(t01, vbslq_f64(vcgeq_f64(t01, half_d), one,
+                                           vdupq_n_f64(0.0)));
+            t23 = vsubq_f64(t23, vbslq_f64(vcgeq_f64(t23, half_d), one,
+                                           vdupq_n_f64(0.0)));
+        }
+    }
+
+    if (i < n) {
+        sine_kernel_scalar(out + i, n - i, phase_wrap(t + (double)i * inc),
+                           inc, amp);
+    }
+}
+#endif
+
+/* A kernel and its ID, published together */
+typedef struct {
+    sine_kernel_fn fn;
+    sine_kernel_t id;
+} sine_kernel_entry_t;
+
+static const sine_kernel_entry_t kernel_scalar = { sine_kernel_scalar, SINE_KERNEL_SCALAR };
+#ifdef SINE_HAVE_SSE2
+static const sine_kernel_entry_t kernel_sse2 = { sine_kernel_sse2, SINE_KERNEL_SSE2 };
+#endif
+#ifdef SINE_HAVE_AVX2
+static const sine_kernel_entry_t kernel_avx2 = { sine_kernel_avx2, SINE_KERNEL_AVX2 };
+#endif
+#ifdef SINE_HAVE_NEON
+static const sine_kernel_entry_t kernel_neon = { sine_kernel_neon, SINE_KERNEL_NEON };
+#endif
+
+/*
+ * Kernel dispatch state (a const sine_kernel_entry_t *, resolved lazily
+ * on first use). Generators render from many threads, so it is one
+ * pointer stored with release and loaded with acquire; threads racing on
+ * the first use all resolve the same entry.
+ */
+static vcard_atomic_ptr active_kernel = NULL;
+
+static const sine_kernel_entry_t *get_active_kernel(void)
+{
+    const sine_kernel_entry_t *entry =
+        (const sine_kernel_entry_t *)vcard_atomic_load_acquire_ptr(&active_kernel);
+
+    if (!entry) {
+        sine_generator_select_kernel(SINE_KERNEL_AUTO);
+        entry = (const sine_kernel_entry_t *)vcard_atomic_load_acquire_ptr(&active_kernel);
+    }
+    return entry;
+}
+
+int sine_generator_kernel_supported(sine_kernel_t kernel)
+{
+    switch (kernel) {
+    case SINE_KERNEL_AUTO:
+    case SINE_KERNEL_SCALAR:
+        return 1;
+#ifdef SINE_HAVE_SSE2
+    case SINE_KERNEL_SSE2:
+        return 1;
+#endif
+#ifdef SINE_HAVE_AVX2
+    case SINE_KERNEL_AVX2:
+#ifdef SINE_AVX2_RUNTIME_CHECK
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+        return 1;
+#endif
+#endif
+#ifdef SINE_HAVE_NEON
+    case SINE_KERNEL_NEON:
+        return 1;
+#endif
+    default:
+        return 0;
+    }
+}
+
+int sine_generator_select_kernel(sine_kernel_t kernel)
+{
+    const sine_kernel_entry_t *entry;
+
+    if (kernel == SINE_KERNEL_AUTO) {
+        if (sine_generator_kernel_supported(SINE_KERNEL_AVX2)) {
+            kernel = SINE_KERNEL_AVX2;
+        } else if (sine_generator_kernel_supported(SINE_KERNEL_SSE2)) {
+            kernel = SINE_KERNEL_SSE2;
+        } else if (sine_generator_kernel_supported(SINE_KERNEL_NEON)) {
+            kernel = SINE_KERNEL_NEON;
+        } else {
+            kernel = SINE_KERNEL_SCALAR;
+        }
+    }
+
+    if (!sine_generator_kernel_supported(kernel)) {
+        return -1;
+    }
+
+    switch (kernel) {
+#ifdef SINE_HAVE_SSE2
+    case SINE_KERNEL_SSE2:
+        entry = &kernel_sse2;
+        break;
+#endif
+#ifdef SINE_HAVE_AVX2
+    case SINE_KERNEL_AVX2:
+        entry = &kernel_avx2;
+        break;
+#endif
+#ifdef SINE_HAVE_NEON
+    case SINE_KERNEL_NEON:
+        entry = &kernel_neon;
+        break;
+#endif
+    default:
+        entry = &kernel_scalar;
+        break;
+    }
+    vcard_atomic_store_release_ptr(&active_kernel, (void *)entry);
+    return 0;
+}
+
+sine_kernel_t sine_generator_active_kernel(void)
+{
+    return get_active_kernel()->id;
+}
+
+const char *sine_generator_kernel_name(sine_kernel_t kernel)
+{
+    switch (kernel) {
+    case SINE_KERNEL_AUTO:   return "auto";
+    case SINE_KERNEL_SCALAR: return "scalar";
+    case SINE_KERNEL_SSE2:   return "sse2";
+    case SINE_KERNEL_AVX2:   return "avx2";
+    case SINE_KERNEL_NEON:   return "neon";
+    default:                 return "unknown";
+    }
+}
+
+/**
+ * Render num_samples mono float samples and advance the generator phase
+ */
+static void sine_render(sine_generator_t *gen, float *out, size_t num_samples)
+{
+    double cycles = gen->phase / (2.0 * M_PI);
+    double inc = gen->frequency / gen->sample_rate;
+
+    inc = phase_frac(inc);
+    get_active_kernel()->fn(out, num_samples, phase_wrap(cycles), inc,
+                            (float)gen->amplitude);
+
+    // Recompute the end phase from the start phase to avoid drift
+    cycles += (double)num_samples * inc;
+    cycles = phase_frac(cycles);
+    gen->phase = cycles * 2.0 * M_PI;
+    if (gen->phase >= 2.0 * M_PI) {
+        gen->phase = 0.0;
+    }
+}
+
+void sine_generator_init(sine_generator_t *gen,
+                        double frequency,
                         double sample_rate,
                         double amplitude)
 {
@@ -20,66 +437,605 @@ void sine_generator_init(sine_generator_t *gen,
     gen->amplitude = amplitude;
 }
 
-void sine_generator_process_f32(sine_generator_t *gen, 
-                               float *buffer, 
+void sine_generator_process_f32(sine_generator_t *gen,
+                               float *buffer,
                                size_t num_samples)
 {
-    double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
-    
-    for (size_t i = 0; i < num_samples; i++) {
-        buffer[i] = (float)(gen->amplitude * sin(gen->phase));
-        gen->phase += phase_increment;
-        
-        // Wrap phase to avoid numerical issues with large values
-        if (gen->phase >= 2.0 * M_PI) {
-            gen->phase -= 2.0 * M_PI;
+    sine_render(gen, buffer, num_samples);
+}
+
+/**
+ * Clip a sample to full scale so integer conversion cannot overflow
+ */
+static float sine_clip(float sample)
+{
+    return sample > 1.0f ? 1.0f : (sample < -1.0f ? -1.0f : sample);
+}
+
+/**
+ * Quantize n samples to 16 bits
+ *
+ * Without noise, clip(x) * 32767 is truncated toward zero. With noise (in
+ * LSBs), the noise is added after scaling and the sum is rounded to
+ * nearest and saturated.
+ */
+static void quantize_i16(const float *src, const float *noise, size_t n, int16_t *out)
+{
+    size_t i = 0;
+
+#if defined(SINE_HAVE_SSE2)
+    {
+        const __m128 lo = _mm_set1_ps(-1.0f);
+        const __m128 hi = _mm_set1_ps(1.0f);
+        const __m128 scale = _mm_set1_ps(32767.0f);
+
+        for (; i + 8 <= n; i += 8) {
+            __m128 a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), lo), hi), scale);
+            __m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), lo), hi),
+                                  scale);
+            __m128i ia, ib;
+
+            if (noise) {
+                ia = _mm_cvtps_epi32(_mm_add_ps(a, _mm_loadu_ps(noise + i)));
+                ib = _mm_cvtps_epi32(_mm_add_ps(b, _mm_loadu_ps(noise + i + 4)));
+            } else {
+                ia = _mm_cvttps_epi32(a);
+                ib = _mm_cvttps_epi32(b);
+            }
+            _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(ia, ib));
+        }
+    }
+#elif defined(SINE_HAVE_NEON)
+    {
+        const float32x4_t lo = vdupq_n_f32(-1.0f);
+        const float32x4_t hi = vdupq_n_f32(1.0f);
+
+        for (; i + 8 <= n; i += 8) {
+            float32x4_t a = vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(src + i), lo), hi),
+                                        32767.0f);
+            float32x4_t b = vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(src + i + 4), lo), hi),
+                                        32767.0f);
+            int32x4_t ia, ib;
+
+            if (noise) {
+                ia = vcvtnq_s32_f32(vaddq_f32(a, vld1q_f32(noise + i)));
+                ib = vcvtnq_s32_f32(vaddq_f32(b, vld1q_f32(noise + i + 4)));
+            } else {
+                ia = vcvtq_s32_f32(a);
+                ib = vcvtq_s32_f32(b);
+            }
+            vst1q_s16(out + i, vcombine_s16(vqmovn_s32(ia), vqmovn_s32(ib)));
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        float v = sine_clip(src[i]) * 32767.0f;
+
+        if (noise) {
+            long q = lrintf(v + noise[i]);
+            out[i] = (int16_t)(q > 32767 ? 32767 : (q < -32768 ? -32768 : q));
+        } else {
+            out[i] = (int16_t)v;
         }
     }
 }
 
-void sine_generator_process_i16(sine_generator_t *gen, 
-                               int16_t *buffer, 
-                               size_t num_samples)
+/**
+ * Quantize n samples to integers of up to 32 bits with full scale at scale
+ *
+ * Scaling is done in double precision so every 24 and 32-bit code is
+ * reachable. Rounding is as for quantize_i16, saturating at
+ * [-scale - 1, scale].
+ */
+static void quantize_i32(const float *src, const float *noise, size_t n, int32_t *out,
+                         double scale)
 {
-    double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
-    const double scale = 32767.0; // Max value for 16-bit signed integer
-    
-    for (size_t i = 0; i < num_samples; i++) {
-        double sample = gen->amplitude * sin(gen->phase);
-        buffer[i] = (int16_t)(sample * scale);
-        gen->phase += phase_increment;
-        
-        // Wrap phase to avoid numerical issues with large values
-        if (gen->phase >= 2.0 * M_PI) {
-            gen->phase -= 2.0 * M_PI;
+    size_t i = 0;
+
+#if defined(SINE_HAVE_SSE2)
+    {
+        const __m128 lo = _mm_set1_ps(-1.0f);
+        const __m128 hi = _mm_set1_ps(1.0f);
+        const __m128d vscale = _mm_set1_pd(scale);
+        const __m128d qmin = _mm_set1_pd(-scale - 1.0);
+        const __m128d qmax = _mm_set1_pd(scale);
+
+        for (; i + 4 <= n; i += 4) {
+            __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), lo), hi);
+            __m128d a = _mm_mul_pd(_mm_cvtps_pd(x), vscale);
+            __m128d b = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(x, x)), vscale);
+            __m128i ia, ib;
+
+            if (noise) {
+                __m128 z = _mm_loadu_ps(noise + i);
+                a = _mm_add_pd(a, _mm_cvtps_pd(z));
+                b = _mm_add_pd(b, _mm_cvtps_pd(_mm_movehl_ps(z, z)));
+                ia = _mm_cvtpd_epi32(_mm_min_pd(_mm_max_pd(a, qmin), qmax));
+                ib = _mm_cvtpd_epi32(_mm_min_pd(_mm_max_pd(b, qmin), qmax));
+            } else {
+                ia = _mm_cvttpd_epi32(a);
+                ib = _mm_cvttpd_epi32(b);
+            }
+            _mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi64(ia, ib));
+        }
+    }
+#elif defined(SINE_HAVE_NEON)
+    {
+        const float32x4_t lo = vdupq_n_f32(-1.0f);
+        const float32x4_t hi = vdupq_n_f32(1.0f);
+        const float64x2_t qmin = vdupq_n_f64(-scale - 1.0);
+        const float64x2_t qmax = vdupq_n_f64(scale);
+
+        for (; i + 4 <= n; i += 4) {
+            float32x4_t x = vminq_f32(vmaxq_f32(vld1q_f32(src + i), lo), hi);
+            float64x2_t a = vmulq_n_f64(vcvt_f64_f32(vget_low_f32(x)), scale);
+            float64x2_t b = vmulq_n_f64(vcvt_high_f64_f32(x), scale);
+            int64x2_t ia, ib;
+
+            if (noise) {
+                float32x4_t z = vld1q_f32(noise + i);
+                a = vaddq_f64(a, vcvt_f64_f32(vget_low_f32(z)));
+                b = vaddq_f64(b, vcvt_high_f64_f32(z));
+                ia = vcvtnq_s64_f64(vminq_f64(vmaxq_f64(a, qmin), qmax));
+                ib = vcvtnq_s64_f64(vminq_f64(vmaxq_f64(b, qmin), qmax));
+            } else {
+                ia = vcvtq_s64_f64(a);
+                ib = vcvtq_s64_f64(b);
+            }
+            vst1q_s32(out + i, vcombine_s32(vmovn_s64(ia), vmovn_s64(ib)));
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        double v = (double)sine_clip(src[i]) * scale;
+
+        if (noise) {
+            v += noise[i];
+            v = v > scale ? scale : (v < -scale - 1.0 ? -scale - 1.0 : v);
+            out[i] = (int32_t)lrint(v);
+        } else {
+            out[i] = (int32_t)v;
         }
     }
 }
 
-void sine_generator_process_i32(sine_generator_t *gen, 
-                               int32_t *buffer, 
-                               size_t num_samples)
+void sine_dither_init(sine_dither_t *dither, uint32_t seed)
+{
+    dither->state = seed;
+}
+
+/**
+ * Fill n samples of triangular noise in (-1, 1) LSB
+ */
+static void dither_noise(sine_dither_t *dither, float *noise, size_t n)
+{
+    const float unit = 1.0f / 16777216.0f;
+    uint32_t state = dither->state;
+
+    for (size_t i = 0; i < n; i++) {
+        uint32_t a, b;
+
+        // Difference of two uniform draws from a 32-bit LCG (top 24 bits)
+        state = state * 1664525u + 1013904223u;
+        a = state >> 8;
+        state = state * 1664525u + 1013904223u;
+        b = state >> 8;
+        noise[i] = (float)((int32_t)a - (int32_t)b) * unit;
+    }
+    dither->state = state;
+}
+
+/*
+ * Store kernels: quantize at most SINE_BLOCK_FRAMES rendered samples and
+ * write each one to `count` adjacent channels. They are instantiated per
+ * format for the common channel counts, where the copy loop has a constant
+ * trip count the compiler unrolls and vectorizes, and once more with the
+ * count taken from the argument for any other layout.
+ */
+static const float *quantize_block_f32(const float *src, const float *noise, size_t n,
+                                       float *out)
+{
+    (void)noise;
+    (void)n;
+    (void)out;
+    return src;
+}
+
+static const int16_t *quantize_block_i16(const float *src, const float *noise, size_t n,
+                                         int16_t *out)
+{
+    quantize_i16(src, noise, n, out);
+    return out;
+}
+
+static const int32_t *quantize_block_i24_32(const float *src, const float *noise, size_t n,
+                                            int32_t *out)
+{
+    quantize_i32(src, noise, n, out, 8388607.0);
+    return out;
+}
+
+static const int32_t *quantize_block_i32(const float *src, const float *noise, size_t n,
+                                         int32_t *out)
+{
+    quantize_i32(src, noise, n, out, 2147483647.0);
+    return out;
+}
+
+#define SINE_DEFINE_STORE(fmt, type, suffix, count) \
+    static void store_##fmt##_##suffix(const float *src, const float *noise, size_t n, \
+                                       void *dst, unsigned int channels) \
+    { \
+        type tmp[SINE_BLOCK_FRAMES]; \
+        type *out = (type *)dst; \
+        const type *q = quantize_block_##fmt(src, noise, n, (count) == 1 ? out : tmp); \
+        (void)channels; \
+        if ((count) == 1) { \
+            if (q != out) { \
+                memcpy(out, q, n * sizeof(type)); \
+            } \
+            return; \
+        } \
+        for (size_t i = 0; i < n; i++) { \
+            for (unsigned int ch = 0; ch < (count); ch++) { \
+                out[i * (count) + ch] = q[i]; \
+            } \
+        } \
+    }
+
+/*
+ * Packed 24-bit: three little-endian bytes per sample. On little-endian
+ * hosts every channel but the last of a frame is one 4-byte store whose
+ * top byte the next channel overwrites, which is several times faster
+ * than storing bytes; the last channel stays within the frame.
+ */
+#if defined(_WIN32) || \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define SINE_STORE_I24_FRAME(p, sample, count) \
+    do { \
+        uint16_t lo = (uint16_t)(sample); \
+        for (unsigned int ch = 0; ch + 1 < (count); ch++) { \
+            memcpy((p) + 3 * ch, &(sample), 4); \
+        } \
+        memcpy((p) + 3 * ((count) - 1), &lo, 2); \
+        (p)[3 * ((count) - 1) + 2] = (uint8_t)((sample) >> 16); \
+    } while (0)
+#else
+#define SINE_STORE_I24_FRAME(p, sample, count) \
+    do { \
+        for (unsigned int ch = 0; ch < (count); ch++) { \
+            (p)[3 * ch] = (uint8_t)(sample); \
+            (p)[3 * ch + 1] = (uint8_t)((sample) >> 8); \
+            (p)[3 * ch + 2] = (uint8_t)((sample) >> 16); \
+        } \
+    } while (0)
+#endif
+
+#define SINE_DEFINE_STORE_I24(suffix, count) \
+    static void store_i24_##suffix(const float *src, const float *noise, size_t n, \
+                                   void *dst, unsigned int channels) \
+    { \
+        int32_t q[SINE_BLOCK_FRAMES]; \
+        uint8_t *p = (uint8_t *)dst; \
+        (void)channels; \
+        quantize_i32(src, noise, n, q, 8388607.0); \
+        for (size_t i = 0; i < n; i++, p += 3 * (count)) { \
+            uint32_t sample = (uint32_t)q[i]; \
+            SINE_STORE_I24_FRAME(p, sample, count); \
+        } \
+    }
+
+#define SINE_DEFINE_STORES(fmt, type) \
+    SINE_DEFINE_STORE(fmt, type, 1, 1) \
+    SINE_DEFINE_STORE(fmt, type, 2, 2) \
+    SINE_DEFINE_STORE(fmt, type, 6, 6) \
+    SINE_DEFINE_STORE(fmt, type, 8, 8) \
+    SINE_DEFINE_STORE(fmt, type, 16, 16) \
+    SINE_DEFINE_STORE(fmt, type, 32, 32) \
+    SINE_DEFINE_STORE(fmt, type, n, channels)
+
+SINE_DEFINE_STORES(f32, float)
+SINE_DEFINE_STORES(i16, int16_t)
+SINE_DEFINE_STORES(i24_32, int32_t)
+SINE_DEFINE_STORES(i32, int32_t)
+SINE_DEFINE_STORE_I24(1, 1)
+SINE_DEFINE_STORE_I24(2, 2)
+SINE_DEFINE_STORE_I24(6, 6)
+SINE_DEFINE_STORE_I24(8, 8)
+SINE_DEFINE_STORE_I24(16, 16)
+SINE_DEFINE_STORE_I24(32, 32)
+SINE_DEFINE_STORE_I24(n, channels)
+
+#define SINE_STORE_ROW(fmt) \
+    { store_##fmt##_1, store_##fmt##_2, store_##fmt##_6, store_##fmt##_8, \
+      store_##fmt##_16, store_##fmt##_32, store_##fmt##_n }
+
+/* Indexed by sine_format_t, then by store_slot() */
+static const sine_store_fn store_table[][7] = {
+    SINE_STORE_ROW(f32),
+    SINE_STORE_ROW(i16),
+    SINE_STORE_ROW(i24),
+    SINE_STORE_ROW(i32),
+    SINE_STORE_ROW(i24_32)
+};
+
+/* Column of store_table for a channel count; the last one takes any count */
+static int store_slot(unsigned int channels)
+{
+    switch (channels) {
+    case 1:  return 0;
+    case 2:  return 1;
+    case 6:  return 2;
+    case 8:  return 3;
+    case 16: return 4;
+    case 32: return 5;
+    default: return 6;
+    }
+}
+
+int sine_writer_init(sine_writer_t *writer, sine_format_t format,
+                     unsigned int channels, int planar)
+{
+    size_t sample_bytes = sine_format_bytes(format);
+
+    if (sample_bytes == 0 || channels == 0) {
+        memset(writer, 0, sizeof(*writer));
+        return -1;
+    }
+    writer->format = format;
+    writer->channels = channels;
+    writer->planar = planar ? 1 : 0;
+    writer->frame_bytes = planar ? sample_bytes : sample_bytes * channels;
+    // Planar output converts into the first plane and copies it to the rest
+    writer->store = store_table[format][store_slot(planar ? 1 : channels)];
+    return 0;
+}
+
+/**
+ * Write one block of at most SINE_BLOCK_FRAMES samples at frame offset
+ */
+static void writer_block(const sine_writer_t *writer, const float *src, size_t n,
+                         void *const *buffers, size_t offset, sine_dither_t *dither)
+{
+    float noise[SINE_BLOCK_FRAMES];
+    const float *z = NULL;
+    size_t start = offset * writer->frame_bytes;
+    uint8_t *first = (uint8_t *)buffers[0] + start;
+
+    // Float output is not dithered, and leaves the noise sequence alone
+    if (dither && writer->format != SINE_FORMAT_F32) {
+        dither_noise(dither, noise, n);
+        z = noise;
+    }
+    writer->store(src, z, n, first, writer->channels);
+    for (unsigned int ch = 1; writer->planar && ch < writer->channels; ch++) {
+        memcpy((uint8_t *)buffers[ch] + start, first, n * writer->frame_bytes);
+    }
+}
+
+void sine_writer_convert(const sine_writer_t *writer, const float *src, size_t num_frames,
+                         void *const *buffers, sine_dither_t *dither)
 {
-    double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
-    const double scale = 2147483647.0; // Max value for 32-bit signed integer
-    
-    for (size_t i = 0; i < num_samples; i++) {
-        double sample = gen->amplitude * sin(gen->phase);
-        buffer[i] = (int32_t)(sample * scale);
-        gen->phase += phase_increment;
-        
-        // Wrap phase to avoid numerical issues with large values
-        if (gen->phase >= 2.0 * M_PI) {
-            gen->phase -= 2.0 * M_PI;
+    size_t offset = 0;
+
+    if (!writer->store) {
+        return;
+    }
+    while (offset < num_frames) {
+        size_t n = num_frames - offset < SINE_BLOCK_FRAMES ?
+                   num_frames - offset : SINE_BLOCK_FRAMES;
+
+        writer_block(writer, src + offset, n, buffers, offset, dither);
+        offset += n;
+    }
+}
+
+void sine_writer_render(const sine_writer_t *writer, sine_generator_t *gen,
+                        void *const *buffers, size_t num_frames, sine_dither_t *dither)
+{
+    float block[SINE_BLOCK_FRAMES];
+    size_t offset = 0;
+
+    if (!writer->store) {
+        return;
+    }
+    if (writer->format == SINE_FORMAT_F32 && writer->planar) {
+        // The kernel renders straight into the first plane; the others are copies
+        sine_render(gen, (float *)buffers[0], num_frames);
+        for (unsigned int ch = 1; ch < writer->channels; ch++) {
+            memcpy(buffers[ch], buffers[0], num_frames * sizeof(float));
+        }
+        return;
+    }
+    if (writer->format == SINE_FORMAT_F32 && writer->channels == 1) {
+        // Interleaved mono is one contiguous plane (the only buffer passed)
+        sine_render(gen, (float *)buffers[0], num_frames);
+        return;
+    }
+
+    while (offset < num_frames) {
+        size_t n = num_frames - offset < SINE_BLOCK_FRAMES ?
+                   num_frames - offset : SINE_BLOCK_FRAMES;
+
+        sine_render(gen, block, n);
+        writer_block(writer, block, n, buffers, offset, dither);
+        offset += n;
+    }
+}
+
+void sine_format_convert(const float *src, size_t num_frames, void *buffer,
+                         unsigned int channels, sine_format_t format)
+{
+    sine_format_convert_dither(src, num_frames, buffer, channels, format, NULL);
+}
+
+void sine_format_convert_dither(const float *src, size_t num_frames, void *buffer,
+                                unsigned int channels, sine_format_t format,
+                                sine_dither_t *dither)
+{
+    sine_writer_t writer;
+
+    if (sine_writer_init(&writer, format, channels, 0) == 0) {
+        sine_writer_convert(&writer, src, num_frames, &buffer, dither);
+    }
+}
+
+void sine_format_to_float(const void *src, size_t num_samples, size_t stride,
+                          sine_format_t format, float *dst)
+{
+    const uint8_t *in = (const uint8_t *)src;
+    size_t step = sine_format_bytes(format) * stride;
+
+    switch (format) {
+    case SINE_FORMAT_F32:
+        for (size_t i = 0; i < num_samples; i++, in += step) {
+            memcpy(&dst[i], in, sizeof(float));
         }
+        break;
+    case SINE_FORMAT_I16:
+        for (size_t i = 0; i < num_samples; i++, in += step) {
+            int16_t s;
+            memcpy(&s, in, sizeof(s));
+            dst[i] = (float)s * (1.0f / 32768.0f);
+        }
+        break;
+    case SINE_FORMAT_I24:
+        for (size_t i = 0; i < num_samples; i++, in += step) {
+            int32_t s = (int32_t)((uint32_t)in[0] << 8 | (uint32_t)in[1] << 16 |
+                                  (uint32_t)in[2] << 24) >> 8;
+            dst[i] = (float)s * (1.0f / 8388608.0f);
+        }
+        break;
+    case SINE_FORMAT_I24_32:
+        for (size_t i = 0; i < num_samples; i++, in += step) {
+            uint32_t s;
+            memcpy(&s, in, sizeof(s));
+            // Only the low 24 bits are significant
+            dst[i] = (float)((int32_t)(s << 8) >> 8) * (1.0f / 8388608.0f);
+        }
+        break;
+    case SINE_FORMAT_I32:
+        for (size_t i = 0; i < num_samples; i++, in += step) {
+            int32_t s;
+            memcpy(&s, in, sizeof(s));
+            dst[i] = (float)((double)s * (1.0 / 2147483648.0));
+        }
+        break;
+    }
+}
+
+size_t sine_format_bytes(sine_format_t format)
+{
+    switch (format) {
+    case SINE_FORMAT_F32:    return sizeof(float);
+    case SINE_FORMAT_I16:    return sizeof(int16_t);
+    case SINE_FORMAT_I24:    return 3;
+    case SINE_FORMAT_I24_32: return sizeof(int32_t);
+    case SINE_FORMAT_I32:    return sizeof(int32_t);
+    default:                 return 0;
+    }
+}
+
+void sine_generator_write_interleaved(sine_generator_t *gen,
+                                      void *buffer,
+                                      size_t num_frames,
+                                      unsigned int channels,
+                                      sine_format_t format)
+{
+    sine_generator_write_interleaved_dither(gen, buffer, num_frames, channels,
+                                            format, NULL);
+}
+
+void sine_generator_write_interleaved_dither(sine_generator_t *gen,
+                                             void *buffer,
+                                             size_t num_frames,
+                                             unsigned int channels,
+                                             sine_format_t format,
+                                             sine_dither_t *dither)
+{
+    sine_writer_t writer;
+
+    if (sine_writer_init(&writer, format, channels, 0) == 0) {
+        sine_writer_render(&writer, gen, &buffer, num_frames, dither);
+    }
+}
+
+void sine_generator_write_planar(sine_generator_t *gen,
+                                 void *const *buffers,
+                                 size_t num_frames,
+                                 unsigned int channels,
+                                 sine_format_t format)
+{
+    sine_generator_write_planar_dither(gen, buffers, num_frames, channels, format, NULL);
+}
+
+void sine_generator_write_planar_dither(sine_generator_t *gen,
+                                        void *const *buffers,
+                                        size_t num_frames,
+                                        unsigned int channels,
+                                        sine_format_t format,
+                                        sine_dither_t *dither)
+{
+    sine_writer_t writer;
+
+    if (sine_writer_init(&writer, format, channels, 1) == 0) {
+        sine_writer_render(&writer, gen, buffers, num_frames, dither);
     }
 }
 
+void sine_generator_process_i16(sine_generator_t *gen,
+                               int16_t *buffer,
+                               size_t num_samples)
+{
+    sine_generator_write_interleaved(gen, buffer, num_samples, 1, SINE_FORMAT_I16);
+}
+
+void sine_generator_process_i32(sine_generator_t *gen,
+                               int32_t *buffer,
+                               size_t num_samples)
+{
+    sine_generator_write_interleaved(gen, buffer, num_samples, 1, SINE_FORMAT_I32);
+}
+
+void sine_generator_process_interleaved_f32(sine_generator_t *gen,
+                                            float *buffer,
+                                            size_t num_frames,
+                                            unsigned int channels)
+{
+    sine_generator_write_interleaved(gen, buffer, num_frames, channels,
+                                     SINE_FORMAT_F32);
+}
+
+void sine_generator_process_interleaved_i16(sine_generator_t *gen,
+                                            int16_t *buffer,
+                                            size_t num_frames,
+                                            unsigned int channels)
+{
+    sine_generator_write_interleaved(gen, buffer, num_frames, channels,
+                                     SINE_FORMAT_I16);
+}
+
+void sine_generator_process_interleaved_i32(sine_generator_t *gen,
+                                            int32_t *buffer,
+                                            size_t num_frames,
+                                            unsigned int channels)
+{
+    sine_generator_write_interleaved(gen, buffer, num_frames, channels,
+                                     SINE_FORMAT_I32);
+}
+
 void sine_generator_set_frequency(sine_generator_t *gen, double frequency)
 {
     gen->frequency = frequency;
 }
 
+void sine_generator_set_sample_rate(sine_generator_t *gen, double sample_rate)
+{
+    gen->sample_rate = sample_rate;
+}
+
 void sine_generator_set_amplitude(sine_generator_t *gen, double amplitude)
 {
     gen->amplitude = amplitude;
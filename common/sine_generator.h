@@ -14,6 +14,83 @@
 extern "C" {
 #endif
 
+/**
+ * Maximum absolute error of the generated samples relative to the
+ * double-precision reference amplitude * sin(phase), for amplitude <= 1.0.
+ * Every kernel (scalar and SIMD) is checked against this bound in
+ * tests/test_sine_generator.c.
+ */
+#define SINE_GENERATOR_MAX_ERROR 1.0e-6
+
+/**
+ * Sine kernel implementations
+ *
+ * All kernels evaluate the same polynomial approximation on a phase that is
+ * accumulated in double precision, so they produce nearly identical output.
+ * SINE_KERNEL_AUTO picks the fastest kernel supported by the running CPU.
+ */
+typedef enum {
+    SINE_KERNEL_AUTO = 0,   /* Best available kernel */
+    SINE_KERNEL_SCALAR,     /* Portable C fallback */
+    SINE_KERNEL_SSE2,       /* x86 SSE2, 4 samples per iteration */
+    SINE_KERNEL_AVX2,       /* x86 AVX2, 8 samples per iteration */
+    SINE_KERNEL_NEON        /* AArch64 NEON, 4 samples per iteration */
+} sine_kernel_t;
+
+/**
+ * Output sample formats of the format-converting writers
+ *
+ * Integer formats are native-endian, except SINE_FORMAT_I24 which is always
+ * three little-endian bytes per sample (ALSA S24_3LE, WAVE 24-bit PCM).
+ * Samples are clipped to full scale before conversion.
+ */
+typedef enum {
+    SINE_FORMAT_F32 = 0,    /* 32-bit float */
+    SINE_FORMAT_I16,        /* 16-bit signed integer */
+    SINE_FORMAT_I24,        /* 24-bit signed integer, packed in 3 bytes */
+    SINE_FORMAT_I32,        /* 32-bit signed integer */
+    SINE_FORMAT_I24_32      /* 24-bit signed integer in the low bits of 32
+                               (ALSA S24_LE), sign-extended */
+} sine_format_t;
+
+/**
+ * TPDF dither state for the integer writers
+ *
+ * Dithered conversion adds triangular noise of +/-1 LSB of the output
+ * format before rounding to nearest, which turns quantization distortion
+ * of low-level signals into a flat noise floor. Float output is unaffected.
+ * One state per thread; the noise sequence depends only on the seed.
+ */
+typedef struct {
+    uint32_t state;
+} sine_dither_t;
+
+/**
+ * Store kernel of a sine_writer_t
+ *
+ * Quantizes n <= 256 samples (with optional noise in LSBs) and writes
+ * each one to `channels` adjacent channels of dst.
+ */
+typedef void (*sine_store_fn)(const float *src, const float *noise, size_t n,
+                              void *dst, unsigned int channels);
+
+/**
+ * Output layout resolved once at stream setup
+ *
+ * sine_writer_init() picks the store kernel for a format, channel count
+ * and interleaved/planar layout, so a render callback makes one indirect
+ * call per block and the per-sample loops carry no format or channel-count
+ * branches. Kernels are specialized for 1, 2, 6, 8, 16 and 32 interleaved
+ * channels of every format; other counts use a generic loop.
+ */
+typedef struct {
+    sine_store_fn store;    /* Specialized kernel, NULL if not initialized */
+    sine_format_t format;
+    unsigned int channels;
+    int planar;             /* One buffer per channel */
+    size_t frame_bytes;     /* Bytes per frame in each output buffer */
+} sine_writer_t;
+
 /**
  * Sine wave generator context
  */
@@ -70,6 +147,248 @@ void sine_generator_process_i32(sine_generator_t *gen,
                                int32_t *buffer, 
                                size_t num_samples);
 
+/**
+ * Generate interleaved multi-channel samples (32-bit float)
+ *
+ * The same waveform is written to every channel of each frame in a single
+ * pass, without a per-sample temporary.
+ *
+ * @param gen Pointer to generator structure
+ * @param buffer Output buffer (num_frames * channels samples)
+ * @param num_frames Number of frames to generate
+ * @param channels Number of interleaved channels
+ */
+void sine_generator_process_interleaved_f32(sine_generator_t *gen,
+                                            float *buffer,
+                                            size_t num_frames,
+                                            unsigned int channels);
+
+/**
+ * Generate interleaved multi-channel samples (16-bit integer)
+ *
+ * @param gen Pointer to generator structure
+ * @param buffer Output buffer (num_frames * channels samples)
+ * @param num_frames Number of frames to generate
+ * @param channels Number of interleaved channels
+ */
+void sine_generator_process_interleaved_i16(sine_generator_t *gen,
+                                            int16_t *buffer,
+                                            size_t num_frames,
+                                            unsigned int channels);
+
+/**
+ * Generate interleaved multi-channel samples (32-bit integer)
+ *
+ * @param gen Pointer to generator structure
+ * @param buffer Output buffer (num_frames * channels samples)
+ * @param num_frames Number of frames to generate
+ * @param channels Number of interleaved channels
+ */
+void sine_generator_process_interleaved_i32(sine_generator_t *gen,
+                                            int32_t *buffer,
+                                            size_t num_frames,
+                                            unsigned int channels);
+
+/**
+ * Generate interleaved multi-channel samples in any output format
+ *
+ * The waveform is rendered once per frame by the active kernel and the
+ * conversion is selected once per call, not per sample.
+ *
+ * @param gen Pointer to generator structure
+ * @param buffer Output buffer (num_frames * channels samples of the format)
+ * @param num_frames Number of frames to generate
+ * @param channels Number of interleaved channels
+ * @param format Output sample format
+ */
+void sine_generator_write_interleaved(sine_generator_t *gen,
+                                      void *buffer,
+                                      size_t num_frames,
+                                      unsigned int channels,
+                                      sine_format_t format);
+
+/**
+ * Generate interleaved multi-channel samples with TPDF dither
+ *
+ * As sine_generator_write_interleaved(); the same dithered sample goes to
+ * every channel of a frame.
+ *
+ * @param gen Pointer to generator structure
+ * @param buffer Output buffer (num_frames * channels samples of the format)
+ * @param num_frames Number of frames to generate
+ * @param channels Number of interleaved channels
+ * @param format Output sample format
+ * @param dither Dither state, or NULL for undithered truncation
+ */
+void sine_generator_write_interleaved_dither(sine_generator_t *gen,
+                                             void *buffer,
+                                             size_t num_frames,
+                                             unsigned int channels,
+                                             sine_format_t format,
+                                             sine_dither_t *dither);
+
+/**
+ * Generate planar (non-interleaved) multi-channel samples in any format
+ *
+ * @param gen Pointer to generator structure
+ * @param buffers One output buffer of num_frames samples per channel
+ * @param num_frames Number of frames to generate
+ * @param channels Number of channel buffers
+ * @param format Output sample format
+ */
+void sine_generator_write_planar(sine_generator_t *gen,
+                                 void *const *buffers,
+                                 size_t num_frames,
+                                 unsigned int channels,
+                                 sine_format_t format);
+
+/**
+ * Generate planar multi-channel samples with TPDF dither
+ *
+ * @param gen Pointer to generator structure
+ * @param buffers One output buffer of num_frames samples per channel
+ * @param num_frames Number of frames to generate
+ * @param channels Number of channel buffers
+ * @param format Output sample format
+ * @param dither Dither state, or NULL for undithered truncation
+ */
+void sine_generator_write_planar_dither(sine_generator_t *gen,
+                                        void *const *buffers,
+                                        size_t num_frames,
+                                        unsigned int channels,
+                                        sine_format_t format,
+                                        sine_dither_t *dither);
+
+/**
+ * Resolve the store kernel for an output layout
+ *
+ * @param writer Writer to initialize
+ * @param format Output sample format
+ * @param channels Number of channels
+ * @param planar Non-zero for one buffer per channel, 0 for interleaved
+ * @return 0 on success, -1 for an unknown format or no channels
+ */
+int sine_writer_init(sine_writer_t *writer, sine_format_t format,
+                     unsigned int channels, int planar);
+
+/**
+ * Generate samples in a writer's layout
+ *
+ * The same waveform goes to every channel.
+ *
+ * @param writer Layout from sine_writer_init()
+ * @param gen Pointer to generator structure
+ * @param buffers Output buffers: the single interleaved buffer, or one
+ *                per channel when planar
+ * @param num_frames Number of frames to generate
+ * @param dither Dither state, or NULL for undithered truncation
+ */
+void sine_writer_render(const sine_writer_t *writer, sine_generator_t *gen,
+                        void *const *buffers, size_t num_frames, sine_dither_t *dither);
+
+/**
+ * Convert mono float samples to a writer's layout
+ *
+ * @param writer Layout from sine_writer_init()
+ * @param src Mono samples
+ * @param num_frames Number of frames to write
+ * @param buffers Output buffers, as for sine_writer_render()
+ * @param dither Dither state, or NULL for undithered truncation
+ */
+void sine_writer_convert(const sine_writer_t *writer, const float *src, size_t num_frames,
+                         void *const *buffers, sine_dither_t *dither);
+
+/**
+ * Convert mono float samples to interleaved samples of any format
+ *
+ * Each sample is clipped to full scale and written to every channel of its
+ * frame, with the same conversion as the writers above.
+ *
+ * @param src Mono samples
+ * @param num_frames Number of frames to write
+ * @param buffer Output buffer (num_frames * channels samples of the format)
+ * @param channels Number of interleaved channels
+ * @param format Output sample format
+ */
+void sine_format_convert(const float *src, size_t num_frames, void *buffer,
+                         unsigned int channels, sine_format_t format);
+
+/**
+ * Convert mono float samples to interleaved samples with TPDF dither
+ *
+ * @param src Mono samples
+ * @param num_frames Number of frames to write
+ * @param buffer Output buffer (num_frames * channels samples of the format)
+ * @param channels Number of interleaved channels
+ * @param format Output sample format
+ * @param dither Dither state, or NULL for undithered truncation
+ */
+void sine_format_convert_dither(const float *src, size_t num_frames, void *buffer,
+                                unsigned int channels, sine_format_t format,
+                                sine_dither_t *dither);
+
+/**
+ * Convert samples of any format to float
+ *
+ * Integer samples are scaled to [-1.0, 1.0).
+ *
+ * @param src First sample
+ * @param num_samples Number of samples to convert
+ * @param stride Distance between consecutive samples, in samples (the
+ *               channel count to extract one channel of interleaved audio)
+ * @param format Sample format of src
+ * @param dst Output samples (contiguous)
+ */
+void sine_format_to_float(const void *src, size_t num_samples, size_t stride,
+                          sine_format_t format, float *dst);
+
+/**
+ * Initialize a dither state
+ *
+ * @param dither Dither state
+ * @param seed Seed of the noise sequence
+ */
+void sine_dither_init(sine_dither_t *dither, uint32_t seed);
+
+/**
+ * Get the size of one sample of a format
+ *
+ * @param format Sample format
+ * @return Bytes per sample (4, 2, 3 or 4), or 0 for an unknown format
+ */
+size_t sine_format_bytes(sine_format_t format);
+
+/**
+ * Select the sine kernel used by all generators
+ *
+ * @param kernel Kernel to use, or SINE_KERNEL_AUTO for the best available
+ * @return 0 on success, -1 if the kernel is not supported on this CPU/build
+ */
+int sine_generator_select_kernel(sine_kernel_t kernel);
+
+/**
+ * Get the sine kernel currently in use
+ *
+ * @return Active kernel (never SINE_KERNEL_AUTO)
+ */
+sine_kernel_t sine_generator_active_kernel(void);
+
+/**
+ * Check whether a sine kernel is supported on this CPU/build
+ *
+ * @param kernel Kernel to check
+ * @return 1 if supported, 0 otherwise
+ */
+int sine_generator_kernel_supported(sine_kernel_t kernel);
+
+/**
+ * Get a printable name for a sine kernel
+ *
+ * @param kernel Kernel identifier
+ * @return Static string such as "scalar" or "avx2"
+ */
+const char *sine_generator_kernel_name(sine_kernel_t kernel);
+
 /**
  * Set frequency of sine wave
  * 
@@ -78,6 +397,17 @@ void sine_generator_process_i32(sine_generator_t *gen,
  */
 void sine_generator_set_frequency(sine_generator_t *gen, double frequency);
 
+/**
+ * Change the sample rate, keeping the phase
+ *
+ * The waveform continues from the same point at the new rate, so a stream
+ * reconfigured between periods carries on without a discontinuity.
+ *
+ * @param gen Pointer to generator structure
+ * @param sample_rate New sample rate in Hz
+ */
+void sine_generator_set_sample_rate(sine_generator_t *gen, double sample_rate);
+
 /**
  * Set amplitude of sine wave
  * 
@@ -0,0 +1,402 @@
+/**
+ * Cached-Period Wavetable Player Implementation
+ */
+
+#include "sine_table.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Frames per interpolated block; matches the writers' block size */
+#define SINE_TABLE_BLOCK 256
+
+/* Alignment of every cache plane and table */
+#define SINE_TABLE_ALIGN 64
+
+size_t sine_table_period(double frequency, double sample_rate, size_t max_frames,
+                         size_t *cycles)
+{
+    double ratio, x;
+    double h0 = 0.0, h1 = 1.0;      // Convergent numerators
+    double k0 = 1.0, k1 = 0.0;      // Convergent denominators
+
+    if (!(frequency > 0.0 && sample_rate > 0.0) || max_frames == 0) {
+        return 0;
+    }
+    ratio = frequency / sample_rate;
+    x = ratio;
+
+    // Continued fraction expansion of f/fs until a convergent is exact enough
+    for (int i = 0; i < 64; i++) {
+        double a = floor(x);
+        double h = a * h1 + h0;
+        double k = a * k1 + k0;
+
+        if (k > (double)max_frames) {
+            return 0;
+        }
+        h0 = h1;
+        h1 = h;
+        k0 = k1;
+        k1 = k;
+        if (fabs(ratio - h / k) <= SINE_TABLE_PERIOD_TOLERANCE * ratio) {
+            if (cycles) {
+                *cycles = (size_t)h;
+            }
+            return (size_t)k;
+        }
+        if (x - a <= 0.0) {
+            return 0;
+        }
+        x = 1.0 / (x - a);
+    }
+    return 0;
+}
+
+/**
+ * Round an arena offset up to the table alignment
+ */
+static size_t align_up(size_t offset)
+{
+    return (offset + SINE_TABLE_ALIGN - 1) & ~(size_t)(SINE_TABLE_ALIGN - 1);
+}
+
+/**
+ * Linearly interpolate n samples of a guarded table from index by inc
+ */
+static double lookup(const float *wave, size_t wave_frames, double index, double inc,
+                     float *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        size_t j = (size_t)index;
+        float frac = (float)(index - (double)j);
+
+        out[i] = wave[j] + frac * (wave[j + 1] - wave[j]);
+        index += inc;
+        if (index >= (double)wave_frames) {
+            index -= (double)wave_frames;
+        }
+    }
+    return index;
+}
+
+/**
+ * Fraction of a cycle at frame n of a period of q frames holding p cycles
+ */
+static double cycle_fraction(size_t n, size_t p, size_t q)
+{
+    return (double)(((uint64_t)(n % q) * (uint64_t)(p % q)) % q) / (double)q;
+}
+
+/**
+ * Signal of channel ch at a cycle fraction: the sine, or its wavetable
+ */
+static float evaluate(const sine_table_t *table, double amplitude, unsigned int ch,
+                      double fraction)
+{
+    const float *wave;
+    double index;
+    size_t j;
+
+    if (table->num_waves == 0) {
+        return (float)(amplitude * sin(table->phase + 2.0 * M_PI * fraction));
+    }
+    wave = table->waves[ch % table->num_waves];
+    index = fraction * (double)table->wave_frames;
+    j = (size_t)index;
+    if (j >= table->wave_frames) {
+        j = table->wave_frames - 1;
+    }
+    return wave[j] + (float)(index - (double)j) * (wave[j + 1] - wave[j]);
+}
+
+/**
+ * Render the cache: exact cycle fractions, converted once to the output format
+ */
+static int fill_cache(sine_table_t *table, double amplitude)
+{
+    const sine_writer_t *writer = &table->writer;
+    unsigned int signals = table->num_waves > 1 ? writer->channels : 1;
+    unsigned int stride = writer->planar ? 1 : signals;
+    size_t frames = table->cache_frames;
+    float *temp = (float *)malloc(frames * stride * sizeof(float));
+
+    if (!temp) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    if (!writer->planar) {
+        void *dst = table->cache[0];
+
+        for (size_t n = 0; n < frames; n++) {
+            double fraction = cycle_fraction(n, table->cycles, table->period_frames);
+
+            for (unsigned int ch = 0; ch < signals; ch++) {
+                temp[n * signals + ch] = evaluate(table, amplitude, ch, fraction);
+            }
+        }
+        // Distinct channels are interleaved floats, converted like a mono stream
+        sine_writer_convert(signals == 1 ? writer : &table->mono, temp, frames * signals,
+                            &dst, NULL);
+    } else {
+        for (unsigned int ch = 0; ch < signals; ch++) {
+            void *dst = table->cache[ch];
+
+            for (size_t n = 0; n < frames; n++) {
+                temp[n] = evaluate(table, amplitude, ch,
+                                   cycle_fraction(n, table->cycles, table->period_frames));
+            }
+            sine_writer_convert(&table->mono, temp, frames, &dst, NULL);
+        }
+    }
+    free(temp);
+    return VCARD_SUCCESS;
+}
+
+/**
+ * Shared setup: pick the mode, lay out one allocation and fill it
+ *
+ * waves is NULL for the sine, which then uses a generated table if the
+ * ratio has no short period.
+ */
+static int table_setup(sine_table_t *table, const sine_writer_t *writer,
+                       const float *const *waves, unsigned int num_waves,
+                       size_t wave_frames, double frequency, double sample_rate,
+                       double amplitude, double phase)
+{
+    unsigned int distinct;
+    unsigned int planes;
+    size_t plane_bytes;
+    size_t max_frames;
+    size_t period, cycles = 0;
+    size_t size = 0;
+    size_t cache_offset = 0, wave_offset = 0, scratch_offset = 0;
+    uint8_t *base;
+
+    memset(table, 0, sizeof(*table));
+    if (!writer->store || !(frequency > 0.0 && sample_rate > 0.0) ||
+        !isfinite(amplitude) || (writer->planar && writer->channels > SINE_TABLE_MAX_CHANNELS)) {
+        return VCARD_ERROR_INVALID;
+    }
+    table->writer = *writer;
+    if (sine_writer_init(&table->mono, writer->format, 1, 0) != 0) {
+        return VCARD_ERROR_INVALID;
+    }
+    table->phase = phase;
+    table->num_waves = waves ? num_waves : 0;
+    distinct = table->num_waves > 1;
+    planes = writer->planar && distinct ? writer->channels : 1;
+    plane_bytes = writer->frame_bytes;
+
+    // Exact period short enough to cache, repeated to a useful copy length
+    max_frames = SINE_TABLE_MAX_BYTES / (planes * plane_bytes);
+    period = sine_table_period(frequency, sample_rate, max_frames, &cycles);
+    if (period > 0) {
+        size_t repeats = (SINE_TABLE_MIN_FRAMES + period - 1) / period;
+
+        if (repeats > max_frames / period) {
+            repeats = max_frames / period;
+        }
+        table->mode = SINE_TABLE_CACHED;
+        table->period_frames = period;
+        table->cycles = cycles;
+        table->cache_frames = period * repeats;
+    } else {
+        table->mode = SINE_TABLE_INTERPOLATED;
+    }
+
+    // Wavetables are kept for the interpolated mode and to render the cache
+    if (waves) {
+        table->wave_frames = wave_frames;
+    } else if (table->mode == SINE_TABLE_INTERPOLATED) {
+        table->num_waves = 1;
+        table->wave_frames = SINE_TABLE_WAVE_FRAMES;
+    }
+
+    if (table->mode == SINE_TABLE_CACHED) {
+        cache_offset = size;
+        size = align_up(size + planes * align_up(table->cache_frames * plane_bytes));
+    }
+    wave_offset = size;
+    size = align_up(size + table->num_waves * align_up((table->wave_frames + 1) * sizeof(float)));
+    if (table->mode == SINE_TABLE_INTERPOLATED) {
+        scratch_offset = size;
+        size += (table->num_waves + writer->channels) * SINE_TABLE_BLOCK * sizeof(float);
+    }
+
+    table->memory = malloc(size + SINE_TABLE_ALIGN);
+    if (!table->memory) {
+        memset(table, 0, sizeof(*table));
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    base = (uint8_t *)align_up((size_t)(uintptr_t)table->memory);
+
+    for (unsigned int w = 0; w < table->num_waves; w++) {
+        float *wave = (float *)(base + wave_offset +
+                                w * align_up((table->wave_frames + 1) * sizeof(float)));
+
+        for (size_t i = 0; i < table->wave_frames; i++) {
+            wave[i] = waves ? (float)(amplitude * waves[w][i]) :
+                      (float)(amplitude * sin(2.0 * M_PI * (double)i / (double)table->wave_frames));
+        }
+        wave[table->wave_frames] = wave[0];
+        table->waves[w] = wave;
+    }
+
+    if (table->mode == SINE_TABLE_CACHED) {
+        int result;
+
+        for (unsigned int ch = 0; ch < SINE_TABLE_MAX_CHANNELS; ch++) {
+            unsigned int plane = ch < planes ? ch : 0;
+            table->cache[ch] = base + cache_offset + plane * align_up(table->cache_frames * plane_bytes);
+        }
+        result = fill_cache(table, amplitude);
+        if (result != VCARD_SUCCESS) {
+            sine_table_free(table);
+            return result;
+        }
+    } else {
+        table->scratch = (float *)(base + scratch_offset);
+        table->index = fmod(phase / (2.0 * M_PI), 1.0) * (double)table->wave_frames;
+        table->increment = fmod(frequency / sample_rate, 1.0) * (double)table->wave_frames;
+    }
+    return VCARD_SUCCESS;
+}
+
+int sine_table_init_sine(sine_table_t *table, const sine_writer_t *writer,
+                         const sine_generator_t *gen)
+{
+    return table_setup(table, writer, NULL, 0, 0, gen->frequency, gen->sample_rate,
+                       gen->amplitude, fmod(gen->phase, 2.0 * M_PI));
+}
+
+int sine_table_init_wave(sine_table_t *table, const sine_writer_t *writer,
+                         const float *const *waves, unsigned int num_waves,
+                         size_t wave_frames, double frequency, double sample_rate,
+                         double amplitude)
+{
+    if (!waves || num_waves == 0 || num_waves > SINE_TABLE_MAX_CHANNELS || wave_frames < 2) {
+        memset(table, 0, sizeof(*table));
+        return VCARD_ERROR_INVALID;
+    }
+    for (unsigned int w = 0; w < num_waves; w++) {
+        if (!waves[w]) {
+            memset(table, 0, sizeof(*table));
+            return VCARD_ERROR_INVALID;
+        }
+    }
+    return table_setup(table, writer, waves, num_waves, wave_frames, frequency,
+                       sample_rate, amplitude, 0.0);
+}
+
+/**
+ * Serve frames from the cache, one memcpy per plane per wrap
+ */
+static void render_cached(sine_table_t *table, void *const *buffers, size_t num_frames)
+{
+    const sine_writer_t *writer = &table->writer;
+    unsigned int outputs = writer->planar ? writer->channels : 1;
+    size_t bytes = writer->frame_bytes;
+    size_t done = 0;
+
+    while (done < num_frames) {
+        size_t run = table->cache_frames - table->position;
+
+        if (run > num_frames - done) {
+            run = num_frames - done;
+        }
+        for (unsigned int ch = 0; ch < outputs; ch++) {
+            memcpy((uint8_t *)buffers[ch] + done * bytes,
+                   table->cache[ch] + table->position * bytes, run * bytes);
+        }
+        table->position += run;
+        if (table->position == table->cache_frames) {
+            table->position = 0;
+        }
+        done += run;
+    }
+}
+
+/**
+ * Look up and convert blocks of interpolated frames
+ */
+static void render_interpolated(sine_table_t *table, void *const *buffers, size_t num_frames)
+{
+    const sine_writer_t *writer = &table->writer;
+    unsigned int channels = writer->channels;
+    unsigned int num_waves = table->num_waves;
+    float *interleaved = table->scratch + (size_t)num_waves * SINE_TABLE_BLOCK;
+    size_t done = 0;
+
+    while (done < num_frames) {
+        size_t n = num_frames - done < SINE_TABLE_BLOCK ? num_frames - done : SINE_TABLE_BLOCK;
+        size_t offset = done * writer->frame_bytes;
+        double next = table->index;
+
+        for (unsigned int w = 0; w < num_waves; w++) {
+            next = lookup(table->waves[w], table->wave_frames, table->index, table->increment,
+                          table->scratch + (size_t)w * SINE_TABLE_BLOCK, n);
+        }
+        table->index = next;
+
+        if (num_waves == 1) {
+            void *dst[SINE_TABLE_MAX_CHANNELS];
+            unsigned int outputs = writer->planar ? channels : 1;
+
+            for (unsigned int ch = 0; ch < outputs; ch++) {
+                dst[ch] = (uint8_t *)buffers[ch] + offset;
+            }
+            sine_writer_convert(writer, table->scratch, n, dst, NULL);
+        } else if (!writer->planar) {
+            void *dst = (uint8_t *)buffers[0] + offset;
+
+            for (size_t i = 0; i < n; i++) {
+                for (unsigned int ch = 0; ch < channels; ch++) {
+                    interleaved[i * channels + ch] =
+                        table->scratch[(size_t)(ch % num_waves) * SINE_TABLE_BLOCK + i];
+                }
+            }
+            sine_writer_convert(&table->mono, interleaved, n * channels, &dst, NULL);
+        } else {
+            for (unsigned int ch = 0; ch < channels; ch++) {
+                void *dst = (uint8_t *)buffers[ch] + offset;
+                sine_writer_convert(&table->mono,
+                                    table->scratch + (size_t)(ch % num_waves) * SINE_TABLE_BLOCK,
+                                    n, &dst, NULL);
+            }
+        }
+        done += n;
+    }
+}
+
+void sine_table_render(sine_table_t *table, void *const *buffers, size_t num_frames)
+{
+    if (table->mode == SINE_TABLE_CACHED) {
+        render_cached(table, buffers, num_frames);
+    } else if (table->mode == SINE_TABLE_INTERPOLATED) {
+        render_interpolated(table, buffers, num_frames);
+    }
+}
+
+double sine_table_phase(const sine_table_t *table)
+{
+    double fraction = 0.0;
+
+    if (table->mode == SINE_TABLE_CACHED) {
+        fraction = cycle_fraction(table->position, table->cycles, table->period_frames);
+        return fmod(table->phase + 2.0 * M_PI * fraction, 2.0 * M_PI);
+    }
+    if (table->mode == SINE_TABLE_INTERPOLATED && table->wave_frames > 0) {
+        fraction = table->index / (double)table->wave_frames;
+    }
+    return 2.0 * M_PI * fraction;
+}
+
+void sine_table_free(sine_table_t *table)
+{
+    free(table->memory);
+    memset(table, 0, sizeof(*table));
+}
@@ -0,0 +1,149 @@
+/**
+ * Virtual Sound Card - Cached-Period Wavetable Player
+ *
+ * Plays a periodic signal without evaluating it per sample. When the
+ * frequency-to-rate ratio reduces to p/q with a small enough q (440 Hz at
+ * 48 kHz is 11/1200), the signal repeats exactly every q frames, so whole
+ * cycles are pre-rendered once, already converted to the output format,
+ * into an aligned cache that rendering serves by memcpy. Ratios without a
+ * short period fall back to a linearly interpolated wavetable lookup.
+ *
+ * The signal is either the sine of a sine_generator_t or a user wavetable
+ * looped per channel. All memory is allocated at init; rendering never
+ * allocates, and its output is undithered. For a plain sine without a
+ * short period the SIMD generator is faster than the lookup; the lookup
+ * is there for wavetables.
+ */
+
+#ifndef SINE_TABLE_H
+#define SINE_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vcard.h"
+#include "sine_generator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Largest cache of pre-rendered cycles, in bytes over all planes */
+#define SINE_TABLE_MAX_BYTES (4u * 1024u * 1024u)
+
+/* Short periods are repeated until the cache holds at least this many frames */
+#define SINE_TABLE_MIN_FRAMES 4096
+
+/* Channels with their own wavetable */
+#define SINE_TABLE_MAX_CHANNELS 32
+
+/* Interpolated sine table size; linear interpolation error is below 3e-7 */
+#define SINE_TABLE_WAVE_FRAMES 4096
+
+/* Largest relative |f/fs - p/q| accepted as an exact period: rounding only */
+#define SINE_TABLE_PERIOD_TOLERANCE 1.0e-14
+
+/**
+ * How rendering produces samples
+ */
+typedef enum {
+    SINE_TABLE_NONE = 0,        /* Not initialized */
+    SINE_TABLE_CACHED,          /* memcpy from pre-rendered cycles */
+    SINE_TABLE_INTERPOLATED     /* Linear wavetable lookup */
+} sine_table_mode_t;
+
+/**
+ * Wavetable player state
+ */
+typedef struct {
+    sine_writer_t writer;       /* Output layout */
+    sine_writer_t mono;         /* 1-channel writer of the same format */
+    sine_table_mode_t mode;
+
+    /* Cached mode: one plane per output buffer (shared if all alike) */
+    uint8_t *cache[SINE_TABLE_MAX_CHANNELS];
+    size_t cache_frames;        /* Whole periods */
+    size_t period_frames;       /* q */
+    size_t cycles;              /* p, signal cycles per period */
+    size_t position;            /* Next frame of the cache */
+
+    /* Interpolated mode, and the source of cached per-channel waves */
+    float *waves[SINE_TABLE_MAX_CHANNELS];  /* wave_frames + 1 guard sample */
+    unsigned int num_waves;     /* 1 for the same signal on every channel */
+    size_t wave_frames;
+    double index;               /* Read position in [0, wave_frames) */
+    double increment;           /* Table frames per output frame */
+    double phase;               /* Sine phase at frame 0 of the cache */
+
+    float *scratch;             /* Interpolated blocks and interleaving */
+    void *memory;               /* Single allocation behind all pointers */
+} sine_table_t;
+
+/**
+ * Find the exact period of a frequency at a sample rate
+ *
+ * @param frequency Frequency in Hz
+ * @param sample_rate Sample rate in Hz
+ * @param max_frames Longest period accepted
+ * @param cycles Output parameter for the signal cycles per period, or NULL
+ * @return Period in frames, or 0 if there is none within max_frames
+ */
+size_t sine_table_period(double frequency, double sample_rate, size_t max_frames,
+                         size_t *cycles);
+
+/**
+ * Prepare a generator's sine for playback
+ *
+ * The generator is left unchanged; playback starts at its current phase.
+ *
+ * @param table Player to initialize
+ * @param writer Output layout
+ * @param gen Generator supplying frequency, rate, amplitude and phase
+ * @return 0 on success, error code on failure
+ */
+int sine_table_init_sine(sine_table_t *table, const sine_writer_t *writer,
+                         const sine_generator_t *gen);
+
+/**
+ * Prepare a looped wavetable for playback
+ *
+ * Channel ch plays waves[ch % num_waves]; each table holds one cycle.
+ *
+ * @param table Player to initialize
+ * @param writer Output layout
+ * @param waves num_waves tables of wave_frames samples
+ * @param num_waves 1, or up to SINE_TABLE_MAX_CHANNELS for distinct channels
+ * @param wave_frames Samples per table (at least 2)
+ * @param frequency Cycles per second
+ * @param sample_rate Sample rate in Hz
+ * @param amplitude Gain applied to the tables
+ * @return 0 on success, error code on failure
+ */
+int sine_table_init_wave(sine_table_t *table, const sine_writer_t *writer,
+                         const float *const *waves, unsigned int num_waves,
+                         size_t wave_frames, double frequency, double sample_rate,
+                         double amplitude);
+
+/**
+ * Render frames in the writer's layout (audio thread)
+ *
+ * @param table Initialized player
+ * @param buffers Output buffers, as for sine_writer_render()
+ * @param num_frames Number of frames to render
+ */
+void sine_table_render(sine_table_t *table, void *const *buffers, size_t num_frames);
+
+/**
+ * Sine phase of the next frame, to hand playback back to a generator
+ */
+double sine_table_phase(const sine_table_t *table);
+
+/**
+ * Free a player's memory; the player may be initialized again
+ */
+void sine_table_free(sine_table_t *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SINE_TABLE_H */
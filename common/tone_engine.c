@@ -0,0 +1,406 @@
+/**
+ * Virtual Sound Card - Multi-Stream Tone Engine Implementation
+ */
+
+#include "tone_engine.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TONE_DEFAULT_FREQUENCY 440.0
+#define TONE_DEFAULT_AMPLITUDE 0.5
+#define TONE_DEFAULT_SWEEP_SECONDS 10.0
+
+/**
+ * Fill in the engine defaults for a channel
+ */
+static void tone_default(tone_params_t *params)
+{
+    memset(params, 0, sizeof(*params));
+    params->waveform = TONE_WAVE_SINE;
+    params->frequency = TONE_DEFAULT_FREQUENCY;
+    params->frequency_end = TONE_DEFAULT_FREQUENCY;
+    params->sweep_seconds = TONE_DEFAULT_SWEEP_SECONDS;
+    params->amplitude = TONE_DEFAULT_AMPLITUDE;
+}
+
+int tone_generator_init(tone_generator_t *gen, const tone_params_t *params,
+                        double sample_rate)
+{
+    double nyquist = sample_rate / 2.0;
+
+    if (sample_rate <= 0.0 || params->amplitude < 0.0 || params->amplitude > 1.0) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (params->waveform != TONE_WAVE_NOISE &&
+        (params->frequency <= 0.0 || params->frequency >= nyquist)) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (params->waveform == TONE_WAVE_SWEEP &&
+        (params->frequency_end <= 0.0 || params->frequency_end >= nyquist ||
+         params->sweep_seconds <= 0.0)) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    memset(gen, 0, sizeof(*gen));
+    gen->params = *params;
+    gen->sample_rate = sample_rate;
+    sine_generator_init(&gen->sine, params->frequency, sample_rate, params->amplitude);
+
+    switch (params->waveform) {
+    case TONE_WAVE_SINE:
+    case TONE_WAVE_SQUARE:
+        break;
+    case TONE_WAVE_NOISE:
+        // xorshift32 never leaves the all-zero state
+        gen->noise = params->seed ? params->seed : 1;
+        break;
+    case TONE_WAVE_SWEEP:
+        gen->sweep_len = (uint64_t)(params->sweep_seconds * sample_rate + 0.5);
+        if (gen->sweep_len == 0) {
+            gen->sweep_len = 1;
+        }
+        gen->sweep_freq = params->frequency;
+        gen->sweep_ratio = pow(params->frequency_end / params->frequency,
+                               1.0 / (double)gen->sweep_len);
+        break;
+    default:
+        return VCARD_ERROR_INVALID;
+    }
+    return VCARD_SUCCESS;
+}
+
+void tone_generator_render(tone_generator_t *gen, float *out, size_t num_frames)
+{
+    const float amp = (float)gen->params.amplitude;
+
+    switch (gen->params.waveform) {
+    case TONE_WAVE_SINE:
+        sine_generator_process_f32(&gen->sine, out, num_frames);
+        break;
+
+    case TONE_WAVE_SQUARE: {
+        double phase = gen->phase;
+        const double inc = gen->params.frequency / gen->sample_rate;
+
+        for (size_t i = 0; i < num_frames; i++) {
+            out[i] = phase < 0.5 ? amp : -amp;
+            phase += inc;
+            if (phase >= 1.0) {
+                phase -= 1.0;
+            }
+        }
+        gen->phase = phase;
+        break;
+    }
+
+    case TONE_WAVE_NOISE: {
+        uint32_t x = gen->noise;
+        const float scale = amp / 2147483648.0f;
+
+        for (size_t i = 0; i < num_frames; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            out[i] = (float)(int32_t)x * scale;
+        }
+        gen->noise = x;
+        break;
+    }
+
+    case TONE_WAVE_SWEEP: {
+        double phase = gen->phase;
+        double freq = gen->sweep_freq;
+        uint64_t pos = gen->sweep_pos;
+        const double inv_rate = 1.0 / gen->sample_rate;
+
+        for (size_t i = 0; i < num_frames; i++) {
+            out[i] = amp * (float)sin(2.0 * M_PI * phase);
+            phase += freq * inv_rate;
+            if (phase >= 1.0) {
+                phase -= 1.0;
+            }
+            // Multiply per sample, restart from the exact start frequency
+            if (++pos == gen->sweep_len) {
+                pos = 0;
+                freq = gen->params.frequency;
+            } else {
+                freq *= gen->sweep_ratio;
+            }
+        }
+        gen->phase = phase;
+        gen->sweep_freq = freq;
+        gen->sweep_pos = pos;
+        break;
+    }
+    }
+}
+
+/**
+ * Return the text after word if text starts with it, NULL otherwise
+ */
+static const char *match_word(const char *text, const char *word)
+{
+    size_t len = strlen(word);
+    return strncmp(text, word, len) == 0 ? text + len : NULL;
+}
+
+/**
+ * Parse a strictly positive number
+ */
+static const char *parse_positive(const char *text, double *value)
+{
+    char *end;
+
+    *value = strtod(text, &end);
+    return (end != text && *value > 0.0) ? end : NULL;
+}
+
+int tone_params_parse(const char *text, tone_params_t *params)
+{
+    const char *p;
+
+    tone_default(params);
+
+    if ((p = match_word(text, "sine:")) != NULL) {
+        params->waveform = TONE_WAVE_SINE;
+        p = parse_positive(p, &params->frequency);
+    } else if ((p = match_word(text, "square:")) != NULL) {
+        params->waveform = TONE_WAVE_SQUARE;
+        p = parse_positive(p, &params->frequency);
+    } else if ((p = match_word(text, "sweep:")) != NULL) {
+        params->waveform = TONE_WAVE_SWEEP;
+        p = parse_positive(p, &params->frequency);
+        if (p && *p == '-') {
+            p = parse_positive(p + 1, &params->frequency_end);
+        } else {
+            p = NULL;
+        }
+    } else if ((p = match_word(text, "noise")) != NULL) {
+        params->waveform = TONE_WAVE_NOISE;
+    }
+    if (!p) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    if (*p == '@') {
+        char *end;
+
+        params->amplitude = strtod(p + 1, &end);
+        if (end == p + 1 || params->amplitude < 0.0 || params->amplitude > 1.0) {
+            return VCARD_ERROR_INVALID;
+        }
+        p = end;
+    }
+    return *p == '\0' ? VCARD_SUCCESS : VCARD_ERROR_INVALID;
+}
+
+/**
+ * Render one stream, plane by plane
+ */
+static void render_stream(tone_stream_t *stream, uint32_t frames)
+{
+    for (uint32_t ch = 0; ch < stream->channels; ch++) {
+        tone_generator_render(&stream->gens[ch], stream->planes[ch], frames);
+    }
+    stream->frames = frames;
+}
+
+/**
+ * Claim and render streams until none are left in this pass
+ */
+static void render_claimed(tone_engine_t *engine, uint32_t frames)
+{
+    uint32_t index;
+
+    while ((index = vcard_atomic_fetch_add_u32(&engine->next_stream, 1)) <
+           engine->num_streams) {
+        render_stream(&engine->streams[index], frames);
+    }
+}
+
+static void worker_main(void *arg)
+{
+    tone_engine_t *engine = (tone_engine_t *)arg;
+    uint32_t seen = 0;
+
+    vcard_mutex_lock(&engine->lock);
+    for (;;) {
+        uint32_t frames;
+
+        while (!engine->stopping && engine->generation == seen) {
+            vcard_cond_wait(&engine->wake, &engine->lock);
+        }
+        if (engine->stopping) {
+            break;
+        }
+        seen = engine->generation;
+        frames = engine->pass_frames;
+        vcard_mutex_unlock(&engine->lock);
+
+        render_claimed(engine, frames);
+
+        vcard_mutex_lock(&engine->lock);
+        if (--engine->busy == 0) {
+            vcard_cond_signal(&engine->done);
+        }
+    }
+    vcard_mutex_unlock(&engine->lock);
+}
+
+int tone_engine_init(tone_engine_t *engine, uint32_t num_workers, int pin_workers)
+{
+    unsigned int cpus = vcard_cpu_count();
+
+    if (num_workers > TONE_ENGINE_MAX_WORKERS) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    memset(engine, 0, sizeof(*engine));
+    vcard_mutex_init(&engine->lock);
+    vcard_cond_init(&engine->wake);
+    vcard_cond_init(&engine->done);
+    vcard_atomic_store_relaxed_u32(&engine->next_stream, 0);
+
+    for (uint32_t i = 0; i < num_workers; i++) {
+        if (vcard_thread_create(&engine->workers[i], worker_main, engine) != VCARD_SUCCESS) {
+            tone_engine_destroy(engine);
+            return VCARD_ERROR_NO_MEMORY;
+        }
+        engine->num_workers++;
+        if (pin_workers) {
+            // Best effort: an unpinned worker still renders correctly
+            vcard_thread_set_affinity(&engine->workers[i], (i + 1) % cpus);
+        }
+    }
+    return VCARD_SUCCESS;
+}
+
+void tone_engine_destroy(tone_engine_t *engine)
+{
+    vcard_mutex_lock(&engine->lock);
+    engine->stopping = 1;
+    vcard_cond_broadcast(&engine->wake);
+    vcard_mutex_unlock(&engine->lock);
+
+    for (uint32_t i = 0; i < engine->num_workers; i++) {
+        vcard_thread_join(&engine->workers[i]);
+    }
+    engine->num_workers = 0;
+
+    for (uint32_t i = 0; i < engine->num_streams; i++) {
+        free(engine->streams[i].storage);
+        engine->streams[i].storage = NULL;
+    }
+    engine->num_streams = 0;
+
+    vcard_cond_destroy(&engine->done);
+    vcard_cond_destroy(&engine->wake);
+    vcard_mutex_destroy(&engine->lock);
+}
+
+int tone_engine_add_stream(tone_engine_t *engine, uint32_t channels,
+                           double sample_rate, uint32_t max_frames,
+                           int *stream_id)
+{
+    tone_stream_t *stream;
+    tone_params_t params;
+    int id;
+
+    if (channels == 0 || channels > VCARD_MAX_CHANNELS || max_frames == 0) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (engine->num_streams >= TONE_ENGINE_MAX_STREAMS) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+
+    id = (int)engine->num_streams;
+    stream = &engine->streams[id];
+    memset(stream, 0, sizeof(*stream));
+    stream->storage = (float *)calloc((size_t)channels * max_frames, sizeof(float));
+    if (!stream->storage) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    stream->channels = channels;
+    stream->max_frames = max_frames;
+    tone_default(&params);
+    for (uint32_t ch = 0; ch < channels; ch++) {
+        stream->planes[ch] = stream->storage + (size_t)ch * max_frames;
+        if (tone_generator_init(&stream->gens[ch], &params, sample_rate) != VCARD_SUCCESS) {
+            free(stream->storage);
+            stream->storage = NULL;
+            return VCARD_ERROR_INVALID;
+        }
+    }
+
+    engine->num_streams++;
+    *stream_id = id;
+    return VCARD_SUCCESS;
+}
+
+int tone_engine_set_tone(tone_engine_t *engine, int stream_id, uint32_t channel,
+                         const tone_params_t *params)
+{
+    tone_stream_t *stream;
+    tone_params_t local;
+
+    if (stream_id < 0 || (uint32_t)stream_id >= engine->num_streams) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    stream = &engine->streams[stream_id];
+    if (channel >= stream->channels) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    // Distinct default noise per channel so streams are not correlated
+    local = *params;
+    if (local.seed == 0) {
+        local.seed = 1u + (uint32_t)stream_id * VCARD_MAX_CHANNELS + channel;
+    }
+    return tone_generator_init(&stream->gens[channel], &local,
+                               stream->gens[channel].sample_rate);
+}
+
+int tone_engine_render(tone_engine_t *engine, uint32_t num_frames)
+{
+    for (uint32_t i = 0; i < engine->num_streams; i++) {
+        if (num_frames > engine->streams[i].max_frames) {
+            return VCARD_ERROR_INVALID;
+        }
+    }
+
+    vcard_atomic_store_relaxed_u32(&engine->next_stream, 0);
+    if (engine->num_workers == 0 || engine->num_streams < 2) {
+        render_claimed(engine, num_frames);
+        return VCARD_SUCCESS;
+    }
+
+    vcard_mutex_lock(&engine->lock);
+    engine->pass_frames = num_frames;
+    engine->busy = engine->num_workers;
+    engine->generation++;
+    vcard_cond_broadcast(&engine->wake);
+    vcard_mutex_unlock(&engine->lock);
+
+    render_claimed(engine, num_frames);
+
+    // Stream state written by the workers is published by the lock
+    vcard_mutex_lock(&engine->lock);
+    while (engine->busy > 0) {
+        vcard_cond_wait(&engine->done, &engine->lock);
+    }
+    vcard_mutex_unlock(&engine->lock);
+    return VCARD_SUCCESS;
+}
+
+const float *const *tone_engine_output(const tone_engine_t *engine, int stream_id)
+{
+    if (stream_id < 0 || (uint32_t)stream_id >= engine->num_streams) {
+        return NULL;
+    }
+    return (const float *const *)engine->streams[stream_id].planes;
+}
@@ -0,0 +1,213 @@
+/**
+ * Virtual Sound Card - Multi-Stream Tone Engine
+ *
+ * Renders up to VCARD_MAX_DEVICES independent streams of up to
+ * VCARD_MAX_CHANNELS channels, each channel with its own waveform,
+ * frequency and amplitude. Output is planar float, ready for
+ * vcard_write_audio() or a routing mixer.
+ *
+ * A render pass hands whole streams to a pool of worker threads (optionally
+ * pinned to cores) and to the calling thread. A stream's state is only
+ * touched by the one thread that renders it in a pass, so its output does
+ * not depend on the number of workers or on scheduling: every stream is
+ * bit-identical to rendering it alone.
+ */
+
+#ifndef TONE_ENGINE_H
+#define TONE_ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "vcard.h"
+#include "vcard_atomic.h"
+#include "vcard_thread.h"
+#include "sine_generator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TONE_ENGINE_MAX_STREAMS VCARD_MAX_DEVICES
+#define TONE_ENGINE_MAX_WORKERS 16
+
+/**
+ * Waveforms
+ */
+typedef enum {
+    TONE_WAVE_SINE = 0,     /* Sine through the SIMD sine kernels */
+    TONE_WAVE_SQUARE,       /* Naive square wave, 50% duty cycle */
+    TONE_WAVE_NOISE,        /* Uniform white noise */
+    TONE_WAVE_SWEEP         /* Exponential sine sweep, restarting */
+} tone_waveform_t;
+
+/**
+ * Parameters of one channel's tone
+ */
+typedef struct {
+    tone_waveform_t waveform;
+    double frequency;       /* Hz (sweep start frequency) */
+    double frequency_end;   /* Sweep end frequency in Hz */
+    double sweep_seconds;   /* Sweep duration before it restarts */
+    double amplitude;       /* Peak amplitude (0.0 to 1.0) */
+    uint32_t seed;          /* Noise seed, 0 for a per-channel default */
+} tone_params_t;
+
+/**
+ * Per-channel generator state
+ */
+typedef struct {
+    tone_params_t params;
+    double sample_rate;
+    sine_generator_t sine;
+    double phase;           /* Square and sweep phase in cycles, [0, 1) */
+    double sweep_freq;      /* Current sweep frequency */
+    double sweep_ratio;     /* Per-sample sweep frequency multiplier */
+    uint64_t sweep_pos;     /* Samples into the current sweep */
+    uint64_t sweep_len;     /* Samples per sweep */
+    uint32_t noise;         /* xorshift32 state */
+} tone_generator_t;
+
+/**
+ * One stream (typically one device)
+ */
+typedef struct {
+    uint32_t channels;
+    uint32_t max_frames;
+    uint32_t frames;                     /* Frames rendered by the last pass */
+    float *storage;
+    float *planes[VCARD_MAX_CHANNELS];
+    tone_generator_t gens[VCARD_MAX_CHANNELS];
+    char pad[VCARD_CACHELINE];           /* Keeps workers off each other's lines */
+} tone_stream_t;
+
+/**
+ * Engine state
+ */
+typedef struct {
+    tone_stream_t streams[TONE_ENGINE_MAX_STREAMS];
+    uint32_t num_streams;
+
+    /* Worker pool; everything below is protected by lock */
+    vcard_thread_t workers[TONE_ENGINE_MAX_WORKERS];
+    uint32_t num_workers;
+    vcard_mutex_t lock;
+    vcard_cond_t wake;                   /* A pass was started or stop requested */
+    vcard_cond_t done;                   /* The last worker finished a pass */
+    uint32_t generation;                 /* Incremented for every pass */
+    uint32_t busy;                       /* Workers still inside the pass */
+    uint32_t pass_frames;
+    int stopping;
+
+    /* Next stream to claim in the current pass */
+    vcard_atomic_u32 next_stream;
+} tone_engine_t;
+
+/**
+ * Initialize a channel generator
+ *
+ * @param gen Generator to initialize
+ * @param params Tone parameters
+ * @param sample_rate Sample rate in Hz
+ * @return 0 on success, VCARD_ERROR_INVALID for bad parameters
+ */
+int tone_generator_init(tone_generator_t *gen, const tone_params_t *params,
+                        double sample_rate);
+
+/**
+ * Render mono samples from a channel generator
+ *
+ * @param gen Generator
+ * @param out Output samples
+ * @param num_frames Number of samples to render
+ */
+void tone_generator_render(tone_generator_t *gen, float *out, size_t num_frames);
+
+/**
+ * Parse a tone description
+ *
+ * Accepts "sine:440", "square:100", "noise" and "sweep:20-20000", each
+ * optionally followed by "@<amplitude>", e.g. "sweep:20-20000@0.25". A
+ * sweep takes 10 seconds and the default amplitude is 0.5.
+ *
+ * @param text Description
+ * @param params Output parameters
+ * @return 0 on success, VCARD_ERROR_INVALID if text is malformed
+ */
+int tone_params_parse(const char *text, tone_params_t *params);
+
+/**
+ * Initialize an engine and start its workers
+ *
+ * @param engine Engine to initialize
+ * @param num_workers Worker threads (0 renders every pass on the caller)
+ * @param pin_workers Non-zero to pin worker n to CPU (n + 1) modulo the CPU
+ *                    count, leaving CPU 0 to the caller
+ * @return 0 on success, VCARD_ERROR_* on failure
+ */
+int tone_engine_init(tone_engine_t *engine, uint32_t num_workers, int pin_workers);
+
+/**
+ * Stop the workers and free every stream
+ *
+ * @param engine Engine
+ */
+void tone_engine_destroy(tone_engine_t *engine);
+
+/**
+ * Add a stream
+ *
+ * Every channel starts as a 440 Hz sine at amplitude 0.5. Not thread-safe
+ * with tone_engine_render().
+ *
+ * @param engine Engine
+ * @param channels Number of channels (1 to VCARD_MAX_CHANNELS)
+ * @param sample_rate Sample rate in Hz
+ * @param max_frames Largest pass the stream will render
+ * @param stream_id Output parameter for the stream index
+ * @return 0 on success, VCARD_ERROR_* on failure
+ */
+int tone_engine_add_stream(tone_engine_t *engine, uint32_t channels,
+                           double sample_rate, uint32_t max_frames,
+                           int *stream_id);
+
+/**
+ * Set the tone of one channel of a stream
+ *
+ * Restarts that channel's generator. Not thread-safe with
+ * tone_engine_render().
+ *
+ * @param engine Engine
+ * @param stream_id Stream index
+ * @param channel Channel index
+ * @param params Tone parameters
+ * @return 0 on success, VCARD_ERROR_* on failure
+ */
+int tone_engine_set_tone(tone_engine_t *engine, int stream_id, uint32_t channel,
+                         const tone_params_t *params);
+
+/**
+ * Render the next num_frames frames of every stream
+ *
+ * Returns once all streams are rendered; the calling thread renders
+ * streams too.
+ *
+ * @param engine Engine
+ * @param num_frames Frames per stream (at most each stream's max_frames)
+ * @return 0 on success, VCARD_ERROR_INVALID if num_frames is too large
+ */
+int tone_engine_render(tone_engine_t *engine, uint32_t num_frames);
+
+/**
+ * Get the planar output of a stream from the last pass
+ *
+ * @param engine Engine
+ * @param stream_id Stream index
+ * @return One buffer per channel, or NULL for an invalid stream
+ */
+const float *const *tone_engine_output(const tone_engine_t *engine, int stream_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TONE_ENGINE_H */
@@ -27,6 +27,9 @@ extern "C" {
 #define VCARD_MAX_DEVICES       16
 #define VCARD_MAX_MIDI_PORTS    16
 #define VCARD_MAX_ROUTES        128
+#define VCARD_MAX_INSERTS       64
+#define VCARD_MAX_INSERT_DELAY_MS 2000
+#define VCARD_MAX_MIDI_MESSAGE  4096     /* Largest MIDI message (sysex) in bytes */
 
 /* Error Codes */
 #define VCARD_SUCCESS           0
@@ -99,6 +102,43 @@ typedef struct {
     } routes[VCARD_MAX_ROUTES];
 } vcard_routing_t;
 
+/* Insert Chain */
+typedef enum {
+    VCARD_INSERT_GAIN    = 0,            /* gain_db */
+    VCARD_INSERT_EQ      = 1,            /* shape, frequency_hz, q, gain_db */
+    VCARD_INSERT_DELAY   = 2,            /* time_ms */
+    VCARD_INSERT_METER   = 3,            /* Read with vcard_get_insert_meter */
+    VCARD_INSERT_LIMITER = 4             /* gain_db (ceiling), time_ms (release) */
+} vcard_insert_type_t;
+
+typedef enum {
+    VCARD_EQ_PEAK       = 0,
+    VCARD_EQ_LOW_SHELF  = 1,
+    VCARD_EQ_HIGH_SHELF = 2,
+    VCARD_EQ_LOWPASS    = 3,
+    VCARD_EQ_HIGHPASS   = 4
+} vcard_eq_shape_t;
+
+typedef struct {
+    vcard_insert_type_t type;
+    uint32_t channel_mask;               /* Input channels processed (bit N = channel N) */
+    vcard_eq_shape_t shape;              /* EQ filter shape */
+    float frequency_hz;                  /* EQ corner or center frequency */
+    float q;                             /* EQ quality factor */
+    float gain_db;                       /* Gain, EQ boost/cut or limiter ceiling */
+    float time_ms;                       /* Delay time or limiter release */
+} vcard_insert_t;
+
+typedef struct {
+    uint32_t num_inserts;                /* Number of inserts, in processing order */
+    vcard_insert_t inserts[VCARD_MAX_INSERTS];
+} vcard_insert_chain_t;
+
+typedef struct {
+    float peak;                          /* Peak level, linear, decaying */
+    float rms;                           /* RMS level, linear, smoothed */
+} vcard_meter_t;
+
 /* MIDI Direction */
 typedef enum {
     VCARD_MIDI_INPUT  = 0,
@@ -156,6 +196,32 @@ int vcard_create_device(const vcard_config_t *config, int *device_id);
  */
 int vcard_destroy_device(int device_id);
 
+/**
+ * Create several virtual audio devices in one call
+ *
+ * All or nothing: every configuration is validated and every slot set up
+ * before any device appears, and on failure none of them is created.
+ * Names must be unique among the existing devices and within the batch.
+ *
+ * @param configs Device configurations
+ * @param count Number of configurations (1 to VCARD_MAX_DEVICES)
+ * @param device_ids Output array of count device IDs, in configs order
+ * @return 0 on success, error code on failure
+ */
+int vcard_create_devices(const vcard_config_t *configs, int count, int *device_ids);
+
+/**
+ * Destroy several virtual audio devices in one call
+ *
+ * The devices disappear together. IDs that name no device are skipped
+ * and reported, after the others are destroyed.
+ *
+ * @param device_ids Device IDs to destroy
+ * @param count Number of IDs
+ * @return 0 on success, VCARD_ERROR_NOT_FOUND if any ID was not a device
+ */
+int vcard_destroy_devices(const int *device_ids, int count);
+
 /**
  * List all virtual audio devices
  * @param devices Array to store device information
@@ -179,9 +245,18 @@ int vcard_get_config(int device_id, vcard_config_t *config);
 
 /**
  * Update device configuration
+ *
+ * The sample rate and buffer size may change while the device streams:
+ * audio still queued is dropped and the reader gets one period of
+ * silence before frames written at the new rate. Safe to call while
+ * vcard_write_audio() and vcard_read_audio() run on other threads.
+ * Channel and MIDI port counts are fixed at creation.
+ *
  * @param device_id Device ID
  * @param config New configuration
- * @return 0 on success, error code on failure
+ * @return 0 on success, VCARD_ERROR_IN_USE if a channel or MIDI port
+ *         count differs or another device has the name, other error
+ *         code on failure
  */
 int vcard_set_config(int device_id, const vcard_config_t *config);
 
@@ -203,10 +278,103 @@ int vcard_set_routing(int device_id, const vcard_routing_t *routing);
  */
 int vcard_get_routing(int device_id, vcard_routing_t *routing);
 
+/**
+ * Configure the insert chain applied to a device's input channels
+ *
+ * Inserts run in list order on the channels in their masks, after the
+ * routing, on every read. The chain is compiled on the calling thread
+ * into a flat schedule with all state in one allocation, and swapped in
+ * between two reads; filter and delay state starts from silence. An
+ * empty chain removes all processing. The chain is rebuilt for the new
+ * rate when vcard_set_config changes the sample rate.
+ *
+ * @param device_id Device ID
+ * @param chain Insert chain
+ * @return 0 on success, error code on failure
+ */
+int vcard_set_inserts(int device_id, const vcard_insert_chain_t *chain);
+
+/**
+ * Get the current insert chain
+ * @param device_id Device ID
+ * @param chain Output parameter for the insert chain
+ * @return 0 on success, error code on failure
+ */
+int vcard_get_inserts(int device_id, vcard_insert_chain_t *chain);
+
+/**
+ * Read the levels of a meter insert
+ *
+ * @param device_id Device ID
+ * @param insert Index of a VCARD_INSERT_METER entry in the chain
+ * @param levels Output array indexed by input channel; channels outside
+ *               the meter's mask read as zero
+ * @return 0 on success, VCARD_ERROR_INVALID if the insert is not a meter
+ */
+int vcard_get_insert_meter(int device_id, uint32_t insert,
+                           vcard_meter_t levels[VCARD_MAX_CHANNELS]);
+
+/* Audio Streaming */
+
+/**
+ * Write audio to a device's output channels (producer side)
+ *
+ * Each output channel is backed by a wait-free single-producer/single-
+ * consumer ring buffer, so this call never blocks, locks or allocates.
+ * Only one thread may write to a given device at a time.
+ *
+ * @param device_id Device ID
+ * @param buffers Array of channels_out planar buffers (NULL entries write silence)
+ * @param frames Number of frames to write
+ * @param frames_written Output parameter for frames accepted (less than
+ *                       frames if the rings are full)
+ * @return 0 on success, error code on failure
+ */
+int vcard_write_audio(int device_id,
+                      const float *const *buffers,
+                      size_t frames,
+                      size_t *frames_written);
+
+/**
+ * Read audio from a device's input channels (consumer side)
+ *
+ * Input channel N receives output channel N unless a routing configuration
+ * is set, in which case the inputs are mixed according to the routes.
+ * Only one thread may read from a given device at a time.
+ *
+ * @param device_id Device ID
+ * @param buffers Array of channels_in planar buffers (NULL entries are skipped)
+ * @param frames Maximum number of frames to read
+ * @param frames_read Output parameter for frames actually read
+ * @return 0 on success, error code on failure
+ */
+int vcard_read_audio(int device_id,
+                     float *const *buffers,
+                     size_t frames,
+                     size_t *frames_read);
+
+/**
+ * Get the number of frames queued in a device
+ *
+ * Lock-free; safe from either streaming thread. This is the fill a
+ * producer steers on when its clock is not the consumer's.
+ *
+ * @param device_id Device ID
+ * @param frames Output parameter for frames written but not yet read
+ * @return 0 on success, error code on failure
+ */
+int vcard_get_buffered(int device_id, size_t *frames);
+
 /* Status and Monitoring */
 
 /**
  * Get current device status
+ *
+ * Lock-free; safe to poll from any thread. frames_processed counts frames
+ * read from the device, latency_us is the audio queued in the device plus
+ * the latency reported by the backend, and xruns and cpu_load are as
+ * reported by the backend (see vcard_report_period).
+ *
  * @param device_id Device ID
  * @param status Output parameter for status
  * @return 0 on success, error code on failure
@@ -214,9 +382,31 @@ int vcard_get_routing(int device_id, vcard_routing_t *routing);
 int vcard_get_status(int device_id, vcard_status_t *status);
 
 /**
- * Register callback for status changes
+ * Get the status of every device in one pass
+ *
+ * Lock-free, like vcard_get_status. Which devices exist and their sample
+ * rates and buffer sizes come from one consistent view: a pass that
+ * overlaps a create, destroy or vcard_set_config is retried. Counters are
+ * read as they stand.
+ *
+ * @param statuses Output array indexed by device ID; slots without a
+ *                 device have is_active false
+ * @param count Output parameter for the number of devices
+ * @return 0 on success, error code on failure
+ */
+int vcard_get_status_all(vcard_status_t statuses[VCARD_MAX_DEVICES], int *count);
+
+/**
+ * Register callback for periodic status snapshots
+ *
+ * The callback runs on a library-owned, non-real-time status thread every
+ * status interval (see vcard_set_status_interval). It may call any
+ * function except vcard_set_status_callback, vcard_set_status_interval,
+ * vcard_destroy_device and vcard_cleanup. Pass NULL to unregister; once
+ * this returns, the previous callback is not running and will not run.
+ *
  * @param device_id Device ID
- * @param callback Callback function
+ * @param callback Callback function (NULL to unregister)
  * @param user_data User data passed to callback
  * @return 0 on success, error code on failure
  */
@@ -224,6 +414,46 @@ int vcard_set_status_callback(int device_id,
                                vcard_status_callback_t callback,
                                void *user_data);
 
+/**
+ * Set how often the status callback is invoked
+ * @param device_id Device ID
+ * @param interval_ms Interval in milliseconds (10-60000, default 100)
+ * @return 0 on success, error code on failure
+ */
+int vcard_set_status_interval(int device_id, uint32_t interval_ms);
+
+/* Backend Telemetry */
+
+/*
+ * Called by the backend driving a device (ALSA, JACK, CoreAudio, WASAPI)
+ * from its audio thread. Each call is a relaxed atomic update: no locks,
+ * allocation or system calls.
+ */
+
+/**
+ * Report one processed period
+ * @param device_id Device ID
+ * @param frames Frames in the period
+ * @param busy_ns Time spent processing the period, used for cpu_load
+ * @return 0 on success, error code on failure
+ */
+int vcard_report_period(int device_id, uint32_t frames, uint64_t busy_ns);
+
+/**
+ * Report a buffer over/underrun (may be called from any thread)
+ * @param device_id Device ID
+ * @return 0 on success, error code on failure
+ */
+int vcard_report_xrun(int device_id);
+
+/**
+ * Report the backend's own latency (hardware and driver buffering)
+ * @param device_id Device ID
+ * @param latency_us Latency in microseconds
+ * @return 0 on success, error code on failure
+ */
+int vcard_report_latency(int device_id, uint32_t latency_us);
+
 /* MIDI API */
 
 /**
@@ -247,23 +477,50 @@ int vcard_midi_open(int device_id,
 int vcard_midi_close(vcard_midi_handle_t midi_handle);
 
 /**
- * Send a MIDI message
+ * Send a MIDI message on an output port
+ *
+ * The message is stamped with the device's current write position in
+ * frames (see vcard_midi_send_timed). Output port N loops back to input
+ * port N; messages on an output port without a matching input port are
+ * discarded. Lock- and allocation-free; one sending thread per port.
+ *
  * @param midi_handle MIDI handle
  * @param message MIDI message data
- * @param length Message length in bytes
- * @return 0 on success, error code on failure
+ * @param length Message length in bytes (1 to VCARD_MAX_MIDI_MESSAGE)
+ * @return 0 on success, VCARD_ERROR_NO_MEMORY if the port queue is full,
+ *         other error code on failure
  */
 int vcard_midi_send(vcard_midi_handle_t midi_handle,
                     const uint8_t *message,
                     size_t length);
 
+/**
+ * Send a MIDI message stamped with an explicit sample-frame time
+ *
+ * Frame times share the timeline of vcard_write_audio/vcard_read_audio:
+ * frame N is the Nth frame written to (and read from) the device. Messages
+ * on a port must be sent in non-decreasing time order.
+ *
+ * @param midi_handle MIDI handle
+ * @param message MIDI message data
+ * @param length Message length in bytes (1 to VCARD_MAX_MIDI_MESSAGE)
+ * @param frame_time Timestamp in sample frames
+ * @return 0 on success, VCARD_ERROR_NO_MEMORY if the port queue is full,
+ *         other error code on failure
+ */
+int vcard_midi_send_timed(vcard_midi_handle_t midi_handle,
+                          const uint8_t *message,
+                          size_t length,
+                          uint64_t frame_time);
+
 /**
  * Receive a MIDI message (non-blocking)
  * @param midi_handle MIDI handle
  * @param message Buffer for MIDI message
  * @param max_length Maximum message length
- * @param length Output parameter for actual message length
- * @return 0 on success, error code on failure
+ * @param length Output parameter for actual message length (0 if none)
+ * @return 0 on success, VCARD_ERROR_INVALID if the message does not fit
+ *         (it stays queued and *length reports its size)
  */
 int vcard_midi_receive(vcard_midi_handle_t midi_handle,
                        uint8_t *message,
@@ -271,7 +528,36 @@ int vcard_midi_receive(vcard_midi_handle_t midi_handle,
                        size_t *length);
 
 /**
- * Register callback for MIDI messages
+ * Receive the next MIDI message due before a sample frame (non-blocking)
+ *
+ * Lets an audio callback drain exactly the messages belonging to the
+ * period it is processing: pass the frame after the period's last frame.
+ *
+ * @param midi_handle MIDI handle
+ * @param frame_limit Only return messages stamped before this frame
+ * @param message Buffer for MIDI message
+ * @param max_length Maximum message length
+ * @param length Output parameter for actual message length (0 if none due)
+ * @param frame_time Output parameter for the message timestamp (may be NULL)
+ * @return 0 on success, VCARD_ERROR_INVALID if the message does not fit
+ */
+int vcard_midi_receive_timed(vcard_midi_handle_t midi_handle,
+                             uint64_t frame_limit,
+                             uint8_t *message,
+                             size_t max_length,
+                             size_t *length,
+                             uint64_t *frame_time);
+
+/**
+ * Register callback for MIDI messages on an input port
+ *
+ * While a callback is registered, messages sent to the port are delivered
+ * synchronously on the sending thread instead of being queued. The
+ * callback may be replaced or cleared (NULL) while the sender streams: a
+ * send sees either the old callback with its user data or the new one
+ * with its own, and this call returns once no send can still be running
+ * the old one. It must therefore not be called from the callback itself.
+ *
  * @param midi_handle MIDI handle
  * @param callback Callback function
  * @param user_data User data passed to callback
@@ -0,0 +1,176 @@
+/**
+ * Virtual Sound Card - Portable Atomics
+ *
+ * Minimal set of atomic operations used by the real-time paths of the
+ * common library. GCC and Clang use C11 <stdatomic.h>; MSVC uses the
+ * Interlocked intrinsics, which are full barriers and therefore at least
+ * as strong as the requested ordering.
+ */
+
+#ifndef VCARD_ATOMIC_H
+#define VCARD_ATOMIC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Cache line size used to pad indices shared between threads */
+#define VCARD_CACHELINE 64
+
+#if defined(_MSC_VER) && !defined(__clang__)
+
+#include <windows.h>
+#include <intrin.h>
+
+typedef volatile long vcard_atomic_u32;
+typedef volatile __int64 vcard_atomic_u64;
+typedef void *volatile vcard_atomic_ptr;
+
+static __inline uint32_t vcard_atomic_load_relaxed_u32(const vcard_atomic_u32 *p)
+{
+    return (uint32_t)*p;
+}
+
+static __inline uint32_t vcard_atomic_load_acquire_u32(const vcard_atomic_u32 *p)
+{
+    return (uint32_t)_InterlockedCompareExchange((volatile long *)p, 0, 0);
+}
+
+static __inline void vcard_atomic_store_relaxed_u32(vcard_atomic_u32 *p, uint32_t v)
+{
+    *p = (long)v;
+}
+
+static __inline void vcard_atomic_store_release_u32(vcard_atomic_u32 *p, uint32_t v)
+{
+    _InterlockedExchange(p, (long)v);
+}
+
+static __inline uint32_t vcard_atomic_fetch_add_u32(vcard_atomic_u32 *p, uint32_t v)
+{
+    return (uint32_t)_InterlockedExchangeAdd(p, (long)v);
+}
+
+static __inline uint32_t vcard_atomic_exchange_u32(vcard_atomic_u32 *p, uint32_t v)
+{
+    return (uint32_t)_InterlockedExchange(p, (long)v);
+}
+
+static __inline uint64_t vcard_atomic_load_relaxed_u64(const vcard_atomic_u64 *p)
+{
+    return (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)p, 0, 0);
+}
+
+static __inline void vcard_atomic_store_relaxed_u64(vcard_atomic_u64 *p, uint64_t v)
+{
+    _InterlockedExchange64(p, (__int64)v);
+}
+
+static __inline uint64_t vcard_atomic_fetch_add_u64(vcard_atomic_u64 *p, uint64_t v)
+{
+    return (uint64_t)_InterlockedExchangeAdd64(p, (__int64)v);
+}
+
+static __inline void *vcard_atomic_load_acquire_ptr(vcard_atomic_ptr *p)
+{
+    return _InterlockedCompareExchangePointer((void *volatile *)p, NULL, NULL);
+}
+
+static __inline void vcard_atomic_store_release_ptr(vcard_atomic_ptr *p, void *v)
+{
+    _InterlockedExchangePointer((void *volatile *)p, v);
+}
+
+static __inline void *vcard_atomic_exchange_ptr(vcard_atomic_ptr *p, void *v)
+{
+    return _InterlockedExchangePointer((void *volatile *)p, v);
+}
+
+static __inline void vcard_atomic_fence(void)
+{
+    MemoryBarrier();
+}
+
+#else
+
+#include <stdatomic.h>
+
+typedef _Atomic uint32_t vcard_atomic_u32;
+typedef _Atomic uint64_t vcard_atomic_u64;
+typedef _Atomic(void *) vcard_atomic_ptr;
+
+static inline uint32_t vcard_atomic_load_relaxed_u32(const vcard_atomic_u32 *p)
+{
+    return atomic_load_explicit((vcard_atomic_u32 *)p, memory_order_relaxed);
+}
+
+static inline uint32_t vcard_atomic_load_acquire_u32(const vcard_atomic_u32 *p)
+{
+    return atomic_load_explicit((vcard_atomic_u32 *)p, memory_order_acquire);
+}
+
+static inline void vcard_atomic_store_relaxed_u32(vcard_atomic_u32 *p, uint32_t v)
+{
+    atomic_store_explicit(p, v, memory_order_relaxed);
+}
+
+static inline void vcard_atomic_store_release_u32(vcard_atomic_u32 *p, uint32_t v)
+{
+    atomic_store_explicit(p, v, memory_order_release);
+}
+
+static inline uint32_t vcard_atomic_fetch_add_u32(vcard_atomic_u32 *p, uint32_t v)
+{
+    return atomic_fetch_add_explicit(p, v, memory_order_relaxed);
+}
+
+static inline uint32_t vcard_atomic_exchange_u32(vcard_atomic_u32 *p, uint32_t v)
+{
+    return atomic_exchange_explicit(p, v, memory_order_acq_rel);
+}
+
+static inline uint64_t vcard_atomic_load_relaxed_u64(const vcard_atomic_u64 *p)
+{
+    return atomic_load_explicit((vcard_atomic_u64 *)p, memory_order_relaxed);
+}
+
+static inline void vcard_atomic_store_relaxed_u64(vcard_atomic_u64 *p, uint64_t v)
+{
+    atomic_store_explicit(p, v, memory_order_relaxed);
+}
+
+static inline uint64_t vcard_atomic_fetch_add_u64(vcard_atomic_u64 *p, uint64_t v)
+{
+    return atomic_fetch_add_explicit(p, v, memory_order_relaxed);
+}
+
+static inline void *vcard_atomic_load_acquire_ptr(vcard_atomic_ptr *p)
+{
+    return atomic_load_explicit(p, memory_order_acquire);
+}
+
+static inline void vcard_atomic_store_release_ptr(vcard_atomic_ptr *p, void *v)
+{
+    atomic_store_explicit(p, v, memory_order_release);
+}
+
+static inline void *vcard_atomic_exchange_ptr(vcard_atomic_ptr *p, void *v)
+{
+    return atomic_exchange_explicit(p, v, memory_order_acq_rel);
+}
+
+static inline void vcard_atomic_fence(void)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VCARD_ATOMIC_H */
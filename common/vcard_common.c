@@ -1,28 +1,351 @@
 /**
  * Virtual Sound Card - Common Implementation
- * 
- * Stub implementations for cross-platform API
+ *
+ * In-process virtual device engine. Every device owns one lock-free SPSC
+ * ring buffer per output channel; a producer thread writes with
+ * vcard_write_audio() and a consumer thread reads with vcard_read_audio()
+ * without locks or system calls. MIDI output port N is looped back to
+ * input port N through a lock-free message queue. Control functions
+ * (create, destroy, configure, open/close) are serialized by a mutex and,
+ * apart from vcard_set_config() and vcard_set_routing(), must not race
+ * with streaming calls on the same device. A sample rate or period size
+ * change builds a new set of rings off the streaming path and swaps it in
+ * between two transfers, waiting out any transfer still using the old
+ * set before freeing it. Backends report
+ * xruns, CPU load and latency into per-device relaxed atomics; a status
+ * thread delivers snapshots to registered callbacks.
  */
 
 #include "vcard.h"
+#include "ring_buffer.h"
+#include "midi_queue.h"
+#include "routing_mixer.h"
+#include "dsp_chain.h"
+#include "vcard_atomic.h"
+#include "vcard_telemetry.h"
+#include "vcard_thread.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+/* Ring capacity in periods of config.buffer_size frames */
+#define VCARD_RING_PERIODS 4
+
+/* Frames mixed per block when a routing configuration is applied */
+#define VCARD_MIX_BLOCK 256
+
+/* Accepted configuration ranges */
+#define VCARD_MIN_SAMPLE_RATE 8000
+#define VCARD_MAX_SAMPLE_RATE 192000
+#define VCARD_MIN_BUFFER_SIZE 16
+#define VCARD_MAX_BUFFER_SIZE 8192
+
+/* Poll interval while a stream swap waits for an in-flight transfer */
+#define VCARD_SWAP_POLL_US 20
+
+/* Per-port MIDI queue: messages in flight and preallocated sysex slots */
+#define VCARD_MIDI_QUEUE_SIZE 4096
+#define VCARD_MIDI_SYSEX_SLOTS 16
+
+/* Status callback delivery */
+#define VCARD_STATUS_DEFAULT_INTERVAL_MS 100
+#define VCARD_STATUS_MIN_INTERVAL_MS 10
+#define VCARD_STATUS_MAX_INTERVAL_MS 60000
+#define VCARD_STATUS_TICK_US 10000       /* Longest status thread sleep */
+
+/* A registered MIDI callback; never modified once published */
+typedef struct {
+    vcard_midi_callback_t callback;
+    void *user_data;
+} vcard_midi_binding_t;
+
+typedef struct {
+    vcard_atomic_u32 open;
+    int device_id;
+    vcard_midi_direction_t direction;
+    uint32_t index;
+    vcard_atomic_ptr binding;            /* Input ports: vcard_midi_binding_t, or NULL */
+    vcard_atomic_u32 send_seq;           /* Output ports: odd while a send uses the peer's binding */
+} vcard_midi_port_t;
+
+/**
+ * Rings for one sample rate and period size (channel counts never change)
+ */
+typedef struct {
+    uint32_t channels_in;
+    uint32_t channels_out;
+    ring_buffer_t rings[VCARD_MAX_CHANNELS]; /* One per output channel */
+} vcard_stream_t;
+
+typedef struct {
+    vcard_atomic_u32 active;             /* Published once setup is complete */
+    vcard_atomic_u32 slot_seq;           /* Odd while setup resets the counters */
+    vcard_config_t config;
+    vcard_routing_t routing;             /* As last set, for vcard_get_routing */
+    routing_mixer_t *mixer;              /* Compiled routing, applied on read */
+    vcard_insert_chain_t inserts;        /* As last set, for vcard_get_inserts */
+    vcard_atomic_ptr chain;              /* Compiled inserts (dsp_chain_t), or NULL */
+    vcard_atomic_ptr stream;             /* Current vcard_stream_t */
+    vcard_atomic_u32 writer_seq;         /* Odd while a write holds the stream */
+    vcard_atomic_u32 reader_seq;         /* Odd while a read holds the stream */
+    float *mix_scratch;                  /* Consumer-owned routing scratch */
+    vcard_atomic_u32 sample_rate;        /* config.sample_rate, for lock-free readers */
+    vcard_atomic_u32 buffer_size;        /* config.buffer_size, likewise */
+    vcard_atomic_u64 frames_written;
+    vcard_atomic_u64 frames_read;
+    vcard_atomic_u64 frames_discarded;   /* Dropped minus silence queued by stream swaps */
+    vcard_telemetry_t telemetry;         /* Reported by the backend */
+    vcard_status_callback_t status_callback; /* Guarded by status_lock */
+    void *status_user_data;
+    uint32_t status_interval_ms;
+    uint64_t status_due_ns;
+    vcard_midi_port_t midi_in[VCARD_MAX_MIDI_PORTS];
+    vcard_midi_port_t midi_out[VCARD_MAX_MIDI_PORTS];
+    midi_queue_t midi_queues[VCARD_MAX_MIDI_PORTS]; /* Output N -> input N */
+} vcard_device_t;
+
 /* Global state */
 static bool initialized = false;
+static vcard_mutex_t devices_lock = VCARD_MUTEX_INITIALIZER;
+static vcard_device_t devices[VCARD_MAX_DEVICES];
+
+/*
+ * Seqlock over which slots are active and at what rate and buffer size:
+ * odd while create, destroy or set_config changes them (under
+ * devices_lock). vcard_get_status_all() reads every slot between two
+ * loads of it and retries if it moved, so one snapshot never mixes two
+ * device tables.
+ */
+static vcard_atomic_u32 devices_seq;
+
+/* Status thread; status_lock is never taken while holding devices_lock */
+static vcard_mutex_t status_lock = VCARD_MUTEX_INITIALIZER;
+static vcard_thread_t status_thread;
+static bool status_thread_running = false;
+static vcard_atomic_u32 status_thread_stop;
+
+/**
+ * Look up an active device (lock-free, safe on the streaming path)
+ */
+static vcard_device_t *get_device(int device_id)
+{
+    if (device_id < 0 || device_id >= VCARD_MAX_DEVICES) {
+        return NULL;
+    }
+    if (!vcard_atomic_load_acquire_u32(&devices[device_id].active)) {
+        return NULL;
+    }
+    return &devices[device_id];
+}
+
+/**
+ * Resolve an open MIDI handle (lock-free, safe on the streaming path)
+ */
+static vcard_midi_port_t *get_midi_port(vcard_midi_handle_t midi_handle)
+{
+    vcard_midi_port_t *port = (vcard_midi_port_t *)midi_handle;
+
+    if (!port || !vcard_atomic_load_acquire_u32(&port->open)) {
+        return NULL;
+    }
+    return port;
+}
+
+/* Number of loopback queues: one per output port that has a matching input */
+static uint32_t midi_loopback_ports(const vcard_config_t *config)
+{
+    return config->midi_ports_out < config->midi_ports_in ?
+           config->midi_ports_out : config->midi_ports_in;
+}
+
+static int validate_config(const vcard_config_t *config)
+{
+    if (!config) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (config->name[0] == '\0' ||
+        memchr(config->name, '\0', VCARD_MAX_DEVICE_NAME) == NULL) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (config->channels_in < 1 || config->channels_in > VCARD_MAX_CHANNELS ||
+        config->channels_out < 1 || config->channels_out > VCARD_MAX_CHANNELS) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (config->sample_rate < VCARD_MIN_SAMPLE_RATE ||
+        config->sample_rate > VCARD_MAX_SAMPLE_RATE) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (config->buffer_size < VCARD_MIN_BUFFER_SIZE ||
+        config->buffer_size > VCARD_MAX_BUFFER_SIZE) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (config->bit_depth != VCARD_BIT_16 && config->bit_depth != VCARD_BIT_24 &&
+        config->bit_depth != VCARD_BIT_32) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (config->midi_ports_in > VCARD_MAX_MIDI_PORTS ||
+        config->midi_ports_out > VCARD_MAX_MIDI_PORTS) {
+        return VCARD_ERROR_INVALID;
+    }
+    return VCARD_SUCCESS;
+}
+
+static int validate_routing(const vcard_device_t *dev, const vcard_routing_t *routing)
+{
+    if (!routing || routing->num_routes < 0 || routing->num_routes > VCARD_MAX_ROUTES) {
+        return VCARD_ERROR_INVALID;
+    }
+    for (int i = 0; i < routing->num_routes; i++) {
+        if (routing->routes[i].source_channel >= dev->config.channels_out ||
+            routing->routes[i].dest_channel >= dev->config.channels_in) {
+            return VCARD_ERROR_INVALID;
+        }
+    }
+    return VCARD_SUCCESS;
+}
+
+static void stream_free(vcard_stream_t *stream)
+{
+    if (!stream) {
+        return;
+    }
+    for (uint32_t ch = 0; ch < stream->channels_out; ch++) {
+        if (stream->rings[ch].data) {
+            ring_buffer_free(&stream->rings[ch]);
+        }
+    }
+    free(stream);
+}
+
+/**
+ * Allocate rings for a configuration, queueing silence_frames of silence
+ *
+ * @return New stream, or NULL when out of memory
+ */
+static vcard_stream_t *stream_create(const vcard_config_t *config, uint32_t silence_frames)
+{
+    vcard_stream_t *stream = (vcard_stream_t *)calloc(1, sizeof(vcard_stream_t));
+    uint32_t capacity = config->buffer_size * VCARD_RING_PERIODS;
+
+    if (!stream) {
+        return NULL;
+    }
+    stream->channels_in = config->channels_in;
+    stream->channels_out = config->channels_out;
+    for (uint32_t ch = 0; ch < stream->channels_out; ch++) {
+        float *region1, *region2;
+        uint32_t size1, size2;
+
+        if (ring_buffer_init(&stream->rings[ch], capacity) != VCARD_SUCCESS) {
+            stream_free(stream);
+            return NULL;
+        }
+        ring_buffer_get_write_regions(&stream->rings[ch], silence_frames, &region1, &size1,
+                                      &region2, &size2);
+        memset(region1, 0, size1 * sizeof(float));
+        ring_buffer_commit_write(&stream->rings[ch], size1);
+    }
+    return stream;
+}
+
+/**
+ * Take the current stream for one transfer (streaming path)
+ *
+ * The odd sequence is made visible before the stream pointer is read, so
+ * a swap either sees this transfer in flight or this transfer sees the
+ * new stream.
+ */
+static vcard_stream_t *stream_enter(vcard_device_t *dev, vcard_atomic_u32 *seq)
+{
+    vcard_atomic_store_relaxed_u32(seq, vcard_atomic_load_relaxed_u32(seq) + 1);
+    vcard_atomic_fence();
+    return (vcard_stream_t *)vcard_atomic_load_acquire_ptr(&dev->stream);
+}
+
+static void stream_leave(vcard_atomic_u32 *seq)
+{
+    vcard_atomic_store_release_u32(seq, vcard_atomic_load_relaxed_u32(seq) + 1);
+}
+
+/**
+ * Wait until a transfer that may hold the previous stream has finished
+ */
+static void stream_quiesce(vcard_atomic_u32 *seq)
+{
+    uint32_t entered = vcard_atomic_load_acquire_u32(seq);
+
+    if (entered & 1) {
+        while (vcard_atomic_load_acquire_u32(seq) == entered) {
+            vcard_sleep_us(VCARD_SWAP_POLL_US);
+        }
+    }
+}
+
+/**
+ * Open a device table change (caller holds devices_lock)
+ */
+static void table_write_begin(void)
+{
+    vcard_atomic_store_relaxed_u32(&devices_seq,
+                                   vcard_atomic_load_relaxed_u32(&devices_seq) + 1);
+    vcard_atomic_fence();
+}
+
+static void table_write_end(void)
+{
+    vcard_atomic_store_release_u32(&devices_seq,
+                                   vcard_atomic_load_relaxed_u32(&devices_seq) + 1);
+}
+
+/**
+ * Release the buffers of a device slot (caller holds devices_lock)
+ */
+static void release_device(vcard_device_t *dev)
+{
+    stream_free((vcard_stream_t *)vcard_atomic_exchange_ptr(&dev->stream, NULL));
+    free(dev->mix_scratch);
+    dev->mix_scratch = NULL;
+    free(dev->mixer);
+    dev->mixer = NULL;
+    dsp_chain_free((dsp_chain_t *)vcard_atomic_exchange_ptr(&dev->chain, NULL));
+    for (uint32_t port = 0; port < VCARD_MAX_MIDI_PORTS; port++) {
+        vcard_atomic_store_release_u32(&dev->midi_in[port].open, 0);
+        vcard_atomic_store_release_u32(&dev->midi_out[port].open, 0);
+        free(vcard_atomic_exchange_ptr(&dev->midi_in[port].binding, NULL));
+        if (dev->midi_queues[port].entries) {
+            midi_queue_free(&dev->midi_queues[port]);
+        }
+    }
+}
 
 int vcard_init(void)
 {
     if (initialized) {
         return VCARD_SUCCESS;
     }
-    
+
     initialized = true;
     return VCARD_SUCCESS;
 }
 
 void vcard_cleanup(void)
 {
+    int ids[VCARD_MAX_DEVICES];
+
+    for (int i = 0; i < VCARD_MAX_DEVICES; i++) {
+        ids[i] = i;
+    }
+    vcard_destroy_devices(ids, VCARD_MAX_DEVICES);
+
+    vcard_mutex_lock(&status_lock);
+    if (status_thread_running) {
+        vcard_atomic_store_release_u32(&status_thread_stop, 1);
+        vcard_mutex_unlock(&status_lock);
+        vcard_thread_join(&status_thread);
+        vcard_mutex_lock(&status_lock);
+        status_thread_running = false;
+    }
+    vcard_mutex_unlock(&status_lock);
     initialized = false;
 }
 
@@ -33,103 +356,942 @@ void vcard_get_version(int *major, int *minor, int *patch)
     if (patch) *patch = VCARD_VERSION_PATCH;
 }
 
-/* Device Management - Stub implementations */
+/**
+ * Set up an inactive slot for a validated configuration (caller holds
+ * devices_lock); it is published by setting active
+ *
+ * A monitor that looked the slot up before it was last destroyed may
+ * still be reading its counters, so those are reset with atomic stores
+ * inside an odd slot_seq rather than cleared with the rest of the slot.
+ * The status callback was already cleared, under status_lock, by destroy.
+ */
+static int setup_device(vcard_device_t *dev, const vcard_config_t *config)
+{
+    int result;
+
+    vcard_atomic_store_relaxed_u32(&dev->slot_seq,
+                                   vcard_atomic_load_relaxed_u32(&dev->slot_seq) + 1);
+    vcard_atomic_fence();
+    vcard_atomic_store_relaxed_u32(&dev->sample_rate, config->sample_rate);
+    vcard_atomic_store_relaxed_u32(&dev->buffer_size, config->buffer_size);
+    vcard_atomic_store_relaxed_u64(&dev->frames_written, 0);
+    vcard_atomic_store_relaxed_u64(&dev->frames_read, 0);
+    vcard_atomic_store_relaxed_u64(&dev->frames_discarded, 0);
+    vcard_telemetry_init(&dev->telemetry);
+    vcard_atomic_store_release_u32(&dev->slot_seq,
+                                   vcard_atomic_load_relaxed_u32(&dev->slot_seq) + 1);
+
+    // Only control calls, under devices_lock, use the rest of an inactive slot
+    dev->config = *config;
+    memset(&dev->routing, 0, sizeof(dev->routing));
+    memset(&dev->inserts, 0, sizeof(dev->inserts));
+    dev->status_interval_ms = VCARD_STATUS_DEFAULT_INTERVAL_MS;
+    dev->status_due_ns = 0;
+    for (uint32_t port = 0; port < VCARD_MAX_MIDI_PORTS; port++) {
+        memset(&dev->midi_queues[port], 0, sizeof(dev->midi_queues[port]));
+    }
+
+    vcard_atomic_store_release_ptr(&dev->stream, stream_create(config, 0));
+    if (!vcard_atomic_load_acquire_ptr(&dev->stream)) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    dev->mix_scratch = (float *)malloc((size_t)config->channels_out *
+                                       VCARD_MIX_BLOCK * sizeof(float));
+    dev->mixer = (routing_mixer_t *)malloc(sizeof(routing_mixer_t));
+    if (!dev->mix_scratch || !dev->mixer) {
+        release_device(dev);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    routing_mixer_init(dev->mixer, config->channels_in, config->channels_out);
+    for (uint32_t port = 0; port < midi_loopback_ports(config); port++) {
+        result = midi_queue_init(&dev->midi_queues[port], VCARD_MIDI_QUEUE_SIZE,
+                                 VCARD_MIDI_SYSEX_SLOTS, VCARD_MAX_MIDI_MESSAGE);
+        if (result != VCARD_SUCCESS) {
+            release_device(dev);
+            return result;
+        }
+    }
+    return VCARD_SUCCESS;
+}
+
+/**
+ * Check that no active device other than except_id, and no earlier entry
+ * of the batch, has the name (caller holds devices_lock)
+ */
+static bool name_taken(const vcard_config_t *configs, int index, int except_id)
+{
+    const char *name = configs[index].name;
+
+    for (int i = 0; i < VCARD_MAX_DEVICES; i++) {
+        if (i != except_id && vcard_atomic_load_relaxed_u32(&devices[i].active) &&
+            strcmp(devices[i].config.name, name) == 0) {
+            return true;
+        }
+    }
+    for (int i = 0; i < index; i++) {
+        if (strcmp(configs[i].name, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Device Management */
 int vcard_create_device(const vcard_config_t *config, int *device_id)
 {
-    (void)config;
-    (void)device_id;
-    return VCARD_ERROR_NOT_FOUND; /* Platform-specific implementation required */
+    return vcard_create_devices(config, 1, device_id);
+}
+
+int vcard_create_devices(const vcard_config_t *configs, int count, int *device_ids)
+{
+    int result = VCARD_SUCCESS;
+    int created = 0;
+
+    if (!initialized || !configs || !device_ids || count <= 0 ||
+        count > VCARD_MAX_DEVICES) {
+        return VCARD_ERROR_INVALID;
+    }
+    for (int i = 0; i < count; i++) {
+        result = validate_config(&configs[i]);
+        if (result != VCARD_SUCCESS) {
+            return result;
+        }
+    }
+
+    vcard_mutex_lock(&devices_lock);
+    for (int i = 0; i < count && result == VCARD_SUCCESS; i++) {
+        if (name_taken(configs, i, -1)) {
+            result = VCARD_ERROR_IN_USE;
+        }
+    }
+
+    // Set every slot up before publishing any, so a failure leaves no trace
+    for (int slot = 0; slot < VCARD_MAX_DEVICES && created < count &&
+         result == VCARD_SUCCESS; slot++) {
+        bool claimed = vcard_atomic_load_relaxed_u32(&devices[slot].active) != 0;
+
+        for (int i = 0; i < created && !claimed; i++) {
+            claimed = device_ids[i] == slot;
+        }
+        if (claimed) {
+            continue;
+        }
+        result = setup_device(&devices[slot], &configs[created]);
+        if (result == VCARD_SUCCESS) {
+            device_ids[created++] = slot;
+        }
+    }
+    if (result == VCARD_SUCCESS && created < count) {
+        result = VCARD_ERROR_NO_MEMORY;
+    }
+    if (result != VCARD_SUCCESS) {
+        for (int i = 0; i < created; i++) {
+            release_device(&devices[device_ids[i]]);
+        }
+        vcard_mutex_unlock(&devices_lock);
+        return result;
+    }
+
+    table_write_begin();
+    for (int i = 0; i < count; i++) {
+        vcard_atomic_store_release_u32(&devices[device_ids[i]].active, 1);
+    }
+    table_write_end();
+    vcard_mutex_unlock(&devices_lock);
+    return VCARD_SUCCESS;
 }
 
 int vcard_destroy_device(int device_id)
 {
-    (void)device_id;
-    return VCARD_ERROR_NOT_FOUND; /* Platform-specific implementation required */
+    return vcard_destroy_devices(&device_id, 1);
+}
+
+int vcard_destroy_devices(const int *device_ids, int count)
+{
+    bool destroyed[VCARD_MAX_DEVICES] = {false};
+    int result = VCARD_SUCCESS;
+
+    if (!device_ids || count < 0) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    // Wait out in-flight status callbacks before the slots go away
+    vcard_mutex_lock(&status_lock);
+    for (int i = 0; i < count; i++) {
+        if (get_device(device_ids[i])) {
+            devices[device_ids[i]].status_callback = NULL;
+        }
+    }
+    vcard_mutex_unlock(&status_lock);
+
+    vcard_mutex_lock(&devices_lock);
+    table_write_begin();
+    for (int i = 0; i < count; i++) {
+        vcard_device_t *dev = get_device(device_ids[i]);
+
+        if (!dev) {
+            result = VCARD_ERROR_NOT_FOUND;
+            continue;
+        }
+        vcard_atomic_store_release_u32(&dev->active, 0);
+        destroyed[device_ids[i]] = true;
+    }
+    table_write_end();
+
+    for (int i = 0; i < VCARD_MAX_DEVICES; i++) {
+        if (destroyed[i]) {
+            release_device(&devices[i]);
+        }
+    }
+    vcard_mutex_unlock(&devices_lock);
+    return result;
 }
 
-int vcard_list_devices(vcard_device_info_t *devices, int max_devices, int *count)
+int vcard_list_devices(vcard_device_info_t *devices_out, int max_devices, int *count)
 {
-    (void)devices;
-    (void)max_devices;
-    if (count) *count = 0;
+    int found = 0;
+
+    if (!count || (max_devices > 0 && !devices_out)) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    vcard_mutex_lock(&devices_lock);
+    for (int i = 0; i < VCARD_MAX_DEVICES && found < max_devices; i++) {
+        vcard_device_t *dev = get_device(i);
+        if (!dev) {
+            continue;
+        }
+        vcard_device_info_t *info = &devices_out[found++];
+        info->device_id = i;
+        memcpy(info->name, dev->config.name, VCARD_MAX_DEVICE_NAME);
+        info->is_active = true;
+        info->channels_in = dev->config.channels_in;
+        info->channels_out = dev->config.channels_out;
+        info->sample_rate = dev->config.sample_rate;
+    }
+    vcard_mutex_unlock(&devices_lock);
+
+    *count = found;
     return VCARD_SUCCESS;
 }
 
-/* Device Configuration - Stub implementations */
+/* Device Configuration */
 int vcard_get_config(int device_id, vcard_config_t *config)
 {
-    (void)device_id;
-    (void)config;
-    return VCARD_ERROR_NOT_FOUND;
+    vcard_device_t *dev;
+
+    if (!config) {
+        return VCARD_ERROR_INVALID;
+    }
+    vcard_mutex_lock(&devices_lock);
+    dev = get_device(device_id);
+    if (dev) {
+        *config = dev->config;
+    }
+    vcard_mutex_unlock(&devices_lock);
+    return dev ? VCARD_SUCCESS : VCARD_ERROR_NOT_FOUND;
 }
 
 int vcard_set_config(int device_id, const vcard_config_t *config)
 {
-    (void)device_id;
-    (void)config;
-    return VCARD_ERROR_NOT_FOUND;
+    vcard_device_t *dev;
+    vcard_stream_t *stream, *old;
+    dsp_chain_t *chain = NULL, *old_chain = NULL;
+    int result = validate_config(config);
+
+    if (result != VCARD_SUCCESS) {
+        return result;
+    }
+
+    vcard_mutex_lock(&devices_lock);
+    dev = get_device(device_id);
+    if (!dev) {
+        vcard_mutex_unlock(&devices_lock);
+        return VCARD_ERROR_NOT_FOUND;
+    }
+
+    // Channel and port counts size the callers' buffer arrays and handles
+    if (config->channels_in != dev->config.channels_in ||
+        config->channels_out != dev->config.channels_out ||
+        config->midi_ports_in != dev->config.midi_ports_in ||
+        config->midi_ports_out != dev->config.midi_ports_out) {
+        vcard_mutex_unlock(&devices_lock);
+        return VCARD_ERROR_IN_USE;
+    }
+    // Names stay unique, or lookups by name would become ambiguous
+    if (name_taken(config, 0, device_id)) {
+        vcard_mutex_unlock(&devices_lock);
+        return VCARD_ERROR_IN_USE;
+    }
+    if (config->sample_rate == dev->config.sample_rate &&
+        config->buffer_size == dev->config.buffer_size) {
+        dev->config = *config;
+        vcard_mutex_unlock(&devices_lock);
+        return VCARD_SUCCESS;
+    }
+
+    // Audio queued at the old rate is dropped; the consumer hears one
+    // period of silence while the producer starts at the new rate
+    // EQ coefficients and delay lengths depend on the rate
+    if (dev->inserts.num_inserts && config->sample_rate != dev->config.sample_rate &&
+        dsp_chain_build(&dev->inserts, config->channels_in, config->sample_rate,
+                        &chain) != VCARD_SUCCESS) {
+        vcard_mutex_unlock(&devices_lock);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    stream = stream_create(config, config->buffer_size);
+    if (!stream) {
+        dsp_chain_free(chain);
+        vcard_mutex_unlock(&devices_lock);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    old = (vcard_stream_t *)vcard_atomic_exchange_ptr(&dev->stream, stream);
+    if (chain) {
+        old_chain = (dsp_chain_t *)vcard_atomic_exchange_ptr(&dev->chain, chain);
+    }
+    vcard_atomic_fence();
+    stream_quiesce(&dev->writer_seq);
+    stream_quiesce(&dev->reader_seq);
+
+    table_write_begin();
+    vcard_atomic_fetch_add_u64(&dev->frames_discarded,
+                               (uint64_t)ring_buffer_read_available(&old->rings[0]) -
+                               config->buffer_size);
+    vcard_atomic_store_relaxed_u32(&dev->sample_rate, config->sample_rate);
+    vcard_atomic_store_relaxed_u32(&dev->buffer_size, config->buffer_size);
+    table_write_end();
+    dev->config = *config;
+    vcard_mutex_unlock(&devices_lock);
+
+    stream_free(old);
+    dsp_chain_free(old_chain);
+    return VCARD_SUCCESS;
 }
 
-/* Audio Routing - Stub implementations */
+/* Audio Routing */
 int vcard_set_routing(int device_id, const vcard_routing_t *routing)
 {
-    (void)device_id;
-    (void)routing;
-    return VCARD_ERROR_NOT_FOUND;
+    vcard_device_t *dev;
+    int result;
+
+    vcard_mutex_lock(&devices_lock);
+    dev = get_device(device_id);
+    if (!dev) {
+        vcard_mutex_unlock(&devices_lock);
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    result = validate_routing(dev, routing);
+    if (result == VCARD_SUCCESS) {
+        dev->routing = *routing;
+        // Picked up by the reader at its next period, with a gain ramp
+        routing_mixer_publish(dev->mixer, routing);
+    }
+    vcard_mutex_unlock(&devices_lock);
+    return result;
 }
 
 int vcard_get_routing(int device_id, vcard_routing_t *routing)
 {
-    (void)device_id;
-    (void)routing;
-    return VCARD_ERROR_NOT_FOUND;
+    vcard_device_t *dev;
+
+    if (!routing) {
+        return VCARD_ERROR_INVALID;
+    }
+    vcard_mutex_lock(&devices_lock);
+    dev = get_device(device_id);
+    if (dev) {
+        *routing = dev->routing;
+    }
+    vcard_mutex_unlock(&devices_lock);
+    return dev ? VCARD_SUCCESS : VCARD_ERROR_NOT_FOUND;
+}
+
+/* Insert Chain */
+int vcard_set_inserts(int device_id, const vcard_insert_chain_t *chain)
+{
+    vcard_device_t *dev;
+    dsp_chain_t *compiled, *old;
+    int result;
+
+    vcard_mutex_lock(&devices_lock);
+    dev = get_device(device_id);
+    if (!dev) {
+        vcard_mutex_unlock(&devices_lock);
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    result = dsp_chain_build(chain, dev->config.channels_in, dev->config.sample_rate,
+                             &compiled);
+    if (result != VCARD_SUCCESS) {
+        vcard_mutex_unlock(&devices_lock);
+        return result;
+    }
+    dev->inserts = *chain;
+
+    // The reader picks the new chain up at its next read; wait out the current one
+    old = (dsp_chain_t *)vcard_atomic_exchange_ptr(&dev->chain, compiled);
+    vcard_atomic_fence();
+    stream_quiesce(&dev->reader_seq);
+    vcard_mutex_unlock(&devices_lock);
+
+    dsp_chain_free(old);
+    return VCARD_SUCCESS;
+}
+
+int vcard_get_inserts(int device_id, vcard_insert_chain_t *chain)
+{
+    vcard_device_t *dev;
+
+    if (!chain) {
+        return VCARD_ERROR_INVALID;
+    }
+    vcard_mutex_lock(&devices_lock);
+    dev = get_device(device_id);
+    if (dev) {
+        *chain = dev->inserts;
+    }
+    vcard_mutex_unlock(&devices_lock);
+    return dev ? VCARD_SUCCESS : VCARD_ERROR_NOT_FOUND;
+}
+
+int vcard_get_insert_meter(int device_id, uint32_t insert,
+                           vcard_meter_t levels[VCARD_MAX_CHANNELS])
+{
+    vcard_device_t *dev;
+    int result;
+
+    // Chains are only replaced under devices_lock, so this one stays put
+    vcard_mutex_lock(&devices_lock);
+    dev = get_device(device_id);
+    if (!dev) {
+        vcard_mutex_unlock(&devices_lock);
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    result = dsp_chain_meter((const dsp_chain_t *)vcard_atomic_load_acquire_ptr(&dev->chain),
+                             insert, levels);
+    vcard_mutex_unlock(&devices_lock);
+    return result;
+}
+
+/* Audio Streaming */
+int vcard_write_audio(int device_id,
+                      const float *const *buffers,
+                      size_t frames,
+                      size_t *frames_written)
+{
+    vcard_device_t *dev = get_device(device_id);
+    vcard_stream_t *stream;
+    uint32_t channels, count;
+
+    if (frames_written) *frames_written = 0;
+    if (!dev) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    if (!buffers) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    stream = stream_enter(dev, &dev->writer_seq);
+    channels = stream->channels_out;
+    count = frames > UINT32_MAX ? UINT32_MAX : (uint32_t)frames;
+
+    // Write the same number of frames to every channel to keep them aligned
+    for (uint32_t ch = 0; ch < channels; ch++) {
+        uint32_t space = ring_buffer_write_available(&stream->rings[ch]);
+        if (space < count) {
+            count = space;
+        }
+    }
+
+    for (uint32_t ch = 0; ch < channels; ch++) {
+        float *region1, *region2;
+        uint32_t size1, size2;
+
+        ring_buffer_get_write_regions(&stream->rings[ch], count, &region1, &size1,
+                                      &region2, &size2);
+        if (buffers[ch]) {
+            memcpy(region1, buffers[ch], size1 * sizeof(float));
+            if (size2) {
+                memcpy(region2, buffers[ch] + size1, size2 * sizeof(float));
+            }
+        } else {
+            memset(region1, 0, size1 * sizeof(float));
+            if (size2) {
+                memset(region2, 0, size2 * sizeof(float));
+            }
+        }
+        ring_buffer_commit_write(&stream->rings[ch], count);
+    }
+
+    vcard_atomic_fetch_add_u64(&dev->frames_written, count);
+    stream_leave(&dev->writer_seq);
+    if (frames_written) *frames_written = count;
+    return VCARD_SUCCESS;
+}
+
+/**
+ * Mix up to VCARD_MIX_BLOCK frames through the compiled routing matrix
+ */
+static void read_routed_block(vcard_device_t *dev, vcard_stream_t *stream,
+                              float *const *buffers, size_t offset, uint32_t count)
+{
+    const float *src[VCARD_MAX_CHANNELS];
+    float *dst[VCARD_MAX_CHANNELS];
+
+    for (uint32_t ch = 0; ch < stream->channels_out; ch++) {
+        float *scratch = dev->mix_scratch + ch * VCARD_MIX_BLOCK;
+        ring_buffer_read(&stream->rings[ch], scratch, count);
+        src[ch] = scratch;
+    }
+    for (uint32_t ch = 0; ch < stream->channels_in; ch++) {
+        dst[ch] = buffers[ch] ? buffers[ch] + offset : NULL;
+    }
+    routing_mixer_process(dev->mixer, src, dst, count);
+}
+
+int vcard_read_audio(int device_id,
+                     float *const *buffers,
+                     size_t frames,
+                     size_t *frames_read)
+{
+    vcard_device_t *dev = get_device(device_id);
+    vcard_stream_t *stream;
+    dsp_chain_t *chain;
+    uint32_t count;
+
+    if (frames_read) *frames_read = 0;
+    if (!dev) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    if (!buffers) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    stream = stream_enter(dev, &dev->reader_seq);
+    count = frames > UINT32_MAX ? UINT32_MAX : (uint32_t)frames;
+    for (uint32_t ch = 0; ch < stream->channels_out; ch++) {
+        uint32_t available = ring_buffer_read_available(&stream->rings[ch]);
+        if (available < count) {
+            count = available;
+        }
+    }
+
+    if (routing_mixer_begin(dev->mixer)) {
+        // Identity loopback: read straight from the rings into the caller
+        for (uint32_t ch = 0; ch < stream->channels_out; ch++) {
+            if (ch < stream->channels_in && buffers[ch]) {
+                ring_buffer_read(&stream->rings[ch], buffers[ch], count);
+            } else {
+                ring_buffer_commit_read(&stream->rings[ch], count);
+            }
+        }
+        for (uint32_t ch = stream->channels_out; ch < stream->channels_in; ch++) {
+            if (buffers[ch]) {
+                memset(buffers[ch], 0, count * sizeof(float));
+            }
+        }
+    } else {
+        for (uint32_t done = 0; done < count; ) {
+            uint32_t n = count - done;
+            if (n > VCARD_MIX_BLOCK) {
+                n = VCARD_MIX_BLOCK;
+            }
+            read_routed_block(dev, stream, buffers, done, n);
+            done += n;
+        }
+    }
+    chain = (dsp_chain_t *)vcard_atomic_load_acquire_ptr(&dev->chain);
+    if (chain && count) {
+        dsp_chain_process(chain, buffers, count);
+    }
+
+    vcard_atomic_fetch_add_u64(&dev->frames_read, count);
+    stream_leave(&dev->reader_seq);
+    if (frames_read) *frames_read = count;
+    return VCARD_SUCCESS;
+}
+
+/**
+ * Frames queued in the current stream, from the counters (any thread)
+ *
+ * The stream itself may be swapped and freed at any moment, so monitors
+ * never touch it.
+ */
+static uint32_t buffered_frames(vcard_device_t *dev)
+{
+    uint64_t read = vcard_atomic_load_relaxed_u64(&dev->frames_read);
+    uint64_t discarded = vcard_atomic_load_relaxed_u64(&dev->frames_discarded);
+    int64_t queued = (int64_t)(vcard_atomic_load_relaxed_u64(&dev->frames_written) -
+                               read - discarded);
+    uint32_t capacity = vcard_atomic_load_relaxed_u32(&dev->buffer_size) * VCARD_RING_PERIODS;
+
+    // The counters are read one at a time and trail the rings slightly
+    if (queued < 0) {
+        return 0;
+    }
+    return queued > (int64_t)capacity ? capacity : (uint32_t)queued;
+}
+
+int vcard_get_buffered(int device_id, size_t *frames)
+{
+    vcard_device_t *dev = get_device(device_id);
+
+    if (!dev) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    if (!frames) {
+        return VCARD_ERROR_INVALID;
+    }
+    *frames = buffered_frames(dev);
+    return VCARD_SUCCESS;
+}
+
+/* Status and Monitoring */
+
+/**
+ * Fill a status from the device's counters alone (any thread)
+ *
+ * @return false if the slot was being set up again meanwhile
+ */
+static bool read_status(vcard_device_t *dev, vcard_status_t *status)
+{
+    uint32_t seq = vcard_atomic_load_acquire_u32(&dev->slot_seq);
+    uint32_t buffered;
+
+    if (seq & 1) {
+        return false;
+    }
+    buffered = buffered_frames(dev);
+    memset(status, 0, sizeof(*status));
+    vcard_telemetry_snapshot(&dev->telemetry, status);
+    status->is_active = true;
+    status->sample_rate = vcard_atomic_load_relaxed_u32(&dev->sample_rate);
+    status->buffer_size = vcard_atomic_load_relaxed_u32(&dev->buffer_size);
+    status->frames_processed = vcard_atomic_load_relaxed_u64(&dev->frames_read);
+    vcard_atomic_fence();
+    if (status->sample_rate == 0 || vcard_atomic_load_relaxed_u32(&dev->slot_seq) != seq) {
+        return false;
+    }
+    // Frames queued in the device plus whatever the backend adds downstream
+    status->latency_us += (uint32_t)((uint64_t)buffered * 1000000u / status->sample_rate);
+    return true;
 }
 
-/* Status and Monitoring - Stub implementations */
 int vcard_get_status(int device_id, vcard_status_t *status)
 {
-    (void)device_id;
-    (void)status;
-    return VCARD_ERROR_NOT_FOUND;
+    vcard_device_t *dev = get_device(device_id);
+
+    if (!dev) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    if (!status) {
+        return VCARD_ERROR_INVALID;
+    }
+    return read_status(dev, status) ? VCARD_SUCCESS : VCARD_ERROR_NOT_FOUND;
+}
+
+int vcard_get_status_all(vcard_status_t statuses[VCARD_MAX_DEVICES], int *count)
+{
+    uint32_t seq;
+    int active;
+
+    if (!statuses || !count) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    // Retry while a create, destroy or reconfigure overlaps the pass
+    do {
+        seq = vcard_atomic_load_acquire_u32(&devices_seq);
+        if (seq & 1) {
+            continue;
+        }
+        active = 0;
+        for (int i = 0; i < VCARD_MAX_DEVICES; i++) {
+            vcard_device_t *dev = get_device(i);
+
+            if (!dev || !read_status(dev, &statuses[i])) {
+                memset(&statuses[i], 0, sizeof(statuses[i]));
+                continue;
+            }
+            active++;
+        }
+        vcard_atomic_fence();
+    } while ((seq & 1) || vcard_atomic_load_relaxed_u32(&devices_seq) != seq);
+
+    *count = active;
+    return VCARD_SUCCESS;
+}
+
+/**
+ * Deliver due status snapshots (status thread, holds status_lock)
+ *
+ * @return Nanoseconds until the next snapshot is due
+ */
+static uint64_t dispatch_status(uint64_t now)
+{
+    uint64_t wait = (uint64_t)VCARD_STATUS_TICK_US * 1000u;
+
+    for (int i = 0; i < VCARD_MAX_DEVICES; i++) {
+        vcard_device_t *dev = get_device(i);
+        vcard_status_t status;
+
+        if (!dev || !dev->status_callback) {
+            continue;
+        }
+        if (now >= dev->status_due_ns) {
+            if (vcard_get_status(i, &status) == VCARD_SUCCESS) {
+                dev->status_callback(i, &status, dev->status_user_data);
+            }
+            dev->status_due_ns += (uint64_t)dev->status_interval_ms * 1000000u;
+            if (dev->status_due_ns <= now) {
+                // Fell behind (slow callback): skip rather than burst
+                dev->status_due_ns = now + (uint64_t)dev->status_interval_ms * 1000000u;
+            }
+        }
+        if (dev->status_due_ns - now < wait) {
+            wait = dev->status_due_ns - now;
+        }
+    }
+    return wait;
+}
+
+static void status_thread_main(void *arg)
+{
+    (void)arg;
+
+    while (!vcard_atomic_load_acquire_u32(&status_thread_stop)) {
+        uint64_t wait;
+
+        vcard_mutex_lock(&status_lock);
+        wait = dispatch_status(vcard_time_ns());
+        vcard_mutex_unlock(&status_lock);
+        vcard_sleep_us((uint32_t)(wait / 1000u) + 1);
+    }
 }
 
-int vcard_set_status_callback(int device_id, 
+int vcard_set_status_callback(int device_id,
                               vcard_status_callback_t callback,
                               void *user_data)
 {
-    (void)device_id;
-    (void)callback;
-    (void)user_data;
-    return VCARD_ERROR_NOT_FOUND;
+    vcard_device_t *dev = get_device(device_id);
+    int result = VCARD_SUCCESS;
+
+    if (!dev) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+
+    vcard_mutex_lock(&status_lock);
+    if (callback && !status_thread_running) {
+        vcard_atomic_store_relaxed_u32(&status_thread_stop, 0);
+        result = vcard_thread_create(&status_thread, status_thread_main, NULL);
+        status_thread_running = result == VCARD_SUCCESS;
+    }
+    if (result == VCARD_SUCCESS) {
+        dev->status_callback = callback;
+        dev->status_user_data = user_data;
+        dev->status_due_ns = vcard_time_ns() +
+                             (uint64_t)dev->status_interval_ms * 1000000u;
+    }
+    vcard_mutex_unlock(&status_lock);
+    return result;
+}
+
+int vcard_set_status_interval(int device_id, uint32_t interval_ms)
+{
+    vcard_device_t *dev = get_device(device_id);
+
+    if (!dev) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    if (interval_ms < VCARD_STATUS_MIN_INTERVAL_MS ||
+        interval_ms > VCARD_STATUS_MAX_INTERVAL_MS) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    vcard_mutex_lock(&status_lock);
+    dev->status_interval_ms = interval_ms;
+    dev->status_due_ns = vcard_time_ns() + (uint64_t)interval_ms * 1000000u;
+    vcard_mutex_unlock(&status_lock);
+    return VCARD_SUCCESS;
+}
+
+/* Backend Telemetry */
+int vcard_report_period(int device_id, uint32_t frames, uint64_t busy_ns)
+{
+    vcard_device_t *dev = get_device(device_id);
+
+    if (!dev) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    vcard_telemetry_period(&dev->telemetry, frames,
+                           vcard_atomic_load_relaxed_u32(&dev->sample_rate), busy_ns);
+    return VCARD_SUCCESS;
+}
+
+int vcard_report_xrun(int device_id)
+{
+    vcard_device_t *dev = get_device(device_id);
+
+    if (!dev) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    vcard_telemetry_xrun(&dev->telemetry);
+    return VCARD_SUCCESS;
+}
+
+int vcard_report_latency(int device_id, uint32_t latency_us)
+{
+    vcard_device_t *dev = get_device(device_id);
+
+    if (!dev) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    vcard_telemetry_latency(&dev->telemetry, latency_us);
+    return VCARD_SUCCESS;
+}
+
+/* MIDI API */
+
+/**
+ * Replace the callback of an open input port (caller holds devices_lock)
+ *
+ * The sender on the matching output port reads the binding lock-free, so
+ * the old one is freed only once no send can still be using it.
+ */
+static int midi_rebind(vcard_midi_port_t *port, vcard_midi_callback_t callback,
+                       void *user_data)
+{
+    vcard_midi_binding_t *binding = NULL;
+
+    if (callback) {
+        binding = (vcard_midi_binding_t *)malloc(sizeof(vcard_midi_binding_t));
+        if (!binding) {
+            return VCARD_ERROR_NO_MEMORY;
+        }
+        binding->callback = callback;
+        binding->user_data = user_data;
+    }
+    binding = (vcard_midi_binding_t *)vcard_atomic_exchange_ptr(&port->binding, binding);
+    vcard_atomic_fence();
+    stream_quiesce(&devices[port->device_id].midi_out[port->index].send_seq);
+    free(binding);
+    return VCARD_SUCCESS;
 }
 
-/* MIDI API - Stub implementations */
-int vcard_midi_open(int device_id, 
+int vcard_midi_open(int device_id,
                    int port_index,
                    vcard_midi_direction_t direction,
                    vcard_midi_handle_t *midi_handle)
 {
-    (void)device_id;
-    (void)port_index;
-    (void)direction;
-    (void)midi_handle;
-    return VCARD_ERROR_NOT_FOUND;
+    vcard_device_t *dev;
+    vcard_midi_port_t *port;
+    uint32_t num_ports;
+
+    if (!midi_handle ||
+        (direction != VCARD_MIDI_INPUT && direction != VCARD_MIDI_OUTPUT)) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    vcard_mutex_lock(&devices_lock);
+    dev = get_device(device_id);
+    if (!dev) {
+        vcard_mutex_unlock(&devices_lock);
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    num_ports = direction == VCARD_MIDI_INPUT ? dev->config.midi_ports_in :
+                                                dev->config.midi_ports_out;
+    if (port_index < 0 || (uint32_t)port_index >= num_ports) {
+        vcard_mutex_unlock(&devices_lock);
+        return VCARD_ERROR_NOT_FOUND;
+    }
+
+    port = direction == VCARD_MIDI_INPUT ? &dev->midi_in[port_index] :
+                                           &dev->midi_out[port_index];
+    // Each queue has exactly one producer and one consumer
+    if (vcard_atomic_load_relaxed_u32(&port->open)) {
+        vcard_mutex_unlock(&devices_lock);
+        return VCARD_ERROR_IN_USE;
+    }
+    port->device_id = device_id;
+    port->direction = direction;
+    port->index = (uint32_t)port_index;
+    vcard_atomic_store_release_u32(&port->open, 1);
+    vcard_mutex_unlock(&devices_lock);
+
+    *midi_handle = port;
+    return VCARD_SUCCESS;
 }
 
 int vcard_midi_close(vcard_midi_handle_t midi_handle)
 {
-    (void)midi_handle;
-    return VCARD_ERROR_NOT_FOUND;
+    vcard_midi_port_t *port;
+
+    vcard_mutex_lock(&devices_lock);
+    port = get_midi_port(midi_handle);
+    if (port) {
+        vcard_atomic_store_release_u32(&port->open, 0);
+        if (port->direction == VCARD_MIDI_INPUT) {
+            midi_rebind(port, NULL, NULL);
+        }
+    }
+    vcard_mutex_unlock(&devices_lock);
+    return port ? VCARD_SUCCESS : VCARD_ERROR_NOT_FOUND;
 }
 
 int vcard_midi_send(vcard_midi_handle_t midi_handle,
                    const uint8_t *message,
                    size_t length)
 {
-    (void)midi_handle;
-    (void)message;
-    (void)length;
-    return VCARD_ERROR_NOT_FOUND;
+    vcard_midi_port_t *port = get_midi_port(midi_handle);
+
+    if (!port) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    return vcard_midi_send_timed(midi_handle, message, length,
+        vcard_atomic_load_relaxed_u64(&devices[port->device_id].frames_written));
+}
+
+int vcard_midi_send_timed(vcard_midi_handle_t midi_handle,
+                          const uint8_t *message,
+                          size_t length,
+                          uint64_t frame_time)
+{
+    vcard_midi_port_t *port = get_midi_port(midi_handle);
+    vcard_device_t *dev;
+    vcard_midi_port_t *peer;
+    const vcard_midi_binding_t *binding = NULL;
+
+    if (!port) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    if (port->direction != VCARD_MIDI_OUTPUT || !message || length == 0 ||
+        length > VCARD_MAX_MIDI_MESSAGE) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    dev = &devices[port->device_id];
+    if (port->index >= midi_loopback_ports(&dev->config)) {
+        // No matching input port: nothing can observe the message
+        return VCARD_SUCCESS;
+    }
+
+    // Callback and user data come from one binding; set_callback waits for
+    // this send to leave before freeing the binding it replaced
+    peer = &dev->midi_in[port->index];
+    vcard_atomic_store_relaxed_u32(&port->send_seq,
+                                   vcard_atomic_load_relaxed_u32(&port->send_seq) + 1);
+    vcard_atomic_fence();
+    if (vcard_atomic_load_acquire_u32(&peer->open)) {
+        binding = (const vcard_midi_binding_t *)vcard_atomic_load_acquire_ptr(&peer->binding);
+    }
+    if (binding) {
+        binding->callback(peer, message, length, binding->user_data);
+    }
+    stream_leave(&port->send_seq);
+    if (binding) {
+        return VCARD_SUCCESS;
+    }
+    return midi_queue_push(&dev->midi_queues[port->index], message, length,
+                           frame_time);
 }
 
 int vcard_midi_receive(vcard_midi_handle_t midi_handle,
@@ -137,19 +1299,58 @@ int vcard_midi_receive(vcard_midi_handle_t midi_handle,
                       size_t max_length,
                       size_t *length)
 {
-    (void)midi_handle;
-    (void)message;
-    (void)max_length;
-    if (length) *length = 0;
-    return VCARD_ERROR_NOT_FOUND;
+    return vcard_midi_receive_timed(midi_handle, UINT64_MAX, message,
+                                    max_length, length, NULL);
+}
+
+int vcard_midi_receive_timed(vcard_midi_handle_t midi_handle,
+                             uint64_t frame_limit,
+                             uint8_t *message,
+                             size_t max_length,
+                             size_t *length,
+                             uint64_t *frame_time)
+{
+    vcard_midi_port_t *port = get_midi_port(midi_handle);
+    vcard_device_t *dev;
+    int result;
+
+    if (!length) {
+        return VCARD_ERROR_INVALID;
+    }
+    *length = 0;
+    if (!port) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    if (port->direction != VCARD_MIDI_INPUT) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    dev = &devices[port->device_id];
+    if (port->index >= midi_loopback_ports(&dev->config)) {
+        return VCARD_SUCCESS;
+    }
+
+    result = midi_queue_pop(&dev->midi_queues[port->index], frame_limit,
+                            message, max_length, length, frame_time);
+    return result < 0 ? result : VCARD_SUCCESS;
 }
 
 int vcard_midi_set_callback(vcard_midi_handle_t midi_handle,
                             vcard_midi_callback_t callback,
                             void *user_data)
 {
-    (void)midi_handle;
-    (void)callback;
-    (void)user_data;
-    return VCARD_ERROR_NOT_FOUND;
+    vcard_midi_port_t *port;
+    int result = VCARD_SUCCESS;
+
+    vcard_mutex_lock(&devices_lock);
+    port = get_midi_port(midi_handle);
+    if (!port) {
+        result = VCARD_ERROR_NOT_FOUND;
+    } else if (port->direction != VCARD_MIDI_INPUT) {
+        result = VCARD_ERROR_INVALID;
+    } else {
+        result = midi_rebind(port, callback, user_data);
+    }
+    vcard_mutex_unlock(&devices_lock);
+    return result;
 }
@@ -0,0 +1,136 @@
+/**
+ * Virtual Sound Card - Real-Time Telemetry
+ *
+ * Counters a backend updates from its audio thread and a monitoring thread
+ * snapshots into a vcard_status_t. Updates are relaxed atomic loads, stores
+ * and adds on naturally aligned words, so the audio thread never locks,
+ * blocks or makes a system call here. Each field is read atomically, but a
+ * snapshot is not a consistent cut across fields.
+ *
+ * Header-only so the standalone backend programs can use it without
+ * linking the common library.
+ */
+
+#ifndef VCARD_TELEMETRY_H
+#define VCARD_TELEMETRY_H
+
+#include <stdint.h>
+#include <string.h>
+#include "vcard.h"
+#include "vcard_atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Weight of the newest period in the smoothed CPU load */
+#define VCARD_TELEMETRY_LOAD_SMOOTHING 0.05f
+
+/**
+ * Telemetry block
+ *
+ * frames, cpu_load and the smoothing state have a single writer (the audio
+ * thread); xruns may be reported from any thread, e.g. a server
+ * notification callback; latency_us has a single writer of the backend's
+ * choosing.
+ */
+typedef struct {
+    vcard_atomic_u64 frames;             /* Frames processed */
+    vcard_atomic_u32 xruns;              /* Over/underruns */
+    vcard_atomic_u32 cpu_load;           /* Smoothed load, float bits */
+    vcard_atomic_u32 latency_us;         /* Output latency */
+    float load_avg;                      /* Audio-thread owned smoothing state */
+} vcard_telemetry_t;
+
+static inline uint32_t vcard_telemetry_float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline float vcard_telemetry_bits_float(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * Reset all counters
+ */
+static inline void vcard_telemetry_init(vcard_telemetry_t *t)
+{
+    vcard_atomic_store_relaxed_u64(&t->frames, 0);
+    vcard_atomic_store_relaxed_u32(&t->xruns, 0);
+    vcard_atomic_store_relaxed_u32(&t->cpu_load, vcard_telemetry_float_bits(0.0f));
+    vcard_atomic_store_relaxed_u32(&t->latency_us, 0);
+    t->load_avg = 0.0f;
+}
+
+/**
+ * Account for one processed period (audio thread)
+ *
+ * CPU load is the time spent producing the period as a percentage of the
+ * period's duration, smoothed over roughly 1 / VCARD_TELEMETRY_LOAD_SMOOTHING
+ * periods.
+ *
+ * @param t Telemetry block
+ * @param frames Frames in the period
+ * @param sample_rate Stream sample rate in Hz
+ * @param busy_ns Time spent processing the period
+ */
+static inline void vcard_telemetry_period(vcard_telemetry_t *t, uint32_t frames,
+                                          uint32_t sample_rate, uint64_t busy_ns)
+{
+    // Single writer: a plain load/store pair avoids a locked add
+    vcard_atomic_store_relaxed_u64(&t->frames,
+                                   vcard_atomic_load_relaxed_u64(&t->frames) + frames);
+    if (frames > 0 && sample_rate > 0) {
+        // busy / (frames / rate) * 100, with busy in ns
+        float load = (float)((double)busy_ns * sample_rate / ((double)frames * 1e7));
+        t->load_avg += (load - t->load_avg) * VCARD_TELEMETRY_LOAD_SMOOTHING;
+        vcard_atomic_store_relaxed_u32(&t->cpu_load,
+                                       vcard_telemetry_float_bits(t->load_avg));
+    }
+}
+
+/**
+ * Count an over/underrun (any thread)
+ */
+static inline void vcard_telemetry_xrun(vcard_telemetry_t *t)
+{
+    vcard_atomic_fetch_add_u32(&t->xruns, 1);
+}
+
+/**
+ * Publish the current latency
+ *
+ * @param t Telemetry block
+ * @param latency_us Latency in microseconds
+ */
+static inline void vcard_telemetry_latency(vcard_telemetry_t *t, uint32_t latency_us)
+{
+    vcard_atomic_store_relaxed_u32(&t->latency_us, latency_us);
+}
+
+/**
+ * Copy the counters into a status structure (monitoring thread)
+ *
+ * Only frames_processed, xruns, cpu_load and latency_us are written.
+ */
+static inline void vcard_telemetry_snapshot(const vcard_telemetry_t *t,
+                                            vcard_status_t *status)
+{
+    status->frames_processed = vcard_atomic_load_relaxed_u64(&t->frames);
+    status->xruns = vcard_atomic_load_relaxed_u32(&t->xruns);
+    status->cpu_load = vcard_telemetry_bits_float(
+        vcard_atomic_load_relaxed_u32(&t->cpu_load));
+    status->latency_us = vcard_atomic_load_relaxed_u32(&t->latency_us);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VCARD_TELEMETRY_H */
@@ -0,0 +1,274 @@
+/**
+ * Virtual Sound Card - Portable Threads Implementation
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#if defined(__linux__)
+#define _GNU_SOURCE                      /* pthread_setaffinity_np */
+#elif defined(__APPLE__)
+#define _DARWIN_C_SOURCE                 /* pthread_mach_thread_np */
+#endif
+
+#include "vcard_thread.h"
+#include "vcard.h"
+#include "vcard_atomic.h"
+
+#ifndef _WIN32
+#include <time.h>
+#include <unistd.h>
+#endif
+#ifdef __APPLE__
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
+static vcard_atomic_ptr exit_hook;
+
+void vcard_thread_set_exit_hook(const vcard_thread_exit_hook_t *hook)
+{
+    vcard_atomic_store_release_ptr(&exit_hook, (void *)hook);
+}
+
+static void run_exit_hook(void)
+{
+    const vcard_thread_exit_hook_t *hook =
+        (const vcard_thread_exit_hook_t *)vcard_atomic_load_acquire_ptr(&exit_hook);
+
+    if (hook) {
+        hook->fn();
+    }
+}
+
+#ifdef _WIN32
+
+void vcard_mutex_init(vcard_mutex_t *mutex)
+{
+    InitializeSRWLock(mutex);
+}
+
+void vcard_mutex_destroy(vcard_mutex_t *mutex)
+{
+    (void)mutex; /* SRW locks need no cleanup */
+}
+
+void vcard_mutex_lock(vcard_mutex_t *mutex)
+{
+    AcquireSRWLockExclusive(mutex);
+}
+
+void vcard_mutex_unlock(vcard_mutex_t *mutex)
+{
+    ReleaseSRWLockExclusive(mutex);
+}
+
+void vcard_cond_init(vcard_cond_t *cond)
+{
+    InitializeConditionVariable(cond);
+}
+
+void vcard_cond_destroy(vcard_cond_t *cond)
+{
+    (void)cond; /* Condition variables need no cleanup */
+}
+
+void vcard_cond_wait(vcard_cond_t *cond, vcard_mutex_t *mutex)
+{
+    SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+}
+
+void vcard_cond_signal(vcard_cond_t *cond)
+{
+    WakeConditionVariable(cond);
+}
+
+void vcard_cond_broadcast(vcard_cond_t *cond)
+{
+    WakeAllConditionVariable(cond);
+}
+
+static DWORD WINAPI thread_trampoline(LPVOID param)
+{
+    vcard_thread_t *thread = (vcard_thread_t *)param;
+    thread->fn(thread->arg);
+    run_exit_hook();
+    return 0;
+}
+
+int vcard_thread_create(vcard_thread_t *thread, void (*fn)(void *arg), void *arg)
+{
+    thread->fn = fn;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, thread_trampoline, thread, 0, NULL);
+    return thread->handle ? VCARD_SUCCESS : VCARD_ERROR_NO_MEMORY;
+}
+
+int vcard_thread_join(vcard_thread_t *thread)
+{
+    if (WaitForSingleObject(thread->handle, INFINITE) != WAIT_OBJECT_0) {
+        return VCARD_ERROR_IO;
+    }
+    CloseHandle(thread->handle);
+    thread->handle = NULL;
+    return VCARD_SUCCESS;
+}
+
+int vcard_thread_set_affinity(vcard_thread_t *thread, unsigned int cpu)
+{
+    if (cpu >= vcard_cpu_count() || cpu >= sizeof(DWORD_PTR) * 8) {
+        return VCARD_ERROR_INVALID;
+    }
+    return SetThreadAffinityMask(thread->handle, (DWORD_PTR)1 << cpu) ?
+           VCARD_SUCCESS : VCARD_ERROR_IO;
+}
+
+unsigned int vcard_cpu_count(void)
+{
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
+void vcard_sleep_us(uint32_t usec)
+{
+    Sleep((usec + 999) / 1000);
+}
+
+uint64_t vcard_time_ns(void)
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+}
+
+#else
+
+void vcard_mutex_init(vcard_mutex_t *mutex)
+{
+    pthread_mutex_init(mutex, NULL);
+}
+
+void vcard_mutex_destroy(vcard_mutex_t *mutex)
+{
+    pthread_mutex_destroy(mutex);
+}
+
+void vcard_mutex_lock(vcard_mutex_t *mutex)
+{
+    pthread_mutex_lock(mutex);
+}
+
+void vcard_mutex_unlock(vcard_mutex_t *mutex)
+{
+    pthread_mutex_unlock(mutex);
+}
+
+void vcard_cond_init(vcard_cond_t *cond)
+{
+    pthread_cond_init(cond, NULL);
+}
+
+void vcard_cond_destroy(vcard_cond_t *cond)
+{
+    pthread_cond_destroy(cond);
+}
+
+void vcard_cond_wait(vcard_cond_t *cond, vcard_mutex_t *mutex)
+{
+    pthread_cond_wait(cond, mutex);
+}
+
+void vcard_cond_signal(vcard_cond_t *cond)
+{
+    pthread_cond_signal(cond);
+}
+
+void vcard_cond_broadcast(vcard_cond_t *cond)
+{
+    pthread_cond_broadcast(cond);
+}
+
+static void *thread_trampoline(void *param)
+{
+    vcard_thread_t *thread = (vcard_thread_t *)param;
+    thread->fn(thread->arg);
+    run_exit_hook();
+    return NULL;
+}
+
+int vcard_thread_create(vcard_thread_t *thread, void (*fn)(void *arg), void *arg)
+{
+    thread->fn = fn;
+    thread->arg = arg;
+    if (pthread_create(&thread->handle, NULL, thread_trampoline, thread) != 0) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    return VCARD_SUCCESS;
+}
+
+int vcard_thread_join(vcard_thread_t *thread)
+{
+    return pthread_join(thread->handle, NULL) == 0 ? VCARD_SUCCESS : VCARD_ERROR_IO;
+}
+
+int vcard_thread_set_affinity(vcard_thread_t *thread, unsigned int cpu)
+{
+    if (cpu >= vcard_cpu_count()) {
+        return VCARD_ERROR_INVALID;
+    }
+#if defined(__linux__)
+    {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(thread->handle, sizeof(set), &set) == 0 ?
+               VCARD_SUCCESS : VCARD_ERROR_IO;
+    }
+#elif defined(__APPLE__)
+    {
+        // Tag 0 means "no affinity", so CPU n uses tag n + 1
+        thread_affinity_policy_data_t policy = { (integer_t)cpu + 1 };
+
+        return thread_policy_set(pthread_mach_thread_np(thread->handle),
+                                 THREAD_AFFINITY_POLICY, (thread_policy_t)&policy,
+                                 THREAD_AFFINITY_POLICY_COUNT) == KERN_SUCCESS ?
+               VCARD_SUCCESS : VCARD_ERROR_IO;
+    }
+#else
+    (void)thread;
+    return VCARD_ERROR_IO;
+#endif
+}
+
+unsigned int vcard_cpu_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned int)count : 1;
+}
+
+void vcard_sleep_us(uint32_t usec)
+{
+    struct timespec ts;
+    ts.tv_sec = usec / 1000000;
+    ts.tv_nsec = (long)(usec % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) != 0) {
+        /* Interrupted by a signal: sleep for the remainder */
+    }
+}
+
+uint64_t vcard_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,190 @@
+/**
+ * Virtual Sound Card - Portable Threads
+ *
+ * Thin wrappers over pthreads and Win32 threads used by the common library
+ * for control-plane locking, helper threads and monotonic timing. None of
+ * these functions are used on the real-time audio path except
+ * vcard_time_ns().
+ */
+
+#ifndef VCARD_THREAD_H
+#define VCARD_THREAD_H
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef _WIN32
+typedef SRWLOCK vcard_mutex_t;
+typedef CONDITION_VARIABLE vcard_cond_t;
+#define VCARD_MUTEX_INITIALIZER SRWLOCK_INIT
+#else
+typedef pthread_mutex_t vcard_mutex_t;
+typedef pthread_cond_t vcard_cond_t;
+#define VCARD_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#endif
+
+/**
+ * Thread handle
+ *
+ * The structure must stay valid until vcard_thread_join() returns.
+ */
+typedef struct {
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    void (*fn)(void *arg);
+    void *arg;
+} vcard_thread_t;
+
+/**
+ * Initialize a mutex (alternative to VCARD_MUTEX_INITIALIZER)
+ *
+ * @param mutex Mutex to initialize
+ */
+void vcard_mutex_init(vcard_mutex_t *mutex);
+
+/**
+ * Destroy a mutex
+ *
+ * @param mutex Mutex to destroy
+ */
+void vcard_mutex_destroy(vcard_mutex_t *mutex);
+
+/**
+ * Lock a mutex
+ *
+ * @param mutex Mutex to lock
+ */
+void vcard_mutex_lock(vcard_mutex_t *mutex);
+
+/**
+ * Unlock a mutex
+ *
+ * @param mutex Mutex to unlock
+ */
+void vcard_mutex_unlock(vcard_mutex_t *mutex);
+
+/**
+ * Initialize a condition variable
+ *
+ * @param cond Condition variable to initialize
+ */
+void vcard_cond_init(vcard_cond_t *cond);
+
+/**
+ * Destroy a condition variable
+ *
+ * @param cond Condition variable to destroy
+ */
+void vcard_cond_destroy(vcard_cond_t *cond);
+
+/**
+ * Atomically unlock a mutex and wait for the condition to be signalled
+ *
+ * May wake spuriously; callers re-check their predicate in a loop.
+ *
+ * @param cond Condition variable
+ * @param mutex Mutex held by the caller, held again on return
+ */
+void vcard_cond_wait(vcard_cond_t *cond, vcard_mutex_t *mutex);
+
+/**
+ * Wake one waiter
+ *
+ * @param cond Condition variable
+ */
+void vcard_cond_signal(vcard_cond_t *cond);
+
+/**
+ * Wake all waiters
+ *
+ * @param cond Condition variable
+ */
+void vcard_cond_broadcast(vcard_cond_t *cond);
+
+/**
+ * Start a thread
+ *
+ * @param thread Thread handle to fill
+ * @param fn Thread entry point
+ * @param arg Argument passed to fn
+ * @return 0 on success, VCARD_ERROR_* on failure
+ */
+int vcard_thread_create(vcard_thread_t *thread, void (*fn)(void *arg), void *arg);
+
+/**
+ * Code run by every vcard_thread_create() thread as its function returns
+ */
+typedef struct {
+    void (*fn)(void);
+} vcard_thread_exit_hook_t;
+
+/**
+ * Install the exit hook (one per process, replacing any earlier one)
+ *
+ * Lets a layer such as the trace release per-thread state without
+ * vcard_thread depending on it; until a hook is installed, exiting costs
+ * one load.
+ *
+ * @param hook Hook with static storage, or NULL to remove it
+ */
+void vcard_thread_set_exit_hook(const vcard_thread_exit_hook_t *hook);
+
+/**
+ * Wait for a thread to finish
+ *
+ * @param thread Thread handle
+ * @return 0 on success, VCARD_ERROR_* on failure
+ */
+int vcard_thread_join(vcard_thread_t *thread);
+
+/**
+ * Pin a running thread to one CPU
+ *
+ * On macOS, which has no hard CPU binding, this sets an affinity tag so
+ * threads with different CPUs are scheduled on different cores.
+ *
+ * @param thread Thread handle
+ * @param cpu CPU index (0 to vcard_cpu_count() - 1)
+ * @return 0 on success, VCARD_ERROR_INVALID if the CPU does not exist,
+ *         VCARD_ERROR_IO if the system refused
+ */
+int vcard_thread_set_affinity(vcard_thread_t *thread, unsigned int cpu);
+
+/**
+ * Number of online CPUs
+ *
+ * @return CPU count (at least 1)
+ */
+unsigned int vcard_cpu_count(void);
+
+/**
+ * Sleep for at least the given number of microseconds
+ *
+ * @param usec Microseconds to sleep
+ */
+void vcard_sleep_us(uint32_t usec);
+
+/**
+ * Read the monotonic clock
+ *
+ * @return Monotonic time in nanoseconds
+ */
+uint64_t vcard_time_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VCARD_THREAD_H */
@@ -0,0 +1,294 @@
+/**
+ * Virtual Sound Card - Period Trace Implementation
+ */
+
+#include "vcard_trace.h"
+#include "vcard.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define VCARD_THREAD_LOCAL __declspec(thread)
+#else
+#define VCARD_THREAD_LOCAL _Thread_local
+#endif
+
+typedef struct {
+    const char *name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint32_t requested;
+    uint32_t rendered;
+    uint32_t fill;
+} trace_event_t;
+
+/**
+ * One recording thread's ring; the owning thread writes, the dumper reads
+ *
+ * A ring outlives its thread: vcard_trace_thread_exit() hands it back and
+ * the next thread to record claims it, appending after whatever the
+ * dumper has not written yet.
+ */
+typedef struct {
+    vcard_atomic_u32 write_index;
+    uint32_t cached_read_index;
+    uint32_t generation;                 /* Trace the owner was last counted in */
+    char pad0[VCARD_CACHELINE - 3 * sizeof(uint32_t)];
+    vcard_atomic_u32 read_index;
+    vcard_atomic_u32 dropped;
+    vcard_atomic_u32 owned;              /* A live thread records into it */
+    vcard_atomic_u32 used;               /* Ever claimed, so worth draining */
+    char pad1[VCARD_CACHELINE - 4 * sizeof(uint32_t)];
+    trace_event_t events[VCARD_TRACE_EVENTS];
+} trace_ring_t;
+
+vcard_atomic_u32 vcard_trace_active;
+
+/* Rings are static so a thread still inside a trace point never sees one freed */
+static trace_ring_t rings[VCARD_TRACE_MAX_THREADS];
+static vcard_atomic_u32 overflow_dropped;    /* Events from threads beyond the limit */
+static vcard_atomic_u32 trace_generation;    /* Bumped by each start, never 0 once started */
+static vcard_atomic_u32 trace_threads;       /* Threads that recorded in this trace */
+static VCARD_THREAD_LOCAL int thread_ring = -1;
+
+/* Hands rings back as vcard_thread threads end, once anything recorded */
+static const vcard_thread_exit_hook_t trace_exit_hook = { vcard_trace_thread_exit };
+
+/* Dumper state, owned by the starting thread and the dumper */
+static vcard_mutex_t trace_lock = VCARD_MUTEX_INITIALIZER;
+static vcard_mutex_t drain_lock = VCARD_MUTEX_INITIALIZER; /* Guards trace_file writes */
+static FILE *trace_file;
+static vcard_thread_t dumper;
+static vcard_atomic_u32 dumper_stop;
+static uint64_t trace_origin_ns;
+static uint64_t trace_events;
+static int trace_running;
+
+uint64_t vcard_trace_begin(void)
+{
+    return vcard_atomic_load_relaxed_u32(&vcard_trace_active) ? vcard_time_ns() : 0;
+}
+
+void vcard_trace_record(const char *name, uint64_t start_ns, uint32_t requested,
+                        uint32_t rendered, uint32_t fill)
+{
+    trace_ring_t *ring;
+    trace_event_t *e;
+    uint32_t w, generation;
+
+    if (!start_ns) {
+        return;
+    }
+    if (thread_ring < 0) {
+        // First event from this thread: claim a free ring until the thread exits
+        vcard_thread_set_exit_hook(&trace_exit_hook);
+        for (int t = 0; t < VCARD_TRACE_MAX_THREADS; t++) {
+            if (!vcard_atomic_load_relaxed_u32(&rings[t].owned) &&
+                vcard_atomic_exchange_u32(&rings[t].owned, 1) == 0) {
+                vcard_atomic_store_release_u32(&rings[t].used, 1);
+                rings[t].generation = 0;
+                thread_ring = t;
+                break;
+            }
+        }
+        if (thread_ring < 0) {
+            // All in use; retried on the next event in case one is released
+            vcard_atomic_fetch_add_u32(&overflow_dropped, 1);
+            return;
+        }
+    }
+
+    ring = &rings[thread_ring];
+    generation = vcard_atomic_load_relaxed_u32(&trace_generation);
+    if (ring->generation != generation) {
+        ring->generation = generation;
+        vcard_atomic_fetch_add_u32(&trace_threads, 1);
+    }
+    w = vcard_atomic_load_relaxed_u32(&ring->write_index);
+    if (w - ring->cached_read_index >= VCARD_TRACE_EVENTS) {
+        ring->cached_read_index = vcard_atomic_load_acquire_u32(&ring->read_index);
+        if (w - ring->cached_read_index >= VCARD_TRACE_EVENTS) {
+            vcard_atomic_fetch_add_u32(&ring->dropped, 1);
+            return;
+        }
+    }
+    e = &ring->events[w & (VCARD_TRACE_EVENTS - 1)];
+    e->name = name;
+    e->start_ns = start_ns;
+    e->end_ns = vcard_time_ns();
+    e->requested = requested;
+    e->rendered = rendered;
+    e->fill = fill;
+    vcard_atomic_store_release_u32(&ring->write_index, w + 1);
+}
+
+void vcard_trace_thread_exit(void)
+{
+    if (thread_ring >= 0) {
+        // Events still queued stay for the dumper; the next owner appends
+        vcard_atomic_store_release_u32(&rings[thread_ring].owned, 0);
+        thread_ring = -1;
+    }
+}
+
+/**
+ * Write every queued event to the file (caller holds drain_lock)
+ */
+static void drain(void)
+{
+    if (!trace_file) {
+        return;
+    }
+    for (uint32_t t = 0; t < VCARD_TRACE_MAX_THREADS; t++) {
+        trace_ring_t *ring = &rings[t];
+        uint32_t r, w;
+
+        if (!vcard_atomic_load_acquire_u32(&ring->used)) {
+            continue;
+        }
+        r = vcard_atomic_load_relaxed_u32(&ring->read_index);
+        w = vcard_atomic_load_acquire_u32(&ring->write_index);
+
+        for (; r != w; r++) {
+            const trace_event_t *e = &ring->events[r & (VCARD_TRACE_EVENTS - 1)];
+            double ts = (double)(int64_t)(e->start_ns - trace_origin_ns) / 1000.0;
+
+            // A complete event for the period and a counter track for the fill
+            fprintf(trace_file,
+                    ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"args\":{\"requested\":%u,\"rendered\":%u,\"fill\":%u}}"
+                    ",\n{\"name\":\"%s.fill\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"args\":{\"frames\":%u}}",
+                    e->name, t + 1, ts, (double)(e->end_ns - e->start_ns) / 1000.0,
+                    e->requested, e->rendered, e->fill,
+                    e->name, t + 1, (double)(int64_t)(e->end_ns - trace_origin_ns) / 1000.0,
+                    e->fill);
+            trace_events++;
+        }
+        vcard_atomic_store_release_u32(&ring->read_index, r);
+    }
+}
+
+static void dumper_main(void *arg)
+{
+    (void)arg;
+
+    while (!vcard_atomic_load_acquire_u32(&dumper_stop)) {
+        vcard_trace_flush();
+        vcard_sleep_us(VCARD_TRACE_DRAIN_MS * 1000);
+    }
+}
+
+void vcard_trace_flush(void)
+{
+    vcard_mutex_lock(&drain_lock);
+    drain();
+    vcard_mutex_unlock(&drain_lock);
+}
+
+int vcard_trace_start(const char *path)
+{
+    FILE *file;
+    uint32_t generation;
+
+    if (!path) {
+        return VCARD_ERROR_INVALID;
+    }
+    vcard_mutex_lock(&trace_lock);
+    if (trace_running) {
+        vcard_mutex_unlock(&trace_lock);
+        return VCARD_ERROR_IN_USE;
+    }
+    file = fopen(path, "w");
+    if (!file) {
+        vcard_mutex_unlock(&trace_lock);
+        return VCARD_ERROR_IO;
+    }
+
+    // Skip whatever was left from a previous trace
+    for (uint32_t t = 0; t < VCARD_TRACE_MAX_THREADS; t++) {
+        vcard_atomic_store_release_u32(&rings[t].read_index,
+                                       vcard_atomic_load_acquire_u32(&rings[t].write_index));
+        vcard_atomic_store_relaxed_u32(&rings[t].dropped, 0);
+    }
+    vcard_atomic_store_relaxed_u32(&overflow_dropped, 0);
+    vcard_atomic_store_relaxed_u32(&trace_threads, 0);
+    generation = vcard_atomic_load_relaxed_u32(&trace_generation) + 1;
+    vcard_atomic_store_relaxed_u32(&trace_generation, generation ? generation : 1);
+    trace_origin_ns = vcard_time_ns();
+    trace_events = 0;
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                  "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                  "\"args\":{\"name\":\"vcard\"}}");
+    vcard_mutex_lock(&drain_lock);
+    trace_file = file;
+    vcard_mutex_unlock(&drain_lock);
+
+    vcard_atomic_store_relaxed_u32(&dumper_stop, 0);
+    if (vcard_thread_create(&dumper, dumper_main, NULL) != 0) {
+        vcard_mutex_lock(&drain_lock);
+        trace_file = NULL;
+        vcard_mutex_unlock(&drain_lock);
+        fclose(file);
+        vcard_mutex_unlock(&trace_lock);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    trace_running = 1;
+    vcard_atomic_store_release_u32(&vcard_trace_active, 1);
+    vcard_mutex_unlock(&trace_lock);
+    return VCARD_SUCCESS;
+}
+
+int vcard_trace_start_from_env(void)
+{
+    const char *path = getenv("VCARD_TRACE_FILE");
+
+    if (!path || !path[0]) {
+        return VCARD_SUCCESS;
+    }
+    return vcard_trace_start(path);
+}
+
+void vcard_trace_stop(vcard_trace_stats_t *stats)
+{
+    uint64_t dropped;
+
+    vcard_mutex_lock(&trace_lock);
+    if (!trace_running) {
+        vcard_mutex_unlock(&trace_lock);
+        if (stats) memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    vcard_atomic_store_release_u32(&vcard_trace_active, 0);
+    vcard_atomic_store_release_u32(&dumper_stop, 1);
+    vcard_thread_join(&dumper);
+
+    // Events from periods that began before the flag cleared
+    vcard_mutex_lock(&drain_lock);
+    drain();
+    dropped = vcard_atomic_load_relaxed_u32(&overflow_dropped);
+    for (uint32_t t = 0; t < VCARD_TRACE_MAX_THREADS; t++) {
+        if (!vcard_atomic_load_acquire_u32(&rings[t].used)) {
+            continue;
+        }
+        // A tid is a ring, shared by the threads that held it in turn
+        fprintf(trace_file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                            "\"args\":{\"name\":\"vcard thread %u\"}}", t + 1, t + 1);
+        dropped += vcard_atomic_load_relaxed_u32(&rings[t].dropped);
+    }
+    fprintf(trace_file, "\n]}\n");
+    fclose(trace_file);
+    trace_file = NULL;
+    vcard_mutex_unlock(&drain_lock);
+    trace_running = 0;
+
+    if (stats) {
+        stats->events = trace_events;
+        stats->dropped = dropped;
+        stats->threads = vcard_atomic_load_relaxed_u32(&trace_threads);
+    }
+    vcard_mutex_unlock(&trace_lock);
+}
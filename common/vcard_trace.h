@@ -0,0 +1,133 @@
+/**
+ * Virtual Sound Card - Period Trace
+ *
+ * Trace points around each backend period record its start and end time,
+ * the frames asked for and rendered, and the buffer fill, to answer why a
+ * given period ran late. Each recording thread writes into its own
+ * lock-free ring; a dumper thread drains the rings into a Chrome trace
+ * JSON file that chrome://tracing and ui.perfetto.dev open directly.
+ * A thread holds its ring until it exits: threads started with
+ * vcard_thread_create() hand it back through the exit hook the trace
+ * installs on its first event, others call
+ * vcard_trace_thread_exit() before they end, so at most
+ * VCARD_TRACE_MAX_THREADS need to be recording at the same time.
+ *
+ * The trace points are macros. Without VCARD_TRACE defined (the CMake
+ * option of the same name) they compile to nothing. With it, a period
+ * costs two clock reads and a ring store while a trace is being written,
+ * and one relaxed load when none is. Set VCARD_TRACE_FILE in the
+ * environment to have the backend programs write one:
+ *
+ *     VCARD_TRACE_BEGIN(t);
+ *     render(...);
+ *     VCARD_TRACE_END(t, "alsa.writei", frames, written, delay);
+ */
+
+#ifndef VCARD_TRACE_H
+#define VCARD_TRACE_H
+
+#include <stdint.h>
+#include "vcard_atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VCARD_TRACE_MAX_THREADS 16           /* Threads recording at the same time */
+#define VCARD_TRACE_EVENTS 4096              /* Ring slots per thread */
+#define VCARD_TRACE_DRAIN_MS 20              /* Dumper period */
+
+/**
+ * Totals for a finished trace
+ */
+typedef struct {
+    uint64_t events;          /* Events written to the file */
+    uint64_t dropped;         /* Events lost to a full ring or too many threads */
+    uint32_t threads;         /* Ring owners that recorded (each thread once) */
+} vcard_trace_stats_t;
+
+/* Non-zero while a trace file is open (read by the trace points) */
+extern vcard_atomic_u32 vcard_trace_active;
+
+/**
+ * Start writing a trace file
+ *
+ * @param path Output file (Chrome trace JSON)
+ * @return 0 on success, VCARD_ERROR_IN_USE if a trace is running,
+ *         VCARD_ERROR_IO if the file cannot be created
+ */
+int vcard_trace_start(const char *path);
+
+/**
+ * Start a trace if VCARD_TRACE_FILE is set in the environment
+ *
+ * @return 0 on success or when the variable is unset, VCARD_ERROR_* on failure
+ */
+int vcard_trace_start_from_env(void);
+
+/**
+ * Stop the dumper, write the remaining events and close the file
+ *
+ * @param stats Output parameter for totals (may be NULL)
+ */
+void vcard_trace_stop(vcard_trace_stats_t *stats);
+
+/**
+ * Record one period (any thread; lock-free, no allocation)
+ *
+ * Called by VCARD_TRACE_END; the end time is taken here.
+ *
+ * @param name Trace point name; must be a string that outlives the trace
+ * @param start_ns vcard_time_ns() at the start of the period, 0 to skip
+ * @param requested Frames asked for
+ * @param rendered Frames produced
+ * @param fill Frames queued in the device after the period
+ */
+void vcard_trace_record(const char *name, uint64_t start_ns, uint32_t requested,
+                        uint32_t rendered, uint32_t fill);
+
+/**
+ * Start time for a trace point, or 0 when no trace is running
+ */
+uint64_t vcard_trace_begin(void);
+
+/**
+ * Write the events queued so far without waiting for the dumper
+ *
+ * Does nothing when no trace is running.
+ */
+void vcard_trace_flush(void);
+
+/**
+ * Hand the calling thread's ring back for another thread to use
+ *
+ * Called on exit by threads started with vcard_thread_create(); threads
+ * created any other way that record should call it before they end.
+ * Events already recorded are still written. Does nothing if the thread
+ * never recorded.
+ */
+void vcard_trace_thread_exit(void);
+
+#if defined(VCARD_TRACE) && VCARD_TRACE
+#define VCARD_TRACE_BEGIN(scope) uint64_t scope = vcard_trace_begin()
+#define VCARD_TRACE_END(scope, name, requested, rendered, fill) \
+    do { \
+        if (scope) { \
+            vcard_trace_record((name), (scope), (uint32_t)(requested), \
+                               (uint32_t)(rendered), (uint32_t)(fill)); \
+        } \
+    } while (0)
+#define VCARD_TRACE_START_FROM_ENV() vcard_trace_start_from_env()
+#define VCARD_TRACE_STOP() vcard_trace_stop(NULL)
+#else
+#define VCARD_TRACE_BEGIN(scope) ((void)0)
+#define VCARD_TRACE_END(scope, name, requested, rendered, fill) ((void)0)
+#define VCARD_TRACE_START_FROM_ENV() ((void)0)
+#define VCARD_TRACE_STOP() ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VCARD_TRACE_H */
@@ -0,0 +1,743 @@
+/**
+ * Virtual Sound Card - Streaming WAV/RF64/W64 Files Implementation
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64             /* 64-bit fseeko/ftello on 32-bit hosts */
+#endif
+
+#include "wav_file.h"
+#include "vcard.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <sys/mman.h>
+#endif
+
+/* stdio buffer of writers and unmapped readers */
+#define WAV_IO_BUFFER (256 * 1024)
+
+#define WAV_TAG_PCM 0x0001
+#define WAV_TAG_FLOAT 0x0003
+#define WAV_TAG_EXTENSIBLE 0xFFFE
+
+#define WAV_FMT_BYTES 16
+#define WAV_FMT_EXTENSIBLE_BYTES 40
+#define WAV_DS64_BYTES 28                /* Sizes, sample count, empty table */
+#define WAV_MAX_HEADER 128
+
+/* Data size placeholder until the writer is closed: "to the end of the file" */
+#define WAV_SIZE_UNKNOWN UINT64_MAX
+
+static const uint8_t W64_GUID_RIFF[16] = {
+    0x72, 0x69, 0x66, 0x66, 0x2E, 0x91, 0xCF, 0x11,
+    0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00
+};
+static const uint8_t W64_GUID_WAVE[16] = {
+    0x77, 0x61, 0x76, 0x65, 0xF3, 0xAC, 0xD3, 0x11,
+    0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A
+};
+static const uint8_t W64_GUID_FMT[16] = {
+    0x66, 0x6D, 0x74, 0x20, 0xF3, 0xAC, 0xD3, 0x11,
+    0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A
+};
+static const uint8_t W64_GUID_DATA[16] = {
+    0x64, 0x61, 0x74, 0x61, 0xF3, 0xAC, 0xD3, 0x11,
+    0x8C, 0xD1, 0x00, 0xC0, 0x4F, 0x8E, 0xDB, 0x8A
+};
+
+/* KSDATAFORMAT_SUBTYPE_PCM/IEEE_FLOAT after the leading format tag */
+static const uint8_t WAV_SUBTYPE_TAIL[14] = {
+    0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00,
+    0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+};
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    put_le16(p, (uint16_t)v);
+    put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void put_le64(uint8_t *p, uint64_t v)
+{
+    put_le32(p, (uint32_t)v);
+    put_le32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+static uint64_t get_le64(const uint8_t *p)
+{
+    return (uint64_t)get_le32(p) | ((uint64_t)get_le32(p + 4) << 32);
+}
+
+static int file_seek(FILE *fp, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(fp, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(fp, (off_t)offset, SEEK_SET);
+#endif
+}
+
+static uint64_t file_size(FILE *fp)
+{
+#ifdef _WIN32
+    if (_fseeki64(fp, 0, SEEK_END) != 0) {
+        return 0;
+    }
+    return (uint64_t)_ftelli64(fp);
+#else
+    if (fseeko(fp, 0, SEEK_END) != 0) {
+        return 0;
+    }
+    return (uint64_t)ftello(fp);
+#endif
+}
+
+static uint32_t format_bits(sine_format_t format)
+{
+    return (uint32_t)sine_format_bytes(format) * 8;
+}
+
+/**
+ * Convert n floats (src_stride apart) to samples (dst_stride samples apart)
+ */
+static void float_to_samples(const float *src, size_t src_stride, size_t n,
+                             uint8_t *dst, size_t dst_stride, sine_format_t format)
+{
+    size_t step = dst_stride * sine_format_bytes(format);
+
+    switch (format) {
+    case SINE_FORMAT_F32:
+        for (size_t i = 0; i < n; i++, dst += step) {
+            memcpy(dst, &src[i * src_stride], sizeof(float));
+        }
+        break;
+    case SINE_FORMAT_I16:
+        for (size_t i = 0; i < n; i++, dst += step) {
+            float v = src[i * src_stride];
+            int16_t s = (int16_t)((v > 1.0f ? 1.0f : (v < -1.0f ? -1.0f : v)) * 32767.0f);
+            memcpy(dst, &s, sizeof(s));
+        }
+        break;
+    case SINE_FORMAT_I24:
+        for (size_t i = 0; i < n; i++, dst += step) {
+            float v = src[i * src_stride];
+            uint32_t s = (uint32_t)(int32_t)((v > 1.0f ? 1.0f : (v < -1.0f ? -1.0f : v)) *
+                                             8388607.0);
+            dst[0] = (uint8_t)s;
+            dst[1] = (uint8_t)(s >> 8);
+            dst[2] = (uint8_t)(s >> 16);
+        }
+        break;
+    case SINE_FORMAT_I32:
+        for (size_t i = 0; i < n; i++, dst += step) {
+            float v = src[i * src_stride];
+            int32_t s = (int32_t)((v > 1.0f ? 1.0f : (v < -1.0f ? -1.0f : v)) *
+                                  2147483647.0);
+            memcpy(dst, &s, sizeof(s));
+        }
+        break;
+    case SINE_FORMAT_I24_32:             // Rejected by wav_writer_open()
+        break;
+    }
+}
+
+/* Writer */
+
+/**
+ * Encode a fmt chunk body
+ *
+ * @return Body size (WAV_FMT_BYTES or WAV_FMT_EXTENSIBLE_BYTES)
+ */
+static uint32_t build_fmt(const wav_writer_t *w, uint8_t *p)
+{
+    uint32_t bits = format_bits(w->format);
+    uint16_t tag = w->format == SINE_FORMAT_F32 ? WAV_TAG_FLOAT : WAV_TAG_PCM;
+    int extensible = w->channels > 2 || bits > 16;
+
+    put_le16(p, extensible ? WAV_TAG_EXTENSIBLE : tag);
+    put_le16(p + 2, (uint16_t)w->channels);
+    put_le32(p + 4, w->sample_rate);
+    put_le32(p + 8, w->sample_rate * w->frame_bytes);
+    put_le16(p + 12, (uint16_t)w->frame_bytes);
+    put_le16(p + 14, (uint16_t)bits);
+    if (!extensible) {
+        return WAV_FMT_BYTES;
+    }
+
+    put_le16(p + 16, 22);                        // cbSize
+    put_le16(p + 18, (uint16_t)bits);            // Valid bits per sample
+    put_le32(p + 20, w->channels == 1 ? 0x4 : (w->channels == 2 ? 0x3 : 0));
+    put_le16(p + 24, tag);
+    memcpy(p + 26, WAV_SUBTYPE_TAIL, sizeof(WAV_SUBTYPE_TAIL));
+    return WAV_FMT_EXTENSIBLE_BYTES;
+}
+
+/**
+ * Encode the whole header for the current data size
+ *
+ * The header has the same length whatever the sizes, so the final one
+ * overwrites the provisional one in place.
+ *
+ * @param final Zero for the provisional header written at open
+ * @return Header size in bytes
+ */
+static size_t build_header(const wav_writer_t *w, uint8_t *h, int final)
+{
+    uint8_t fmt[WAV_FMT_EXTENSIBLE_BYTES];
+    uint32_t fmt_bytes = build_fmt(w, fmt);
+    uint64_t data = final ? w->data_bytes : WAV_SIZE_UNKNOWN;
+    uint64_t frames = final ? w->data_bytes / w->frame_bytes : 0;
+    size_t pos = 0;
+
+    if (w->container == WAV_CONTAINER_W64) {
+        uint64_t total = 40 + 24 + (uint64_t)fmt_bytes + 24 + ((w->data_bytes + 7) & ~7ull);
+
+        memcpy(h, W64_GUID_RIFF, 16);
+        put_le64(h + 16, final ? total : WAV_SIZE_UNKNOWN);
+        memcpy(h + 24, W64_GUID_WAVE, 16);
+        memcpy(h + 40, W64_GUID_FMT, 16);
+        put_le64(h + 56, 24 + (uint64_t)fmt_bytes);
+        memcpy(h + 64, fmt, fmt_bytes);
+        pos = 64 + fmt_bytes;
+        memcpy(h + pos, W64_GUID_DATA, 16);
+        put_le64(h + pos + 16, final ? 24 + data : WAV_SIZE_UNKNOWN);
+        return pos + 24;
+    } else {
+        uint64_t riff = 4 + 8 + WAV_DS64_BYTES + 8 + (uint64_t)fmt_bytes + 8 +
+                        w->data_bytes + (w->data_bytes & 1);
+        int rf64 = w->container == WAV_CONTAINER_RF64 ||
+                   (final && riff > UINT32_MAX) || (final && data > UINT32_MAX);
+
+        memcpy(h, rf64 ? "RF64" : "RIFF", 4);
+        put_le32(h + 4, rf64 || !final ? UINT32_MAX : (uint32_t)riff);
+        memcpy(h + 8, "WAVE", 4);
+        if (rf64) {
+            memcpy(h + 12, "ds64", 4);
+            put_le32(h + 16, WAV_DS64_BYTES);
+            put_le64(h + 20, final ? riff : WAV_SIZE_UNKNOWN);
+            put_le64(h + 28, data);
+            put_le64(h + 36, frames);
+            put_le32(h + 44, 0);
+        } else {
+            // Reserved for ds64 should the file outgrow RIFF
+            memcpy(h + 12, "JUNK", 4);
+            put_le32(h + 16, WAV_DS64_BYTES);
+            memset(h + 20, 0, WAV_DS64_BYTES);
+        }
+        memcpy(h + 48, "fmt ", 4);
+        put_le32(h + 52, fmt_bytes);
+        memcpy(h + 56, fmt, fmt_bytes);
+        pos = 56 + fmt_bytes;
+        memcpy(h + pos, "data", 4);
+        put_le32(h + pos + 4, rf64 || !final ? UINT32_MAX : (uint32_t)data);
+        return pos + 8;
+    }
+}
+
+int wav_writer_open(wav_writer_t *w, const char *path, uint32_t channels,
+                    uint32_t sample_rate, sine_format_t format,
+                    wav_container_t container)
+{
+    uint8_t header[WAV_MAX_HEADER];
+    size_t header_bytes;
+
+    memset(w, 0, sizeof(*w));
+    if (!path || channels == 0 || channels > WAV_MAX_CHANNELS || sample_rate == 0 ||
+        sine_format_bytes(format) == 0 || format == SINE_FORMAT_I24_32 ||
+        container < WAV_CONTAINER_AUTO || container > WAV_CONTAINER_W64) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    w->container = container;
+    w->format = format;
+    w->channels = channels;
+    w->sample_rate = sample_rate;
+    w->frame_bytes = channels * (uint32_t)sine_format_bytes(format);
+    w->scratch = (uint8_t *)malloc((size_t)WAV_CHUNK_FRAMES * w->frame_bytes);
+    if (!w->scratch) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+
+    w->fp = fopen(path, "wb");
+    if (!w->fp) {
+        free(w->scratch);
+        w->scratch = NULL;
+        return VCARD_ERROR_IO;
+    }
+    setvbuf(w->fp, NULL, _IOFBF, WAV_IO_BUFFER);
+
+    header_bytes = build_header(w, header, 0);
+    if (fwrite(header, 1, header_bytes, w->fp) != header_bytes) {
+        wav_writer_close(w);
+        return VCARD_ERROR_IO;
+    }
+    return VCARD_SUCCESS;
+}
+
+int wav_writer_write(wav_writer_t *w, const void *frames, size_t num_frames)
+{
+    if (w->error) {
+        return w->error;
+    }
+    if (num_frames == 0) {
+        return VCARD_SUCCESS;
+    }
+    if (fwrite(frames, w->frame_bytes, num_frames, w->fp) != num_frames) {
+        w->error = VCARD_ERROR_IO;
+        return w->error;
+    }
+    w->data_bytes += (uint64_t)num_frames * w->frame_bytes;
+    return VCARD_SUCCESS;
+}
+
+int wav_writer_write_float(wav_writer_t *w, const float *frames, size_t num_frames)
+{
+    size_t done = 0;
+
+    while (done < num_frames && !w->error) {
+        size_t n = num_frames - done < WAV_CHUNK_FRAMES ? num_frames - done :
+                                                          WAV_CHUNK_FRAMES;
+
+        float_to_samples(frames + done * w->channels, 1, n * w->channels,
+                         w->scratch, 1, w->format);
+        wav_writer_write(w, w->scratch, n);
+        done += n;
+    }
+    return w->error;
+}
+
+int wav_writer_write_planar(wav_writer_t *w, const float *const *planes,
+                            size_t num_frames)
+{
+    size_t bytes = sine_format_bytes(w->format);
+    size_t done = 0;
+
+    while (done < num_frames && !w->error) {
+        size_t n = num_frames - done < WAV_CHUNK_FRAMES ? num_frames - done :
+                                                          WAV_CHUNK_FRAMES;
+
+        for (uint32_t ch = 0; ch < w->channels; ch++) {
+            uint8_t *dst = w->scratch + ch * bytes;
+
+            if (planes[ch]) {
+                float_to_samples(planes[ch] + done, 1, n, dst, w->channels, w->format);
+            } else {
+                for (size_t i = 0; i < n; i++) {
+                    memset(dst + i * w->frame_bytes, 0, bytes);
+                }
+            }
+        }
+        wav_writer_write(w, w->scratch, n);
+        done += n;
+    }
+    return w->error;
+}
+
+int wav_writer_close(wav_writer_t *w)
+{
+    int result;
+
+    if (!w->fp) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    if (!w->error) {
+        static const uint8_t zeros[8] = { 0 };
+        uint8_t header[WAV_MAX_HEADER];
+        size_t header_bytes = build_header(w, header, 1);
+        size_t pad = w->container == WAV_CONTAINER_W64 ?
+                     (size_t)((8 - (w->data_bytes & 7)) & 7) : (size_t)(w->data_bytes & 1);
+
+        // Chunks end on an even (RIFF) or 8-byte (W64) boundary
+        if (fwrite(zeros, 1, pad, w->fp) != pad ||
+            file_seek(w->fp, 0) != 0 ||
+            fwrite(header, 1, header_bytes, w->fp) != header_bytes) {
+            w->error = VCARD_ERROR_IO;
+        }
+    }
+    if (fclose(w->fp) != 0) {
+        w->error = VCARD_ERROR_IO;
+    }
+
+    result = w->error;
+    free(w->scratch);
+    memset(w, 0, sizeof(*w));
+    return result;
+}
+
+/* Reader */
+
+static int parse_fmt(wav_reader_t *r, const uint8_t *p, uint32_t bytes)
+{
+    uint16_t tag;
+    uint32_t bits;
+
+    if (bytes < WAV_FMT_BYTES) {
+        return VCARD_ERROR_INVALID;
+    }
+    tag = get_le16(p);
+    r->channels = get_le16(p + 2);
+    r->sample_rate = get_le32(p + 4);
+    r->frame_bytes = get_le16(p + 12);
+    bits = get_le16(p + 14);
+    if (tag == WAV_TAG_EXTENSIBLE) {
+        if (bytes < WAV_FMT_EXTENSIBLE_BYTES ||
+            memcmp(p + 26, WAV_SUBTYPE_TAIL, sizeof(WAV_SUBTYPE_TAIL)) != 0) {
+            return VCARD_ERROR_INVALID;
+        }
+        tag = get_le16(p + 24);
+    }
+
+    if (tag == WAV_TAG_FLOAT && bits == 32) {
+        r->format = SINE_FORMAT_F32;
+    } else if (tag == WAV_TAG_PCM && bits == 16) {
+        r->format = SINE_FORMAT_I16;
+    } else if (tag == WAV_TAG_PCM && bits == 24) {
+        r->format = SINE_FORMAT_I24;
+    } else if (tag == WAV_TAG_PCM && bits == 32) {
+        r->format = SINE_FORMAT_I32;
+    } else {
+        return VCARD_ERROR_INVALID;
+    }
+    if (r->channels == 0 || r->channels > WAV_MAX_CHANNELS || r->sample_rate == 0 ||
+        r->frame_bytes != r->channels * sine_format_bytes(r->format)) {
+        return VCARD_ERROR_INVALID;
+    }
+    return VCARD_SUCCESS;
+}
+
+/**
+ * Walk the chunks of a RIFF or RF64 file up to the data chunk
+ */
+static int parse_riff(wav_reader_t *r, uint64_t size, uint64_t *data_bytes)
+{
+    uint64_t ds64_data = WAV_SIZE_UNKNOWN;
+    uint64_t pos = 12;
+    int have_fmt = 0;
+
+    while (pos + 8 <= size) {
+        uint8_t chunk[8];
+        uint8_t body[WAV_FMT_EXTENSIBLE_BYTES];
+        uint32_t bytes;
+
+        if (file_seek(r->fp, pos) != 0 || fread(chunk, 1, 8, r->fp) != 8) {
+            return VCARD_ERROR_IO;
+        }
+        bytes = get_le32(chunk + 4);
+
+        if (memcmp(chunk, "ds64", 4) == 0 && bytes >= 24) {
+            if (fread(body, 1, 24, r->fp) != 24) {
+                return VCARD_ERROR_IO;
+            }
+            ds64_data = get_le64(body + 8);
+        } else if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint32_t n = bytes < sizeof(body) ? bytes : (uint32_t)sizeof(body);
+            int result;
+
+            if (fread(body, 1, n, r->fp) != n) {
+                return VCARD_ERROR_IO;
+            }
+            result = parse_fmt(r, body, n);
+            if (result != VCARD_SUCCESS) {
+                return result;
+            }
+            have_fmt = 1;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt) {
+                return VCARD_ERROR_INVALID;
+            }
+            r->data_offset = pos + 8;
+            *data_bytes = bytes == UINT32_MAX ? ds64_data : bytes;
+            return VCARD_SUCCESS;
+        }
+        pos += 8 + (uint64_t)bytes + (bytes & 1);
+    }
+    return VCARD_ERROR_INVALID;
+}
+
+/**
+ * Walk the chunks of a Wave64 file up to the data chunk
+ */
+static int parse_w64(wav_reader_t *r, uint64_t size, uint64_t *data_bytes)
+{
+    uint64_t pos = 40;
+    int have_fmt = 0;
+
+    while (pos + 24 <= size) {
+        uint8_t chunk[24];
+        uint8_t body[WAV_FMT_EXTENSIBLE_BYTES];
+        uint64_t bytes;
+
+        if (file_seek(r->fp, pos) != 0 || fread(chunk, 1, 24, r->fp) != 24) {
+            return VCARD_ERROR_IO;
+        }
+        bytes = get_le64(chunk + 16);         // Includes the 24-byte chunk header
+
+        if (memcmp(chunk, W64_GUID_FMT, 16) == 0) {
+            uint32_t n = bytes - 24 < sizeof(body) ? (uint32_t)(bytes - 24) :
+                                                     (uint32_t)sizeof(body);
+            int result;
+
+            if (bytes < 24 || fread(body, 1, n, r->fp) != n) {
+                return VCARD_ERROR_INVALID;
+            }
+            result = parse_fmt(r, body, n);
+            if (result != VCARD_SUCCESS) {
+                return result;
+            }
+            have_fmt = 1;
+        } else if (memcmp(chunk, W64_GUID_DATA, 16) == 0) {
+            if (!have_fmt) {
+                return VCARD_ERROR_INVALID;
+            }
+            r->data_offset = pos + 24;
+            *data_bytes = bytes == WAV_SIZE_UNKNOWN ? WAV_SIZE_UNKNOWN : bytes - 24;
+            return VCARD_SUCCESS;
+        }
+        if (bytes < 24 || bytes > size) {
+            return VCARD_ERROR_INVALID;
+        }
+        pos += (bytes + 7) & ~7ull;
+    }
+    return VCARD_ERROR_INVALID;
+}
+
+static void map_file(wav_reader_t *r, uint64_t size)
+{
+    if (size == 0 || size > (uint64_t)SIZE_MAX) {
+        return;
+    }
+#ifdef _WIN32
+    {
+        HANDLE file = (HANDLE)_get_osfhandle(_fileno(r->fp));
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        void *view;
+
+        if (!mapping) {
+            return;
+        }
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+            CloseHandle(mapping);
+            return;
+        }
+        r->map = (const uint8_t *)view;
+        r->map_handle = mapping;
+    }
+#else
+    {
+        void *view = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fileno(r->fp), 0);
+
+        if (view == MAP_FAILED) {
+            return;
+        }
+        posix_madvise(view, (size_t)size, POSIX_MADV_SEQUENTIAL);
+        r->map = (const uint8_t *)view;
+    }
+#endif
+    r->map_size = size;
+}
+
+int wav_reader_open(wav_reader_t *r, const char *path, int flags)
+{
+    uint8_t head[40];
+    uint64_t size;
+    uint64_t data_bytes = 0;
+    int result;
+
+    memset(r, 0, sizeof(*r));
+    if (!path) {
+        return VCARD_ERROR_INVALID;
+    }
+    r->fp = fopen(path, "rb");
+    if (!r->fp) {
+        return VCARD_ERROR_IO;
+    }
+
+    size = file_size(r->fp);
+    if (size < sizeof(head) || file_seek(r->fp, 0) != 0 ||
+        fread(head, 1, sizeof(head), r->fp) != sizeof(head)) {
+        wav_reader_close(r);
+        return VCARD_ERROR_INVALID;
+    }
+
+    if ((memcmp(head, "RIFF", 4) == 0 || memcmp(head, "RF64", 4) == 0) &&
+        memcmp(head + 8, "WAVE", 4) == 0) {
+        r->container = memcmp(head, "RF64", 4) == 0 ? WAV_CONTAINER_RF64 :
+                                                      WAV_CONTAINER_AUTO;
+        result = parse_riff(r, size, &data_bytes);
+    } else if (memcmp(head, W64_GUID_RIFF, 16) == 0 &&
+               memcmp(head + 24, W64_GUID_WAVE, 16) == 0) {
+        r->container = WAV_CONTAINER_W64;
+        result = parse_w64(r, size, &data_bytes);
+    } else {
+        result = VCARD_ERROR_INVALID;
+    }
+    if (result != VCARD_SUCCESS) {
+        wav_reader_close(r);
+        return result;
+    }
+
+    // An unfinished or truncated file holds what is actually on disk
+    if (data_bytes > size - r->data_offset) {
+        data_bytes = size - r->data_offset;
+    }
+    r->frames = data_bytes / r->frame_bytes;
+
+    if (flags & WAV_READER_MMAP) {
+        map_file(r, size);
+    }
+    if (!r->map) {
+        r->scratch = (uint8_t *)malloc((size_t)WAV_CHUNK_FRAMES * r->frame_bytes);
+        if (!r->scratch) {
+            wav_reader_close(r);
+            return VCARD_ERROR_NO_MEMORY;
+        }
+        setvbuf(r->fp, NULL, _IOFBF, WAV_IO_BUFFER);
+    }
+    return wav_reader_seek(r, 0);
+}
+
+/**
+ * Get up to num_frames raw frames at the read position and advance it
+ *
+ * Returns a pointer into the mapping, or reads into the scratch buffer
+ * (at most WAV_CHUNK_FRAMES) when the file is not mapped.
+ */
+static const uint8_t *read_chunk(wav_reader_t *r, size_t num_frames, size_t *got)
+{
+    uint64_t left = r->frames - r->position;
+    const uint8_t *src;
+    size_t n = num_frames < left ? num_frames : (size_t)left;
+
+    if (r->map) {
+        src = r->map + r->data_offset + r->position * r->frame_bytes;
+    } else {
+        if (n > WAV_CHUNK_FRAMES) {
+            n = WAV_CHUNK_FRAMES;
+        }
+        n = fread(r->scratch, r->frame_bytes, n, r->fp);
+        src = r->scratch;
+    }
+    r->position += n;
+    *got = n;
+    return src;
+}
+
+size_t wav_reader_read(wav_reader_t *r, void *frames, size_t num_frames)
+{
+    uint64_t left = r->frames - r->position;
+    size_t n = num_frames < left ? num_frames : (size_t)left;
+
+    if (r->map) {
+        memcpy(frames, r->map + r->data_offset + r->position * r->frame_bytes,
+               n * r->frame_bytes);
+    } else {
+        n = fread(frames, r->frame_bytes, n, r->fp);
+    }
+    r->position += n;
+    return n;
+}
+
+size_t wav_reader_read_float(wav_reader_t *r, float *frames, size_t num_frames)
+{
+    size_t done = 0;
+
+    while (done < num_frames) {
+        size_t want = num_frames - done < WAV_CHUNK_FRAMES ? num_frames - done :
+                                                             WAV_CHUNK_FRAMES;
+        size_t got;
+        const uint8_t *src = read_chunk(r, want, &got);
+
+        if (got == 0) {
+            break;
+        }
+        sine_format_to_float(src, got * r->channels, 1, r->format,
+                             frames + done * r->channels);
+        done += got;
+    }
+    return done;
+}
+
+size_t wav_reader_read_planar(wav_reader_t *r, float *const *planes,
+                              size_t num_frames)
+{
+    size_t bytes = sine_format_bytes(r->format);
+    size_t done = 0;
+
+    while (done < num_frames) {
+        size_t want = num_frames - done < WAV_CHUNK_FRAMES ? num_frames - done :
+                                                             WAV_CHUNK_FRAMES;
+        size_t got;
+        const uint8_t *src = read_chunk(r, want, &got);
+
+        if (got == 0) {
+            break;
+        }
+        for (uint32_t ch = 0; ch < r->channels; ch++) {
+            if (planes[ch]) {
+                sine_format_to_float(src + ch * bytes, got, r->channels, r->format,
+                                     planes[ch] + done);
+            }
+        }
+        done += got;
+    }
+    return done;
+}
+
+int wav_reader_seek(wav_reader_t *r, uint64_t frame)
+{
+    if (frame > r->frames) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (!r->map && file_seek(r->fp, r->data_offset + frame * r->frame_bytes) != 0) {
+        return VCARD_ERROR_IO;
+    }
+    r->position = frame;
+    return VCARD_SUCCESS;
+}
+
+const void *wav_reader_mapped_data(const wav_reader_t *r)
+{
+    return r->map ? r->map + r->data_offset : NULL;
+}
+
+void wav_reader_close(wav_reader_t *r)
+{
+    if (r->map) {
+#ifdef _WIN32
+        UnmapViewOfFile((LPCVOID)r->map);
+        CloseHandle((HANDLE)r->map_handle);
+#else
+        munmap((void *)r->map, (size_t)r->map_size);
+#endif
+    }
+    if (r->fp) {
+        fclose(r->fp);
+    }
+    free(r->scratch);
+    memset(r, 0, sizeof(*r));
+}
@@ -0,0 +1,215 @@
+/**
+ * Virtual Sound Card - Streaming WAV/RF64/W64 Files
+ *
+ * Writes and reads multichannel PCM (16, packed 24 and 32 bit) and 32-bit
+ * float audio a chunk at a time, so memory use does not depend on the
+ * length of the file. Three containers are supported:
+ *  - WAV_CONTAINER_AUTO: RIFF/WAVE, rewritten as RF64 (EBU Tech 3306) when
+ *    closed if the data outgrew the 4 GB RIFF limit. Space for the RF64
+ *    ds64 chunk is reserved up front as a JUNK chunk.
+ *  - WAV_CONTAINER_RF64: always RF64.
+ *  - WAV_CONTAINER_W64: Sony Wave64, with 64-bit chunk sizes throughout.
+ *
+ * Files with more than two channels or more than 16 bits are written with
+ * WAVE_FORMAT_EXTENSIBLE. The reader accepts all three containers, takes
+ * a missing or placeholder data size (from a writer that never closed the
+ * file) to mean "to the end of the file", and can map the file into memory
+ * instead of reading it through stdio.
+ *
+ * Samples are stored little-endian, as the sine_format_t writers produce
+ * them on little-endian hosts.
+ */
+
+#ifndef WAV_FILE_H
+#define WAV_FILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sine_generator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WAV_MAX_CHANNELS 32                  /* VCARD_MAX_CHANNELS */
+#define WAV_CHUNK_FRAMES 1024                /* Frames converted per step */
+
+/* wav_reader_open() flags */
+#define WAV_READER_MMAP 0x1                  /* Map the file if possible */
+
+/**
+ * Container formats
+ */
+typedef enum {
+    WAV_CONTAINER_AUTO = 0,  /* RIFF, promoted to RF64 beyond 4 GB */
+    WAV_CONTAINER_RF64,      /* RF64 from the start */
+    WAV_CONTAINER_W64        /* Sony Wave64 */
+} wav_container_t;
+
+/**
+ * Streaming writer state
+ */
+typedef struct {
+    FILE *fp;
+    wav_container_t container;
+    sine_format_t format;
+    uint32_t channels;
+    uint32_t sample_rate;
+    uint32_t frame_bytes;
+    uint64_t data_bytes;    /* Sample bytes written so far */
+    uint8_t *scratch;       /* WAV_CHUNK_FRAMES converted frames */
+    int error;              /* Sticky VCARD_ERROR_IO after a failed write */
+} wav_writer_t;
+
+/**
+ * Reader state
+ */
+typedef struct {
+    FILE *fp;
+    wav_container_t container;
+    sine_format_t format;
+    uint32_t channels;
+    uint32_t sample_rate;
+    uint32_t frame_bytes;
+    uint64_t frames;        /* Frames in the file */
+    uint64_t data_offset;   /* File offset of the first frame */
+    uint64_t position;      /* Next frame to read */
+    const uint8_t *map;     /* Whole file when mapped, else NULL */
+    uint64_t map_size;
+    void *map_handle;       /* Windows file mapping object */
+    uint8_t *scratch;       /* WAV_CHUNK_FRAMES raw frames */
+} wav_reader_t;
+
+/**
+ * Create a file and write its header
+ *
+ * @param w Writer to initialize
+ * @param path File to create (truncated if it exists)
+ * @param channels Number of interleaved channels (1 to WAV_MAX_CHANNELS)
+ * @param sample_rate Sample rate in Hz
+ * @param format Sample format of the file (not SINE_FORMAT_I24_32)
+ * @param container Container format
+ * @return 0 on success, VCARD_ERROR_INVALID for bad parameters,
+ *         VCARD_ERROR_IO if the file cannot be created
+ */
+int wav_writer_open(wav_writer_t *w, const char *path, uint32_t channels,
+                    uint32_t sample_rate, sine_format_t format,
+                    wav_container_t container);
+
+/**
+ * Append interleaved frames already in the file's sample format
+ *
+ * @param w Writer
+ * @param frames Interleaved frames
+ * @param num_frames Number of frames
+ * @return 0 on success, VCARD_ERROR_IO on a write error
+ */
+int wav_writer_write(wav_writer_t *w, const void *frames, size_t num_frames);
+
+/**
+ * Append interleaved float frames, converted to the file's format
+ *
+ * Samples are clipped to full scale, as by the sine_format_t writers.
+ *
+ * @param w Writer
+ * @param frames Interleaved frames (w->channels samples each)
+ * @param num_frames Number of frames
+ * @return 0 on success, VCARD_ERROR_IO on a write error
+ */
+int wav_writer_write_float(wav_writer_t *w, const float *frames, size_t num_frames);
+
+/**
+ * Append planar float frames, interleaved and converted to the file's format
+ *
+ * @param w Writer
+ * @param planes One buffer of num_frames samples per channel (NULL for silence)
+ * @param num_frames Number of frames
+ * @return 0 on success, VCARD_ERROR_IO on a write error
+ */
+int wav_writer_write_planar(wav_writer_t *w, const float *const *planes,
+                            size_t num_frames);
+
+/**
+ * Finalize the header sizes and close the file
+ *
+ * @param w Writer
+ * @return 0 on success, VCARD_ERROR_IO if any write failed
+ */
+int wav_writer_close(wav_writer_t *w);
+
+/**
+ * Open a file and parse its header
+ *
+ * @param r Reader to initialize
+ * @param path File to open
+ * @param flags WAV_READER_MMAP to map the file; reading falls back to stdio
+ *              if mapping is not possible
+ * @return 0 on success, VCARD_ERROR_IO if the file cannot be read,
+ *         VCARD_ERROR_INVALID for an unsupported or malformed file
+ */
+int wav_reader_open(wav_reader_t *r, const char *path, int flags);
+
+/**
+ * Read interleaved frames in the file's sample format
+ *
+ * @param r Reader
+ * @param frames Output buffer (num_frames * r->frame_bytes bytes)
+ * @param num_frames Maximum number of frames
+ * @return Number of frames read (0 at the end of the file)
+ */
+size_t wav_reader_read(wav_reader_t *r, void *frames, size_t num_frames);
+
+/**
+ * Read interleaved frames converted to float
+ *
+ * Integer samples are scaled to [-1.0, 1.0).
+ *
+ * @param r Reader
+ * @param frames Output buffer (num_frames * r->channels samples)
+ * @param num_frames Maximum number of frames
+ * @return Number of frames read (0 at the end of the file)
+ */
+size_t wav_reader_read_float(wav_reader_t *r, float *frames, size_t num_frames);
+
+/**
+ * Read frames converted to float into one buffer per channel
+ *
+ * @param r Reader
+ * @param planes One buffer per channel (NULL entries are skipped)
+ * @param num_frames Maximum number of frames
+ * @return Number of frames read (0 at the end of the file)
+ */
+size_t wav_reader_read_planar(wav_reader_t *r, float *const *planes,
+                              size_t num_frames);
+
+/**
+ * Move the read position
+ *
+ * @param r Reader
+ * @param frame Frame to read next
+ * @return 0 on success, VCARD_ERROR_INVALID if frame is past the end
+ */
+int wav_reader_seek(wav_reader_t *r, uint64_t frame);
+
+/**
+ * Get the sample data of a mapped file
+ *
+ * @param r Reader
+ * @return First frame (r->frames frames of r->frame_bytes bytes), or NULL
+ *         if the file is not mapped
+ */
+const void *wav_reader_mapped_data(const wav_reader_t *r);
+
+/**
+ * Close the file and release the mapping
+ *
+ * @param r Reader
+ */
+void wav_reader_close(wav_reader_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WAV_FILE_H */
@@ -3,6 +3,21 @@
  * 
  * Reads audio from ALSA loopback device and verifies it contains a sine wave
  * This program should be run while sine_generator_app is playing
+ * Usage: ./test_loopback_read [--mmap] [--latency] [--bits <16|24|32>]
+ *                             [--duration <seconds>]
+ *
+ *   --mmap       Analyze samples in place in the mmap'd ALSA ring buffer
+ *                (snd_pcm_mmap_begin/commit) instead of copying each period
+ *                out with snd_pcm_readi
+ *   --latency    Measure the round-trip latency of the bursts played by
+ *                sine_generator_app --latency-probe instead of checking
+ *                the tone
+ *   --bits       Sample depth (default 16), negotiated as by
+ *                sine_generator_app; the loopback needs both ends to agree
+ *   --duration   Capture length (default 2 seconds)
+ *
+ * Every channel is analyzed period by period as it is captured, so memory
+ * use does not grow with the duration.
  */
 
 #include <stdio.h>
@@ -10,7 +25,14 @@
 #include <stdint.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include <alsa/asoundlib.h>
+#include "vcard.h"
+#include "vcard_telemetry.h"
+#include "sine_generator.h"
+#include "signal_analyzer.h"
+#include "latency_probe.h"
+#include "vcard_thread.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -22,82 +44,490 @@
 #define READ_DURATION 2
 #define EXPECTED_FREQUENCY 440.0
 #define FREQUENCY_TOLERANCE 5.0
+#define MIN_RMS (1000.0 / 32768.0)
+#define MAX_DC_OFFSET (1000.0 / 32768.0)
+#define MAX_THD_N_DB -40.0
+#define LATENCY_REPORT_BINS 16
+
+/* CPU time spent per period (transfer + channel extraction) */
+typedef struct {
+	uint64_t periods;
+	uint64_t total_ns;
+	uint64_t max_ns;
+} cpu_stats_t;
+
+/* Live overrun and load counters, shown with the progress line */
+static vcard_telemetry_t telemetry;
+
+/* One streaming analyzer per captured channel */
+static signal_analyzer_t analyzers[CHANNELS];
+
+/* Latency mode: probe bursts are detected on the first channel instead */
+static latency_detector_t detector;
+static int latency_mode;
+
+/* Negotiated sample format */
+typedef struct {
+	snd_pcm_format_t alsa;
+	sine_format_t sine;
+	unsigned int bits;
+	const char *name;
+} pcm_format_t;
+
+static const pcm_format_t pcm_formats[] = {
+	{ SND_PCM_FORMAT_S16_LE, SINE_FORMAT_I16, VCARD_BIT_16, "S16_LE" },
+	{ SND_PCM_FORMAT_S24_3LE, SINE_FORMAT_I24, VCARD_BIT_24, "S24_3LE" },
+	{ SND_PCM_FORMAT_S24_LE, SINE_FORMAT_I24_32, VCARD_BIT_24, "S24_LE" },
+	{ SND_PCM_FORMAT_S32_LE, SINE_FORMAT_I32, VCARD_BIT_32, "S32_LE" },
+	{ SND_PCM_FORMAT_FLOAT_LE, SINE_FORMAT_F32, VCARD_BIT_32, "FLOAT_LE" },
+};
+
+static const pcm_format_t *pcm_format;
+
+/* One channel of a period converted to float (formats other than S16) */
+static float *scratch;
 
 /**
- * Simple zero-crossing frequency detector
+ * Pick the first format of the requested depth the device accepts,
+ * falling back to the deepest format it accepts at all
  */
-static double detect_frequency(int16_t *buffer, size_t num_samples,
-			       int sample_rate)
+static const pcm_format_t *negotiate_format(snd_pcm_t *handle,
+					    snd_pcm_hw_params_t *params,
+					    unsigned int bits)
 {
-	int zero_crossings = 0;
-	int16_t prev_sample = buffer[0];
+	size_t count = sizeof(pcm_formats) / sizeof(pcm_formats[0]);
 
-	for (size_t i = 1; i < num_samples; i++) {
-		int16_t curr_sample = buffer[i];
-		if ((prev_sample < 0 && curr_sample >= 0) ||
-		    (prev_sample >= 0 && curr_sample < 0)) {
-			zero_crossings++;
+	for (size_t i = 0; i < count; i++) {
+		if (pcm_formats[i].bits == bits &&
+		    snd_pcm_hw_params_test_format(handle, params,
+						  pcm_formats[i].alsa) == 0) {
+			return &pcm_formats[i];
 		}
-		prev_sample = curr_sample;
 	}
+	for (size_t i = count; i-- > 0;) {
+		if (snd_pcm_hw_params_test_format(handle, params,
+						  pcm_formats[i].alsa) == 0) {
+			return &pcm_formats[i];
+		}
+	}
+	return NULL;
+}
 
-	/* Frequency = (zero crossings / 2) / duration */
-	double duration = (double)num_samples / sample_rate;
-	double frequency = (zero_crossings / 2.0) / duration;
+/**
+ * Feed one channel of captured samples to its analyzer or the detector
+ *
+ * @param src First sample of the channel
+ * @param stride Distance between its samples, in samples
+ */
+static void analyze_channel(int channel, const void *src, size_t frames,
+			    size_t stride)
+{
+	if (latency_mode && channel != 0) {
+		return;
+	}
+	if (pcm_format->sine == SINE_FORMAT_I16) {
+		if (latency_mode) {
+			latency_detector_process_i16(&detector, src, frames, stride,
+						     vcard_time_ns());
+		} else {
+			signal_analyzer_process_i16(&analyzers[channel], src, frames,
+						    stride);
+		}
+		return;
+	}
 
-	return frequency;
+	sine_format_to_float(src, frames, stride, pcm_format->sine, scratch);
+	if (latency_mode) {
+		latency_detector_process(&detector, scratch, frames, 1,
+					 vcard_time_ns());
+	} else {
+		signal_analyzer_process(&analyzers[channel], scratch, frames, 1);
+	}
 }
 
 /**
- * Check if signal has reasonable amplitude
+ * Check one channel's worst-case measurements against the expected tone
  */
-static int check_amplitude(int16_t *buffer, size_t num_samples)
+static int check_channel(int channel, const signal_analyzer_t *analyzer)
 {
-	int32_t sum = 0;
-	int32_t sum_sq = 0;
+	const signal_summary_t *s = &analyzer->summary;
+	int ok = 1;
 
-	for (size_t i = 0; i < num_samples; i++) {
-		sum += buffer[i];
-		sum_sq += (int32_t)buffer[i] * buffer[i];
+	if (s->blocks == 0) {
+		fprintf(stderr, "FAIL: Channel %d: too little audio to analyze\n",
+			channel);
+		return 0;
 	}
 
-	double mean = (double)sum / num_samples;
-	double rms = sqrt((double)sum_sq / num_samples);
+	printf("Channel %d: %.2f - %.2f Hz, RMS >= %.4f, |DC| <= %.4f, "
+	       "THD+N <= %.1f dB, SNR >= %.1f dB (%llu blocks)\n",
+	       channel, s->frequency_min, s->frequency_max, s->rms_min,
+	       s->dc_max, s->thd_n_db_max, s->snr_db_min,
+	       (unsigned long long)s->blocks);
 
-	/* RMS should be significant (not silent) */
-	if (rms < 1000) {
-		fprintf(stderr, "Signal too quiet (RMS: %.2f)\n", rms);
-		return 0;
+	if (fabs(s->frequency_min - EXPECTED_FREQUENCY) > FREQUENCY_TOLERANCE ||
+	    fabs(s->frequency_max - EXPECTED_FREQUENCY) > FREQUENCY_TOLERANCE) {
+		fprintf(stderr,
+			"FAIL: Frequency mismatch (expected %.2f ± %.2f Hz)\n",
+			EXPECTED_FREQUENCY, FREQUENCY_TOLERANCE);
+		ok = 0;
+	}
+	if (s->rms_min < MIN_RMS) {
+		fprintf(stderr, "FAIL: Signal too quiet\n");
+		ok = 0;
+	}
+	if (s->dc_max > MAX_DC_OFFSET) {
+		fprintf(stderr, "FAIL: Signal has DC offset\n");
+		ok = 0;
 	}
+	if (s->thd_n_db_max > MAX_THD_N_DB) {
+		fprintf(stderr, "FAIL: Distorted or noisy signal (THD+N limit %.1f dB)\n",
+			MAX_THD_N_DB);
+		ok = 0;
+	}
+	return ok;
+}
 
-	/* Mean should be close to zero (no DC offset) */
-	if (fabs(mean) > 1000) {
-		fprintf(stderr, "Signal has DC offset (mean: %.2f)\n", mean);
+/**
+ * Print the measured latencies and their jitter histogram
+ */
+static int report_latency(const latency_detector_t *d)
+{
+	static const char bar[] = "########################################";
+	latency_report_t report;
+	uint32_t bins[LATENCY_REPORT_BINS];
+	uint32_t used;
+	uint32_t peak = 1;
+	double bin_us;
+
+	latency_stats_report(&d->stats, &report);
+	if (report.count == 0) {
+		fprintf(stderr, "FAIL: No latency probe bursts received (%llu corrupt)\n",
+			(unsigned long long)report.errors);
+		fprintf(stderr, "Play them with sine_generator_app --latency-probe\n");
 		return 0;
 	}
 
-	printf("Signal amplitude OK (RMS: %.2f, mean: %.2f)\n", rms, mean);
+	printf("Bursts: %llu (%llu corrupt)\n", (unsigned long long)report.count,
+	       (unsigned long long)report.errors);
+	printf("Latency: min %.3f ms, mean %.3f ms, p99 %.3f ms, max %.3f ms\n",
+	       report.min_us / 1000.0, report.mean_us / 1000.0,
+	       report.p99_us / 1000.0, report.max_us / 1000.0);
+	printf("Jitter: %.3f ms standard deviation\n", report.jitter_us / 1000.0);
+
+	used = latency_stats_jitter_histogram(&d->stats, bins,
+					      LATENCY_REPORT_BINS, &bin_us);
+	for (uint32_t b = 0; b < used; b++) {
+		if (bins[b] > peak) {
+			peak = bins[b];
+		}
+	}
+	printf("Jitter histogram (above minimum):\n");
+	for (uint32_t b = 0; b < used; b++) {
+		printf("  +%7.2f ms %6u %.*s\n", b * bin_us / 1000.0, bins[b],
+		       (int)((uint64_t)bins[b] * (sizeof(bar) - 1) / peak), bar);
+	}
 	return 1;
 }
 
+static uint64_t thread_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void cpu_stats_add(cpu_stats_t *stats, uint64_t ns)
+{
+	stats->periods++;
+	stats->total_ns += ns;
+	if (ns > stats->max_ns) {
+		stats->max_ns = ns;
+	}
+}
+
+/**
+ * Account for one period in the CPU statistics and the live load
+ */
+static void record_period(cpu_stats_t *stats, snd_pcm_uframes_t frames,
+			  unsigned int rate, uint64_t busy_ns)
+{
+	cpu_stats_add(stats, busy_ns);
+	vcard_telemetry_period(&telemetry, (uint32_t)frames, rate, busy_ns);
+}
+
+static void cpu_stats_print(const cpu_stats_t *stats, const char *mode,
+			    snd_pcm_uframes_t period, unsigned int rate)
+{
+	double budget_us = (double)period * 1e6 / rate;
+	double avg_us;
+
+	if (stats->periods == 0) {
+		return;
+	}
+	avg_us = (double)stats->total_ns / stats->periods / 1000.0;
+	printf("CPU per period (%s): avg %.1f us, max %.1f us "
+	       "(%.2f%% of %.0f us period)\n",
+	       mode, avg_us, stats->max_ns / 1000.0,
+	       avg_us / budget_us * 100.0, budget_us);
+}
+
+/**
+ * Recover from an overrun or suspend
+ */
+static int xrun_recovery(snd_pcm_t *handle, int err)
+{
+	if (err == -EPIPE) {
+		vcard_telemetry_xrun(&telemetry);
+		return snd_pcm_prepare(handle);
+	}
+	if (err == -ESTRPIPE) {
+		while ((err = snd_pcm_resume(handle)) == -EAGAIN) {
+			sleep(1);
+		}
+		if (err < 0) {
+			return snd_pcm_prepare(handle);
+		}
+		return 0;
+	}
+	return err;
+}
+
+static void print_progress(int frames_read, int total_frames,
+			   int *next_progress, unsigned int sample_rate)
+{
+	if (frames_read >= *next_progress) {
+		vcard_status_t status;
+
+		vcard_telemetry_snapshot(&telemetry, &status);
+		printf("\rProgress: %5.1f%%  overruns: %u  load: %5.2f%% ",
+		       (float)frames_read / total_frames * 100.0f,
+		       status.xruns, status.cpu_load);
+		fflush(stdout);
+		*next_progress += sample_rate / 4;
+	}
+}
+
+/**
+ * Capture using snd_pcm_readi into a staging buffer
+ *
+ * @return Number of frames analyzed, or negative error code
+ */
+static long capture_rw(snd_pcm_t *pcm_handle, snd_pcm_uframes_t frames,
+		       unsigned int sample_rate, int total_frames,
+		       cpu_stats_t *stats)
+{
+	size_t sample_bytes = sine_format_bytes(pcm_format->sine);
+	char *buffer;
+	int frames_read = 0;
+	int next_progress = sample_rate / 4;
+	int err;
+
+	buffer = malloc(frames * CHANNELS * sample_bytes);
+	if (!buffer) {
+		fprintf(stderr, "Error allocating buffer\n");
+		return -ENOMEM;
+	}
+
+	while (frames_read < total_frames) {
+		uint64_t start = thread_cpu_ns();
+
+		/* Read samples from device */
+		err = snd_pcm_readi(pcm_handle, buffer, frames);
+		if (err == -EPIPE) {
+			/* Buffer overrun */
+			xrun_recovery(pcm_handle, err);
+			continue;
+		} else if (err < 0) {
+			fprintf(stderr, "Error reading from PCM device: %s\n",
+				snd_strerror(err));
+			break;
+		}
+
+		/* Analyze every channel straight from the interleaved period */
+		for (int ch = 0; ch < CHANNELS; ch++) {
+			analyze_channel(ch, buffer + ch * sample_bytes, err, CHANNELS);
+		}
+		record_period(stats, err, sample_rate, thread_cpu_ns() - start);
+
+		frames_read += err;
+		print_progress(frames_read, total_frames, &next_progress,
+			       sample_rate);
+	}
+
+	free(buffer);
+	return frames_read;
+}
+
+/**
+ * Capture by analyzing every channel straight out of the mmap'd ring
+ *
+ * @return Number of frames analyzed, or negative error code
+ */
+static long capture_mmap(snd_pcm_t *pcm_handle, snd_pcm_uframes_t frames,
+			 unsigned int sample_rate, int total_frames,
+			 cpu_stats_t *stats)
+{
+	unsigned int sample_bits = 8 * (unsigned int)sine_format_bytes(pcm_format->sine);
+	int frames_read = 0;
+	int next_progress = sample_rate / 4;
+	int first = 1;
+	int err;
+
+	while (frames_read < total_frames) {
+		snd_pcm_sframes_t avail;
+		snd_pcm_uframes_t remaining = frames;
+		uint64_t start;
+
+		if (snd_pcm_state(pcm_handle) == SND_PCM_STATE_XRUN) {
+			err = xrun_recovery(pcm_handle, -EPIPE);
+			if (err < 0) {
+				return err;
+			}
+			first = 1;
+		}
+
+		if (first) {
+			/* Capture must be started explicitly in mmap mode */
+			first = 0;
+			err = snd_pcm_start(pcm_handle);
+			if (err < 0) {
+				fprintf(stderr, "Start error: %s\n",
+					snd_strerror(err));
+				return err;
+			}
+		}
+
+		avail = snd_pcm_avail_update(pcm_handle);
+		if (avail < 0) {
+			err = xrun_recovery(pcm_handle, avail);
+			if (err < 0) {
+				fprintf(stderr, "avail update failed: %s\n",
+					snd_strerror(err));
+				return err;
+			}
+			first = 1;
+			continue;
+		}
+		if ((snd_pcm_uframes_t)avail < frames) {
+			err = snd_pcm_wait(pcm_handle, 1000);
+			if (err < 0) {
+				err = xrun_recovery(pcm_handle, err);
+				if (err < 0) {
+					return err;
+				}
+				first = 1;
+			}
+			continue;
+		}
+
+		start = thread_cpu_ns();
+		while (remaining > 0) {
+			const snd_pcm_channel_area_t *areas;
+			snd_pcm_uframes_t offset;
+			snd_pcm_uframes_t size = remaining;
+			snd_pcm_sframes_t committed;
+
+			err = snd_pcm_mmap_begin(pcm_handle, &areas, &offset, &size);
+			if (err < 0) {
+				err = xrun_recovery(pcm_handle, err);
+				if (err < 0) {
+					return err;
+				}
+				first = 1;
+				break;
+			}
+
+			/* Each channel walks its area in steps of the frame size */
+			for (int ch = 0; ch < CHANNELS; ch++) {
+				const char *src = (const char *)areas[ch].addr +
+					(areas[ch].first + offset * areas[ch].step) / 8;
+
+				analyze_channel(ch, src, size, areas[ch].step / sample_bits);
+			}
+
+			committed = snd_pcm_mmap_commit(pcm_handle, offset, size);
+			if (committed < 0 || (snd_pcm_uframes_t)committed != size) {
+				err = xrun_recovery(pcm_handle,
+						    committed >= 0 ? -EPIPE : committed);
+				if (err < 0) {
+					return err;
+				}
+				first = 1;
+			}
+			remaining -= size;
+			frames_read += size;
+		}
+		record_period(stats, frames, sample_rate, thread_cpu_ns() - start);
+
+		print_progress(frames_read, total_frames, &next_progress,
+			       sample_rate);
+	}
+
+	return frames_read;
+}
+
+static void print_usage(const char *program_name)
+{
+	printf("Usage: %s [--mmap] [--latency] [--bits <16|24|32>] [--duration <seconds>]\n",
+	       program_name);
+}
+
 int main(int argc, char *argv[])
 {
-	(void)argc;
-	(void)argv;
 	snd_pcm_t *pcm_handle;
 	snd_pcm_hw_params_t *params;
-	int16_t *buffer;
-	int16_t *mono_buffer;
+	cpu_stats_t stats = { 0, 0, 0 };
+	int use_mmap = 0;
+	unsigned int bits = VCARD_BIT_16;
+	int duration = READ_DURATION;
 	int err;
+	long collected;
 	unsigned int sample_rate = SAMPLE_RATE;
 	snd_pcm_uframes_t frames = BUFFER_SIZE;
 	int test_passed = 1;
 
+	/* Parse command line arguments */
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--mmap") == 0) {
+			use_mmap = 1;
+		} else if (strcmp(argv[i], "--latency") == 0) {
+			latency_mode = 1;
+		} else if (strcmp(argv[i], "--bits") == 0 && i + 1 < argc) {
+			bits = (unsigned int)atoi(argv[++i]);
+			if (bits != VCARD_BIT_16 && bits != VCARD_BIT_24 &&
+			    bits != VCARD_BIT_32) {
+				print_usage(argv[0]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+			duration = atoi(argv[++i]);
+			if (duration <= 0) {
+				print_usage(argv[0]);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-h") == 0 ||
+			   strcmp(argv[i], "--help") == 0) {
+			print_usage(argv[0]);
+			return 0;
+		} else {
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
 	printf("Loopback Read Test\n");
 	printf("==================\n");
 	printf("Reading from virtual sound card...\n");
-	printf("Expected frequency: %.2f Hz\n", EXPECTED_FREQUENCY);
-	printf("Duration: %d seconds\n", READ_DURATION);
+	if (latency_mode) {
+		printf("Measuring latency of probe bursts\n");
+	} else {
+		printf("Expected frequency: %.2f Hz\n", EXPECTED_FREQUENCY);
+	}
+	printf("Duration: %d seconds\n", duration);
+	printf("Access Mode: %s\n",
+	       use_mmap ? "mmap (zero-copy)" : "read/write (snd_pcm_readi)");
 	printf("\n");
 
 	/* Open PCM device for capture */
@@ -122,8 +552,15 @@ int main(int argc, char *argv[])
 
 	/* Set hardware parameters */
 	snd_pcm_hw_params_set_access(pcm_handle, params,
-				     SND_PCM_ACCESS_RW_INTERLEAVED);
-	snd_pcm_hw_params_set_format(pcm_handle, params, SND_PCM_FORMAT_S16_LE);
+				     use_mmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED :
+						SND_PCM_ACCESS_RW_INTERLEAVED);
+	pcm_format = negotiate_format(pcm_handle, params, bits);
+	if (!pcm_format) {
+		fprintf(stderr, "No supported sample format\n");
+		snd_pcm_close(pcm_handle);
+		return 1;
+	}
+	snd_pcm_hw_params_set_format(pcm_handle, params, pcm_format->alsa);
 	snd_pcm_hw_params_set_channels(pcm_handle, params, CHANNELS);
 	snd_pcm_hw_params_set_rate_near(pcm_handle, params, &sample_rate, 0);
 	snd_pcm_hw_params_set_period_size_near(pcm_handle, params, &frames, 0);
@@ -137,105 +574,87 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	vcard_telemetry_init(&telemetry);
+	printf("Format: %s%s\n\n", pcm_format->name,
+	       pcm_format->bits != bits ? " (requested depth not supported)" : "");
+
+	scratch = malloc(frames * sizeof(float));
+	if (!scratch) {
+		fprintf(stderr, "Error allocating buffer\n");
+		snd_pcm_close(pcm_handle);
+		return 1;
+	}
+
 	/* Start capture */
 	err = snd_pcm_prepare(pcm_handle);
 	if (err < 0) {
 		fprintf(stderr, "Error preparing PCM: %s\n",
 			snd_strerror(err));
+		free(scratch);
 		snd_pcm_close(pcm_handle);
 		return 1;
 	}
 
-	/* Allocate buffers */
-	buffer = malloc(frames * CHANNELS * sizeof(int16_t));
-	mono_buffer = malloc(frames * sizeof(int16_t));
-	if (!buffer || !mono_buffer) {
-		fprintf(stderr, "Error allocating buffers\n");
-		snd_pcm_close(pcm_handle);
-		return 1;
+	/* Analysis blocks of 100 ms on every channel */
+	if (latency_mode && latency_detector_init(&detector, sample_rate) != 0) {
+		fprintf(stderr, "Unsupported sample rate for the latency probe: %u Hz\n",
+			sample_rate);
+		test_passed = 0;
+		goto cleanup;
 	}
-
-	/* Read audio for specified duration */
-	int total_frames = READ_DURATION * sample_rate;
-	int frames_read = 0;
-	size_t mono_samples_collected = 0;
-	size_t total_mono_samples = total_frames;
-	int16_t *all_mono_samples = malloc(total_mono_samples * sizeof(int16_t));
-
-	if (!all_mono_samples) {
-		fprintf(stderr, "Error allocating analysis buffer\n");
-		free(buffer);
-		free(mono_buffer);
-		snd_pcm_close(pcm_handle);
-		return 1;
+	for (int ch = 0; ch < CHANNELS && !latency_mode; ch++) {
+		if (signal_analyzer_init(&analyzers[ch], sample_rate,
+					 EXPECTED_FREQUENCY, sample_rate / 10) != 0) {
+			fprintf(stderr, "Error allocating analyzer\n");
+			test_passed = 0;
+			goto cleanup;
+		}
 	}
 
 	printf("Reading audio...\n");
 
-	while (frames_read < total_frames) {
-		/* Read samples from device */
-		err = snd_pcm_readi(pcm_handle, buffer, frames);
-		if (err == -EPIPE) {
-			/* Buffer overrun */
-			fprintf(stderr, "Buffer overrun\n");
-			snd_pcm_prepare(pcm_handle);
-			continue;
-		} else if (err < 0) {
-			fprintf(stderr, "Error reading from PCM device: %s\n",
-				snd_strerror(err));
-			break;
-		}
-
-		/* Extract mono channel (left channel) */
-		for (int i = 0; i < err && mono_samples_collected < total_mono_samples; i++) {
-			all_mono_samples[mono_samples_collected++] = buffer[i * CHANNELS];
-		}
-
-		frames_read += err;
-
-		/* Print progress */
-		if (frames_read % (sample_rate / 4) == 0) {
-			float progress = (float)frames_read / total_frames * 100.0f;
-			printf("\rProgress: %.1f%%", progress);
-			fflush(stdout);
-		}
+	if (use_mmap) {
+		collected = capture_mmap(pcm_handle, frames, sample_rate,
+					 duration * (int)sample_rate, &stats);
+	} else {
+		collected = capture_rw(pcm_handle, frames, sample_rate,
+				       duration * (int)sample_rate, &stats);
+	}
+	if (collected <= 0) {
+		fprintf(stderr, "No audio captured\n");
+		test_passed = 0;
+		goto cleanup;
 	}
 
 	printf("\rProgress: 100.0%%\n");
-	printf("Read complete. Analyzing...\n\n");
+	printf("Read complete.\n\n");
+	cpu_stats_print(&stats, use_mmap ? "mmap" : "rw", frames, sample_rate);
+	printf("Overruns: %u\n", vcard_atomic_load_relaxed_u32(&telemetry.xruns));
+	printf("\n");
 
-	/* Analyze the captured audio */
+	/* Worst block of every channel over the whole capture */
 	printf("=== Analysis Results ===\n");
-
-	/* Check amplitude */
-	if (!check_amplitude(all_mono_samples, mono_samples_collected)) {
-		test_passed = 0;
+	if (latency_mode) {
+		test_passed = report_latency(&detector);
+		printf("\n");
+		goto cleanup;
 	}
-
-	/* Detect frequency */
-	double detected_freq = detect_frequency(all_mono_samples,
-						mono_samples_collected,
-						sample_rate);
-	printf("Detected frequency: %.2f Hz\n", detected_freq);
-
-	/* Verify frequency is close to expected */
-	double freq_diff = fabs(detected_freq - EXPECTED_FREQUENCY);
-	if (freq_diff > FREQUENCY_TOLERANCE) {
-		fprintf(stderr,
-			"FAIL: Frequency mismatch (expected %.2f ± %.2f Hz, got %.2f Hz)\n",
-			EXPECTED_FREQUENCY, FREQUENCY_TOLERANCE, detected_freq);
-		test_passed = 0;
-	} else {
-		printf("PASS: Frequency within tolerance (%.2f Hz)\n",
-		       freq_diff);
+	for (int ch = 0; ch < CHANNELS; ch++) {
+		if (!check_channel(ch, &analyzers[ch])) {
+			test_passed = 0;
+		}
+	}
+	if (test_passed) {
+		printf("PASS: All channels within tolerance\n");
 	}
 
 	printf("\n");
 
-	/* Cleanup */
-	free(all_mono_samples);
-	free(buffer);
-	free(mono_buffer);
+cleanup:
+	for (int ch = 0; ch < CHANNELS; ch++) {
+		signal_analyzer_free(&analyzers[ch]);
+	}
+	free(scratch);
 	snd_pcm_close(pcm_handle);
 
 	if (test_passed) {
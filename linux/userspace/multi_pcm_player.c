@@ -0,0 +1,659 @@
+/**
+ * Multi-PCM Sine Player
+ *
+ * Plays a sine to several ALSA PCMs from one real-time thread. Every PCM
+ * is opened non-blocking; the thread sleeps in poll() on all of their
+ * descriptors and tops up each ready PCM in a fixed order, so one process
+ * can serve all eight snd-aloop substreams with deterministic scheduling.
+ * Stream n plays (n + 1) times the base frequency.
+ *
+ * Usage: ./multi_pcm_player [--streams <n> | --pcm <name> ...] [--rate <hz>]
+ *                           [--bits <16|24|32>] [--period <frames>]
+ *                           [--periods <n>] [--cpu <n>] [--priority <n>]
+ *                           [frequency] [duration_seconds]
+ *
+ *   --streams    Play to hw:Loopback,0,0 .. hw:Loopback,0,<n-1> (default 8)
+ *   --pcm        Play to this PCM; repeat for more (replaces --streams)
+ *   --rate       Sample rate (default 48000)
+ *   --bits       Sample depth (default 16), negotiated as sine_generator_app
+ *   --period     Period size in frames (default 256)
+ *   --periods    Periods per buffer (default 3)
+ *   --cpu        Pin the engine thread to this CPU
+ *   --priority   SCHED_FIFO priority of the engine thread (default 70)
+ *
+ * The engine thread runs SCHED_FIFO with all memory locked when the
+ * process may do so (root, or an rtprio/memlock limit), and falls back
+ * to normal scheduling with a warning otherwise.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <alsa/asoundlib.h>
+#include "vcard.h"
+#include "sine_generator.h"
+#include "sine_table.h"
+#include "vcard_atomic.h"
+#include "vcard_telemetry.h"
+#include "vcard_thread.h"
+#include "vcard_trace.h"
+
+#define DEFAULT_FREQUENCY 440.0
+#define DEFAULT_DURATION 5
+#define DEFAULT_SAMPLE_RATE 48000
+#define DEFAULT_STREAMS 8
+#define DEFAULT_PERIOD 256
+#define DEFAULT_PERIODS 3
+#define DEFAULT_PRIORITY 70
+#define MAX_STREAMS 32
+#define CHANNELS 2
+
+/* Negotiated sample format */
+typedef struct {
+	snd_pcm_format_t alsa;
+	sine_format_t sine;
+	unsigned int bits;
+	const char *name;
+} pcm_format_t;
+
+static const pcm_format_t pcm_formats[] = {
+	{ SND_PCM_FORMAT_S16_LE, SINE_FORMAT_I16, VCARD_BIT_16, "S16_LE" },
+	{ SND_PCM_FORMAT_S24_3LE, SINE_FORMAT_I24, VCARD_BIT_24, "S24_3LE" },
+	{ SND_PCM_FORMAT_S24_LE, SINE_FORMAT_I24_32, VCARD_BIT_24, "S24_LE" },
+	{ SND_PCM_FORMAT_S32_LE, SINE_FORMAT_I32, VCARD_BIT_32, "S32_LE" },
+	{ SND_PCM_FORMAT_FLOAT_LE, SINE_FORMAT_F32, VCARD_BIT_32, "FLOAT_LE" },
+};
+
+/* One PCM and the tone played to it */
+typedef struct {
+	char name[64];
+	snd_pcm_t *handle;
+	const pcm_format_t *format;
+	unsigned int rate;
+	snd_pcm_uframes_t period;
+	snd_pcm_uframes_t buffer_size;
+	sine_writer_t writer;
+	sine_generator_t gen;
+	sine_table_t table;		/* Cached cycles, when the frequency allows */
+
+	void *staging;			/* One rendered period */
+	snd_pcm_uframes_t pending;	/* Frames of staging not yet written */
+	snd_pcm_uframes_t offset;
+
+	struct pollfd *fds;		/* This PCM's slice of the poll set */
+	unsigned int nfds;
+
+	uint64_t total_frames;
+	vcard_atomic_u64 written;	/* Frames accepted by the PCM */
+	vcard_telemetry_t telemetry;
+	int done;
+	int error;			/* Unrecoverable error, 0 if none */
+} stream_t;
+
+/* The engine thread's view of all streams */
+typedef struct {
+	stream_t *streams;
+	unsigned int num_streams;
+	struct pollfd *fds;
+	unsigned int nfds;
+	int priority;
+	int cpu;			/* CPU to pin to, or -1 */
+
+	vcard_telemetry_t telemetry;	/* Load over all streams per wake-up */
+	uint64_t wakeups;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	int realtime;			/* SCHED_FIFO was granted */
+	int pinned;			/* Running on cpu */
+	vcard_atomic_u32 finished;
+} engine_t;
+
+/**
+ * Pick the first format of the requested depth the device accepts,
+ * falling back to the deepest format it accepts at all
+ */
+static const pcm_format_t *negotiate_format(snd_pcm_t *handle,
+					    snd_pcm_hw_params_t *params,
+					    unsigned int bits)
+{
+	size_t count = sizeof(pcm_formats) / sizeof(pcm_formats[0]);
+
+	for (size_t i = 0; i < count; i++) {
+		if (pcm_formats[i].bits == bits &&
+		    snd_pcm_hw_params_test_format(handle, params,
+						  pcm_formats[i].alsa) == 0) {
+			return &pcm_formats[i];
+		}
+	}
+	for (size_t i = count; i-- > 0;) {
+		if (snd_pcm_hw_params_test_format(handle, params,
+						  pcm_formats[i].alsa) == 0) {
+			return &pcm_formats[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Apply hardware and software parameters for low-latency polling
+ *
+ * The device wakes the engine once a period of space is free (avail_min)
+ * and starts playing as soon as the buffer is full (start_threshold), so
+ * the first wake-up comes one period after the stream starts.
+ */
+static int configure_stream(stream_t *s, unsigned int bits, unsigned int rate,
+			    snd_pcm_uframes_t period, unsigned int periods)
+{
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_sw_params_t *sw;
+	snd_pcm_uframes_t buffer_size = period * periods;
+	int err;
+
+	snd_pcm_hw_params_alloca(&hw);
+	snd_pcm_hw_params_any(s->handle, hw);
+	snd_pcm_hw_params_set_access(s->handle, hw, SND_PCM_ACCESS_RW_INTERLEAVED);
+	s->format = negotiate_format(s->handle, hw, bits);
+	if (!s->format) {
+		fprintf(stderr, "%s: no supported sample format\n", s->name);
+		return -EINVAL;
+	}
+	snd_pcm_hw_params_set_format(s->handle, hw, s->format->alsa);
+	snd_pcm_hw_params_set_channels(s->handle, hw, CHANNELS);
+	s->rate = rate;
+	snd_pcm_hw_params_set_rate_near(s->handle, hw, &s->rate, 0);
+	snd_pcm_hw_params_set_period_size_near(s->handle, hw, &period, 0);
+	snd_pcm_hw_params_set_buffer_size_near(s->handle, hw, &buffer_size);
+	err = snd_pcm_hw_params(s->handle, hw);
+	if (err < 0) {
+		fprintf(stderr, "%s: error setting HW params: %s\n", s->name,
+			snd_strerror(err));
+		return err;
+	}
+	snd_pcm_hw_params_get_period_size(hw, &s->period, 0);
+	snd_pcm_hw_params_get_buffer_size(hw, &s->buffer_size);
+
+	snd_pcm_sw_params_alloca(&sw);
+	snd_pcm_sw_params_current(s->handle, sw);
+	snd_pcm_sw_params_set_avail_min(s->handle, sw, s->period);
+	snd_pcm_sw_params_set_start_threshold(s->handle, sw, s->buffer_size);
+	err = snd_pcm_sw_params(s->handle, sw);
+	if (err < 0) {
+		fprintf(stderr, "%s: error setting SW params: %s\n", s->name,
+			snd_strerror(err));
+		return err;
+	}
+	sine_writer_init(&s->writer, s->format->sine, CHANNELS, 0);
+	return 0;
+}
+
+/**
+ * Recover from an underrun or suspend, counting underruns
+ */
+static int recover(stream_t *s, int err)
+{
+	if (err == -EPIPE) {
+		vcard_telemetry_xrun(&s->telemetry);
+	}
+	return snd_pcm_recover(s->handle, err, 1);
+}
+
+/**
+ * Write rendered periods until the PCM is full or the stream is done
+ */
+static void service_stream(stream_t *s)
+{
+	size_t frame_bytes = s->writer.frame_bytes;
+	uint64_t written = vcard_atomic_load_relaxed_u64(&s->written);
+	snd_pcm_sframes_t delay = 0;
+	VCARD_TRACE_BEGIN(trace);
+
+	while (!s->done) {
+		snd_pcm_sframes_t n;
+
+		if (s->pending == 0) {
+			if (written >= s->total_frames) {
+				s->done = 1;
+				break;
+			}
+			if (s->table.mode != SINE_TABLE_NONE) {
+				sine_table_render(&s->table, &s->staging, s->period);
+			} else {
+				sine_writer_render(&s->writer, &s->gen, &s->staging,
+						   s->period, NULL);
+			}
+			s->pending = s->period;
+			s->offset = 0;
+		}
+
+		n = snd_pcm_writei(s->handle,
+				   (const uint8_t *)s->staging + s->offset * frame_bytes,
+				   s->pending);
+		if (n == -EAGAIN) {
+			break;
+		}
+		if (n < 0) {
+			int err = recover(s, (int)n);
+
+			if (err < 0) {
+				s->error = err;
+				s->done = 1;
+			}
+			continue;
+		}
+		s->pending -= (snd_pcm_uframes_t)n;
+		s->offset += (snd_pcm_uframes_t)n;
+		written += (uint64_t)n;
+		vcard_atomic_store_relaxed_u64(&s->written, written);
+	}
+
+	if (snd_pcm_delay(s->handle, &delay) == 0 && delay >= 0) {
+		vcard_telemetry_latency(&s->telemetry,
+					(uint32_t)((uint64_t)delay * 1000000u / s->rate));
+	}
+	VCARD_TRACE_END(trace, "alsa.poll", s->period, s->period - s->pending,
+			delay > 0 ? delay : 0);
+}
+
+static uint64_t thread_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Drop finished PCMs from the poll set; the number still playing
+ */
+static unsigned int drop_finished(engine_t *e)
+{
+	unsigned int active = 0;
+
+	for (unsigned int i = 0; i < e->num_streams; i++) {
+		stream_t *s = &e->streams[i];
+
+		if (s->done) {
+			for (unsigned int f = 0; f < s->nfds; f++) {
+				s->fds[f].fd = -1;
+			}
+		} else {
+			active++;
+		}
+	}
+	return active;
+}
+
+/**
+ * Engine thread: poll every PCM, service the ready ones in stream order
+ */
+static void engine_thread(void *arg)
+{
+	engine_t *e = (engine_t *)arg;
+	struct sched_param param;
+	unsigned int active;
+
+	/* Pin before the prefill, so no period is rendered on another CPU */
+	if (e->cpu >= 0) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(e->cpu, &set);
+		e->pinned = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+	}
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = e->priority;
+	e->realtime = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+
+	/* Prefill every buffer; each PCM starts once its buffer is full */
+	for (unsigned int i = 0; i < e->num_streams; i++) {
+		service_stream(&e->streams[i]);
+	}
+	active = drop_finished(e);
+
+	while (active > 0) {
+		uint64_t start;
+		int ready = poll(e->fds, e->nfds, 1000);
+
+		if (ready < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		if (ready == 0) {
+			/* Streams that finished or failed without an event */
+			active = drop_finished(e);
+			continue;
+		}
+
+		start = thread_cpu_ns();
+		for (unsigned int i = 0; i < e->num_streams; i++) {
+			stream_t *s = &e->streams[i];
+			unsigned short revents = 0;
+
+			if (s->done) {
+				continue;
+			}
+			snd_pcm_poll_descriptors_revents(s->handle, s->fds, s->nfds, &revents);
+			if (revents & POLLERR) {
+				snd_pcm_state_t state = snd_pcm_state(s->handle);
+				int err = 0;
+
+				if (state == SND_PCM_STATE_XRUN) {
+					err = recover(s, -EPIPE);
+				} else if (state == SND_PCM_STATE_SUSPENDED) {
+					err = recover(s, -ESTRPIPE);
+				}
+				if (err < 0) {
+					s->error = err;
+					s->done = 1;
+				}
+			}
+			if (revents & (POLLOUT | POLLERR)) {
+				service_stream(s);
+			}
+		}
+		active = drop_finished(e);
+
+		{
+			uint64_t busy = thread_cpu_ns() - start;
+
+			e->wakeups++;
+			e->total_ns += busy;
+			if (busy > e->max_ns) {
+				e->max_ns = busy;
+			}
+			vcard_telemetry_period(&e->telemetry, (uint32_t)e->streams[0].period,
+					       e->streams[0].rate, busy);
+		}
+	}
+	vcard_atomic_store_release_u32(&e->finished, 1);
+}
+
+static void print_progress(const engine_t *e)
+{
+	uint64_t written = 0, total = 0;
+	uint32_t xruns = 0;
+	vcard_status_t status;
+
+	for (unsigned int i = 0; i < e->num_streams; i++) {
+		written += vcard_atomic_load_relaxed_u64(&e->streams[i].written);
+		total += e->streams[i].total_frames;
+		xruns += vcard_atomic_load_relaxed_u32(&e->streams[i].telemetry.xruns);
+	}
+	vcard_telemetry_snapshot(&e->telemetry, &status);
+	printf("\rProgress: %5.1f%%  xruns: %u  engine load: %5.2f%% ",
+	       total ? (double)written / (double)total * 100.0 : 100.0, xruns,
+	       status.cpu_load);
+	fflush(stdout);
+}
+
+static void close_streams(stream_t *streams, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		if (streams[i].handle) {
+			snd_pcm_close(streams[i].handle);
+		}
+		sine_table_free(&streams[i].table);
+		free(streams[i].staging);
+	}
+}
+
+static void print_usage(const char *program_name)
+{
+	printf("Usage: %s [--streams <n> | --pcm <name> ...] [--rate <hz>]\n"
+	       "       [--bits <16|24|32>] [--period <frames>] [--periods <n>]\n"
+	       "       [--cpu <n>] [--priority <n>] [frequency] [duration_seconds]\n",
+	       program_name);
+}
+
+int main(int argc, char *argv[])
+{
+	static stream_t streams[MAX_STREAMS];
+	static struct pollfd fds[MAX_STREAMS * 4];
+	static engine_t engine;
+	const char *pcm_names[MAX_STREAMS];
+	unsigned int num_pcms = 0;
+	unsigned int num_streams = DEFAULT_STREAMS;
+	double frequency = DEFAULT_FREQUENCY;
+	int duration = DEFAULT_DURATION;
+	unsigned int rate = DEFAULT_SAMPLE_RATE;
+	unsigned int bits = VCARD_BIT_16;
+	snd_pcm_uframes_t period = DEFAULT_PERIOD;
+	unsigned int periods = DEFAULT_PERIODS;
+	int cpu = -1;
+	int priority = DEFAULT_PRIORITY;
+	int positional = 0;
+	int locked;
+	vcard_thread_t thread;
+	int failed = 0;
+
+	/* Parse command line arguments */
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--streams") == 0 && i + 1 < argc) {
+			int n = atoi(argv[++i]);
+
+			if (n <= 0 || n > MAX_STREAMS) {
+				fprintf(stderr, "Invalid stream count: %d\n", n);
+				return 1;
+			}
+			num_streams = (unsigned int)n;
+		} else if (strcmp(argv[i], "--pcm") == 0 && i + 1 < argc) {
+			if (num_pcms == MAX_STREAMS) {
+				fprintf(stderr, "At most %d PCMs\n", MAX_STREAMS);
+				return 1;
+			}
+			pcm_names[num_pcms++] = argv[++i];
+		} else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+			rate = (unsigned int)atoi(argv[++i]);
+			if (rate < 8000 || rate > 384000) {
+				fprintf(stderr, "Invalid sample rate: %u\n", rate);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--bits") == 0 && i + 1 < argc) {
+			bits = (unsigned int)atoi(argv[++i]);
+			if (bits != VCARD_BIT_16 && bits != VCARD_BIT_24 &&
+			    bits != VCARD_BIT_32) {
+				fprintf(stderr, "Invalid bit depth: %u\n", bits);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--period") == 0 && i + 1 < argc) {
+			int n = atoi(argv[++i]);
+
+			if (n < 16 || n > 8192) {
+				fprintf(stderr, "Invalid period size: %d\n", n);
+				return 1;
+			}
+			period = (snd_pcm_uframes_t)n;
+		} else if (strcmp(argv[i], "--periods") == 0 && i + 1 < argc) {
+			int n = atoi(argv[++i]);
+
+			if (n < 2 || n > 32) {
+				fprintf(stderr, "Invalid period count: %d\n", n);
+				return 1;
+			}
+			periods = (unsigned int)n;
+		} else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+			cpu = atoi(argv[++i]);
+			if (cpu < 0 || (unsigned int)cpu >= vcard_cpu_count()) {
+				fprintf(stderr, "Invalid CPU: %d\n", cpu);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--priority") == 0 && i + 1 < argc) {
+			priority = atoi(argv[++i]);
+			if (priority < sched_get_priority_min(SCHED_FIFO) ||
+			    priority > sched_get_priority_max(SCHED_FIFO)) {
+				fprintf(stderr, "Invalid priority: %d\n", priority);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-h") == 0 ||
+			   strcmp(argv[i], "--help") == 0) {
+			print_usage(argv[0]);
+			return 0;
+		} else if (positional == 0) {
+			frequency = atof(argv[i]);
+			if (frequency <= 0 || frequency > 20000) {
+				fprintf(stderr, "Invalid frequency: %.2f Hz\n",
+					frequency);
+				return 1;
+			}
+			positional++;
+		} else if (positional == 1) {
+			duration = atoi(argv[i]);
+			if (duration <= 0 || duration > 3600) {
+				fprintf(stderr, "Invalid duration: %d seconds\n",
+					duration);
+				return 1;
+			}
+			positional++;
+		} else {
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+	if (num_pcms > 0) {
+		num_streams = num_pcms;
+	}
+
+	printf("Multi-PCM Sine Player\n");
+	printf("=====================\n");
+	printf("Streams: %u, base frequency %.2f Hz, %d seconds\n",
+	       num_streams, frequency, duration);
+	printf("Requested: %u Hz, %lu-frame periods x %u\n\n", rate,
+	       (unsigned long)period, periods);
+
+	/* Open and configure every PCM before anything plays */
+	engine.streams = streams;
+	engine.num_streams = num_streams;
+	engine.fds = fds;
+	engine.priority = priority;
+	engine.cpu = cpu;
+	for (unsigned int i = 0; i < num_streams; i++) {
+		stream_t *s = &streams[i];
+		double f = frequency * (i + 1);
+		int count;
+		int err;
+
+		if (num_pcms > 0) {
+			snprintf(s->name, sizeof(s->name), "%s", pcm_names[i]);
+		} else {
+			snprintf(s->name, sizeof(s->name), "hw:Loopback,0,%u", i);
+		}
+		err = snd_pcm_open(&s->handle, s->name, SND_PCM_STREAM_PLAYBACK,
+				   SND_PCM_NONBLOCK);
+		if (err < 0) {
+			fprintf(stderr, "Error opening PCM device %s: %s\n", s->name,
+				snd_strerror(err));
+			fprintf(stderr, "Make sure the snd-aloop module is loaded:\n");
+			fprintf(stderr, "  sudo modprobe snd-aloop\n");
+			s->handle = NULL;
+			close_streams(streams, i);
+			return 1;
+		}
+		if (configure_stream(s, bits, rate, period, periods) < 0) {
+			close_streams(streams, i + 1);
+			return 1;
+		}
+
+		count = snd_pcm_poll_descriptors_count(s->handle);
+		if (count <= 0 || engine.nfds + (unsigned int)count > MAX_STREAMS * 4) {
+			fprintf(stderr, "%s: cannot poll\n", s->name);
+			close_streams(streams, i + 1);
+			return 1;
+		}
+		s->fds = fds + engine.nfds;
+		s->nfds = (unsigned int)snd_pcm_poll_descriptors(s->handle, s->fds,
+								 (unsigned int)count);
+		engine.nfds += s->nfds;
+
+		s->staging = malloc(s->period * s->writer.frame_bytes);
+		if (!s->staging) {
+			fprintf(stderr, "Error allocating buffer\n");
+			close_streams(streams, i + 1);
+			return 1;
+		}
+		if (f >= s->rate / 2.0) {
+			f = frequency;
+		}
+		sine_generator_init(&s->gen, f, s->rate, 0.5);
+		if (sine_table_init_sine(&s->table, &s->writer, &s->gen) == VCARD_SUCCESS &&
+		    s->table.mode != SINE_TABLE_CACHED) {
+			sine_table_free(&s->table);
+		}
+		s->total_frames = (uint64_t)duration * s->rate;
+		vcard_telemetry_init(&s->telemetry);
+
+		printf("%-20s %8.2f Hz  %s  %u Hz  period %lu  buffer %lu%s\n",
+		       s->name, f, s->format->name, s->rate, (unsigned long)s->period,
+		       (unsigned long)s->buffer_size,
+		       s->table.mode == SINE_TABLE_CACHED ? "  (cached)" : "");
+	}
+	vcard_telemetry_init(&engine.telemetry);
+
+	/* Keep every page resident so the engine never takes a page fault */
+	locked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+	VCARD_TRACE_START_FROM_ENV();
+
+	if (vcard_thread_create(&thread, engine_thread, &engine) != VCARD_SUCCESS) {
+		fprintf(stderr, "Error starting the engine thread\n");
+		close_streams(streams, num_streams);
+		return 1;
+	}
+
+	printf("\nPlaying...\n");
+	while (!vcard_atomic_load_acquire_u32(&engine.finished)) {
+		print_progress(&engine);
+		vcard_sleep_us(250000);
+	}
+	vcard_thread_join(&thread);
+	print_progress(&engine);
+	printf("\n\n");
+
+	if (!engine.realtime) {
+		printf("Warning: SCHED_FIFO not granted; ran with normal scheduling\n");
+	}
+	if (cpu >= 0 && !engine.pinned) {
+		printf("Warning: could not pin the engine to CPU %d\n", cpu);
+	}
+	if (!locked) {
+		printf("Warning: mlockall failed; memory was not locked\n");
+	}
+	for (unsigned int i = 0; i < num_streams; i++) {
+		stream_t *s = &streams[i];
+		vcard_status_t status;
+
+		vcard_telemetry_snapshot(&s->telemetry, &status);
+		printf("%-20s %10llu frames  xruns: %u  latency: %u us%s%s\n", s->name,
+		       (unsigned long long)vcard_atomic_load_relaxed_u64(&s->written),
+		       status.xruns, status.latency_us, s->error ? "  error: " : "",
+		       s->error ? snd_strerror(s->error) : "");
+		if (s->error) {
+			failed = 1;
+		} else {
+			/* Let the queued audio play out */
+			snd_pcm_nonblock(s->handle, 0);
+			snd_pcm_drain(s->handle);
+		}
+	}
+	if (engine.wakeups > 0) {
+		double budget_us = (double)streams[0].period * 1e6 / streams[0].rate;
+		double avg_us = (double)engine.total_ns / engine.wakeups / 1000.0;
+
+		printf("Engine: %llu wake-ups, CPU avg %.1f us, max %.1f us "
+		       "(%.2f%% of %.0f us period)%s\n",
+		       (unsigned long long)engine.wakeups, avg_us,
+		       engine.max_ns / 1000.0, avg_us / budget_us * 100.0, budget_us,
+		       engine.realtime ? ", SCHED_FIFO" : "");
+	}
+
+	close_streams(streams, num_streams);
+	VCARD_TRACE_STOP();
+	return failed;
+}
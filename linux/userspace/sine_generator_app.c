@@ -1,97 +1,582 @@
 /**
  * Sine Wave Generator Application
- * 
+ *
  * Generates a sine wave and plays it to the ALSA loopback device
- * Usage: ./sine_generator_app [frequency] [duration_seconds]
+ * Usage: ./sine_generator_app [--mmap] [--latency-probe] [--bits <16|24|32>]
+ *                             [--dither] [--rate <hz> | --rates <hz,hz,...>]
+ *                             [--cycles <n>] [--no-cache]
+ *                             [frequency] [duration_seconds]
+ *
+ *   --mmap            Render directly into the ALSA ring buffer with
+ *                     snd_pcm_mmap_begin/commit instead of copying each
+ *                     period through snd_pcm_writei
+ *   --latency-probe   Play timestamped MLS bursts instead of the tone, for
+ *                     test_loopback_read --latency
+ *   --bits            Sample depth (default 16): 24 negotiates S24_3LE or
+ *                     S24_LE, 32 negotiates S32_LE or FLOAT_LE
+ *   --dither          Add TPDF dither when converting to integer samples
+ *   --rate            Sample rate (default 48000)
+ *   --rates           Play duration_seconds at each rate in turn, draining
+ *                     and reconfiguring the open PCM between them instead
+ *                     of closing and reopening it
+ *   --cycles          Repeat the --rates list this many times (default 1)
+ *   --no-cache        Evaluate the sine every period instead of playing
+ *                     pre-rendered cycles (the cache is also skipped when
+ *                     dithering integer samples)
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <math.h>
+#include <time.h>
 #include <alsa/asoundlib.h>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
+#include "vcard.h"
+#include "sine_generator.h"
+#include "sine_table.h"
+#include "latency_probe.h"
+#include "vcard_telemetry.h"
+#include "vcard_thread.h"
+#include "vcard_trace.h"
 
 #define DEFAULT_FREQUENCY 440.0
 #define DEFAULT_DURATION 5
-#define SAMPLE_RATE 48000
+#define DEFAULT_SAMPLE_RATE 48000
+#define MAX_RATES 16
+#define MAX_CYCLES 1000
 #define CHANNELS 2
 #define BUFFER_SIZE 1024
 
+/* CPU time spent per period (render + transfer) */
 typedef struct {
-	double phase;
-	double frequency;
-	double sample_rate;
-	double amplitude;
-} sine_generator_t;
-
-static void sine_generator_init(sine_generator_t *gen, double frequency,
-				double sample_rate, double amplitude)
+	uint64_t periods;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint32_t delay;		/* Frames queued in the device after the last period */
+} cpu_stats_t;
+
+/* Live xrun, load and latency counters, shown with the progress line */
+static vcard_telemetry_t telemetry;
+
+/* Latency probe bursts, played instead of the sine when enabled */
+static latency_probe_t probe;
+static int probe_enabled;
+
+/* Negotiated sample format, and TPDF dither state when enabled */
+typedef struct {
+	snd_pcm_format_t alsa;
+	sine_format_t sine;
+	unsigned int bits;
+	const char *name;
+} pcm_format_t;
+
+static const pcm_format_t pcm_formats[] = {
+	{ SND_PCM_FORMAT_S16_LE, SINE_FORMAT_I16, VCARD_BIT_16, "S16_LE" },
+	{ SND_PCM_FORMAT_S24_3LE, SINE_FORMAT_I24, VCARD_BIT_24, "S24_3LE" },
+	{ SND_PCM_FORMAT_S24_LE, SINE_FORMAT_I24_32, VCARD_BIT_24, "S24_LE" },
+	{ SND_PCM_FORMAT_S32_LE, SINE_FORMAT_I32, VCARD_BIT_32, "S32_LE" },
+	{ SND_PCM_FORMAT_FLOAT_LE, SINE_FORMAT_F32, VCARD_BIT_32, "FLOAT_LE" },
+};
+
+static const pcm_format_t *pcm_format;
+static sine_writer_t writer;		/* Output kernel for pcm_format */
+static sine_dither_t dither;
+static int dither_enabled;
+
+/* Pre-rendered cycles (or wavetable lookup) replacing the generator */
+static sine_table_t table;
+static int table_enabled;
+
+/**
+ * Pick the first format of the requested depth the device accepts,
+ * falling back to the deepest format it accepts at all
+ */
+static const pcm_format_t *negotiate_format(snd_pcm_t *handle,
+					    snd_pcm_hw_params_t *params,
+					    unsigned int bits)
+{
+	size_t count = sizeof(pcm_formats) / sizeof(pcm_formats[0]);
+
+	for (size_t i = 0; i < count; i++) {
+		if (pcm_formats[i].bits == bits &&
+		    snd_pcm_hw_params_test_format(handle, params,
+						  pcm_formats[i].alsa) == 0) {
+			return &pcm_formats[i];
+		}
+	}
+	for (size_t i = count; i-- > 0;) {
+		if (snd_pcm_hw_params_test_format(handle, params,
+						  pcm_formats[i].alsa) == 0) {
+			return &pcm_formats[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Render interleaved frames, duplicating the mono signal on every channel
+ */
+static void render_frames(sine_generator_t *gen, void *dst,
+			  snd_pcm_uframes_t frames)
+{
+	if (probe_enabled) {
+		latency_probe_write_interleaved(&probe, dst, frames, CHANNELS,
+						pcm_format->sine, vcard_time_ns());
+		return;
+	}
+	if (table.mode != SINE_TABLE_NONE) {
+		sine_table_render(&table, &dst, frames);
+		return;
+	}
+	sine_writer_render(&writer, gen, &dst, frames, dither_enabled ? &dither : NULL);
+}
+
+/**
+ * Rebuild the cached cycles for the generator's current rate and phase.
+ * Without a short period the SIMD generator beats the interpolated
+ * lookup, so rendering falls back to it.
+ */
+static void setup_table(const sine_generator_t *gen)
+{
+	sine_table_free(&table);
+	if (!table_enabled || probe_enabled ||
+	    (dither_enabled && pcm_format->sine != SINE_FORMAT_F32)) {
+		return;
+	}
+	if (sine_table_init_sine(&table, &writer, gen) != VCARD_SUCCESS) {
+		return;
+	}
+	if (table.mode != SINE_TABLE_CACHED) {
+		sine_table_free(&table);
+		return;
+	}
+	printf("Signal: %zu cached frames (%zu cycles every %zu frames)\n",
+	       table.cache_frames, table.cycles, table.period_frames);
+}
+
+static uint64_t thread_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void cpu_stats_add(cpu_stats_t *stats, uint64_t ns)
+{
+	stats->periods++;
+	stats->total_ns += ns;
+	if (ns > stats->max_ns) {
+		stats->max_ns = ns;
+	}
+}
+
+static void cpu_stats_print(const cpu_stats_t *stats, const char *mode,
+			    snd_pcm_uframes_t period, unsigned int rate)
+{
+	double budget_us = (double)period * 1e6 / rate;
+	double avg_us;
+
+	if (stats->periods == 0) {
+		return;
+	}
+	avg_us = (double)stats->total_ns / stats->periods / 1000.0;
+	printf("CPU per period (%s): avg %.1f us, max %.1f us "
+	       "(%.2f%% of %.0f us period)\n",
+	       mode, avg_us, stats->max_ns / 1000.0,
+	       avg_us / budget_us * 100.0, budget_us);
+}
+
+/**
+ * Account for one period: CPU statistics, load and current latency
+ */
+static void record_period(snd_pcm_t *handle, cpu_stats_t *stats,
+			  snd_pcm_uframes_t frames, unsigned int rate,
+			  uint64_t busy_ns)
+{
+	snd_pcm_sframes_t delay;
+
+	cpu_stats_add(stats, busy_ns);
+	vcard_telemetry_period(&telemetry, (uint32_t)frames, rate, busy_ns);
+	if (snd_pcm_delay(handle, &delay) == 0 && delay >= 0) {
+		stats->delay = (uint32_t)delay;
+		vcard_telemetry_latency(&telemetry,
+					(uint32_t)((uint64_t)delay * 1000000u / rate));
+	}
+}
+
+static void print_progress(int frames_written, int total_frames)
+{
+	vcard_status_t status;
+
+	vcard_telemetry_snapshot(&telemetry, &status);
+	printf("\rProgress: %5.1f%%  xruns: %u  load: %5.2f%%  latency: %u us ",
+	       (float)frames_written / total_frames * 100.0f, status.xruns,
+	       status.cpu_load, status.latency_us);
+	fflush(stdout);
+}
+
+/**
+ * Recover from an underrun or suspend
+ */
+static int xrun_recovery(snd_pcm_t *handle, int err)
+{
+	if (err == -EPIPE) {
+		vcard_telemetry_xrun(&telemetry);
+		return snd_pcm_prepare(handle);
+	}
+	if (err == -ESTRPIPE) {
+		while ((err = snd_pcm_resume(handle)) == -EAGAIN) {
+			sleep(1);
+		}
+		if (err < 0) {
+			return snd_pcm_prepare(handle);
+		}
+		return 0;
+	}
+	return err;
+}
+
+/**
+ * Play using snd_pcm_writei from a staging buffer
+ */
+static int play_rw(snd_pcm_t *pcm_handle, sine_generator_t *gen,
+		   snd_pcm_uframes_t frames, unsigned int sample_rate,
+		   int total_frames, cpu_stats_t *stats)
+{
+	void *buffer;
+	int frames_written = 0;
+	int next_progress = sample_rate / 4;
+	int err;
+
+	buffer = malloc(frames * CHANNELS * sine_format_bytes(pcm_format->sine));
+	if (!buffer) {
+		fprintf(stderr, "Error allocating buffer\n");
+		return -ENOMEM;
+	}
+
+	while (frames_written < total_frames) {
+		uint64_t start = thread_cpu_ns();
+		VCARD_TRACE_BEGIN(trace);
+
+		/* Generate interleaved samples */
+		render_frames(gen, buffer, frames);
+
+		/* Write samples to device */
+		err = snd_pcm_writei(pcm_handle, buffer, frames);
+		record_period(pcm_handle, stats, frames, sample_rate,
+			      thread_cpu_ns() - start);
+		VCARD_TRACE_END(trace, "alsa.writei", frames, err > 0 ? err : 0,
+				stats->delay);
+		if (err == -EPIPE) {
+			/* Buffer underrun */
+			xrun_recovery(pcm_handle, err);
+		} else if (err < 0) {
+			fprintf(stderr, "Error writing to PCM device: %s\n",
+				snd_strerror(err));
+			break;
+		}
+
+		frames_written += frames;
+
+		/* Print progress */
+		if (frames_written >= next_progress) {
+			print_progress(frames_written, total_frames);
+			next_progress += sample_rate / 4;
+		}
+	}
+
+	free(buffer);
+	return 0;
+}
+
+/**
+ * Play by rendering directly into the mmap'd ALSA ring buffer
+ */
+static int play_mmap(snd_pcm_t *pcm_handle, sine_generator_t *gen,
+		     snd_pcm_uframes_t frames, unsigned int sample_rate,
+		     int total_frames, cpu_stats_t *stats)
+{
+	int frames_written = 0;
+	int next_progress = sample_rate / 4;
+	int first = 1;
+	int err;
+
+	while (frames_written < total_frames) {
+		snd_pcm_sframes_t avail;
+		snd_pcm_uframes_t remaining = frames;
+		uint64_t start;
+
+		if (snd_pcm_state(pcm_handle) == SND_PCM_STATE_XRUN) {
+			err = xrun_recovery(pcm_handle, -EPIPE);
+			if (err < 0) {
+				fprintf(stderr, "XRUN recovery failed: %s\n",
+					snd_strerror(err));
+				return err;
+			}
+			first = 1;
+		}
+
+		avail = snd_pcm_avail_update(pcm_handle);
+		if (avail < 0) {
+			err = xrun_recovery(pcm_handle, avail);
+			if (err < 0) {
+				fprintf(stderr, "avail update failed: %s\n",
+					snd_strerror(err));
+				return err;
+			}
+			first = 1;
+			continue;
+		}
+		if ((snd_pcm_uframes_t)avail < frames) {
+			if (first) {
+				/* Ring prefilled: start the stream */
+				first = 0;
+				err = snd_pcm_start(pcm_handle);
+				if (err < 0) {
+					fprintf(stderr, "Start error: %s\n",
+						snd_strerror(err));
+					return err;
+				}
+			} else {
+				err = snd_pcm_wait(pcm_handle, -1);
+				if (err < 0) {
+					err = xrun_recovery(pcm_handle, err);
+					if (err < 0) {
+						return err;
+					}
+					first = 1;
+				}
+			}
+			continue;
+		}
+
+		start = thread_cpu_ns();
+		VCARD_TRACE_BEGIN(trace);
+		while (remaining > 0) {
+			const snd_pcm_channel_area_t *areas;
+			snd_pcm_uframes_t offset;
+			snd_pcm_uframes_t size = remaining;
+			snd_pcm_sframes_t committed;
+			char *dst;
+
+			err = snd_pcm_mmap_begin(pcm_handle, &areas, &offset, &size);
+			if (err < 0) {
+				err = xrun_recovery(pcm_handle, err);
+				if (err < 0) {
+					return err;
+				}
+				first = 1;
+				break;
+			}
+
+			/* Interleaved: channel 0's area walks every frame */
+			dst = (char *)areas[0].addr +
+			      (areas[0].first + offset * areas[0].step) / 8;
+			render_frames(gen, dst, size);
+
+			committed = snd_pcm_mmap_commit(pcm_handle, offset, size);
+			if (committed < 0 || (snd_pcm_uframes_t)committed != size) {
+				err = xrun_recovery(pcm_handle,
+						    committed >= 0 ? -EPIPE : committed);
+				if (err < 0) {
+					return err;
+				}
+				first = 1;
+			}
+			remaining -= size;
+			frames_written += size;
+		}
+		record_period(pcm_handle, stats, frames, sample_rate,
+			      thread_cpu_ns() - start);
+		VCARD_TRACE_END(trace, "alsa.mmap", frames, frames - remaining,
+				stats->delay);
+
+		/* Print progress */
+		if (frames_written >= next_progress) {
+			print_progress(frames_written, total_frames);
+			next_progress += sample_rate / 4;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Apply hardware parameters to an open PCM in the OPEN or SETUP state
+ *
+ * Also used between rates: after snd_pcm_drain() the handle is back in
+ * SETUP and takes new parameters without being reopened.
+ */
+static int configure_pcm(snd_pcm_t *pcm_handle, int use_mmap, unsigned int bits,
+			 unsigned int *sample_rate, snd_pcm_uframes_t *frames)
 {
-	gen->phase = 0.0;
-	gen->frequency = frequency;
-	gen->sample_rate = sample_rate;
-	gen->amplitude = amplitude;
+	snd_pcm_hw_params_t *params;
+	int err;
+
+	/* Allocate hardware parameters object */
+	snd_pcm_hw_params_alloca(&params);
+
+	/* Fill it with default values */
+	snd_pcm_hw_params_any(pcm_handle, params);
+
+	/* Set hardware parameters */
+	snd_pcm_hw_params_set_access(pcm_handle, params,
+				     use_mmap ? SND_PCM_ACCESS_MMAP_INTERLEAVED :
+						SND_PCM_ACCESS_RW_INTERLEAVED);
+	pcm_format = negotiate_format(pcm_handle, params, bits);
+	if (!pcm_format) {
+		fprintf(stderr, "No supported sample format\n");
+		return -EINVAL;
+	}
+	snd_pcm_hw_params_set_format(pcm_handle, params, pcm_format->alsa);
+	sine_writer_init(&writer, pcm_format->sine, CHANNELS, 0);
+	snd_pcm_hw_params_set_channels(pcm_handle, params, CHANNELS);
+	snd_pcm_hw_params_set_rate_near(pcm_handle, params, sample_rate, 0);
+	snd_pcm_hw_params_set_period_size_near(pcm_handle, params, frames, 0);
+
+	/* Write parameters to device */
+	err = snd_pcm_hw_params(pcm_handle, params);
+	if (err < 0) {
+		fprintf(stderr, "Error setting HW params: %s\n",
+			snd_strerror(err));
+	}
+	return err;
 }
 
-static void sine_generator_process_i16(sine_generator_t *gen, int16_t *buffer,
-				       size_t num_samples)
+/**
+ * Parse a comma-separated rate list
+ *
+ * @return Number of rates, or 0 if the list is malformed
+ */
+static int parse_rates(const char *list, unsigned int *rates)
 {
-	double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
-	const double scale = 32767.0;
+	int count = 0;
 
-	for (size_t i = 0; i < num_samples; i++) {
-		double sample = gen->amplitude * sin(gen->phase);
-		buffer[i] = (int16_t)(sample * scale);
-		gen->phase += phase_increment;
+	while (*list && count < MAX_RATES) {
+		char *end;
+		long rate = strtol(list, &end, 10);
 
-		if (gen->phase >= 2.0 * M_PI) {
-			gen->phase -= 2.0 * M_PI;
+		if (end == list || rate < 8000 || rate > 192000 ||
+		    (*end != ',' && *end != '\0')) {
+			return 0;
 		}
+		rates[count++] = (unsigned int)rate;
+		list = *end ? end + 1 : end;
 	}
+	return *list ? 0 : count;
+}
+
+static void print_usage(const char *program_name)
+{
+	printf("Usage: %s [--mmap] [--latency-probe] [--bits <16|24|32>] [--dither]\n"
+	       "       [--rate <hz> | --rates <hz,hz,...>] [--cycles <n>] [--no-cache]\n"
+	       "       [frequency] [duration_seconds]\n", program_name);
 }
 
 int main(int argc, char *argv[])
 {
 	snd_pcm_t *pcm_handle;
-	snd_pcm_hw_params_t *params;
 	sine_generator_t gen;
-	int16_t *buffer;
+	cpu_stats_t stats = { 0, 0, 0, 0 };
 	double frequency = DEFAULT_FREQUENCY;
 	int duration = DEFAULT_DURATION;
+	int use_mmap = 0;
+	unsigned int bits = VCARD_BIT_16;
+	int positional = 0;
 	int err;
-	unsigned int sample_rate = SAMPLE_RATE;
+	unsigned int rates[MAX_RATES] = { DEFAULT_SAMPLE_RATE };
+	int num_rates = 1;
+	int cycles = 1;
+	unsigned int sample_rate;
 	snd_pcm_uframes_t frames = BUFFER_SIZE;
+	uint64_t switch_ns = 0;
+	int switches = 0;
+
+	table_enabled = 1;
 
 	/* Parse command line arguments */
-	if (argc >= 2) {
-		frequency = atof(argv[1]);
-		if (frequency <= 0 || frequency > 20000) {
-			fprintf(stderr, "Invalid frequency: %.2f Hz\n",
-				frequency);
-			return 1;
-		}
-	}
-	if (argc >= 3) {
-		duration = atoi(argv[2]);
-		if (duration <= 0 || duration > 60) {
-			fprintf(stderr, "Invalid duration: %d seconds\n",
-				duration);
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--mmap") == 0) {
+			use_mmap = 1;
+		} else if (strcmp(argv[i], "--latency-probe") == 0) {
+			probe_enabled = 1;
+		} else if (strcmp(argv[i], "--bits") == 0 && i + 1 < argc) {
+			bits = (unsigned int)atoi(argv[++i]);
+			if (bits != VCARD_BIT_16 && bits != VCARD_BIT_24 &&
+			    bits != VCARD_BIT_32) {
+				fprintf(stderr, "Invalid bit depth: %u\n", bits);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--dither") == 0) {
+			dither_enabled = 1;
+		} else if ((strcmp(argv[i], "--rate") == 0 ||
+			    strcmp(argv[i], "--rates") == 0) && i + 1 < argc) {
+			num_rates = parse_rates(argv[i + 1], rates);
+			if (num_rates == 0 ||
+			    (num_rates > 1 && strcmp(argv[i], "--rate") == 0)) {
+				fprintf(stderr, "Invalid sample rate: %s\n",
+					argv[i + 1]);
+				return 1;
+			}
+			i++;
+		} else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+			cycles = atoi(argv[++i]);
+			if (cycles <= 0 || cycles > MAX_CYCLES) {
+				fprintf(stderr, "Invalid cycle count: %d\n", cycles);
+				return 1;
+			}
+		} else if (strcmp(argv[i], "--no-cache") == 0) {
+			table_enabled = 0;
+		} else if (strcmp(argv[i], "-h") == 0 ||
+			   strcmp(argv[i], "--help") == 0) {
+			print_usage(argv[0]);
+			return 0;
+		} else if (positional == 0) {
+			frequency = atof(argv[i]);
+			if (frequency <= 0 || frequency > 20000) {
+				fprintf(stderr, "Invalid frequency: %.2f Hz\n",
+					frequency);
+				return 1;
+			}
+			positional++;
+		} else if (positional == 1) {
+			duration = atoi(argv[i]);
+			if (duration <= 0 || duration > 60) {
+				fprintf(stderr, "Invalid duration: %d seconds\n",
+					duration);
+				return 1;
+			}
+			positional++;
+		} else {
+			print_usage(argv[0]);
 			return 1;
 		}
 	}
 
 	printf("Sine Wave Generator\n");
 	printf("===================\n");
-	printf("Frequency: %.2f Hz\n", frequency);
-	printf("Duration: %d seconds\n", duration);
-	printf("Sample Rate: %d Hz\n", sample_rate);
+	if (probe_enabled) {
+		printf("Signal: latency probe bursts every %.0f ms\n",
+		       LATENCY_PROBE_DEFAULT_INTERVAL * 1000.0);
+	} else {
+		printf("Frequency: %.2f Hz\n", frequency);
+	}
+	printf("Duration: %d seconds%s\n", duration,
+	       num_rates > 1 ? " per rate" : "");
+	printf("Sample Rate:");
+	for (int r = 0; r < num_rates; r++) {
+		printf("%s %u", r ? "," : "", rates[r]);
+	}
+	printf(" Hz");
+	if (num_rates > 1 && cycles > 1) {
+		printf(" (x%d)", cycles);
+	}
+	printf("\n");
 	printf("Channels: %d\n", CHANNELS);
 	printf("Buffer Size: %lu frames\n", (unsigned long)frames);
+	printf("Access Mode: %s\n",
+	       use_mmap ? "mmap (zero-copy)" : "read/write (snd_pcm_writei)");
 	printf("\n");
 
 	/* Open PCM device for playback */
@@ -106,85 +591,99 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	/* Allocate hardware parameters object */
-	snd_pcm_hw_params_alloca(&params);
-
-	/* Fill it with default values */
-	snd_pcm_hw_params_any(pcm_handle, params);
-
-	/* Set hardware parameters */
-	snd_pcm_hw_params_set_access(pcm_handle, params,
-				     SND_PCM_ACCESS_RW_INTERLEAVED);
-	snd_pcm_hw_params_set_format(pcm_handle, params, SND_PCM_FORMAT_S16_LE);
-	snd_pcm_hw_params_set_channels(pcm_handle, params, CHANNELS);
-	snd_pcm_hw_params_set_rate_near(pcm_handle, params, &sample_rate, 0);
-	snd_pcm_hw_params_set_period_size_near(pcm_handle, params, &frames, 0);
-
-	/* Write parameters to device */
-	err = snd_pcm_hw_params(pcm_handle, params);
-	if (err < 0) {
-		fprintf(stderr, "Error setting HW params: %s\n",
-			snd_strerror(err));
+	sample_rate = rates[0];
+	if (configure_pcm(pcm_handle, use_mmap, bits, &sample_rate, &frames) < 0) {
 		snd_pcm_close(pcm_handle);
 		return 1;
 	}
 
-	/* Allocate buffer */
-	buffer = malloc(frames * CHANNELS * sizeof(int16_t));
-	if (!buffer) {
-		fprintf(stderr, "Error allocating buffer\n");
+	printf("Format: %s%s\n", pcm_format->name,
+	       pcm_format->bits != bits ? " (requested depth not supported)" :
+	       dither_enabled && pcm_format->sine != SINE_FORMAT_F32 ? ", TPDF dither" : "");
+
+	/* Initialize sine generator */
+	sine_generator_init(&gen, frequency, sample_rate, 0.5);
+	sine_dither_init(&dither, (uint32_t)vcard_time_ns());
+	setup_table(&gen);
+	if (probe_enabled &&
+	    latency_probe_init(&probe, sample_rate, LATENCY_PROBE_DEFAULT_INTERVAL,
+			       0.5) != 0) {
+		fprintf(stderr, "Unsupported sample rate for the latency probe: %u Hz\n",
+			sample_rate);
 		snd_pcm_close(pcm_handle);
 		return 1;
 	}
+	vcard_telemetry_init(&telemetry);
+	VCARD_TRACE_START_FROM_ENV();
 
-	/* Initialize sine generator */
-	sine_generator_init(&gen, frequency, sample_rate, 0.5);
+	printf(probe_enabled ? "Playing latency probe...\n" : "Playing sine wave...\n");
 
-	printf("Playing sine wave...\n");
+	for (int step = 0; step < num_rates * (num_rates > 1 ? cycles : 1); step++) {
+		/* Generate and play audio for specified duration */
+		int total_frames;
 
-	/* Generate and play audio for specified duration */
-	int total_frames = duration * sample_rate;
-	int frames_written = 0;
+		if (step > 0) {
+			uint64_t start = vcard_time_ns();
 
-	while (frames_written < total_frames) {
-		/* Generate interleaved stereo samples */
-		for (unsigned int i = 0; i < frames; i++) {
-			int16_t mono_sample;
-			sine_generator_process_i16(&gen, &mono_sample, 1);
-			/* Duplicate for stereo */
-			buffer[i * CHANNELS] = mono_sample;
-			buffer[i * CHANNELS + 1] = mono_sample;
+			/* Let the old rate play out, then reconfigure in place */
+			snd_pcm_drain(pcm_handle);
+			sample_rate = rates[step % num_rates];
+			frames = BUFFER_SIZE;
+			if (configure_pcm(pcm_handle, use_mmap, bits, &sample_rate,
+					  &frames) < 0) {
+				snd_pcm_close(pcm_handle);
+				VCARD_TRACE_STOP();
+				return 1;
+			}
+			/* Continue from the cached phase at the new rate */
+			if (table.mode != SINE_TABLE_NONE) {
+				gen.phase = sine_table_phase(&table);
+			}
+			sine_generator_set_sample_rate(&gen, sample_rate);
+			setup_table(&gen);
+			if (probe_enabled &&
+			    latency_probe_init(&probe, sample_rate,
+					       LATENCY_PROBE_DEFAULT_INTERVAL, 0.5) != 0) {
+				fprintf(stderr, "Unsupported sample rate for the latency probe: %u Hz\n",
+					sample_rate);
+				snd_pcm_close(pcm_handle);
+				VCARD_TRACE_STOP();
+				return 1;
+			}
+			switch_ns += vcard_time_ns() - start;
+			switches++;
+			printf("\nSwitched to %u Hz\n", sample_rate);
 		}
 
-		/* Write samples to device */
-		err = snd_pcm_writei(pcm_handle, buffer, frames);
-		if (err == -EPIPE) {
-			/* Buffer underrun */
-			fprintf(stderr, "Buffer underrun\n");
-			snd_pcm_prepare(pcm_handle);
-		} else if (err < 0) {
-			fprintf(stderr, "Error writing to PCM device: %s\n",
-				snd_strerror(err));
-			break;
+		total_frames = duration * sample_rate;
+		if (use_mmap) {
+			err = play_mmap(pcm_handle, &gen, frames, sample_rate,
+					total_frames, &stats);
+		} else {
+			err = play_rw(pcm_handle, &gen, frames, sample_rate,
+				      total_frames, &stats);
 		}
-
-		frames_written += frames;
-
-		/* Print progress */
-		if (frames_written % (sample_rate / 4) == 0) {
-			float progress = (float)frames_written / total_frames * 100.0f;
-			printf("\rProgress: %.1f%%", progress);
-			fflush(stdout);
+		if (err < 0) {
+			snd_pcm_close(pcm_handle);
+			VCARD_TRACE_STOP();
+			return 1;
 		}
+		print_progress(total_frames, total_frames);
 	}
 
-	printf("\rProgress: 100.0%%\n");
-	printf("Playback complete!\n");
+	printf("\nPlayback complete!\n");
+	cpu_stats_print(&stats, use_mmap ? "mmap" : "rw", frames, sample_rate);
+	printf("Xruns: %u\n", vcard_atomic_load_relaxed_u32(&telemetry.xruns));
+	if (switches > 0) {
+		printf("Rate switches: %d, avg %.1f ms each (drain + reconfigure)\n",
+		       switches, (double)switch_ns / switches / 1e6);
+	}
 
 	/* Cleanup */
-	free(buffer);
 	snd_pcm_drain(pcm_handle);
 	snd_pcm_close(pcm_handle);
+	sine_table_free(&table);
+	VCARD_TRACE_STOP();
 
 	return 0;
 }
@@ -2,50 +2,20 @@
  * Test Virtual Sine Device Configuration
  * 
  * Basic test to verify the virtual sine device can be built and
- * has the correct configuration options.
+ * has the correct configuration options. Exercises the common sine
+ * generator the device renders with.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include "sine_generator.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
-// Sine generator (copy from virtual_sine_device.c for testing)
-typedef struct {
-    double phase;
-    double frequency;
-    double sample_rate;
-    double amplitude;
-} sine_generator_t;
-
-static void sine_generator_init(sine_generator_t *gen, double frequency,
-                                double sample_rate, double amplitude)
-{
-    gen->phase = 0.0;
-    gen->frequency = frequency;
-    gen->sample_rate = sample_rate;
-    gen->amplitude = amplitude;
-}
-
-static void sine_generator_process_f32(sine_generator_t *gen, float *buffer,
-                                       size_t num_samples)
-{
-    double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
-    
-    for (size_t i = 0; i < num_samples; i++) {
-        buffer[i] = (float)(gen->amplitude * sin(gen->phase));
-        gen->phase += phase_increment;
-        
-        if (gen->phase >= 2.0 * M_PI) {
-            gen->phase -= 2.0 * M_PI;
-        }
-    }
-}
-
 int main(void)
 {
     sine_generator_t gen;
@@ -130,6 +100,32 @@ int main(void)
         test_passed = 0;
     }
     
+    // Test 6: Non-interleaved buffers match the interleaved stream
+    printf("Test 6: Non-interleaved buffer list... ");
+    {
+        float interleaved[64 * 2];
+        float left[64], right[64];
+        void *planes[2] = { left, right };
+        int planar_ok = 1;
+        
+        sine_generator_init(&gen, 440.0, 48000.0, 0.5);
+        sine_generator_write_interleaved(&gen, interleaved, 64, 2, SINE_FORMAT_F32);
+        sine_generator_init(&gen, 440.0, 48000.0, 0.5);
+        sine_generator_write_planar(&gen, planes, 64, 2, SINE_FORMAT_F32);
+        for (int i = 0; i < 64; i++) {
+            if (left[i] != interleaved[i * 2] || right[i] != interleaved[i * 2 + 1]) {
+                planar_ok = 0;
+                break;
+            }
+        }
+        if (planar_ok) {
+            printf("PASS\n");
+        } else {
+            printf("FAIL (planar and interleaved samples differ)\n");
+            test_passed = 0;
+        }
+    }
+    
     printf("\n");
     
     if (test_passed) {
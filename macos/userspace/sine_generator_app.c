@@ -2,21 +2,23 @@
  * Sine Wave Generator Application (macOS)
  * 
  * Generates a sine wave and plays it to a CoreAudio device
- * Usage: ./sine_generator_app [frequency] [duration_seconds]
+ * Usage: ./sine_generator_app [--latency-probe] [frequency] [duration_seconds]
+ *
+ *   --latency-probe   Play timestamped MLS bursts instead of the tone, for
+ *                     test_loopback_read --latency
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <math.h>
 #include <CoreAudio/CoreAudio.h>
 #include <AudioToolbox/AudioToolbox.h>
 #include <unistd.h>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
+#include "sine_generator.h"
+#include "latency_probe.h"
+#include "vcard_thread.h"
+#include "vcard_trace.h"
 
 #define DEFAULT_FREQUENCY 440.0
 #define DEFAULT_DURATION 5
@@ -24,45 +26,14 @@
 #define CHANNELS 2
 #define BUFFER_SIZE 1024
 
-typedef struct {
-	double phase;
-	double frequency;
-	double sample_rate;
-	double amplitude;
-} sine_generator_t;
-
 typedef struct {
 	sine_generator_t generator;
+	latency_probe_t probe;
+	int probe_enabled;		/* Play probe bursts instead of the sine */
 	int frames_remaining;
 	int total_frames;
 } audio_context_t;
 
-static void sine_generator_init(sine_generator_t *gen, double frequency,
-				double sample_rate, double amplitude)
-{
-	gen->phase = 0.0;
-	gen->frequency = frequency;
-	gen->sample_rate = sample_rate;
-	gen->amplitude = amplitude;
-}
-
-static void sine_generator_process_i16(sine_generator_t *gen, int16_t *buffer,
-				       size_t num_samples)
-{
-	double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
-	const double scale = 32767.0;
-
-	for (size_t i = 0; i < num_samples; i++) {
-		double sample = gen->amplitude * sin(gen->phase);
-		buffer[i] = (int16_t)(sample * scale);
-		gen->phase += phase_increment;
-
-		if (gen->phase >= 2.0 * M_PI) {
-			gen->phase -= 2.0 * M_PI;
-		}
-	}
-}
-
 // Audio callback function
 static OSStatus audio_callback(void *inRefCon,
 			       AudioUnitRenderActionFlags *ioActionFlags,
@@ -76,6 +47,7 @@ static OSStatus audio_callback(void *inRefCon,
 	(void)inBusNumber;
 	
 	audio_context_t *context = (audio_context_t *)inRefCon;
+	VCARD_TRACE_BEGIN(trace);
 	
 	if (context->frames_remaining <= 0) {
 		// Silence when done
@@ -83,6 +55,7 @@ static OSStatus audio_callback(void *inRefCon,
 			memset(ioData->mBuffers[i].mData, 0,
 			       ioData->mBuffers[i].mDataByteSize);
 		}
+		VCARD_TRACE_END(trace, "coreaudio.render", inNumberFrames, 0, inNumberFrames);
 		return noErr;
 	}
 	
@@ -94,12 +67,12 @@ static OSStatus audio_callback(void *inRefCon,
 	}
 	
 	// Generate interleaved stereo samples
-	for (UInt32 i = 0; i < frames_to_generate; i++) {
-		int16_t mono_sample;
-		sine_generator_process_i16(&context->generator, &mono_sample, 1);
-		// Duplicate for stereo
-		buffer[i * CHANNELS] = mono_sample;
-		buffer[i * CHANNELS + 1] = mono_sample;
+	if (context->probe_enabled) {
+		latency_probe_write_interleaved(&context->probe, buffer, frames_to_generate,
+						CHANNELS, SINE_FORMAT_I16, vcard_time_ns());
+	} else {
+		sine_generator_write_interleaved(&context->generator, buffer, frames_to_generate,
+						 CHANNELS, SINE_FORMAT_I16);
 	}
 	
 	// Fill rest with silence if needed
@@ -111,6 +84,9 @@ static OSStatus audio_callback(void *inRefCon,
 	
 	context->frames_remaining -= frames_to_generate;
 	
+	/* The HAL owns the queue; the IO buffer is what this period fills */
+	VCARD_TRACE_END(trace, "coreaudio.render", inNumberFrames, frames_to_generate,
+			inNumberFrames);
 	return noErr;
 }
 
@@ -122,7 +98,14 @@ int main(int argc, char *argv[])
 	AudioComponentInstance audio_unit;
 	audio_context_t context;
 
+	memset(&context, 0, sizeof(context));
+
 	/* Parse command line arguments */
+	if (argc >= 2 && strcmp(argv[1], "--latency-probe") == 0) {
+		context.probe_enabled = 1;
+		argv++;
+		argc--;
+	}
 	if (argc >= 2) {
 		frequency = atof(argv[1]);
 		if (frequency <= 0 || frequency > 20000) {
@@ -142,7 +125,12 @@ int main(int argc, char *argv[])
 
 	printf("Sine Wave Generator (macOS)\n");
 	printf("============================\n");
-	printf("Frequency: %.2f Hz\n", frequency);
+	if (context.probe_enabled) {
+		printf("Signal: latency probe bursts every %.0f ms\n",
+		       LATENCY_PROBE_DEFAULT_INTERVAL * 1000.0);
+	} else {
+		printf("Frequency: %.2f Hz\n", frequency);
+	}
 	printf("Duration: %d seconds\n", duration);
 	printf("Sample Rate: %d Hz\n", SAMPLE_RATE);
 	printf("Channels: %d\n", CHANNELS);
@@ -150,6 +138,7 @@ int main(int argc, char *argv[])
 
 	// Initialize sine generator
 	sine_generator_init(&context.generator, frequency, SAMPLE_RATE, 0.5);
+	latency_probe_init(&context.probe, SAMPLE_RATE, LATENCY_PROBE_DEFAULT_INTERVAL, 0.5);
 	context.total_frames = duration * SAMPLE_RATE;
 	context.frames_remaining = context.total_frames;
 
@@ -220,8 +209,9 @@ int main(int argc, char *argv[])
 		AudioComponentInstanceDispose(audio_unit);
 		return 1;
 	}
+	VCARD_TRACE_START_FROM_ENV();
 
-	printf("Playing sine wave...\n");
+	printf(context.probe_enabled ? "Playing latency probe...\n" : "Playing sine wave...\n");
 
 	// Start playback
 	err = AudioOutputUnitStart(audio_unit);
@@ -229,6 +219,7 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "Error: Could not start audio output (error: %d)\n", (int)err);
 		AudioUnitUninitialize(audio_unit);
 		AudioComponentInstanceDispose(audio_unit);
+		VCARD_TRACE_STOP();
 		return 1;
 	}
 
@@ -249,6 +240,7 @@ int main(int argc, char *argv[])
 	AudioOutputUnitStop(audio_unit);
 	AudioUnitUninitialize(audio_unit);
 	AudioComponentInstanceDispose(audio_unit);
+	VCARD_TRACE_STOP();
 
 	return 0;
 }
@@ -11,77 +11,157 @@
  *   -r <rate>        Sample rate in Hz (default: 48000)
  *   -c <channels>    Number of channels (default: 2)
  *   -a <amplitude>   Amplitude 0.0-1.0 (default: 0.5)
+ *   -b <frames>      Device IO buffer size in frames (default: device setting)
  *   -h               Show this help message
  * 
  * Examples:
  *   ./virtual_sine_device -f 440 -d "BlackHole 2ch"
  *   ./virtual_sine_device -f 880 -a 0.3
+ *   ./virtual_sine_device -d "BlackHole 2ch" -b 32
+ *
+ * The render callback fills whole blocks: one planar call for a
+ * non-interleaved buffer list (one buffer per channel, the output unit's
+ * canonical layout) or one interleaved call per buffer otherwise. On its
+ * first cycle the IO thread joins the device's os_workgroup, or on systems
+ * without workgroups takes a time-constraint policy sized to the period.
+ *
+ * -d names are resolved through the device discovery cache
+ * (common/device_cache.h), keyed to the device UID: a cached UID is
+ * translated straight to its AudioDeviceID, and only a miss walks the
+ * whole device list. A kAudioHardwarePropertyDevices listener drops the
+ * cache whenever devices come or go while the program runs.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <math.h>
 #include <signal.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <errno.h>
+#include <pthread.h>
+#include <Availability.h>
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
 #include <CoreAudio/CoreAudio.h>
 #include <AudioToolbox/AudioToolbox.h>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
+#if defined(__MAC_11_0)
+#include <os/workgroup.h>
+#define HAVE_OS_WORKGROUP 1
 #endif
+#include "sine_generator.h"
+#include "vcard_atomic.h"
+#include "vcard_telemetry.h"
+#include "vcard_trace.h"
+#include "device_cache.h"
+#include "vcard.h"
 
 #define DEFAULT_FREQUENCY 440.0
 #define DEFAULT_SAMPLE_RATE 48000
 #define DEFAULT_CHANNELS 2
 #define DEFAULT_AMPLITUDE 0.5
-#define BUFFER_SIZE 512
+#define MAX_CHANNELS 32
+#define MIN_BUFFER_FRAMES 8
+#define MAX_BUFFER_FRAMES 4096
+#define STOP_TIMEOUT_US 200000
 
-typedef struct {
-    double phase;
-    double frequency;
-    double sample_rate;
-    double amplitude;
-} sine_generator_t;
+/* Scheduling of the render thread, set up on its first cycle */
+enum {
+    RT_PENDING = 0,
+    RT_WORKGROUP_JOINED,     /* Joined the device workgroup; leave on stop */
+    RT_WORKGROUP_MEMBER,     /* The HAL had already joined it */
+    RT_TIME_CONSTRAINT,      /* Time-constraint policy set */
+    RT_FAILED,
+    RT_LEFT                  /* Left the workgroup while stopping */
+};
 
 typedef struct {
     sine_generator_t generator;
     int channels;
+    uint32_t sample_rate;
+    sine_format_t format;            /* Negotiated stream sample format */
+    uint32_t buffer_frames;          /* Device IO buffer size in use */
+    vcard_telemetry_t telemetry;     /* Updated by the render callback */
+    vcard_atomic_u32 rt_state;       /* RT_* */
+    vcard_atomic_u32 stopping;
+#ifdef HAVE_OS_WORKGROUP
+    os_workgroup_t workgroup;        /* Device IO workgroup, or NULL */
+    os_workgroup_join_token_s join_token;
+#endif
 } audio_context_t;
 
+/* Stream formats offered to the output unit, in order of preference */
+static const struct {
+    AudioFormatFlags flags;
+    UInt32 bits;
+    sine_format_t format;
+    const char *name;
+} stream_formats[] = {
+    { kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked | kAudioFormatFlagIsNonInterleaved,
+      32, SINE_FORMAT_F32, "32-bit float, non-interleaved" },
+    { kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked,
+      32, SINE_FORMAT_F32, "32-bit float, interleaved" },
+    { kAudioFormatFlagIsSignedInteger | kAudioFormatFlagIsPacked | kAudioFormatFlagIsNonInterleaved,
+      32, SINE_FORMAT_I32, "32-bit integer, non-interleaved" },
+    { kAudioFormatFlagIsSignedInteger | kAudioFormatFlagIsPacked,
+      16, SINE_FORMAT_I16, "16-bit integer, interleaved" },
+};
+
 static volatile int g_running = 1;
 
-static void sine_generator_init(sine_generator_t *gen, double frequency,
-                                double sample_rate, double amplitude)
+// -d name to device UID cache; its path is fixed before the listener starts
+static device_cache_t g_device_cache;
+
+static void signal_handler(int sig)
 {
-    gen->phase = 0.0;
-    gen->frequency = frequency;
-    gen->sample_rate = sample_rate;
-    gen->amplitude = amplitude;
+    (void)sig;
+    g_running = 0;
+    printf("\nShutting down...\n");
 }
 
-static void sine_generator_process_f32(sine_generator_t *gen, float *buffer,
-                                       size_t num_samples)
+// Time-constraint policy for the calling thread: one computation per IO period
+static int set_time_constraint_policy(uint32_t frames, uint32_t sample_rate)
 {
-    double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
+    mach_timebase_info_data_t timebase;
+    thread_time_constraint_policy_data_t policy;
+    uint64_t period_ns = (uint64_t)frames * 1000000000u / sample_rate;
+    uint64_t period;
     
-    for (size_t i = 0; i < num_samples; i++) {
-        buffer[i] = (float)(gen->amplitude * sin(gen->phase));
-        gen->phase += phase_increment;
-        
-        if (gen->phase >= 2.0 * M_PI) {
-            gen->phase -= 2.0 * M_PI;
-        }
+    if (mach_timebase_info(&timebase) != KERN_SUCCESS || timebase.numer == 0) {
+        return 0;
     }
+    period = period_ns * timebase.denom / timebase.numer;
+    policy.period = (uint32_t)period;
+    policy.computation = (uint32_t)(period / 2);
+    policy.constraint = (uint32_t)period;
+    policy.preemptible = 1;
+    
+    return thread_policy_set(pthread_mach_thread_np(pthread_self()),
+                             THREAD_TIME_CONSTRAINT_POLICY,
+                             (thread_policy_t)&policy,
+                             THREAD_TIME_CONSTRAINT_POLICY_COUNT) == KERN_SUCCESS;
 }
 
-static void signal_handler(int sig)
+// Called on the render thread's first cycle
+static uint32_t configure_render_thread(audio_context_t *context)
 {
-    (void)sig;
-    g_running = 0;
-    printf("\nShutting down...\n");
+#ifdef HAVE_OS_WORKGROUP
+    if (context->workgroup) {
+        if (__builtin_available(macOS 11.0, *)) {
+            int err = os_workgroup_join(context->workgroup, &context->join_token);
+            if (err == 0) {
+                return RT_WORKGROUP_JOINED;
+            }
+            if (err == EALREADY) {
+                return RT_WORKGROUP_MEMBER;
+            }
+        }
+    }
+#endif
+    return set_time_constraint_policy(context->buffer_frames, context->sample_rate) ?
+           RT_TIME_CONSTRAINT : RT_FAILED;
 }
 
 // Audio callback function - generates sine wave
@@ -97,27 +177,206 @@ static OSStatus audio_callback(void *inRefCon,
     (void)inBusNumber;
     
     audio_context_t *context = (audio_context_t *)inRefCon;
+    UInt64 start = AudioGetCurrentHostTime();
+    VCARD_TRACE_BEGIN(trace);
+    uint32_t rt_state = vcard_atomic_load_relaxed_u32(&context->rt_state);
+    
+    if (rt_state == RT_PENDING) {
+        vcard_atomic_store_release_u32(&context->rt_state, configure_render_thread(context));
+    }
+#ifdef HAVE_OS_WORKGROUP
+    else if (rt_state == RT_WORKGROUP_JOINED &&
+             vcard_atomic_load_acquire_u32(&context->stopping)) {
+        // A workgroup must be left by the thread that joined it
+        if (__builtin_available(macOS 11.0, *)) {
+            os_workgroup_leave(context->workgroup, &context->join_token);
+        }
+        vcard_atomic_store_release_u32(&context->rt_state, RT_LEFT);
+    }
+#endif
     
     if (!ioData || ioData->mNumberBuffers == 0) {
         return noErr;
     }
     
-    float *buffer = (float *)ioData->mBuffers[0].mData;
+    UInt32 buffers = ioData->mNumberBuffers;
+    void *planes[MAX_CHANNELS];
+    int planar = buffers > 1 && buffers <= MAX_CHANNELS;
     
-    // Generate mono samples and duplicate for all channels
-    for (UInt32 i = 0; i < inNumberFrames; i++) {
-        float mono_sample;
-        sine_generator_process_f32(&context->generator, &mono_sample, 1);
+    for (UInt32 i = 0; planar && i < buffers; i++) {
+        planes[i] = ioData->mBuffers[i].mData;
+        planar = ioData->mBuffers[i].mNumberChannels == 1;
+    }
+    
+    if (planar) {
+        // One buffer per channel: a single block call fills them all
+        sine_generator_write_planar(&context->generator, planes, inNumberFrames,
+                                    (unsigned int)buffers, context->format);
+    } else {
+        // Interleaved buffers; each one renders the same stretch of the wave
+        sine_generator_t block_start = context->generator;
         
-        // Duplicate for all channels
-        for (int ch = 0; ch < context->channels; ch++) {
-            buffer[i * context->channels + ch] = mono_sample;
+        for (UInt32 i = 0; i < buffers; i++) {
+            context->generator = block_start;
+            sine_generator_write_interleaved(&context->generator, ioData->mBuffers[i].mData,
+                                             inNumberFrames,
+                                             ioData->mBuffers[i].mNumberChannels,
+                                             context->format);
         }
     }
     
+    vcard_telemetry_period(&context->telemetry, inNumberFrames, context->sample_rate,
+                           AudioConvertHostTimeToNanos(AudioGetCurrentHostTime() - start));
+    VCARD_TRACE_END(trace, "coreaudio.render", inNumberFrames, inNumberFrames, inNumberFrames);
+    return noErr;
+}
+
+// Called by the HAL on its notification thread when an IO cycle overran
+static OSStatus overload_listener(AudioObjectID inObjectID,
+                                  UInt32 inNumberAddresses,
+                                  const AudioObjectPropertyAddress *inAddresses,
+                                  void *inClientData)
+{
+    (void)inObjectID;
+    (void)inNumberAddresses;
+    (void)inAddresses;
+    
+    audio_context_t *context = (audio_context_t *)inClientData;
+    vcard_telemetry_xrun(&context->telemetry);
     return noErr;
 }
 
+static UInt32 get_device_u32(AudioDeviceID device, AudioObjectPropertySelector selector,
+                             AudioObjectPropertyScope scope)
+{
+    AudioObjectPropertyAddress property_address = {
+        selector,
+        scope,
+        kAudioObjectPropertyElementMain
+    };
+    UInt32 value = 0;
+    UInt32 size = sizeof(value);
+    
+    if (AudioObjectGetPropertyData(device, &property_address, 0, NULL, &size, &value) != noErr) {
+        return 0;
+    }
+    return value;
+}
+
+// Output latency: device and safety offset plus one IO buffer, in microseconds
+static uint32_t query_output_latency_us(AudioDeviceID device, uint32_t sample_rate)
+{
+    UInt32 frames = get_device_u32(device, kAudioDevicePropertyLatency,
+                                   kAudioObjectPropertyScopeOutput) +
+                    get_device_u32(device, kAudioDevicePropertySafetyOffset,
+                                   kAudioObjectPropertyScopeOutput) +
+                    get_device_u32(device, kAudioDevicePropertyBufferFrameSize,
+                                   kAudioObjectPropertyScopeGlobal);
+    
+    return (uint32_t)((uint64_t)frames * 1000000u / sample_rate);
+}
+
+// Ask for an IO buffer of the given size, clamped to the device's range
+static UInt32 set_buffer_frame_size(AudioDeviceID device, UInt32 frames)
+{
+    AudioObjectPropertyAddress property_address = {
+        kAudioDevicePropertyBufferFrameSizeRange,
+        kAudioObjectPropertyScopeGlobal,
+        kAudioObjectPropertyElementMain
+    };
+    AudioValueRange range;
+    UInt32 size = sizeof(range);
+    
+    if (AudioObjectGetPropertyData(device, &property_address, 0, NULL, &size, &range) == noErr) {
+        if (frames < (UInt32)range.mMinimum) {
+            frames = (UInt32)range.mMinimum;
+        }
+        if (frames > (UInt32)range.mMaximum) {
+            frames = (UInt32)range.mMaximum;
+        }
+    }
+    
+    property_address.mSelector = kAudioDevicePropertyBufferFrameSize;
+    OSStatus err = AudioObjectSetPropertyData(device, &property_address, 0, NULL,
+                                              sizeof(frames), &frames);
+    if (err != noErr) {
+        fprintf(stderr, "Warning: Could not set IO buffer size to %u frames (error: %d)\n",
+                (unsigned int)frames, (int)err);
+    }
+    return get_device_u32(device, kAudioDevicePropertyBufferFrameSize,
+                          kAudioObjectPropertyScopeGlobal);
+}
+
+#ifdef HAVE_OS_WORKGROUP
+// Workgroup of the device's IO thread (retained), or NULL
+static os_workgroup_t query_io_workgroup(AudioDeviceID device)
+{
+    if (__builtin_available(macOS 11.0, *)) {
+        AudioObjectPropertyAddress property_address = {
+            kAudioDevicePropertyIOThreadOSWorkgroup,
+            kAudioObjectPropertyScopeGlobal,
+            kAudioObjectPropertyElementMain
+        };
+        os_workgroup_t workgroup = NULL;
+        UInt32 size = sizeof(workgroup);
+        
+        if (AudioObjectGetPropertyData(device, &property_address, 0, NULL,
+                                       &size, &workgroup) == noErr) {
+            return workgroup;
+        }
+    }
+    return NULL;
+}
+#endif
+
+// Set the first stream format the output unit accepts; returns its index or -1
+static int negotiate_stream_format(AudioComponentInstance audio_unit, int sample_rate,
+                                   int channels)
+{
+    for (size_t i = 0; i < sizeof(stream_formats) / sizeof(stream_formats[0]); i++) {
+        AudioStreamBasicDescription format;
+        UInt32 frame_bytes = stream_formats[i].bits / 8;
+        
+        if (!(stream_formats[i].flags & kAudioFormatFlagIsNonInterleaved)) {
+            frame_bytes *= (UInt32)channels;
+        }
+        memset(&format, 0, sizeof(format));
+        format.mSampleRate = sample_rate;
+        format.mFormatID = kAudioFormatLinearPCM;
+        format.mFormatFlags = stream_formats[i].flags;
+        format.mBytesPerPacket = frame_bytes;
+        format.mFramesPerPacket = 1;
+        format.mBytesPerFrame = frame_bytes;
+        format.mChannelsPerFrame = (UInt32)channels;
+        format.mBitsPerChannel = stream_formats[i].bits;
+        
+        if (AudioUnitSetProperty(audio_unit,
+                                 kAudioUnitProperty_StreamFormat,
+                                 kAudioUnitScope_Input,
+                                 0,
+                                 &format,
+                                 sizeof(format)) == noErr) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int device_name_equals(AudioDeviceID device, const char *device_name)
+{
+    AudioObjectPropertyAddress property_address = {
+        kAudioDevicePropertyDeviceName,
+        kAudioObjectPropertyScopeGlobal,
+        kAudioObjectPropertyElementMain
+    };
+    char name[256];
+    UInt32 size = sizeof(name);
+    
+    return AudioObjectGetPropertyData(device, &property_address, 0, NULL,
+                                      &size, name) == noErr &&
+           strcmp(name, device_name) == 0;
+}
+
 static AudioDeviceID find_device_by_name(const char *device_name)
 {
     AudioObjectPropertyAddress property_address = {
@@ -138,6 +397,9 @@ static AudioDeviceID find_device_by_name(const char *device_name)
     
     int device_count = size / sizeof(AudioDeviceID);
     AudioDeviceID *devices = (AudioDeviceID *)malloc(size);
+    if (devices == NULL) {
+        return kAudioDeviceUnknown;
+    }
     
     err = AudioObjectGetPropertyData(kAudioObjectSystemObject,
                                      &property_address,
@@ -151,20 +413,8 @@ static AudioDeviceID find_device_by_name(const char *device_name)
     }
     
     AudioDeviceID found_device = kAudioDeviceUnknown;
-    property_address.mSelector = kAudioDevicePropertyDeviceName;
-    
     for (int i = 0; i < device_count; i++) {
-        char name[256];
-        size = sizeof(name);
-        
-        err = AudioObjectGetPropertyData(devices[i],
-                                        &property_address,
-                                        0,
-                                        NULL,
-                                        &size,
-                                        name);
-        
-        if (err == noErr && strcmp(name, device_name) == 0) {
+        if (device_name_equals(devices[i], device_name)) {
             found_device = devices[i];
             break;
         }
@@ -174,6 +424,112 @@ static AudioDeviceID find_device_by_name(const char *device_name)
     return found_device;
 }
 
+// Persistent UID of a device; AudioDeviceIDs are not kept across restarts
+static int get_device_uid(AudioDeviceID device, char *uid, size_t size)
+{
+    AudioObjectPropertyAddress property_address = {
+        kAudioDevicePropertyDeviceUID,
+        kAudioObjectPropertyScopeGlobal,
+        kAudioObjectPropertyElementMain
+    };
+    CFStringRef string = NULL;
+    UInt32 data_size = sizeof(string);
+    int ok;
+    
+    if (AudioObjectGetPropertyData(device, &property_address, 0, NULL,
+                                   &data_size, &string) != noErr || string == NULL) {
+        return 0;
+    }
+    ok = CFStringGetCString(string, uid, (CFIndex)size, kCFStringEncodingUTF8);
+    CFRelease(string);
+    return ok;
+}
+
+static AudioDeviceID device_for_uid(const char *uid)
+{
+    CFStringRef string = CFStringCreateWithCString(NULL, uid, kCFStringEncodingUTF8);
+    AudioDeviceID device = kAudioDeviceUnknown;
+    
+    if (string == NULL) {
+        return kAudioDeviceUnknown;
+    }
+#if defined(__MAC_11_0)
+    AudioObjectPropertyAddress property_address = {
+        kAudioHardwarePropertyTranslateUIDToDevice,
+        kAudioObjectPropertyScopeGlobal,
+        kAudioObjectPropertyElementMain
+    };
+    UInt32 size = sizeof(device);
+    
+    if (AudioObjectGetPropertyData(kAudioObjectSystemObject, &property_address,
+                                   sizeof(string), &string, &size, &device) != noErr) {
+        device = kAudioDeviceUnknown;
+    }
+#else
+    AudioObjectPropertyAddress property_address = {
+        kAudioHardwarePropertyDeviceForUID,
+        kAudioObjectPropertyScopeGlobal,
+        kAudioObjectPropertyElementMain
+    };
+    AudioValueTranslation translation = { &string, sizeof(string), &device, sizeof(device) };
+    UInt32 size = sizeof(translation);
+    
+    if (AudioObjectGetPropertyData(kAudioObjectSystemObject, &property_address,
+                                   0, NULL, &size, &translation) != noErr) {
+        device = kAudioDeviceUnknown;
+    }
+#endif
+    CFRelease(string);
+    return device;
+}
+
+// Resolve a device name, trying the discovery cache before the device list
+static AudioDeviceID open_device_by_name(const char *device_name, int *cached)
+{
+    char path[DEVICE_CACHE_PATH_MAX];
+    char uid[DEVICE_CACHE_ID_MAX];
+    const char *cached_uid;
+    AudioDeviceID device;
+    
+    if (device_cache_default_path("coreaudio", path, sizeof(path)) != VCARD_SUCCESS) {
+        path[0] = '\0';
+    }
+    device_cache_load(&g_device_cache, path);
+    
+    *cached = 0;
+    cached_uid = device_cache_lookup(&g_device_cache, device_name);
+    if (cached_uid != NULL) {
+        device = device_for_uid(cached_uid);
+        if (device != kAudioDeviceUnknown && device_name_equals(device, device_name)) {
+            *cached = 1;
+            return device;
+        }
+        device_cache_remove(&g_device_cache, device_name);
+    }
+    
+    device = find_device_by_name(device_name);
+    if (device != kAudioDeviceUnknown && get_device_uid(device, uid, sizeof(uid))) {
+        device_cache_store(&g_device_cache, device_name, uid);
+    }
+    device_cache_save(&g_device_cache);
+    return device;
+}
+
+// Called by the HAL on its notification thread when devices come or go
+static OSStatus device_list_listener(AudioObjectID inObjectID,
+                                     UInt32 inNumberAddresses,
+                                     const AudioObjectPropertyAddress *inAddresses,
+                                     void *inClientData)
+{
+    (void)inObjectID;
+    (void)inNumberAddresses;
+    (void)inAddresses;
+    (void)inClientData;
+    
+    device_cache_invalidate(g_device_cache.path);
+    return noErr;
+}
+
 static void list_audio_devices(void)
 {
     AudioObjectPropertyAddress property_address = {
@@ -242,11 +598,13 @@ static void print_usage(const char *program_name)
     printf("  -r <rate>        Sample rate in Hz (default: %d)\n", DEFAULT_SAMPLE_RATE);
     printf("  -c <channels>    Number of channels (default: %d)\n", DEFAULT_CHANNELS);
     printf("  -a <amplitude>   Amplitude 0.0-1.0 (default: %.1f)\n", DEFAULT_AMPLITUDE);
+    printf("  -b <frames>      Device IO buffer size in frames, e.g. 32 or 64\n");
     printf("  -l               List available audio devices\n");
     printf("  -h               Show this help message\n");
     printf("\nExamples:\n");
     printf("  %s -f 440 -d \"BlackHole 2ch\"\n", program_name);
     printf("  %s -f 880 -a 0.3\n", program_name);
+    printf("  %s -d \"BlackHole 2ch\" -b 32\n", program_name);
     printf("\n");
 }
 
@@ -256,12 +614,13 @@ int main(int argc, char *argv[])
     int sample_rate = DEFAULT_SAMPLE_RATE;
     int channels = DEFAULT_CHANNELS;
     double amplitude = DEFAULT_AMPLITUDE;
+    int buffer_frames = 0;
     char *device_name = NULL;
     int list_devices = 0;
     int opt;
     
     // Parse command line options
-    while ((opt = getopt(argc, argv, "f:d:r:c:a:lh")) != -1) {
+    while ((opt = getopt(argc, argv, "f:d:r:c:a:b:lh")) != -1) {
         switch (opt) {
             case 'f':
                 frequency = atof(optarg);
@@ -282,7 +641,7 @@ int main(int argc, char *argv[])
                 break;
             case 'c':
                 channels = atoi(optarg);
-                if (channels < 1 || channels > 32) {
+                if (channels < 1 || channels > MAX_CHANNELS) {
                     fprintf(stderr, "Invalid channel count: %d\n", channels);
                     return 1;
                 }
@@ -294,6 +653,14 @@ int main(int argc, char *argv[])
                     return 1;
                 }
                 break;
+            case 'b':
+                buffer_frames = atoi(optarg);
+                if (buffer_frames < MIN_BUFFER_FRAMES || buffer_frames > MAX_BUFFER_FRAMES) {
+                    fprintf(stderr, "Invalid buffer size: %d frames (must be %d-%d)\n",
+                            buffer_frames, MIN_BUFFER_FRAMES, MAX_BUFFER_FRAMES);
+                    return 1;
+                }
+                break;
             case 'l':
                 list_devices = 1;
                 break;
@@ -323,8 +690,11 @@ int main(int argc, char *argv[])
     audio_context_t context;
     
     // Initialize sine generator
+    memset(&context, 0, sizeof(context));
     sine_generator_init(&context.generator, frequency, sample_rate, amplitude);
     context.channels = channels;
+    context.sample_rate = (uint32_t)sample_rate;
+    vcard_telemetry_init(&context.telemetry);
     
     // Set up signal handlers
     signal(SIGINT, signal_handler);
@@ -339,15 +709,18 @@ int main(int argc, char *argv[])
     desc.componentFlagsMask = 0;
     
     // If specific device is requested, use HAL output
+    AudioDeviceID device_id = kAudioDeviceUnknown;
     if (device_name != NULL) {
-        AudioDeviceID device_id = find_device_by_name(device_name);
+        int cached = 0;
+        device_id = open_device_by_name(device_name, &cached);
         if (device_id == kAudioDeviceUnknown) {
             fprintf(stderr, "Error: Device '%s' not found\n", device_name);
             printf("\nUse -l option to list available devices.\n");
             return 1;
         }
         
-        printf("Output Device: %s (ID: %u)\n", device_name, device_id);
+        printf("Output Device: %s (ID: %u%s)\n", device_name, device_id,
+               cached ? ", cached" : "");
         desc.componentSubType = kAudioUnitSubType_HALOutput;
     } else {
         printf("Output Device: System Default\n");
@@ -369,7 +742,6 @@ int main(int argc, char *argv[])
     
     // If specific device is requested, set it
     if (device_name != NULL) {
-        AudioDeviceID device_id = find_device_by_name(device_name);
         err = AudioUnitSetProperty(audio_unit,
                                   kAudioOutputUnitProperty_CurrentDevice,
                                   kAudioUnitScope_Global,
@@ -383,28 +755,15 @@ int main(int argc, char *argv[])
         }
     }
     
-    // Set audio format
-    AudioStreamBasicDescription format;
-    format.mSampleRate = sample_rate;
-    format.mFormatID = kAudioFormatLinearPCM;
-    format.mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked;
-    format.mBytesPerPacket = channels * sizeof(float);
-    format.mFramesPerPacket = 1;
-    format.mBytesPerFrame = channels * sizeof(float);
-    format.mChannelsPerFrame = channels;
-    format.mBitsPerChannel = 32;
-    
-    err = AudioUnitSetProperty(audio_unit,
-                              kAudioUnitProperty_StreamFormat,
-                              kAudioUnitScope_Input,
-                              0,
-                              &format,
-                              sizeof(format));
-    if (err != noErr) {
-        fprintf(stderr, "Error: Could not set audio format (error: %d)\n", (int)err);
+    // Set audio format: the callback follows whichever layout is accepted
+    int stream_format = negotiate_stream_format(audio_unit, sample_rate, channels);
+    if (stream_format < 0) {
+        fprintf(stderr, "Error: Could not set audio format\n");
         AudioComponentInstanceDispose(audio_unit);
         return 1;
     }
+    context.format = stream_formats[stream_format].format;
+    printf("Stream Format: %s\n", stream_formats[stream_format].name);
     
     // Set render callback
     AURenderCallbackStruct callback;
@@ -431,15 +790,67 @@ int main(int argc, char *argv[])
         return 1;
     }
     
+    // Watch the device actually in use for overloads and report its latency
+    AudioDeviceID output_device = kAudioDeviceUnknown;
+    UInt32 device_size = sizeof(output_device);
+    AudioObjectPropertyAddress overload_address = {
+        kAudioDeviceProcessorOverload,
+        kAudioObjectPropertyScopeGlobal,
+        kAudioObjectPropertyElementMain
+    };
+    err = AudioUnitGetProperty(audio_unit,
+                              kAudioOutputUnitProperty_CurrentDevice,
+                              kAudioUnitScope_Global,
+                              0,
+                              &output_device,
+                              &device_size);
+    if (err == noErr && output_device != kAudioDeviceUnknown) {
+        if (buffer_frames > 0) {
+            context.buffer_frames = set_buffer_frame_size(output_device, (UInt32)buffer_frames);
+        } else {
+            context.buffer_frames = get_device_u32(output_device,
+                                                   kAudioDevicePropertyBufferFrameSize,
+                                                   kAudioObjectPropertyScopeGlobal);
+        }
+#ifdef HAVE_OS_WORKGROUP
+        context.workgroup = query_io_workgroup(output_device);
+#endif
+        AudioObjectAddPropertyListener(output_device, &overload_address,
+                                       overload_listener, &context);
+        vcard_telemetry_latency(&context.telemetry,
+                                query_output_latency_us(output_device, context.sample_rate));
+    } else {
+        output_device = kAudioDeviceUnknown;
+    }
+    
+    // Keep the discovery cache honest for the next launch
+    AudioObjectPropertyAddress devices_address = {
+        kAudioHardwarePropertyDevices,
+        kAudioObjectPropertyScopeGlobal,
+        kAudioObjectPropertyElementMain
+    };
+    int devices_listening = g_device_cache.path[0] != '\0' &&
+                            AudioObjectAddPropertyListener(kAudioObjectSystemObject,
+                                                           &devices_address,
+                                                           device_list_listener,
+                                                           NULL) == noErr;
+    if (context.buffer_frames == 0) {
+        context.buffer_frames = buffer_frames > 0 ? (uint32_t)buffer_frames : 512;
+    }
+    printf("IO Buffer: %u frames (%.2f ms)\n", context.buffer_frames,
+           context.buffer_frames * 1000.0 / context.sample_rate);
+    
     printf("Starting sine wave generation...\n");
     printf("Press Ctrl+C to stop\n\n");
     
     // Start playback
+    VCARD_TRACE_START_FROM_ENV();
     err = AudioOutputUnitStart(audio_unit);
     if (err != noErr) {
         fprintf(stderr, "Error: Could not start audio output (error: %d)\n", (int)err);
         AudioUnitUninitialize(audio_unit);
         AudioComponentInstanceDispose(audio_unit);
+        VCARD_TRACE_STOP();
         return 1;
     }
     
@@ -453,16 +864,49 @@ int main(int argc, char *argv[])
         printf("  %s -d \"BlackHole 2ch\" -f %.0f\n", argv[0], frequency);
     }
     
-    // Keep running
+    // Keep running, reporting telemetry once per second
+    printf("\n");
     while (g_running) {
+        static const char *rt_names[] = {
+            "pending", "workgroup", "workgroup", "time-constraint", "default", "default"
+        };
+        vcard_status_t status;
+        
         sleep(1);
+        vcard_telemetry_snapshot(&context.telemetry, &status);
+        printf("\rFrames: %llu  xruns: %u  load: %5.2f%%  latency: %u us  rt: %s ",
+               (unsigned long long)status.frames_processed, status.xruns,
+               status.cpu_load, status.latency_us,
+               rt_names[vcard_atomic_load_acquire_u32(&context.rt_state)]);
+        fflush(stdout);
     }
     
     // Cleanup
     printf("\nStopping...\n");
+    // Give the render thread a few cycles to leave the workgroup it joined
+    vcard_atomic_store_release_u32(&context.stopping, 1);
+    for (int waited = 0; waited < STOP_TIMEOUT_US &&
+         vcard_atomic_load_acquire_u32(&context.rt_state) == RT_WORKGROUP_JOINED;
+         waited += 1000) {
+        usleep(1000);
+    }
     AudioOutputUnitStop(audio_unit);
+    if (output_device != kAudioDeviceUnknown) {
+        AudioObjectRemovePropertyListener(output_device, &overload_address,
+                                          overload_listener, &context);
+    }
+    if (devices_listening) {
+        AudioObjectRemovePropertyListener(kAudioObjectSystemObject, &devices_address,
+                                          device_list_listener, NULL);
+    }
     AudioUnitUninitialize(audio_unit);
     AudioComponentInstanceDispose(audio_unit);
+    VCARD_TRACE_STOP();
+#ifdef HAVE_OS_WORKGROUP
+    if (context.workgroup) {
+        os_release(context.workgroup);
+    }
+#endif
     
     printf("Stopped.\n");
     return 0;
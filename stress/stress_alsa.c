@@ -0,0 +1,170 @@
+/**
+ * Stress backend for ALSA loopback cables
+ *
+ * Device n plays to hw:Loopback,0,n and captures from hw:Loopback,1,n,
+ * the two ends of one snd-aloop substream, in FLOAT_LE. The capture
+ * read blocks on the cable's clock, so the backend is paced. Underruns
+ * and overruns are recovered with snd_pcm_recover and counted.
+ */
+
+#include "stress_backend.h"
+#include "vcard.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <alsa/asoundlib.h>
+
+/* snd-aloop substreams per cable */
+#define ALSA_MAX_SUBSTREAMS 8
+
+typedef struct {
+    snd_pcm_t *playback;
+    snd_pcm_t *capture;
+    uint32_t channels;
+    snd_pcm_uframes_t frames;
+    float *interleaved;         /* One period of channels samples per frame */
+} alsa_stream_t;
+
+static int alsa_configure(snd_pcm_t *pcm, const stress_config_t *config,
+                          unsigned int periods)
+{
+    snd_pcm_hw_params_t *params;
+    unsigned int rate = config->sample_rate;
+    snd_pcm_uframes_t period = config->buffer_size;
+    snd_pcm_uframes_t buffer = period * periods;
+
+    snd_pcm_hw_params_alloca(&params);
+    snd_pcm_hw_params_any(pcm, params);
+    if (snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED) < 0 ||
+        snd_pcm_hw_params_set_format(pcm, params, SND_PCM_FORMAT_FLOAT_LE) < 0 ||
+        snd_pcm_hw_params_set_channels(pcm, params, config->channels) < 0 ||
+        snd_pcm_hw_params_set_rate(pcm, params, rate, 0) < 0 ||
+        snd_pcm_hw_params_set_period_size(pcm, params, period, 0) < 0 ||
+        snd_pcm_hw_params_set_buffer_size_near(pcm, params, &buffer) < 0 ||
+        snd_pcm_hw_params(pcm, params) < 0) {
+        return VCARD_ERROR_INVALID;
+    }
+    return VCARD_SUCCESS;
+}
+
+/**
+ * Queue a playback buffer of silence; the PCM starts once it is full
+ */
+static void alsa_prefill(alsa_stream_t *s)
+{
+    memset(s->interleaved, 0, s->frames * s->channels * sizeof(float));
+    for (int i = 0; i < 2; i++) {
+        snd_pcm_writei(s->playback, s->interleaved, s->frames);
+    }
+}
+
+static void alsa_close(void *stream)
+{
+    alsa_stream_t *s = (alsa_stream_t *)stream;
+
+    if (s->playback) {
+        snd_pcm_close(s->playback);
+    }
+    if (s->capture) {
+        snd_pcm_close(s->capture);
+    }
+    free(s->interleaved);
+    free(s);
+}
+
+static int alsa_open(const stress_config_t *config, uint32_t index, void **stream)
+{
+    alsa_stream_t *s = (alsa_stream_t *)calloc(1, sizeof(*s));
+    char name[32];
+
+    if (!s) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    s->channels = config->channels;
+    s->frames = config->buffer_size;
+    s->interleaved = (float *)malloc(s->frames * s->channels * sizeof(float));
+    if (!s->interleaved) {
+        free(s);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+
+    snprintf(name, sizeof(name), "hw:Loopback,0,%u", index);
+    if (snd_pcm_open(&s->playback, name, SND_PCM_STREAM_PLAYBACK, 0) < 0) {
+        s->playback = NULL;
+        alsa_close(s);
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    snprintf(name, sizeof(name), "hw:Loopback,1,%u", index);
+    if (snd_pcm_open(&s->capture, name, SND_PCM_STREAM_CAPTURE, 0) < 0) {
+        s->capture = NULL;
+        alsa_close(s);
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    if (alsa_configure(s->playback, config, 2) != VCARD_SUCCESS ||
+        alsa_configure(s->capture, config, 4) != VCARD_SUCCESS) {
+        alsa_close(s);
+        return VCARD_ERROR_INVALID;
+    }
+    alsa_prefill(s);
+    *stream = s;
+    return VCARD_SUCCESS;
+}
+
+static int alsa_exchange(void *stream, const float *const *out, float *const *in,
+                         uint64_t *ready_ns)
+{
+    alsa_stream_t *s = (alsa_stream_t *)stream;
+    snd_pcm_uframes_t done = 0;
+    int xruns = 0;
+
+    // Capture first: it blocks until the cable has delivered a period
+    while (done < s->frames) {
+        snd_pcm_sframes_t n = snd_pcm_readi(s->capture, s->interleaved + done * s->channels,
+                                            s->frames - done);
+        if (n < 0) {
+            if (n == -EPIPE) {
+                xruns++;
+            }
+            if (snd_pcm_recover(s->capture, (int)n, 1) < 0) {
+                return -1;
+            }
+            continue;
+        }
+        done += (snd_pcm_uframes_t)n;
+    }
+    *ready_ns = vcard_time_ns();
+    for (uint32_t ch = 0; ch < s->channels; ch++) {
+        for (snd_pcm_uframes_t i = 0; i < s->frames; i++) {
+            in[ch][i] = s->interleaved[i * s->channels + ch];
+        }
+    }
+
+    for (uint32_t ch = 0; ch < s->channels; ch++) {
+        for (snd_pcm_uframes_t i = 0; i < s->frames; i++) {
+            s->interleaved[i * s->channels + ch] = out[ch][i];
+        }
+    }
+    done = 0;
+    while (done < s->frames) {
+        snd_pcm_sframes_t n = snd_pcm_writei(s->playback,
+                                             s->interleaved + done * s->channels,
+                                             s->frames - done);
+        if (n < 0) {
+            if (n == -EPIPE) {
+                xruns++;
+            }
+            if (snd_pcm_recover(s->playback, (int)n, 1) < 0) {
+                return -1;
+            }
+            continue;
+        }
+        done += (snd_pcm_uframes_t)n;
+    }
+    return xruns;
+}
+
+const stress_backend_t stress_backend_alsa = {
+    "alsa", 1, ALSA_MAX_SUBSTREAMS,
+    alsa_open, alsa_exchange, alsa_close
+};
@@ -0,0 +1,95 @@
+/**
+ * Virtual Sound Card - Stress Harness Backends
+ *
+ * A backend carries one device's streams for vcard_stress: each period
+ * the harness hands it buffer_size frames of planar output and takes
+ * back buffer_size frames of input. Every device runs on its own thread,
+ * so a backend stream is only used by one thread at a time.
+ *
+ * Paced backends block in exchange() on the device clock, as a real audio
+ * callback would. Unpaced backends return at once, and the harness
+ * sleeps between periods to the period deadlines.
+ */
+
+#ifndef STRESS_BACKEND_H
+#define STRESS_BACKEND_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * One trial configuration
+ */
+typedef struct {
+    uint32_t devices;
+    uint32_t channels;          /* Channels per device, in and out */
+    uint32_t sample_rate;
+    uint32_t buffer_size;       /* Frames per period */
+} stress_config_t;
+
+typedef struct {
+    const char *name;
+    int paced;                  /* exchange() waits for the device clock */
+    uint32_t max_devices;
+
+    /**
+     * Open device index of a trial
+     *
+     * @param config Trial configuration
+     * @param index Device index (0 to devices - 1)
+     * @param stream Output parameter for the backend's stream
+     * @return 0 on success, VCARD_ERROR_* on failure
+     */
+    int (*open)(const stress_config_t *config, uint32_t index, void **stream);
+
+    /**
+     * Write one period of output and read one period of input
+     *
+     * @param stream Stream from open()
+     * @param out channels planar buffers of buffer_size frames
+     * @param in channels planar buffers of buffer_size frames
+     * @param ready_ns Paced backends: output parameter for the
+     *                 vcard_time_ns() at which the input became available
+     * @return Xruns detected and recovered (0 normally), or < 0 if the
+     *         stream failed
+     */
+    int (*exchange)(void *stream, const float *const *out, float *const *in,
+                    uint64_t *ready_ns);
+
+    /**
+     * Close a stream
+     */
+    void (*close)(void *stream);
+} stress_backend_t;
+
+/* In-process device engine (vcard.h) */
+extern const stress_backend_t stress_backend_engine;
+
+#ifdef VCARD_STRESS_ALSA
+/* snd-aloop playback/capture pairs */
+extern const stress_backend_t stress_backend_alsa;
+#endif
+
+#ifdef VCARD_STRESS_JACK
+/* JACK clients with their outputs connected to their inputs */
+extern const stress_backend_t stress_backend_jack;
+#endif
+
+#ifdef VCARD_STRESS_WASAPI
+/* Default render endpoint with a loopback capture stream */
+extern const stress_backend_t stress_backend_wasapi;
+#endif
+
+#ifdef VCARD_STRESS_COREAUDIO
+/* A loopback device such as BlackHole, driven by an IOProc */
+extern const stress_backend_t stress_backend_coreaudio;
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STRESS_BACKEND_H */
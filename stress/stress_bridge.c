@@ -0,0 +1,209 @@
+/**
+ * Virtual Sound Card - Stress Harness Callback Bridge Implementation
+ */
+
+#include "stress_bridge.h"
+#include "vcard.h"
+#include "vcard_thread.h"
+#include <string.h>
+
+/* Harness wait for input before the device counts as stalled */
+#define BRIDGE_TIMEOUT_NS 1000000000ull
+
+/* Periods of each size the rings hold */
+#define BRIDGE_RING_PERIODS 4
+
+int stress_bridge_init(stress_bridge_t *bridge, uint32_t channels, uint32_t frames,
+                       uint32_t device_frames, uint32_t sample_rate)
+{
+    uint32_t capacity;
+    uint64_t period_us;
+
+    memset(bridge, 0, sizeof(*bridge));
+    if (channels == 0 || channels > VCARD_MAX_CHANNELS || frames == 0 || sample_rate == 0) {
+        return VCARD_ERROR_INVALID;
+    }
+    capacity = (frames + device_frames) * channels * BRIDGE_RING_PERIODS;
+    if (ring_buffer_init(&bridge->out, capacity) != VCARD_SUCCESS) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    if (ring_buffer_init(&bridge->in, capacity) != VCARD_SUCCESS) {
+        ring_buffer_free(&bridge->out);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    bridge->channels = channels;
+    bridge->frames = frames;
+    bridge->device_frames = device_frames;
+
+    // Check for input a few times a period, without spinning
+    period_us = (uint64_t)frames * 1000000 / sample_rate;
+    bridge->poll_us = period_us / 8 > 20 ? (uint32_t)(period_us / 8) : 20;
+    return VCARD_SUCCESS;
+}
+
+void stress_bridge_free(stress_bridge_t *bridge)
+{
+    ring_buffer_free(&bridge->out);
+    ring_buffer_free(&bridge->in);
+}
+
+/**
+ * Interleave planes into a ring region starting at sample offset
+ */
+static void interleave(float *dst, uint32_t count, uint32_t offset, uint32_t channels,
+                       const float *const *planes, size_t stride)
+{
+    uint32_t ch = offset % channels;
+    size_t frame = offset / channels;
+
+    for (uint32_t i = 0; i < count; i++) {
+        dst[i] = planes ? planes[ch][frame * stride] : 0.0f;
+        if (++ch == channels) {
+            ch = 0;
+            frame++;
+        }
+    }
+}
+
+/**
+ * Deinterleave a ring region starting at sample offset into planes
+ */
+static void deinterleave(const float *src, uint32_t count, uint32_t offset, uint32_t channels,
+                         float *const *planes, size_t stride)
+{
+    uint32_t ch = offset % channels;
+    size_t frame = offset / channels;
+
+    for (uint32_t i = 0; i < count; i++) {
+        planes[ch][frame * stride] = src[i];
+        if (++ch == channels) {
+            ch = 0;
+            frame++;
+        }
+    }
+}
+
+static void silence(float *const *planes, uint32_t channels, size_t stride,
+                    uint32_t first, uint32_t frames)
+{
+    for (uint32_t ch = 0; ch < channels; ch++) {
+        for (uint32_t i = first; i < frames; i++) {
+            planes[ch][(size_t)i * stride] = 0.0f;
+        }
+    }
+}
+
+void stress_bridge_capture(stress_bridge_t *bridge, const float *const *planes,
+                           uint32_t stride, uint32_t frames)
+{
+    uint32_t need = frames * bridge->channels;
+    float *r1, *r2;
+    uint32_t s1, s2;
+
+    if (!vcard_atomic_load_acquire_u32(&bridge->running)) {
+        return;
+    }
+    if (ring_buffer_get_write_regions(&bridge->in, need, &r1, &s1, &r2, &s2) < need) {
+        // The harness stopped taking input: an overrun
+        vcard_atomic_fetch_add_u32(&bridge->xruns, 1);
+        return;
+    }
+    interleave(r1, s1, 0, bridge->channels, planes, stride);
+    if (r2) {
+        interleave(r2, s2, s1, bridge->channels, planes, stride);
+    }
+    vcard_atomic_store_relaxed_u64(&bridge->ready_ns, vcard_time_ns());
+    ring_buffer_commit_write(&bridge->in, need);
+}
+
+void stress_bridge_playback(stress_bridge_t *bridge, float *const *planes,
+                            uint32_t stride, uint32_t frames)
+{
+    uint32_t need = frames * bridge->channels;
+    const float *r1, *r2;
+    uint32_t s1, s2, got;
+
+    if (!vcard_atomic_load_acquire_u32(&bridge->running)) {
+        silence(planes, bridge->channels, stride, 0, frames);
+        return;
+    }
+    got = ring_buffer_get_read_regions(&bridge->out, need, &r1, &s1, &r2, &s2);
+    if (got) {
+        deinterleave(r1, s1, 0, bridge->channels, planes, stride);
+        if (r2) {
+            deinterleave(r2, s2, s1, bridge->channels, planes, stride);
+        }
+        ring_buffer_commit_read(&bridge->out, got);
+    }
+    if (got < need) {
+        // The harness was late with this period: an underrun
+        silence(planes, bridge->channels, stride, got / bridge->channels, frames);
+        vcard_atomic_fetch_add_u32(&bridge->xruns, 1);
+    }
+}
+
+void stress_bridge_xrun(stress_bridge_t *bridge)
+{
+    vcard_atomic_fetch_add_u32(&bridge->xruns, 1);
+}
+
+void stress_bridge_fail(stress_bridge_t *bridge)
+{
+    vcard_atomic_store_release_u32(&bridge->failed, 1);
+}
+
+/**
+ * Queue frames of the harness's output, silence when out is NULL
+ */
+static void queue_output(stress_bridge_t *bridge, const float *const *out, uint32_t frames)
+{
+    uint32_t need = frames * bridge->channels;
+    float *r1, *r2;
+    uint32_t s1, s2, room;
+
+    room = ring_buffer_get_write_regions(&bridge->out, need, &r1, &s1, &r2, &s2);
+    if (room < need) {
+        // Never expected: the callback drains at least as fast as it captures
+        vcard_atomic_fetch_add_u32(&bridge->xruns, 1);
+        return;
+    }
+    interleave(r1, s1, 0, bridge->channels, out, 1);
+    if (r2) {
+        interleave(r2, s2, s1, bridge->channels, out, 1);
+    }
+    ring_buffer_commit_write(&bridge->out, need);
+}
+
+int stress_bridge_exchange(stress_bridge_t *bridge, const float *const *out,
+                           float *const *in, uint64_t *ready_ns)
+{
+    uint32_t need = bridge->frames * bridge->channels;
+    const float *r1, *r2;
+    uint32_t s1, s2;
+    uint64_t deadline;
+
+    if (!vcard_atomic_load_relaxed_u32(&bridge->running)) {
+        // One device period of slack, as a callback's own double buffering
+        queue_output(bridge, NULL, bridge->device_frames);
+        queue_output(bridge, out, bridge->frames);
+        vcard_atomic_store_release_u32(&bridge->running, 1);
+    } else {
+        queue_output(bridge, out, bridge->frames);
+    }
+
+    deadline = vcard_time_ns() + BRIDGE_TIMEOUT_NS;
+    while (ring_buffer_read_available(&bridge->in) < need) {
+        if (vcard_atomic_load_acquire_u32(&bridge->failed) || vcard_time_ns() > deadline) {
+            return -1;
+        }
+        vcard_sleep_us(bridge->poll_us);
+    }
+    ring_buffer_get_read_regions(&bridge->in, need, &r1, &s1, &r2, &s2);
+    deinterleave(r1, s1, 0, bridge->channels, in, 1);
+    if (r2) {
+        deinterleave(r2, s2, s1, bridge->channels, in, 1);
+    }
+    ring_buffer_commit_read(&bridge->in, need);
+    *ready_ns = vcard_atomic_load_relaxed_u64(&bridge->ready_ns);
+    return (int)vcard_atomic_exchange_u32(&bridge->xruns, 0);
+}
@@ -0,0 +1,105 @@
+/**
+ * Virtual Sound Card - Stress Harness Callback Bridge
+ *
+ * Callback-driven backends (JACK, WASAPI, CoreAudio) run the device on
+ * their own I/O thread at the device's period, while vcard_stress drives
+ * each device from a thread of its own at the trial's period. The bridge
+ * joins the two with a pair of lock-free rings: the I/O callback pushes
+ * the input it captured and pulls the output the harness queued, and the
+ * harness side of exchange() queues a period of output and then waits for
+ * a period of input.
+ *
+ * The callback side never blocks or allocates. Output missing when the
+ * callback needs it (the harness was late) is played as silence and
+ * counted as an xrun, as is input with no room left in its ring. Until
+ * the first exchange the callback plays silence and discards its input,
+ * so opening and starting a trial are not counted.
+ */
+
+#ifndef STRESS_BRIDGE_H
+#define STRESS_BRIDGE_H
+
+#include "ring_buffer.h"
+#include "vcard_atomic.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    ring_buffer_t out;          /* Harness to callback, interleaved */
+    ring_buffer_t in;           /* Callback to harness, interleaved */
+    uint32_t channels;
+    uint32_t frames;            /* Harness period */
+    uint32_t device_frames;     /* Callback period, queued as silence up front */
+    uint32_t poll_us;           /* Harness wait between input checks */
+    vcard_atomic_u32 running;   /* Set by the first exchange */
+    vcard_atomic_u32 failed;    /* The device stopped for good */
+    vcard_atomic_u32 xruns;     /* Since the last exchange */
+    vcard_atomic_u64 ready_ns;  /* vcard_time_ns() of the latest capture */
+} stress_bridge_t;
+
+/**
+ * Initialize a bridge
+ *
+ * @param bridge Bridge to initialize
+ * @param channels Channels in each direction
+ * @param frames Harness period in frames
+ * @param device_frames Largest period the callback is expected to run at
+ * @param sample_rate Device sample rate, for the wait granularity
+ * @return 0 on success, VCARD_ERROR_* on failure
+ */
+int stress_bridge_init(stress_bridge_t *bridge, uint32_t channels, uint32_t frames,
+                       uint32_t device_frames, uint32_t sample_rate);
+
+/**
+ * Free a bridge whose callback has stopped
+ */
+void stress_bridge_free(stress_bridge_t *bridge);
+
+/**
+ * Queue captured input (I/O callback)
+ *
+ * @param bridge Bridge
+ * @param planes Channel c's first sample at planes[c], or NULL for silence
+ * @param stride Samples between consecutive frames of one channel
+ * @param frames Frames captured
+ */
+void stress_bridge_capture(stress_bridge_t *bridge, const float *const *planes,
+                           uint32_t stride, uint32_t frames);
+
+/**
+ * Fill a callback's output from the queued periods (I/O callback)
+ *
+ * @param bridge Bridge
+ * @param planes Channel c's first sample at planes[c]
+ * @param stride Samples between consecutive frames of one channel
+ * @param frames Frames wanted
+ */
+void stress_bridge_playback(stress_bridge_t *bridge, float *const *planes,
+                            uint32_t stride, uint32_t frames);
+
+/**
+ * Count an xrun the device reported (any thread)
+ */
+void stress_bridge_xrun(stress_bridge_t *bridge);
+
+/**
+ * Mark the device as gone, failing the waiting and later exchanges (any thread)
+ */
+void stress_bridge_fail(stress_bridge_t *bridge);
+
+/**
+ * Harness side of stress_backend_t.exchange()
+ *
+ * Gives up with -1 when no input arrives for a second.
+ */
+int stress_bridge_exchange(stress_bridge_t *bridge, const float *const *out,
+                           float *const *in, uint64_t *ready_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STRESS_BRIDGE_H */
@@ -0,0 +1,321 @@
+/**
+ * Stress backend for CoreAudio (macOS)
+ *
+ * The device is one loopback device whose output comes back on its input,
+ * such as BlackHole: "BlackHole 2ch" unless VCARD_STRESS_COREAUDIO_DEVICE
+ * names another. An IOProc on the device exchanges periods with the
+ * harness through a stress_bridge_t, so the backend is paced by the
+ * device clock. The device is switched to the trial's sample rate and
+ * asked for an IO buffer of the trial's period.
+ *
+ * The HAL hands IOProcs 32-bit float buffers, either one interleaved
+ * buffer per direction or one buffer per channel; a trial opens when the
+ * device has at least its channel count in both directions. Every device
+ * would share the one loopback device, so there is one. Processor
+ * overloads count as xruns.
+ */
+
+#ifdef __APPLE__
+
+#include "stress_backend.h"
+#include "stress_bridge.h"
+#include "vcard.h"
+#include <stdlib.h>
+#include <string.h>
+#include <CoreAudio/CoreAudio.h>
+
+#define COREAUDIO_DEFAULT_DEVICE "BlackHole 2ch"
+
+typedef struct {
+    uint32_t stride;            /* Samples per frame in one buffer */
+    int split;                  /* One buffer per channel */
+} coreaudio_layout_t;
+
+typedef struct {
+    AudioDeviceID device;
+    AudioDeviceIOProcID proc;
+    uint32_t channels;
+    coreaudio_layout_t in_layout;
+    coreaudio_layout_t out_layout;
+    int bridged;                /* bridge initialized */
+    int listening;              /* overload listener installed */
+    stress_bridge_t bridge;
+} coreaudio_stream_t;
+
+static const AudioObjectPropertyAddress overload_address = {
+    kAudioDeviceProcessorOverload,
+    kAudioObjectPropertyScopeGlobal,
+    kAudioObjectPropertyElementMain
+};
+
+static int coreaudio_name_equals(AudioDeviceID device, const char *device_name)
+{
+    AudioObjectPropertyAddress property_address = {
+        kAudioDevicePropertyDeviceName,
+        kAudioObjectPropertyScopeGlobal,
+        kAudioObjectPropertyElementMain
+    };
+    char name[256];
+    UInt32 size = sizeof(name);
+
+    return AudioObjectGetPropertyData(device, &property_address, 0, NULL,
+                                      &size, name) == noErr &&
+           strcmp(name, device_name) == 0;
+}
+
+static AudioDeviceID coreaudio_find_device(const char *device_name)
+{
+    AudioObjectPropertyAddress property_address = {
+        kAudioHardwarePropertyDevices,
+        kAudioObjectPropertyScopeGlobal,
+        kAudioObjectPropertyElementMain
+    };
+    AudioDeviceID found = kAudioDeviceUnknown;
+    AudioDeviceID *devices;
+    UInt32 size = 0;
+
+    if (AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &property_address,
+                                       0, NULL, &size) != noErr) {
+        return kAudioDeviceUnknown;
+    }
+    devices = (AudioDeviceID *)malloc(size);
+    if (!devices) {
+        return kAudioDeviceUnknown;
+    }
+    if (AudioObjectGetPropertyData(kAudioObjectSystemObject, &property_address,
+                                   0, NULL, &size, devices) == noErr) {
+        for (UInt32 i = 0; i < size / sizeof(AudioDeviceID); i++) {
+            if (coreaudio_name_equals(devices[i], device_name)) {
+                found = devices[i];
+                break;
+            }
+        }
+    }
+    free(devices);
+    return found;
+}
+
+/**
+ * Read how one direction's channels are laid out in the IOProc buffers
+ */
+static int coreaudio_layout(AudioDeviceID device, AudioObjectPropertyScope scope,
+                            uint32_t channels, coreaudio_layout_t *layout)
+{
+    AudioObjectPropertyAddress property_address = {
+        kAudioDevicePropertyStreamConfiguration,
+        scope,
+        kAudioObjectPropertyElementMain
+    };
+    AudioBufferList *list;
+    UInt32 size = 0;
+    int result = VCARD_ERROR_INVALID;
+
+    if (AudioObjectGetPropertyDataSize(device, &property_address, 0, NULL, &size) != noErr) {
+        return VCARD_ERROR_INVALID;
+    }
+    list = (AudioBufferList *)malloc(size);
+    if (!list) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    if (AudioObjectGetPropertyData(device, &property_address, 0, NULL, &size, list) == noErr) {
+        if (list->mNumberBuffers >= 1 && list->mBuffers[0].mNumberChannels >= channels) {
+            layout->stride = list->mBuffers[0].mNumberChannels;
+            layout->split = 0;
+            result = VCARD_SUCCESS;
+        } else if (list->mNumberBuffers >= channels) {
+            result = VCARD_SUCCESS;
+            for (UInt32 b = 0; b < channels; b++) {
+                if (list->mBuffers[b].mNumberChannels != list->mBuffers[0].mNumberChannels) {
+                    result = VCARD_ERROR_INVALID;
+                }
+            }
+            layout->stride = list->mBuffers[0].mNumberChannels;
+            layout->split = 1;
+        }
+    }
+    free(list);
+    return result;
+}
+
+/**
+ * Point each channel at its first sample; frames in the buffers, or 0
+ */
+static uint32_t coreaudio_planes(const AudioBufferList *list, const coreaudio_layout_t *layout,
+                                 uint32_t channels, float **planes)
+{
+    if (!list || list->mNumberBuffers < (layout->split ? channels : 1)) {
+        return 0;
+    }
+    for (uint32_t ch = 0; ch < channels; ch++) {
+        planes[ch] = layout->split ? (float *)list->mBuffers[ch].mData
+                                   : (float *)list->mBuffers[0].mData + ch;
+    }
+    return list->mBuffers[0].mDataByteSize / (uint32_t)(sizeof(float) * layout->stride);
+}
+
+static OSStatus coreaudio_ioproc(AudioObjectID device, const AudioTimeStamp *now,
+                                 const AudioBufferList *input, const AudioTimeStamp *input_time,
+                                 AudioBufferList *output, const AudioTimeStamp *output_time,
+                                 void *arg)
+{
+    coreaudio_stream_t *s = (coreaudio_stream_t *)arg;
+    float *in[VCARD_MAX_CHANNELS];
+    float *out[VCARD_MAX_CHANNELS];
+    uint32_t frames;
+
+    (void)device;
+    (void)now;
+    (void)input_time;
+    (void)output_time;
+    frames = coreaudio_planes(input, &s->in_layout, s->channels, in);
+    if (frames) {
+        stress_bridge_capture(&s->bridge, (const float *const *)in, s->in_layout.stride, frames);
+    }
+    // The HAL zeroes output buffers, so channels beyond the trial stay silent
+    frames = coreaudio_planes(output, &s->out_layout, s->channels, out);
+    if (frames) {
+        stress_bridge_playback(&s->bridge, out, s->out_layout.stride, frames);
+    }
+    return noErr;
+}
+
+static OSStatus coreaudio_overload(AudioObjectID device, UInt32 count,
+                                   const AudioObjectPropertyAddress *addresses, void *arg)
+{
+    (void)device;
+    (void)count;
+    (void)addresses;
+    stress_bridge_xrun(&((coreaudio_stream_t *)arg)->bridge);
+    return noErr;
+}
+
+/**
+ * Switch the device to a sample rate; non-zero if it runs at it afterwards
+ */
+static int coreaudio_set_rate(AudioDeviceID device, uint32_t sample_rate)
+{
+    AudioObjectPropertyAddress property_address = {
+        kAudioDevicePropertyNominalSampleRate,
+        kAudioObjectPropertyScopeGlobal,
+        kAudioObjectPropertyElementMain
+    };
+    Float64 rate = 0.0;
+    UInt32 size = sizeof(rate);
+
+    if (AudioObjectGetPropertyData(device, &property_address, 0, NULL, &size, &rate) == noErr &&
+        rate == (Float64)sample_rate) {
+        return 1;
+    }
+    rate = (Float64)sample_rate;
+    if (AudioObjectSetPropertyData(device, &property_address, 0, NULL,
+                                   sizeof(rate), &rate) != noErr) {
+        return 0;
+    }
+    size = sizeof(rate);
+    return AudioObjectGetPropertyData(device, &property_address, 0, NULL, &size, &rate) == noErr &&
+           rate == (Float64)sample_rate;
+}
+
+/**
+ * Ask for an IO buffer of the given size; the size the device settled on
+ */
+static uint32_t coreaudio_set_buffer(AudioDeviceID device, uint32_t frames)
+{
+    AudioObjectPropertyAddress property_address = {
+        kAudioDevicePropertyBufferFrameSize,
+        kAudioObjectPropertyScopeGlobal,
+        kAudioObjectPropertyElementMain
+    };
+    UInt32 value = frames;
+    UInt32 size = sizeof(value);
+
+    AudioObjectSetPropertyData(device, &property_address, 0, NULL, sizeof(value), &value);
+    if (AudioObjectGetPropertyData(device, &property_address, 0, NULL, &size, &value) != noErr) {
+        return frames;
+    }
+    return value;
+}
+
+static void coreaudio_close(void *stream)
+{
+    coreaudio_stream_t *s = (coreaudio_stream_t *)stream;
+
+    // Stopping waits for a running IOProc, so the bridge is unused after it
+    if (s->proc) {
+        AudioDeviceStop(s->device, s->proc);
+        AudioDeviceDestroyIOProcID(s->device, s->proc);
+    }
+    if (s->listening) {
+        AudioObjectRemovePropertyListener(s->device, &overload_address, coreaudio_overload, s);
+    }
+    if (s->bridged) {
+        stress_bridge_free(&s->bridge);
+    }
+    free(s);
+}
+
+static int coreaudio_open(const stress_config_t *config, uint32_t index, void **stream)
+{
+    const char *name = getenv("VCARD_STRESS_COREAUDIO_DEVICE");
+    coreaudio_stream_t *s;
+    int result;
+
+    if (index > 0 || config->channels == 0 || config->channels > VCARD_MAX_CHANNELS) {
+        return VCARD_ERROR_INVALID;
+    }
+    s = (coreaudio_stream_t *)calloc(1, sizeof(*s));
+    if (!s) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    s->channels = config->channels;
+    s->device = coreaudio_find_device(name && name[0] ? name : COREAUDIO_DEFAULT_DEVICE);
+    if (s->device == kAudioDeviceUnknown) {
+        free(s);
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    if ((result = coreaudio_layout(s->device, kAudioObjectPropertyScopeInput, s->channels,
+                                   &s->in_layout)) != VCARD_SUCCESS ||
+        (result = coreaudio_layout(s->device, kAudioObjectPropertyScopeOutput, s->channels,
+                                   &s->out_layout)) != VCARD_SUCCESS) {
+        free(s);
+        return result;
+    }
+    if (!coreaudio_set_rate(s->device, config->sample_rate)) {
+        free(s);
+        return VCARD_ERROR_INVALID;
+    }
+    if (stress_bridge_init(&s->bridge, config->channels, config->buffer_size,
+                           coreaudio_set_buffer(s->device, config->buffer_size),
+                           config->sample_rate) != VCARD_SUCCESS) {
+        free(s);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    s->bridged = 1;
+
+    s->listening = AudioObjectAddPropertyListener(s->device, &overload_address,
+                                                  coreaudio_overload, s) == noErr;
+    if (AudioDeviceCreateIOProcID(s->device, coreaudio_ioproc, s, &s->proc) != noErr) {
+        s->proc = NULL;
+        coreaudio_close(s);
+        return VCARD_ERROR_INVALID;
+    }
+    if (AudioDeviceStart(s->device, s->proc) != noErr) {
+        coreaudio_close(s);
+        return VCARD_ERROR_INVALID;
+    }
+    *stream = s;
+    return VCARD_SUCCESS;
+}
+
+static int coreaudio_exchange(void *stream, const float *const *out, float *const *in,
+                              uint64_t *ready_ns)
+{
+    return stress_bridge_exchange(&((coreaudio_stream_t *)stream)->bridge, out, in, ready_ns);
+}
+
+const stress_backend_t stress_backend_coreaudio = {
+    "coreaudio", 1, 1,
+    coreaudio_open, coreaudio_exchange, coreaudio_close
+};
+
+#endif /* __APPLE__ */
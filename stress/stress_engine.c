@@ -0,0 +1,77 @@
+/**
+ * Stress backend for the in-process device engine
+ *
+ * Each device is a vcard device with the identity routing: a period is
+ * vcard_write_audio() followed by vcard_read_audio(). A short read is an
+ * underrun and is reported to the device like a backend would.
+ */
+
+#include "stress_backend.h"
+#include "vcard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int device_id;
+    uint32_t frames;
+} engine_stream_t;
+
+static int engine_open(const stress_config_t *config, uint32_t index, void **stream)
+{
+    engine_stream_t *s = (engine_stream_t *)calloc(1, sizeof(*s));
+    vcard_config_t dev;
+    int result;
+
+    if (!s) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    memset(&dev, 0, sizeof(dev));
+    snprintf(dev.name, sizeof(dev.name), "Stress %u", index);
+    dev.channels_in = config->channels;
+    dev.channels_out = config->channels;
+    dev.sample_rate = config->sample_rate;
+    dev.buffer_size = config->buffer_size;
+    dev.bit_depth = VCARD_BIT_32;
+
+    result = vcard_create_device(&dev, &s->device_id);
+    if (result != VCARD_SUCCESS) {
+        free(s);
+        return result;
+    }
+    s->frames = config->buffer_size;
+    *stream = s;
+    return VCARD_SUCCESS;
+}
+
+static int engine_exchange(void *stream, const float *const *out, float *const *in,
+                           uint64_t *ready_ns)
+{
+    engine_stream_t *s = (engine_stream_t *)stream;
+    size_t written = 0, read = 0;
+    int xruns = 0;
+
+    (void)ready_ns;
+    if (vcard_write_audio(s->device_id, out, s->frames, &written) != VCARD_SUCCESS ||
+        vcard_read_audio(s->device_id, in, s->frames, &read) != VCARD_SUCCESS) {
+        return -1;
+    }
+    if (written < s->frames || read < s->frames) {
+        vcard_report_xrun(s->device_id);
+        xruns = 1;
+    }
+    return xruns;
+}
+
+static void engine_close(void *stream)
+{
+    engine_stream_t *s = (engine_stream_t *)stream;
+
+    vcard_destroy_device(s->device_id);
+    free(s);
+}
+
+const stress_backend_t stress_backend_engine = {
+    "engine", 0, VCARD_MAX_DEVICES,
+    engine_open, engine_exchange, engine_close
+};
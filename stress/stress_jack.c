@@ -0,0 +1,147 @@
+/**
+ * Stress backend for JACK
+ *
+ * Device n is a JACK client "vcard_stress_n" with channels input and
+ * output ports, each output connected back to the input of the same
+ * index, so the graph loops the harness's output into its input one JACK
+ * cycle later. The process callback exchanges periods with the harness
+ * through a stress_bridge_t, so the backend is paced by the server clock.
+ *
+ * The server keeps its own sample rate and period: a trial at another
+ * rate fails to open, and a harness period that differs from the
+ * server's is carried through the bridge. JACK reports xruns for the
+ * whole server, so every device counts each one.
+ */
+
+#include "stress_backend.h"
+#include "stress_bridge.h"
+#include "vcard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jack/jack.h>
+
+typedef struct {
+    jack_client_t *client;
+    jack_port_t *in[VCARD_MAX_CHANNELS];
+    jack_port_t *out[VCARD_MAX_CHANNELS];
+    uint32_t channels;
+    int bridged;                /* bridge initialized */
+    stress_bridge_t bridge;
+} jack_stream_t;
+
+static int stress_jack_process(jack_nframes_t nframes, void *arg)
+{
+    jack_stream_t *s = (jack_stream_t *)arg;
+    const float *in[VCARD_MAX_CHANNELS];
+    float *out[VCARD_MAX_CHANNELS];
+
+    for (uint32_t ch = 0; ch < s->channels; ch++) {
+        in[ch] = (const float *)jack_port_get_buffer(s->in[ch], nframes);
+        out[ch] = (float *)jack_port_get_buffer(s->out[ch], nframes);
+    }
+    stress_bridge_capture(&s->bridge, in, 1, nframes);
+    stress_bridge_playback(&s->bridge, out, 1, nframes);
+    return 0;
+}
+
+static int stress_jack_xrun(void *arg)
+{
+    stress_bridge_xrun(&((jack_stream_t *)arg)->bridge);
+    return 0;
+}
+
+static void stress_jack_shutdown(void *arg)
+{
+    stress_bridge_fail(&((jack_stream_t *)arg)->bridge);
+}
+
+static void stress_jack_close(void *stream)
+{
+    jack_stream_t *s = (jack_stream_t *)stream;
+
+    // Closing deactivates first, so the callback is gone before the bridge
+    if (s->client) {
+        jack_client_close(s->client);
+    }
+    if (s->bridged) {
+        stress_bridge_free(&s->bridge);
+    }
+    free(s);
+}
+
+static int stress_jack_open(const stress_config_t *config, uint32_t index, void **stream)
+{
+    jack_stream_t *s;
+    jack_status_t status;
+    char name[64];
+
+    if (config->channels == 0 || config->channels > VCARD_MAX_CHANNELS) {
+        return VCARD_ERROR_INVALID;
+    }
+    s = (jack_stream_t *)calloc(1, sizeof(*s));
+    if (!s) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    s->channels = config->channels;
+
+    snprintf(name, sizeof(name), "vcard_stress_%u", index);
+    s->client = jack_client_open(name, JackNoStartServer, &status);
+    if (!s->client) {
+        stress_jack_close(s);
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    if (jack_get_sample_rate(s->client) != config->sample_rate) {
+        stress_jack_close(s);
+        return VCARD_ERROR_INVALID;
+    }
+    if (stress_bridge_init(&s->bridge, config->channels, config->buffer_size,
+                           jack_get_buffer_size(s->client),
+                           config->sample_rate) != VCARD_SUCCESS) {
+        stress_jack_close(s);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    s->bridged = 1;
+
+    for (uint32_t ch = 0; ch < s->channels; ch++) {
+        snprintf(name, sizeof(name), "in_%u", ch + 1);
+        s->in[ch] = jack_port_register(s->client, name, JACK_DEFAULT_AUDIO_TYPE,
+                                       JackPortIsInput, 0);
+        snprintf(name, sizeof(name), "out_%u", ch + 1);
+        s->out[ch] = jack_port_register(s->client, name, JACK_DEFAULT_AUDIO_TYPE,
+                                        JackPortIsOutput, 0);
+        if (!s->in[ch] || !s->out[ch]) {
+            stress_jack_close(s);
+            return VCARD_ERROR_INVALID;
+        }
+    }
+    jack_set_process_callback(s->client, stress_jack_process, s);
+    jack_set_xrun_callback(s->client, stress_jack_xrun, s);
+    jack_on_shutdown(s->client, stress_jack_shutdown, s);
+    if (jack_activate(s->client) != 0) {
+        stress_jack_close(s);
+        return VCARD_ERROR_INVALID;
+    }
+
+    // Ports can only be connected once the client is active
+    for (uint32_t ch = 0; ch < s->channels; ch++) {
+        if (jack_connect(s->client, jack_port_name(s->out[ch]),
+                         jack_port_name(s->in[ch])) != 0) {
+            stress_jack_close(s);
+            return VCARD_ERROR_INVALID;
+        }
+    }
+    *stream = s;
+    return VCARD_SUCCESS;
+}
+
+static int stress_jack_exchange(void *stream, const float *const *out, float *const *in,
+                                uint64_t *ready_ns)
+{
+    return stress_bridge_exchange(&((jack_stream_t *)stream)->bridge, out, in, ready_ns);
+}
+
+const stress_backend_t stress_backend_jack = {
+    "jack", 1, VCARD_MAX_DEVICES,
+    stress_jack_open, stress_jack_exchange, stress_jack_close
+};
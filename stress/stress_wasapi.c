@@ -0,0 +1,300 @@
+/**
+ * Stress backend for WASAPI (Windows)
+ *
+ * The device is the default render endpoint in shared, event-driven mode,
+ * captured back through a loopback stream on the same endpoint, so a
+ * virtual cable or the endpoint itself loops the harness's output into
+ * its input. A backend thread wakes on the render event, queues the
+ * loopback packets and refills the render buffer through a
+ * stress_bridge_t; the backend is paced by the audio engine.
+ *
+ * Shared mode runs at the engine's mix format, so only trials whose
+ * channel count and sample rate match a 32-bit float mix format open.
+ * Every device would play to the same endpoint, so there is one.
+ * Loopback discontinuities count as xruns.
+ */
+
+#ifdef _WIN32
+
+#define COBJMACROS
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <audioclient.h>
+#include "stress_backend.h"
+#include "stress_bridge.h"
+#include "vcard.h"
+#include "vcard_thread.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WAVE_FORMAT_EXTENSIBLE
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+#endif
+
+/* 100-nanosecond units (REFERENCE_TIME) per second */
+#define HNS_PER_SEC 10000000LL
+
+static const CLSID stress_CLSID_MMDeviceEnumerator = {0xBCDE0395, 0xE52F, 0x467C, {0x8E, 0x3D, 0xC4, 0x57, 0x92, 0x91, 0x69, 0x2E}};
+static const IID stress_IID_IMMDeviceEnumerator = {0xA95664D2, 0x9614, 0x4F35, {0xA7, 0x46, 0xDE, 0x8D, 0xB6, 0x36, 0x17, 0xE6}};
+static const IID stress_IID_IAudioClient = {0x1CB9AD4C, 0xDBFA, 0x4C32, {0xB1, 0x78, 0xC2, 0xF5, 0x68, 0xA7, 0x03, 0xB2}};
+static const IID stress_IID_IAudioRenderClient = {0xF294ACFC, 0x3146, 0x4483, {0xA7, 0xBF, 0xAD, 0xDC, 0xA7, 0xC2, 0x60, 0xE2}};
+static const IID stress_IID_IAudioCaptureClient = {0xC8ADBD64, 0xE71E, 0x48A0, {0xA4, 0xDE, 0x18, 0x5C, 0x39, 0x5C, 0xD3, 0x17}};
+static const GUID stress_SUBTYPE_IEEE_FLOAT = {
+    0x00000003, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71}
+};
+
+typedef struct {
+    stress_config_t config;
+    stress_bridge_t bridge;
+    int bridged;                /* bridge initialized */
+    vcard_thread_t thread;
+    HANDLE event;               /* Render buffer ready */
+    vcard_atomic_u32 stop;
+
+    /* Startup handshake with open() */
+    vcard_mutex_t lock;
+    vcard_cond_t cond;
+    int state;                  /* 0 starting, 1 running, < 0 failed (VCARD_ERROR_*) */
+} wasapi_stream_t;
+
+/* COM objects, created and released on the backend thread */
+typedef struct {
+    IMMDeviceEnumerator *enumerator;
+    IMMDevice *device;
+    IAudioClient *render_client;
+    IAudioClient *capture_client;
+    IAudioRenderClient *render;
+    IAudioCaptureClient *capture;
+    WAVEFORMATEX *format;
+    UINT32 buffer_frames;
+} wasapi_com_t;
+
+static int is_float_format(const WAVEFORMATEX *format)
+{
+    if (format->wFormatTag == WAVE_FORMAT_IEEE_FLOAT) {
+        return format->wBitsPerSample == 32;
+    }
+    if (format->wFormatTag == WAVE_FORMAT_EXTENSIBLE) {
+        const WAVEFORMATEXTENSIBLE *ext = (const WAVEFORMATEXTENSIBLE *)format;
+        return format->wBitsPerSample == 32 &&
+               memcmp(&ext->SubFormat, &stress_SUBTYPE_IEEE_FLOAT, sizeof(GUID)) == 0;
+    }
+    return 0;
+}
+
+static void wasapi_release(wasapi_com_t *com)
+{
+    if (com->render_client) IAudioClient_Stop(com->render_client);
+    if (com->capture_client) IAudioClient_Stop(com->capture_client);
+    if (com->render) IAudioRenderClient_Release(com->render);
+    if (com->capture) IAudioCaptureClient_Release(com->capture);
+    if (com->render_client) IAudioClient_Release(com->render_client);
+    if (com->capture_client) IAudioClient_Release(com->capture_client);
+    if (com->format) CoTaskMemFree(com->format);
+    if (com->device) IMMDevice_Release(com->device);
+    if (com->enumerator) IMMDeviceEnumerator_Release(com->enumerator);
+}
+
+/**
+ * Open the render and loopback streams of the default endpoint
+ */
+static int wasapi_setup(wasapi_stream_t *s, wasapi_com_t *com)
+{
+    const stress_config_t *config = &s->config;
+    REFERENCE_TIME duration = (REFERENCE_TIME)config->buffer_size * HNS_PER_SEC /
+                              config->sample_rate;
+
+    if (FAILED(CoCreateInstance(&stress_CLSID_MMDeviceEnumerator, NULL, CLSCTX_ALL,
+                                &stress_IID_IMMDeviceEnumerator, (void **)&com->enumerator)) ||
+        FAILED(IMMDeviceEnumerator_GetDefaultAudioEndpoint(com->enumerator, eRender,
+                                                           eConsole, &com->device))) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    if (FAILED(IMMDevice_Activate(com->device, &stress_IID_IAudioClient, CLSCTX_ALL, NULL,
+                                  (void **)&com->render_client)) ||
+        FAILED(IMMDevice_Activate(com->device, &stress_IID_IAudioClient, CLSCTX_ALL, NULL,
+                                  (void **)&com->capture_client)) ||
+        FAILED(IAudioClient_GetMixFormat(com->render_client, &com->format))) {
+        return VCARD_ERROR_NOT_FOUND;
+    }
+    if (!is_float_format(com->format) || com->format->nChannels != config->channels ||
+        com->format->nSamplesPerSec != config->sample_rate) {
+        return VCARD_ERROR_INVALID;
+    }
+
+    // The engine rounds the buffer up to its own period
+    if (FAILED(IAudioClient_Initialize(com->render_client, AUDCLNT_SHAREMODE_SHARED,
+                                       AUDCLNT_STREAMFLAGS_EVENTCALLBACK, duration, 0,
+                                       com->format, NULL)) ||
+        FAILED(IAudioClient_Initialize(com->capture_client, AUDCLNT_SHAREMODE_SHARED,
+                                       AUDCLNT_STREAMFLAGS_LOOPBACK, duration, 0,
+                                       com->format, NULL)) ||
+        FAILED(IAudioClient_SetEventHandle(com->render_client, s->event)) ||
+        FAILED(IAudioClient_GetBufferSize(com->render_client, &com->buffer_frames)) ||
+        FAILED(IAudioClient_GetService(com->render_client, &stress_IID_IAudioRenderClient,
+                                       (void **)&com->render)) ||
+        FAILED(IAudioClient_GetService(com->capture_client, &stress_IID_IAudioCaptureClient,
+                                       (void **)&com->capture))) {
+        return VCARD_ERROR_INVALID;
+    }
+    if (stress_bridge_init(&s->bridge, config->channels, config->buffer_size,
+                           com->buffer_frames, config->sample_rate) != VCARD_SUCCESS) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    s->bridged = 1;
+    if (FAILED(IAudioClient_Start(com->capture_client)) ||
+        FAILED(IAudioClient_Start(com->render_client))) {
+        return VCARD_ERROR_INVALID;
+    }
+    return VCARD_SUCCESS;
+}
+
+/**
+ * Queue every pending loopback packet, then refill the render buffer
+ */
+static int wasapi_service(wasapi_stream_t *s, wasapi_com_t *com)
+{
+    uint32_t channels = s->config.channels;
+    const float *in[VCARD_MAX_CHANNELS];
+    float *out[VCARD_MAX_CHANNELS];
+    UINT32 packet, padding;
+    BYTE *data;
+
+    while (SUCCEEDED(IAudioCaptureClient_GetNextPacketSize(com->capture, &packet)) && packet) {
+        UINT32 frames;
+        DWORD flags;
+
+        if (FAILED(IAudioCaptureClient_GetBuffer(com->capture, &data, &frames, &flags,
+                                                 NULL, NULL))) {
+            return -1;
+        }
+        if (flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) {
+            stress_bridge_xrun(&s->bridge);
+        }
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            in[ch] = (const float *)data + ch;
+        }
+        stress_bridge_capture(&s->bridge, (flags & AUDCLNT_BUFFERFLAGS_SILENT) ? NULL : in,
+                              channels, frames);
+        IAudioCaptureClient_ReleaseBuffer(com->capture, frames);
+    }
+
+    if (FAILED(IAudioClient_GetCurrentPadding(com->render_client, &padding))) {
+        return -1;
+    }
+    if (padding < com->buffer_frames) {
+        UINT32 frames = com->buffer_frames - padding;
+
+        if (FAILED(IAudioRenderClient_GetBuffer(com->render, frames, &data))) {
+            return -1;
+        }
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            out[ch] = (float *)data + ch;
+        }
+        stress_bridge_playback(&s->bridge, out, channels, frames);
+        IAudioRenderClient_ReleaseBuffer(com->render, frames, 0);
+    }
+    return 0;
+}
+
+static void wasapi_thread(void *arg)
+{
+    wasapi_stream_t *s = (wasapi_stream_t *)arg;
+    wasapi_com_t com;
+    HRESULT init = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    int result;
+
+    memset(&com, 0, sizeof(com));
+    result = SUCCEEDED(init) ? wasapi_setup(s, &com) : VCARD_ERROR_INVALID;
+
+    vcard_mutex_lock(&s->lock);
+    s->state = result == VCARD_SUCCESS ? 1 : result;
+    vcard_cond_signal(&s->cond);
+    vcard_mutex_unlock(&s->lock);
+
+    while (result == VCARD_SUCCESS && !vcard_atomic_load_acquire_u32(&s->stop)) {
+        // A missed event leaves the harness to time out the exchange
+        if (WaitForSingleObject(s->event, 1000) == WAIT_OBJECT_0 &&
+            wasapi_service(s, &com) < 0) {
+            stress_bridge_fail(&s->bridge);
+            break;
+        }
+    }
+    wasapi_release(&com);
+    if (SUCCEEDED(init)) {
+        CoUninitialize();
+    }
+}
+
+static void wasapi_close(void *stream)
+{
+    wasapi_stream_t *s = (wasapi_stream_t *)stream;
+
+    vcard_atomic_store_release_u32(&s->stop, 1);
+    SetEvent(s->event);
+    vcard_thread_join(&s->thread);
+    if (s->bridged) {
+        stress_bridge_free(&s->bridge);
+    }
+    CloseHandle(s->event);
+    vcard_cond_destroy(&s->cond);
+    vcard_mutex_destroy(&s->lock);
+    free(s);
+}
+
+static int wasapi_open(const stress_config_t *config, uint32_t index, void **stream)
+{
+    wasapi_stream_t *s;
+    int state;
+
+    if (index > 0 || config->channels == 0 || config->channels > VCARD_MAX_CHANNELS) {
+        return VCARD_ERROR_INVALID;
+    }
+    s = (wasapi_stream_t *)calloc(1, sizeof(*s));
+    if (!s) {
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    s->config = *config;
+    s->event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!s->event) {
+        free(s);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    vcard_mutex_init(&s->lock);
+    vcard_cond_init(&s->cond);
+
+    // COM objects live and die on the backend thread
+    if (vcard_thread_create(&s->thread, wasapi_thread, s) != VCARD_SUCCESS) {
+        CloseHandle(s->event);
+        vcard_cond_destroy(&s->cond);
+        vcard_mutex_destroy(&s->lock);
+        free(s);
+        return VCARD_ERROR_NO_MEMORY;
+    }
+    vcard_mutex_lock(&s->lock);
+    while (s->state == 0) {
+        vcard_cond_wait(&s->cond, &s->lock);
+    }
+    state = s->state;
+    vcard_mutex_unlock(&s->lock);
+
+    if (state < 0) {
+        wasapi_close(s);
+        return state;
+    }
+    *stream = s;
+    return VCARD_SUCCESS;
+}
+
+static int wasapi_exchange(void *stream, const float *const *out, float *const *in,
+                           uint64_t *ready_ns)
+{
+    return stress_bridge_exchange(&((wasapi_stream_t *)stream)->bridge, out, in, ready_ns);
+}
+
+const stress_backend_t stress_backend_wasapi = {
+    "wasapi", 1, 1,
+    wasapi_open, wasapi_exchange, wasapi_close
+};
+
+#endif /* _WIN32 */
@@ -0,0 +1,574 @@
+/**
+ * Virtual Sound Card - Stress and Soak Harness
+ *
+ * Finds the largest configuration a backend sustains without xruns on
+ * this host. Every device runs on its own thread, as a backend's audio
+ * thread would: each period it renders a sine per output channel,
+ * exchanges the period with the backend and checks the looped-back tone
+ * with a signal analyzer. A trial passes when no period misses its
+ * deadline and the backend reports no xruns.
+ *
+ * Starting from 1 device of 2 channels at 48 kHz with 256-frame periods,
+ * the harness ramps in turn:
+ *  - devices:     1, 2, 4, 8, 16
+ *  - channels:    2, 4, 8, 16, 32 per device
+ *  - sample rate: 48, 96, 192 kHz
+ *  - buffer size: 256 down to 16 frames
+ * keeping the last passing value of each stage, then soaks the resulting
+ * configuration. The report is one JSON document with every trial, the
+ * sustained limits, CPU per channel, latency percentiles and the soak's
+ * xruns per hour.
+ *
+ * Usage: vcard_stress [--backend <name>] [--trial <seconds>]
+ *                     [--soak <seconds>] [--realtime] [--quick]
+ *                     [--output <file>]
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L          /* clock_gettime, CLOCK_THREAD_CPUTIME_ID */
+#endif
+
+#include "vcard.h"
+#include "vcard_thread.h"
+#include "sine_generator.h"
+#include "signal_analyzer.h"
+#include "stress_backend.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+/* Latency histogram: 1 us bins, the last one collects everything longer */
+#define STRESS_HIST_BINS 20000
+
+#define STRESS_ANALYSIS_BLOCK 4096
+#define STRESS_TONE_HZ 1000.0
+#define STRESS_TONE_STEP_HZ 100.0
+#define STRESS_AMPLITUDE 0.5
+
+/* Largest tolerated error of the looped-back tone, in Hz */
+#define STRESS_FREQUENCY_TOLERANCE 1.0
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define STRESS_ARCH "x86_64"
+#elif defined(__i386__) || defined(_M_IX86)
+#define STRESS_ARCH "x86"
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define STRESS_ARCH "arm64"
+#elif defined(__arm__) || defined(_M_ARM)
+#define STRESS_ARCH "arm"
+#else
+#define STRESS_ARCH "unknown"
+#endif
+
+static const stress_backend_t *const backends[] = {
+    &stress_backend_engine,
+#ifdef VCARD_STRESS_ALSA
+    &stress_backend_alsa,
+#endif
+#ifdef VCARD_STRESS_JACK
+    &stress_backend_jack,
+#endif
+#ifdef VCARD_STRESS_WASAPI
+    &stress_backend_wasapi,
+#endif
+#ifdef VCARD_STRESS_COREAUDIO
+    &stress_backend_coreaudio,
+#endif
+};
+
+/**
+ * One device's thread and its measurements
+ */
+typedef struct {
+    const stress_backend_t *backend;
+    const stress_config_t *config;
+    void *stream;
+    int realtime;
+    uint64_t start_ns;          /* Shared start of the trial */
+    uint64_t duration_ns;
+
+    float *out[VCARD_MAX_CHANNELS];
+    float *in[VCARD_MAX_CHANNELS];
+    float *samples;             /* Backing store of out and in */
+    sine_generator_t gens[VCARD_MAX_CHANNELS];
+    signal_analyzer_t analyzer;
+    uint32_t *hist;
+
+    uint64_t periods;
+    uint64_t xruns;             /* Backend xruns plus missed deadlines */
+    uint64_t max_ns;
+    uint64_t cpu_ns;
+    int failed;
+} stress_worker_t;
+
+/**
+ * Aggregated result of one trial
+ */
+typedef struct {
+    stress_config_t config;
+    double seconds;
+    uint64_t periods;
+    uint64_t xruns;
+    double cpu_percent;         /* Of one core, over all device threads */
+    double cpu_per_channel;     /* cpu_percent per output channel */
+    double p50_us, p99_us, p999_us, max_us;
+    int signal_ok;
+    int opened;                 /* Every device opened */
+    int pass;
+} stress_result_t;
+
+typedef struct {
+    FILE *out;
+    const stress_backend_t *backend;
+    double trial_seconds;
+    double soak_seconds;
+    int realtime;
+    int trials;
+} stress_t;
+
+static uint64_t thread_cpu_ns(void)
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    ULARGE_INTEGER k, u;
+
+    GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) * 100;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/**
+ * Raise the calling thread to real-time priority; 0 if refused
+ */
+static int set_realtime(void)
+{
+#ifdef _WIN32
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+    struct sched_param param;
+
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 10;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#endif
+}
+
+static void render_output(stress_worker_t *w)
+{
+    for (uint32_t ch = 0; ch < w->config->channels; ch++) {
+        sine_generator_process_f32(&w->gens[ch], w->out[ch], w->config->buffer_size);
+    }
+}
+
+/**
+ * Device thread: one period per deadline (or per device period when paced)
+ */
+static void worker_thread(void *arg)
+{
+    stress_worker_t *w = (stress_worker_t *)arg;
+    const stress_config_t *config = w->config;
+    uint64_t period_ns = (uint64_t)config->buffer_size * 1000000000ull / config->sample_rate;
+    uint64_t end = w->start_ns + w->duration_ns;
+    uint64_t cpu_start;
+    uint64_t k = 0;
+    uint64_t now;
+
+    if (w->realtime) {
+        set_realtime();
+    }
+    render_output(w);
+    now = vcard_time_ns();
+    while (now < w->start_ns) {
+        vcard_sleep_us((uint32_t)((w->start_ns - now) / 1000) + 1);
+        now = vcard_time_ns();
+    }
+    cpu_start = thread_cpu_ns();
+
+    while ((now = vcard_time_ns()) < end) {
+        uint64_t due = w->start_ns + k * period_ns;
+        uint64_t ready = 0;
+        uint64_t done;
+        uint64_t latency;
+        int xruns;
+
+        if (!w->backend->paced && now < due) {
+            vcard_sleep_us((uint32_t)((due - now) / 1000));
+        }
+        xruns = w->backend->exchange(w->stream, (const float *const *)w->out, w->in, &ready);
+        if (xruns < 0) {
+            w->failed = 1;
+            break;
+        }
+        w->xruns += (uint64_t)xruns;
+        if (w->backend->paced) {
+            due = ready;
+        }
+
+        signal_analyzer_process(&w->analyzer, w->in[0], config->buffer_size, 1);
+        render_output(w);
+
+        done = vcard_time_ns();
+        latency = done > due ? done - due : 0;
+        w->hist[latency / 1000 < STRESS_HIST_BINS ? latency / 1000 : STRESS_HIST_BINS - 1]++;
+        if (latency > w->max_ns) {
+            w->max_ns = latency;
+        }
+        w->periods++;
+
+        if (!w->backend->paced && latency > period_ns) {
+            // Missed the next deadline: count it and skip the lost periods
+            w->xruns++;
+            k = (done - w->start_ns) / period_ns + 1;
+        } else {
+            k++;
+        }
+    }
+    w->cpu_ns = thread_cpu_ns() - cpu_start;
+}
+
+/**
+ * Latency at a quantile of a merged histogram, in microseconds
+ */
+static double hist_quantile(const uint32_t *hist, uint64_t total, double q, double max_us)
+{
+    uint64_t target = (uint64_t)ceil(q * (double)total);
+    uint64_t seen = 0;
+
+    for (uint32_t bin = 0; bin < STRESS_HIST_BINS; bin++) {
+        seen += hist[bin];
+        if (seen >= target && seen > 0) {
+            return bin == STRESS_HIST_BINS - 1 || bin + 1.0 > max_us ? max_us : bin + 1.0;
+        }
+    }
+    return max_us;
+}
+
+static void free_workers(stress_worker_t *workers, uint32_t count)
+{
+    for (uint32_t d = 0; d < count; d++) {
+        stress_worker_t *w = &workers[d];
+
+        if (w->stream) {
+            w->backend->close(w->stream);
+        }
+        signal_analyzer_free(&w->analyzer);
+        free(w->samples);
+        free(w->hist);
+    }
+    free(workers);
+}
+
+/**
+ * Run one configuration for a number of seconds
+ */
+static void run_trial(const stress_t *st, const stress_config_t *config, double seconds,
+                      stress_result_t *result)
+{
+    stress_worker_t *workers = (stress_worker_t *)calloc(config->devices, sizeof(*workers));
+    vcard_thread_t threads[VCARD_MAX_DEVICES];
+    uint32_t started = 0;
+    uint32_t *hist = (uint32_t *)calloc(STRESS_HIST_BINS, sizeof(uint32_t));
+    uint64_t cpu_ns = 0, max_ns = 0;
+    size_t samples = (size_t)config->buffer_size * config->channels * 2;
+    double wall_ns = seconds * 1e9;
+
+    memset(result, 0, sizeof(*result));
+    result->config = *config;
+    result->seconds = seconds;
+    result->signal_ok = 1;
+    if (!workers || !hist) {
+        free(workers);
+        free(hist);
+        return;
+    }
+
+    // Open every device before any thread starts, so setup is not timed
+    result->opened = 1;
+    for (uint32_t d = 0; d < config->devices && result->opened; d++) {
+        stress_worker_t *w = &workers[d];
+
+        w->backend = st->backend;
+        w->config = config;
+        w->realtime = st->realtime;
+        w->duration_ns = (uint64_t)wall_ns;
+        w->samples = (float *)calloc(samples, sizeof(float));
+        w->hist = (uint32_t *)calloc(STRESS_HIST_BINS, sizeof(uint32_t));
+        if (!w->samples || !w->hist ||
+            signal_analyzer_init(&w->analyzer, config->sample_rate, STRESS_TONE_HZ,
+                                 STRESS_ANALYSIS_BLOCK) != VCARD_SUCCESS ||
+            st->backend->open(config, d, &w->stream) != VCARD_SUCCESS) {
+            w->stream = NULL;
+            result->opened = 0;
+            break;
+        }
+        for (uint32_t ch = 0; ch < config->channels; ch++) {
+            w->out[ch] = w->samples + (size_t)ch * config->buffer_size;
+            w->in[ch] = w->samples + (size_t)(config->channels + ch) * config->buffer_size;
+            sine_generator_init(&w->gens[ch], STRESS_TONE_HZ + STRESS_TONE_STEP_HZ * ch,
+                                config->sample_rate, STRESS_AMPLITUDE);
+        }
+    }
+
+    if (result->opened) {
+        uint64_t start = vcard_time_ns() + 50000000ull;
+
+        for (uint32_t d = 0; d < config->devices; d++) {
+            workers[d].start_ns = start;
+            if (vcard_thread_create(&threads[d], worker_thread, &workers[d]) != VCARD_SUCCESS) {
+                break;
+            }
+            started++;
+        }
+        for (uint32_t d = 0; d < started; d++) {
+            vcard_thread_join(&threads[d]);
+        }
+    }
+
+    for (uint32_t d = 0; d < started; d++) {
+        stress_worker_t *w = &workers[d];
+        const signal_metrics_t *m = &w->analyzer.last;
+
+        result->periods += w->periods;
+        result->xruns += w->xruns;
+        cpu_ns += w->cpu_ns;
+        if (w->max_ns > max_ns) {
+            max_ns = w->max_ns;
+        }
+        for (uint32_t bin = 0; bin < STRESS_HIST_BINS; bin++) {
+            hist[bin] += w->hist[bin];
+        }
+        if (w->failed || w->analyzer.summary.blocks == 0 ||
+            fabs(m->frequency - STRESS_TONE_HZ) > STRESS_FREQUENCY_TOLERANCE ||
+            m->amplitude < STRESS_AMPLITUDE / 2.0) {
+            result->signal_ok = 0;
+        }
+    }
+    if (started < config->devices) {
+        result->signal_ok = 0;
+    }
+
+    result->max_us = (double)max_ns / 1000.0;
+    result->p50_us = hist_quantile(hist, result->periods, 0.50, result->max_us);
+    result->p99_us = hist_quantile(hist, result->periods, 0.99, result->max_us);
+    result->p999_us = hist_quantile(hist, result->periods, 0.999, result->max_us);
+    result->cpu_percent = (double)cpu_ns / wall_ns * 100.0;
+    result->cpu_per_channel = result->cpu_percent /
+                              ((double)config->devices * config->channels);
+    result->pass = result->opened && result->signal_ok && result->periods > 0 &&
+                   result->xruns == 0;
+
+    free_workers(workers, config->devices);
+    free(hist);
+}
+
+static void print_result(FILE *out, const stress_result_t *r)
+{
+    fprintf(out, "\"devices\": %u, \"channels\": %u, \"sample_rate\": %u, "
+            "\"buffer_size\": %u, \"seconds\": %.1f, \"periods\": %llu, \"xruns\": %llu, "
+            "\"cpu_percent\": %.2f, \"cpu_per_channel_percent\": %.4f, "
+            "\"latency_us\": {\"p50\": %.0f, \"p99\": %.0f, \"p999\": %.0f, \"max\": %.1f}, "
+            "\"signal_ok\": %s, \"pass\": %s",
+            r->config.devices, r->config.channels, r->config.sample_rate,
+            r->config.buffer_size, r->seconds, (unsigned long long)r->periods,
+            (unsigned long long)r->xruns, r->cpu_percent, r->cpu_per_channel,
+            r->p50_us, r->p99_us, r->p999_us, r->max_us,
+            r->signal_ok ? "true" : "false", r->pass ? "true" : "false");
+}
+
+/**
+ * Run a trial, report it as a row of the trials array and on stderr
+ */
+static int trial(stress_t *st, const char *stage, const stress_config_t *config)
+{
+    stress_result_t r;
+
+    run_trial(st, config, st->trial_seconds, &r);
+    fprintf(st->out, "%s\n    {\"stage\": \"%s\", ", st->trials ? "," : "", stage);
+    print_result(st->out, &r);
+    fprintf(st->out, "%s}", r.opened ? "" : ", \"error\": \"open failed\"");
+    st->trials++;
+
+    fprintf(stderr, "  %-8s %2u x %2u ch  %6u Hz  %4u frames: %s (xruns %llu, "
+            "p99 %.0f us, cpu %.1f%%)\n", stage, config->devices, config->channels,
+            config->sample_rate, config->buffer_size,
+            r.pass ? "pass" : "FAIL", (unsigned long long)r.xruns, r.p99_us,
+            r.cpu_percent);
+    return r.pass;
+}
+
+/**
+ * Raise (or shrink) one field through a list of values, keeping the last
+ * passing value; the current value is assumed to pass already
+ */
+static void ramp(stress_t *st, const char *stage, stress_config_t *config,
+                 uint32_t *field, const uint32_t *values, size_t count, uint32_t limit)
+{
+    for (size_t i = 0; i < count; i++) {
+        uint32_t previous = *field;
+
+        if (values[i] == previous || values[i] > limit) {
+            continue;
+        }
+        *field = values[i];
+        if (!trial(st, stage, config)) {
+            *field = previous;
+            return;
+        }
+    }
+}
+
+static void print_usage(const char *prog)
+{
+    printf("Usage: %s [--backend <name>] [--trial <seconds>] [--soak <seconds>]\n"
+           "       [--realtime] [--quick] [--output <file>]\n", prog);
+    printf("  --backend <name>  Backend to load:");
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        printf(" %s", backends[i]->name);
+    }
+    printf(" (default engine)\n");
+    printf("  --trial <seconds> Length of each ramp trial (default 2)\n");
+    printf("  --soak <seconds>  Length of the final soak at the limits, 0 to skip (default 10)\n");
+    printf("  --realtime        Run device threads at real-time priority\n");
+    printf("  --quick           0.5 s trials and a 2 s soak (smoke run)\n");
+    printf("  --output <file>   Write the JSON report to a file (default stdout)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static const uint32_t device_steps[] = { 1, 2, 4, 8, 16 };
+    static const uint32_t channel_steps[] = { 2, 4, 8, 16, 32 };
+    static const uint32_t rate_steps[] = { 48000, 96000, 192000 };
+    static const uint32_t buffer_steps[] = { 256, 128, 64, 32, 16 };
+    stress_t st;
+    stress_config_t config = { 1, 2, 48000, 256 };
+    const char *output = NULL;
+    const char *backend = "engine";
+    int base_ok;
+
+    memset(&st, 0, sizeof(st));
+    st.trial_seconds = 2.0;
+    st.soak_seconds = 10.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            backend = argv[++i];
+        } else if (strcmp(argv[i], "--trial") == 0 && i + 1 < argc) {
+            st.trial_seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--soak") == 0 && i + 1 < argc) {
+            st.soak_seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--realtime") == 0) {
+            st.realtime = 1;
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            st.trial_seconds = 0.5;
+            st.soak_seconds = 2.0;
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+    if (!(st.trial_seconds > 0.0 && st.trial_seconds <= 3600.0) ||
+        !(st.soak_seconds >= 0.0 && st.soak_seconds <= 7.0 * 86400.0)) {
+        fprintf(stderr, "vcard_stress: invalid trial or soak length\n");
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (strcmp(backends[i]->name, backend) == 0) {
+            st.backend = backends[i];
+        }
+    }
+    if (!st.backend) {
+        fprintf(stderr, "vcard_stress: backend '%s' is not built in\n", backend);
+        return 1;
+    }
+
+    st.out = output ? fopen(output, "w") : stdout;
+    if (!st.out) {
+        fprintf(stderr, "vcard_stress: cannot open %s\n", output);
+        return 1;
+    }
+    if (vcard_init() != VCARD_SUCCESS) {
+        fprintf(stderr, "vcard_stress: vcard_init failed\n");
+        return 1;
+    }
+
+    fprintf(stderr, "Stressing backend %s (%.1f s trials)\n", st.backend->name,
+            st.trial_seconds);
+    fprintf(st.out, "{\n  \"suite\": \"vcard_stress\",\n");
+    fprintf(st.out, "  \"version\": \"%d.%d.%d\",\n", VCARD_VERSION_MAJOR,
+            VCARD_VERSION_MINOR, VCARD_VERSION_PATCH);
+    fprintf(st.out, "  \"backend\": \"%s\",\n", st.backend->name);
+    fprintf(st.out, "  \"arch\": \"%s\",\n", STRESS_ARCH);
+    fprintf(st.out, "  \"cpus\": %u,\n", vcard_cpu_count());
+    fprintf(st.out, "  \"realtime\": %s,\n", st.realtime ? "true" : "false");
+    fprintf(st.out, "  \"trial_seconds\": %.1f,\n", st.trial_seconds);
+    fprintf(st.out, "  \"trials\": [");
+
+    base_ok = trial(&st, "base", &config);
+    if (base_ok) {
+        ramp(&st, "devices", &config, &config.devices, device_steps,
+             sizeof(device_steps) / sizeof(device_steps[0]), st.backend->max_devices);
+        ramp(&st, "channels", &config, &config.channels, channel_steps,
+             sizeof(channel_steps) / sizeof(channel_steps[0]), VCARD_MAX_CHANNELS);
+        ramp(&st, "rate", &config, &config.sample_rate, rate_steps,
+             sizeof(rate_steps) / sizeof(rate_steps[0]), UINT32_MAX);
+        // Smaller is harder: the limit check does not apply while shrinking
+        ramp(&st, "buffer", &config, &config.buffer_size, buffer_steps,
+             sizeof(buffer_steps) / sizeof(buffer_steps[0]), UINT32_MAX);
+    }
+    fprintf(st.out, "\n  ],\n");
+
+    if (base_ok) {
+        fprintf(st.out, "  \"limits\": {\"devices\": %u, \"channels\": %u, "
+                "\"sample_rate\": %u, \"buffer_size\": %u},\n", config.devices,
+                config.channels, config.sample_rate, config.buffer_size);
+    } else {
+        fprintf(st.out, "  \"limits\": null,\n");
+    }
+
+    if (base_ok && st.soak_seconds > 0.0) {
+        stress_result_t soak;
+
+        fprintf(stderr, "Soaking %u x %u ch at %u Hz, %u frames for %.0f s\n",
+                config.devices, config.channels, config.sample_rate,
+                config.buffer_size, st.soak_seconds);
+        run_trial(&st, &config, st.soak_seconds, &soak);
+        fprintf(st.out, "  \"soak\": {");
+        print_result(st.out, &soak);
+        fprintf(st.out, ", \"xruns_per_hour\": %.1f}\n",
+                (double)soak.xruns * 3600.0 / st.soak_seconds);
+        fprintf(stderr, "  soak: %llu xruns (%.1f per hour), p99 %.0f us, "
+                "%.4f%% CPU per channel\n", (unsigned long long)soak.xruns,
+                (double)soak.xruns * 3600.0 / st.soak_seconds, soak.p99_us,
+                soak.cpu_per_channel);
+    } else {
+        fprintf(st.out, "  \"soak\": null\n");
+    }
+    fprintf(st.out, "}\n");
+
+    if (st.out != stdout) {
+        fclose(st.out);
+    }
+    vcard_cleanup();
+    return base_ok ? 0 : 1;
+}
@@ -48,7 +48,7 @@ int main(void)
     vcard_cleanup();
     printf("  PASS: Cleanup called\n");
     
-    // Test device listing (should return 0 devices in stub implementation)
+    // Test device listing (no devices have been created)
     vcard_device_info_t devices[VCARD_MAX_DEVICES];
     int count = -1;
     result = vcard_list_devices(devices, VCARD_MAX_DEVICES, &count);
@@ -59,7 +59,7 @@ int main(void)
         printf("  FAIL: Expected 0 devices, got %d\n", count);
         passed = 0;
     } else {
-        printf("  PASS: Device listing returns 0 devices (stub implementation)\n");
+        printf("  PASS: Device listing returns 0 devices\n");
     }
     
     printf("\n");
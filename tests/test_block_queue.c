@@ -0,0 +1,164 @@
+/**
+ * Test for the Block Queue
+ *
+ * Checks block accounting and overflow counting, and streams blocks filled
+ * in place from a producer thread to a consumer thread.
+ */
+
+#include "block_queue.h"
+#include "vcard.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_BLOCK_FRAMES 512
+#define TEST_STREAM_BLOCKS 100000
+
+typedef struct {
+    block_queue_t *queue;
+    int errors;
+} stream_context_t;
+
+/* Frames carried by a given block: varies like a CoreAudio slice */
+static uint32_t block_frames(uint32_t seq)
+{
+    return 1 + (seq * 37) % TEST_BLOCK_FRAMES;
+}
+
+static void producer_thread(void *arg)
+{
+    stream_context_t *ctx = (stream_context_t *)arg;
+
+    for (uint32_t seq = 0; seq < TEST_STREAM_BLOCKS; ) {
+        int16_t *block = (int16_t *)block_queue_write_begin(ctx->queue);
+        uint32_t frames = block_frames(seq);
+
+        if (!block) {
+            vcard_sleep_us(20);
+            continue;
+        }
+        for (uint32_t i = 0; i < frames; i++) {
+            block[i] = (int16_t)(seq + i);
+        }
+        block_queue_write_commit(ctx->queue, frames);
+        seq++;
+    }
+}
+
+static void consumer_thread(void *arg)
+{
+    stream_context_t *ctx = (stream_context_t *)arg;
+
+    for (uint32_t seq = 0; seq < TEST_STREAM_BLOCKS; ) {
+        uint32_t frames = 0;
+        const int16_t *block = (const int16_t *)block_queue_read_begin(ctx->queue, &frames);
+
+        if (!block) {
+            vcard_sleep_us(20);
+            continue;
+        }
+        if (frames != block_frames(seq)) {
+            ctx->errors++;
+        } else {
+            for (uint32_t i = 0; i < frames; i++) {
+                if (block[i] != (int16_t)(seq + i)) {
+                    ctx->errors++;
+                    break;
+                }
+            }
+        }
+        block_queue_read_commit(ctx->queue);
+        seq++;
+    }
+}
+
+int main(void)
+{
+    block_queue_t queue;
+    int passed = 1;
+
+    printf("Testing block queue...\n");
+
+    if (block_queue_init(&queue, 0, 64) != VCARD_ERROR_INVALID ||
+        block_queue_init(&queue, 4, 0) != VCARD_ERROR_INVALID) {
+        printf("  FAIL: Invalid sizes should be rejected\n");
+        passed = 0;
+    } else {
+        printf("  PASS: Invalid sizes rejected\n");
+    }
+
+    // Rounded up to a power of two, full queue drops and counts overflows
+    {
+        uint32_t frames = 0;
+        void *first, *again;
+        int ok = 1;
+
+        if (block_queue_init(&queue, 3, 100) != VCARD_SUCCESS) {
+            printf("  FAIL: Could not allocate queue\n");
+            return 1;
+        }
+        ok &= queue.num_blocks == 4 && queue.stride % VCARD_CACHELINE == 0;
+        first = block_queue_write_begin(&queue);
+        again = block_queue_write_begin(&queue);
+        ok &= first != NULL && first == again;
+        ok &= block_queue_read_begin(&queue, &frames) == NULL;
+        for (uint32_t i = 0; i < 4; i++) {
+            ok &= block_queue_write_begin(&queue) != NULL;
+            block_queue_write_commit(&queue, 10 + i);
+        }
+        ok &= block_queue_write_begin(&queue) == NULL;
+        ok &= block_queue_write_begin(&queue) == NULL;
+        ok &= block_queue_overflows(&queue) == 2;
+
+        ok &= block_queue_read_begin(&queue, &frames) == first && frames == 10;
+        block_queue_read_commit(&queue);
+        ok &= block_queue_write_begin(&queue) == first;
+        block_queue_free(&queue);
+
+        if (!ok) {
+            printf("  FAIL: Block accounting\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Blocks recycled in order, overflows counted\n");
+        }
+    }
+
+    // Producer/consumer stream with variable block fill
+    {
+        stream_context_t ctx;
+        vcard_thread_t producer, consumer;
+
+        if (block_queue_init(&queue, 8, TEST_BLOCK_FRAMES * sizeof(int16_t)) != VCARD_SUCCESS) {
+            printf("  FAIL: Could not allocate queue\n");
+            return 1;
+        }
+        ctx.queue = &queue;
+        ctx.errors = 0;
+        if (vcard_thread_create(&consumer, consumer_thread, &ctx) != VCARD_SUCCESS ||
+            vcard_thread_create(&producer, producer_thread, &ctx) != VCARD_SUCCESS) {
+            printf("  FAIL: Could not start threads\n");
+            return 1;
+        }
+        vcard_thread_join(&producer);
+        vcard_thread_join(&consumer);
+        block_queue_free(&queue);
+
+        if (ctx.errors != 0) {
+            printf("  FAIL: %d corrupted blocks\n", ctx.errors);
+            passed = 0;
+        } else {
+            printf("  PASS: %d blocks streamed between threads intact\n",
+                   TEST_STREAM_BLOCKS);
+        }
+    }
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
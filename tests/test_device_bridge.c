@@ -0,0 +1,198 @@
+/**
+ * Test for the Device Bridge
+ *
+ * A producer thread writes a 1 kHz tone into a 44.1 kHz device on the
+ * wall clock while the test reads a 48 kHz device on a clock running
+ * 0.2% fast, with a bridge between the two, and checks that the tone
+ * arrives continuous, at its frequency and level, without the
+ * destination running dry.
+ */
+
+#include "device_bridge.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TEST_SOURCE_RATE 44100
+#define TEST_DEST_RATE 48000
+#define TEST_BUFFER_SIZE 256
+#define TEST_FREQUENCY 1000.0
+#define TEST_DRIFT 0.002
+#define TEST_SECONDS 3
+#define TEST_CHUNK 64
+
+typedef struct {
+    int device_id;
+    vcard_atomic_u32 running;
+} producer_t;
+
+static float received[TEST_DEST_RATE * (TEST_SECONDS + 1)];
+
+static int make_device(const char *name, uint32_t rate, int *device_id)
+{
+    vcard_config_t config;
+
+    memset(&config, 0, sizeof(config));
+    strncpy(config.name, name, VCARD_MAX_DEVICE_NAME - 1);
+    config.channels_in = 2;
+    config.channels_out = 2;
+    config.sample_rate = rate;
+    config.buffer_size = TEST_BUFFER_SIZE;
+    config.bit_depth = VCARD_BIT_32;
+    return vcard_create_device(&config, device_id);
+}
+
+/* Writes the tone at TEST_SOURCE_RATE as measured by the monotonic clock */
+static void producer_main(void *arg)
+{
+    producer_t *p = (producer_t *)arg;
+    float left[TEST_CHUNK], right[TEST_CHUNK];
+    const float *buffers[2] = { left, right };
+    uint64_t start = vcard_time_ns();
+    uint64_t frame = 0;
+
+    while (vcard_atomic_load_acquire_u32(&p->running)) {
+        uint64_t due = (vcard_time_ns() - start) * TEST_SOURCE_RATE / 1000000000u;
+
+        while (frame < due) {
+            size_t n = due - frame < TEST_CHUNK ? (size_t)(due - frame) : TEST_CHUNK;
+            size_t written = 0;
+
+            for (size_t i = 0; i < n; i++) {
+                left[i] = (float)(0.5 * sin(2.0 * M_PI * TEST_FREQUENCY *
+                                            (double)(frame + i) / TEST_SOURCE_RATE));
+                right[i] = -left[i];
+            }
+            vcard_write_audio(p->device_id, buffers, n, &written);
+            if (written < n) {
+                break;      // Source full: the bridge is behind; drop the rest of this slot
+            }
+            frame += n;
+        }
+        frame = due;
+        vcard_sleep_us(1000);
+    }
+}
+
+int main(void)
+{
+    producer_t producer;
+    device_bridge_t bridge;
+    device_bridge_stats_t stats;
+    vcard_thread_t thread;
+    int source_id, dest_id;
+    size_t total = 0;
+    uint64_t start, expected;
+    int passed = 1;
+
+    printf("Testing device bridge...\n");
+
+    vcard_init();
+    if (make_device("Bridge Source", TEST_SOURCE_RATE, &source_id) != VCARD_SUCCESS ||
+        make_device("Bridge Dest", TEST_DEST_RATE, &dest_id) != VCARD_SUCCESS ||
+        device_bridge_start(&bridge, source_id, dest_id, 0) != VCARD_SUCCESS) {
+        printf("  FAIL: Could not set up the bridge\n");
+        vcard_cleanup();
+        return 1;
+    }
+    producer.device_id = source_id;
+    vcard_atomic_store_relaxed_u32(&producer.running, 1);
+    vcard_thread_create(&thread, producer_main, &producer);
+
+    // Consume on a clock TEST_DRIFT fast
+    start = vcard_time_ns();
+    expected = (uint64_t)(TEST_SECONDS * TEST_DEST_RATE * (1.0 + TEST_DRIFT));
+    while (vcard_time_ns() - start < (uint64_t)TEST_SECONDS * 1000000000u) {
+        double due = (double)(vcard_time_ns() - start) * 1e-9 * TEST_DEST_RATE *
+                     (1.0 + TEST_DRIFT);
+        static float discard[TEST_BUFFER_SIZE];
+
+        while ((double)total + TEST_BUFFER_SIZE <= due) {
+            float *buffers[2] = { received + total, discard };
+            size_t got = 0;
+
+            if (total + TEST_BUFFER_SIZE > sizeof(received) / sizeof(received[0])) {
+                break;
+            }
+            vcard_read_audio(dest_id, buffers, TEST_BUFFER_SIZE, &got);
+            if (got == 0) {
+                break;
+            }
+            total += got;
+        }
+        vcard_sleep_us(1000);
+    }
+
+    vcard_atomic_store_release_u32(&producer.running, 0);
+    vcard_thread_join(&thread);
+    device_bridge_get_stats(&bridge, &stats);
+    device_bridge_stop(&bridge);
+
+    // Frames read, allowing for start-up and the buffering in between
+    if (total < expected * 9 / 10 || stats.frames_out == 0) {
+        printf("  FAIL: Read %zu of about %llu frames\n", total, (unsigned long long)expected);
+        passed = 0;
+    } else {
+        printf("  PASS: Read %zu frames across the bridge (%.1f ppm correction, fill %u/%u)\n",
+               total, stats.correction_ppm, stats.fill, stats.target);
+    }
+
+    // The last second: the tone at its frequency and level, unbroken
+    if (total > TEST_DEST_RATE) {
+        const float *tail = received + total - TEST_DEST_RATE;
+        double peak = 0.0;
+        int crossings = 0;
+
+        for (size_t i = 1; i < TEST_DEST_RATE; i++) {
+            if ((tail[i - 1] < 0.0f) != (tail[i] < 0.0f)) {
+                crossings++;
+            }
+            if (fabs(tail[i]) > peak) {
+                peak = fabs(tail[i]);
+            }
+        }
+        if (abs(crossings - 2000) > 20 || fabs(peak - 0.5) > 0.02) {
+            printf("  FAIL: Tone after the bridge (%d zero crossings, peak %.3f)\n",
+                   crossings, peak);
+            passed = 0;
+        } else {
+            printf("  PASS: Tone after the bridge (%d zero crossings, peak %.3f)\n",
+                   crossings, peak);
+        }
+    } else {
+        passed = 0;
+    }
+
+    // Bad parameters
+    {
+        int ok = device_bridge_start(&bridge, source_id, source_id, 0) == VCARD_ERROR_INVALID &&
+                 device_bridge_start(&bridge, source_id, 9999, 0) == VCARD_ERROR_NOT_FOUND &&
+                 device_bridge_start(&bridge, source_id, dest_id,
+                                     4 * TEST_BUFFER_SIZE) == VCARD_ERROR_INVALID;
+        if (!ok) {
+            printf("  FAIL: Bad parameters not rejected\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Bad parameters rejected\n");
+        }
+    }
+
+    vcard_destroy_device(source_id);
+    vcard_destroy_device(dest_id);
+    vcard_cleanup();
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,175 @@
+/**
+ * Test for the Persistent Device Discovery Cache
+ *
+ * Checks lookups, replacement and eviction order, that a saved cache loads
+ * back unchanged, that missing, foreign and damaged files load as empty or
+ * partial caches, that invalid names are rejected, and that invalidation
+ * removes the file.
+ */
+
+#include "device_cache.h"
+#include "vcard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FILE "test_device_cache.cache"
+
+static device_cache_t cache;
+static device_cache_t loaded;
+
+static int write_file(const char *text)
+{
+    FILE *fp = fopen(TEST_FILE, "w");
+
+    if (!fp) {
+        return 0;
+    }
+    fputs(text, fp);
+    return fclose(fp) == 0;
+}
+
+int main(void)
+{
+    int passed = 1;
+
+    printf("Testing device discovery cache...\n");
+
+    // Store, replace and look up
+    {
+        device_cache_load(&cache, NULL);
+        device_cache_store(&cache, "CABLE Input", "{0.0.0.00000000}.{a}");
+        device_cache_store(&cache, "Speakers", "{0.0.0.00000000}.{b}");
+        device_cache_store(&cache, "CABLE Input", "{0.0.0.00000000}.{c}");
+        if (cache.count != 2 ||
+            !device_cache_lookup(&cache, "CABLE Input") ||
+            strcmp(device_cache_lookup(&cache, "CABLE Input"), "{0.0.0.00000000}.{c}") != 0 ||
+            strcmp(cache.entries[0].name, "CABLE Input") != 0 ||
+            device_cache_lookup(&cache, "CABLE") != NULL ||
+            device_cache_lookup(&cache, NULL) != NULL) {
+            printf("  FAIL: Lookup after store and replace\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Replaced entries move to the front, misses return NULL\n");
+        }
+    }
+
+    // A full cache drops the least recently stored entry
+    {
+        char name[32], id[32];
+        int ok = 1;
+
+        device_cache_load(&cache, NULL);
+        for (int i = 0; i < DEVICE_CACHE_MAX_ENTRIES + 3; i++) {
+            snprintf(name, sizeof(name), "Device %d", i);
+            snprintf(id, sizeof(id), "id-%d", i);
+            ok = ok && device_cache_store(&cache, name, id) == VCARD_SUCCESS;
+        }
+        device_cache_remove(&cache, "Device 10");
+        ok = ok && cache.count == DEVICE_CACHE_MAX_ENTRIES - 1 &&
+             device_cache_lookup(&cache, "Device 2") == NULL &&
+             device_cache_lookup(&cache, "Device 3") != NULL &&
+             device_cache_lookup(&cache, "Device 10") == NULL &&
+             strcmp(cache.entries[0].id, "id-34") == 0;
+        if (!ok) {
+            printf("  FAIL: Eviction (%u entries)\n", cache.count);
+            passed = 0;
+        } else {
+            printf("  PASS: Oldest entries evicted, removal keeps the order\n");
+        }
+    }
+
+    // Save and load back
+    {
+        int ok;
+
+        remove(TEST_FILE);
+        device_cache_load(&cache, TEST_FILE);
+        device_cache_store(&cache, "Loopback Audio", "BlackHole2ch_UID");
+        device_cache_store(&cache, "Lautsprecher (Realtek\xc2\xae Audio)", "{0.0.0.00000000}.{d}");
+        ok = cache.dirty && device_cache_save(&cache) == VCARD_SUCCESS && !cache.dirty &&
+             device_cache_load(&loaded, TEST_FILE) == VCARD_SUCCESS &&
+             loaded.count == 2 && !loaded.dirty &&
+             strcmp(loaded.entries[0].name, cache.entries[0].name) == 0 &&
+             strcmp(loaded.entries[0].id, cache.entries[0].id) == 0 &&
+             strcmp(loaded.entries[1].name, "Loopback Audio") == 0 &&
+             strcmp(loaded.entries[1].id, "BlackHole2ch_UID") == 0;
+        if (!ok) {
+            printf("  FAIL: Save and load round trip\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Saved cache loads back unchanged\n");
+        }
+    }
+
+    // Missing, foreign and damaged files
+    {
+        int ok;
+
+        remove(TEST_FILE);
+        ok = device_cache_load(&loaded, TEST_FILE) == VCARD_SUCCESS && loaded.count == 0 &&
+             strcmp(loaded.path, TEST_FILE) == 0;
+        ok = ok && write_file("vcard-device-cache 2\nid\tname\n") &&
+             device_cache_load(&loaded, TEST_FILE) == VCARD_SUCCESS && loaded.count == 0;
+        ok = ok && write_file("vcard-device-cache 1\r\nid-a\tA\r\nno tab\n\tempty id\n"
+                              "id-b\tB\nid-c\tA\nid-d\tD") &&
+             device_cache_load(&loaded, TEST_FILE) == VCARD_SUCCESS && loaded.count == 2 &&
+             strcmp(device_cache_lookup(&loaded, "A"), "id-a") == 0 &&
+             strcmp(device_cache_lookup(&loaded, "B"), "id-b") == 0 &&
+             device_cache_lookup(&loaded, "D") == NULL;
+        if (!ok) {
+            printf("  FAIL: Damaged files (%u entries)\n", loaded.count);
+            passed = 0;
+        } else {
+            printf("  PASS: Missing and foreign files load empty, bad lines are skipped\n");
+        }
+    }
+
+    // Invalid names and identifiers are rejected
+    {
+        char longname[DEVICE_CACHE_NAME_MAX + 1];
+
+        memset(longname, 'x', sizeof(longname) - 1);
+        longname[sizeof(longname) - 1] = '\0';
+        device_cache_load(&cache, NULL);
+        if (device_cache_store(&cache, "", "id") != VCARD_ERROR_INVALID ||
+            device_cache_store(&cache, "name", "") != VCARD_ERROR_INVALID ||
+            device_cache_store(&cache, "a\tb", "id") != VCARD_ERROR_INVALID ||
+            device_cache_store(&cache, "name", "id\n") != VCARD_ERROR_INVALID ||
+            device_cache_store(&cache, longname, "id") != VCARD_ERROR_INVALID ||
+            cache.count != 0 || cache.dirty ||
+            device_cache_save(&cache) != VCARD_SUCCESS) {
+            printf("  FAIL: Invalid entries accepted\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Invalid entries rejected, memory-only cache never written\n");
+        }
+    }
+
+    // Invalidation removes the file
+    {
+        FILE *fp;
+
+        device_cache_load(&cache, TEST_FILE);
+        device_cache_store(&cache, "Speakers", "id");
+        device_cache_save(&cache);
+        device_cache_invalidate(TEST_FILE);
+        fp = fopen(TEST_FILE, "r");
+        if (fp) {
+            fclose(fp);
+            printf("  FAIL: Invalidated cache file still present\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Invalidation removes the cache file\n");
+        }
+    }
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,725 @@
+/**
+ * Test for the In-Process Device Engine
+ *
+ * Creates virtual devices and exchanges audio between a producer thread and
+ * a consumer thread through the per-channel lock-free rings, then switches
+ * the sample rate back and forth while both keep streaming. Applies an
+ * insert chain on read and keeps it across a rate change. Finally creates
+ * and destroys devices in batches while snapshots of every device's status
+ * are taken.
+ */
+
+#include "vcard.h"
+#include "vcard_thread.h"
+#include "vcard_atomic.h"
+#include "routing_mixer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TEST_CHANNELS 4
+#define TEST_BUFFER_SIZE 256
+#define TEST_TOTAL_FRAMES 1000000
+#define TEST_CHUNK 97
+#define TEST_SWITCHES 400
+#define TEST_BATCH 13            /* Leaves room for the churned pair */
+#define TEST_SNAPSHOTS 200000
+
+typedef struct {
+    int device_id;
+    int errors;
+} stream_context_t;
+
+/* Sample value for a given frame and channel (exact in float) */
+static float test_sample(size_t frame, int channel)
+{
+    return (float)((frame % 65536) + channel * 65536);
+}
+
+static void producer_thread(void *arg)
+{
+    stream_context_t *ctx = (stream_context_t *)arg;
+    float data[TEST_CHANNELS][TEST_CHUNK];
+    const float *buffers[TEST_CHANNELS];
+    size_t frame = 0;
+
+    for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+        buffers[ch] = data[ch];
+    }
+
+    while (frame < TEST_TOTAL_FRAMES) {
+        size_t n = TEST_TOTAL_FRAMES - frame < TEST_CHUNK ?
+                   TEST_TOTAL_FRAMES - frame : TEST_CHUNK;
+        size_t written = 0;
+
+        for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+            for (size_t i = 0; i < n; i++) {
+                data[ch][i] = test_sample(frame + i, ch);
+            }
+        }
+        if (vcard_write_audio(ctx->device_id, buffers, n, &written) != VCARD_SUCCESS) {
+            ctx->errors++;
+            return;
+        }
+        if (written < n) {
+            // Ring full: retry the remainder once the consumer catches up
+            vcard_sleep_us(50);
+        }
+        frame += written;
+    }
+}
+
+static void consumer_thread(void *arg)
+{
+    stream_context_t *ctx = (stream_context_t *)arg;
+    float data[TEST_CHANNELS][TEST_BUFFER_SIZE];
+    float *buffers[TEST_CHANNELS];
+    size_t frame = 0;
+
+    for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+        buffers[ch] = data[ch];
+    }
+
+    while (frame < TEST_TOTAL_FRAMES) {
+        size_t got = 0;
+
+        if (vcard_read_audio(ctx->device_id, buffers, TEST_BUFFER_SIZE, &got) != VCARD_SUCCESS) {
+            ctx->errors++;
+            return;
+        }
+        for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+            for (size_t i = 0; i < got; i++) {
+                if (data[ch][i] != test_sample(frame + i, ch)) {
+                    ctx->errors++;
+                    return;
+                }
+            }
+        }
+        if (got == 0) {
+            vcard_sleep_us(50);
+        }
+        frame += got;
+    }
+}
+
+/* Streams until running clears; counts frames whose channels disagree */
+typedef struct {
+    int device_id;
+    vcard_atomic_u32 running;
+    uint64_t frames;
+    uint64_t silent;
+    int errors;
+} live_context_t;
+
+static void live_writer(void *arg)
+{
+    live_context_t *ctx = (live_context_t *)arg;
+    float data[TEST_CHANNELS][TEST_CHUNK];
+    const float *buffers[TEST_CHANNELS];
+    size_t frame = 0;
+
+    for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+        buffers[ch] = data[ch];
+    }
+    while (vcard_atomic_load_acquire_u32(&ctx->running)) {
+        size_t written = 0;
+
+        for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+            for (size_t i = 0; i < TEST_CHUNK; i++) {
+                data[ch][i] = test_sample(frame + i, ch);
+            }
+        }
+        if (vcard_write_audio(ctx->device_id, buffers, TEST_CHUNK, &written) != VCARD_SUCCESS) {
+            ctx->errors++;
+            return;
+        }
+        if (written == 0) {
+            vcard_sleep_us(20);
+        }
+        frame += written;
+    }
+}
+
+static void live_reader(void *arg)
+{
+    live_context_t *ctx = (live_context_t *)arg;
+    float data[TEST_CHANNELS][TEST_BUFFER_SIZE];
+    float *buffers[TEST_CHANNELS];
+
+    for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+        buffers[ch] = data[ch];
+    }
+    while (vcard_atomic_load_acquire_u32(&ctx->running)) {
+        size_t got = 0;
+
+        if (vcard_read_audio(ctx->device_id, buffers, TEST_BUFFER_SIZE, &got) != VCARD_SUCCESS) {
+            ctx->errors++;
+            return;
+        }
+        for (size_t i = 0; i < got; i++) {
+            int silent = 1;
+
+            for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+                silent = silent && data[ch][i] == 0.0f;
+            }
+            if (silent) {
+                ctx->silent++;
+                continue;
+            }
+            // Frames may be dropped at a swap, but channels stay aligned
+            for (int ch = 1; ch < TEST_CHANNELS; ch++) {
+                if (data[ch][i] - data[0][i] != (float)(ch * 65536)) {
+                    ctx->errors++;
+                    break;
+                }
+            }
+        }
+        if (got == 0) {
+            vcard_sleep_us(20);
+        }
+        ctx->frames += got;
+    }
+}
+
+/* Creates and destroys a pair of devices in batches until running clears */
+typedef struct {
+    vcard_config_t configs[2];
+    vcard_atomic_u32 running;
+    uint32_t cycles;
+    int errors;
+} churn_context_t;
+
+static void churn_thread(void *arg)
+{
+    churn_context_t *ctx = (churn_context_t *)arg;
+    int ids[2];
+
+    while (vcard_atomic_load_acquire_u32(&ctx->running)) {
+        if (vcard_create_devices(ctx->configs, 2, ids) != VCARD_SUCCESS) {
+            ctx->errors++;
+            return;
+        }
+        // Long enough for some snapshots to see the pair
+        vcard_sleep_us(20);
+        if (vcard_destroy_devices(ids, 2) != VCARD_SUCCESS) {
+            ctx->errors++;
+            return;
+        }
+        ctx->cycles++;
+    }
+}
+
+static void make_config(vcard_config_t *config, const char *name)
+{
+    memset(config, 0, sizeof(*config));
+    snprintf(config->name, sizeof(config->name), "%s", name);
+    config->channels_in = TEST_CHANNELS;
+    config->channels_out = TEST_CHANNELS;
+    config->sample_rate = 48000;
+    config->buffer_size = TEST_BUFFER_SIZE;
+    config->bit_depth = VCARD_BIT_32;
+}
+
+int main(void)
+{
+    vcard_config_t config;
+    vcard_config_t read_back;
+    int device_id = -1;
+    int other_id = -1;
+    int result;
+    int passed = 1;
+
+    printf("Testing in-process device engine...\n");
+
+    vcard_init();
+
+    // Device creation and validation
+    make_config(&config, "Engine Test");
+    result = vcard_create_device(&config, &device_id);
+    if (result != VCARD_SUCCESS) {
+        printf("  FAIL: Device creation failed with error %d\n", result);
+        return 1;
+    }
+    printf("  PASS: Device created (id %d)\n", device_id);
+
+    result = vcard_create_device(&config, &other_id);
+    if (result != VCARD_ERROR_IN_USE) {
+        printf("  FAIL: Duplicate name should be rejected, got %d\n", result);
+        passed = 0;
+    } else {
+        printf("  PASS: Duplicate device name rejected\n");
+    }
+
+    make_config(&config, "Bad Device");
+    config.channels_out = VCARD_MAX_CHANNELS + 1;
+    result = vcard_create_device(&config, &other_id);
+    if (result != VCARD_ERROR_INVALID) {
+        printf("  FAIL: Invalid channel count should be rejected, got %d\n", result);
+        passed = 0;
+    } else {
+        printf("  PASS: Invalid configuration rejected\n");
+    }
+
+    if (vcard_get_config(device_id, &read_back) != VCARD_SUCCESS ||
+        strcmp(read_back.name, "Engine Test") != 0 ||
+        read_back.channels_out != TEST_CHANNELS) {
+        printf("  FAIL: Configuration read back incorrectly\n");
+        passed = 0;
+    } else {
+        printf("  PASS: Configuration read back\n");
+    }
+
+    vcard_device_info_t infos[VCARD_MAX_DEVICES];
+    int count = 0;
+    vcard_list_devices(infos, VCARD_MAX_DEVICES, &count);
+    if (count != 1 || infos[0].device_id != device_id) {
+        printf("  FAIL: Expected 1 listed device, got %d\n", count);
+        passed = 0;
+    } else {
+        printf("  PASS: Device listed\n");
+    }
+
+    // Producer/consumer exchange across threads
+    stream_context_t producer_ctx = { device_id, 0 };
+    stream_context_t consumer_ctx = { device_id, 0 };
+    vcard_thread_t producer, consumer;
+
+    vcard_thread_create(&consumer, consumer_thread, &consumer_ctx);
+    vcard_thread_create(&producer, producer_thread, &producer_ctx);
+    vcard_thread_join(&producer);
+    vcard_thread_join(&consumer);
+
+    if (producer_ctx.errors || consumer_ctx.errors) {
+        printf("  FAIL: Stream corrupted (producer errors %d, consumer errors %d)\n",
+               producer_ctx.errors, consumer_ctx.errors);
+        passed = 0;
+    } else {
+        printf("  PASS: %d frames x %d channels exchanged intact\n",
+               TEST_TOTAL_FRAMES, TEST_CHANNELS);
+    }
+
+    vcard_status_t status;
+    if (vcard_get_status(device_id, &status) != VCARD_SUCCESS ||
+        status.frames_processed != TEST_TOTAL_FRAMES) {
+        printf("  FAIL: Status frame count incorrect\n");
+        passed = 0;
+    } else {
+        printf("  PASS: Status reports %llu frames processed\n",
+               (unsigned long long)status.frames_processed);
+    }
+
+    // Routing: input 0 <- 0.5 * output 1, input 1 <- output 0 + output 1
+    {
+        vcard_routing_t routing;
+        float out_data[TEST_CHANNELS][TEST_CHUNK];
+        float in_data[TEST_CHANNELS][TEST_CHUNK];
+        const float *out[TEST_CHANNELS];
+        float *in[TEST_CHANNELS];
+        size_t frames = 0;
+        int routing_ok = 1;
+
+        memset(&routing, 0, sizeof(routing));
+        routing.num_routes = 3;
+        routing.routes[0].source_channel = 1;
+        routing.routes[0].dest_channel = 0;
+        routing.routes[0].gain = 0.5f;
+        routing.routes[1].source_channel = 0;
+        routing.routes[1].dest_channel = 1;
+        routing.routes[1].gain = 1.0f;
+        routing.routes[2].source_channel = 1;
+        routing.routes[2].dest_channel = 1;
+        routing.routes[2].gain = 1.0f;
+
+        if (vcard_set_routing(device_id, &routing) != VCARD_SUCCESS) {
+            printf("  FAIL: Routing rejected\n");
+            passed = 0;
+        }
+
+        for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+            for (int i = 0; i < TEST_CHUNK; i++) {
+                out_data[ch][i] = (float)(ch + 1);
+            }
+            out[ch] = out_data[ch];
+            in[ch] = in_data[ch];
+        }
+
+        // Gains ramp from the identity mapping: input 1 glides from 2 to 3
+        {
+            float prev = 2.0f;
+            size_t ramped = 0;
+
+            while (ramped < ROUTING_MIXER_RAMP_FRAMES) {
+                size_t n = ROUTING_MIXER_RAMP_FRAMES - ramped < TEST_CHUNK ?
+                           ROUTING_MIXER_RAMP_FRAMES - ramped : TEST_CHUNK;
+
+                vcard_write_audio(device_id, out, n, &frames);
+                vcard_read_audio(device_id, in, n, &frames);
+                for (size_t i = 0; i < frames; i++) {
+                    float step = in_data[1][i] - prev;
+                    if (step < -1e-5f || step > 2.0f / ROUTING_MIXER_RAMP_FRAMES) {
+                        routing_ok = 0;
+                    }
+                    prev = in_data[1][i];
+                }
+                ramped += frames;
+            }
+            if (!routing_ok || fabsf(prev - 3.0f) > 1e-2f) {
+                printf("  FAIL: Routing gain ramp not smooth\n");
+                passed = 0;
+            } else {
+                printf("  PASS: Routing change ramped over %d frames\n",
+                       ROUTING_MIXER_RAMP_FRAMES);
+            }
+        }
+
+        vcard_write_audio(device_id, out, TEST_CHUNK, &frames);
+        vcard_read_audio(device_id, in, TEST_CHUNK, &frames);
+
+        for (int i = 0; i < TEST_CHUNK; i++) {
+            if (fabsf(in_data[0][i] - 1.0f) > 1e-6f ||
+                fabsf(in_data[1][i] - 3.0f) > 1e-6f ||
+                in_data[2][i] != 0.0f || in_data[3][i] != 0.0f) {
+                routing_ok = 0;
+                break;
+            }
+        }
+        if (frames != TEST_CHUNK || !routing_ok) {
+            printf("  FAIL: Routed audio incorrect\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Routing applied on read\n");
+        }
+
+        routing.routes[0].source_channel = TEST_CHANNELS;
+        if (vcard_set_routing(device_id, &routing) != VCARD_ERROR_INVALID) {
+            printf("  FAIL: Out-of-range route should be rejected\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Out-of-range route rejected\n");
+        }
+    }
+
+    // Live sample rate and buffer size changes
+    {
+        float out_data[TEST_CHANNELS][TEST_CHUNK];
+        float in_data[TEST_CHANNELS][2 * TEST_BUFFER_SIZE];
+        const float *out[TEST_CHANNELS];
+        float *in[TEST_CHANNELS];
+        size_t frames = 0, buffered = 0;
+        int live_id = -1;
+        int ok = 1;
+
+        make_config(&config, "Reconfig Test");
+        result = vcard_create_device(&config, &live_id);
+        for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+            for (int i = 0; i < TEST_CHUNK; i++) {
+                out_data[ch][i] = test_sample((size_t)i, ch);
+            }
+            out[ch] = out_data[ch];
+            in[ch] = in_data[ch];
+        }
+
+        // Queued audio is dropped and one period of silence takes its place
+        vcard_write_audio(live_id, out, TEST_CHUNK, &frames);
+        config.sample_rate = 44100;
+        config.buffer_size = 2 * TEST_BUFFER_SIZE;
+        if (result != VCARD_SUCCESS ||
+            vcard_set_config(live_id, &config) != VCARD_SUCCESS ||
+            vcard_get_buffered(live_id, &buffered) != VCARD_SUCCESS ||
+            buffered != 2 * TEST_BUFFER_SIZE) {
+            ok = 0;
+        }
+        vcard_read_audio(live_id, in, 2 * TEST_BUFFER_SIZE, &frames);
+        for (size_t i = 0; i < frames; i++) {
+            if (in_data[0][i] != 0.0f || in_data[TEST_CHANNELS - 1][i] != 0.0f) {
+                ok = 0;
+            }
+        }
+        vcard_write_audio(live_id, out, TEST_CHUNK, &frames);
+        vcard_read_audio(live_id, in, TEST_CHUNK, &frames);
+        if (frames != TEST_CHUNK || in_data[2][5] != test_sample(5, 2) ||
+            vcard_get_status(live_id, &status) != VCARD_SUCCESS ||
+            status.sample_rate != 44100 || status.buffer_size != 2 * TEST_BUFFER_SIZE) {
+            ok = 0;
+        }
+        if (!ok) {
+            printf("  FAIL: Sample rate change while open\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Sample rate changed in place with one period of silence\n");
+        }
+
+        config.channels_out = TEST_CHANNELS - 1;
+        result = vcard_set_config(live_id, &config);
+        config.channels_out = TEST_CHANNELS;
+        config.midi_ports_in = 1;
+        if (result != VCARD_ERROR_IN_USE ||
+            vcard_set_config(live_id, &config) != VCARD_ERROR_IN_USE) {
+            printf("  FAIL: Channel and MIDI port count changes should be rejected\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Channel and MIDI port count changes rejected\n");
+        }
+        config.midi_ports_in = 0;
+
+        // Renames must keep names unique, with or without a rate change
+        {
+            vcard_config_t current;
+
+            snprintf(config.name, sizeof(config.name), "%s", "Engine Test");
+            ok = vcard_set_config(live_id, &config) == VCARD_ERROR_IN_USE;
+            config.sample_rate = 48000;
+            ok = ok && vcard_set_config(live_id, &config) == VCARD_ERROR_IN_USE;
+            config.sample_rate = 44100;
+            snprintf(config.name, sizeof(config.name), "%s", "Reconfig Renamed");
+            ok = ok && vcard_set_config(live_id, &config) == VCARD_SUCCESS &&
+                 vcard_get_config(live_id, &current) == VCARD_SUCCESS &&
+                 strcmp(current.name, "Reconfig Renamed") == 0;
+            snprintf(config.name, sizeof(config.name), "%s", "Reconfig Test");
+            ok = ok && vcard_set_config(live_id, &config) == VCARD_SUCCESS;
+            if (!ok) {
+                printf("  FAIL: Rename to a live device's name should be rejected\n");
+                passed = 0;
+            } else {
+                printf("  PASS: Rename to a live device's name rejected, free name accepted\n");
+            }
+        }
+
+        // Switch back and forth while a writer and a reader keep streaming
+        {
+            live_context_t live;
+            vcard_thread_t writer, reader;
+            uint64_t start, elapsed;
+            int switch_errors = 0;
+
+            memset(&live, 0, sizeof(live));
+            live.device_id = live_id;
+            vcard_atomic_store_relaxed_u32(&live.running, 1);
+            vcard_thread_create(&reader, live_reader, &live);
+            vcard_thread_create(&writer, live_writer, &live);
+
+            start = vcard_time_ns();
+            for (int i = 0; i < TEST_SWITCHES; i++) {
+                config.sample_rate = i % 2 ? 44100 : 192000;
+                config.buffer_size = i % 2 ? TEST_BUFFER_SIZE : 2 * TEST_BUFFER_SIZE;
+                if (vcard_set_config(live_id, &config) != VCARD_SUCCESS) {
+                    switch_errors++;
+                }
+                vcard_sleep_us(200);
+            }
+            elapsed = vcard_time_ns() - start;
+
+            vcard_atomic_store_release_u32(&live.running, 0);
+            vcard_thread_join(&writer);
+            vcard_thread_join(&reader);
+
+            vcard_get_status(live_id, &status);
+            vcard_get_buffered(live_id, &buffered);
+            if (switch_errors || live.errors || live.frames == 0 ||
+                live.frames == live.silent || status.sample_rate != 44100 ||
+                buffered > (size_t)TEST_BUFFER_SIZE * 4) {
+                printf("  FAIL: Live switching (%d switch errors, %d stream errors)\n",
+                       switch_errors, live.errors);
+                passed = 0;
+            } else {
+                printf("  PASS: %d switches while streaming (%.1f us each incl. 200 us pause, "
+                       "%llu frames, %llu silent)\n", TEST_SWITCHES,
+                       (double)elapsed / TEST_SWITCHES / 1000.0,
+                       (unsigned long long)live.frames, (unsigned long long)live.silent);
+            }
+        }
+        vcard_destroy_device(live_id);
+    }
+
+    // Insert chain applied on read, kept across a rate change, then removed
+    {
+        vcard_insert_chain_t inserts, read_inserts;
+        vcard_meter_t levels[VCARD_MAX_CHANNELS];
+        float out_data[TEST_CHANNELS][TEST_CHUNK];
+        float in_data[TEST_CHANNELS][TEST_CHUNK];
+        const float *out[TEST_CHANNELS];
+        float *in[TEST_CHANNELS];
+        size_t frames = 0;
+        int insert_id = -1;
+        int ok = 1;
+
+        make_config(&config, "Insert Test");
+        ok = vcard_create_device(&config, &insert_id) == VCARD_SUCCESS;
+        for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+            for (int i = 0; i < TEST_CHUNK; i++) {
+                out_data[ch][i] = 1.0f;
+            }
+            out[ch] = out_data[ch];
+            in[ch] = in_data[ch];
+        }
+        memset(&inserts, 0, sizeof(inserts));
+        inserts.num_inserts = 2;
+        inserts.inserts[0].type = VCARD_INSERT_GAIN;
+        inserts.inserts[0].channel_mask = 0x1;
+        inserts.inserts[0].gain_db = -6.0206f;
+        inserts.inserts[1].type = VCARD_INSERT_METER;
+        inserts.inserts[1].channel_mask = 0x3;
+        ok = ok && vcard_set_inserts(insert_id, &inserts) == VCARD_SUCCESS;
+        inserts.inserts[0].channel_mask = 1u << TEST_CHANNELS;
+        ok = ok && vcard_set_inserts(insert_id, &inserts) == VCARD_ERROR_INVALID;
+
+        for (int pass = 0; pass < 2 && ok; pass++) {
+            vcard_write_audio(insert_id, out, TEST_CHUNK, &frames);
+            vcard_read_audio(insert_id, in, TEST_CHUNK, &frames);
+            ok = frames == TEST_CHUNK && fabsf(in_data[0][TEST_CHUNK - 1] - 0.5f) < 1e-4f &&
+                 in_data[1][TEST_CHUNK - 1] == 1.0f &&
+                 vcard_get_insert_meter(insert_id, 1, levels) == VCARD_SUCCESS &&
+                 fabsf(levels[0].peak - 0.5f) < 1e-4f && levels[1].peak == 1.0f &&
+                 vcard_get_insert_meter(insert_id, 0, levels) == VCARD_ERROR_INVALID;
+            // The chain is rebuilt for the new rate; the rate change queues silence
+            config.sample_rate = 96000;
+            vcard_set_config(insert_id, &config);
+            vcard_read_audio(insert_id, in, TEST_CHUNK, &frames);
+            vcard_read_audio(insert_id, in, TEST_CHUNK, &frames);
+            vcard_read_audio(insert_id, in, TEST_CHUNK, &frames);
+        }
+        ok = ok && vcard_get_inserts(insert_id, &read_inserts) == VCARD_SUCCESS &&
+             read_inserts.num_inserts == 2 && read_inserts.inserts[0].channel_mask == 0x1;
+
+        inserts.num_inserts = 0;
+        vcard_set_inserts(insert_id, &inserts);
+        vcard_write_audio(insert_id, out, TEST_CHUNK, &frames);
+        vcard_read_audio(insert_id, in, TEST_CHUNK, &frames);
+        if (!ok || in_data[0][0] != 1.0f ||
+            vcard_get_insert_meter(insert_id, 1, levels) != VCARD_ERROR_INVALID) {
+            printf("  FAIL: Insert chain on read\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Insert chain applied on read, kept across a rate change, removed\n");
+        }
+        vcard_destroy_device(insert_id);
+    }
+
+    // Batch creation is all or nothing
+    {
+        vcard_config_t batch[VCARD_MAX_DEVICES];
+        vcard_status_t statuses[VCARD_MAX_DEVICES];
+        int ids[VCARD_MAX_DEVICES + 1];
+        int ok = 1;
+
+        for (int i = 0; i < VCARD_MAX_DEVICES; i++) {
+            char name[VCARD_MAX_DEVICE_NAME];
+
+            snprintf(name, sizeof(name), "Batch %d", i);
+            make_config(&batch[i], name);
+        }
+        strcpy(batch[2].name, batch[0].name);
+        if (vcard_create_devices(batch, 3, ids) != VCARD_ERROR_IN_USE) {
+            ok = 0;
+        }
+        strcpy(batch[2].name, "Engine Test");
+        if (vcard_create_devices(batch, 3, ids) != VCARD_ERROR_IN_USE) {
+            ok = 0;
+        }
+        strcpy(batch[2].name, "Batch 2");
+        batch[5].channels_out = 0;
+        if (vcard_create_devices(batch, 6, ids) != VCARD_ERROR_INVALID) {
+            ok = 0;
+        }
+        batch[5].channels_out = TEST_CHANNELS;
+        // One device already exists, so a full table's worth does not fit
+        if (vcard_create_devices(batch, VCARD_MAX_DEVICES, ids) != VCARD_ERROR_NO_MEMORY) {
+            ok = 0;
+        }
+        vcard_list_devices(infos, VCARD_MAX_DEVICES, &count);
+        if (!ok || count != 1) {
+            printf("  FAIL: Failed batch creation left %d devices\n", count);
+            passed = 0;
+        } else {
+            printf("  PASS: Failed batches (duplicate, invalid, too many) created nothing\n");
+        }
+
+        result = vcard_create_devices(batch, TEST_BATCH, ids);
+        ok = result == VCARD_SUCCESS;
+        for (int i = 0; ok && i < TEST_BATCH; i++) {
+            ok = vcard_get_config(ids[i], &read_back) == VCARD_SUCCESS &&
+                 strcmp(read_back.name, batch[i].name) == 0;
+        }
+        if (!ok || vcard_get_status_all(statuses, &count) != VCARD_SUCCESS ||
+            count != TEST_BATCH + 1 || !statuses[device_id].is_active ||
+            !statuses[ids[TEST_BATCH - 1]].is_active) {
+            printf("  FAIL: Batch creation (error %d)\n", result);
+            passed = 0;
+        } else {
+            printf("  PASS: %d devices created in one batch\n", TEST_BATCH);
+        }
+
+        // Snapshots never see half of a batch while another thread churns one
+        {
+            churn_context_t churn;
+            vcard_thread_t thread;
+            uint64_t start, elapsed;
+            int torn = 0, seen_pair = 0;
+
+            memset(&churn, 0, sizeof(churn));
+            make_config(&churn.configs[0], "Churn A");
+            make_config(&churn.configs[1], "Churn B");
+            vcard_atomic_store_relaxed_u32(&churn.running, 1);
+            vcard_thread_create(&thread, churn_thread, &churn);
+
+            start = vcard_time_ns();
+            for (int i = 0; i < TEST_SNAPSHOTS; i++) {
+                int active = 0;
+
+                vcard_get_status_all(statuses, &count);
+                for (int slot = 0; slot < VCARD_MAX_DEVICES; slot++) {
+                    active += statuses[slot].is_active;
+                }
+                if (active != count || (count != TEST_BATCH + 1 && count != TEST_BATCH + 3)) {
+                    torn++;
+                }
+                seen_pair += count == TEST_BATCH + 3;
+            }
+            elapsed = vcard_time_ns() - start;
+
+            vcard_atomic_store_release_u32(&churn.running, 0);
+            vcard_thread_join(&thread);
+            if (torn || churn.errors || churn.cycles == 0) {
+                printf("  FAIL: %d torn snapshots, %d churn errors\n", torn, churn.errors);
+                passed = 0;
+            } else {
+                printf("  PASS: %d snapshots of %d devices (%.0f ns each) during %u batch "
+                       "cycles, none torn, %d with the pair\n", TEST_SNAPSHOTS,
+                       VCARD_MAX_DEVICES, (double)elapsed / TEST_SNAPSHOTS, churn.cycles,
+                       seen_pair);
+            }
+        }
+
+        // An unknown ID is reported but does not stop the rest
+        ids[TEST_BATCH] = VCARD_MAX_DEVICES;
+        if (vcard_destroy_devices(ids, TEST_BATCH + 1) != VCARD_ERROR_NOT_FOUND ||
+            vcard_get_status_all(statuses, &count) != VCARD_SUCCESS || count != 1 ||
+            statuses[ids[0]].is_active) {
+            printf("  FAIL: Batch destruction left %d devices\n", count);
+            passed = 0;
+        } else {
+            printf("  PASS: Batch destroyed, unknown ID reported\n");
+        }
+    }
+
+    // Destruction
+    if (vcard_destroy_device(device_id) != VCARD_SUCCESS ||
+        vcard_destroy_device(device_id) != VCARD_ERROR_NOT_FOUND) {
+        printf("  FAIL: Device destruction\n");
+        passed = 0;
+    } else {
+        printf("  PASS: Device destroyed\n");
+    }
+
+    vcard_cleanup();
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
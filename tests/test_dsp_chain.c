@@ -0,0 +1,356 @@
+/**
+ * Test for the Insert Chain Processor
+ *
+ * Checks chain validation and scheduling, the four-lane EQ kernel against
+ * the same filters run one channel at a time, filter responses, delay
+ * lines across call boundaries, the limiter ceiling, meter levels and
+ * silent stand-ins for NULL channels, and times a typical chain.
+ */
+
+#include "dsp_chain.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TEST_RATE 48000
+#define TEST_CHANNELS 6
+#define TEST_FRAMES 4800
+#define TEST_CALL 97                     /* Odd call size: SIMD tails and block splits */
+#define TEST_TIMING_FRAMES 480000
+
+static vcard_insert_t make_insert(vcard_insert_type_t type, uint32_t mask)
+{
+    vcard_insert_t insert;
+
+    memset(&insert, 0, sizeof(insert));
+    insert.type = type;
+    insert.channel_mask = mask;
+    insert.q = 0.707f;
+    insert.frequency_hz = 1000.0f;
+    return insert;
+}
+
+static vcard_insert_t make_eq(vcard_eq_shape_t shape, uint32_t mask, float frequency,
+                              float q, float gain_db)
+{
+    vcard_insert_t insert = make_insert(VCARD_INSERT_EQ, mask);
+
+    insert.shape = shape;
+    insert.frequency_hz = frequency;
+    insert.q = q;
+    insert.gain_db = gain_db;
+    return insert;
+}
+
+/* Run a chain over planar buffers in TEST_CALL sized calls */
+static void run(dsp_chain_t *chain, float **buffers, uint32_t channels, uint32_t frames)
+{
+    for (uint32_t done = 0; done < frames; ) {
+        float *at[VCARD_MAX_CHANNELS];
+        uint32_t n = frames - done < TEST_CALL ? frames - done : TEST_CALL;
+
+        for (uint32_t ch = 0; ch < channels; ch++) {
+            at[ch] = buffers[ch] ? buffers[ch] + done : NULL;
+        }
+        dsp_chain_process(chain, at, n);
+        done += n;
+    }
+}
+
+static float test_input(uint32_t ch, uint32_t i)
+{
+    return 0.5f * sinf((float)i * (0.013f + 0.021f * (float)ch)) +
+           0.25f * sinf((float)i * (0.37f + 0.05f * (float)ch));
+}
+
+/* Peak amplitude of the second half of a buffer (past the filter transient) */
+static float settled_peak(const float *x, uint32_t frames)
+{
+    float peak = 0.0f;
+
+    for (uint32_t i = frames / 2; i < frames; i++) {
+        peak = fabsf(x[i]) > peak ? fabsf(x[i]) : peak;
+    }
+    return peak;
+}
+
+static void fill_sine(float *x, uint32_t frames, double frequency, float amplitude)
+{
+    for (uint32_t i = 0; i < frames; i++) {
+        x[i] = amplitude * (float)sin(2.0 * M_PI * frequency * i / TEST_RATE);
+    }
+}
+
+int main(void)
+{
+    static float data[TEST_CHANNELS][TEST_FRAMES];
+    static float ref[TEST_CHANNELS][TEST_FRAMES];
+    float *buffers[VCARD_MAX_CHANNELS];
+    vcard_insert_chain_t chain;
+    dsp_chain_t *compiled = NULL;
+    int passed = 1;
+
+    printf("Testing insert chain processor...\n");
+
+    for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+        buffers[ch] = data[ch];
+    }
+
+    // Validation
+    {
+        int ok = 1;
+
+        memset(&chain, 0, sizeof(chain));
+        chain.num_inserts = 1;
+        chain.inserts[0] = make_insert(VCARD_INSERT_GAIN, 1u << TEST_CHANNELS);
+        ok = ok && dsp_chain_validate(&chain, TEST_CHANNELS) == VCARD_ERROR_INVALID;
+        chain.inserts[0] = make_insert(VCARD_INSERT_GAIN, 0);
+        ok = ok && dsp_chain_validate(&chain, TEST_CHANNELS) == VCARD_ERROR_INVALID;
+        chain.inserts[0] = make_eq(VCARD_EQ_PEAK, 1, 1000.0f, 0.0f, 0.0f);
+        ok = ok && dsp_chain_validate(&chain, TEST_CHANNELS) == VCARD_ERROR_INVALID;
+        chain.inserts[0] = make_insert(VCARD_INSERT_DELAY, 1);
+        chain.inserts[0].time_ms = VCARD_MAX_INSERT_DELAY_MS + 1;
+        ok = ok && dsp_chain_validate(&chain, TEST_CHANNELS) == VCARD_ERROR_INVALID;
+        chain.inserts[0] = make_insert(VCARD_INSERT_LIMITER, 1);
+        chain.inserts[0].gain_db = 3.0f;
+        chain.inserts[0].time_ms = 50.0f;
+        ok = ok && dsp_chain_validate(&chain, TEST_CHANNELS) == VCARD_ERROR_INVALID;
+        chain.num_inserts = 0;
+        ok = ok && dsp_chain_build(&chain, TEST_CHANNELS, TEST_RATE, &compiled) == VCARD_SUCCESS &&
+             compiled == NULL;
+        if (!ok) {
+            printf("  FAIL: Invalid inserts accepted\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Invalid inserts rejected, empty chain compiles to nothing\n");
+        }
+    }
+
+    // Scheduling: per-channel inserts of one kind at one depth share a step
+    {
+        uint32_t steps, reordered;
+
+        memset(&chain, 0, sizeof(chain));
+        for (uint32_t ch = 0; ch < 4; ch++) {
+            chain.inserts[chain.num_inserts++] =
+                make_eq(VCARD_EQ_PEAK, 1u << ch, 500.0f * (ch + 1), 1.0f, 3.0f);
+        }
+        chain.inserts[chain.num_inserts++] = make_insert(VCARD_INSERT_GAIN, 0x3);
+        chain.inserts[chain.num_inserts++] = make_insert(VCARD_INSERT_GAIN, 0xC);
+        chain.inserts[chain.num_inserts++] = make_insert(VCARD_INSERT_METER, 0xF);
+        dsp_chain_build(&chain, TEST_CHANNELS, TEST_RATE, &compiled);
+        steps = dsp_chain_steps(compiled);
+        dsp_chain_free(compiled);
+
+        // A gain on channel 5 first depends on nothing: it joins the first depth
+        chain.inserts[chain.num_inserts++] = make_insert(VCARD_INSERT_GAIN, 1u << 5);
+        dsp_chain_build(&chain, TEST_CHANNELS, TEST_RATE, &compiled);
+        reordered = dsp_chain_steps(compiled);
+        dsp_chain_free(compiled);
+        if (steps != 3 || reordered != 4) {
+            printf("  FAIL: %u inserts compiled to %u and %u steps\n",
+                   chain.num_inserts - 1, steps, reordered);
+            passed = 0;
+        } else {
+            printf("  PASS: 7 inserts scheduled as 3 steps by dependency depth\n");
+        }
+    }
+
+    // Four-lane EQ against the same filters one channel at a time
+    {
+        static const vcard_eq_shape_t shapes[TEST_CHANNELS] = {
+            VCARD_EQ_PEAK, VCARD_EQ_LOW_SHELF, VCARD_EQ_HIGH_SHELF,
+            VCARD_EQ_LOWPASS, VCARD_EQ_HIGHPASS, VCARD_EQ_PEAK
+        };
+        float max_error = 0.0f;
+
+        memset(&chain, 0, sizeof(chain));
+        for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+            chain.inserts[chain.num_inserts++] =
+                make_eq(shapes[ch], 1u << ch, 300.0f + 700.0f * ch, 0.5f + 0.3f * ch,
+                        -9.0f + 4.0f * ch);
+            for (uint32_t i = 0; i < TEST_FRAMES; i++) {
+                data[ch][i] = ref[ch][i] = test_input(ch, i);
+            }
+        }
+        dsp_chain_build(&chain, TEST_CHANNELS, TEST_RATE, &compiled);
+        run(compiled, buffers, TEST_CHANNELS, TEST_FRAMES);
+        dsp_chain_free(compiled);
+
+        for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+            vcard_insert_chain_t single;
+            float *one[VCARD_MAX_CHANNELS] = { NULL };
+
+            memset(&single, 0, sizeof(single));
+            single.num_inserts = 1;
+            single.inserts[0] = chain.inserts[ch];
+            one[ch] = ref[ch];
+            dsp_chain_build(&single, TEST_CHANNELS, TEST_RATE, &compiled);
+            run(compiled, one, TEST_CHANNELS, TEST_FRAMES);
+            dsp_chain_free(compiled);
+            for (uint32_t i = 0; i < TEST_FRAMES; i++) {
+                float e = fabsf(data[ch][i] - ref[ch][i]);
+                max_error = e > max_error ? e : max_error;
+            }
+        }
+        if (max_error > 1e-5f) {
+            printf("  FAIL: Lane kernel differs from single-channel filter by %g\n",
+                   max_error);
+            passed = 0;
+        } else {
+            printf("  PASS: Four-lane EQ matches single-channel filters (max error %g)\n",
+                   max_error);
+        }
+    }
+
+    // Filter responses: +6 dB peak at its center, -30 dB a decade past a lowpass
+    {
+        float boosted, cut;
+
+        memset(&chain, 0, sizeof(chain));
+        chain.num_inserts = 2;
+        chain.inserts[0] = make_eq(VCARD_EQ_PEAK, 0x1, 1000.0f, 1.0f, 6.0f);
+        chain.inserts[1] = make_eq(VCARD_EQ_LOWPASS, 0x2, 1000.0f, 0.707f, 0.0f);
+        fill_sine(data[0], TEST_FRAMES, 1000.0, 0.25f);
+        fill_sine(data[1], TEST_FRAMES, 10000.0, 0.25f);
+        dsp_chain_build(&chain, 2, TEST_RATE, &compiled);
+        run(compiled, buffers, 2, TEST_FRAMES);
+        dsp_chain_free(compiled);
+        boosted = 20.0f * log10f(settled_peak(data[0], TEST_FRAMES) / 0.25f);
+        cut = 20.0f * log10f(settled_peak(data[1], TEST_FRAMES) / 0.25f);
+        if (fabsf(boosted - 6.0f) > 0.1f || cut > -30.0f) {
+            printf("  FAIL: Peak gain %.2f dB, lowpass at 10 kHz %.1f dB\n", boosted, cut);
+            passed = 0;
+        } else {
+            printf("  PASS: Peak gain %.2f dB at center, lowpass %.1f dB at 10 kHz\n",
+                   boosted, cut);
+        }
+    }
+
+    // Delay lines keep their place across calls; gain applies after
+    {
+        uint32_t delay_frames = (uint32_t)(TEST_RATE * 12.5 / 1000.0);
+        int ok = 1;
+
+        memset(&chain, 0, sizeof(chain));
+        chain.num_inserts = 2;
+        chain.inserts[0] = make_insert(VCARD_INSERT_DELAY, 0x1);
+        chain.inserts[0].time_ms = 12.5f;
+        chain.inserts[1] = make_insert(VCARD_INSERT_GAIN, 0x1);
+        chain.inserts[1].gain_db = -6.0206f;
+        for (uint32_t i = 0; i < TEST_FRAMES; i++) {
+            data[0][i] = (float)(i + 1);
+        }
+        dsp_chain_build(&chain, 1, TEST_RATE, &compiled);
+        run(compiled, buffers, 1, TEST_FRAMES);
+        dsp_chain_free(compiled);
+        for (uint32_t i = 0; i < TEST_FRAMES; i++) {
+            float expected = i < delay_frames ? 0.0f : 0.5f * (float)(i + 1 - delay_frames);
+            if (fabsf(data[0][i] - expected) > 1e-3f * (expected + 1.0f)) {
+                ok = 0;
+                break;
+            }
+        }
+        if (!ok) {
+            printf("  FAIL: Delay line\n");
+            passed = 0;
+        } else {
+            printf("  PASS: %u frame delay across %d frame calls\n", delay_frames, TEST_CALL);
+        }
+    }
+
+    // Limiter holds linked channels under the ceiling; meters follow the level
+    {
+        vcard_meter_t levels[VCARD_MAX_CHANNELS];
+        float ceiling = powf(10.0f, -6.0f / 20.0f);
+        float peak = 0.0f;
+
+        memset(&chain, 0, sizeof(chain));
+        chain.num_inserts = 3;
+        chain.inserts[0] = make_insert(VCARD_INSERT_METER, 0x7);
+        chain.inserts[1] = make_insert(VCARD_INSERT_LIMITER, 0x3);
+        chain.inserts[1].gain_db = -6.0f;
+        chain.inserts[1].time_ms = 50.0f;
+        chain.inserts[2] = make_insert(VCARD_INSERT_GAIN, 0x4);
+        fill_sine(data[0], TEST_FRAMES, 440.0, 2.0f);
+        fill_sine(data[1], TEST_FRAMES, 440.0, 0.1f);
+        buffers[2] = NULL;
+        dsp_chain_build(&chain, 3, TEST_RATE, &compiled);
+        // Three seconds: ten meter time constants
+        for (int pass = 0; pass < 30; pass++) {
+            run(compiled, buffers, 3, TEST_FRAMES);
+            peak = settled_peak(data[0], TEST_FRAMES);
+            fill_sine(data[0], TEST_FRAMES, 440.0, 2.0f);
+            fill_sine(data[1], TEST_FRAMES, 440.0, 0.1f);
+        }
+        buffers[2] = data[2];
+        if (dsp_chain_meter(compiled, 0, levels) != VCARD_SUCCESS ||
+            dsp_chain_meter(compiled, 1, levels) != VCARD_ERROR_INVALID) {
+            printf("  FAIL: Meter lookup\n");
+            passed = 0;
+        }
+        dsp_chain_meter(compiled, 0, levels);
+        dsp_chain_free(compiled);
+        if (peak > ceiling * 1.0001f || peak < ceiling * 0.9f ||
+            fabsf(levels[0].peak - 2.0f) > 0.01f ||
+            fabsf(levels[0].rms - 2.0f / sqrtf(2.0f)) > 0.02f ||
+            fabsf(levels[1].rms - 0.1f / sqrtf(2.0f)) > 0.002f ||
+            levels[2].peak != 0.0f || levels[3].peak != 0.0f) {
+            printf("  FAIL: Limited peak %.4f (ceiling %.4f), meter %.3f/%.3f\n",
+                   peak, ceiling, levels[0].peak, levels[0].rms);
+            passed = 0;
+        } else {
+            printf("  PASS: Limiter holds %.4f under a %.4f ceiling; meter %.3f peak, "
+                   "%.3f RMS; NULL channel silent\n", peak, ceiling, levels[0].peak,
+                   levels[0].rms);
+        }
+    }
+
+    // A typical chain: EQ, limiter and meter on six channels
+    {
+        static float block[TEST_CHANNELS][TEST_CALL];
+        float *io[VCARD_MAX_CHANNELS];
+        uint64_t start;
+        double ns;
+
+        memset(&chain, 0, sizeof(chain));
+        for (uint32_t band = 0; band < 3; band++) {
+            chain.inserts[chain.num_inserts++] = make_eq(VCARD_EQ_PEAK, 0x3F,
+                                                         250.0f * (band + 1), 1.0f, 2.0f);
+        }
+        chain.inserts[chain.num_inserts++] = make_insert(VCARD_INSERT_LIMITER, 0x3F);
+        chain.inserts[chain.num_inserts - 1].gain_db = -1.0f;
+        chain.inserts[chain.num_inserts - 1].time_ms = 50.0f;
+        chain.inserts[chain.num_inserts++] = make_insert(VCARD_INSERT_METER, 0x3F);
+        for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+            for (uint32_t i = 0; i < TEST_CALL; i++) {
+                block[ch][i] = test_input(ch, i);
+            }
+            io[ch] = block[ch];
+        }
+        dsp_chain_build(&chain, TEST_CHANNELS, TEST_RATE, &compiled);
+        start = vcard_time_ns();
+        for (uint32_t done = 0; done < TEST_TIMING_FRAMES; done += TEST_CALL) {
+            dsp_chain_process(compiled, io, TEST_CALL);
+        }
+        ns = (double)(vcard_time_ns() - start) / TEST_TIMING_FRAMES;
+        dsp_chain_free(compiled);
+        printf("  PASS: 3 EQ bands, limiter and meter on %d channels: %.1f ns per frame\n",
+               TEST_CHANNELS, ns);
+    }
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
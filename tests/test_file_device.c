@@ -0,0 +1,229 @@
+/**
+ * Test for the File Device
+ *
+ * Records a device to disk while the test feeds its outputs, and plays a
+ * file into a device while the test drains its inputs, checking that every
+ * frame arrives intact and in order through the pump and I/O threads.
+ */
+
+#include "file_device.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FILE "test_file_device.wav"
+#define TEST_RATE 48000
+#define TEST_BUFFER_SIZE 256
+#define TEST_FRAMES 100000      /* Over a dozen blocks, not a multiple */
+#define TEST_CHUNK 301
+#define TEST_TIMEOUT_NS 20000000000ull
+
+/* Sample value for a given frame and channel (exact in float) */
+static float test_sample(size_t frame, uint32_t channel)
+{
+    return (float)((int)(frame % 65536) - 32768 + (int)channel * 7) / 65536.0f;
+}
+
+static int make_device(const char *name, uint32_t in, uint32_t out, int *device_id)
+{
+    vcard_config_t config;
+
+    memset(&config, 0, sizeof(config));
+    strncpy(config.name, name, VCARD_MAX_DEVICE_NAME - 1);
+    config.channels_in = in;
+    config.channels_out = out;
+    config.sample_rate = TEST_RATE;
+    config.buffer_size = TEST_BUFFER_SIZE;
+    config.bit_depth = VCARD_BIT_32;
+    return vcard_create_device(&config, device_id);
+}
+
+/* Feed TEST_FRAMES into a device record, then flush the recording */
+static int test_record(void)
+{
+    static float data[2][TEST_CHUNK];
+    static float plane_data[2][TEST_FRAMES];
+    const float *buffers[2] = { data[0], data[1] };
+    float *planes[2] = { plane_data[0], plane_data[1] };
+    file_device_t fd;
+    file_device_stats_t stats;
+    vcard_status_t status;
+    wav_reader_t r;
+    uint64_t deadline = vcard_time_ns() + TEST_TIMEOUT_NS;
+    size_t frame = 0;
+    int device_id;
+    int ok;
+
+    if (make_device("File Record", 2, 2, &device_id) != VCARD_SUCCESS ||
+        file_device_start(&fd, device_id, TEST_FILE, FILE_DEVICE_RECORD,
+                          SINE_FORMAT_F32, WAV_CONTAINER_W64) != VCARD_SUCCESS) {
+        return 0;
+    }
+
+    while (frame < TEST_FRAMES && vcard_time_ns() < deadline) {
+        size_t n = TEST_FRAMES - frame < TEST_CHUNK ? TEST_FRAMES - frame : TEST_CHUNK;
+        size_t written = 0;
+
+        for (uint32_t ch = 0; ch < 2; ch++) {
+            for (size_t i = 0; i < n; i++) {
+                data[ch][i] = test_sample(frame + i, ch);
+            }
+        }
+        vcard_write_audio(device_id, buffers, n, &written);
+        frame += written;
+        if (written < n) {
+            vcard_sleep_us(200);
+        }
+    }
+    // Wait for the pump to take everything out of the device
+    do {
+        vcard_sleep_us(1000);
+        vcard_get_status(device_id, &status);
+    } while (status.frames_processed < TEST_FRAMES && vcard_time_ns() < deadline);
+
+    ok = file_device_stop(&fd) == VCARD_SUCCESS;
+    file_device_get_stats(&fd, &stats);
+    ok = ok && frame == TEST_FRAMES && stats.frames == TEST_FRAMES &&
+         stats.dropped_frames == 0;
+    vcard_destroy_device(device_id);
+
+    if (!ok || wav_reader_open(&r, TEST_FILE, WAV_READER_MMAP) != VCARD_SUCCESS) {
+        printf("  FAIL: Recorded %llu of %d frames (%llu dropped)\n",
+               (unsigned long long)stats.frames, TEST_FRAMES,
+               (unsigned long long)stats.dropped_frames);
+        return 0;
+    }
+    ok = r.channels == 2 && r.frames == TEST_FRAMES &&
+         wav_reader_read_planar(&r, planes, TEST_FRAMES) == TEST_FRAMES;
+    for (size_t i = 0; ok && i < TEST_FRAMES; i++) {
+        ok = plane_data[0][i] == test_sample(i, 0) && plane_data[1][i] == test_sample(i, 1);
+    }
+    wav_reader_close(&r);
+    if (!ok) {
+        printf("  FAIL: Recording does not match the device input\n");
+        return 0;
+    }
+    printf("  PASS: Recorded %d frames through the file device\n", TEST_FRAMES);
+    return 1;
+}
+
+/* Play a stereo file into a three-output device and drain it */
+static int test_play(void)
+{
+    static float data[3][TEST_CHUNK];
+    float *buffers[3] = { data[0], data[1], data[2] };
+    const float *planes[2];
+    file_device_t fd;
+    file_device_stats_t stats;
+    wav_writer_t w;
+    uint64_t deadline = vcard_time_ns() + TEST_TIMEOUT_NS;
+    size_t frame = 0;
+    int device_id;
+    int ok = 1;
+
+    if (wav_writer_open(&w, TEST_FILE, 2, TEST_RATE, SINE_FORMAT_F32,
+                        WAV_CONTAINER_AUTO) != VCARD_SUCCESS) {
+        return 0;
+    }
+    for (size_t done = 0; done < TEST_FRAMES; done += TEST_CHUNK) {
+        size_t n = TEST_FRAMES - done < TEST_CHUNK ? TEST_FRAMES - done : TEST_CHUNK;
+        for (uint32_t ch = 0; ch < 2; ch++) {
+            for (size_t i = 0; i < n; i++) {
+                data[ch][i] = test_sample(done + i, ch);
+            }
+            planes[ch] = data[ch];
+        }
+        wav_writer_write_planar(&w, planes, n);
+    }
+    if (wav_writer_close(&w) != VCARD_SUCCESS ||
+        make_device("File Play", 3, 3, &device_id) != VCARD_SUCCESS ||
+        file_device_start(&fd, device_id, TEST_FILE, FILE_DEVICE_PLAY,
+                          SINE_FORMAT_F32, WAV_CONTAINER_AUTO) != VCARD_SUCCESS) {
+        return 0;
+    }
+
+    while (frame < TEST_FRAMES && vcard_time_ns() < deadline) {
+        size_t got = 0;
+
+        vcard_read_audio(device_id, buffers, TEST_CHUNK, &got);
+        for (size_t i = 0; i < got; i++) {
+            if (data[0][i] != test_sample(frame + i, 0) ||
+                data[1][i] != test_sample(frame + i, 1) || data[2][i] != 0.0f) {
+                ok = 0;
+            }
+        }
+        frame += got;
+        if (got == 0) {
+            vcard_sleep_us(200);
+        }
+    }
+    while (!file_device_finished(&fd) && vcard_time_ns() < deadline) {
+        vcard_sleep_us(1000);
+    }
+
+    ok = ok && frame == TEST_FRAMES && file_device_finished(&fd);
+    file_device_get_stats(&fd, &stats);
+    ok = file_device_stop(&fd) == VCARD_SUCCESS && ok && stats.frames == TEST_FRAMES;
+    vcard_destroy_device(device_id);
+    if (!ok) {
+        printf("  FAIL: Played %zu of %d frames\n", frame, TEST_FRAMES);
+        return 0;
+    }
+    printf("  PASS: Played %d frames through the file device (%u underruns)\n",
+           TEST_FRAMES, stats.underruns);
+    return 1;
+}
+
+int main(void)
+{
+    file_device_t fd;
+    int device_id;
+    int passed = 1;
+
+    printf("Testing file device...\n");
+
+    vcard_init();
+
+    passed &= test_record();
+    passed &= test_play();
+
+    // Missing files, unknown devices and mismatched sample rates
+    {
+        vcard_config_t config = { 0 };
+        int other_id = -1;
+        int ok = make_device("File Errors", 2, 2, &device_id) == VCARD_SUCCESS &&
+                 file_device_start(&fd, device_id, "does_not_exist.wav", FILE_DEVICE_PLAY,
+                                   SINE_FORMAT_F32, WAV_CONTAINER_AUTO) == VCARD_ERROR_IO &&
+                 file_device_start(&fd, 9999, TEST_FILE, FILE_DEVICE_RECORD,
+                                   SINE_FORMAT_F32, WAV_CONTAINER_AUTO) == VCARD_ERROR_NOT_FOUND &&
+                 vcard_get_config(device_id, &config) == VCARD_SUCCESS;
+
+        // TEST_FILE is still the 48 kHz file played above
+        strncpy(config.name, "File Errors 44k", VCARD_MAX_DEVICE_NAME - 1);
+        config.sample_rate = 44100;
+        ok = ok && vcard_create_device(&config, &other_id) == VCARD_SUCCESS &&
+             file_device_start(&fd, other_id, TEST_FILE, FILE_DEVICE_PLAY,
+                               SINE_FORMAT_F32, WAV_CONTAINER_AUTO) == VCARD_ERROR_INVALID;
+        vcard_destroy_device(other_id);
+        vcard_destroy_device(device_id);
+        if (!ok) {
+            printf("  FAIL: Bad files and devices not rejected\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Bad files and devices rejected\n");
+        }
+    }
+
+    remove(TEST_FILE);
+    vcard_cleanup();
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,207 @@
+/**
+ * Test for the Round-Trip Latency Probe
+ *
+ * Renders probe bursts, delivers them to the detector through a simulated
+ * pipeline with a known delay, in different buffer sizes, and checks the
+ * measured latency, robustness to gain, inversion and noise, and the
+ * statistics and jitter histogram.
+ */
+
+#include "latency_probe.h"
+#include "vcard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_SECONDS 10
+#define TEST_FRAMES ((size_t)(TEST_SECONDS * TEST_SAMPLE_RATE))
+#define TEST_RENDER_PERIOD 256
+#define TEST_READ_PERIOD 333
+#define TEST_DELAY_FRAMES 1000
+#define TEST_BURSTS 40
+
+/* Start the clock past 2^32 us so the timestamps wrap */
+#define TEST_EPOCH_NS 5000000000000ull
+
+static uint64_t frame_time_ns(size_t frame)
+{
+    return TEST_EPOCH_NS + (uint64_t)((double)frame * 1e9 / TEST_SAMPLE_RATE + 0.5);
+}
+
+/* Generator side: TEST_SECONDS of bursts, stamped as if rendered in real time */
+static float *render_stream(void)
+{
+    latency_probe_t probe;
+    float *stream = malloc(TEST_FRAMES * sizeof(float));
+
+    if (!stream ||
+        latency_probe_init(&probe, TEST_SAMPLE_RATE, LATENCY_PROBE_DEFAULT_INTERVAL,
+                           0.5) != VCARD_SUCCESS) {
+        free(stream);
+        return NULL;
+    }
+    for (size_t done = 0; done < TEST_FRAMES; done += TEST_RENDER_PERIOD) {
+        latency_probe_render(&probe, stream + done, TEST_RENDER_PERIOD,
+                             frame_time_ns(done));
+    }
+    return stream;
+}
+
+/*
+ * Reader side: each period arrives TEST_DELAY_FRAMES after it was rendered,
+ * plus jitter_us on every third period
+ */
+static void receive_stream(latency_detector_t *d, const float *stream,
+                           double jitter_us)
+{
+    for (size_t done = 0, n = 0; done < TEST_FRAMES; done += TEST_READ_PERIOD, n++) {
+        size_t frames = TEST_FRAMES - done < TEST_READ_PERIOD ? TEST_FRAMES - done :
+                                                                TEST_READ_PERIOD;
+        uint64_t t = frame_time_ns(done + frames - 1 + TEST_DELAY_FRAMES);
+
+        if (n % 3 == 2) {
+            t += (uint64_t)(jitter_us * 1000.0);
+        }
+        latency_detector_process(d, stream + done, frames, 1, t);
+    }
+}
+
+int main(void)
+{
+    static latency_detector_t detector;
+    latency_probe_t probe;
+    latency_report_t report;
+    double expected_us = TEST_DELAY_FRAMES * 1e6 / TEST_SAMPLE_RATE;
+    float *stream;
+    int passed = 1;
+
+    printf("Testing latency probe...\n");
+
+    if (latency_probe_init(&probe, 4000.0, 0.25, 0.5) != VCARD_ERROR_INVALID ||
+        latency_probe_init(&probe, TEST_SAMPLE_RATE, 0.01, 0.5) != VCARD_ERROR_INVALID ||
+        latency_probe_init(&probe, TEST_SAMPLE_RATE, 0.25, 0.0) != VCARD_ERROR_INVALID ||
+        latency_detector_init(&detector, 384000.0) != VCARD_ERROR_INVALID) {
+        printf("  FAIL: Invalid configurations should be rejected\n");
+        passed = 0;
+    } else {
+        printf("  PASS: Invalid configurations rejected\n");
+    }
+
+    stream = render_stream();
+    if (!stream) {
+        printf("  FAIL: Could not render the probe stream\n");
+        return 1;
+    }
+
+    // Clean pipeline with a fixed delay
+    {
+        int ok;
+
+        latency_detector_init(&detector, TEST_SAMPLE_RATE);
+        receive_stream(&detector, stream, 0.0);
+        latency_stats_report(&detector.stats, &report);
+        ok = report.count == TEST_BURSTS && report.errors == 0 &&
+             fabs(report.min_us - expected_us) < 2.0 &&
+             fabs(report.max_us - expected_us) < 2.0 &&
+             report.jitter_us < 1.0;
+
+        if (!ok) {
+            printf("  FAIL: Fixed delay (%llu bursts, %.2f-%.2f us, expected %.2f us)\n",
+                   (unsigned long long)report.count, report.min_us, report.max_us,
+                   expected_us);
+            passed = 0;
+        } else {
+            printf("  PASS: %llu bursts at %.2f us (expected %.2f us)\n",
+                   (unsigned long long)report.count, report.mean_us, expected_us);
+        }
+    }
+
+    // Inverted, attenuated and noisy, one channel of interleaved 16-bit stereo
+    {
+        int16_t period[TEST_READ_PERIOD * 2];
+        uint32_t seed = 1;
+        int ok;
+
+        latency_detector_init(&detector, TEST_SAMPLE_RATE);
+        for (size_t done = 0; done < TEST_FRAMES; done += TEST_READ_PERIOD) {
+            size_t frames = TEST_FRAMES - done < TEST_READ_PERIOD ? TEST_FRAMES - done :
+                                                                    TEST_READ_PERIOD;
+
+            for (size_t i = 0; i < frames; i++) {
+                double noise;
+
+                seed ^= seed << 13;
+                seed ^= seed >> 17;
+                seed ^= seed << 5;
+                noise = 0.05 * ((double)seed / 2147483648.0 - 1.0);
+                period[2 * i] = (int16_t)lrint((-0.3 * stream[done + i] + noise) * 32767.0);
+                period[2 * i + 1] = (int16_t)lrint(0.5 * sin(0.05 * (double)(done + i)) * 32767.0);
+            }
+            latency_detector_process_i16(&detector, period, frames, 2,
+                                         frame_time_ns(done + frames - 1 + TEST_DELAY_FRAMES));
+        }
+        latency_stats_report(&detector.stats, &report);
+        ok = report.count == TEST_BURSTS && report.errors == 0 &&
+             fabs(report.min_us - expected_us) < 15.0 &&
+             fabs(report.max_us - expected_us) < 15.0;
+
+        if (!ok) {
+            printf("  FAIL: Degraded signal (%llu bursts, %llu errors, %.2f-%.2f us)\n",
+                   (unsigned long long)report.count, (unsigned long long)report.errors,
+                   report.min_us, report.max_us);
+            passed = 0;
+        } else {
+            printf("  PASS: Inverted noisy 16-bit signal, %.2f-%.2f us\n",
+                   report.min_us, report.max_us);
+        }
+    }
+
+    // Late reads: statistics and jitter histogram
+    {
+        uint32_t bins[16];
+        double bin_us;
+        uint32_t used;
+        uint64_t total = 0;
+        int ok;
+
+        latency_detector_init(&detector, TEST_SAMPLE_RATE);
+        receive_stream(&detector, stream, 2000.0);
+        latency_stats_report(&detector.stats, &report);
+        used = latency_stats_jitter_histogram(&detector.stats, bins, 16, &bin_us);
+        for (uint32_t b = 0; b < used; b++) {
+            total += bins[b];
+        }
+        ok = report.count == TEST_BURSTS &&
+             fabs(report.min_us - expected_us) < 2.0 &&
+             fabs(report.max_us - expected_us - 2000.0) < 2.0 &&
+             report.mean_us > report.min_us && report.mean_us < report.max_us &&
+             report.p99_us <= report.max_us && report.p99_us > report.max_us - 100.0 &&
+             report.jitter_us > 500.0 && report.jitter_us < 1000.0 &&
+             used >= 2 && used <= 16 && total == report.count &&
+             bins[0] > 0 && bins[used - 1] > 0;
+
+        if (!ok) {
+            printf("  FAIL: Jitter (min %.1f, mean %.1f, p99 %.1f, max %.1f, "
+                   "jitter %.1f us, %u bins)\n", report.min_us, report.mean_us,
+                   report.p99_us, report.max_us, report.jitter_us, used);
+            passed = 0;
+        } else {
+            printf("  PASS: min %.1f, mean %.1f, p99 %.1f, max %.1f us, "
+                   "%u x %.0f us jitter bins\n", report.min_us, report.mean_us,
+                   report.p99_us, report.max_us, used, bin_us);
+        }
+    }
+
+    free(stream);
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,400 @@
+/**
+ * Test for the MIDI Loopback Transport
+ *
+ * Opens MIDI ports on a virtual device and checks timestamped delivery,
+ * sysex pool handling, callbacks (also replaced while a sender streams),
+ * and a producer/consumer stress run
+ * through the lock-free per-port queues.
+ */
+
+#include "vcard.h"
+#include "vcard_atomic.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_STREAM_MESSAGES 200000
+#define TEST_SYSEX_EVERY 1000
+#define TEST_SYSEX_LENGTH 600
+
+typedef struct {
+    vcard_midi_handle_t out;
+    vcard_midi_handle_t in;
+    int errors;
+} stream_context_t;
+
+typedef struct {
+    int calls;
+    uint8_t last[3];
+} callback_context_t;
+
+typedef struct {
+    char tag;                /* Which callback this user data belongs to */
+    int calls;
+    int errors;
+} swap_context_t;
+
+typedef struct {
+    vcard_midi_handle_t out;
+    vcard_atomic_u32 running;
+    vcard_atomic_u32 sends;
+} swap_sender_t;
+
+/* Fill a sysex message whose payload encodes its sequence number */
+static void make_sysex(uint8_t *msg, size_t length, uint32_t seq)
+{
+    msg[0] = 0xF0;
+    for (size_t i = 1; i < length - 1; i++) {
+        msg[i] = (uint8_t)((seq + i) & 0x7F);
+    }
+    msg[length - 1] = 0xF7;
+}
+
+static void sender_thread(void *arg)
+{
+    stream_context_t *ctx = (stream_context_t *)arg;
+    uint8_t sysex[TEST_SYSEX_LENGTH];
+    uint32_t seq = 0;
+
+    while (seq < TEST_STREAM_MESSAGES) {
+        int result;
+
+        if (seq % TEST_SYSEX_EVERY == 0) {
+            make_sysex(sysex, sizeof(sysex), seq);
+            result = vcard_midi_send_timed(ctx->out, sysex, sizeof(sysex), seq);
+        } else {
+            uint8_t cc[3] = { 0xB0, (uint8_t)(seq & 0x7F), (uint8_t)((seq >> 7) & 0x7F) };
+            result = vcard_midi_send_timed(ctx->out, cc, sizeof(cc), seq);
+        }
+
+        if (result == VCARD_ERROR_NO_MEMORY) {
+            // Queue or sysex pool full: wait for the receiver
+            vcard_sleep_us(20);
+            continue;
+        }
+        if (result != VCARD_SUCCESS) {
+            ctx->errors++;
+            return;
+        }
+        seq++;
+    }
+}
+
+static void receiver_thread(void *arg)
+{
+    stream_context_t *ctx = (stream_context_t *)arg;
+    uint8_t msg[VCARD_MAX_MIDI_MESSAGE];
+    uint8_t expected[TEST_SYSEX_LENGTH];
+    uint32_t seq = 0;
+
+    while (seq < TEST_STREAM_MESSAGES) {
+        size_t length = 0;
+        uint64_t frame = 0;
+
+        if (vcard_midi_receive_timed(ctx->in, UINT64_MAX, msg, sizeof(msg),
+                                     &length, &frame) != VCARD_SUCCESS) {
+            ctx->errors++;
+            return;
+        }
+        if (length == 0) {
+            vcard_sleep_us(20);
+            continue;
+        }
+
+        if (frame != seq) {
+            ctx->errors++;
+        } else if (seq % TEST_SYSEX_EVERY == 0) {
+            make_sysex(expected, sizeof(expected), seq);
+            if (length != sizeof(expected) || memcmp(msg, expected, length) != 0) {
+                ctx->errors++;
+            }
+        } else if (length != 3 || msg[0] != 0xB0 || msg[1] != (seq & 0x7F) ||
+                   msg[2] != ((seq >> 7) & 0x7F)) {
+            ctx->errors++;
+        }
+        seq++;
+    }
+}
+
+static void test_callback(vcard_midi_handle_t handle, const uint8_t *message,
+                          size_t length, void *user_data)
+{
+    callback_context_t *ctx = (callback_context_t *)user_data;
+
+    (void)handle;
+    if (length == 3) {
+        memcpy(ctx->last, message, 3);
+    }
+    ctx->calls++;
+}
+
+/* Callbacks that check they were paired with their own user data */
+static void swap_callback_a(vcard_midi_handle_t handle, const uint8_t *message,
+                            size_t length, void *user_data)
+{
+    swap_context_t *ctx = (swap_context_t *)user_data;
+
+    (void)handle;
+    (void)message;
+    (void)length;
+    ctx->errors += ctx->tag != 'A';
+    ctx->calls++;
+}
+
+static void swap_callback_b(vcard_midi_handle_t handle, const uint8_t *message,
+                            size_t length, void *user_data)
+{
+    swap_context_t *ctx = (swap_context_t *)user_data;
+
+    (void)handle;
+    (void)message;
+    (void)length;
+    ctx->errors += ctx->tag != 'B';
+    ctx->calls++;
+}
+
+static void swap_sender_thread(void *arg)
+{
+    swap_sender_t *ctx = (swap_sender_t *)arg;
+    const uint8_t cc[3] = { 0xB0, 1, 2 };
+
+    while (vcard_atomic_load_acquire_u32(&ctx->running)) {
+        // Queued (or dropped when full) while no callback is registered
+        vcard_midi_send(ctx->out, cc, sizeof(cc));
+        vcard_atomic_store_release_u32(&ctx->sends,
+                                       vcard_atomic_load_relaxed_u32(&ctx->sends) + 1);
+    }
+}
+
+/* Let the sender make a few sends under the current callback */
+static void wait_sends(swap_sender_t *ctx, uint32_t count)
+{
+    uint32_t target = vcard_atomic_load_acquire_u32(&ctx->sends) + count;
+
+    while ((int32_t)(vcard_atomic_load_acquire_u32(&ctx->sends) - target) < 0) {
+        vcard_sleep_us(10);
+    }
+}
+
+static void make_config(vcard_config_t *config, const char *name)
+{
+    memset(config, 0, sizeof(*config));
+    strncpy(config->name, name, VCARD_MAX_DEVICE_NAME - 1);
+    config->channels_in = 2;
+    config->channels_out = 2;
+    config->sample_rate = 48000;
+    config->buffer_size = 256;
+    config->bit_depth = VCARD_BIT_24;
+    config->midi_ports_in = 2;
+    config->midi_ports_out = 2;
+}
+
+int main(void)
+{
+    vcard_config_t config;
+    vcard_midi_handle_t out = NULL;
+    vcard_midi_handle_t in = NULL;
+    vcard_midi_handle_t other = NULL;
+    uint8_t msg[VCARD_MAX_MIDI_MESSAGE];
+    size_t length = 0;
+    uint64_t frame = 0;
+    int device_id = -1;
+    int result;
+    int passed = 1;
+
+    printf("Testing MIDI loopback transport...\n");
+
+    vcard_init();
+
+    make_config(&config, "MIDI Test");
+    result = vcard_create_device(&config, &device_id);
+    if (result != VCARD_SUCCESS) {
+        printf("  FAIL: Device creation failed with error %d\n", result);
+        return 1;
+    }
+
+    // Port management
+    if (vcard_midi_open(device_id, 0, VCARD_MIDI_OUTPUT, &out) != VCARD_SUCCESS ||
+        vcard_midi_open(device_id, 0, VCARD_MIDI_INPUT, &in) != VCARD_SUCCESS) {
+        printf("  FAIL: Could not open MIDI ports\n");
+        return 1;
+    }
+    printf("  PASS: MIDI ports opened\n");
+
+    if (vcard_midi_open(device_id, 0, VCARD_MIDI_OUTPUT, &other) != VCARD_ERROR_IN_USE ||
+        vcard_midi_open(device_id, 2, VCARD_MIDI_INPUT, &other) != VCARD_ERROR_NOT_FOUND) {
+        printf("  FAIL: Duplicate or out-of-range port should be rejected\n");
+        passed = 0;
+    } else {
+        printf("  PASS: Duplicate and out-of-range ports rejected\n");
+    }
+
+    // Short messages with timestamps, delivered only once due
+    {
+        const uint8_t note_on[3] = { 0x90, 60, 100 };
+        const uint8_t note_off[3] = { 0x80, 60, 0 };
+        int ok = 1;
+
+        ok &= vcard_midi_send_timed(out, note_on, 3, 100) == VCARD_SUCCESS;
+        ok &= vcard_midi_send_timed(out, note_off, 3, 300) == VCARD_SUCCESS;
+
+        // Period [0, 256) only sees the note-on
+        ok &= vcard_midi_receive_timed(in, 256, msg, sizeof(msg), &length, &frame) == VCARD_SUCCESS;
+        ok &= length == 3 && frame == 100 && memcmp(msg, note_on, 3) == 0;
+        ok &= vcard_midi_receive_timed(in, 256, msg, sizeof(msg), &length, &frame) == VCARD_SUCCESS;
+        ok &= length == 0;
+        ok &= vcard_midi_receive_timed(in, 512, msg, sizeof(msg), &length, &frame) == VCARD_SUCCESS;
+        ok &= length == 3 && frame == 300 && memcmp(msg, note_off, 3) == 0;
+
+        if (!ok) {
+            printf("  FAIL: Timestamped short messages\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Timestamped messages released per period\n");
+        }
+    }
+
+    // Sysex through the preallocated pool, and a too-small receive buffer
+    {
+        uint8_t sysex[VCARD_MAX_MIDI_MESSAGE];
+        int ok = 1;
+
+        make_sysex(sysex, sizeof(sysex), 7);
+        ok &= vcard_midi_send(out, sysex, sizeof(sysex)) == VCARD_SUCCESS;
+        ok &= vcard_midi_receive(in, msg, 16, &length) == VCARD_ERROR_INVALID;
+        ok &= length == sizeof(sysex);
+        ok &= vcard_midi_receive(in, msg, sizeof(msg), &length) == VCARD_SUCCESS;
+        ok &= length == sizeof(sysex) && memcmp(msg, sysex, length) == 0;
+        ok &= vcard_midi_send(out, sysex, sizeof(sysex) + 1) == VCARD_ERROR_INVALID;
+
+        if (!ok) {
+            printf("  FAIL: Sysex round trip\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Sysex round trip through pool\n");
+        }
+    }
+
+    // Sysex pool exhaustion is reported and recovers once drained
+    {
+        uint8_t sysex[64];
+        int sent = 0;
+        int drained = 0;
+
+        make_sysex(sysex, sizeof(sysex), 0);
+        while (vcard_midi_send(out, sysex, sizeof(sysex)) == VCARD_SUCCESS && sent < 1000) {
+            sent++;
+        }
+        while (vcard_midi_receive(in, msg, sizeof(msg), &length) == VCARD_SUCCESS &&
+               length > 0) {
+            drained++;
+        }
+        if (sent == 0 || sent >= 1000 || drained != sent ||
+            vcard_midi_send(out, sysex, sizeof(sysex)) != VCARD_SUCCESS ||
+            vcard_midi_receive(in, msg, sizeof(msg), &length) != VCARD_SUCCESS ||
+            length != sizeof(sysex)) {
+            printf("  FAIL: Sysex pool exhaustion (sent %d, drained %d)\n", sent, drained);
+            passed = 0;
+        } else {
+            printf("  PASS: Sysex pool bounded at %d messages and recovered\n", sent);
+        }
+    }
+
+    // Callback delivery on the sending thread
+    {
+        callback_context_t cb = { 0, { 0, 0, 0 } };
+        const uint8_t cc[3] = { 0xB0, 7, 64 };
+
+        vcard_midi_set_callback(in, test_callback, &cb);
+        vcard_midi_send(out, cc, 3);
+        vcard_midi_set_callback(in, NULL, NULL);
+        vcard_midi_receive(in, msg, sizeof(msg), &length);
+
+        if (cb.calls != 1 || memcmp(cb.last, cc, 3) != 0 || length != 0 ||
+            vcard_midi_set_callback(out, test_callback, &cb) != VCARD_ERROR_INVALID) {
+            printf("  FAIL: Callback delivery\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Callback invoked synchronously\n");
+        }
+    }
+
+    // Callbacks replaced while a sender streams keep their own user data
+    {
+        swap_context_t a = { 'A', 0, 0 }, b = { 'B', 0, 0 };
+        swap_sender_t sender_ctx;
+        vcard_thread_t sender;
+
+        sender_ctx.out = out;
+        vcard_atomic_store_relaxed_u32(&sender_ctx.running, 1);
+        vcard_atomic_store_relaxed_u32(&sender_ctx.sends, 0);
+        vcard_thread_create(&sender, swap_sender_thread, &sender_ctx);
+        for (int i = 0; i < 1000; i++) {
+            vcard_midi_set_callback(in, swap_callback_a, &a);
+            wait_sends(&sender_ctx, 4);
+            vcard_midi_set_callback(in, swap_callback_b, &b);
+            wait_sends(&sender_ctx, 4);
+            vcard_midi_set_callback(in, NULL, NULL);
+        }
+        vcard_atomic_store_release_u32(&sender_ctx.running, 0);
+        vcard_thread_join(&sender);
+        while (vcard_midi_receive(in, msg, sizeof(msg), &length) == VCARD_SUCCESS &&
+               length > 0) {
+        }
+
+        if (a.errors || b.errors || a.calls == 0 || b.calls == 0) {
+            printf("  FAIL: Callback swap (%d/%d mismatched of %d/%d calls)\n",
+                   a.errors, b.errors, a.calls, b.calls);
+            passed = 0;
+        } else {
+            printf("  PASS: 3000 callback changes while sending, %d calls all paired\n",
+                   a.calls + b.calls);
+        }
+    }
+
+    // Producer/consumer stress with interleaved sysex
+    {
+        stream_context_t ctx = { out, in, 0 };
+        vcard_thread_t sender, receiver;
+
+        if (vcard_thread_create(&receiver, receiver_thread, &ctx) != VCARD_SUCCESS ||
+            vcard_thread_create(&sender, sender_thread, &ctx) != VCARD_SUCCESS) {
+            printf("  FAIL: Could not start threads\n");
+            return 1;
+        }
+        vcard_thread_join(&sender);
+        vcard_thread_join(&receiver);
+
+        if (ctx.errors != 0) {
+            printf("  FAIL: %d errors streaming %d messages\n", ctx.errors,
+                   TEST_STREAM_MESSAGES);
+            passed = 0;
+        } else {
+            printf("  PASS: %d messages streamed in order between threads\n",
+                   TEST_STREAM_MESSAGES);
+        }
+    }
+
+    // Closing invalidates the handle
+    if (vcard_midi_close(out) != VCARD_SUCCESS ||
+        vcard_midi_send(out, msg, 3) != VCARD_ERROR_NOT_FOUND ||
+        vcard_midi_close(in) != VCARD_SUCCESS) {
+        printf("  FAIL: Port close\n");
+        passed = 0;
+    } else {
+        printf("  PASS: Ports closed\n");
+    }
+
+    vcard_destroy_device(device_id);
+    vcard_cleanup();
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
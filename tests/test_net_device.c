@@ -0,0 +1,428 @@
+/**
+ * Test for the Network Streaming Device
+ *
+ * Feeds the jitter buffer hand-built RTP packets to check reordering,
+ * loss concealment, late, duplicate and malformed packets, the adaptive
+ * target and rebuffering, then streams a 1 kHz tone from one device to
+ * another through a sender and receiver on the loopback interface and
+ * checks that it arrives unbroken with its latency reported.
+ */
+
+#include "net_device.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TEST_RATE 48000
+#define TEST_FRAMES 48                       /* 1 ms packets */
+#define TEST_BUFFER_SIZE 256
+#define TEST_FREQUENCY 1000.0
+#define TEST_SECONDS 2
+#define TEST_CHUNK 64
+#define TEST_SSRC 0x12345678u
+
+typedef struct {
+    int device_id;
+    vcard_atomic_u32 running;
+} producer_t;
+
+static net_jitter_t jitter;
+static float received[TEST_RATE * (TEST_SECONDS + 1)];
+
+/* Value carried by every sample of a packet, distinct per sequence and channel */
+static float packet_value(uint32_t seq, uint32_t ch)
+{
+    return (float)((int)(seq % 50) - 25) / 32.0f + (ch ? 0.125f : 0.0f);
+}
+
+/* seq counts on past 65535, as the sender's timestamp does */
+static size_t make_packet(uint32_t seq, uint32_t ssrc, net_encoding_t encoding,
+                          uint8_t *packet)
+{
+    static float left[TEST_FRAMES], right[TEST_FRAMES];
+    const float *in[2] = { left, right };
+    net_rtp_header_t header;
+
+    for (int i = 0; i < TEST_FRAMES; i++) {
+        left[i] = packet_value(seq, 0);
+        right[i] = packet_value(seq, 1);
+    }
+    header.payload_type = NET_DEFAULT_PAYLOAD_TYPE;
+    header.sequence = (uint16_t)seq;
+    header.timestamp = 1000u + seq * TEST_FRAMES;
+    header.ssrc = ssrc;
+    return net_rtp_write(&header, encoding, in, 2, TEST_FRAMES, packet);
+}
+
+static net_packet_result_t push(uint32_t seq, uint64_t arrival_ns)
+{
+    uint8_t packet[NET_MAX_PACKET];
+    size_t bytes = make_packet(seq, TEST_SSRC, jitter.encoding, packet);
+
+    return net_jitter_push(&jitter, packet, bytes, arrival_ns);
+}
+
+/* Pulls one packet's frames and checks they carry seq's values (or silence) */
+static int pull_packet(int64_t seq, float tolerance)
+{
+    float left[TEST_FRAMES], right[TEST_FRAMES];
+    float *out[2] = { left, right };
+    float expect_l = seq < 0 ? 0.0f : packet_value((uint32_t)seq, 0);
+    float expect_r = seq < 0 ? 0.0f : packet_value((uint32_t)seq, 1);
+
+    if (net_jitter_pull(&jitter, out, TEST_FRAMES) != TEST_FRAMES) {
+        return 0;
+    }
+    for (int i = 0; i < TEST_FRAMES; i++) {
+        if (fabsf(left[i] - expect_l) > tolerance || fabsf(right[i] - expect_r) > tolerance) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int make_device(const char *name, int *device_id)
+{
+    vcard_config_t config;
+
+    memset(&config, 0, sizeof(config));
+    strncpy(config.name, name, VCARD_MAX_DEVICE_NAME - 1);
+    config.channels_in = 2;
+    config.channels_out = 2;
+    config.sample_rate = TEST_RATE;
+    config.buffer_size = TEST_BUFFER_SIZE;
+    config.bit_depth = VCARD_BIT_32;
+    return vcard_create_device(&config, device_id);
+}
+
+/* Writes the tone at TEST_RATE as measured by the monotonic clock */
+static void producer_main(void *arg)
+{
+    producer_t *p = (producer_t *)arg;
+    float left[TEST_CHUNK], right[TEST_CHUNK];
+    const float *buffers[2] = { left, right };
+    uint64_t start = vcard_time_ns();
+    uint64_t frame = 0;
+
+    while (vcard_atomic_load_acquire_u32(&p->running)) {
+        uint64_t due = (vcard_time_ns() - start) * TEST_RATE / 1000000000u;
+
+        while (frame < due) {
+            size_t n = due - frame < TEST_CHUNK ? (size_t)(due - frame) : TEST_CHUNK;
+            size_t written = 0;
+
+            for (size_t i = 0; i < n; i++) {
+                left[i] = (float)(0.5 * sin(2.0 * M_PI * TEST_FREQUENCY *
+                                            (double)(frame + i) / TEST_RATE));
+                right[i] = -left[i];
+            }
+            vcard_write_audio(p->device_id, buffers, n, &written);
+            if (written < n) {
+                break;
+            }
+            frame += n;
+        }
+        frame = due;
+        vcard_sleep_us(1000);
+    }
+}
+
+int main(void)
+{
+    net_config_t config;
+    int passed = 1;
+
+    printf("Testing network streaming device...\n");
+
+    memset(&config, 0, sizeof(config));
+    config.encoding = NET_ENCODING_L24;
+    config.packet_frames = TEST_FRAMES;
+
+    // Reordered packets play in sequence order at L24 precision
+    {
+        int ok = net_jitter_init(&jitter, 2, TEST_RATE, &config) == VCARD_SUCCESS &&
+                 jitter.min_target == 2 * TEST_FRAMES;
+
+        ok = ok && push(1, 1000000) == NET_PACKET_OK && !jitter.playing &&
+             push(0, 0) == NET_PACKET_OK && jitter.playing &&
+             push(3, 3000000) == NET_PACKET_OK &&
+             push(2, 2000000) == NET_PACKET_OK &&
+             net_jitter_depth(&jitter) == 4 * TEST_FRAMES;
+        for (int32_t seq = 0; seq < 4 && ok; seq++) {
+            ok = pull_packet(seq, 1.0f / 4000000.0f);
+        }
+        if (!ok) {
+            printf("  FAIL: Reordered packets\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Reordered packets played in order\n");
+        }
+    }
+
+    // Late, duplicate and lost packets
+    {
+        int ok = push(1, 4000000) == NET_PACKET_LATE &&
+                 push(5, 5000000) == NET_PACKET_OK &&
+                 push(5, 5000000) == NET_PACKET_DUPLICATE &&
+                 push(6, 6000000) == NET_PACKET_OK &&
+                 pull_packet(-1, 0.0f) && pull_packet(5, 1.0f / 4000000.0f) &&
+                 pull_packet(6, 1.0f / 4000000.0f);
+
+        ok = ok && jitter.stats.late == 1 && jitter.stats.duplicates == 1 &&
+             jitter.stats.lost == 1 && jitter.stats.received == 6;
+        if (!ok) {
+            printf("  FAIL: Late, duplicate and lost packets (late %llu, dup %llu, lost %llu)\n",
+                   (unsigned long long)jitter.stats.late,
+                   (unsigned long long)jitter.stats.duplicates,
+                   (unsigned long long)jitter.stats.lost);
+            passed = 0;
+        } else {
+            printf("  PASS: Late and duplicate packets dropped, a lost one concealed\n");
+        }
+    }
+
+    // Running dry rebuffers to the target before playing again
+    {
+        float left[TEST_FRAMES], right[TEST_FRAMES];
+        float *out[2] = { left, right };
+        int ok = net_jitter_pull(&jitter, out, TEST_FRAMES) == 0 && !jitter.playing &&
+                 jitter.stats.underruns == 1 &&
+                 push(7, 7000000) == NET_PACKET_OK &&
+                 net_jitter_pull(&jitter, out, TEST_FRAMES) == 0 &&
+                 push(8, 8000000) == NET_PACKET_OK && jitter.playing &&
+                 pull_packet(7, 1.0f / 4000000.0f);
+
+        if (!ok) {
+            printf("  FAIL: Underrun and rebuffering\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Underrun counted, playout resumes at the target depth\n");
+        }
+    }
+
+    // Malformed packets and a new stream
+    {
+        uint8_t packet[NET_MAX_PACKET];
+        size_t bytes = make_packet(9, TEST_SSRC, NET_ENCODING_L24, packet);
+        int ok;
+
+        packet[1] = 97;
+        ok = net_jitter_push(&jitter, packet, bytes, 0) == NET_PACKET_MALFORMED;
+        packet[1] = NET_DEFAULT_PAYLOAD_TYPE;
+        ok = ok && net_jitter_push(&jitter, packet, bytes - 3, 0) == NET_PACKET_MALFORMED &&
+             net_jitter_push(&jitter, packet, 8, 0) == NET_PACKET_MALFORMED;
+        packet[0] = 0x40;
+        ok = ok && net_jitter_push(&jitter, packet, bytes, 0) == NET_PACKET_MALFORMED;
+        bytes = make_packet(9, TEST_SSRC, NET_ENCODING_L16, packet);
+        ok = ok && net_jitter_push(&jitter, packet, bytes, 0) == NET_PACKET_MALFORMED &&
+             jitter.stats.malformed == 5;
+
+        bytes = make_packet(40000, TEST_SSRC + 1, NET_ENCODING_L24, packet);
+        ok = ok && net_jitter_push(&jitter, packet, bytes, 10000000) == NET_PACKET_RESYNC &&
+             jitter.stats.resyncs == 1 && !jitter.playing &&
+             net_jitter_depth(&jitter) == TEST_FRAMES;
+        if (!ok) {
+            printf("  FAIL: Malformed packets or SSRC change\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Malformed packets rejected, a new SSRC restarts the buffer\n");
+        }
+        net_jitter_free(&jitter);
+    }
+
+    // L16 packets, sequence wrap and a target that follows the jitter
+    {
+        float left[TEST_FRAMES], right[TEST_FRAMES];
+        float *out[2] = { left, right };
+        uint32_t next = 65520;
+        uint32_t steady;
+        int ok;
+
+        config.encoding = NET_ENCODING_L16;
+        ok = net_jitter_init(&jitter, 2, TEST_RATE, &config) == VCARD_SUCCESS;
+        for (uint32_t i = 0; i < 40 && ok; i++) {
+            ok = push(65520 + i, (uint64_t)i * 1000000) == NET_PACKET_OK;
+            if (jitter.playing) {
+                ok = ok && pull_packet(next++, 1.0f / 16000.0f);
+            }
+        }
+        ok = ok && next == 65520 + 39;
+        steady = jitter.target;
+
+        // Arrivals now alternate 3 ms early and late
+        for (uint32_t i = 40; i < 200 && ok; i++) {
+            uint64_t arrival = (uint64_t)i * 1000000 + (i & 1 ? 3000000 : 0);
+
+            ok = push(65520 + i, arrival) == NET_PACKET_OK;
+            while (net_jitter_depth(&jitter) > jitter.target + TEST_FRAMES) {
+                net_jitter_pull(&jitter, out, TEST_FRAMES);
+            }
+        }
+        ok = ok && steady == jitter.min_target && jitter.target > 4 * TEST_FRAMES &&
+             jitter.target <= jitter.max_target &&
+             jitter.max_target == TEST_RATE / 1000 * 20 && jitter.stats.lost == 0;
+        if (!ok) {
+            printf("  FAIL: Adaptive target (steady %u, jittery %u frames)\n", steady,
+                   jitter.target);
+            passed = 0;
+        } else {
+            printf("  PASS: Target %u frames without jitter, %u with 3 ms of it\n", steady,
+                   jitter.target);
+        }
+        net_jitter_free(&jitter);
+    }
+
+    // A tone streamed between two devices over the loopback interface
+    {
+        producer_t producer;
+        net_sender_t sender;
+        net_receiver_t receiver;
+        net_sender_stats_t sent;
+        net_receiver_stats_t stats;
+        vcard_status_t status;
+        vcard_thread_t thread;
+        int source_id, dest_id;
+        size_t total = 0;
+        uint64_t start;
+
+        vcard_init();
+        memset(&config, 0, sizeof(config));
+        config.encoding = NET_ENCODING_L24;
+        config.address = "127.0.0.1";
+        if (make_device("Net Source", &source_id) != VCARD_SUCCESS ||
+            make_device("Net Dest", &dest_id) != VCARD_SUCCESS ||
+            net_receiver_start(&receiver, dest_id, &config) != VCARD_SUCCESS) {
+            printf("  FAIL: Could not set up the receiver\n");
+            vcard_cleanup();
+            return 1;
+        }
+        config.port = receiver.port;
+        if (net_sender_start(&sender, source_id, &config) != VCARD_SUCCESS) {
+            printf("  FAIL: Could not set up the sender\n");
+            net_receiver_stop(&receiver);
+            vcard_cleanup();
+            return 1;
+        }
+        producer.device_id = source_id;
+        vcard_atomic_store_relaxed_u32(&producer.running, 1);
+        vcard_thread_create(&thread, producer_main, &producer);
+
+        start = vcard_time_ns();
+        while (vcard_time_ns() - start < (uint64_t)TEST_SECONDS * 1000000000u) {
+            double due = (double)(vcard_time_ns() - start) * 1e-9 * TEST_RATE;
+            static float discard[TEST_BUFFER_SIZE];
+
+            while ((double)total + TEST_BUFFER_SIZE <= due) {
+                float *buffers[2] = { received + total, discard };
+                size_t got = 0;
+
+                if (total + TEST_BUFFER_SIZE > sizeof(received) / sizeof(received[0])) {
+                    break;
+                }
+                vcard_read_audio(dest_id, buffers, TEST_BUFFER_SIZE, &got);
+                if (got == 0) {
+                    break;
+                }
+                total += got;
+            }
+            vcard_sleep_us(1000);
+        }
+
+        vcard_get_status(dest_id, &status);
+        vcard_atomic_store_release_u32(&producer.running, 0);
+        vcard_thread_join(&thread);
+        net_sender_get_stats(&sender, &sent);
+        net_receiver_get_stats(&receiver, &stats);
+        net_sender_stop(&sender);
+        net_receiver_stop(&receiver);
+
+        if (total < (size_t)TEST_SECONDS * TEST_RATE * 8 / 10 || sent.packets == 0 ||
+            sent.batches > sent.packets || stats.jitter.received == 0 ||
+            stats.jitter.lost != 0 || stats.jitter.malformed != 0) {
+            printf("  FAIL: Read %zu frames (%llu packets sent, %llu received, %llu lost)\n",
+                   total, (unsigned long long)sent.packets,
+                   (unsigned long long)stats.jitter.received,
+                   (unsigned long long)stats.jitter.lost);
+            passed = 0;
+        } else {
+            printf("  PASS: Read %zu frames from %llu packets in %llu sends\n", total,
+                   (unsigned long long)stats.jitter.received,
+                   (unsigned long long)sent.batches);
+        }
+
+        if (stats.latency_us == 0 || stats.latency_us > 25000 ||
+            status.latency_us < stats.latency_us / 2) {
+            printf("  FAIL: Latency %u us (device status %u us)\n", stats.latency_us,
+                   status.latency_us);
+            passed = 0;
+        } else {
+            printf("  PASS: Latency %u us reported, device status %u us (jitter %.0f us)\n",
+                   stats.latency_us, status.latency_us, stats.jitter.jitter_us);
+        }
+
+        // The last second: the tone at its frequency and level, unbroken
+        if (total > TEST_RATE) {
+            const float *tail = received + total - TEST_RATE;
+            double peak = 0.0;
+            int crossings = 0;
+
+            for (size_t i = 1; i < TEST_RATE; i++) {
+                if ((tail[i - 1] < 0.0f) != (tail[i] < 0.0f)) {
+                    crossings++;
+                }
+                if (fabs(tail[i]) > peak) {
+                    peak = fabs(tail[i]);
+                }
+            }
+            if (abs(crossings - 2000) > 20 || fabs(peak - 0.5) > 0.02) {
+                printf("  FAIL: Tone after the network (%d zero crossings, peak %.3f)\n",
+                       crossings, peak);
+                passed = 0;
+            } else {
+                printf("  PASS: Tone after the network (%d zero crossings, peak %.3f)\n",
+                       crossings, peak);
+            }
+        } else {
+            passed = 0;
+        }
+
+        // Bad parameters
+        {
+            int ok;
+
+            config.address = "not-an-address";
+            ok = net_sender_start(&sender, source_id, &config) == VCARD_ERROR_INVALID;
+            config.address = "127.0.0.1";
+            config.packet_frames = 480;
+            ok = ok && net_sender_start(&sender, source_id, &config) == VCARD_ERROR_INVALID &&
+                 net_receiver_start(&receiver, dest_id, &config) == VCARD_ERROR_INVALID;
+            config.packet_frames = 0;
+            ok = ok && net_receiver_start(&receiver, 9999, &config) == VCARD_ERROR_NOT_FOUND;
+            if (!ok) {
+                printf("  FAIL: Bad parameters not rejected\n");
+                passed = 0;
+            } else {
+                printf("  PASS: Bad parameters rejected\n");
+            }
+        }
+
+        vcard_destroy_device(source_id);
+        vcard_destroy_device(dest_id);
+        vcard_cleanup();
+    }
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
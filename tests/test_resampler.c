@@ -0,0 +1,229 @@
+/**
+ * Test for the Adaptive Resampler
+ *
+ * Checks fixed-ratio conversion against the analytic signal, the frame
+ * count over a long stream fed in uneven chunks, and that fill steering
+ * locks onto a drifting consumer clock and holds the buffer at its target.
+ */
+
+#include "resampler.h"
+#include "vcard.h"
+#include <stdio.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TEST_CHANNELS 4
+#define TEST_FRAMES 48000
+#define TEST_FREQUENCY 1000.0
+#define TEST_PERIOD 256
+#define TEST_TARGET 512.0
+#define TEST_SIM_SECONDS 120
+
+static float input[TEST_CHANNELS][TEST_FRAMES];
+static float output[TEST_CHANNELS][TEST_FRAMES * 2];
+
+static double test_signal(double t, uint32_t channel)
+{
+    return 0.5 * sin(2.0 * M_PI * TEST_FREQUENCY * t + channel * 0.7);
+}
+
+/* Resample the test sine between two rates; returns the worst error */
+static double convert(uint32_t in_rate, uint32_t out_rate, size_t *produced)
+{
+    resampler_t r;
+    const float *in[TEST_CHANNELS];
+    float *out[TEST_CHANNELS];
+    size_t in_pos = 0, out_pos = 0;
+    double worst = 0.0;
+    int chunk = 0;
+
+    for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+        for (size_t i = 0; i < TEST_FRAMES; i++) {
+            input[ch][i] = (float)test_signal((double)i / in_rate, ch);
+        }
+    }
+    if (resampler_init(&r, TEST_CHANNELS, in_rate, out_rate) != VCARD_SUCCESS) {
+        return 1.0;
+    }
+
+    // Uneven input chunks and output capacities exercise the staging
+    while (in_pos < TEST_FRAMES) {
+        size_t in_frames = (size_t)(chunk % 3 == 0 ? 37 : 700);
+        size_t out_frames = (size_t)(chunk % 2 == 0 ? 129 : 1000);
+        size_t used;
+
+        if (in_frames > TEST_FRAMES - in_pos) {
+            in_frames = TEST_FRAMES - in_pos;
+        }
+        for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+            in[ch] = input[ch] + in_pos;
+            out[ch] = output[ch] + out_pos;
+        }
+        out_pos += resampler_process(&r, in, in_frames, &used, out, out_frames);
+        in_pos += used;
+        chunk++;
+    }
+    // Render what is still staged
+    for (;;) {
+        size_t n;
+        for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+            out[ch] = output[ch] + out_pos;
+        }
+        n = resampler_process(&r, in, 0, NULL, out, 1000);
+        if (n == 0) {
+            break;
+        }
+        out_pos += n;
+    }
+    resampler_free(&r);
+
+    // Output frame k is the input at k * in_rate / out_rate; skip the start-up taps
+    for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+        for (size_t k = RESAMPLER_TAPS; k < out_pos; k++) {
+            double err = fabs(output[ch][k] - test_signal((double)k / out_rate, ch));
+            if (err > worst) {
+                worst = err;
+            }
+        }
+    }
+    *produced = out_pos;
+    return worst;
+}
+
+/**
+ * Simulate a producer on the nominal clock feeding a consumer whose clock
+ * is off by drift, with the resampler steered from the buffer between them
+ */
+static int steer(double drift, double *final_adjust, double *fill_error)
+{
+    static float block[TEST_PERIOD];
+    static float resampled[TEST_PERIOD * 2];
+    const float *in[1] = { block };
+    float *out[1] = { resampled };
+    const int periods = TEST_SIM_SECONDS * 48000 / TEST_PERIOD;
+    const double seconds = (double)TEST_PERIOD / 48000;
+    resampler_t r;
+    double fill = TEST_TARGET;
+    double consumed = 0.0;
+    double fill_sum = 0.0;
+    int late = 0;
+    int ok = 1;
+
+    if (resampler_init(&r, 1, 48000, 48000) != VCARD_SUCCESS) {
+        return 0;
+    }
+    for (size_t i = 0; i < TEST_PERIOD; i++) {
+        block[i] = (float)sin(0.01 * (double)i);
+    }
+
+    for (int period = 0; period < periods; period++) {
+        size_t used = 0;
+        double take;
+
+        // The producer's period goes through the resampler into the buffer
+        while (used < TEST_PERIOD) {
+            size_t n;
+            fill += (double)resampler_process(&r, in, TEST_PERIOD - used, &n, out,
+                                              TEST_PERIOD * 2);
+            used += n;
+            in[0] = block + used;
+        }
+        in[0] = block;
+
+        // The consumer drains whole frames at its own rate
+        consumed += TEST_PERIOD * (1.0 + drift);
+        take = floor(consumed);
+        consumed -= take;
+        fill -= take;
+        if (fill < 0.0) {
+            ok = 0;
+        }
+        resampler_steer(&r, fill, TEST_TARGET, seconds);
+
+        // Average the fill over the last quarter of the run
+        if (period >= periods * 3 / 4) {
+            fill_sum += fill;
+            late++;
+        }
+    }
+
+    *final_adjust = r.adjust;
+    *fill_error = fill_sum / late - TEST_TARGET;
+    resampler_free(&r);
+    return ok;
+}
+
+int main(void)
+{
+    static const uint32_t rates[][2] = {
+        { 48000, 44100 }, { 44100, 48000 }, { 48000, 96000 }, { 96000, 48000 }
+    };
+    int passed = 1;
+
+    printf("Testing adaptive resampler...\n");
+
+    // Fixed-ratio conversion against the analytic signal
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        size_t produced = 0;
+        double expected = (double)TEST_FRAMES * rates[i][1] / rates[i][0];
+        double worst = convert(rates[i][0], rates[i][1], &produced);
+
+        if (worst > 2e-3 || fabs((double)produced - expected) > RESAMPLER_TAPS) {
+            printf("  FAIL: %u -> %u Hz (error %.2e, %zu frames for %.0f)\n",
+                   rates[i][0], rates[i][1], worst, produced, expected);
+            passed = 0;
+        } else {
+            printf("  PASS: %u -> %u Hz (error %.2e, %zu frames)\n",
+                   rates[i][0], rates[i][1], worst, produced);
+        }
+    }
+
+    // Steering against a fast and a slow consumer clock
+    {
+        static const double drifts[] = { 300e-6, -1000e-6 };
+
+        for (size_t i = 0; i < sizeof(drifts) / sizeof(drifts[0]); i++) {
+            double adjust = 0.0, fill_error = 0.0;
+            int ok = steer(drifts[i], &adjust, &fill_error);
+
+            // A consumer running fast needs more output: less input per frame
+            ok = ok && fabs(adjust + drifts[i]) < 20e-6 && fabs(fill_error) < TEST_PERIOD / 4;
+            if (!ok) {
+                printf("  FAIL: %+.0f ppm drift (correction %+.1f ppm, fill error %.1f)\n",
+                       drifts[i] * 1e6, adjust * 1e6, fill_error);
+                passed = 0;
+            } else {
+                printf("  PASS: %+.0f ppm drift locked (correction %+.1f ppm, fill error %.1f)\n",
+                       drifts[i] * 1e6, adjust * 1e6, fill_error);
+            }
+        }
+    }
+
+    // Bad parameters
+    {
+        resampler_t r;
+        int ok = resampler_init(&r, 0, 48000, 48000) == VCARD_ERROR_INVALID &&
+                 resampler_init(&r, VCARD_MAX_CHANNELS + 1, 48000, 48000) == VCARD_ERROR_INVALID &&
+                 resampler_init(&r, 2, 192000, 8000) == VCARD_ERROR_INVALID &&
+                 resampler_init(&r, 2, 48000, 0) == VCARD_ERROR_INVALID;
+
+        if (!ok) {
+            printf("  FAIL: Bad parameters not rejected\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Bad parameters rejected\n");
+        }
+    }
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,235 @@
+/**
+ * Test for the Routing Matrix Mixer
+ *
+ * Checks the multiply-accumulate kernels against scalar references, route
+ * compilation, gain ramps, and that a reader never observes a partially
+ * published matrix while another thread keeps republishing.
+ */
+
+#include "routing_mixer.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TEST_FRAMES 64
+#define TEST_PUBLISHES 20000
+
+typedef struct {
+    routing_mixer_t *mixer;
+    vcard_atomic_u32 done;
+} publish_context_t;
+
+static void set_route(vcard_routing_t *routing, int index, uint32_t src,
+                      uint32_t dest, float gain)
+{
+    routing->routes[index].source_channel = src;
+    routing->routes[index].dest_channel = dest;
+    routing->routes[index].gain = gain;
+}
+
+static int test_kernels(void)
+{
+    float src[67] = {0}, dst[67] = {0}, ref[67] = {0};
+    int ok = 1;
+
+    for (uint32_t n = 0; n <= 67; n++) {
+        for (uint32_t i = 0; i < n; i++) {
+            src[i] = sinf((float)i * 0.37f);
+            dst[i] = ref[i] = cosf((float)i * 0.11f);
+        }
+        routing_mix_gain(dst, src, 0.7f, n);
+        for (uint32_t i = 0; i < n; i++) {
+            ref[i] += 0.7f * src[i];
+            if (fabsf(dst[i] - ref[i]) > 1e-6f) {
+                ok = 0;
+            }
+        }
+
+        routing_mix_ramp(dst, src, 0.25f, 0.01f, n);
+        for (uint32_t i = 0; i < n; i++) {
+            ref[i] += (0.25f + (float)i * 0.01f) * src[i];
+            if (fabsf(dst[i] - ref[i]) > 1e-5f) {
+                ok = 0;
+            }
+        }
+    }
+    return ok;
+}
+
+/* Run enough frames to finish any ramp, returning the last frame per channel */
+static void settle(routing_mixer_t *mixer, const float *const *src,
+                   float *const *dst)
+{
+    for (int i = 0; i < ROUTING_MIXER_RAMP_FRAMES / TEST_FRAMES + 1; i++) {
+        routing_mixer_begin(mixer);
+        routing_mixer_process(mixer, src, dst, TEST_FRAMES);
+    }
+}
+
+static void publisher_thread(void *arg)
+{
+    publish_context_t *ctx = (publish_context_t *)arg;
+    vcard_routing_t routing;
+
+    memset(&routing, 0, sizeof(routing));
+    routing.num_routes = 2;
+    for (int k = 1; k <= TEST_PUBLISHES; k++) {
+        // Both destinations always get the same gain within one matrix
+        float gain = (float)(k % 7) * 0.25f;
+        set_route(&routing, 0, 0, 0, gain);
+        set_route(&routing, 1, 1, 1, gain);
+        routing_mixer_publish(ctx->mixer, &routing);
+    }
+    vcard_atomic_store_release_u32(&ctx->done, 1);
+}
+
+int main(void)
+{
+    static routing_mixer_t mixer;
+    float src_data[4][TEST_FRAMES];
+    float dst_data[4][TEST_FRAMES];
+    const float *src[4];
+    float *dst[4];
+    vcard_routing_t routing;
+    int passed = 1;
+
+    printf("Testing routing matrix mixer...\n");
+
+    for (int ch = 0; ch < 4; ch++) {
+        for (int i = 0; i < TEST_FRAMES; i++) {
+            src_data[ch][i] = (float)(ch + 1);
+        }
+        src[ch] = src_data[ch];
+        dst[ch] = dst_data[ch];
+    }
+
+    if (!test_kernels()) {
+        printf("  FAIL: Mix kernels disagree with scalar reference\n");
+        passed = 0;
+    } else {
+        printf("  PASS: Mix kernels match scalar reference\n");
+    }
+
+    // Identity by default
+    routing_mixer_init(&mixer, 4, 4);
+    if (!routing_mixer_begin(&mixer)) {
+        printf("  FAIL: New mixer should be identity\n");
+        passed = 0;
+    } else {
+        routing_mixer_process(&mixer, src, dst, TEST_FRAMES);
+        if (dst_data[2][5] != 3.0f) {
+            printf("  FAIL: Identity mapping\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Identity mapping by default\n");
+        }
+    }
+
+    // Duplicate routes are summed; unrouted inputs are silent
+    memset(&routing, 0, sizeof(routing));
+    routing.num_routes = 4;
+    set_route(&routing, 0, 3, 0, 0.25f);
+    set_route(&routing, 1, 3, 0, 0.25f);
+    set_route(&routing, 2, 0, 1, 1.0f);
+    set_route(&routing, 3, 1, 1, 0.5f);
+    routing_mixer_publish(&mixer, &routing);
+    settle(&mixer, src, dst);
+    if (routing_mixer_begin(&mixer) ||
+        fabsf(dst_data[0][TEST_FRAMES - 1] - 2.0f) > 1e-6f ||
+        fabsf(dst_data[1][TEST_FRAMES - 1] - 2.0f) > 1e-6f ||
+        dst_data[2][0] != 0.0f || dst_data[3][0] != 0.0f) {
+        printf("  FAIL: Compiled routing (got %f, %f)\n",
+               dst_data[0][TEST_FRAMES - 1], dst_data[1][TEST_FRAMES - 1]);
+        passed = 0;
+    } else {
+        printf("  PASS: Duplicate routes summed, unrouted inputs silent\n");
+    }
+
+    // Ramp is linear and a matrix published mid-ramp waits for it to end
+    {
+        float expected_step = (0.0f - 2.0f) / ROUTING_MIXER_RAMP_FRAMES;
+        int ramp_ok = 1;
+
+        memset(&routing, 0, sizeof(routing));
+        routing.num_routes = 1;
+        set_route(&routing, 0, 0, 1, 1.0f); // drops the 0.25 * ch3 route on input 0
+        routing_mixer_publish(&mixer, &routing);
+        routing_mixer_begin(&mixer);
+        routing_mixer_process(&mixer, src, dst, TEST_FRAMES);
+        for (int i = 1; i < TEST_FRAMES; i++) {
+            if (fabsf((dst_data[0][i] - dst_data[0][i - 1]) - expected_step) > 1e-5f) {
+                ramp_ok = 0;
+            }
+        }
+
+        // Published mid-ramp: must not disturb the ramp in progress
+        routing.num_routes = 0;
+        routing_mixer_publish(&mixer, &routing);
+        routing_mixer_begin(&mixer);
+        routing_mixer_process(&mixer, src, dst, TEST_FRAMES);
+        if (fabsf((dst_data[0][0] - dst_data[0][TEST_FRAMES - 1]) +
+                  expected_step * (TEST_FRAMES - 1)) > 1e-4f) {
+            ramp_ok = 0;
+        }
+
+        settle(&mixer, src, dst);
+        settle(&mixer, src, dst);
+        if (!ramp_ok || !routing_mixer_begin(&mixer) || dst_data[3][0] != 4.0f) {
+            printf("  FAIL: Gain ramp\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Linear gain ramp, deferred swap back to identity\n");
+        }
+    }
+
+    // Concurrent publishing never exposes a torn matrix
+    {
+        publish_context_t ctx;
+        vcard_thread_t thread;
+        long periods = 0;
+        int torn = 0;
+
+        routing_mixer_init(&mixer, 2, 2);
+        ctx.mixer = &mixer;
+        vcard_atomic_store_relaxed_u32(&ctx.done, 0);
+        for (int i = 0; i < TEST_FRAMES; i++) {
+            src_data[1][i] = 1.0f;
+            src_data[0][i] = 1.0f;
+        }
+
+        if (vcard_thread_create(&thread, publisher_thread, &ctx) != VCARD_SUCCESS) {
+            printf("  FAIL: Could not start publisher thread\n");
+            return 1;
+        }
+        while (!vcard_atomic_load_acquire_u32(&ctx.done) || periods < 1000) {
+            routing_mixer_begin(&mixer);
+            routing_mixer_process(&mixer, src, dst, TEST_FRAMES);
+            for (int i = 0; i < TEST_FRAMES; i++) {
+                if (dst_data[0][i] != dst_data[1][i]) {
+                    torn = 1;
+                }
+            }
+            periods++;
+        }
+        vcard_thread_join(&thread);
+
+        if (torn) {
+            printf("  FAIL: Reader observed a partially updated matrix\n");
+            passed = 0;
+        } else {
+            printf("  PASS: %d publishes against %ld periods, no torn reads\n",
+                   TEST_PUBLISHES, periods);
+        }
+    }
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
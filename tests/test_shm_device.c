@@ -0,0 +1,322 @@
+/**
+ * Test for the Shared-Memory Device
+ *
+ * Creates a segment and attaches to it a second time by name, so the
+ * producer and consumer work through separate mappings as they would in
+ * two processes. Checks naming errors, a long stream through the rings
+ * with both sides sleeping on the wake-ups, wait timeouts, and two vcard
+ * devices joined through an export and an import link.
+ */
+
+#include "shm_device.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_CHANNELS 4
+#define TEST_RATE 48000
+#define TEST_FRAMES 512
+#define TEST_TOTAL_FRAMES 2000000
+#define TEST_CHUNK 100
+#define TEST_PERIOD 256
+#define TEST_LINK_CHANNELS 2
+#define TEST_LINK_FRAMES 100000
+
+typedef struct {
+    shm_device_t *shm;
+    int errors;
+} producer_t;
+
+/* Sample value for a given frame and channel (exact in float) */
+static float test_sample(size_t frame, int channel)
+{
+    return (float)((frame % 65536) + channel * 65536);
+}
+
+static void producer_main(void *arg)
+{
+    producer_t *p = (producer_t *)arg;
+    float data[TEST_CHANNELS][TEST_CHUNK];
+    const float *buffers[TEST_CHANNELS];
+    size_t frame = 0;
+
+    for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+        buffers[ch] = data[ch];
+    }
+    while (frame < TEST_TOTAL_FRAMES) {
+        size_t n = TEST_TOTAL_FRAMES - frame < TEST_CHUNK ? TEST_TOTAL_FRAMES - frame :
+                                                            TEST_CHUNK;
+        size_t written = 0;
+
+        if (shm_device_wait_writable(p->shm, (uint32_t)n, 1000) != VCARD_SUCCESS) {
+            p->errors++;
+            return;
+        }
+        for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+            for (size_t i = 0; i < n; i++) {
+                data[ch][i] = test_sample(frame + i, ch);
+            }
+        }
+        shm_device_write(p->shm, buffers, n, &written);
+        if (written != n) {
+            p->errors++;
+            return;
+        }
+        frame += n;
+    }
+}
+
+static int make_device(const char *name, uint32_t channels_in, uint32_t channels_out,
+                       int *device_id)
+{
+    vcard_config_t config;
+
+    memset(&config, 0, sizeof(config));
+    snprintf(config.name, sizeof(config.name), "%s", name);
+    config.channels_in = channels_in;
+    config.channels_out = channels_out;
+    config.sample_rate = TEST_RATE;
+    config.buffer_size = TEST_PERIOD;
+    config.bit_depth = VCARD_BIT_32;
+    return vcard_create_device(&config, device_id);
+}
+
+/**
+ * Write a counting stream into source and read it back from dest, where
+ * the links in between carry it; the number of frames that arrived intact
+ */
+static size_t stream_through_links(int source_id, int dest_id)
+{
+    float out[TEST_LINK_CHANNELS][TEST_PERIOD], in[TEST_LINK_CHANNELS][TEST_PERIOD];
+    const float *out_planes[TEST_LINK_CHANNELS];
+    float *in_planes[TEST_LINK_CHANNELS];
+    size_t sent = 0, received = 0;
+    uint64_t deadline = vcard_time_ns() + 10000000000ull;
+
+    for (int ch = 0; ch < TEST_LINK_CHANNELS; ch++) {
+        out_planes[ch] = out[ch];
+        in_planes[ch] = in[ch];
+    }
+    while (received < TEST_LINK_FRAMES && vcard_time_ns() < deadline) {
+        size_t want = TEST_LINK_FRAMES - sent < TEST_PERIOD ? TEST_LINK_FRAMES - sent :
+                                                              TEST_PERIOD;
+        size_t written = 0, got = 0;
+
+        for (int ch = 0; ch < TEST_LINK_CHANNELS; ch++) {
+            for (size_t i = 0; i < want; i++) {
+                out[ch][i] = test_sample(sent + i, ch);
+            }
+        }
+        if (want) {
+            vcard_write_audio(source_id, out_planes, want, &written);
+            sent += written;
+        }
+        vcard_read_audio(dest_id, in_planes, TEST_PERIOD, &got);
+        for (int ch = 0; ch < TEST_LINK_CHANNELS; ch++) {
+            for (size_t i = 0; i < got; i++) {
+                if (in[ch][i] != test_sample(received + i, ch)) {
+                    return received;
+                }
+            }
+        }
+        received += got;
+        if (!written && !got) {
+            vcard_sleep_us(200);
+        }
+    }
+    return received;
+}
+
+int main(void)
+{
+    shm_device_t owner, peer, other;
+    char name[SHM_DEVICE_MAX_NAME + 1];
+    int passed = 1;
+
+    printf("Testing shared-memory device...\n");
+
+    // A fresh name per run, so a leftover segment cannot interfere
+    snprintf(name, sizeof(name), "test-%08x", (unsigned)(vcard_time_ns() & 0xffffffffu));
+
+    if (shm_device_create(&owner, name, TEST_CHANNELS, TEST_RATE, TEST_FRAMES - 100) !=
+        VCARD_SUCCESS) {
+        printf("  FAIL: Could not create segment %s\n", name);
+        return 1;
+    }
+    if (shm_device_open(&peer, name) != VCARD_SUCCESS || peer.channels != TEST_CHANNELS ||
+        peer.sample_rate != TEST_RATE || peer.capacity != TEST_FRAMES ||
+        peer.header == owner.header) {
+        printf("  FAIL: Second attachment does not match the segment\n");
+        shm_device_close(&owner);
+        return 1;
+    }
+    printf("  PASS: Segment %s created and attached (%u channels, %u frames)\n",
+           name, peer.channels, peer.capacity);
+
+    {
+        int ok = shm_device_create(&other, name, 2, TEST_RATE, 64) == VCARD_ERROR_IN_USE &&
+                 shm_device_open(&other, "test-missing-segment") == VCARD_ERROR_NOT_FOUND &&
+                 shm_device_open(&other, "bad/name") == VCARD_ERROR_INVALID &&
+                 shm_device_create(&other, "test-bad", 0, TEST_RATE, 64) ==
+                     VCARD_ERROR_INVALID &&
+                 shm_device_wait_readable(&peer, TEST_FRAMES + 1, 0) == VCARD_ERROR_INVALID;
+        if (!ok) {
+            printf("  FAIL: Bad names or parameters not rejected\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Existing, missing and malformed names rejected\n");
+        }
+    }
+
+    // Empty segment: a wait sleeps for its timeout
+    {
+        uint64_t start = vcard_time_ns();
+        int result = shm_device_wait_readable(&peer, 1, 20);
+        uint64_t elapsed = vcard_time_ns() - start;
+
+        if (result != VCARD_ERROR_TIMEOUT || elapsed < 19000000u || elapsed > 500000000u) {
+            printf("  FAIL: Empty wait returned %d after %.1f ms\n", result, elapsed / 1e6);
+            passed = 0;
+        } else {
+            printf("  PASS: Empty wait timed out after %.1f ms\n", elapsed / 1e6);
+        }
+    }
+
+    // Producer on the creator's mapping, consumer on the second one
+    {
+        producer_t producer = { &owner, 0 };
+        vcard_thread_t thread;
+        float data[TEST_CHANNELS][TEST_PERIOD];
+        float *buffers[TEST_CHANNELS];
+        size_t frame = 0;
+        int errors = 0;
+        uint64_t start = vcard_time_ns();
+
+        for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+            buffers[ch] = data[ch];
+        }
+        vcard_thread_create(&thread, producer_main, &producer);
+        while (frame < TEST_TOTAL_FRAMES && !errors) {
+            size_t want = TEST_TOTAL_FRAMES - frame < TEST_PERIOD ? TEST_TOTAL_FRAMES - frame :
+                                                                    TEST_PERIOD;
+            size_t got = 0;
+
+            if (shm_device_wait_readable(&peer, (uint32_t)want, 1000) != VCARD_SUCCESS) {
+                errors++;
+                break;
+            }
+            shm_device_read(&peer, buffers, want, &got);
+            for (int ch = 0; ch < TEST_CHANNELS && !errors; ch++) {
+                for (size_t i = 0; i < got; i++) {
+                    if (data[ch][i] != test_sample(frame + i, ch)) {
+                        errors++;
+                        break;
+                    }
+                }
+            }
+            frame += got;
+        }
+        vcard_thread_join(&thread);
+
+        if (errors || producer.errors || frame != TEST_TOTAL_FRAMES ||
+            shm_device_buffered(&peer) != 0) {
+            printf("  FAIL: Stream through the segment (%zu frames, %d consumer errors, "
+                   "%d producer errors)\n", frame, errors, producer.errors);
+            passed = 0;
+        } else {
+            printf("  PASS: %d frames x %d channels streamed intact in %.0f ms\n",
+                   TEST_TOTAL_FRAMES, TEST_CHANNELS, (vcard_time_ns() - start) / 1e6);
+        }
+    }
+
+    // The name goes away with the creator
+    shm_device_close(&peer);
+    shm_device_close(&owner);
+    if (shm_device_open(&other, name) != VCARD_ERROR_NOT_FOUND) {
+        printf("  FAIL: Segment still attachable after close\n");
+        shm_device_close(&other);
+        passed = 0;
+    } else {
+        printf("  PASS: Segment removed on close\n");
+    }
+
+    // A device exported into a segment and imported into another device
+    {
+        shm_link_t export_link, import_link, bad_link;
+        shm_link_stats_t export_stats, import_stats;
+        int source_id, dest_id, wide_id;
+        size_t received;
+
+        vcard_init();
+        snprintf(name, sizeof(name), "link-%08x", (unsigned)(vcard_time_ns() & 0xffffffffu));
+        if (make_device("Link Source", TEST_LINK_CHANNELS, TEST_LINK_CHANNELS, &source_id) !=
+                VCARD_SUCCESS ||
+            make_device("Link Dest", TEST_LINK_CHANNELS, TEST_LINK_CHANNELS, &dest_id) !=
+                VCARD_SUCCESS ||
+            make_device("Link Wide", TEST_LINK_CHANNELS, TEST_LINK_CHANNELS + 1, &wide_id) !=
+                VCARD_SUCCESS) {
+            printf("  FAIL: Could not create the linked devices\n");
+            vcard_cleanup();
+            return 1;
+        }
+
+        if (shm_link_start(&bad_link, dest_id, name, SHM_LINK_IMPORT, 0) !=
+                VCARD_ERROR_NOT_FOUND ||
+            shm_link_start(&export_link, source_id, name, SHM_LINK_EXPORT, 0) !=
+                VCARD_SUCCESS) {
+            printf("  FAIL: Import before the export, or the export itself\n");
+            vcard_cleanup();
+            return 1;
+        }
+        if (shm_link_start(&bad_link, wide_id, name, SHM_LINK_IMPORT, 0) !=
+                VCARD_ERROR_INVALID ||
+            shm_link_start(&bad_link, source_id, name, SHM_LINK_EXPORT, 0) !=
+                VCARD_ERROR_IN_USE ||
+            shm_link_start(&bad_link, 999, name, SHM_LINK_IMPORT, 0) != VCARD_ERROR_NOT_FOUND) {
+            printf("  FAIL: Mismatched, duplicate or unknown link accepted\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Missing, mismatched, duplicate and unknown links rejected\n");
+        }
+
+        if (shm_link_start(&import_link, dest_id, name, SHM_LINK_IMPORT, 0) != VCARD_SUCCESS) {
+            printf("  FAIL: Could not import segment %s\n", name);
+            shm_link_stop(&export_link);
+            vcard_cleanup();
+            return 1;
+        }
+        received = stream_through_links(source_id, dest_id);
+        shm_link_stop(&import_link);
+        shm_link_stop(&export_link);
+        shm_link_get_stats(&export_link, &export_stats);
+        shm_link_get_stats(&import_link, &import_stats);
+
+        if (received != TEST_LINK_FRAMES || export_stats.dropped_frames != 0 ||
+            import_stats.frames != TEST_LINK_FRAMES) {
+            printf("  FAIL: %zu of %d frames through the links (%llu exported, "
+                   "%llu dropped, %llu imported)\n", received, TEST_LINK_FRAMES,
+                   (unsigned long long)export_stats.frames,
+                   (unsigned long long)export_stats.dropped_frames,
+                   (unsigned long long)import_stats.frames);
+            passed = 0;
+        } else {
+            printf("  PASS: %d frames from one device to another through segment %s\n",
+                   TEST_LINK_FRAMES, name);
+        }
+        if (shm_device_open(&other, name) != VCARD_ERROR_NOT_FOUND) {
+            printf("  FAIL: Export left its segment behind\n");
+            shm_device_close(&other);
+            passed = 0;
+        }
+        vcard_cleanup();
+    }
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
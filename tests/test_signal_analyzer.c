@@ -0,0 +1,197 @@
+/**
+ * Test for the Streaming Signal Analyzer
+ *
+ * Feeds synthetic tones with known frequency offset, DC, harmonics and
+ * noise through both analyzer modes in odd-sized periods and checks the
+ * measured frequency, amplitude, DC, THD+N and SNR.
+ */
+
+#include "signal_analyzer.h"
+#include "vcard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_PERIOD 333
+#define TEST_SECONDS 5
+
+/* Test signal: a0 sin(f) + a2 sin(2f) + a3 sin(3f) + dc + uniform noise */
+typedef struct {
+    double frequency;
+    double amplitude;
+    double second;
+    double third;
+    double dc;
+    double noise;
+    uint64_t n;
+    uint32_t seed;
+} test_signal_t;
+
+static double next_sample(test_signal_t *s)
+{
+    double t = 2.0 * M_PI * s->frequency * (double)s->n++ / TEST_SAMPLE_RATE;
+    double x = s->amplitude * sin(t) + s->second * sin(2.0 * t) +
+               s->third * sin(3.0 * t) + s->dc;
+
+    s->seed ^= s->seed << 13;
+    s->seed ^= s->seed >> 17;
+    s->seed ^= s->seed << 5;
+    return x + s->noise * ((double)s->seed / 2147483648.0 - 1.0);
+}
+
+/* Stream TEST_SECONDS of the signal through the analyzer a period at a time */
+static void run_float(signal_analyzer_t *a, test_signal_t *s)
+{
+    float period[TEST_PERIOD];
+    size_t total = (size_t)(TEST_SECONDS * TEST_SAMPLE_RATE);
+
+    for (size_t done = 0; done < total; done += TEST_PERIOD) {
+        for (int i = 0; i < TEST_PERIOD; i++) {
+            period[i] = (float)next_sample(s);
+        }
+        signal_analyzer_process(a, period, TEST_PERIOD, 1);
+    }
+}
+
+int main(void)
+{
+    signal_analyzer_t a;
+    int passed = 1;
+
+    printf("Testing signal analyzer...\n");
+
+    if (signal_analyzer_init(&a, TEST_SAMPLE_RATE, 0.0, 4800) != VCARD_ERROR_INVALID ||
+        signal_analyzer_init(&a, TEST_SAMPLE_RATE, 24000.0, 4800) != VCARD_ERROR_INVALID ||
+        signal_analyzer_init(&a, TEST_SAMPLE_RATE, 440.0, 32) != VCARD_ERROR_INVALID) {
+        printf("  FAIL: Invalid configurations should be rejected\n");
+        passed = 0;
+    } else {
+        printf("  PASS: Invalid configurations rejected\n");
+    }
+
+    // Goertzel: clean tone 1.7 Hz off the expected frequency, with DC
+    {
+        test_signal_t s = { 441.7, 0.5, 0.0, 0.0, 0.01, 0.0, 0, 1 };
+        const signal_summary_t *sum = &a.summary;
+        int ok;
+
+        signal_analyzer_init(&a, TEST_SAMPLE_RATE, 440.0, 4800);
+        run_float(&a, &s);
+        ok = sum->blocks == TEST_SECONDS * 10 - 2 &&
+             fabs(sum->frequency_min - 441.7) < 0.01 &&
+             fabs(sum->frequency_max - 441.7) < 0.01 &&
+             fabs(sum->amplitude_min - 0.5) < 1e-4 &&
+             fabs(a.last.dc - 0.01) < 1e-6 &&
+             fabs(sum->rms_min - 0.5 / sqrt(2.0)) < 1e-4 &&
+             sum->thd_n_db_max < -120.0;
+        signal_analyzer_free(&a);
+
+        if (!ok) {
+            printf("  FAIL: Goertzel tone (%.4f Hz, amp %.6f, THD+N %.1f dB)\n",
+                   sum->frequency_max, sum->amplitude_min, sum->thd_n_db_max);
+            passed = 0;
+        } else {
+            printf("  PASS: Goertzel tone %.3f Hz, THD+N %.1f dB\n",
+                   sum->frequency_max, sum->thd_n_db_max);
+        }
+    }
+
+    // Goertzel: 0.1% second harmonic and noise 60 dB below the tone
+    {
+        double noise = sqrt(3.0 * 0.125 * 1e-6);
+        test_signal_t s = { 997.0, 0.5, 0.0005, 0.0, 0.0, noise, 0, 1 };
+        int ok;
+
+        signal_analyzer_init(&a, TEST_SAMPLE_RATE, 1000.0, 4800);
+        run_float(&a, &s);
+        // Harmonic (-60 dB) plus noise (-60 dB) make THD+N -57 dB
+        ok = fabs(a.summary.snr_db_min - 60.0) < 1.0 &&
+             fabs(a.last.snr_db - 60.0) < 0.5 &&
+             fabs(a.last.thd_n_db + 57.0) < 0.5 &&
+             fabs(a.last.frequency - 997.0) < 0.05;
+        signal_analyzer_free(&a);
+
+        if (!ok) {
+            printf("  FAIL: Harmonics and noise (SNR %.2f dB, THD+N %.2f dB)\n",
+                   a.last.snr_db, a.last.thd_n_db);
+            passed = 0;
+        } else {
+            printf("  PASS: SNR %.2f dB, THD+N %.2f dB\n",
+                   a.last.snr_db, a.last.thd_n_db);
+        }
+    }
+
+    // FFT: unknown frequency with a 1% third harmonic
+    {
+        test_signal_t s = { 1234.5, 0.25, 0.0, 0.0025, -0.02, 0.0, 0, 1 };
+        int ok;
+
+        if (signal_analyzer_init(&a, TEST_SAMPLE_RATE, 0.0, 8192) != VCARD_SUCCESS) {
+            printf("  FAIL: Could not allocate FFT analyzer\n");
+            return 1;
+        }
+        run_float(&a, &s);
+        ok = a.summary.blocks == (uint64_t)(TEST_SECONDS * TEST_SAMPLE_RATE) / 8192 &&
+             fabs(a.summary.frequency_min - 1234.5) < 0.5 &&
+             fabs(a.summary.frequency_max - 1234.5) < 0.5 &&
+             fabs(a.summary.amplitude_min - 0.25) < 0.0025 &&
+             fabs(a.last.dc + 0.02) < 1e-6 &&
+             fabs(a.summary.thd_n_db_max + 40.0) < 0.5 &&
+             a.summary.snr_db_min > 100.0;
+        signal_analyzer_free(&a);
+
+        if (!ok) {
+            printf("  FAIL: FFT tone (%.3f-%.3f Hz, THD+N %.2f dB, SNR %.1f dB)\n",
+                   a.summary.frequency_min, a.summary.frequency_max,
+                   a.summary.thd_n_db_max, a.summary.snr_db_min);
+            passed = 0;
+        } else {
+            printf("  PASS: FFT found %.3f Hz, THD+N %.2f dB\n",
+                   a.last.frequency, a.summary.thd_n_db_max);
+        }
+    }
+
+    // One channel of interleaved 16-bit stereo
+    {
+        int16_t period[TEST_PERIOD * 2];
+        test_signal_t left = { 440.0, 0.5, 0.0, 0.0, 0.0, 0.0, 0, 1 };
+        test_signal_t right = { 3000.0, 0.9, 0.0, 0.0, 0.0, 0.0, 0, 1 };
+        int ok;
+
+        signal_analyzer_init(&a, TEST_SAMPLE_RATE, 440.0, 4800);
+        for (int p = 0; p < 200; p++) {
+            for (int i = 0; i < TEST_PERIOD; i++) {
+                period[2 * i] = (int16_t)lrint(next_sample(&left) * 32767.0);
+                period[2 * i + 1] = (int16_t)lrint(next_sample(&right) * 32767.0);
+            }
+            signal_analyzer_process_i16(&a, period, TEST_PERIOD, 2);
+        }
+        // 16-bit quantization of a half-scale tone: about 92 dB
+        ok = a.summary.blocks == 200 * TEST_PERIOD / 4800 - 2 &&
+             fabs(a.summary.frequency_max - 440.0) < 0.01 &&
+             a.summary.snr_db_min > 88.0 && a.summary.snr_db_min < 96.0;
+        signal_analyzer_free(&a);
+
+        if (!ok) {
+            printf("  FAIL: 16-bit interleaved (SNR %.1f dB)\n", a.summary.snr_db_min);
+            passed = 0;
+        } else {
+            printf("  PASS: 16-bit interleaved, SNR %.1f dB\n", a.summary.snr_db_min);
+        }
+    }
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
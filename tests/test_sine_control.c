@@ -0,0 +1,254 @@
+/**
+ * Test for Live Sine Parameter Control
+ *
+ * Checks that commands take effect at the frame they are stamped with,
+ * that amplitude and frequency ramps follow their envelopes without phase
+ * discontinuities, and that the queue reports overflow and completion,
+ * including while another thread pushes commands during rendering.
+ */
+
+#include "sine_control.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_FRAMES 48000
+#define TEST_PERIOD 256
+#define TEST_THREAD_COMMANDS 2000
+
+static float output[TEST_FRAMES];
+static float reference[TEST_FRAMES];
+
+/* Render TEST_FRAMES in periods, as a process callback would */
+static void render_all(sine_control_t *ctl, float *out)
+{
+    for (size_t done = 0; done < TEST_FRAMES; done += TEST_PERIOD) {
+        size_t n = TEST_FRAMES - done < TEST_PERIOD ? TEST_FRAMES - done : TEST_PERIOD;
+        sine_control_render(ctl, out + done, n);
+    }
+}
+
+/* Largest step between neighbouring samples after index start */
+static double max_step(const float *x, size_t start, size_t end)
+{
+    double worst = 0.0;
+
+    for (size_t i = start + 1; i < end; i++) {
+        double d = fabs((double)x[i] - (double)x[i - 1]);
+        if (d > worst) {
+            worst = d;
+        }
+    }
+    return worst;
+}
+
+typedef struct {
+    sine_control_t *ctl;
+    int rejected;
+    vcard_atomic_u32 finished;
+} producer_t;
+
+static void producer_thread(void *arg)
+{
+    producer_t *p = (producer_t *)arg;
+
+    for (int i = 0; i < TEST_THREAD_COMMANDS; i++) {
+        sine_param_t param = (i & 1) ? SINE_PARAM_AMPLITUDE : SINE_PARAM_FREQUENCY;
+        double target = (i & 1) ? 0.1 + 0.0002 * i : 200.0 + (i % 1000);
+
+        while (sine_control_push(p->ctl, param, target, (uint32_t)(i % 64),
+                                 SINE_CONTROL_NOW) == VCARD_ERROR_NO_MEMORY) {
+            p->rejected++;
+            vcard_sleep_us(100);
+        }
+    }
+    vcard_atomic_store_release_u32(&p->finished, 1);
+}
+
+int main(void)
+{
+    static sine_control_t ctl;
+    int passed = 1;
+
+    printf("Testing live sine control...\n");
+
+    // No commands: identical to the plain generator
+    {
+        sine_generator_t gen;
+        double worst = 0.0;
+
+        sine_control_init(&ctl, 1000.0, TEST_SAMPLE_RATE, 0.5);
+        render_all(&ctl, output);
+        sine_generator_init(&gen, 1000.0, TEST_SAMPLE_RATE, 0.5);
+        sine_generator_process_f32(&gen, reference, TEST_FRAMES);
+        for (size_t i = 0; i < TEST_FRAMES; i++) {
+            double d = fabs((double)output[i] - (double)reference[i]);
+            if (d > worst) {
+                worst = d;
+            }
+        }
+        if (worst > 1e-5 || sine_control_frames(&ctl) != TEST_FRAMES) {
+            printf("  FAIL: Uncontrolled output differs by %g\n", worst);
+            passed = 0;
+        } else {
+            printf("  PASS: Uncontrolled output matches the generator\n");
+        }
+    }
+
+    // Stamped jump: exact frame, continuous phase
+    {
+        const uint64_t at = 10007;
+        sine_generator_t gen;
+        double worst = 0.0;
+
+        sine_control_init(&ctl, 1000.0, TEST_SAMPLE_RATE, 0.5);
+        sine_control_push(&ctl, SINE_PARAM_FREQUENCY, 3000.0, 0, at);
+        sine_control_push(&ctl, SINE_PARAM_AMPLITUDE, 0.25, 0, at);
+        render_all(&ctl, output);
+
+        sine_generator_init(&gen, 1000.0, TEST_SAMPLE_RATE, 0.5);
+        sine_generator_process_f32(&gen, reference, at);
+        sine_generator_set_frequency(&gen, 3000.0);
+        sine_generator_set_amplitude(&gen, 0.25);
+        sine_generator_process_f32(&gen, reference + at, TEST_FRAMES - at);
+        for (size_t i = 0; i < TEST_FRAMES; i++) {
+            double d = fabs((double)output[i] - (double)reference[i]);
+            if (d > worst) {
+                worst = d;
+            }
+        }
+        if (worst > 1e-5 || !sine_control_idle(&ctl) ||
+            fabs(sine_control_frequency(&ctl) - 3000.0) > 0.001) {
+            printf("  FAIL: Jump at frame %llu differs by %g\n",
+                   (unsigned long long)at, worst);
+            passed = 0;
+        } else {
+            printf("  PASS: Jump applied at frame %llu\n", (unsigned long long)at);
+        }
+    }
+
+    // Amplitude ramp 0.5 -> 0.0 over 4800 frames from frame 1000
+    {
+        const size_t start = 1000, len = 4800;
+        int ok = 1;
+
+        sine_control_init(&ctl, 440.0, TEST_SAMPLE_RATE, 0.5);
+        sine_control_push(&ctl, SINE_PARAM_AMPLITUDE, 0.0, (uint32_t)len, start);
+        render_all(&ctl, output);
+        for (size_t i = start; i < TEST_FRAMES; i++) {
+            double envelope = i >= start + len ? 0.0 :
+                              0.5 * (1.0 - (double)(i - start) / (double)len);
+            if (fabs((double)output[i]) > envelope + 1e-6) {
+                ok = 0;
+            }
+        }
+        // Halfway through, the amplitude is half the starting one
+        ok = ok && fabs(fabs(output[start + len / 2]) -
+                        0.25 * fabs(sin(2.0 * M_PI * 440.0 * (double)(start + len / 2) /
+                                        TEST_SAMPLE_RATE))) < 1e-3;
+        if (!ok || !sine_control_idle(&ctl)) {
+            printf("  FAIL: Amplitude ramp exceeds its envelope\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Amplitude ramp follows its envelope\n");
+        }
+    }
+
+    // Exponential frequency sweep 100 -> 1000 Hz over one second
+    {
+        double expected = 2.0 * 900.0 / log(10.0);  // Zero crossings
+        double limit = 2.0 * M_PI * 1000.0 / TEST_SAMPLE_RATE * 0.5 + 1e-4;
+        int crossings = 0;
+
+        sine_control_init(&ctl, 100.0, TEST_SAMPLE_RATE, 0.5);
+        sine_control_push(&ctl, SINE_PARAM_FREQUENCY, 1000.0, TEST_FRAMES,
+                          SINE_CONTROL_NOW);
+        render_all(&ctl, output);
+        for (size_t i = 1; i < TEST_FRAMES; i++) {
+            if ((output[i - 1] < 0.0f) != (output[i] < 0.0f)) {
+                crossings++;
+            }
+        }
+        if (fabs(crossings - expected) > 2.0 || max_step(output, 0, TEST_FRAMES) > limit ||
+            !sine_control_idle(&ctl) ||
+            fabs(sine_control_frequency(&ctl) - 1000.0) > 0.001) {
+            printf("  FAIL: Sweep has %d zero crossings (expected %.0f), max step %g\n",
+                   crossings, expected, max_step(output, 0, TEST_FRAMES));
+            passed = 0;
+        } else {
+            printf("  PASS: Sweep has %d zero crossings (expected %.0f)\n",
+                   crossings, expected);
+        }
+    }
+
+    // Invalid targets, overflow and completion
+    {
+        int ok = 1;
+        int i;
+
+        sine_control_init(&ctl, 440.0, TEST_SAMPLE_RATE, 0.5);
+        ok = sine_control_push(&ctl, SINE_PARAM_FREQUENCY, 0.0, 0, 0) == VCARD_ERROR_INVALID &&
+             sine_control_push(&ctl, SINE_PARAM_AMPLITUDE, 1.5, 0, 0) == VCARD_ERROR_INVALID &&
+             sine_control_push(&ctl, SINE_PARAM_AMPLITUDE, NAN, 0, 0) == VCARD_ERROR_INVALID &&
+             sine_control_idle(&ctl);
+        for (i = 0; i < SINE_CONTROL_QUEUE_SIZE; i++) {
+            ok = ok && sine_control_push(&ctl, SINE_PARAM_AMPLITUDE, 0.25, 100, 0) == 0;
+        }
+        ok = ok && sine_control_push(&ctl, SINE_PARAM_AMPLITUDE, 0.25, 0, 0) ==
+                   VCARD_ERROR_NO_MEMORY && !sine_control_idle(&ctl);
+        sine_control_render(&ctl, output, 50);
+        ok = ok && !sine_control_idle(&ctl);
+        sine_control_render(&ctl, output, 50);
+        ok = ok && sine_control_idle(&ctl) && fabs(ctl.gen.amplitude - 0.25) < 1e-12;
+        if (!ok) {
+            printf("  FAIL: Validation, overflow or completion\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Validation, overflow and completion\n");
+        }
+    }
+
+    // Commands pushed from another thread during rendering
+    {
+        producer_t producer = { &ctl, 0, 0 };
+        vcard_thread_t thread;
+        double limit = 2.0 * M_PI * 1200.0 / TEST_SAMPLE_RATE + 1e-3;
+        int ok = 1;
+
+        sine_control_init(&ctl, 440.0, TEST_SAMPLE_RATE, 0.5);
+        if (vcard_thread_create(&thread, producer_thread, &producer) != 0) {
+            printf("  FAIL: Could not start the producer thread\n");
+            return 1;
+        }
+        // Render until every command is pushed and applied
+        while (!vcard_atomic_load_acquire_u32(&producer.finished) ||
+               !sine_control_idle(&ctl)) {
+            render_all(&ctl, output);
+            ok = ok && max_step(output, 0, TEST_FRAMES) <= limit;
+        }
+        vcard_thread_join(&thread);
+        if (!ok || !sine_control_idle(&ctl) ||
+            fabs(ctl.gen.frequency - (200.0 + (TEST_THREAD_COMMANDS - 2) % 1000)) > 1e-9) {
+            printf("  FAIL: Concurrent commands (%d retries)\n", producer.rejected);
+            passed = 0;
+        } else {
+            printf("  PASS: %d concurrent commands applied (%d retries)\n",
+                   TEST_THREAD_COMMANDS, producer.rejected);
+        }
+    }
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
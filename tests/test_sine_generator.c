@@ -5,6 +5,7 @@
 #include "sine_generator.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #ifndef M_PI
@@ -16,6 +17,45 @@
 #define TEST_AMPLITUDE 0.5
 #define TEST_SAMPLES 1000
 #define EPSILON 0.001
+#define ACCURACY_SAMPLES 48000
+#define INTERLEAVED_FRAMES 300
+#define INTERLEAVED_CHANNELS 6
+#define LAYOUT_FRAMES 601           /* Spans two full blocks and a tail */
+
+/**
+ * Measure the maximum error of the active kernel against sin()
+ *
+ * Samples are generated in uneven chunks so that SIMD tails and the phase
+ * carried between calls are exercised as well.
+ */
+static double measure_max_error(double frequency, double sample_rate)
+{
+    static float buffer[ACCURACY_SAMPLES];
+    static const size_t chunks[] = { 1, 7, 64, 333, 1024, 4093 };
+    sine_generator_t gen;
+    size_t done = 0;
+    size_t c = 0;
+    double max_error = 0.0;
+
+    sine_generator_init(&gen, frequency, sample_rate, 1.0);
+    while (done < ACCURACY_SAMPLES) {
+        size_t n = chunks[c++ % (sizeof(chunks) / sizeof(chunks[0]))];
+        if (n > ACCURACY_SAMPLES - done) {
+            n = ACCURACY_SAMPLES - done;
+        }
+        sine_generator_process_f32(&gen, buffer + done, n);
+        done += n;
+    }
+
+    for (size_t i = 0; i < ACCURACY_SAMPLES; i++) {
+        double cycles = fmod((double)i * frequency, sample_rate) / sample_rate;
+        double error = fabs(buffer[i] - sin(2.0 * M_PI * cycles));
+        if (error > max_error) {
+            max_error = error;
+        }
+    }
+    return max_error;
+}
 
 int main(void)
 {
@@ -102,6 +142,330 @@ int main(void)
         printf("  PASS: 32-bit generation works (first sample: %d)\n", buffer_i32[0]);
     }
     
+    // Test interleaved writers against the mono output
+    {
+        float mono[INTERLEAVED_FRAMES];
+        float inter_f32[INTERLEAVED_FRAMES * INTERLEAVED_CHANNELS];
+        int16_t inter_i16[INTERLEAVED_FRAMES * INTERLEAVED_CHANNELS];
+        int32_t inter_i32[INTERLEAVED_FRAMES * INTERLEAVED_CHANNELS];
+        int interleaved_ok = 1;
+
+        sine_generator_init(&gen, TEST_FREQUENCY, TEST_SAMPLE_RATE, TEST_AMPLITUDE);
+        sine_generator_process_f32(&gen, mono, INTERLEAVED_FRAMES);
+        sine_generator_reset(&gen);
+        sine_generator_process_interleaved_f32(&gen, inter_f32, INTERLEAVED_FRAMES,
+                                               INTERLEAVED_CHANNELS);
+        sine_generator_reset(&gen);
+        sine_generator_process_interleaved_i16(&gen, inter_i16, INTERLEAVED_FRAMES,
+                                               INTERLEAVED_CHANNELS);
+        sine_generator_reset(&gen);
+        sine_generator_process_interleaved_i32(&gen, inter_i32, INTERLEAVED_FRAMES,
+                                               INTERLEAVED_CHANNELS);
+
+        for (int i = 0; i < INTERLEAVED_FRAMES && interleaved_ok; i++) {
+            for (int ch = 0; ch < INTERLEAVED_CHANNELS; ch++) {
+                int idx = i * INTERLEAVED_CHANNELS + ch;
+                if (inter_f32[idx] != mono[i] ||
+                    inter_i16[idx] != (int16_t)(mono[i] * 32767.0f) ||
+                    inter_i32[idx] != (int32_t)(mono[i] * 2147483647.0)) {
+                    printf("  FAIL: Interleaved frame %d channel %d mismatch\n", i, ch);
+                    interleaved_ok = 0;
+                    break;
+                }
+            }
+        }
+        if (interleaved_ok) {
+            printf("  PASS: Interleaved f32/i16/i32 writers match mono output (%d ch)\n",
+                   INTERLEAVED_CHANNELS);
+        } else {
+            passed = 0;
+        }
+    }
+
+    // Test the format-converting writers: packed 24-bit, planar and clipping
+    {
+        float mono[INTERLEAVED_FRAMES];
+        uint8_t inter_i24[INTERLEAVED_FRAMES * INTERLEAVED_CHANNELS * 3];
+        int16_t planes_i16[INTERLEAVED_CHANNELS][INTERLEAVED_FRAMES];
+        void *planes[INTERLEAVED_CHANNELS];
+        int32_t loud[INTERLEAVED_FRAMES];
+        int formats_ok = sine_format_bytes(SINE_FORMAT_I24) == 3 &&
+                         sine_format_bytes(SINE_FORMAT_F32) == 4;
+
+        for (int ch = 0; ch < INTERLEAVED_CHANNELS; ch++) {
+            planes[ch] = planes_i16[ch];
+        }
+        sine_generator_init(&gen, TEST_FREQUENCY, TEST_SAMPLE_RATE, TEST_AMPLITUDE);
+        sine_generator_process_f32(&gen, mono, INTERLEAVED_FRAMES);
+        sine_generator_reset(&gen);
+        sine_generator_write_interleaved(&gen, inter_i24, INTERLEAVED_FRAMES,
+                                         INTERLEAVED_CHANNELS, SINE_FORMAT_I24);
+        sine_generator_reset(&gen);
+        sine_generator_write_planar(&gen, planes, INTERLEAVED_FRAMES,
+                                    INTERLEAVED_CHANNELS, SINE_FORMAT_I16);
+
+        for (int i = 0; i < INTERLEAVED_FRAMES && formats_ok; i++) {
+            int32_t expected24 = (int32_t)(mono[i] * 8388607.0);
+            for (int ch = 0; ch < INTERLEAVED_CHANNELS; ch++) {
+                const uint8_t *p24 = inter_i24 + (i * INTERLEAVED_CHANNELS + ch) * 3;
+                // Sign-extend the little-endian 24-bit sample
+                int32_t value = (int32_t)((uint32_t)p24[0] << 8 | (uint32_t)p24[1] << 16 |
+                                          (uint32_t)p24[2] << 24) >> 8;
+                if (value != expected24 ||
+                    planes_i16[ch][i] != (int16_t)(mono[i] * 32767.0f)) {
+                    printf("  FAIL: Format writer frame %d channel %d mismatch\n", i, ch);
+                    formats_ok = 0;
+                    break;
+                }
+            }
+        }
+
+        // Amplitude above full scale must clip, not wrap
+        sine_generator_init(&gen, TEST_FREQUENCY, TEST_SAMPLE_RATE, 4.0);
+        sine_generator_write_interleaved(&gen, loud, INTERLEAVED_FRAMES, 1, SINE_FORMAT_I32);
+        for (int i = 1; i < INTERLEAVED_FRAMES && formats_ok; i++) {
+            if ((loud[i] < 0) != (mono[i] < 0.0f) && mono[i] != 0.0f) {
+                printf("  FAIL: Over-range sample %d wrapped (%d)\n", i, loud[i]);
+                formats_ok = 0;
+            }
+        }
+
+        if (formats_ok) {
+            printf("  PASS: Packed 24-bit and planar writers match, over-range clips\n");
+        } else {
+            passed = 0;
+        }
+    }
+
+    // Test the SIMD quantizers against the scalar definitions, tails included
+    {
+        static const sine_format_t formats[] = {
+            SINE_FORMAT_I16, SINE_FORMAT_I24, SINE_FORMAT_I24_32, SINE_FORMAT_I32
+        };
+        float ramp[1003];
+        uint8_t out[1003 * 2 * 4];
+        float back[1003];
+        int convert_ok = sine_format_bytes(SINE_FORMAT_I24_32) == 4;
+
+        // Full range and beyond, including exact full scale and zero
+        for (int i = 0; i < 1003; i++) {
+            ramp[i] = (float)(i - 501) / 400.0f;
+        }
+        for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]) && convert_ok; f++) {
+            size_t bytes = sine_format_bytes(formats[f]);
+
+            sine_format_convert(ramp, 1003, out, 2, formats[f]);
+            for (int i = 0; i < 1003 && convert_ok; i++) {
+                float c = ramp[i] > 1.0f ? 1.0f : (ramp[i] < -1.0f ? -1.0f : ramp[i]);
+                const uint8_t *p = out + (size_t)i * 2 * bytes;
+                int64_t expected, value;
+
+                switch (formats[f]) {
+                case SINE_FORMAT_I16:
+                    expected = (int16_t)(c * 32767.0f);
+                    value = (int16_t)(p[0] | p[1] << 8);
+                    break;
+                case SINE_FORMAT_I24:
+                    expected = (int32_t)(c * 8388607.0);
+                    value = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 |
+                                      (uint32_t)p[2] << 24) >> 8;
+                    break;
+                case SINE_FORMAT_I24_32:
+                    expected = (int32_t)(c * 8388607.0);
+                    value = (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+                                      (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+                    break;
+                default:
+                    expected = (int32_t)(c * 2147483647.0);
+                    value = (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+                                      (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+                    break;
+                }
+                if (value != expected || memcmp(p, p + bytes, bytes) != 0) {
+                    printf("  FAIL: Format %d sample %d is %lld, expected %lld\n",
+                           (int)formats[f], i, (long long)value, (long long)expected);
+                    convert_ok = 0;
+                }
+            }
+
+            // And back to float, one channel of the interleaved pair
+            sine_format_to_float(out + bytes, 1003, 2, formats[f], back);
+            for (int i = 0; i < 1003 && convert_ok; i++) {
+                float c = ramp[i] > 1.0f ? 1.0f : (ramp[i] < -1.0f ? -1.0f : ramp[i]);
+                if (fabs(back[i] - c) > (formats[f] == SINE_FORMAT_I16 ? 1.0 / 16384.0 : 1e-6)) {
+                    printf("  FAIL: Format %d sample %d reads back as %g\n",
+                           (int)formats[f], i, back[i]);
+                    convert_ok = 0;
+                }
+            }
+        }
+        if (convert_ok) {
+            printf("  PASS: i16/i24/i24-in-32/i32 conversion matches the scalar definition\n");
+        } else {
+            passed = 0;
+        }
+    }
+
+    // Test every specialized layout kernel against the mono conversion
+    {
+        static const sine_format_t formats[] = {
+            SINE_FORMAT_F32, SINE_FORMAT_I16, SINE_FORMAT_I24, SINE_FORMAT_I24_32,
+            SINE_FORMAT_I32
+        };
+        static const unsigned int counts[] = { 1, 2, 3, 6, 8, 16, 32 };
+        static float ramp[LAYOUT_FRAMES];
+        static uint8_t mono[LAYOUT_FRAMES * 4];
+        static uint8_t out[LAYOUT_FRAMES * 32 * 4 + 1];
+        static uint8_t planes[32][LAYOUT_FRAMES * 4];
+        void *plane_ptrs[32];
+        sine_writer_t writer;
+        void *buffer = out;
+        int layout_ok = sine_writer_init(&writer, SINE_FORMAT_I16, 0, 0) == -1 &&
+                        writer.store == NULL;
+
+        for (int i = 0; i < LAYOUT_FRAMES; i++) {
+            ramp[i] = (float)(i - LAYOUT_FRAMES / 2) / (LAYOUT_FRAMES / 2.5f);
+        }
+        for (int ch = 0; ch < 32; ch++) {
+            plane_ptrs[ch] = planes[ch];
+        }
+        for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]) && layout_ok; f++) {
+            size_t bytes = sine_format_bytes(formats[f]);
+
+            sine_format_convert(ramp, LAYOUT_FRAMES, mono, 1, formats[f]);
+            for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]) && layout_ok; c++) {
+                unsigned int channels = counts[c];
+
+                memset(out, 0xAA, sizeof(out));
+                sine_writer_init(&writer, formats[f], channels, 0);
+                sine_writer_convert(&writer, ramp, LAYOUT_FRAMES, &buffer, NULL);
+                sine_writer_init(&writer, formats[f], channels, 1);
+                sine_writer_convert(&writer, ramp, LAYOUT_FRAMES, plane_ptrs, NULL);
+                for (int i = 0; i < LAYOUT_FRAMES && layout_ok; i++) {
+                    for (unsigned int ch = 0; ch < channels; ch++) {
+                        const uint8_t *expected = mono + (size_t)i * bytes;
+                        if (memcmp(out + ((size_t)i * channels + ch) * bytes, expected,
+                                   bytes) != 0 ||
+                            memcmp(planes[ch] + (size_t)i * bytes, expected, bytes) != 0) {
+                            printf("  FAIL: Format %d, %u channels: frame %d channel %u\n",
+                                   (int)formats[f], channels, i, ch);
+                            layout_ok = 0;
+                            break;
+                        }
+                    }
+                }
+                // Nothing written past the last frame
+                if (out[(size_t)LAYOUT_FRAMES * channels * bytes] != 0xAA) {
+                    printf("  FAIL: Format %d, %u channels: overrun\n",
+                           (int)formats[f], channels);
+                    layout_ok = 0;
+                }
+            }
+        }
+        if (layout_ok) {
+            printf("  PASS: Layout kernels match for 5 formats x 1-32 channels, "
+                   "interleaved and planar\n");
+        } else {
+            passed = 0;
+        }
+    }
+
+    // Test TPDF dither: bounded error, zero mean, and low-level signal kept
+    {
+        static float quiet[48000];
+        static int16_t plain[48000], dithered[48000];
+        sine_dither_t dither;
+        double err_sum = 0.0, worst = 0.0, correlation = 0.0, plain_energy = 0.0;
+        int dither_ok = 1;
+
+        // A 0.4 LSB sine vanishes when truncated to 16 bits
+        for (int i = 0; i < 48000; i++) {
+            quiet[i] = (float)(0.4 / 32767.0 * sin(2.0 * M_PI * 1000.0 * i / 48000.0));
+        }
+        sine_format_convert(quiet, 48000, plain, 1, SINE_FORMAT_I16);
+        sine_dither_init(&dither, 12345);
+        sine_format_convert_dither(quiet, 48000, dithered, 1, SINE_FORMAT_I16, &dither);
+        for (int i = 0; i < 48000; i++) {
+            double exact = quiet[i] * 32767.0;
+            double e = dithered[i] - exact;
+            err_sum += e;
+            if (fabs(e) > worst) {
+                worst = fabs(e);
+            }
+            correlation += dithered[i] * sin(2.0 * M_PI * 1000.0 * i / 48000.0);
+            plain_energy += (double)plain[i] * plain[i];
+        }
+        // Amplitude recovered by correlation: 2/N * sum(y * s)
+        correlation = 2.0 * correlation / 48000.0;
+        if (worst > 1.5 || fabs(err_sum / 48000.0) > 0.02 || plain_energy != 0.0 ||
+            fabs(correlation - 0.4) > 0.05) {
+            printf("  FAIL: Dither error %.2f LSB, mean %.3f, recovered %.3f LSB\n",
+                   worst, err_sum / 48000.0, correlation);
+            dither_ok = 0;
+        }
+
+        // Same seed, same output; full scale still saturates
+        {
+            int16_t again[48000];
+            float loud[16];
+            int16_t loud_out[16];
+            sine_dither_init(&dither, 12345);
+            sine_format_convert_dither(quiet, 48000, again, 1, SINE_FORMAT_I16, &dither);
+            for (int i = 0; i < 16; i++) {
+                loud[i] = i & 1 ? -2.0f : 1.0f;
+            }
+            sine_format_convert_dither(loud, 16, loud_out, 1, SINE_FORMAT_I16, &dither);
+            dither_ok = dither_ok && memcmp(again, dithered, sizeof(again)) == 0;
+            for (int i = 0; i < 16; i++) {
+                dither_ok = dither_ok && (i & 1 ? loud_out[i] <= -32766 : loud_out[i] >= 32766);
+            }
+        }
+        if (dither_ok) {
+            printf("  PASS: TPDF dither within %.2f LSB, keeps a 0.4 LSB tone (%.3f)\n",
+                   worst, correlation);
+        } else {
+            printf("  FAIL: Dither not deterministic or not saturating\n");
+            passed = 0;
+        }
+    }
+
+    // Test accuracy of every supported kernel against sin()
+    {
+        static const double rates[] = { 44100.0, 48000.0, 192000.0 };
+        static const double freqs[] = { 1.0, 440.0, 997.0, 12345.6, 20000.0 };
+        sine_kernel_t default_kernel = sine_generator_active_kernel();
+
+        printf("  Default kernel: %s\n", sine_generator_kernel_name(default_kernel));
+        for (int k = SINE_KERNEL_SCALAR; k <= SINE_KERNEL_NEON; k++) {
+            double worst = 0.0;
+
+            if (sine_generator_select_kernel((sine_kernel_t)k) != 0) {
+                printf("  SKIP: %s kernel not supported\n",
+                       sine_generator_kernel_name((sine_kernel_t)k));
+                continue;
+            }
+            for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+                for (size_t f = 0; f < sizeof(freqs) / sizeof(freqs[0]); f++) {
+                    double error = measure_max_error(freqs[f], rates[r]);
+                    if (error > worst) {
+                        worst = error;
+                    }
+                }
+            }
+            if (worst > SINE_GENERATOR_MAX_ERROR) {
+                printf("  FAIL: %s kernel max error %.3g exceeds %.3g\n",
+                       sine_generator_kernel_name((sine_kernel_t)k), worst,
+                       SINE_GENERATOR_MAX_ERROR);
+                passed = 0;
+            } else {
+                printf("  PASS: %s kernel max error %.3g (bound %.3g)\n",
+                       sine_generator_kernel_name((sine_kernel_t)k), worst,
+                       SINE_GENERATOR_MAX_ERROR);
+            }
+        }
+        sine_generator_select_kernel(SINE_KERNEL_AUTO);
+    }
+
     printf("\n");
     if (passed) {
         printf("All tests PASSED\n");
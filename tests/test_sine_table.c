@@ -0,0 +1,288 @@
+/**
+ * Test for the Cached-Period Wavetable Player
+ *
+ * Checks period detection, that cached playback matches the generator
+ * across cache wraps and odd call sizes in interleaved and planar layouts,
+ * that per-channel wavetables loop sample-exact, that ratios without a
+ * short period fall back to interpolation within its error bound, and
+ * that the phase hands back to a generator.
+ */
+
+#include "sine_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_FRAMES 48000
+#define TEST_CHANNELS 2
+#define TEST_WAVE_FRAMES 64
+
+static float output[TEST_FRAMES * TEST_CHANNELS];
+static float reference[TEST_FRAMES * TEST_CHANNELS];
+static int32_t output_i[TEST_CHANNELS][TEST_FRAMES];
+static int32_t reference_i[TEST_CHANNELS][TEST_FRAMES];
+
+/* Call sizes cycled through while rendering, to cross the cache end at odd offsets */
+static const size_t call_sizes[] = { 1, 7, 256, 1023, 4097, 480 };
+
+/* Render frames of an interleaved layout in uneven calls */
+static void render_interleaved(sine_table_t *table, uint8_t *out, size_t frame_bytes,
+                               size_t frames)
+{
+    size_t done = 0;
+
+    for (size_t i = 0; done < frames; i++) {
+        size_t n = call_sizes[i % (sizeof(call_sizes) / sizeof(call_sizes[0]))];
+        void *dst = out + done * frame_bytes;
+
+        if (n > frames - done) {
+            n = frames - done;
+        }
+        sine_table_render(table, &dst, n);
+        done += n;
+    }
+}
+
+/* Render frames of a planar layout in uneven calls */
+static void render_planar(sine_table_t *table, void *const *planes, size_t sample_bytes,
+                          unsigned int channels, size_t frames)
+{
+    size_t done = 0;
+
+    for (size_t i = 0; done < frames; i++) {
+        size_t n = call_sizes[i % (sizeof(call_sizes) / sizeof(call_sizes[0]))];
+        void *dst[TEST_CHANNELS];
+
+        if (n > frames - done) {
+            n = frames - done;
+        }
+        for (unsigned int ch = 0; ch < channels; ch++) {
+            dst[ch] = (uint8_t *)planes[ch] + done * sample_bytes;
+        }
+        sine_table_render(table, dst, n);
+        done += n;
+    }
+}
+
+static double max_error(const float *a, const float *b, size_t n)
+{
+    double worst = 0.0;
+
+    for (size_t i = 0; i < n; i++) {
+        double d = fabs((double)a[i] - (double)b[i]);
+        if (d > worst) {
+            worst = d;
+        }
+    }
+    return worst;
+}
+
+/* Distance between two phases on the circle */
+static double phase_distance(double a, double b)
+{
+    double d = fmod(fabs(a - b), 2.0 * M_PI);
+    return d > M_PI ? 2.0 * M_PI - d : d;
+}
+
+int main(void)
+{
+    static sine_table_t table;
+    sine_writer_t writer;
+    int passed = 1;
+
+    printf("Testing cached-period wavetable player...\n");
+
+    // Period detection by rational reduction
+    {
+        size_t cycles = 0, cycles2 = 0, cycles3 = 0;
+        size_t p440 = sine_table_period(440.0, 48000.0, 1u << 20, &cycles);
+        size_t p1k = sine_table_period(1000.0, 44100.0, 1u << 20, &cycles2);
+        size_t p441 = sine_table_period(441.0, 48000.0, 1u << 20, &cycles3);
+        size_t irrational = sine_table_period(1000.0 * sqrt(2.0), 48000.0, 1u << 20, NULL);
+        size_t too_long = sine_table_period(440.0, 48000.0, 1000, NULL);
+
+        if (p440 != 1200 || cycles != 11 || p1k != 441 || cycles2 != 10 ||
+            p441 != 16000 || cycles3 != 147 || irrational != 0 || too_long != 0) {
+            printf("  FAIL: Periods %zu/%zu %zu/%zu %zu/%zu %zu %zu\n", cycles, p440,
+                   cycles2, p1k, cycles3, p441, irrational, too_long);
+            passed = 0;
+        } else {
+            printf("  PASS: 440 Hz repeats every 1200 frames, irrational ratios have no period\n");
+        }
+    }
+
+    // Cached sine, interleaved float: matches the generator through cache wraps
+    {
+        sine_generator_t gen;
+        double worst, phase_error;
+        int result;
+
+        sine_generator_init(&gen, 440.0, TEST_SAMPLE_RATE, 0.5);
+        gen.phase = 1.0;
+        sine_writer_init(&writer, SINE_FORMAT_F32, TEST_CHANNELS, 0);
+        result = sine_table_init_sine(&table, &writer, &gen);
+        render_interleaved(&table, (uint8_t *)output, writer.frame_bytes, TEST_FRAMES);
+        sine_generator_write_interleaved(&gen, reference, TEST_FRAMES, TEST_CHANNELS,
+                                         SINE_FORMAT_F32);
+        worst = max_error(output, reference, TEST_FRAMES * TEST_CHANNELS);
+        phase_error = phase_distance(sine_table_phase(&table), gen.phase);
+        if (result != VCARD_SUCCESS || table.mode != SINE_TABLE_CACHED ||
+            table.cache_frames % 1200 != 0 || table.cache_frames < SINE_TABLE_MIN_FRAMES ||
+            ((uintptr_t)table.cache[0] & 63) != 0 ||
+            worst > 2.0 * SINE_GENERATOR_MAX_ERROR || phase_error > 1e-9) {
+            printf("  FAIL: Cached sine differs by %g (phase %g, %zu frames)\n",
+                   worst, phase_error, table.cache_frames);
+            passed = 0;
+        } else {
+            printf("  PASS: Cached sine matches the generator (%g, %zu cached frames)\n",
+                   worst, table.cache_frames);
+        }
+        sine_table_free(&table);
+    }
+
+    // Cached sine, planar i24-in-32: within one LSB of the generator's writer
+    {
+        sine_generator_t gen;
+        void *planes[TEST_CHANNELS] = { output_i[0], output_i[1] };
+        void *ref_planes[TEST_CHANNELS] = { reference_i[0], reference_i[1] };
+        int32_t worst = 0;
+        int result;
+
+        sine_generator_init(&gen, 1000.0, 44100.0, 0.8);
+        sine_writer_init(&writer, SINE_FORMAT_I24_32, TEST_CHANNELS, 1);
+        result = sine_table_init_sine(&table, &writer, &gen);
+        render_planar(&table, planes, writer.frame_bytes, TEST_CHANNELS, TEST_FRAMES);
+        sine_generator_write_planar(&gen, ref_planes, TEST_FRAMES, TEST_CHANNELS,
+                                    SINE_FORMAT_I24_32);
+        for (unsigned int ch = 0; ch < TEST_CHANNELS; ch++) {
+            for (size_t i = 0; i < TEST_FRAMES; i++) {
+                int32_t d = abs(output_i[ch][i] - reference_i[ch][i]);
+                if (d > worst) {
+                    worst = d;
+                }
+            }
+        }
+        if (result != VCARD_SUCCESS || table.mode != SINE_TABLE_CACHED || worst > 1) {
+            printf("  FAIL: Planar cached sine differs by %d LSB\n", (int)worst);
+            passed = 0;
+        } else {
+            printf("  PASS: Planar cached sine within %d LSB of the generator\n", (int)worst);
+        }
+        sine_table_free(&table);
+    }
+
+    // Per-channel wavetables loop sample-exact when a cycle is whole frames
+    {
+        static float square[TEST_WAVE_FRAMES], saw[TEST_WAVE_FRAMES];
+        const float *waves[TEST_CHANNELS] = { square, saw };
+        void *planes[TEST_CHANNELS] = { output_i[0], output_i[1] };
+        int exact_interleaved = 1, exact_planar = 1;
+        int result, result2;
+
+        for (size_t i = 0; i < TEST_WAVE_FRAMES; i++) {
+            square[i] = i < TEST_WAVE_FRAMES / 2 ? 1.0f : -1.0f;
+            saw[i] = (float)i / TEST_WAVE_FRAMES * 2.0f - 1.0f;
+        }
+        sine_writer_init(&writer, SINE_FORMAT_F32, TEST_CHANNELS, 0);
+        result = sine_table_init_wave(&table, &writer, waves, TEST_CHANNELS, TEST_WAVE_FRAMES,
+                                      TEST_SAMPLE_RATE / TEST_WAVE_FRAMES, TEST_SAMPLE_RATE, 0.5);
+        render_interleaved(&table, (uint8_t *)output, writer.frame_bytes, TEST_FRAMES);
+        for (size_t i = 0; i < TEST_FRAMES; i++) {
+            if (output[i * 2] != 0.5f * square[i % TEST_WAVE_FRAMES] ||
+                output[i * 2 + 1] != 0.5f * saw[i % TEST_WAVE_FRAMES]) {
+                exact_interleaved = 0;
+            }
+        }
+        sine_table_free(&table);
+
+        sine_writer_init(&writer, SINE_FORMAT_I32, TEST_CHANNELS, 1);
+        result2 = sine_table_init_wave(&table, &writer, waves, TEST_CHANNELS, TEST_WAVE_FRAMES,
+                                       TEST_SAMPLE_RATE / TEST_WAVE_FRAMES, TEST_SAMPLE_RATE, 0.5);
+        render_planar(&table, planes, writer.frame_bytes, TEST_CHANNELS, TEST_FRAMES);
+        for (size_t i = 0; i < TEST_FRAMES; i++) {
+            float expect[TEST_CHANNELS] = { 0.5f * square[i % TEST_WAVE_FRAMES],
+                                            0.5f * saw[i % TEST_WAVE_FRAMES] };
+            for (unsigned int ch = 0; ch < TEST_CHANNELS; ch++) {
+                int32_t converted;
+                void *dst = &converted;
+                sine_writer_t mono;
+
+                sine_writer_init(&mono, SINE_FORMAT_I32, 1, 0);
+                sine_writer_convert(&mono, &expect[ch], 1, &dst, NULL);
+                if (output_i[ch][i] != converted) {
+                    exact_planar = 0;
+                }
+            }
+        }
+        if (result != VCARD_SUCCESS || result2 != VCARD_SUCCESS ||
+            table.mode != SINE_TABLE_CACHED || !exact_interleaved || !exact_planar) {
+            printf("  FAIL: Per-channel wavetables (interleaved %d, planar %d)\n",
+                   exact_interleaved, exact_planar);
+            passed = 0;
+        } else {
+            printf("  PASS: Per-channel wavetables loop sample-exact\n");
+        }
+        sine_table_free(&table);
+    }
+
+    // Irrational ratio: interpolated lookup within its error bound
+    {
+        sine_generator_t gen;
+        double worst, phase_error;
+        int result;
+
+        sine_generator_init(&gen, 1000.0 * sqrt(2.0), TEST_SAMPLE_RATE, 1.0);
+        gen.phase = 2.5;
+        sine_writer_init(&writer, SINE_FORMAT_F32, TEST_CHANNELS, 0);
+        result = sine_table_init_sine(&table, &writer, &gen);
+        render_interleaved(&table, (uint8_t *)output, writer.frame_bytes, TEST_FRAMES);
+        sine_generator_write_interleaved(&gen, reference, TEST_FRAMES, TEST_CHANNELS,
+                                         SINE_FORMAT_F32);
+        worst = max_error(output, reference, TEST_FRAMES * TEST_CHANNELS);
+        phase_error = phase_distance(sine_table_phase(&table), gen.phase);
+        if (result != VCARD_SUCCESS || table.mode != SINE_TABLE_INTERPOLATED ||
+            worst > 3e-7 + 2.0 * SINE_GENERATOR_MAX_ERROR || phase_error > 1e-6) {
+            printf("  FAIL: Interpolated sine differs by %g (phase %g)\n", worst, phase_error);
+            passed = 0;
+        } else {
+            printf("  PASS: Interpolated fallback within %g of the generator\n", worst);
+        }
+        sine_table_free(&table);
+    }
+
+    // Invalid setups are rejected and leave the player empty
+    {
+        sine_generator_t gen;
+        sine_writer_t none;
+        const float *missing[1] = { NULL };
+
+        memset(&none, 0, sizeof(none));
+        sine_generator_init(&gen, 0.0, TEST_SAMPLE_RATE, 0.5);
+        sine_writer_init(&writer, SINE_FORMAT_I16, 1, 0);
+        if (sine_table_init_sine(&table, &writer, &gen) != VCARD_ERROR_INVALID ||
+            table.mode != SINE_TABLE_NONE ||
+            sine_table_init_sine(&table, &none, &gen) != VCARD_ERROR_INVALID ||
+            sine_table_init_wave(&table, &writer, missing, 1, 64, 100.0,
+                                 TEST_SAMPLE_RATE, 1.0) != VCARD_ERROR_INVALID) {
+            printf("  FAIL: Invalid setups accepted\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Invalid setups rejected\n");
+        }
+    }
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
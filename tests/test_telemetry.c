@@ -0,0 +1,244 @@
+/**
+ * Test for Device Telemetry
+ *
+ * Checks the relaxed-atomic telemetry counters, the backend reporting
+ * hooks as seen through vcard_get_status, and periodic delivery of status
+ * snapshots from the status thread.
+ */
+
+#include "vcard.h"
+#include "vcard_telemetry.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TEST_SAMPLE_RATE 48000
+#define TEST_PERIOD 480                  /* 10 ms at 48 kHz */
+#define TEST_PERIODS 100000
+#define TEST_XRUN_THREADS 4
+#define TEST_XRUNS_PER_THREAD 10000
+#define TEST_INTERVAL_MS 20
+#define TEST_RUN_MS 400
+
+typedef struct {
+    vcard_telemetry_t *telemetry;
+    int device_id;
+} telemetry_context_t;
+
+typedef struct {
+    vcard_atomic_u32 calls;
+    vcard_atomic_u32 bad;
+    uint32_t last_xruns;
+} status_context_t;
+
+static void audio_thread(void *arg)
+{
+    telemetry_context_t *ctx = (telemetry_context_t *)arg;
+
+    for (int i = 0; i < TEST_PERIODS; i++) {
+        // 2.5 ms of a 10 ms period: 25% load
+        vcard_telemetry_period(ctx->telemetry, TEST_PERIOD, TEST_SAMPLE_RATE, 2500000);
+    }
+}
+
+static void xrun_thread(void *arg)
+{
+    telemetry_context_t *ctx = (telemetry_context_t *)arg;
+
+    for (int i = 0; i < TEST_XRUNS_PER_THREAD; i++) {
+        vcard_telemetry_xrun(ctx->telemetry);
+    }
+}
+
+static void status_callback(int device_id, const vcard_status_t *status,
+                            void *user_data)
+{
+    status_context_t *ctx = (status_context_t *)user_data;
+
+    (void)device_id;
+    if (!status->is_active || status->xruns < ctx->last_xruns) {
+        vcard_atomic_fetch_add_u32(&ctx->bad, 1);
+    }
+    ctx->last_xruns = status->xruns;
+    vcard_atomic_fetch_add_u32(&ctx->calls, 1);
+}
+
+int main(void)
+{
+    vcard_telemetry_t telemetry;
+    vcard_config_t config;
+    vcard_status_t status;
+    int device_id = -1;
+    int result;
+    int passed = 1;
+
+    printf("Testing device telemetry...\n");
+
+    // Counters updated concurrently from an audio thread and xrun reporters
+    {
+        telemetry_context_t ctx = { &telemetry, -1 };
+        vcard_thread_t audio, xruns[TEST_XRUN_THREADS];
+        int started = 1;
+
+        vcard_telemetry_init(&telemetry);
+        started &= vcard_thread_create(&audio, audio_thread, &ctx) == VCARD_SUCCESS;
+        for (int i = 0; i < TEST_XRUN_THREADS; i++) {
+            started &= vcard_thread_create(&xruns[i], xrun_thread, &ctx) == VCARD_SUCCESS;
+        }
+        if (!started) {
+            printf("  FAIL: Could not start threads\n");
+            return 1;
+        }
+        // Snapshots while the writers run must never go backwards
+        uint64_t last_frames = 0;
+        uint32_t last_xruns = 0;
+        int monotonic = 1;
+        for (int i = 0; i < 1000; i++) {
+            memset(&status, 0, sizeof(status));
+            vcard_telemetry_snapshot(&telemetry, &status);
+            monotonic &= status.frames_processed >= last_frames && status.xruns >= last_xruns;
+            last_frames = status.frames_processed;
+            last_xruns = status.xruns;
+        }
+        vcard_thread_join(&audio);
+        for (int i = 0; i < TEST_XRUN_THREADS; i++) {
+            vcard_thread_join(&xruns[i]);
+        }
+
+        vcard_telemetry_snapshot(&telemetry, &status);
+        if (!monotonic ||
+            status.frames_processed != (uint64_t)TEST_PERIODS * TEST_PERIOD ||
+            status.xruns != TEST_XRUN_THREADS * TEST_XRUNS_PER_THREAD) {
+            printf("  FAIL: Counters (frames %llu, xruns %u)\n",
+                   (unsigned long long)status.frames_processed, status.xruns);
+            passed = 0;
+        } else {
+            printf("  PASS: %u xruns from %d threads, frames counted exactly\n",
+                   status.xruns, TEST_XRUN_THREADS);
+        }
+        if (fabsf(status.cpu_load - 25.0f) > 0.01f) {
+            printf("  FAIL: CPU load %.3f%%, expected 25%%\n", status.cpu_load);
+            passed = 0;
+        } else {
+            printf("  PASS: CPU load converges to busy / period (%.2f%%)\n",
+                   status.cpu_load);
+        }
+    }
+
+    vcard_init();
+
+    memset(&config, 0, sizeof(config));
+    strncpy(config.name, "Telemetry Test", VCARD_MAX_DEVICE_NAME - 1);
+    config.channels_in = 2;
+    config.channels_out = 2;
+    config.sample_rate = TEST_SAMPLE_RATE;
+    config.buffer_size = TEST_PERIOD;
+    config.bit_depth = VCARD_BIT_24;
+    result = vcard_create_device(&config, &device_id);
+    if (result != VCARD_SUCCESS) {
+        printf("  FAIL: Device creation failed with error %d\n", result);
+        return 1;
+    }
+
+    // Backend hooks show up in the device status
+    {
+        float silence[TEST_PERIOD];
+        const float *buffers[2] = { silence, silence };
+        size_t written = 0;
+        int ok = 1;
+
+        memset(silence, 0, sizeof(silence));
+        ok &= vcard_write_audio(device_id, buffers, TEST_PERIOD, &written) == VCARD_SUCCESS;
+        ok &= vcard_report_latency(device_id, 3000) == VCARD_SUCCESS;
+        ok &= vcard_report_xrun(device_id) == VCARD_SUCCESS;
+        ok &= vcard_report_xrun(device_id) == VCARD_SUCCESS;
+        for (int i = 0; i < 1000; i++) {
+            ok &= vcard_report_period(device_id, TEST_PERIOD, 5000000) == VCARD_SUCCESS;
+        }
+        ok &= vcard_get_status(device_id, &status) == VCARD_SUCCESS;
+        ok &= vcard_report_xrun(VCARD_MAX_DEVICES) == VCARD_ERROR_NOT_FOUND;
+
+        // 480 queued frames are another 10 ms on top of the backend's 3 ms
+        if (!ok || status.xruns != 2 || status.latency_us != 13000 ||
+            fabsf(status.cpu_load - 50.0f) > 0.01f) {
+            printf("  FAIL: Reported telemetry (xruns %u, latency %u us, load %.2f%%)\n",
+                   status.xruns, status.latency_us, status.cpu_load);
+            passed = 0;
+        } else {
+            printf("  PASS: Reported xruns, latency and load in device status\n");
+        }
+    }
+
+    // Snapshots delivered at the configured interval from the status thread
+    {
+        static status_context_t ctx;
+        uint32_t calls, after;
+        uint64_t start, elapsed_ms;
+
+        vcard_atomic_store_relaxed_u32(&ctx.calls, 0);
+        vcard_atomic_store_relaxed_u32(&ctx.bad, 0);
+        if (vcard_set_status_interval(device_id, 1) != VCARD_ERROR_INVALID ||
+            vcard_set_status_interval(device_id, TEST_INTERVAL_MS) != VCARD_SUCCESS ||
+            vcard_set_status_callback(device_id, status_callback, &ctx) != VCARD_SUCCESS) {
+            printf("  FAIL: Status callback setup\n");
+            return 1;
+        }
+        start = vcard_time_ns();
+        for (int i = 0; i < TEST_RUN_MS; i++) {
+            if (i % 10 == 0) {
+                vcard_report_xrun(device_id);
+            }
+            vcard_sleep_us(1000);
+        }
+        vcard_set_status_callback(device_id, NULL, NULL);
+        elapsed_ms = (vcard_time_ns() - start) / 1000000u;
+        calls = vcard_atomic_load_relaxed_u32(&ctx.calls);
+        vcard_sleep_us(3 * TEST_INTERVAL_MS * 1000);
+        after = vcard_atomic_load_relaxed_u32(&ctx.calls);
+
+        // Generous bounds: the test may be descheduled on a loaded machine
+        if (calls < TEST_RUN_MS / TEST_INTERVAL_MS / 4 ||
+            calls > elapsed_ms / TEST_INTERVAL_MS + 1 ||
+            vcard_atomic_load_relaxed_u32(&ctx.bad) != 0) {
+            printf("  FAIL: %u status callbacks in %llu ms at %d ms interval\n",
+                   calls, (unsigned long long)elapsed_ms, TEST_INTERVAL_MS);
+            passed = 0;
+        } else if (after != calls) {
+            printf("  FAIL: Callback ran after being unregistered\n");
+            passed = 0;
+        } else {
+            printf("  PASS: %u status callbacks in %llu ms at %d ms interval\n",
+                   calls, (unsigned long long)elapsed_ms, TEST_INTERVAL_MS);
+        }
+    }
+
+    // Destroying a device with a registered callback is safe
+    {
+        static status_context_t ctx;
+
+        vcard_set_status_interval(device_id, 10);
+        vcard_set_status_callback(device_id, status_callback, &ctx);
+        vcard_sleep_us(50000);
+        if (vcard_destroy_device(device_id) != VCARD_SUCCESS ||
+            vcard_set_status_callback(device_id, status_callback, &ctx) !=
+                VCARD_ERROR_NOT_FOUND) {
+            printf("  FAIL: Destroy with status callback registered\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Device destroyed with status callback registered\n");
+        }
+    }
+
+    vcard_cleanup();
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,228 @@
+/**
+ * Test for the Multi-Stream Tone Engine
+ *
+ * Checks tone parsing and each waveform, that streams rendered on a worker
+ * pool are bit-identical to rendering them on one thread, and feeds a full
+ * set of devices from one engine.
+ */
+
+#include "tone_engine.h"
+#include "vcard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TEST_SAMPLE_RATE 48000.0
+#define TEST_CHANNELS 8
+#define TEST_MAX_FRAMES 512
+#define TEST_PASSES 200
+#define TEST_WORKERS 4
+
+/* Engines are large; keep them off the stack */
+static tone_engine_t serial_engine;
+static tone_engine_t pool_engine;
+
+/* Give every channel of every stream a different tone */
+static int configure_streams(tone_engine_t *engine)
+{
+    static const char *const tones[] = {
+        "sine:440", "square:100@0.25", "noise@0.1", "sweep:20-20000@0.5",
+        "sine:997@0.8", "square:1234", "noise", "sweep:1000-50"
+    };
+
+    for (int s = 0; s < TONE_ENGINE_MAX_STREAMS; s++) {
+        int stream_id;
+
+        if (tone_engine_add_stream(engine, TEST_CHANNELS, TEST_SAMPLE_RATE,
+                                   TEST_MAX_FRAMES, &stream_id) != VCARD_SUCCESS) {
+            return 0;
+        }
+        for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+            tone_params_t params;
+
+            if (tone_params_parse(tones[(s + ch) % 8], &params) != VCARD_SUCCESS) {
+                return 0;
+            }
+            params.frequency += s;
+            if (tone_engine_set_tone(engine, stream_id, ch, &params) != VCARD_SUCCESS) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int main(void)
+{
+    tone_params_t params;
+    tone_generator_t gen;
+    int passed = 1;
+
+    printf("Testing tone engine...\n");
+
+    // Tone descriptions
+    {
+        int ok = 1;
+
+        ok &= tone_params_parse("sine:440", &params) == VCARD_SUCCESS &&
+              params.waveform == TONE_WAVE_SINE && params.frequency == 440.0 &&
+              params.amplitude == 0.5;
+        ok &= tone_params_parse("sweep:20-20000@0.25", &params) == VCARD_SUCCESS &&
+              params.waveform == TONE_WAVE_SWEEP && params.frequency == 20.0 &&
+              params.frequency_end == 20000.0 && params.amplitude == 0.25;
+        ok &= tone_params_parse("noise@1", &params) == VCARD_SUCCESS &&
+              params.waveform == TONE_WAVE_NOISE && params.amplitude == 1.0;
+        ok &= tone_params_parse("square:-5", &params) == VCARD_ERROR_INVALID;
+        ok &= tone_params_parse("sweep:20", &params) == VCARD_ERROR_INVALID;
+        ok &= tone_params_parse("sine:440@2", &params) == VCARD_ERROR_INVALID;
+        ok &= tone_params_parse("sine:440x", &params) == VCARD_ERROR_INVALID;
+        ok &= tone_params_parse("triangle:440", &params) == VCARD_ERROR_INVALID;
+        tone_params_parse("sine:30000", &params);
+        ok &= tone_generator_init(&gen, &params, TEST_SAMPLE_RATE) == VCARD_ERROR_INVALID;
+
+        if (!ok) {
+            printf("  FAIL: Tone descriptions\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Tone descriptions parsed and validated\n");
+        }
+    }
+
+    // Waveform shapes
+    {
+        float buffer[4800];
+        int ok = 1;
+
+        // 375 Hz square at 48 kHz (exact phase steps): 64 samples high, 64 low
+        tone_params_parse("square:375@0.25", &params);
+        tone_generator_init(&gen, &params, TEST_SAMPLE_RATE);
+        tone_generator_render(&gen, buffer, 4800);
+        for (int i = 0; i < 4800; i++) {
+            ok &= buffer[i] == ((i % 128) < 64 ? 0.25f : -0.25f);
+        }
+
+        // Noise stays within the amplitude and averages out
+        double sum = 0.0;
+        tone_params_parse("noise@0.5", &params);
+        tone_generator_init(&gen, &params, TEST_SAMPLE_RATE);
+        tone_generator_render(&gen, buffer, 4800);
+        for (int i = 0; i < 4800; i++) {
+            ok &= fabsf(buffer[i]) <= 0.5f;
+            sum += buffer[i];
+        }
+        ok &= fabs(sum / 4800.0) < 0.02;
+
+        // A 0.05 s sweep restarts at its start frequency after 2400 samples
+        tone_params_parse("sweep:100-10000", &params);
+        params.sweep_seconds = 0.05;
+        tone_generator_init(&gen, &params, TEST_SAMPLE_RATE);
+        tone_generator_render(&gen, buffer, 2400);
+        ok &= gen.sweep_pos == 0 && gen.sweep_freq == 100.0;
+        tone_generator_render(&gen, buffer, 1200);
+        ok &= fabs(gen.sweep_freq - 1000.0) < 1.0;
+
+        if (!ok) {
+            printf("  FAIL: Waveform shapes\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Square period, noise range and sweep restart\n");
+        }
+    }
+
+    // Worker pool output is bit-identical to single-threaded rendering
+    {
+        int ok = tone_engine_init(&serial_engine, 0, 0) == VCARD_SUCCESS &&
+                 tone_engine_init(&pool_engine, TEST_WORKERS, 1) == VCARD_SUCCESS &&
+                 configure_streams(&serial_engine) && configure_streams(&pool_engine);
+        int mismatches = 0;
+
+        if (!ok) {
+            printf("  FAIL: Engine setup\n");
+            return 1;
+        }
+        for (int pass = 0; pass < TEST_PASSES; pass++) {
+            uint32_t frames = 1 + (uint32_t)(pass * 97) % TEST_MAX_FRAMES;
+
+            tone_engine_render(&serial_engine, frames);
+            tone_engine_render(&pool_engine, frames);
+            for (int s = 0; s < TONE_ENGINE_MAX_STREAMS; s++) {
+                const float *const *a = tone_engine_output(&serial_engine, s);
+                const float *const *b = tone_engine_output(&pool_engine, s);
+                for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+                    mismatches += memcmp(a[ch], b[ch], frames * sizeof(float)) != 0;
+                }
+            }
+        }
+        ok &= tone_engine_render(&pool_engine, TEST_MAX_FRAMES + 1) == VCARD_ERROR_INVALID;
+        ok &= tone_engine_output(&pool_engine, TONE_ENGINE_MAX_STREAMS) == NULL;
+
+        if (!ok || mismatches != 0) {
+            printf("  FAIL: %d stream blocks differ between 0 and %d workers\n",
+                   mismatches, TEST_WORKERS);
+            passed = 0;
+        } else {
+            printf("  PASS: %d streams x %d passes identical with %d pinned workers\n",
+                   TONE_ENGINE_MAX_STREAMS, TEST_PASSES, TEST_WORKERS);
+        }
+        tone_engine_destroy(&serial_engine);
+    }
+
+    // One engine feeds every device of the in-process engine
+    {
+        int device_ids[VCARD_MAX_DEVICES];
+        float readback[TEST_CHANNELS][256];
+        float *read_planes[TEST_CHANNELS];
+        int ok = 1;
+
+        for (int ch = 0; ch < TEST_CHANNELS; ch++) {
+            read_planes[ch] = readback[ch];
+        }
+        vcard_init();
+        for (int d = 0; d < VCARD_MAX_DEVICES && ok; d++) {
+            vcard_config_t config;
+
+            memset(&config, 0, sizeof(config));
+            snprintf(config.name, sizeof(config.name), "Tone %d", d);
+            config.channels_in = TEST_CHANNELS;
+            config.channels_out = TEST_CHANNELS;
+            config.sample_rate = (uint32_t)TEST_SAMPLE_RATE;
+            config.buffer_size = 256;
+            config.bit_depth = VCARD_BIT_32;
+            ok &= vcard_create_device(&config, &device_ids[d]) == VCARD_SUCCESS;
+        }
+
+        ok &= tone_engine_render(&pool_engine, 256) == VCARD_SUCCESS;
+        for (int d = 0; d < VCARD_MAX_DEVICES && ok; d++) {
+            const float *const *planes = tone_engine_output(&pool_engine, d);
+            size_t done = 0;
+
+            ok &= vcard_write_audio(device_ids[d], planes, 256, &done) == VCARD_SUCCESS &&
+                  done == 256;
+            ok &= vcard_read_audio(device_ids[d], read_planes, 256, &done) == VCARD_SUCCESS &&
+                  done == 256;
+            for (int ch = 0; ch < TEST_CHANNELS && ok; ch++) {
+                ok &= memcmp(readback[ch], planes[ch], sizeof(readback[ch])) == 0;
+            }
+        }
+        vcard_cleanup();
+
+        if (!ok) {
+            printf("  FAIL: Feeding %d devices\n", VCARD_MAX_DEVICES);
+            passed = 0;
+        } else {
+            printf("  PASS: %d devices fed from one engine\n", VCARD_MAX_DEVICES);
+        }
+    }
+
+    tone_engine_destroy(&pool_engine);
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,228 @@
+/**
+ * Test for the Period Trace
+ *
+ * Records from several threads into a trace file and checks the file is
+ * complete JSON with every event in it, that rings are reused by later
+ * threads, that nothing is recorded while no trace runs, and what a trace
+ * point costs with and without a trace.
+ */
+
+#define VCARD_TRACE 1
+#include "vcard_trace.h"
+#include "vcard.h"
+#include "vcard_thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_THREADS 3
+#define TEST_EVENTS 20000            /* Per thread, several times a ring */
+#define TEST_FLUSH_EVENTS 1000       /* Recorded between flushes, under a ring */
+#define TEST_LIFETIMES (VCARD_TRACE_MAX_THREADS * 3)
+#define TEST_LIFETIME_EVENTS 100
+#define TEST_TIMING_EVENTS 1000000
+#define TEST_FILE "test_trace.json"
+
+typedef struct {
+    uint32_t index;
+} recorder_t;
+
+static void recorder_main(void *arg)
+{
+    recorder_t *r = (recorder_t *)arg;
+
+    for (uint32_t i = 0; i < TEST_EVENTS; i++) {
+        VCARD_TRACE_BEGIN(trace);
+        VCARD_TRACE_END(trace, "test.period", 256, 256, r->index * 1000 + i % 1000);
+        // Drain before the ring can fill, whatever the dumper's timing
+        if (i % TEST_FLUSH_EVENTS == TEST_FLUSH_EVENTS - 1) {
+            vcard_trace_flush();
+        }
+    }
+}
+
+static void short_lived_main(void *arg)
+{
+    (void)arg;
+    for (uint32_t i = 0; i < TEST_LIFETIME_EVENTS; i++) {
+        VCARD_TRACE_BEGIN(trace);
+        VCARD_TRACE_END(trace, "test.lifetime", 256, 256, i);
+    }
+}
+
+/* Count occurrences of a string in a file */
+static long count_in_file(const char *path, const char *needle, int *closed)
+{
+    FILE *f = fopen(path, "rb");
+    char *text;
+    long size, count = 0;
+    const char *p;
+
+    if (!f) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    text = (char *)malloc((size_t)size + 1);
+    if (!text || fread(text, 1, (size_t)size, f) != (size_t)size) {
+        free(text);
+        fclose(f);
+        return -1;
+    }
+    text[size] = '\0';
+    fclose(f);
+
+    for (p = strstr(text, needle); p; p = strstr(p + 1, needle)) {
+        count++;
+    }
+    *closed = size >= 4 && strcmp(text + size - 4, "\n]}\n") == 0 && text[0] == '{';
+    free(text);
+    return count;
+}
+
+/* Average cost of one trace point, in ns */
+static double time_trace_point(void)
+{
+    uint64_t start = vcard_time_ns();
+
+    for (uint32_t i = 0; i < TEST_TIMING_EVENTS; i++) {
+        VCARD_TRACE_BEGIN(trace);
+        VCARD_TRACE_END(trace, "test.timing", 256, 256, i);
+    }
+    return (double)(vcard_time_ns() - start) / TEST_TIMING_EVENTS;
+}
+
+int main(void)
+{
+    vcard_trace_stats_t stats;
+    int passed = 1;
+
+    printf("Testing period trace...\n");
+
+    // No trace running: trace points record nothing
+    {
+        double idle_ns = time_trace_point();
+
+        if (vcard_trace_start("/nonexistent-dir/trace.json") != VCARD_ERROR_IO) {
+            printf("  FAIL: Unwritable trace file accepted\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Idle trace point costs %.1f ns; bad path rejected\n", idle_ns);
+        }
+    }
+
+    if (vcard_trace_start(TEST_FILE) != VCARD_SUCCESS) {
+        printf("  FAIL: Could not start a trace\n");
+        return 1;
+    }
+    if (vcard_trace_start(TEST_FILE) != VCARD_ERROR_IN_USE) {
+        printf("  FAIL: Second trace allowed while one runs\n");
+        passed = 0;
+    } else {
+        printf("  PASS: Second trace refused\n");
+    }
+
+    // Several recording threads, each on its own ring
+    {
+        vcard_thread_t threads[TEST_THREADS];
+        recorder_t recorders[TEST_THREADS];
+        int closed = 0;
+        long periods;
+
+        for (uint32_t t = 0; t < TEST_THREADS; t++) {
+            recorders[t].index = t;
+            vcard_thread_create(&threads[t], recorder_main, &recorders[t]);
+        }
+        for (int t = 0; t < TEST_THREADS; t++) {
+            vcard_thread_join(&threads[t]);
+        }
+        vcard_trace_stop(&stats);
+
+        periods = count_in_file(TEST_FILE, "\"name\":\"test.period\",\"ph\":\"X\"", &closed);
+        if (stats.events != (uint64_t)TEST_THREADS * TEST_EVENTS || stats.dropped != 0 ||
+            stats.threads != TEST_THREADS || periods != (long)stats.events || !closed) {
+            printf("  FAIL: %llu events, %llu dropped, %u threads, %ld in file, closed %d\n",
+                   (unsigned long long)stats.events, (unsigned long long)stats.dropped,
+                   stats.threads, periods, closed);
+            passed = 0;
+        } else {
+            printf("  PASS: %ld events from %u threads written, none dropped\n",
+                   periods, stats.threads);
+        }
+    }
+
+    // More thread lifetimes than rings, one after another, all recorded
+    {
+        int closed = 0;
+        long periods;
+
+        vcard_trace_start(TEST_FILE);
+        for (int t = 0; t < TEST_LIFETIMES; t++) {
+            vcard_thread_t thread;
+
+            vcard_thread_create(&thread, short_lived_main, NULL);
+            vcard_thread_join(&thread);
+            // The next lifetime appends to the same ring; keep it from filling
+            vcard_trace_flush();
+        }
+        vcard_trace_stop(&stats);
+
+        periods = count_in_file(TEST_FILE, "\"name\":\"test.lifetime\",\"ph\":\"X\"", &closed);
+        if (stats.events != (uint64_t)TEST_LIFETIMES * TEST_LIFETIME_EVENTS ||
+            stats.dropped != 0 || stats.threads != TEST_LIFETIMES ||
+            periods != (long)stats.events || !closed) {
+            printf("  FAIL: %d thread lifetimes gave %llu events, %llu dropped, %u threads\n",
+                   TEST_LIFETIMES, (unsigned long long)stats.events,
+                   (unsigned long long)stats.dropped, stats.threads);
+            passed = 0;
+        } else {
+            printf("  PASS: %d thread lifetimes on %d rings, %ld events, none dropped\n",
+                   TEST_LIFETIMES, VCARD_TRACE_MAX_THREADS, periods);
+        }
+    }
+
+    // Cost while tracing; a burst larger than the ring drops instead of blocking
+    {
+        double active_ns;
+        int closed = 0;
+
+        vcard_trace_start(TEST_FILE);
+        active_ns = time_trace_point();
+        vcard_trace_stop(&stats);
+        if (stats.events + stats.dropped != TEST_TIMING_EVENTS ||
+            count_in_file(TEST_FILE, "\"name\":\"test.timing\",\"ph\":\"X\"", &closed) !=
+                (long)stats.events || !closed) {
+            printf("  FAIL: Burst of %d gave %llu events and %llu dropped\n",
+                   TEST_TIMING_EVENTS, (unsigned long long)stats.events,
+                   (unsigned long long)stats.dropped);
+            passed = 0;
+        } else {
+            printf("  PASS: Active trace point costs %.1f ns (%llu kept, %llu dropped)\n",
+                   active_ns, (unsigned long long)stats.events,
+                   (unsigned long long)stats.dropped);
+        }
+    }
+
+    // Stopped again: nothing recorded, nothing to stop
+    {
+        VCARD_TRACE_BEGIN(trace);
+        vcard_trace_stop(&stats);
+        if (trace != 0 || stats.events != 0) {
+            printf("  FAIL: Trace point active after stop\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Trace points inactive after stop\n");
+        }
+    }
+    remove(TEST_FILE);
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
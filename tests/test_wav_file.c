@@ -0,0 +1,306 @@
+/**
+ * Test for Streaming WAV/RF64/W64 Files
+ *
+ * Writes every container in every sample format in uneven chunks, reads the
+ * files back through stdio and through a memory mapping, and checks the
+ * header magic, the sample values, seeking, recovery of a file whose
+ * writer never finalized the sizes, and rejection of bad input.
+ */
+
+#include "wav_file.h"
+#include "vcard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TEST_FILE "test_wav_file.wav"
+#define TEST_RATE 48000
+#define TEST_CHANNELS 3
+#define TEST_FRAMES 5000        /* Several WAV_CHUNK_FRAMES, not a multiple */
+
+static float source[TEST_FRAMES * TEST_CHANNELS];
+static float readback[TEST_FRAMES * TEST_CHANNELS];
+
+/* Deterministic test signal in [-1, 1], with a few clipped samples */
+static float test_sample(size_t frame, uint32_t channel)
+{
+    if (frame == 7) {
+        return channel & 1 ? -1.5f : 1.5f;
+    }
+    return (float)sin(0.001 * (double)(frame + 1) * (channel + 1) * 37.0);
+}
+
+static double tolerance(sine_format_t format)
+{
+    switch (format) {
+    case SINE_FORMAT_I16: return 1.0 / 16384.0;
+    case SINE_FORMAT_I24: return 1.0 / 2097152.0;
+    case SINE_FORMAT_I32: return 1e-6;
+    default: return 0.0;
+    }
+}
+
+/* Largest difference between readback and the (clipped) source */
+static double max_error(size_t frames, sine_format_t format)
+{
+    double worst = 0.0;
+
+    for (size_t i = 0; i < frames * TEST_CHANNELS; i++) {
+        double expected = source[i];
+        if (format != SINE_FORMAT_F32) {
+            expected = expected > 1.0 ? 1.0 : (expected < -1.0 ? -1.0 : expected);
+        }
+        if (fabs(readback[i] - expected) > worst) {
+            worst = fabs(readback[i] - expected);
+        }
+    }
+    return worst;
+}
+
+/* Write TEST_FRAMES frames, alternating interleaved and planar chunks */
+static int write_file(sine_format_t format, wav_container_t container)
+{
+    static float plane_data[TEST_CHANNELS][TEST_FRAMES];
+    const float *planes[TEST_CHANNELS];
+    wav_writer_t w;
+    size_t done = 0;
+    int chunk = 0;
+
+    for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+        planes[ch] = plane_data[ch];
+    }
+    if (wav_writer_open(&w, TEST_FILE, TEST_CHANNELS, TEST_RATE, format, container) != 0) {
+        return -1;
+    }
+    while (done < TEST_FRAMES) {
+        size_t n = (size_t)(chunk % 2 ? 1500 : 333);
+        if (n > TEST_FRAMES - done) {
+            n = TEST_FRAMES - done;
+        }
+        if (chunk % 2) {
+            for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+                for (size_t i = 0; i < n; i++) {
+                    plane_data[ch][i] = source[(done + i) * TEST_CHANNELS + ch];
+                }
+            }
+            if (wav_writer_write_planar(&w, planes, n) != 0) {
+                wav_writer_close(&w);
+                return -1;
+            }
+        } else if (wav_writer_write_float(&w, source + done * TEST_CHANNELS, n) != 0) {
+            wav_writer_close(&w);
+            return -1;
+        }
+        done += n;
+        chunk++;
+    }
+    return wav_writer_close(&w);
+}
+
+static int check_magic(wav_container_t container)
+{
+    static const uint8_t w64_riff[4] = { 0x72, 0x69, 0x66, 0x66 };
+    uint8_t head[16];
+    FILE *fp = fopen(TEST_FILE, "rb");
+    size_t got;
+
+    if (!fp) {
+        return 0;
+    }
+    got = fread(head, 1, sizeof(head), fp);
+    fclose(fp);
+    if (got != sizeof(head)) {
+        return 0;
+    }
+    switch (container) {
+    case WAV_CONTAINER_AUTO:
+        return memcmp(head, "RIFF", 4) == 0 && memcmp(head + 12, "JUNK", 4) == 0;
+    case WAV_CONTAINER_RF64:
+        return memcmp(head, "RF64", 4) == 0 && memcmp(head + 12, "ds64", 4) == 0;
+    default:
+        return memcmp(head, w64_riff, 4) == 0 && head[4] == 0x2E;
+    }
+}
+
+/* Read the whole file in odd-sized chunks; returns frames read */
+static size_t read_file(wav_reader_t *r, int planar)
+{
+    static float plane_data[TEST_CHANNELS][TEST_FRAMES];
+    float *planes[TEST_CHANNELS];
+    size_t done = 0, n;
+
+    for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+        planes[ch] = plane_data[ch];
+    }
+    if (!planar) {
+        while ((n = wav_reader_read_float(r, readback + done * TEST_CHANNELS, 777)) > 0) {
+            done += n;
+        }
+        return done;
+    }
+    while (done < TEST_FRAMES) {
+        for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+            planes[ch] = plane_data[ch] + done;
+        }
+        n = wav_reader_read_planar(r, planes, 2049);
+        if (n == 0) {
+            break;
+        }
+        done += n;
+    }
+    for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+        for (size_t i = 0; i < done; i++) {
+            readback[i * TEST_CHANNELS + ch] = plane_data[ch][i];
+        }
+    }
+    return done;
+}
+
+int main(void)
+{
+    static const char *container_names[] = { "RIFF", "RF64", "W64" };
+    static const char *format_names[] = { "f32", "i16", "i24", "i32" };
+    static const sine_format_t formats[] = {
+        SINE_FORMAT_F32, SINE_FORMAT_I16, SINE_FORMAT_I24, SINE_FORMAT_I32
+    };
+    int passed = 1;
+
+    printf("Testing streaming WAV files...\n");
+
+    for (size_t i = 0; i < TEST_FRAMES; i++) {
+        for (uint32_t ch = 0; ch < TEST_CHANNELS; ch++) {
+            source[i * TEST_CHANNELS + ch] = test_sample(i, ch);
+        }
+    }
+
+    // Round trip of every container and format, via stdio and via mmap
+    for (int c = WAV_CONTAINER_AUTO; c <= WAV_CONTAINER_W64; c++) {
+        for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+            int ok = write_file(formats[f], (wav_container_t)c) == 0 &&
+                     check_magic((wav_container_t)c);
+
+            for (int mapped = 0; ok && mapped < 2; mapped++) {
+                wav_reader_t r;
+                size_t got;
+
+                if (wav_reader_open(&r, TEST_FILE, mapped ? WAV_READER_MMAP : 0) != 0) {
+                    ok = 0;
+                    break;
+                }
+                memset(readback, 0, sizeof(readback));
+                got = read_file(&r, mapped);
+                ok = r.channels == TEST_CHANNELS && r.sample_rate == TEST_RATE &&
+                     r.format == formats[f] && r.frames == TEST_FRAMES &&
+                     got == TEST_FRAMES && max_error(got, formats[f]) <= tolerance(formats[f]);
+                wav_reader_close(&r);
+            }
+            if (!ok) {
+                printf("  FAIL: %s %s round trip\n", container_names[c], format_names[f]);
+                passed = 0;
+            } else {
+                printf("  PASS: %s %s round trip\n", container_names[c], format_names[f]);
+            }
+        }
+    }
+
+    // Seeking, and raw frames identical between stdio and the mapping
+    {
+        wav_reader_t r, m;
+        int16_t raw[TEST_CHANNELS];
+        int ok = write_file(SINE_FORMAT_I16, WAV_CONTAINER_AUTO) == 0 &&
+                 wav_reader_open(&r, TEST_FILE, 0) == 0;
+
+        if (ok) {
+            ok = wav_reader_open(&m, TEST_FILE, WAV_READER_MMAP) == 0;
+            if (ok) {
+                const int16_t *mapped = (const int16_t *)wav_reader_mapped_data(&m);
+                ok = wav_reader_seek(&r, 4321) == 0 && wav_reader_read(&r, raw, 1) == 1 &&
+                     (!mapped || memcmp(raw, mapped + 4321 * TEST_CHANNELS, sizeof(raw)) == 0) &&
+                     wav_reader_seek(&r, TEST_FRAMES) == 0 &&
+                     wav_reader_read(&r, raw, 1) == 0 &&
+                     wav_reader_seek(&r, TEST_FRAMES + 1) == VCARD_ERROR_INVALID;
+                wav_reader_close(&m);
+            }
+            wav_reader_close(&r);
+        }
+        if (!ok) {
+            printf("  FAIL: Seek and mapped data\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Seek and mapped data\n");
+        }
+    }
+
+    // A writer that never closed leaves placeholder sizes: read to EOF
+    {
+        static const uint8_t unknown[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+        wav_reader_t r;
+        FILE *fp;
+        int ok = write_file(SINE_FORMAT_I24, WAV_CONTAINER_AUTO) == 0;
+
+        fp = ok ? fopen(TEST_FILE, "r+b") : NULL;
+        if (fp) {
+            // RIFF size, and the data size of the 40-byte extensible fmt chunk
+            ok = fseek(fp, 4, SEEK_SET) == 0 && fwrite(unknown, 1, 4, fp) == 4 &&
+                 fseek(fp, 56 + 40 + 4, SEEK_SET) == 0 && fwrite(unknown, 1, 4, fp) == 4;
+            fclose(fp);
+        } else {
+            ok = 0;
+        }
+        ok = ok && wav_reader_open(&r, TEST_FILE, 0) == 0;
+        if (ok) {
+            ok = r.frames == TEST_FRAMES && read_file(&r, 0) == TEST_FRAMES &&
+                 max_error(TEST_FRAMES, SINE_FORMAT_I24) <= tolerance(SINE_FORMAT_I24);
+            wav_reader_close(&r);
+        }
+        if (!ok) {
+            printf("  FAIL: Unfinalized file not recovered\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Unfinalized file read to the end\n");
+        }
+    }
+
+    // Bad parameters and files
+    {
+        wav_writer_t w;
+        wav_reader_t r;
+        FILE *fp;
+        int ok = wav_writer_open(&w, TEST_FILE, 0, TEST_RATE, SINE_FORMAT_I16,
+                                 WAV_CONTAINER_AUTO) == VCARD_ERROR_INVALID &&
+                 wav_writer_open(&w, TEST_FILE, WAV_MAX_CHANNELS + 1, TEST_RATE,
+                                 SINE_FORMAT_I16, WAV_CONTAINER_AUTO) == VCARD_ERROR_INVALID &&
+                 wav_writer_open(&w, TEST_FILE, 2, 0, SINE_FORMAT_I16,
+                                 WAV_CONTAINER_AUTO) == VCARD_ERROR_INVALID &&
+                 wav_reader_open(&r, "does_not_exist.wav", 0) == VCARD_ERROR_IO;
+
+        fp = fopen(TEST_FILE, "wb");
+        if (fp) {
+            char junk[64];
+            memset(junk, 'x', sizeof(junk));
+            ok = ok && fwrite(junk, 1, sizeof(junk), fp) == sizeof(junk);
+            fclose(fp);
+            ok = ok && wav_reader_open(&r, TEST_FILE, 0) == VCARD_ERROR_INVALID;
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            printf("  FAIL: Bad input not rejected\n");
+            passed = 0;
+        } else {
+            printf("  PASS: Bad input rejected\n");
+        }
+    }
+
+    remove(TEST_FILE);
+
+    printf("\n");
+    if (passed) {
+        printf("All tests PASSED\n");
+        return 0;
+    } else {
+        printf("Some tests FAILED\n");
+        return 1;
+    }
+}
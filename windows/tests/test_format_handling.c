@@ -1,7 +1,8 @@
 /**
  * Test Format Handling for Windows Virtual Sine Device
  * 
- * Tests the WAVEFORMATEXTENSIBLE handling and format detection functions
+ * Tests the WAVEFORMATEXTENSIBLE handling and format detection functions,
+ * and the common sine generator writers for each stream format
  */
 
 #ifdef _WIN32
@@ -14,11 +15,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
-#include <math.h>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
+#include "sine_generator.h"
 
 #ifndef WAVE_FORMAT_EXTENSIBLE
 #define WAVE_FORMAT_EXTENSIBLE 0xFFFE
@@ -74,78 +71,6 @@ static int is_format_pcm(WAVEFORMATEX *pwfx)
     return 0;
 }
 
-/**
- * Sine generator for testing
- */
-typedef struct {
-    double phase;
-    double frequency;
-    double sample_rate;
-    double amplitude;
-} sine_generator_t;
-
-static void sine_generator_init(sine_generator_t *gen, double frequency,
-                                double sample_rate, double amplitude)
-{
-    gen->phase = 0.0;
-    gen->frequency = frequency;
-    gen->sample_rate = sample_rate;
-    gen->amplitude = amplitude;
-}
-
-static void sine_generator_process_float(sine_generator_t *gen, float *buffer,
-                                         size_t num_samples, int channels)
-{
-    double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
-
-    for (size_t i = 0; i < num_samples; i++) {
-        float sample = (float)(gen->amplitude * sin(gen->phase));
-        
-        for (int ch = 0; ch < channels; ch++) {
-            buffer[i * channels + ch] = sample;
-        }
-        
-        gen->phase += phase_increment;
-        if (gen->phase >= 2.0 * M_PI) {
-            gen->phase -= 2.0 * M_PI;
-        }
-    }
-}
-
-static void sine_generator_process_pcm(sine_generator_t *gen, BYTE *buffer,
-                                       size_t num_samples, int channels,
-                                       int bits_per_sample)
-{
-    double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
-    int bytes_per_sample = bits_per_sample / 8;
-    
-    for (size_t i = 0; i < num_samples; i++) {
-        double sample_value = gen->amplitude * sin(gen->phase);
-        
-        for (int ch = 0; ch < channels; ch++) {
-            BYTE *sample_ptr = buffer + (i * channels + ch) * bytes_per_sample;
-            
-            if (bits_per_sample == 16) {
-                int16_t pcm_sample = (int16_t)(sample_value * 32767.0);
-                memcpy(sample_ptr, &pcm_sample, sizeof(int16_t));
-            } else if (bits_per_sample == 24) {
-                int32_t pcm_sample = (int32_t)(sample_value * 8388607.0);
-                sample_ptr[0] = (BYTE)(pcm_sample & 0xFF);
-                sample_ptr[1] = (BYTE)((pcm_sample >> 8) & 0xFF);
-                sample_ptr[2] = (BYTE)((pcm_sample >> 16) & 0xFF);
-            } else if (bits_per_sample == 32) {
-                int32_t pcm_sample = (int32_t)(sample_value * 2147483647.0);
-                memcpy(sample_ptr, &pcm_sample, sizeof(int32_t));
-            }
-        }
-        
-        gen->phase += phase_increment;
-        if (gen->phase >= 2.0 * M_PI) {
-            gen->phase -= 2.0 * M_PI;
-        }
-    }
-}
-
 int main(void)
 {
     int test_passed = 1;
@@ -223,7 +148,7 @@ int main(void)
     sine_generator_init(&gen, 440.0, 48000.0, 0.5);
     
     float float_buffer[100 * 2];  /* 100 frames, 2 channels */
-    sine_generator_process_float(&gen, float_buffer, 100, 2);
+    sine_generator_write_interleaved(&gen, float_buffer, 100, 2, SINE_FORMAT_F32);
     
     /* Check that samples are in valid range */
     int float_samples_ok = 1;
@@ -246,7 +171,7 @@ int main(void)
     sine_generator_init(&gen, 440.0, 48000.0, 0.5);
     
     BYTE pcm16_buffer[100 * 2 * 2];  /* 100 frames, 2 channels, 2 bytes per sample */
-    sine_generator_process_pcm(&gen, pcm16_buffer, 100, 2, 16);
+    sine_generator_write_interleaved(&gen, pcm16_buffer, 100, 2, SINE_FORMAT_I16);
     
     /* Check that we generated non-zero data */
     int pcm16_ok = 0;
@@ -269,7 +194,7 @@ int main(void)
     sine_generator_init(&gen, 440.0, 48000.0, 0.5);
     
     BYTE pcm24_buffer[100 * 2 * 3];  /* 100 frames, 2 channels, 3 bytes per sample */
-    sine_generator_process_pcm(&gen, pcm24_buffer, 100, 2, 24);
+    sine_generator_write_interleaved(&gen, pcm24_buffer, 100, 2, SINE_FORMAT_I24);
     
     /* Check that we generated non-zero data */
     int pcm24_ok = 0;
@@ -292,7 +217,7 @@ int main(void)
     sine_generator_init(&gen, 440.0, 48000.0, 0.5);
     
     BYTE pcm32_buffer[100 * 2 * 4];  /* 100 frames, 2 channels, 4 bytes per sample */
-    sine_generator_process_pcm(&gen, pcm32_buffer, 100, 2, 32);
+    sine_generator_write_interleaved(&gen, pcm32_buffer, 100, 2, SINE_FORMAT_I32);
     
     /* Check that we generated non-zero data */
     int pcm32_ok = 0;
@@ -6,6 +6,19 @@
  * 
  * For a complete virtual sound card loopback, use the WDM driver implementation
  * which creates a virtual audio device with loopback capabilities.
+ *
+ * An event-driven capture thread copies each WASAPI packet into a block
+ * from a pool preallocated for the endpoint buffer size and hands it to
+ * the main (analysis) thread through a lock-free queue; nothing is
+ * allocated or locked while the stream runs. The analysis thread measures
+ * the front channels block by block, so memory use does not grow with the
+ * duration. Each block starts with the time the packet was captured.
+ *
+ * Usage: test_loopback_read [--latency] [--duration <seconds>]
+ *
+ *   --latency    Measure the round-trip latency of the bursts played by
+ *                sine_generator_app --latency-probe instead of checking
+ *                the tone
  */
 
 #ifdef _WIN32
@@ -16,7 +29,12 @@
 #include <audioclient.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include "block_queue.h"
+#include "signal_analyzer.h"
+#include "latency_probe.h"
+#include "vcard_thread.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -29,6 +47,29 @@
 #define READ_DURATION 2
 #define EXPECTED_FREQUENCY 440.0
 #define FREQUENCY_TOLERANCE 5.0
+#define MIN_RMS 0.01
+#define MAX_DC_OFFSET 0.1
+#define MAX_THD_N_DB -40.0
+#define LATENCY_REPORT_BINS 16
+
+/* Front left and right; further mix format channels are not checked */
+#define ANALYZED_CHANNELS 2
+
+/* 100-nanosecond units (REFERENCE_TIME) per millisecond */
+#define HNS_PER_MS 10000LL
+
+/* Endpoint buffer requested in event mode */
+#define CAPTURE_BUFFER_MS 20
+
+/* Audio the block pool can hold before the capture thread starts dropping */
+#define CAPTURE_QUEUE_MS 250
+#define MIN_CAPTURE_BLOCKS 4
+
+/* vcard_time_ns() of the packet, ahead of its frames in every block */
+#define CAPTURE_STAMP_BYTES sizeof(UINT64)
+
+/* Latency mode detector; too large for the stack */
+static latency_detector_t detector;
 
 /* COM GUIDs */
 const CLSID CLSID_MMDeviceEnumerator = {0xBCDE0395, 0xE52F, 0x467C, {0x8E, 0x3D, 0xC4, 0x57, 0x92, 0x91, 0x69, 0x2E}};
@@ -41,6 +82,16 @@ static const GUID KSDATAFORMAT_SUBTYPE_IEEE_FLOAT = {
     0x00000003, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71}
 };
 
+typedef struct {
+	IAudioCaptureClient *pCaptureClient;
+	HANDLE hEvent;
+	block_queue_t queue;		/* Capture thread -> analysis thread */
+	UINT32 block_frames;		/* Largest packet a block holds */
+	UINT32 frame_bytes;
+	vcard_atomic_u32 running;
+	HRESULT hr;			/* Capture thread error, read after join */
+} capture_context_t;
+
 /**
  * Helper function to compare GUIDs
  */
@@ -67,102 +118,239 @@ static int is_format_ieee_float(WAVEFORMATEX *pwfx)
 }
 
 /**
- * Simple zero-crossing frequency detector
+ * Check one channel's worst-case measurements against the expected tone
  */
-static double detect_frequency(float *buffer, size_t num_samples, int sample_rate)
+static int check_channel(int channel, const signal_analyzer_t *analyzer)
 {
-	int zero_crossings = 0;
-	float prev_sample = buffer[0];
-
-	for (size_t i = 1; i < num_samples; i++) {
-		float curr_sample = buffer[i];
-		if ((prev_sample < 0 && curr_sample >= 0) ||
-		    (prev_sample >= 0 && curr_sample < 0)) {
-			zero_crossings++;
-		}
-		prev_sample = curr_sample;
-	}
+	const signal_summary_t *s = &analyzer->summary;
+	int ok = 1;
 
-	/* Frequency = (zero crossings / 2) / duration */
-	double duration = (double)num_samples / sample_rate;
-	double frequency = (zero_crossings / 2.0) / duration;
+	if (s->blocks == 0) {
+		fprintf(stderr, "FAIL: Channel %d: too little audio to analyze\n",
+			channel);
+		return 0;
+	}
 
-	return frequency;
+	printf("Channel %d: %.2f - %.2f Hz, RMS >= %.4f, |DC| <= %.4f, "
+	       "THD+N <= %.1f dB, SNR >= %.1f dB (%llu blocks)\n",
+	       channel, s->frequency_min, s->frequency_max, s->rms_min,
+	       s->dc_max, s->thd_n_db_max, s->snr_db_min,
+	       (unsigned long long)s->blocks);
+
+	if (fabs(s->frequency_min - EXPECTED_FREQUENCY) > FREQUENCY_TOLERANCE ||
+	    fabs(s->frequency_max - EXPECTED_FREQUENCY) > FREQUENCY_TOLERANCE) {
+		fprintf(stderr,
+			"FAIL: Frequency mismatch (expected %.2f ± %.2f Hz)\n",
+			EXPECTED_FREQUENCY, FREQUENCY_TOLERANCE);
+		ok = 0;
+	}
+	if (s->rms_min < MIN_RMS) {
+		fprintf(stderr, "FAIL: Signal too quiet\n");
+		ok = 0;
+	}
+	if (s->dc_max > MAX_DC_OFFSET) {
+		fprintf(stderr, "FAIL: Signal has DC offset\n");
+		ok = 0;
+	}
+	if (s->thd_n_db_max > MAX_THD_N_DB) {
+		fprintf(stderr, "FAIL: Distorted or noisy signal (THD+N limit %.1f dB)\n",
+			MAX_THD_N_DB);
+		ok = 0;
+	}
+	return ok;
 }
 
 /**
- * Check if signal has reasonable amplitude
+ * Print the measured latencies and their jitter histogram
  */
-static int check_amplitude(float *buffer, size_t num_samples)
+static int report_latency(const latency_detector_t *d)
 {
-	double sum = 0.0;
-	double sum_sq = 0.0;
+	static const char bar[] = "########################################";
+	latency_report_t report;
+	uint32_t bins[LATENCY_REPORT_BINS];
+	uint32_t used;
+	uint32_t peak = 1;
+	double bin_us;
+
+	latency_stats_report(&d->stats, &report);
+	if (report.count == 0) {
+		fprintf(stderr, "FAIL: No latency probe bursts received (%llu corrupt)\n",
+			(unsigned long long)report.errors);
+		fprintf(stderr, "Play them with sine_generator_app --latency-probe\n");
+		return 0;
+	}
 
-	for (size_t i = 0; i < num_samples; i++) {
-		sum += buffer[i];
-		sum_sq += buffer[i] * buffer[i];
+	printf("Bursts: %llu (%llu corrupt)\n", (unsigned long long)report.count,
+	       (unsigned long long)report.errors);
+	printf("Latency: min %.3f ms, mean %.3f ms, p99 %.3f ms, max %.3f ms\n",
+	       report.min_us / 1000.0, report.mean_us / 1000.0,
+	       report.p99_us / 1000.0, report.max_us / 1000.0);
+	printf("Jitter: %.3f ms standard deviation\n", report.jitter_us / 1000.0);
+
+	used = latency_stats_jitter_histogram(&d->stats, bins,
+					      LATENCY_REPORT_BINS, &bin_us);
+	for (uint32_t b = 0; b < used; b++) {
+		if (bins[b] > peak) {
+			peak = bins[b];
+		}
 	}
+	printf("Jitter histogram (above minimum):\n");
+	for (uint32_t b = 0; b < used; b++) {
+		printf("  +%7.2f ms %6u %.*s\n", b * bin_us / 1000.0, bins[b],
+		       (int)((uint64_t)bins[b] * (sizeof(bar) - 1) / peak), bar);
+	}
+	return 1;
+}
 
-	double mean = sum / num_samples;
-	double rms = sqrt(sum_sq / num_samples);
+/**
+ * Capture thread: move every packet into a pooled block, never allocate
+ */
+static DWORD WINAPI capture_thread(LPVOID arg)
+{
+	capture_context_t *ctx = (capture_context_t *)arg;
+	HRESULT hr;
 
-	/* RMS should be significant (not silent) */
-	if (rms < 0.01) {
-		fprintf(stderr, "Signal too quiet (RMS: %.4f)\n", rms);
-		return 0;
-	}
+	/* Join the multithreaded apartment the audio client lives in */
+	CoInitializeEx(NULL, COINIT_MULTITHREADED);
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+	ctx->hr = S_OK;
 
-	/* Mean should be close to zero (no DC offset) */
-	if (fabs(mean) > 0.1) {
-		fprintf(stderr, "Signal has DC offset (mean: %.4f)\n", mean);
-		return 0;
+	while (vcard_atomic_load_acquire_u32(&ctx->running)) {
+		if (WaitForSingleObject(ctx->hEvent, 2000) != WAIT_OBJECT_0) {
+			ctx->hr = AUDCLNT_E_DEVICE_INVALIDATED;
+			break;
+		}
+
+		for (;;) {
+			BYTE *pData;
+			UINT32 numFramesToRead;
+			DWORD flags;
+			void *block;
+
+			hr = IAudioCaptureClient_GetBuffer(ctx->pCaptureClient, &pData,
+							  &numFramesToRead, &flags, NULL, NULL);
+			if (hr == AUDCLNT_S_BUFFER_EMPTY) {
+				break;
+			}
+			if (FAILED(hr)) {
+				ctx->hr = hr;
+				goto done;
+			}
+
+			/* No free block: the analysis thread fell behind, drop the packet */
+			block = numFramesToRead <= ctx->block_frames ?
+				block_queue_write_begin(&ctx->queue) : NULL;
+			if (block) {
+				BYTE *frames = (BYTE *)block + CAPTURE_STAMP_BYTES;
+
+				*(UINT64 *)block = vcard_time_ns();
+				if (flags & AUDCLNT_BUFFERFLAGS_SILENT) {
+					memset(frames, 0, (size_t)numFramesToRead * ctx->frame_bytes);
+				} else {
+					memcpy(frames, pData, (size_t)numFramesToRead * ctx->frame_bytes);
+				}
+				block_queue_write_commit(&ctx->queue, numFramesToRead);
+			}
+
+			hr = IAudioCaptureClient_ReleaseBuffer(ctx->pCaptureClient, numFramesToRead);
+			if (FAILED(hr)) {
+				ctx->hr = hr;
+				goto done;
+			}
+		}
 	}
 
-	printf("Signal amplitude OK (RMS: %.4f, mean: %.4f)\n", rms, mean);
-	return 1;
+done:
+	CoUninitialize();
+	return 0;
 }
 
-int main(void)
+/**
+ * Analyze captured blocks and hand them back (analysis thread)
+ */
+static void drain_blocks(capture_context_t *ctx, WAVEFORMATEX *pwfx, int is_float,
+			 signal_analyzer_t *analyzers, int num_analyzers,
+			 latency_detector_t *latency, size_t *frames_analyzed)
+{
+	const BYTE *block;
+	uint32_t frames;
+
+	while ((block = block_queue_read_begin(&ctx->queue, &frames)) != NULL) {
+		const float *floatData = (const float *)(block + CAPTURE_STAMP_BYTES);
+
+		if (is_float && latency) {
+			latency_detector_process(latency, floatData, frames, pwfx->nChannels,
+						 *(const UINT64 *)block);
+			*frames_analyzed += frames;
+		} else if (is_float) {
+			/* Every analyzed channel straight from the interleaved block */
+			for (int ch = 0; ch < num_analyzers; ch++) {
+				signal_analyzer_process(&analyzers[ch], floatData + ch,
+							frames, pwfx->nChannels);
+			}
+			*frames_analyzed += frames;
+		}
+		block_queue_read_commit(&ctx->queue);
+	}
+}
+
+int main(int argc, char *argv[])
 {
 	HRESULT hr;
 	IMMDeviceEnumerator *pEnumerator = NULL;
 	IMMDevice *pDevice = NULL;
 	IAudioClient *pAudioClient = NULL;
-	IAudioCaptureClient *pCaptureClient = NULL;
 	WAVEFORMATEX *pwfx = NULL;
+	HANDLE hThread = NULL;
 	UINT32 bufferFrameCount;
-	UINT32 packetLength = 0;
-	BYTE *pData;
-	DWORD flags;
-	int test_passed = 1;
-	float *all_samples = NULL;
-	size_t samples_collected = 0;
-	size_t samples_capacity = 0;
+	capture_context_t ctx;
+	int com_initialized = 0;
+	int test_passed = 0;
+	int duration = READ_DURATION;
+	signal_analyzer_t analyzers[ANALYZED_CHANNELS];
+	int num_analyzers = 0;
+	latency_detector_t *latency = NULL;
+	size_t frames_analyzed = 0;
+
+	memset(&ctx, 0, sizeof(ctx));
+	memset(analyzers, 0, sizeof(analyzers));
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--latency") == 0) {
+			latency = &detector;
+		} else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc &&
+			   (duration = atoi(argv[i + 1])) > 0) {
+			i++;
+		} else {
+			printf("Usage: %s [--latency] [--duration <seconds>]\n", argv[0]);
+			return 1;
+		}
+	}
 
 	printf("Windows WASAPI Loopback Read Test\n");
 	printf("===================================\n");
 	printf("Reading from default capture device...\n");
 	printf("Expected frequency: %.2f Hz\n", EXPECTED_FREQUENCY);
-	printf("Duration: %d seconds\n", READ_DURATION);
+	printf("Duration: %d seconds\n", duration);
 	printf("\n");
 	printf("Note: Make sure audio is playing through your system,\n");
 	printf("      or use a virtual audio cable for loopback testing.\n");
 	printf("\n");
 
-	/* Initialize COM */
-	hr = CoInitialize(NULL);
+	/* Initialize COM; the capture thread uses the client from the MTA too */
+	hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
 	if (FAILED(hr)) {
 		fprintf(stderr, "Failed to initialize COM: 0x%lx\n", hr);
 		return 1;
 	}
+	com_initialized = 1;
 
 	/* Create device enumerator */
 	hr = CoCreateInstance(&CLSID_MMDeviceEnumerator, NULL, CLSCTX_ALL,
 			      &IID_IMMDeviceEnumerator, (void**)&pEnumerator);
 	if (FAILED(hr)) {
 		fprintf(stderr, "Failed to create device enumerator: 0x%lx\n", hr);
-		CoUninitialize();
-		return 1;
+		goto cleanup;
 	}
 
 	/* Get default audio capture endpoint */
@@ -170,9 +358,7 @@ int main(void)
 							eConsole, &pDevice);
 	if (FAILED(hr)) {
 		fprintf(stderr, "Failed to get default audio capture endpoint: 0x%lx\n", hr);
-		IMMDeviceEnumerator_Release(pEnumerator);
-		CoUninitialize();
-		return 1;
+		goto cleanup;
 	}
 
 	/* Activate audio client */
@@ -180,77 +366,88 @@ int main(void)
 			       NULL, (void**)&pAudioClient);
 	if (FAILED(hr)) {
 		fprintf(stderr, "Failed to activate audio client: 0x%lx\n", hr);
-		IMMDevice_Release(pDevice);
-		IMMDeviceEnumerator_Release(pEnumerator);
-		CoUninitialize();
-		return 1;
+		goto cleanup;
 	}
 
 	/* Get mix format */
 	hr = IAudioClient_GetMixFormat(pAudioClient, &pwfx);
 	if (FAILED(hr)) {
 		fprintf(stderr, "Failed to get mix format: 0x%lx\n", hr);
-		IAudioClient_Release(pAudioClient);
-		IMMDevice_Release(pDevice);
-		IMMDeviceEnumerator_Release(pEnumerator);
-		CoUninitialize();
-		return 1;
+		goto cleanup;
 	}
 
 	printf("Sample Rate: %ld Hz\n", pwfx->nSamplesPerSec);
 	printf("Channels: %d\n", pwfx->nChannels);
 	printf("\n");
 
-	/* Initialize audio client */
+	/* Initialize audio client in event-driven shared mode */
 	hr = IAudioClient_Initialize(pAudioClient, AUDCLNT_SHAREMODE_SHARED,
-				     0, 10000000, 0, pwfx, NULL);
+				     AUDCLNT_STREAMFLAGS_EVENTCALLBACK,
+				     CAPTURE_BUFFER_MS * HNS_PER_MS, 0, pwfx, NULL);
 	if (FAILED(hr)) {
 		fprintf(stderr, "Failed to initialize audio client: 0x%lx\n", hr);
-		CoTaskMemFree(pwfx);
-		IAudioClient_Release(pAudioClient);
-		IMMDevice_Release(pDevice);
-		IMMDeviceEnumerator_Release(pEnumerator);
-		CoUninitialize();
-		return 1;
+		goto cleanup;
+	}
+
+	ctx.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (!ctx.hEvent) {
+		fprintf(stderr, "Failed to create capture event\n");
+		goto cleanup;
+	}
+	hr = IAudioClient_SetEventHandle(pAudioClient, ctx.hEvent);
+	if (FAILED(hr)) {
+		fprintf(stderr, "Failed to set event handle: 0x%lx\n", hr);
+		goto cleanup;
 	}
 
 	/* Get buffer size */
 	hr = IAudioClient_GetBufferSize(pAudioClient, &bufferFrameCount);
 	if (FAILED(hr)) {
 		fprintf(stderr, "Failed to get buffer size: 0x%lx\n", hr);
-		CoTaskMemFree(pwfx);
-		IAudioClient_Release(pAudioClient);
-		IMMDevice_Release(pDevice);
-		IMMDeviceEnumerator_Release(pEnumerator);
-		CoUninitialize();
-		return 1;
+		goto cleanup;
 	}
 
 	/* Get capture client */
 	hr = IAudioClient_GetService(pAudioClient, &IID_IAudioCaptureClient,
-				    (void**)&pCaptureClient);
+				    (void**)&ctx.pCaptureClient);
 	if (FAILED(hr)) {
 		fprintf(stderr, "Failed to get capture client: 0x%lx\n", hr);
-		CoTaskMemFree(pwfx);
-		IAudioClient_Release(pAudioClient);
-		IMMDevice_Release(pDevice);
-		IMMDeviceEnumerator_Release(pEnumerator);
-		CoUninitialize();
-		return 1;
+		goto cleanup;
 	}
 
-	/* Allocate buffer for analysis */
-	samples_capacity = READ_DURATION * pwfx->nSamplesPerSec;
-	all_samples = (float*)malloc(samples_capacity * sizeof(float));
-	if (!all_samples) {
-		fprintf(stderr, "Failed to allocate analysis buffer\n");
-		IAudioCaptureClient_Release(pCaptureClient);
-		CoTaskMemFree(pwfx);
-		IAudioClient_Release(pAudioClient);
-		IMMDevice_Release(pDevice);
-		IMMDeviceEnumerator_Release(pEnumerator);
-		CoUninitialize();
-		return 1;
+	/* A packet never exceeds the endpoint buffer: size the blocks from it */
+	{
+		UINT32 num_blocks = (UINT32)((UINT64)pwfx->nSamplesPerSec * CAPTURE_QUEUE_MS /
+					     1000 / bufferFrameCount);
+
+		if (num_blocks < MIN_CAPTURE_BLOCKS) {
+			num_blocks = MIN_CAPTURE_BLOCKS;
+		}
+		ctx.block_frames = bufferFrameCount;
+		ctx.frame_bytes = pwfx->nBlockAlign;
+		if (block_queue_init(&ctx.queue, num_blocks, CAPTURE_STAMP_BYTES +
+				     (size_t)bufferFrameCount * pwfx->nBlockAlign) != 0) {
+			fprintf(stderr, "Failed to allocate capture blocks\n");
+			goto cleanup;
+		}
+		printf("Capture pool: %u blocks of %u frames\n", ctx.queue.num_blocks,
+		       bufferFrameCount);
+	}
+
+	/* One analyzer per checked channel, 100 ms blocks */
+	if (latency && latency_detector_init(latency, pwfx->nSamplesPerSec) != 0) {
+		fprintf(stderr, "Unsupported sample rate for the latency probe\n");
+		goto cleanup;
+	}
+	num_analyzers = pwfx->nChannels < ANALYZED_CHANNELS ? pwfx->nChannels :
+							      ANALYZED_CHANNELS;
+	for (int ch = 0; ch < num_analyzers; ch++) {
+		if (signal_analyzer_init(&analyzers[ch], pwfx->nSamplesPerSec,
+					 EXPECTED_FREQUENCY,
+					 pwfx->nSamplesPerSec / 10) != 0) {
+			fprintf(stderr, "Failed to allocate analyzers\n");
+			goto cleanup;
+		}
 	}
 
 	printf("Reading audio...\n");
@@ -259,64 +456,26 @@ int main(void)
 	hr = IAudioClient_Start(pAudioClient);
 	if (FAILED(hr)) {
 		fprintf(stderr, "Failed to start audio client: 0x%lx\n", hr);
-		free(all_samples);
-		IAudioCaptureClient_Release(pCaptureClient);
-		CoTaskMemFree(pwfx);
-		IAudioClient_Release(pAudioClient);
-		IMMDevice_Release(pDevice);
-		IMMDeviceEnumerator_Release(pEnumerator);
-		CoUninitialize();
-		return 1;
+		goto cleanup;
 	}
 
-	/* Capture audio for specified duration */
+	vcard_atomic_store_release_u32(&ctx.running, 1);
+	hThread = CreateThread(NULL, 0, capture_thread, &ctx, 0, NULL);
+	if (!hThread) {
+		fprintf(stderr, "Failed to start capture thread\n");
+		IAudioClient_Stop(pAudioClient);
+		goto cleanup;
+	}
+
+	/* Analysis thread: drain blocks for the specified duration */
 	DWORD startTime = GetTickCount();
-	DWORD duration_ms = READ_DURATION * 1000;
+	DWORD duration_ms = (DWORD)duration * 1000;
+	int is_float = is_format_ieee_float(pwfx);
 
 	while ((GetTickCount() - startTime) < duration_ms) {
-		/* Sleep a bit before checking for data */
 		Sleep(10);
-
-		/* Check if there's data available */
-		hr = IAudioCaptureClient_GetNextPacketSize(pCaptureClient, &packetLength);
-		if (FAILED(hr)) {
-			fprintf(stderr, "Failed to get packet size: 0x%lx\n", hr);
-			break;
-		}
-
-		while (packetLength != 0) {
-			UINT32 numFramesToRead;
-
-			/* Get the captured data */
-			hr = IAudioCaptureClient_GetBuffer(pCaptureClient, &pData,
-							  &numFramesToRead, &flags, NULL, NULL);
-			if (FAILED(hr)) {
-				fprintf(stderr, "Failed to get buffer: 0x%lx\n", hr);
-				break;
-			}
-
-			/* Extract mono samples (left channel only) */
-			if (is_format_ieee_float(pwfx)) {
-				float *floatData = (float*)pData;
-				for (UINT32 i = 0; i < numFramesToRead && samples_collected < samples_capacity; i++) {
-					all_samples[samples_collected++] = floatData[i * pwfx->nChannels];
-				}
-			}
-
-			/* Release buffer */
-			hr = IAudioCaptureClient_ReleaseBuffer(pCaptureClient, numFramesToRead);
-			if (FAILED(hr)) {
-				fprintf(stderr, "Failed to release buffer: 0x%lx\n", hr);
-				break;
-			}
-
-			/* Check for next packet */
-			hr = IAudioCaptureClient_GetNextPacketSize(pCaptureClient, &packetLength);
-			if (FAILED(hr)) {
-				fprintf(stderr, "Failed to get packet size: 0x%lx\n", hr);
-				break;
-			}
-		}
+		drain_blocks(&ctx, pwfx, is_float, analyzers, num_analyzers,
+			     latency, &frames_analyzed);
 
 		/* Print progress */
 		DWORD elapsed = GetTickCount() - startTime;
@@ -325,36 +484,37 @@ int main(void)
 		fflush(stdout);
 	}
 
+	vcard_atomic_store_release_u32(&ctx.running, 0);
+	WaitForSingleObject(hThread, INFINITE);
+	CloseHandle(hThread);
+	drain_blocks(&ctx, pwfx, is_float, analyzers, num_analyzers,
+		     latency, &frames_analyzed);
+
 	printf("\rProgress: 100.0%%\n");
-	printf("Read complete. Analyzing...\n\n");
+	printf("Read complete.\n\n");
 
 	/* Stop audio client */
 	IAudioClient_Stop(pAudioClient);
+	if (FAILED(ctx.hr)) {
+		fprintf(stderr, "Capture thread failed: 0x%lx\n", ctx.hr);
+	}
 
-	/* Analyze the captured audio */
+	/* Worst block of every channel over the whole capture */
 	printf("=== Analysis Results ===\n");
-	printf("Samples collected: %zu\n", samples_collected);
-
-	if (samples_collected > 0) {
-		/* Check amplitude */
-		if (!check_amplitude(all_samples, samples_collected)) {
-			test_passed = 0;
+	printf("Frames analyzed: %zu\n", frames_analyzed);
+	printf("Dropped packets: %u\n", block_queue_overflows(&ctx.queue));
+	test_passed = 1;
+
+	if (frames_analyzed > 0 && latency) {
+		test_passed = report_latency(latency);
+	} else if (frames_analyzed > 0) {
+		for (int ch = 0; ch < num_analyzers; ch++) {
+			if (!check_channel(ch, &analyzers[ch])) {
+				test_passed = 0;
+			}
 		}
-
-		/* Detect frequency */
-		double detected_freq = detect_frequency(all_samples, samples_collected,
-						       pwfx->nSamplesPerSec);
-		printf("Detected frequency: %.2f Hz\n", detected_freq);
-
-		/* Verify frequency is close to expected */
-		double freq_diff = fabs(detected_freq - EXPECTED_FREQUENCY);
-		if (freq_diff > FREQUENCY_TOLERANCE) {
-			fprintf(stderr,
-				"FAIL: Frequency mismatch (expected %.2f ± %.2f Hz, got %.2f Hz)\n",
-				EXPECTED_FREQUENCY, FREQUENCY_TOLERANCE, detected_freq);
-			test_passed = 0;
-		} else {
-			printf("PASS: Frequency within tolerance (%.2f Hz)\n", freq_diff);
+		if (test_passed) {
+			printf("PASS: All channels within tolerance\n");
 		}
 	} else {
 		fprintf(stderr, "FAIL: No audio data captured\n");
@@ -363,14 +523,32 @@ int main(void)
 
 	printf("\n");
 
-	/* Cleanup */
-	free(all_samples);
-	IAudioCaptureClient_Release(pCaptureClient);
-	CoTaskMemFree(pwfx);
-	IAudioClient_Release(pAudioClient);
-	IMMDevice_Release(pDevice);
-	IMMDeviceEnumerator_Release(pEnumerator);
-	CoUninitialize();
+cleanup:
+	for (int ch = 0; ch < ANALYZED_CHANNELS; ch++) {
+		signal_analyzer_free(&analyzers[ch]);
+	}
+	block_queue_free(&ctx.queue);
+	if (ctx.pCaptureClient) {
+		IAudioCaptureClient_Release(ctx.pCaptureClient);
+	}
+	if (ctx.hEvent) {
+		CloseHandle(ctx.hEvent);
+	}
+	if (pwfx) {
+		CoTaskMemFree(pwfx);
+	}
+	if (pAudioClient) {
+		IAudioClient_Release(pAudioClient);
+	}
+	if (pDevice) {
+		IMMDevice_Release(pDevice);
+	}
+	if (pEnumerator) {
+		IMMDeviceEnumerator_Release(pEnumerator);
+	}
+	if (com_initialized) {
+		CoUninitialize();
+	}
 
 	if (test_passed) {
 		printf("=== TEST PASSED ===\n");
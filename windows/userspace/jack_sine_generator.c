@@ -2,7 +2,22 @@
  * JACK2 Sine Wave Generator Application (Windows)
  * 
  * Generates a sine wave and plays it through JACK2 audio server
- * Usage: jack_sine_generator.exe [frequency] [duration_seconds]
+ * Usage: jack_sine_generator.exe [--channels n] [--latency-probe] [--sweep end_hz]
+ *                            [frequency] [duration_seconds]
+ *
+ *   --channels n      Register n output ports (1 to 32, default 2), each
+ *                     connected to the next physical playback port
+ *   --latency-probe   Play timestamped MLS bursts instead of the tone, for
+ *                     test_loopback_read --latency
+ *   --sweep end_hz    Sweep exponentially from frequency to end_hz over the
+ *                     whole duration
+ *
+ * While the tone plays, commands typed on stdin change it without
+ * restarting the client:
+ *   freq <hz> [ramp_ms]      Glide to a new frequency
+ *   amp <level> [ramp_ms]    Fade to a new amplitude (0.0 to 1.0)
+ *   quit                     Stop playback
+ * The process callback applies them through a lock-free command queue.
  * 
  * Prerequisites:
  *   - JACK2 for Windows installed from https://jackaudio.org/
@@ -13,7 +28,6 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <math.h>
 #include <signal.h>
 
 #ifdef _WIN32
@@ -23,62 +37,78 @@
 #endif
 
 #include <jack/jack.h>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
+#include "sine_generator.h"
+#include "sine_control.h"
+#include "latency_probe.h"
+#include "vcard_telemetry.h"
+#include "vcard_thread.h"
+#include "vcard_atomic.h"
+#include "vcard_trace.h"
 
 #define DEFAULT_FREQUENCY 440.0
 #define DEFAULT_DURATION 5
+#define DEFAULT_CHANNELS 2
+
+#define COMMAND_LINE_MAX 128
 
 typedef struct {
-	double phase;
-	double frequency;
+	sine_control_t control;		/* Tone, changed live through its queue */
+	latency_probe_t probe;
+	int probe_enabled;		/* Play probe bursts instead of the sine */
 	double sample_rate;
-	double amplitude;
-	int frames_remaining;
+	int frames_remaining;		/* Process callback only */
 	int total_frames;
-	volatile int should_exit;
-} sine_generator_t;
 
-static sine_generator_t generator;
-static jack_port_t *output_port_left;
-static jack_port_t *output_port_right;
+	/* Published by the process callback */
+	vcard_atomic_u64 frames_played;
+	vcard_atomic_u32 finished;
+} sine_playback_t;
+
+static sine_playback_t generator;
+static volatile sig_atomic_t interrupted;
+static jack_port_t *output_ports[VCARD_MAX_CHANNELS];
+static unsigned int num_ports;
 static jack_client_t *client;
 
-static void sine_generator_init(sine_generator_t *gen, double frequency,
-				double sample_rate, double amplitude, int duration)
+/* Written by the process and xrun callbacks, read by the main loop */
+static vcard_telemetry_t telemetry;
+
+static void playback_init(sine_playback_t *gen, double frequency,
+			  double sample_rate, double amplitude, int duration)
 {
-	gen->phase = 0.0;
-	gen->frequency = frequency;
+	sine_control_init(&gen->control, frequency, sample_rate, amplitude);
 	gen->sample_rate = sample_rate;
-	gen->amplitude = amplitude;
 	gen->total_frames = (int)(duration * sample_rate);
 	gen->frames_remaining = gen->total_frames;
-	gen->should_exit = 0;
+	vcard_atomic_store_relaxed_u64(&gen->frames_played, 0);
+	vcard_atomic_store_relaxed_u32(&gen->finished, 0);
 }
 
-static void sine_generator_process_float(sine_generator_t *gen, float *left,
-					 float *right, jack_nframes_t nframes)
+/*
+ * Render into the port buffers. The signal is the same on every port, so
+ * it is rendered once, straight into the first port, and copied to the
+ * others.
+ */
+static void playback_process(sine_playback_t *gen, float *const *buffers,
+			     unsigned int channels, jack_nframes_t nframes)
 {
-	double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
+	jack_nframes_t n = nframes;
 
-	for (jack_nframes_t i = 0; i < nframes; i++) {
-		if (gen->frames_remaining <= 0) {
-			left[i] = 0.0f;
-			right[i] = 0.0f;
-		} else {
-			float sample = (float)(gen->amplitude * sin(gen->phase));
-			left[i] = sample;
-			right[i] = sample;
-			
-			gen->phase += phase_increment;
-			if (gen->phase >= 2.0 * M_PI) {
-				gen->phase -= 2.0 * M_PI;
-			}
-			
-			gen->frames_remaining--;
-		}
+	if ((int)n > gen->frames_remaining) {
+		n = gen->frames_remaining > 0 ? (jack_nframes_t)gen->frames_remaining : 0;
+	}
+	if (gen->probe_enabled) {
+		latency_probe_render(&gen->probe, buffers[0], n, vcard_time_ns());
+	} else {
+		sine_control_render(&gen->control, buffers[0], n);
+	}
+	gen->frames_remaining -= (int)n;
+	vcard_atomic_fetch_add_u64(&gen->frames_played, n);
+
+	/* Silence after the end of the tone */
+	memset(buffers[0] + n, 0, (nframes - n) * sizeof(float));
+	for (unsigned int ch = 1; ch < channels; ch++) {
+		memcpy(buffers[ch], buffers[0], nframes * sizeof(float));
 	}
 }
 
@@ -86,18 +116,156 @@ static int jack_process_callback(jack_nframes_t nframes, void *arg)
 {
 	(void)arg;
 	
-	float *left_buffer = (float *)jack_port_get_buffer(output_port_left, nframes);
-	float *right_buffer = (float *)jack_port_get_buffer(output_port_right, nframes);
+	VCARD_TRACE_BEGIN(trace);
+	jack_time_t start = jack_get_time();
+	float *buffers[VCARD_MAX_CHANNELS];
+
+	for (unsigned int ch = 0; ch < num_ports; ch++) {
+		buffers[ch] = (float *)jack_port_get_buffer(output_ports[ch], nframes);
+	}
 	
-	sine_generator_process_float(&generator, left_buffer, right_buffer, nframes);
+	playback_process(&generator, buffers, num_ports, nframes);
 	
 	if (generator.frames_remaining <= 0) {
-		generator.should_exit = 1;
+		vcard_atomic_store_release_u32(&generator.finished, 1);
 	}
 	
+	vcard_telemetry_period(&telemetry, nframes, (uint32_t)generator.sample_rate,
+			       (uint64_t)(jack_get_time() - start) * 1000u);
+	/* JACK keeps no queue of its own: the period is the whole buffer */
+	VCARD_TRACE_END(trace, "jack.process", nframes, nframes, nframes);
+	return 0;
+}
+
+static int jack_xrun_callback(void *arg)
+{
+	(void)arg;
+	vcard_telemetry_xrun(&telemetry);
 	return 0;
 }
 
+/**
+ * Publish the playback latency of the output ports (main thread)
+ */
+static void update_latency(void)
+{
+	jack_latency_range_t range;
+	jack_nframes_t frames;
+
+	jack_port_get_latency_range(output_ports[0], JackPlaybackLatency, &range);
+	frames = range.max + jack_get_buffer_size(client);
+	vcard_telemetry_latency(&telemetry, (uint32_t)((uint64_t)frames * 1000000u /
+						      (uint64_t)generator.sample_rate));
+}
+
+static void print_progress(int progress)
+{
+	vcard_status_t status;
+
+	vcard_telemetry_snapshot(&telemetry, &status);
+	printf("\rProgress: %3d%%  ", progress);
+	if (!generator.probe_enabled) {
+		printf("%8.2f Hz%s  ", sine_control_frequency(&generator.control),
+		       sine_control_idle(&generator.control) ? " " : "*");
+	}
+	printf("xruns: %u  DSP load: %5.2f%%  latency: %u us ",
+	       status.xruns, status.cpu_load, status.latency_us);
+	fflush(stdout);
+}
+
+/**
+ * Read tone commands from stdin and queue them for the process callback
+ *
+ * Runs until stdin closes; it is the only producer of the command queue.
+ * Blocked in fgets at exit, so it is never joined.
+ */
+static void command_thread(void *arg)
+{
+	char line[COMMAND_LINE_MAX];
+
+	(void)arg;
+	while (fgets(line, sizeof(line), stdin)) {
+		char name[16];
+		double value;
+		double ramp_ms = 0.0;
+		int fields = sscanf(line, "%15s %lf %lf", name, &value, &ramp_ms);
+		sine_param_t param;
+
+		if (fields >= 1 && strcmp(name, "quit") == 0) {
+			interrupted = 1;
+			return;
+		}
+		if (fields >= 2 && strcmp(name, "freq") == 0) {
+			param = SINE_PARAM_FREQUENCY;
+		} else if (fields >= 2 && strcmp(name, "amp") == 0) {
+			param = SINE_PARAM_AMPLITUDE;
+		} else {
+			fprintf(stderr, "\nCommands: freq <hz> [ramp_ms], amp <level> [ramp_ms], quit\n");
+			continue;
+		}
+		if (ramp_ms < 0.0 || ramp_ms > 600000.0 ||
+		    sine_control_push(&generator.control, param, value,
+				      (uint32_t)(ramp_ms * generator.sample_rate / 1000.0),
+				      SINE_CONTROL_NOW) != 0) {
+			fprintf(stderr, "\nRejected: %s", line);
+		}
+	}
+}
+
+/**
+ * Register the output ports: output_left/output_right for stereo, as
+ * before, and output_1 to output_n otherwise
+ */
+static int register_ports(unsigned int channels)
+{
+	for (unsigned int ch = 0; ch < channels; ch++) {
+		char name[32];
+
+		if (channels == 2) {
+			snprintf(name, sizeof(name), "%s", ch == 0 ? "output_left" : "output_right");
+		} else {
+			snprintf(name, sizeof(name), "output_%u", ch + 1);
+		}
+		output_ports[ch] = jack_port_register(client, name, JACK_DEFAULT_AUDIO_TYPE,
+						      JackPortIsOutput, 0);
+		if (output_ports[ch] == NULL) {
+			return -1;
+		}
+		num_ports = ch + 1;
+	}
+	return 0;
+}
+
+/**
+ * Connect output port n to physical playback port n, for as many as exist
+ *
+ * @return Number of ports connected
+ */
+static unsigned int connect_ports(void)
+{
+	const char **ports = jack_get_ports(client, NULL, NULL,
+					    JackPortIsPhysical | JackPortIsInput);
+	unsigned int connected = 0;
+	unsigned int available = 0;
+
+	if (ports == NULL) {
+		return 0;
+	}
+	while (ports[available] != NULL) {
+		available++;
+	}
+	for (unsigned int ch = 0; ch < num_ports && ch < available; ch++) {
+		if (jack_connect(client, jack_port_name(output_ports[ch]), ports[ch]) == 0) {
+			connected++;
+		} else {
+			fprintf(stderr, "Cannot connect %s to %s\n",
+				jack_port_name(output_ports[ch]), ports[ch]);
+		}
+	}
+	jack_free(ports);
+	return connected;
+}
+
 static void jack_shutdown_callback(void *arg)
 {
 	(void)arg;
@@ -108,17 +276,49 @@ static void jack_shutdown_callback(void *arg)
 static void signal_handler(int sig)
 {
 	(void)sig;
-	generator.should_exit = 1;
+	interrupted = 1;
 }
 
 int main(int argc, char *argv[])
 {
 	jack_status_t status;
-	const char **ports;
+	vcard_thread_t input_thread;
+	unsigned int channels = DEFAULT_CHANNELS;
+	unsigned int connected;
 	double frequency = DEFAULT_FREQUENCY;
+	double sweep_end = 0.0;
 	int duration = DEFAULT_DURATION;
-
-	/* Parse command line arguments */
+	int probe_enabled = 0;
+
+	/* Parse command line arguments: options first, then positionals */
+	while (argc >= 2 && strncmp(argv[1], "--", 2) == 0) {
+		if (strcmp(argv[1], "--latency-probe") == 0) {
+			probe_enabled = 1;
+		} else if (strcmp(argv[1], "--channels") == 0 && argc >= 3) {
+			int n = atoi(argv[2]);
+			if (n < 1 || n > VCARD_MAX_CHANNELS) {
+				fprintf(stderr, "Invalid channel count: %s (1 to %d)\n",
+					argv[2], VCARD_MAX_CHANNELS);
+				return 1;
+			}
+			channels = (unsigned int)n;
+			argv++;
+			argc--;
+		} else if (strcmp(argv[1], "--sweep") == 0 && argc >= 3) {
+			sweep_end = atof(argv[2]);
+			if (sweep_end <= 0 || sweep_end > 20000) {
+				fprintf(stderr, "Invalid sweep end frequency: %.2f Hz\n", sweep_end);
+				return 1;
+			}
+			argv++;
+			argc--;
+		} else {
+			fprintf(stderr, "Unknown option: %s\n", argv[1]);
+			return 1;
+		}
+		argv++;
+		argc--;
+	}
 	if (argc >= 2) {
 		frequency = atof(argv[1]);
 		if (frequency <= 0 || frequency > 20000) {
@@ -138,6 +338,7 @@ int main(int argc, char *argv[])
 	printf("====================================\n");
 	printf("Frequency: %.2f Hz\n", frequency);
 	printf("Duration: %d seconds\n", duration);
+	printf("Channels: %u\n", channels);
 	printf("\n");
 
 	/* Create JACK client */
@@ -163,28 +364,38 @@ int main(int argc, char *argv[])
 	}
 
 	/* Initialize sine generator */
-	sine_generator_init(&generator, frequency, jack_get_sample_rate(client),
-			    0.5, duration);
+	playback_init(&generator, frequency, jack_get_sample_rate(client),
+		      0.5, duration);
+	if (probe_enabled) {
+		if (latency_probe_init(&generator.probe, generator.sample_rate,
+				       LATENCY_PROBE_DEFAULT_INTERVAL, 0.5) != 0) {
+			fprintf(stderr, "Unsupported sample rate for the latency probe\n");
+			jack_client_close(client);
+			return 1;
+		}
+		generator.probe_enabled = 1;
+		printf("Signal: latency probe bursts every %.0f ms\n",
+		       LATENCY_PROBE_DEFAULT_INTERVAL * 1000.0);
+	} else if (sweep_end > 0) {
+		sine_control_push(&generator.control, SINE_PARAM_FREQUENCY, sweep_end,
+				  (uint32_t)generator.total_frames, SINE_CONTROL_NOW);
+		printf("Signal: sweep %.2f Hz to %.2f Hz\n", frequency, sweep_end);
+	}
 
 	printf("Sample Rate: %.0f Hz\n", generator.sample_rate);
 	printf("Total Frames: %d\n", generator.total_frames);
 	printf("\n");
 
 	/* Set process callback */
+	vcard_telemetry_init(&telemetry);
 	jack_set_process_callback(client, jack_process_callback, NULL);
+	jack_set_xrun_callback(client, jack_xrun_callback, NULL);
 
 	/* Set shutdown callback */
 	jack_on_shutdown(client, jack_shutdown_callback, NULL);
 
 	/* Create output ports */
-	output_port_left = jack_port_register(client, "output_left",
-					      JACK_DEFAULT_AUDIO_TYPE,
-					      JackPortIsOutput, 0);
-	output_port_right = jack_port_register(client, "output_right",
-					       JACK_DEFAULT_AUDIO_TYPE,
-					       JackPortIsOutput, 0);
-
-	if ((output_port_left == NULL) || (output_port_right == NULL)) {
+	if (register_ports(channels) != 0) {
 		fprintf(stderr, "Failed to create output ports\n");
 		jack_client_close(client);
 		return 1;
@@ -196,25 +407,18 @@ int main(int argc, char *argv[])
 		jack_client_close(client);
 		return 1;
 	}
+	VCARD_TRACE_START_FROM_ENV();
 
 	/* Connect ports to physical outputs */
-	ports = jack_get_ports(client, NULL, NULL,
-			       JackPortIsPhysical | JackPortIsInput);
-	if (ports == NULL) {
+	connected = connect_ports();
+	if (connected == 0) {
 		fprintf(stderr, "No physical playback ports found\n");
 		fprintf(stderr, "You may need to connect manually using:\n");
 		fprintf(stderr, "  QjackCtl (GUI - recommended for Windows)\n");
-		fprintf(stderr, "  jack_connect sine_generator:output_left system:playback_1\n");
+		fprintf(stderr, "  jack_connect %s system:playback_1\n",
+			jack_port_name(output_ports[0]));
 	} else {
-		if (jack_connect(client, jack_port_name(output_port_left), ports[0])) {
-			fprintf(stderr, "Cannot connect left output port\n");
-		}
-		if (ports[1] != NULL) {
-			if (jack_connect(client, jack_port_name(output_port_right), ports[1])) {
-				fprintf(stderr, "Cannot connect right output port\n");
-			}
-		}
-		jack_free(ports);
+		printf("Connected %u of %u ports to physical outputs\n", connected, num_ports);
 	}
 
 	/* Set up signal handler */
@@ -222,26 +426,33 @@ int main(int argc, char *argv[])
 	signal(SIGTERM, signal_handler);
 
 	printf("Playing sine wave...\n");
+	if (!probe_enabled && vcard_thread_create(&input_thread, command_thread, NULL) == 0) {
+		printf("Type 'freq <hz> [ramp_ms]', 'amp <level> [ramp_ms]' or 'quit'\n");
+	}
 	printf("Press Ctrl+C to stop\n\n");
 
-	/* Wait for playback to complete */
-	int last_progress = -1;
-	while (!generator.should_exit) {
-		usleep(100000); /* 100ms */
-		
-		int progress = (int)((1.0 - (double)generator.frames_remaining / generator.total_frames) * 100.0);
-		if (progress != last_progress && progress <= 100) {
-			printf("\rProgress: %d%%", progress);
-			fflush(stdout);
-			last_progress = progress;
+	/*
+	 * Refresh the display until playback completes; everything shown is
+	 * published by the process callback through atomics
+	 */
+	while (!vcard_atomic_load_acquire_u32(&generator.finished) && !interrupted) {
+		uint64_t played;
+
+		vcard_sleep_us(100000);
+		played = vcard_atomic_load_relaxed_u64(&generator.frames_played);
+		if (played > (uint64_t)generator.total_frames) {
+			played = (uint64_t)generator.total_frames;
 		}
+		update_latency();
+		print_progress((int)(played * 100 / (uint64_t)generator.total_frames));
 	}
 
-	printf("\rProgress: 100%%\n");
-	printf("Playback complete!\n");
+	print_progress(100);
+	printf("\nPlayback complete!\n");
 
 	/* Cleanup */
 	jack_client_close(client);
+	VCARD_TRACE_STOP();
 
 	return 0;
 }
@@ -2,7 +2,10 @@
  * Sine Wave Generator Application (Windows/WASAPI)
  * 
  * Generates a sine wave and plays it through the default WASAPI audio device
- * Usage: sine_generator_app.exe [frequency] [duration_seconds]
+ * Usage: sine_generator_app.exe [--latency-probe] [frequency] [duration_seconds]
+ *
+ *   --latency-probe   Play timestamped MLS bursts instead of the tone, for
+ *                     test_loopback_read --latency
  * 
  * This is a demonstration of Windows audio output using WASAPI.
  * For a complete virtual sound card, use the WDM driver implementation.
@@ -16,10 +19,14 @@
 #include <audioclient.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
+#include <string.h>
+#include "sine_generator.h"
+#include "latency_probe.h"
+#include "vcard_thread.h"
+#include "vcard_trace.h"
+
+#ifndef WAVE_FORMAT_EXTENSIBLE
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
 #endif
 
 #define DEFAULT_FREQUENCY 440.0
@@ -33,40 +40,30 @@ const IID IID_IMMDeviceEnumerator = {0xA95664D2, 0x9614, 0x4F35, {0xA7, 0x46, 0x
 const IID IID_IAudioClient = {0x1CB9AD4C, 0xDBFA, 0x4C32, {0xB1, 0x78, 0xC2, 0xF5, 0x68, 0xA7, 0x03, 0xB2}};
 const IID IID_IAudioRenderClient = {0xF294ACFC, 0x3146, 0x4483, {0xA7, 0xBF, 0xAD, 0xDC, 0xA7, 0xC2, 0x60, 0xE2}};
 
-typedef struct {
-	double phase;
-	double frequency;
-	double sample_rate;
-	double amplitude;
-} sine_generator_t;
-
-static void sine_generator_init(sine_generator_t *gen, double frequency,
-				double sample_rate, double amplitude)
+/**
+ * Map the mix format to a sine generator output format
+ * Returns 1 if the format can be rendered, 0 otherwise
+ */
+static int wave_sample_format(WAVEFORMATEX *pwfx, sine_format_t *format)
 {
-	gen->phase = 0.0;
-	gen->frequency = frequency;
-	gen->sample_rate = sample_rate;
-	gen->amplitude = amplitude;
-}
+	WORD tag = pwfx->wFormatTag;
 
-static void sine_generator_process_float(sine_generator_t *gen, float *buffer,
-					 size_t num_samples, int channels)
-{
-	double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
-
-	for (size_t i = 0; i < num_samples; i++) {
-		float sample = (float)(gen->amplitude * sin(gen->phase));
-		
-		/* Write to all channels */
-		for (int ch = 0; ch < channels; ch++) {
-			buffer[i * channels + ch] = sample;
-		}
-		
-		gen->phase += phase_increment;
-		if (gen->phase >= 2.0 * M_PI) {
-			gen->phase -= 2.0 * M_PI;
+	/* KSDATAFORMAT_SUBTYPE_* GUIDs carry the plain format tag in Data1 */
+	if (tag == WAVE_FORMAT_EXTENSIBLE) {
+		tag = (WORD)((WAVEFORMATEXTENSIBLE *)pwfx)->SubFormat.Data1;
+	}
+	if (tag == WAVE_FORMAT_IEEE_FLOAT && pwfx->wBitsPerSample == 32) {
+		*format = SINE_FORMAT_F32;
+		return 1;
+	}
+	if (tag == WAVE_FORMAT_PCM) {
+		switch (pwfx->wBitsPerSample) {
+		case 16: *format = SINE_FORMAT_I16; return 1;
+		case 24: *format = SINE_FORMAT_I24; return 1;
+		case 32: *format = SINE_FORMAT_I32; return 1;
 		}
 	}
+	return 0;
 }
 
 int main(int argc, char *argv[])
@@ -80,11 +77,21 @@ int main(int argc, char *argv[])
 	UINT32 bufferFrameCount;
 	BYTE *pData;
 	sine_generator_t gen;
+	latency_probe_t probe;
+	int probe_enabled = 0;
+	sine_format_t format = SINE_FORMAT_F32;
+	sine_writer_t writer;
+	int have_format;
 	double frequency = DEFAULT_FREQUENCY;
 	int duration = DEFAULT_DURATION;
 	DWORD flags = 0;
 
 	/* Parse command line arguments */
+	if (argc >= 2 && strcmp(argv[1], "--latency-probe") == 0) {
+		probe_enabled = 1;
+		argv++;
+		argc--;
+	}
 	if (argc >= 2) {
 		frequency = atof(argv[1]);
 		if (frequency <= 0 || frequency > 20000) {
@@ -102,7 +109,12 @@ int main(int argc, char *argv[])
 
 	printf("Windows WASAPI Sine Wave Generator\n");
 	printf("===================================\n");
-	printf("Frequency: %.2f Hz\n", frequency);
+	if (probe_enabled) {
+		printf("Signal: latency probe bursts every %.0f ms\n",
+		       LATENCY_PROBE_DEFAULT_INTERVAL * 1000.0);
+	} else {
+		printf("Frequency: %.2f Hz\n", frequency);
+	}
 	printf("Duration: %d seconds\n", duration);
 	printf("\n");
 
@@ -206,8 +218,20 @@ int main(int argc, char *argv[])
 
 	/* Initialize sine generator */
 	sine_generator_init(&gen, frequency, pwfx->nSamplesPerSec, 0.5);
+	/* Resolve the output kernel once for the mix format */
+	have_format = wave_sample_format(pwfx, &format) &&
+		      sine_writer_init(&writer, format, pwfx->nChannels, 0) == 0;
+	if (!have_format) {
+		fprintf(stderr, "Unsupported mix format, playing silence\n");
+	}
+	if (probe_enabled &&
+	    latency_probe_init(&probe, pwfx->nSamplesPerSec,
+			       LATENCY_PROBE_DEFAULT_INTERVAL, 0.5) != 0) {
+		fprintf(stderr, "Unsupported sample rate for the latency probe\n");
+		probe_enabled = 0;
+	}
 
-	printf("Playing sine wave...\n");
+	printf(probe_enabled ? "Playing latency probe...\n" : "Playing sine wave...\n");
 
 	/* Start audio client */
 	hr = IAudioClient_Start(pAudioClient);
@@ -221,6 +245,7 @@ int main(int argc, char *argv[])
 		CoUninitialize();
 		return 1;
 	}
+	VCARD_TRACE_START_FROM_ENV();
 
 	/* Generate and play audio */
 	int total_frames = duration * pwfx->nSamplesPerSec;
@@ -240,6 +265,8 @@ int main(int argc, char *argv[])
 		numFramesAvailable = bufferFrameCount - numFramesPadding;
 
 		if (numFramesAvailable > 0) {
+			VCARD_TRACE_BEGIN(trace);
+
 			/* Get buffer */
 			hr = IAudioRenderClient_GetBuffer(pRenderClient, numFramesAvailable, &pData);
 			if (FAILED(hr)) {
@@ -248,12 +275,15 @@ int main(int argc, char *argv[])
 			}
 
 			/* Generate audio */
-			if (pwfx->wFormatTag == WAVE_FORMAT_IEEE_FLOAT) {
-				sine_generator_process_float(&gen, (float*)pData,
-							    numFramesAvailable,
-							    pwfx->nChannels);
+			if (have_format && probe_enabled) {
+				latency_probe_write_interleaved(&probe, pData, numFramesAvailable,
+								pwfx->nChannels, format,
+								vcard_time_ns());
+			} else if (have_format) {
+				void *buffer = pData;
+				sine_writer_render(&writer, &gen, &buffer, numFramesAvailable, NULL);
 			} else {
-				/* For PCM, we'd need to convert - for now just silence */
+				/* Unsupported format - write silence */
 				memset(pData, 0, numFramesAvailable * pwfx->nBlockAlign);
 			}
 
@@ -264,6 +294,8 @@ int main(int argc, char *argv[])
 				fprintf(stderr, "Failed to release buffer: 0x%lx\n", hr);
 				break;
 			}
+			VCARD_TRACE_END(trace, "wasapi.render", numFramesAvailable, numFramesAvailable,
+					numFramesPadding + numFramesAvailable);
 
 			frames_written += numFramesAvailable;
 
@@ -284,6 +316,7 @@ int main(int argc, char *argv[])
 
 	/* Stop audio client */
 	IAudioClient_Stop(pAudioClient);
+	VCARD_TRACE_STOP();
 
 	/* Cleanup */
 	IAudioRenderClient_Release(pRenderClient);
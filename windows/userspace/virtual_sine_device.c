@@ -11,12 +11,36 @@
  *   -r <rate>        Sample rate in Hz (default: 48000)
  *   -c <channels>    Number of channels (default: 2)
  *   -a <amplitude>   Amplitude 0.0-1.0 (default: 0.5)
+ *   -m <mode>        Render mode: event, lowlat, exclusive or poll
+ *                    (default: event)
+ *   -b <ms>          Buffer duration in milliseconds (default: engine period)
  *   -l               List available audio devices
  *   -h               Show this help message
  * 
  * Examples:
  *   ./virtual_sine_device.exe -f 440 -d "CABLE Input"
  *   ./virtual_sine_device.exe -f 880 -a 0.3
+ *   ./virtual_sine_device.exe -m lowlat
+ *   ./virtual_sine_device.exe -m exclusive -b 3
+ *
+ * Render modes:
+ *   event      Shared mode, AUDCLNT_STREAMFLAGS_EVENTCALLBACK; the render
+ *              thread sleeps in WaitForSingleObject until the engine asks
+ *              for the next period
+ *   lowlat     Like event, but initialized through IAudioClient3 with the
+ *              smallest shared-mode engine period the driver supports
+ *   exclusive  Event-driven exclusive mode, bypassing the shared engine
+ *   poll       Legacy GetCurrentPadding + Sleep(10) loop with a 1 s buffer
+ *
+ * Event-driven modes register the render thread with MMCSS "Pro Audio" and
+ * print the measured output latency (samples written minus the device
+ * clock position) and the wakeup interval once per second.
+ *
+ * -d names are resolved through the device discovery cache
+ * (common/device_cache.h): a cached endpoint ID is opened directly, and
+ * only a miss enumerates every endpoint. An IMMNotificationClient drops
+ * the cache whenever an endpoint is added, removed, changes state or is
+ * renamed while the program runs.
  */
 
 #ifdef _WIN32
@@ -26,16 +50,17 @@
 #include <mmdeviceapi.h>
 #include <audioclient.h>
 #include <functiondiscoverykeys_devpkey.h>
+#include <avrt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
-#include <math.h>
 #include <signal.h>
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
+#include "sine_generator.h"
+#include "vcard_telemetry.h"
+#include "vcard_trace.h"
+#include "device_cache.h"
+#include "vcard.h"
 
 #ifndef WAVE_FORMAT_EXTENSIBLE
 #define WAVE_FORMAT_EXTENSIBLE 0xFFFE
@@ -46,11 +71,21 @@
 #define DEFAULT_CHANNELS 2
 #define DEFAULT_AMPLITUDE 0.5
 
+/* 100-nanosecond units (REFERENCE_TIME) per second and per millisecond */
+#define HNS_PER_SEC 10000000LL
+#define HNS_PER_MS 10000LL
+
+/* Legacy polling loop buffer duration */
+#define POLL_BUFFER_DURATION HNS_PER_SEC
+
 /* COM GUIDs */
 const CLSID CLSID_MMDeviceEnumerator = {0xBCDE0395, 0xE52F, 0x467C, {0x8E, 0x3D, 0xC4, 0x57, 0x92, 0x91, 0x69, 0x2E}};
 const IID IID_IMMDeviceEnumerator = {0xA95664D2, 0x9614, 0x4F35, {0xA7, 0x46, 0xDE, 0x8D, 0xB6, 0x36, 0x17, 0xE6}};
 const IID IID_IAudioClient = {0x1CB9AD4C, 0xDBFA, 0x4C32, {0xB1, 0x78, 0xC2, 0xF5, 0x68, 0xA7, 0x03, 0xB2}};
 const IID IID_IAudioRenderClient = {0xF294ACFC, 0x3146, 0x4483, {0xA7, 0xBF, 0xAD, 0xDC, 0xA7, 0xC2, 0x60, 0xE2}};
+const IID IID_IAudioClient3 = {0x7ED4EE07, 0x8E67, 0x4CD4, {0x8C, 0x1A, 0x2B, 0x7A, 0x59, 0x87, 0xAD, 0x42}};
+const IID IID_IAudioClock = {0xCD63314F, 0x3FBA, 0x4A1B, {0x81, 0x2C, 0xEF, 0x96, 0x35, 0x87, 0x28, 0xE7}};
+const IID IID_IMMNotificationClient = {0x7991EEC9, 0x7E89, 0x4D85, {0x83, 0x90, 0x6C, 0x70, 0x3C, 0xEC, 0x60, 0xC0}};
 
 /* Audio format GUIDs for WAVEFORMATEXTENSIBLE */
 static const GUID KSDATAFORMAT_SUBTYPE_IEEE_FLOAT = {
@@ -60,15 +95,34 @@ static const GUID KSDATAFORMAT_SUBTYPE_PCM = {
     0x00000001, 0x0000, 0x0010, {0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71}
 };
 
+typedef enum {
+    RENDER_MODE_EVENT,
+    RENDER_MODE_LOW_LATENCY,
+    RENDER_MODE_EXCLUSIVE,
+    RENDER_MODE_POLL
+} render_mode_t;
+
+/* Measured latency and wakeup timing, reset after every report */
 typedef struct {
-    double phase;
-    double frequency;
-    double sample_rate;
-    double amplitude;
-} sine_generator_t;
+    double latency_min_ms;
+    double latency_max_ms;
+    double latency_sum_ms;
+    double interval_max_ms;
+    double interval_sum_ms;
+    UINT32 samples;
+} latency_stats_t;
 
 static volatile int g_running = 1;
 
+/* Xruns, load and measured latency, updated by the render loop */
+static vcard_telemetry_t g_telemetry;
+
+/* Output kernel for the negotiated format, resolved once before streaming */
+static sine_writer_t g_writer;
+
+/* -d name to endpoint ID cache; its path is fixed before notifications start */
+static device_cache_t g_device_cache;
+
 /**
  * Helper function to compare GUIDs
  */
@@ -140,79 +194,480 @@ static const char* get_format_description(WAVEFORMATEX *pwfx)
     return desc;
 }
 
-static void sine_generator_init(sine_generator_t *gen, double frequency,
-                                double sample_rate, double amplitude)
+/**
+ * Map a stream format to a sine generator output format
+ * Returns 1 if the format can be rendered, 0 otherwise
+ */
+static int wave_sample_format(WAVEFORMATEX *pwfx, sine_format_t *format)
 {
-    gen->phase = 0.0;
-    gen->frequency = frequency;
-    gen->sample_rate = sample_rate;
-    gen->amplitude = amplitude;
+    if (is_format_ieee_float(pwfx) && pwfx->wBitsPerSample == 32) {
+        *format = SINE_FORMAT_F32;
+        return 1;
+    }
+    if (is_format_pcm(pwfx)) {
+        /* 24-in-32 containers are left-justified, so they take I32 */
+        switch (pwfx->wBitsPerSample) {
+        case 16: *format = SINE_FORMAT_I16; return 1;
+        case 24: *format = SINE_FORMAT_I24; return 1;
+        case 32: *format = SINE_FORMAT_I32; return 1;
+        }
+    }
+    return 0;
 }
 
-static void sine_generator_process_float(sine_generator_t *gen, float *buffer,
-                                         size_t num_samples, int channels)
+/**
+ * Resolve the output kernel for the stream format
+ * Returns 1 if the format can be rendered, 0 if blocks will be silent
+ */
+static int setup_writer(WAVEFORMATEX *pwfx)
 {
-    double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
+    sine_format_t format;
+
+    if (!wave_sample_format(pwfx, &format) ||
+        sine_writer_init(&g_writer, format, pwfx->nChannels, 0) != 0) {
+        memset(&g_writer, 0, sizeof(g_writer));
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Render one block in the stream format (float, PCM or silence)
+ */
+static void render_block(sine_generator_t *gen, BYTE *data, UINT32 frames,
+                         WAVEFORMATEX *pwfx)
+{
+    if (g_writer.store) {
+        void *buffer = data;
+        sine_writer_render(&g_writer, gen, &buffer, frames, NULL);
+    } else {
+        /* Unsupported format - write silence */
+        memset(data, 0, frames * pwfx->nBlockAlign);
+    }
+}
+
+static const char* render_mode_name(render_mode_t mode)
+{
+    switch (mode) {
+    case RENDER_MODE_EVENT:       return "event (shared)";
+    case RENDER_MODE_LOW_LATENCY: return "lowlat (IAudioClient3 shared)";
+    case RENDER_MODE_EXCLUSIVE:   return "exclusive (event)";
+    case RENDER_MODE_POLL:        return "poll (shared)";
+    }
+    return "unknown";
+}
+
+static int parse_render_mode(const char *name, render_mode_t *mode)
+{
+    if (strcmp(name, "event") == 0) {
+        *mode = RENDER_MODE_EVENT;
+    } else if (strcmp(name, "lowlat") == 0) {
+        *mode = RENDER_MODE_LOW_LATENCY;
+    } else if (strcmp(name, "exclusive") == 0) {
+        *mode = RENDER_MODE_EXCLUSIVE;
+    } else if (strcmp(name, "poll") == 0) {
+        *mode = RENDER_MODE_POLL;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Pick a format the endpoint accepts in exclusive mode
+ * Tries the mix format first, then 16-bit PCM at the same rate/channels.
+ * On success *ppwfx may be replaced (CoTaskMemAlloc'd like the original).
+ */
+static HRESULT select_exclusive_format(IAudioClient *pAudioClient,
+                                       WAVEFORMATEX **ppwfx)
+{
+    WAVEFORMATEX *pcm;
+    HRESULT hr;
+
+    hr = IAudioClient_IsFormatSupported(pAudioClient, AUDCLNT_SHAREMODE_EXCLUSIVE,
+                                        *ppwfx, NULL);
+    if (hr == S_OK) {
+        return S_OK;
+    }
 
-    for (size_t i = 0; i < num_samples; i++) {
-        float sample = (float)(gen->amplitude * sin(gen->phase));
-        
-        /* Write to all channels */
-        for (int ch = 0; ch < channels; ch++) {
-            buffer[i * channels + ch] = sample;
+    pcm = (WAVEFORMATEX*)CoTaskMemAlloc(sizeof(WAVEFORMATEX));
+    if (!pcm) {
+        return E_OUTOFMEMORY;
+    }
+    pcm->wFormatTag = WAVE_FORMAT_PCM;
+    pcm->nChannels = (*ppwfx)->nChannels;
+    pcm->nSamplesPerSec = (*ppwfx)->nSamplesPerSec;
+    pcm->wBitsPerSample = 16;
+    pcm->nBlockAlign = (WORD)(pcm->nChannels * 2);
+    pcm->nAvgBytesPerSec = pcm->nSamplesPerSec * pcm->nBlockAlign;
+    pcm->cbSize = 0;
+
+    hr = IAudioClient_IsFormatSupported(pAudioClient, AUDCLNT_SHAREMODE_EXCLUSIVE,
+                                        pcm, NULL);
+    if (hr != S_OK) {
+        CoTaskMemFree(pcm);
+        return AUDCLNT_E_UNSUPPORTED_FORMAT;
+    }
+
+    CoTaskMemFree(*ppwfx);
+    *ppwfx = pcm;
+    return S_OK;
+}
+
+/**
+ * Initialize the audio client for the requested render mode
+ *
+ * In exclusive mode the client may be re-activated to retry with a buffer
+ * duration aligned to the device, so it is passed by reference.
+ */
+static HRESULT initialize_audio_client(IMMDevice *pDevice,
+                                       IAudioClient **ppAudioClient,
+                                       WAVEFORMATEX **ppwfx,
+                                       render_mode_t mode,
+                                       double buffer_ms)
+{
+    IAudioClient *pAudioClient = *ppAudioClient;
+    REFERENCE_TIME default_period = 0;
+    REFERENCE_TIME min_period = 0;
+    REFERENCE_TIME duration;
+    HRESULT hr;
+
+    hr = IAudioClient_GetDevicePeriod(pAudioClient, &default_period, &min_period);
+    if (SUCCEEDED(hr)) {
+        printf("Device period: default %.2f ms, minimum %.2f ms\n",
+               (double)default_period / HNS_PER_MS,
+               (double)min_period / HNS_PER_MS);
+    }
+
+    duration = (REFERENCE_TIME)(buffer_ms * HNS_PER_MS);
+
+    switch (mode) {
+    case RENDER_MODE_POLL:
+        return IAudioClient_Initialize(pAudioClient, AUDCLNT_SHAREMODE_SHARED, 0,
+                                       duration > 0 ? duration : POLL_BUFFER_DURATION,
+                                       0, *ppwfx, NULL);
+
+    case RENDER_MODE_LOW_LATENCY: {
+        IAudioClient3 *pAudioClient3 = NULL;
+        UINT32 default_frames, fundamental_frames, min_frames, max_frames;
+        UINT32 period_frames;
+
+        hr = IAudioClient_QueryInterface(pAudioClient, &IID_IAudioClient3,
+                                         (void**)&pAudioClient3);
+        if (FAILED(hr)) {
+            printf("IAudioClient3 not available, using event mode\n");
+            break;
+        }
+
+        hr = IAudioClient3_GetSharedModeEnginePeriod(pAudioClient3, *ppwfx,
+                                                     &default_frames,
+                                                     &fundamental_frames,
+                                                     &min_frames, &max_frames);
+        if (FAILED(hr)) {
+            IAudioClient3_Release(pAudioClient3);
+            return hr;
+        }
+        printf("Engine period: default %u, min %u, max %u, step %u frames\n",
+               default_frames, min_frames, max_frames, fundamental_frames);
+
+        period_frames = min_frames;
+        if (buffer_ms > 0.0) {
+            /* Round the requested duration to the engine's granularity */
+            period_frames = (UINT32)(buffer_ms * (*ppwfx)->nSamplesPerSec / 1000.0);
+            if (fundamental_frames != 0) {
+                period_frames -= period_frames % fundamental_frames;
+            } else {
+                /* No granularity reported: only the minimum is known to work */
+                period_frames = min_frames;
+            }
+            if (period_frames < min_frames) {
+                period_frames = min_frames;
+            } else if (period_frames > max_frames) {
+                period_frames = max_frames;
+            }
+        }
+
+        hr = IAudioClient3_InitializeSharedAudioStream(pAudioClient3,
+                                                       AUDCLNT_STREAMFLAGS_EVENTCALLBACK,
+                                                       period_frames, *ppwfx, NULL);
+        IAudioClient3_Release(pAudioClient3);
+        return hr;
+    }
+
+    case RENDER_MODE_EXCLUSIVE:
+        hr = select_exclusive_format(pAudioClient, ppwfx);
+        if (FAILED(hr)) {
+            fprintf(stderr, "No exclusive-mode format accepted by the device\n");
+            return hr;
         }
-        
-        gen->phase += phase_increment;
-        if (gen->phase >= 2.0 * M_PI) {
-            gen->phase -= 2.0 * M_PI;
+        if (duration <= 0) {
+            duration = min_period;
         }
+
+        /* Exclusive event mode requires periodicity == buffer duration */
+        hr = IAudioClient_Initialize(pAudioClient, AUDCLNT_SHAREMODE_EXCLUSIVE,
+                                     AUDCLNT_STREAMFLAGS_EVENTCALLBACK,
+                                     duration, duration, *ppwfx, NULL);
+        if (hr == AUDCLNT_E_BUFFER_SIZE_NOT_ALIGNED) {
+            UINT32 aligned_frames;
+
+            hr = IAudioClient_GetBufferSize(pAudioClient, &aligned_frames);
+            if (FAILED(hr)) {
+                return hr;
+            }
+            duration = (REFERENCE_TIME)((double)HNS_PER_SEC * aligned_frames /
+                                        (*ppwfx)->nSamplesPerSec + 0.5);
+
+            IAudioClient_Release(pAudioClient);
+            *ppAudioClient = NULL;
+            hr = IMMDevice_Activate(pDevice, &IID_IAudioClient, CLSCTX_ALL,
+                                    NULL, (void**)&pAudioClient);
+            if (FAILED(hr)) {
+                return hr;
+            }
+            *ppAudioClient = pAudioClient;
+
+            hr = IAudioClient_Initialize(pAudioClient, AUDCLNT_SHAREMODE_EXCLUSIVE,
+                                         AUDCLNT_STREAMFLAGS_EVENTCALLBACK,
+                                         duration, duration, *ppwfx, NULL);
+        }
+        return hr;
+
+    case RENDER_MODE_EVENT:
+        break;
+    }
+
+    /* Shared event mode; 0 lets the engine choose its default period */
+    return IAudioClient_Initialize(pAudioClient, AUDCLNT_SHAREMODE_SHARED,
+                                   AUDCLNT_STREAMFLAGS_EVENTCALLBACK,
+                                   duration, 0, *ppwfx, NULL);
+}
+
+static double qpc_to_ms(LONGLONG ticks, LARGE_INTEGER qpc_freq)
+{
+    return (double)ticks * 1000.0 / (double)qpc_freq.QuadPart;
+}
+
+static void latency_stats_reset(latency_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->latency_min_ms = 1e9;
+}
+
+static void latency_stats_print(const latency_stats_t *stats)
+{
+    vcard_status_t status;
+
+    if (stats->samples == 0) {
+        return;
     }
+    vcard_telemetry_snapshot(&g_telemetry, &status);
+    printf("Latency: avg %.2f ms, min %.2f ms, max %.2f ms | "
+           "wakeup interval avg %.3f ms, max %.3f ms | xruns %u, load %.2f%%\n",
+           stats->latency_sum_ms / stats->samples,
+           stats->latency_min_ms, stats->latency_max_ms,
+           stats->interval_sum_ms / stats->samples, stats->interval_max_ms,
+           status.xruns, status.cpu_load);
+}
+
+static UINT64 qpc_to_ns(LONGLONG ticks, LARGE_INTEGER qpc_freq)
+{
+    return (UINT64)((double)ticks * 1e9 / (double)qpc_freq.QuadPart);
 }
 
 /**
- * Process sine wave into PCM format
- * Supports 16-bit, 24-bit, and 32-bit PCM
+ * Event-driven render loop
+ *
+ * Latency is measured per wakeup as the duration of audio written but not
+ * yet played according to the device clock, extrapolated to "now" with
+ * the QPC timestamp IAudioClock reports alongside its position.
  */
-static void sine_generator_process_pcm(sine_generator_t *gen, BYTE *buffer,
-                                       size_t num_samples, int channels,
-                                       int bits_per_sample)
+static HRESULT run_event_loop(IAudioClient *pAudioClient,
+                              IAudioRenderClient *pRenderClient,
+                              IAudioClock *pClock, HANDLE hEvent,
+                              WAVEFORMATEX *pwfx, UINT32 bufferFrameCount,
+                              UINT64 frames_prefilled, int exclusive,
+                              sine_generator_t *gen)
 {
-    double phase_increment = 2.0 * M_PI * gen->frequency / gen->sample_rate;
-    int bytes_per_sample = bits_per_sample / 8;
-    
-    for (size_t i = 0; i < num_samples; i++) {
-        double sample_value = gen->amplitude * sin(gen->phase);
-        
-        /* Write to all channels */
-        for (int ch = 0; ch < channels; ch++) {
-            BYTE *sample_ptr = buffer + (i * channels + ch) * bytes_per_sample;
-            
-            if (bits_per_sample == 16) {
-                /* 16-bit signed PCM: range -32768 to 32767 */
-                int16_t pcm_sample = (int16_t)(sample_value * 32767.0);
-                memcpy(sample_ptr, &pcm_sample, sizeof(int16_t));
-            } else if (bits_per_sample == 24) {
-                /* 24-bit signed PCM: range -8388608 to 8388607 */
-                int32_t pcm_sample = (int32_t)(sample_value * 8388607.0);
-                /* Write 3 bytes (little-endian) */
-                sample_ptr[0] = (BYTE)(pcm_sample & 0xFF);
-                sample_ptr[1] = (BYTE)((pcm_sample >> 8) & 0xFF);
-                sample_ptr[2] = (BYTE)((pcm_sample >> 16) & 0xFF);
-            } else if (bits_per_sample == 32) {
-                /* 32-bit signed PCM: range -2147483648 to 2147483647 */
-                int32_t pcm_sample = (int32_t)(sample_value * 2147483647.0);
-                memcpy(sample_ptr, &pcm_sample, sizeof(int32_t));
-            } else {
-                /* Unsupported bit depth - write silence */
-                memset(sample_ptr, 0, bytes_per_sample);
+    LARGE_INTEGER qpc_freq, now, done, last_wakeup, last_report;
+    UINT64 clock_freq = 0;
+    UINT64 frames_written = frames_prefilled;
+    double period_ms = (double)bufferFrameCount * 1000.0 / pwfx->nSamplesPerSec;
+    latency_stats_t stats;
+    HRESULT hr = S_OK;
+
+    QueryPerformanceFrequency(&qpc_freq);
+    if (pClock) {
+        IAudioClock_GetFrequency(pClock, &clock_freq);
+    }
+    latency_stats_reset(&stats);
+    QueryPerformanceCounter(&last_wakeup);
+    last_report = last_wakeup;
+
+    while (g_running) {
+        UINT32 numFramesPadding = 0;
+        UINT32 numFramesAvailable;
+        BYTE *pData;
+        DWORD wait;
+
+        wait = WaitForSingleObject(hEvent, 2000);
+        if (wait != WAIT_OBJECT_0) {
+            fprintf(stderr, "Timed out waiting for audio engine event\n");
+            hr = E_FAIL;
+            break;
+        }
+        QueryPerformanceCounter(&now);
+
+        if (exclusive) {
+            /* Each event hands us one full buffer; a wakeup a whole buffer
+             * late means the device played one we never filled */
+            numFramesAvailable = bufferFrameCount;
+            if (qpc_to_ms(now.QuadPart - last_wakeup.QuadPart, qpc_freq) > 2.0 * period_ms) {
+                vcard_telemetry_xrun(&g_telemetry);
+            }
+        } else {
+            hr = IAudioClient_GetCurrentPadding(pAudioClient, &numFramesPadding);
+            if (FAILED(hr)) {
+                fprintf(stderr, "Failed to get current padding: 0x%lx\n", hr);
+                break;
+            }
+            if (numFramesPadding == 0) {
+                /* The engine drained everything we had queued */
+                vcard_telemetry_xrun(&g_telemetry);
             }
+            numFramesAvailable = bufferFrameCount - numFramesPadding;
         }
-        
-        gen->phase += phase_increment;
-        if (gen->phase >= 2.0 * M_PI) {
-            gen->phase -= 2.0 * M_PI;
+
+        if (numFramesAvailable > 0) {
+            VCARD_TRACE_BEGIN(trace);
+
+            hr = IAudioRenderClient_GetBuffer(pRenderClient, numFramesAvailable, &pData);
+            if (FAILED(hr)) {
+                fprintf(stderr, "Failed to get buffer: 0x%lx\n", hr);
+                break;
+            }
+
+            render_block(gen, pData, numFramesAvailable, pwfx);
+
+            hr = IAudioRenderClient_ReleaseBuffer(pRenderClient,
+                                                 numFramesAvailable, 0);
+            if (FAILED(hr)) {
+                fprintf(stderr, "Failed to release buffer: 0x%lx\n", hr);
+                break;
+            }
+            frames_written += numFramesAvailable;
+            QueryPerformanceCounter(&done);
+            vcard_telemetry_period(&g_telemetry, numFramesAvailable, pwfx->nSamplesPerSec,
+                                   qpc_to_ns(done.QuadPart - now.QuadPart, qpc_freq));
+            /* Padding stays 0 in exclusive mode, where the period is the buffer */
+            VCARD_TRACE_END(trace, "wasapi.event", numFramesAvailable, numFramesAvailable,
+                            numFramesPadding + numFramesAvailable);
         }
+
+        if (pClock && clock_freq > 0) {
+            UINT64 position, qpc_position;
+
+            if (SUCCEEDED(IAudioClock_GetPosition(pClock, &position, &qpc_position))) {
+                /* qpc_position is in 100 ns units */
+                double now_hns = (double)now.QuadPart * HNS_PER_SEC / qpc_freq.QuadPart;
+                double played_s = (double)position / clock_freq +
+                                  (now_hns - (double)qpc_position) / HNS_PER_SEC;
+                double written_s = (double)frames_written / pwfx->nSamplesPerSec;
+                double latency_ms = (written_s - played_s) * 1000.0;
+                double interval_ms = qpc_to_ms(now.QuadPart - last_wakeup.QuadPart,
+                                               qpc_freq);
+
+                if (latency_ms < stats.latency_min_ms) {
+                    stats.latency_min_ms = latency_ms;
+                }
+                if (latency_ms > stats.latency_max_ms) {
+                    stats.latency_max_ms = latency_ms;
+                }
+                if (interval_ms > stats.interval_max_ms) {
+                    stats.interval_max_ms = interval_ms;
+                }
+                stats.latency_sum_ms += latency_ms;
+                stats.interval_sum_ms += interval_ms;
+                stats.samples++;
+                vcard_telemetry_latency(&g_telemetry,
+                                        latency_ms > 0.0 ? (uint32_t)(latency_ms * 1000.0) : 0);
+            }
+        }
+        last_wakeup = now;
+
+        if (qpc_to_ms(now.QuadPart - last_report.QuadPart, qpc_freq) >= 1000.0) {
+            latency_stats_print(&stats);
+            latency_stats_reset(&stats);
+            last_report = now;
+        }
+    }
+
+    return hr;
+}
+
+/**
+ * Legacy polling render loop
+ */
+static HRESULT run_poll_loop(IAudioClient *pAudioClient,
+                             IAudioRenderClient *pRenderClient,
+                             WAVEFORMATEX *pwfx, UINT32 bufferFrameCount,
+                             sine_generator_t *gen)
+{
+    LARGE_INTEGER qpc_freq, start, done;
+    HRESULT hr = S_OK;
+
+    QueryPerformanceFrequency(&qpc_freq);
+
+    while (g_running) {
+        UINT32 numFramesPadding;
+        UINT32 numFramesAvailable;
+        BYTE *pData;
+
+        /* Check how much buffer space is available */
+        hr = IAudioClient_GetCurrentPadding(pAudioClient, &numFramesPadding);
+        if (FAILED(hr)) {
+            fprintf(stderr, "Failed to get current padding: 0x%lx\n", hr);
+            break;
+        }
+        if (numFramesPadding == 0) {
+            vcard_telemetry_xrun(&g_telemetry);
+        }
+
+        numFramesAvailable = bufferFrameCount - numFramesPadding;
+        QueryPerformanceCounter(&start);
+
+        if (numFramesAvailable > 0) {
+            VCARD_TRACE_BEGIN(trace);
+
+            /* Get buffer */
+            hr = IAudioRenderClient_GetBuffer(pRenderClient, numFramesAvailable, &pData);
+            if (FAILED(hr)) {
+                fprintf(stderr, "Failed to get buffer: 0x%lx\n", hr);
+                break;
+            }
+
+            /* Generate audio */
+            render_block(gen, pData, numFramesAvailable, pwfx);
+
+            /* Release buffer */
+            hr = IAudioRenderClient_ReleaseBuffer(pRenderClient,
+                                                 numFramesAvailable, 0);
+            if (FAILED(hr)) {
+                fprintf(stderr, "Failed to release buffer: 0x%lx\n", hr);
+                break;
+            }
+            QueryPerformanceCounter(&done);
+            vcard_telemetry_period(&g_telemetry, numFramesAvailable, pwfx->nSamplesPerSec,
+                                   qpc_to_ns(done.QuadPart - start.QuadPart, qpc_freq));
+            VCARD_TRACE_END(trace, "wasapi.poll", numFramesAvailable, numFramesAvailable,
+                            numFramesPadding + numFramesAvailable);
+        }
+
+        /* Sleep to avoid busy-waiting */
+        Sleep(10);
     }
+
+    return hr;
 }
 
 static BOOL WINAPI console_handler(DWORD signal)
@@ -285,6 +740,32 @@ static void list_audio_devices(void)
     IMMDeviceEnumerator_Release(pEnumerator);
 }
 
+/**
+ * Check that an endpoint is active and its friendly name contains a name
+ */
+static int device_name_matches(IMMDevice *pDevice, const wchar_t *device_name)
+{
+    IPropertyStore *pProps = NULL;
+    PROPVARIANT varName;
+    DWORD state = 0;
+    int match = 0;
+
+    if (FAILED(IMMDevice_GetState(pDevice, &state)) || state != DEVICE_STATE_ACTIVE) {
+        return 0;
+    }
+    if (FAILED(IMMDevice_OpenPropertyStore(pDevice, STGM_READ, &pProps))) {
+        return 0;
+    }
+    PropVariantInit(&varName);
+    if (SUCCEEDED(IPropertyStore_GetValue(pProps, &PKEY_Device_FriendlyName, &varName)) &&
+        varName.vt == VT_LPWSTR) {
+        match = wcsstr(varName.pwszVal, device_name) != NULL;
+    }
+    PropVariantClear(&varName);
+    IPropertyStore_Release(pProps);
+    return match;
+}
+
 static IMMDevice* find_device_by_name(IMMDeviceEnumerator *pEnumerator, const wchar_t *device_name)
 {
     HRESULT hr;
@@ -304,32 +785,16 @@ static IMMDevice* find_device_by_name(IMMDeviceEnumerator *pEnumerator, const wc
         return NULL;
     }
 
-    for (UINT i = 0; i < count; i++) {
+    for (UINT i = 0; i < count && !pFoundDevice; i++) {
         IMMDevice *pDevice = NULL;
-        IPropertyStore *pProps = NULL;
-        PROPVARIANT varName;
-
-        PropVariantInit(&varName);
 
         hr = IMMDeviceCollection_Item(pCollection, i, &pDevice);
         if (SUCCEEDED(hr)) {
-            hr = IMMDevice_OpenPropertyStore(pDevice, STGM_READ, &pProps);
-            if (SUCCEEDED(hr)) {
-                hr = IPropertyStore_GetValue(pProps, &PKEY_Device_FriendlyName, &varName);
-                if (SUCCEEDED(hr) && varName.vt == VT_LPWSTR) {
-                    if (wcsstr(varName.pwszVal, device_name) != NULL) {
-                        pFoundDevice = pDevice;
-                        IMMDevice_AddRef(pFoundDevice);
-                    }
-                }
-                PropVariantClear(&varName);
-                IPropertyStore_Release(pProps);
+            if (device_name_matches(pDevice, device_name)) {
+                pFoundDevice = pDevice;
+                IMMDevice_AddRef(pFoundDevice);
             }
             IMMDevice_Release(pDevice);
-            
-            if (pFoundDevice) {
-                break;
-            }
         }
     }
 
@@ -337,6 +802,140 @@ static IMMDevice* find_device_by_name(IMMDeviceEnumerator *pEnumerator, const wc
     return pFoundDevice;
 }
 
+/**
+ * Open a render endpoint by name, trying the discovery cache first
+ *
+ * A cached endpoint ID is accepted only if the endpoint is still active
+ * under a matching name. Otherwise, and on a miss, every endpoint is
+ * enumerated and the one found is cached for the next launch.
+ */
+static IMMDevice* open_device_by_name(IMMDeviceEnumerator *pEnumerator, const char *device_name,
+                                      const wchar_t *wdevice_name, int *cached)
+{
+    char path[DEVICE_CACHE_PATH_MAX];
+    const char *id;
+    IMMDevice *pDevice = NULL;
+    LPWSTR endpoint_id = NULL;
+
+    if (device_cache_default_path("wasapi", path, sizeof(path)) != VCARD_SUCCESS) {
+        path[0] = '\0';
+    }
+    device_cache_load(&g_device_cache, path);
+
+    *cached = 0;
+    id = device_cache_lookup(&g_device_cache, device_name);
+    if (id) {
+        wchar_t wid[DEVICE_CACHE_ID_MAX];
+
+        if (MultiByteToWideChar(CP_UTF8, 0, id, -1, wid, DEVICE_CACHE_ID_MAX) > 0 &&
+            SUCCEEDED(IMMDeviceEnumerator_GetDevice(pEnumerator, wid, &pDevice)) &&
+            !device_name_matches(pDevice, wdevice_name)) {
+            IMMDevice_Release(pDevice);
+            pDevice = NULL;
+        }
+        if (pDevice) {
+            *cached = 1;
+            return pDevice;
+        }
+        device_cache_remove(&g_device_cache, device_name);
+    }
+
+    pDevice = find_device_by_name(pEnumerator, wdevice_name);
+    if (pDevice && SUCCEEDED(IMMDevice_GetId(pDevice, &endpoint_id))) {
+        char utf8_id[DEVICE_CACHE_ID_MAX];
+
+        if (WideCharToMultiByte(CP_UTF8, 0, endpoint_id, -1, utf8_id, sizeof(utf8_id),
+                                NULL, NULL) > 0) {
+            device_cache_store(&g_device_cache, device_name, utf8_id);
+        }
+        CoTaskMemFree(endpoint_id);
+    }
+    device_cache_save(&g_device_cache);
+    return pDevice;
+}
+
+/*
+ * Endpoint notifications: any endpoint arriving, leaving, changing state
+ * or being renamed drops the discovery cache. Runs on a system thread and
+ * only removes the file.
+ */
+static HRESULT STDMETHODCALLTYPE notifier_query_interface(IMMNotificationClient *This,
+                                                          REFIID riid, void **ppv)
+{
+    if (IsEqualIID(riid, &IID_IUnknown) || IsEqualIID(riid, &IID_IMMNotificationClient)) {
+        *ppv = This;
+        return S_OK;
+    }
+    *ppv = NULL;
+    return E_NOINTERFACE;
+}
+
+/* The client is a static object: reference counting is a no-op */
+static ULONG STDMETHODCALLTYPE notifier_add_ref(IMMNotificationClient *This)
+{
+    (void)This;
+    return 1;
+}
+
+static ULONG STDMETHODCALLTYPE notifier_release(IMMNotificationClient *This)
+{
+    (void)This;
+    return 1;
+}
+
+static HRESULT STDMETHODCALLTYPE notifier_state_changed(IMMNotificationClient *This,
+                                                        LPCWSTR id, DWORD state)
+{
+    (void)This; (void)id; (void)state;
+    device_cache_invalidate(g_device_cache.path);
+    return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE notifier_added(IMMNotificationClient *This, LPCWSTR id)
+{
+    (void)This; (void)id;
+    device_cache_invalidate(g_device_cache.path);
+    return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE notifier_removed(IMMNotificationClient *This, LPCWSTR id)
+{
+    (void)This; (void)id;
+    device_cache_invalidate(g_device_cache.path);
+    return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE notifier_default_changed(IMMNotificationClient *This,
+                                                          EDataFlow flow, ERole role,
+                                                          LPCWSTR id)
+{
+    (void)This; (void)flow; (void)role; (void)id;
+    return S_OK;
+}
+
+static HRESULT STDMETHODCALLTYPE notifier_property_changed(IMMNotificationClient *This,
+                                                           LPCWSTR id, const PROPERTYKEY key)
+{
+    (void)This; (void)id;
+    if (memcmp(&key, &PKEY_Device_FriendlyName, sizeof(key)) == 0) {
+        device_cache_invalidate(g_device_cache.path);
+    }
+    return S_OK;
+}
+
+static IMMNotificationClientVtbl g_notifier_vtbl = {
+    notifier_query_interface,
+    notifier_add_ref,
+    notifier_release,
+    notifier_state_changed,
+    notifier_added,
+    notifier_removed,
+    notifier_default_changed,
+    notifier_property_changed
+};
+
+static IMMNotificationClient g_notifier = { &g_notifier_vtbl };
+
 static void print_usage(const char *program_name)
 {
     printf("Usage: %s [options]\n", program_name);
@@ -346,11 +945,19 @@ static void print_usage(const char *program_name)
     printf("  -r <rate>        Sample rate in Hz (default: %d)\n", DEFAULT_SAMPLE_RATE);
     printf("  -c <channels>    Number of channels (default: %d)\n", DEFAULT_CHANNELS);
     printf("  -a <amplitude>   Amplitude 0.0-1.0 (default: %.1f)\n", DEFAULT_AMPLITUDE);
+    printf("  -m <mode>        Render mode (default: event):\n");
+    printf("                     event      shared mode, event-driven\n");
+    printf("                     lowlat     shared mode, IAudioClient3 minimum engine period\n");
+    printf("                     exclusive  exclusive mode, event-driven\n");
+    printf("                     poll       shared mode, 10 ms polling (legacy)\n");
+    printf("  -b <ms>          Buffer duration in milliseconds (default: device period)\n");
     printf("  -l               List available audio devices\n");
     printf("  -h               Show this help message\n");
     printf("\nExamples:\n");
     printf("  %s -f 440 -d \"CABLE Input\"\n", program_name);
     printf("  %s -f 880 -a 0.3\n", program_name);
+    printf("  %s -m lowlat\n", program_name);
+    printf("  %s -m exclusive -b 3\n", program_name);
     printf("\nNote: For VB-Cable loopback:\n");
     printf("  1. Install VB-Cable from https://vb-audio.com/Cable/\n");
     printf("  2. Run: %s -d \"CABLE Input\"\n", program_name);
@@ -363,11 +970,22 @@ int main(int argc, char *argv[])
     HRESULT hr;
     IMMDeviceEnumerator *pEnumerator = NULL;
     IMMDevice *pDevice = NULL;
+    int notifier_registered = 0;
     IAudioClient *pAudioClient = NULL;
     IAudioRenderClient *pRenderClient = NULL;
+    IAudioClock *pClock = NULL;
     WAVEFORMATEX *pwfx = NULL;
+    HANDLE hEvent = NULL;
+    HANDLE hTask = NULL;
+    DWORD taskIndex = 0;
     UINT32 bufferFrameCount;
+    REFERENCE_TIME streamLatency = 0;
+    BYTE *pData;
+    UINT32 prefilled = 0;
     sine_generator_t gen;
+    render_mode_t mode = RENDER_MODE_EVENT;
+    double buffer_ms = 0.0;
+    int exit_code = 1;
     double frequency = DEFAULT_FREQUENCY;
     int sample_rate = DEFAULT_SAMPLE_RATE;
     int channels = DEFAULT_CHANNELS;
@@ -403,6 +1021,17 @@ int main(int argc, char *argv[])
                 fprintf(stderr, "Invalid amplitude: %.2f (must be 0.0-1.0)\n", amplitude);
                 return 1;
             }
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            if (!parse_render_mode(argv[++i], &mode)) {
+                fprintf(stderr, "Invalid render mode: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            buffer_ms = atof(argv[++i]);
+            if (buffer_ms <= 0.0 || buffer_ms > 2000.0) {
+                fprintf(stderr, "Invalid buffer duration: %.2f ms\n", buffer_ms);
+                return 1;
+            }
         } else if (strcmp(argv[i], "-l") == 0) {
             list_devices = 1;
         } else if (strcmp(argv[i], "-h") == 0) {
@@ -445,8 +1074,9 @@ int main(int argc, char *argv[])
     /* Get audio device */
     if (device_name) {
         wchar_t wdevice_name[256];
+        int cached = 0;
         MultiByteToWideChar(CP_UTF8, 0, device_name, -1, wdevice_name, 256);
-        pDevice = find_device_by_name(pEnumerator, wdevice_name);
+        pDevice = open_device_by_name(pEnumerator, device_name, wdevice_name, &cached);
         if (!pDevice) {
             fprintf(stderr, "Could not find device: %s\n", device_name);
             fprintf(stderr, "Use -l to list available devices\n");
@@ -454,7 +1084,14 @@ int main(int argc, char *argv[])
             CoUninitialize();
             return 1;
         }
-        printf("Target device: %s\n", device_name);
+        printf("Target device: %s%s\n", device_name, cached ? " (cached)" : "");
+
+        /* Keep the cache honest for the next launch */
+        if (g_device_cache.path[0] &&
+            SUCCEEDED(IMMDeviceEnumerator_RegisterEndpointNotificationCallback(pEnumerator,
+                                                                               &g_notifier))) {
+            notifier_registered = 1;
+        }
     } else {
         hr = IMMDeviceEnumerator_GetDefaultAudioEndpoint(pEnumerator, eRender,
                                                         eConsole, &pDevice);
@@ -472,155 +1109,162 @@ int main(int argc, char *argv[])
                            NULL, (void**)&pAudioClient);
     if (FAILED(hr)) {
         fprintf(stderr, "Failed to activate audio client: 0x%lx\n", hr);
-        IMMDevice_Release(pDevice);
-        IMMDeviceEnumerator_Release(pEnumerator);
-        CoUninitialize();
-        return 1;
+        goto cleanup;
     }
 
     /* Get mix format */
     hr = IAudioClient_GetMixFormat(pAudioClient, &pwfx);
     if (FAILED(hr)) {
         fprintf(stderr, "Failed to get mix format: 0x%lx\n", hr);
-        IAudioClient_Release(pAudioClient);
-        IMMDevice_Release(pDevice);
-        IMMDeviceEnumerator_Release(pEnumerator);
-        CoUninitialize();
-        return 1;
+        goto cleanup;
+    }
+
+    printf("Render Mode: %s\n", render_mode_name(mode));
+
+    /* Initialize audio client */
+    hr = initialize_audio_client(pDevice, &pAudioClient, &pwfx, mode, buffer_ms);
+    if (FAILED(hr)) {
+        fprintf(stderr, "Failed to initialize audio client: 0x%lx\n", hr);
+        goto cleanup;
     }
 
     printf("Frequency: %.2f Hz\n", frequency);
     printf("Sample Rate: %ld Hz\n", pwfx->nSamplesPerSec);
     printf("Channels: %d\n", pwfx->nChannels);
     printf("Format: %s\n", get_format_description(pwfx));
-    printf("\n");
 
-    /* Initialize audio client */
-    hr = IAudioClient_Initialize(pAudioClient, AUDCLNT_SHAREMODE_SHARED,
-                                 0, 10000000, 0, pwfx, NULL);
-    if (FAILED(hr)) {
-        fprintf(stderr, "Failed to initialize audio client: 0x%lx\n", hr);
-        CoTaskMemFree(pwfx);
-        IAudioClient_Release(pAudioClient);
-        IMMDevice_Release(pDevice);
-        IMMDeviceEnumerator_Release(pEnumerator);
-        CoUninitialize();
-        return 1;
+    if (mode != RENDER_MODE_POLL) {
+        hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (!hEvent) {
+            fprintf(stderr, "Failed to create event: %lu\n", GetLastError());
+            goto cleanup;
+        }
+        hr = IAudioClient_SetEventHandle(pAudioClient, hEvent);
+        if (FAILED(hr)) {
+            fprintf(stderr, "Failed to set event handle: 0x%lx\n", hr);
+            goto cleanup;
+        }
     }
 
     /* Get buffer size */
     hr = IAudioClient_GetBufferSize(pAudioClient, &bufferFrameCount);
     if (FAILED(hr)) {
         fprintf(stderr, "Failed to get buffer size: 0x%lx\n", hr);
-        CoTaskMemFree(pwfx);
-        IAudioClient_Release(pAudioClient);
-        IMMDevice_Release(pDevice);
-        IMMDeviceEnumerator_Release(pEnumerator);
-        CoUninitialize();
-        return 1;
+        goto cleanup;
     }
+    IAudioClient_GetStreamLatency(pAudioClient, &streamLatency);
+    printf("Buffer: %u frames (%.2f ms), stream latency %.2f ms\n",
+           bufferFrameCount,
+           bufferFrameCount * 1000.0 / pwfx->nSamplesPerSec,
+           (double)streamLatency / HNS_PER_MS);
+    printf("\n");
 
     /* Get render client */
     hr = IAudioClient_GetService(pAudioClient, &IID_IAudioRenderClient,
                                 (void**)&pRenderClient);
     if (FAILED(hr)) {
         fprintf(stderr, "Failed to get render client: 0x%lx\n", hr);
-        CoTaskMemFree(pwfx);
-        IAudioClient_Release(pAudioClient);
-        IMMDevice_Release(pDevice);
-        IMMDeviceEnumerator_Release(pEnumerator);
-        CoUninitialize();
-        return 1;
+        goto cleanup;
+    }
+
+    /* The clock is only used for latency reporting */
+    if (FAILED(IAudioClient_GetService(pAudioClient, &IID_IAudioClock,
+                                       (void**)&pClock))) {
+        pClock = NULL;
     }
 
     /* Initialize sine generator */
     sine_generator_init(&gen, frequency, pwfx->nSamplesPerSec, amplitude);
+    if (!setup_writer(pwfx)) {
+        printf("Unsupported stream format, rendering silence\n");
+    }
+
+    /* Pre-fill the whole buffer so the first period doesn't glitch */
+    hr = IAudioRenderClient_GetBuffer(pRenderClient, bufferFrameCount, &pData);
+    if (SUCCEEDED(hr)) {
+        render_block(&gen, pData, bufferFrameCount, pwfx);
+        if (SUCCEEDED(IAudioRenderClient_ReleaseBuffer(pRenderClient,
+                                                       bufferFrameCount, 0))) {
+            prefilled = bufferFrameCount;
+        }
+    }
 
     /* Set up console handler for Ctrl+C */
     SetConsoleCtrlHandler(console_handler, TRUE);
 
+    /* Raise the render thread to the MMCSS "Pro Audio" class */
+    if (mode != RENDER_MODE_POLL) {
+        hTask = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+        if (hTask) {
+            AvSetMmThreadPriority(hTask, AVRT_PRIORITY_CRITICAL);
+            printf("MMCSS: registered with \"Pro Audio\" (task %lu)\n", taskIndex);
+        } else {
+            printf("MMCSS: registration failed (%lu), continuing\n", GetLastError());
+        }
+    }
+
     printf("Generating continuous sine wave...\n");
     printf("Press Ctrl+C to stop\n\n");
 
     /* Start audio client */
+    vcard_telemetry_init(&g_telemetry);
     hr = IAudioClient_Start(pAudioClient);
     if (FAILED(hr)) {
         fprintf(stderr, "Failed to start audio client: 0x%lx\n", hr);
-        IAudioRenderClient_Release(pRenderClient);
-        CoTaskMemFree(pwfx);
-        IAudioClient_Release(pAudioClient);
-        IMMDevice_Release(pDevice);
-        IMMDeviceEnumerator_Release(pEnumerator);
-        CoUninitialize();
-        return 1;
+        goto cleanup;
     }
 
     /* Generate and play audio continuously */
-    while (g_running) {
-        UINT32 numFramesPadding;
-        UINT32 numFramesAvailable;
-        BYTE *pData;
-
-        /* Check how much buffer space is available */
-        hr = IAudioClient_GetCurrentPadding(pAudioClient, &numFramesPadding);
-        if (FAILED(hr)) {
-            fprintf(stderr, "Failed to get current padding: 0x%lx\n", hr);
-            break;
-        }
-
-        numFramesAvailable = bufferFrameCount - numFramesPadding;
-
-        if (numFramesAvailable > 0) {
-            /* Get buffer */
-            hr = IAudioRenderClient_GetBuffer(pRenderClient, numFramesAvailable, &pData);
-            if (FAILED(hr)) {
-                fprintf(stderr, "Failed to get buffer: 0x%lx\n", hr);
-                break;
-            }
-
-            /* Generate audio */
-            if (is_format_ieee_float(pwfx)) {
-                sine_generator_process_float(&gen, (float*)pData,
-                                            numFramesAvailable,
-                                            pwfx->nChannels);
-            } else if (is_format_pcm(pwfx)) {
-                sine_generator_process_pcm(&gen, pData,
-                                          numFramesAvailable,
-                                          pwfx->nChannels,
-                                          pwfx->wBitsPerSample);
-            } else {
-                /* Unsupported format - write silence */
-                memset(pData, 0, numFramesAvailable * pwfx->nBlockAlign);
-            }
-
-            /* Release buffer */
-            hr = IAudioRenderClient_ReleaseBuffer(pRenderClient,
-                                                 numFramesAvailable, 0);
-            if (FAILED(hr)) {
-                fprintf(stderr, "Failed to release buffer: 0x%lx\n", hr);
-                break;
-            }
-        }
-
-        /* Sleep to avoid busy-waiting */
-        Sleep(10);
+    VCARD_TRACE_START_FROM_ENV();
+    if (mode == RENDER_MODE_POLL) {
+        hr = run_poll_loop(pAudioClient, pRenderClient, pwfx,
+                           bufferFrameCount, &gen);
+    } else {
+        hr = run_event_loop(pAudioClient, pRenderClient, pClock, hEvent, pwfx,
+                            bufferFrameCount, prefilled,
+                            mode == RENDER_MODE_EXCLUSIVE, &gen);
+    }
+    if (SUCCEEDED(hr)) {
+        exit_code = 0;
     }
 
     printf("\nStopping audio...\n");
+    printf("Xruns: %u\n", vcard_atomic_load_relaxed_u32(&g_telemetry.xruns));
 
     /* Stop audio client */
     IAudioClient_Stop(pAudioClient);
+    VCARD_TRACE_STOP();
 
-    /* Cleanup */
-    IAudioRenderClient_Release(pRenderClient);
-    CoTaskMemFree(pwfx);
-    IAudioClient_Release(pAudioClient);
+cleanup:
+    if (hTask) {
+        AvRevertMmThreadCharacteristics(hTask);
+    }
+    if (pClock) {
+        IAudioClock_Release(pClock);
+    }
+    if (pRenderClient) {
+        IAudioRenderClient_Release(pRenderClient);
+    }
+    if (hEvent) {
+        CloseHandle(hEvent);
+    }
+    if (pwfx) {
+        CoTaskMemFree(pwfx);
+    }
+    if (pAudioClient) {
+        IAudioClient_Release(pAudioClient);
+    }
     IMMDevice_Release(pDevice);
+    if (notifier_registered) {
+        IMMDeviceEnumerator_UnregisterEndpointNotificationCallback(pEnumerator, &g_notifier);
+    }
     IMMDeviceEnumerator_Release(pEnumerator);
     CoUninitialize();
 
-    printf("Done.\n");
-    return 0;
+    if (exit_code == 0) {
+        printf("Done.\n");
+    }
+    return exit_code;
 }
 
 #else